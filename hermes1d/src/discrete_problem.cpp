@@ -7,6 +7,7 @@
 #include "discrete_problem.h"
 #include "weakform.h"
 #include "space.h"
+#include "precalc.h"
 
 #include "../../hermes_common/error.h"
 #include "../../hermes_common/callstack.h"
@@ -15,28 +16,12 @@
 #include "../../hermes_common/solver/solver.h"
 
 
-static int _precalculated = 0;
-
 DiscreteProblem::DiscreteProblem(WeakForm* wf, Space* space, bool is_linear) : wf(wf), 
 space(space), is_linear(is_linear)
 {
   if(space->get_n_eq() != wf->get_neq())
         error("WeakForm does not have as many equations as Space in DiscreteProblem::DiscreteProblem()");
-  if (_precalculated == 0) {
-    // precalculating values and derivatives 
-    // of all polynomials at all possible 
-    // integration points
-    info("Precalculating Legendre polynomials...");
-    precalculate_legendre_1d();
-    precalculate_legendre_1d_left();
-    precalculate_legendre_1d_right();
-
-    info("Precalculating Lobatto shape functions...");
-    precalculate_lobatto_1d();
-    precalculate_lobatto_1d_left();
-    precalculate_lobatto_1d_right();
-    _precalculated = 1;
-  }
+  precalculate_tables();
 }
 
 // process volumetric weak forms
@@ -285,9 +270,18 @@ void DiscreteProblem::assemble(scalar *coeff_vec, SparseMatrix *mat, Vector *rhs
   {
     mat->free();
     mat->prealloc(ndof);
-    for(int i = 0; i < ndof; i++)
-      for(int j = 0; j< ndof; j++)
-        mat->pre_add_ij(i, j);
+    // all equations are coupled within an element, the elements only through shared DOFs
+    Iterator *I = new Iterator(space);
+    Element *e;
+    int dofs[MAX_EQN_NUM * (MAX_P + 1)];
+    while ((e = I->next_active_element()) != NULL) {
+      int n = 0;
+      for(int c = 0; c < n_eq; c++)
+        for(int i = 0; i < e->p + 1; i++)
+          dofs[n++] = e->dof[c][i];
+      mat->pre_add_block(n, n, dofs, dofs);
+    }
+    delete I;
     mat->alloc();
     // Zero the matrix, which should be done by the appropriate implementation anyway.
     mat->zero();
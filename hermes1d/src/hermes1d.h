@@ -19,6 +19,7 @@
 #include "quad_std.h"
 #include "legendre.h"
 #include "lobatto.h"
+#include "precalc.h"
 #include "discrete_problem.h"
 #include "solution.h"
 #include "linearizer.h"
@@ -5,12 +5,18 @@
 
 #include "legendre.h"
 
-double legendre_val_ref_tab[MAX_QUAD_ORDER][MAX_QUAD_PTS_NUM][MAX_P + 1];
-double legendre_der_ref_tab[MAX_QUAD_ORDER][MAX_QUAD_PTS_NUM][MAX_P + 1];
-double legendre_val_ref_tab_left[MAX_QUAD_ORDER][MAX_QUAD_PTS_NUM][MAX_P + 1];
-double legendre_der_ref_tab_left[MAX_QUAD_ORDER][MAX_QUAD_PTS_NUM][MAX_P + 1];
-double legendre_val_ref_tab_right[MAX_QUAD_ORDER][MAX_QUAD_PTS_NUM][MAX_P + 1];
-double legendre_der_ref_tab_right[MAX_QUAD_ORDER][MAX_QUAD_PTS_NUM][MAX_P + 1];
+static double legendre_val_ref_tab_data[MAX_QUAD_ORDER][MAX_QUAD_PTS_NUM][MAX_P + 1];
+double (*legendre_val_ref_tab)[MAX_QUAD_PTS_NUM][MAX_P + 1] = legendre_val_ref_tab_data;
+static double legendre_der_ref_tab_data[MAX_QUAD_ORDER][MAX_QUAD_PTS_NUM][MAX_P + 1];
+double (*legendre_der_ref_tab)[MAX_QUAD_PTS_NUM][MAX_P + 1] = legendre_der_ref_tab_data;
+static double legendre_val_ref_tab_left_data[MAX_QUAD_ORDER][MAX_QUAD_PTS_NUM][MAX_P + 1];
+double (*legendre_val_ref_tab_left)[MAX_QUAD_PTS_NUM][MAX_P + 1] = legendre_val_ref_tab_left_data;
+static double legendre_der_ref_tab_left_data[MAX_QUAD_ORDER][MAX_QUAD_PTS_NUM][MAX_P + 1];
+double (*legendre_der_ref_tab_left)[MAX_QUAD_PTS_NUM][MAX_P + 1] = legendre_der_ref_tab_left_data;
+static double legendre_val_ref_tab_right_data[MAX_QUAD_ORDER][MAX_QUAD_PTS_NUM][MAX_P + 1];
+double (*legendre_val_ref_tab_right)[MAX_QUAD_PTS_NUM][MAX_P + 1] = legendre_val_ref_tab_right_data;
+static double legendre_der_ref_tab_right_data[MAX_QUAD_ORDER][MAX_QUAD_PTS_NUM][MAX_P + 1];
+double (*legendre_der_ref_tab_right)[MAX_QUAD_PTS_NUM][MAX_P + 1] = legendre_der_ref_tab_right_data;
 
 int legendre_order_1d[] = {
 0,
@@ -186,6 +192,10 @@ void legendre_der_phys_quad(int flag, int quad_order, int fns_num,
 // Legendre polynomials in (-1, 1)
 void precalculate_legendre_1d() 
 {
+  // the tables may point into a file of map_precalculated_tables()
+  legendre_val_ref_tab = legendre_val_ref_tab_data;
+  legendre_der_ref_tab = legendre_der_ref_tab_data;
+
   // erasing
   for (int quad_order=0; quad_order < MAX_QUAD_ORDER; quad_order++) {
     for (int point_id=0; point_id < MAX_QUAD_PTS_NUM; point_id++) {
@@ -210,6 +220,10 @@ void precalculate_legendre_1d()
 // half polynomials in (-1, 0)
 void precalculate_legendre_1d_left() 
 {
+  // the tables may point into a file of map_precalculated_tables()
+  legendre_val_ref_tab_left = legendre_val_ref_tab_left_data;
+  legendre_der_ref_tab_left = legendre_der_ref_tab_left_data;
+
   // erasing
   for (int quad_order=0; quad_order < MAX_QUAD_ORDER; quad_order++) {
     for (int point_id=0; point_id < MAX_QUAD_PTS_NUM; point_id++) {
@@ -235,6 +249,10 @@ void precalculate_legendre_1d_left()
 // half polynomials in (0, 1)
 void precalculate_legendre_1d_right() 
 {
+  // the tables may point into a file of map_precalculated_tables()
+  legendre_val_ref_tab_right = legendre_val_ref_tab_right_data;
+  legendre_der_ref_tab_right = legendre_der_ref_tab_right_data;
+
   // erasing
   for (int quad_order=0; quad_order < MAX_QUAD_ORDER; quad_order++) {
     for (int point_id=0; point_id < MAX_QUAD_PTS_NUM; point_id++) {
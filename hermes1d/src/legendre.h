@@ -26,9 +26,11 @@ extern int HERMES_API legendre_order_1d[];
 // interval (-1, 1). The first index runs through Gauss quadrature 
 // orders. The second index runs through the quadrature points of 
 // the corresponding rule, and the third through the values of 
-// Lobatto polynomials at that point. 
-extern double HERMES_API legendre_val_ref_tab[MAX_QUAD_ORDER][MAX_QUAD_PTS_NUM][MAX_P + 1];
-extern double HERMES_API legendre_der_ref_tab[MAX_QUAD_ORDER][MAX_QUAD_PTS_NUM][MAX_P + 1];
+// Lobatto polynomials at that point. The tables below are filled by
+// the precalculate_*() functions or point into a file mapped by
+// map_precalculated_tables() (see precalc.h).
+extern double HERMES_API (*legendre_val_ref_tab)[MAX_QUAD_PTS_NUM][MAX_P + 1];
+extern double HERMES_API (*legendre_der_ref_tab)[MAX_QUAD_PTS_NUM][MAX_P + 1];
 extern void HERMES_API precalculate_legendre_1d();
 
 // Precalculated values of Legendre polynomials and their derivatives 
@@ -38,8 +40,8 @@ extern void HERMES_API precalculate_legendre_1d();
 // orders. The second index runs through the quadrature points of 
 // the corresponding rule, and the third through the values of 
 // Lobatto polynomials at that point. 
-extern double HERMES_API legendre_val_ref_tab_left[MAX_QUAD_ORDER][MAX_QUAD_PTS_NUM][MAX_P + 1];
-extern double HERMES_API legendre_der_ref_tab_left[MAX_QUAD_ORDER][MAX_QUAD_PTS_NUM][MAX_P + 1];
+extern double HERMES_API (*legendre_val_ref_tab_left)[MAX_QUAD_PTS_NUM][MAX_P + 1];
+extern double HERMES_API (*legendre_der_ref_tab_left)[MAX_QUAD_PTS_NUM][MAX_P + 1];
 extern void HERMES_API precalculate_legendre_1d_left();
 
 // Precalculated values of Legendre polynomials and their derivatives 
@@ -49,8 +51,8 @@ extern void HERMES_API precalculate_legendre_1d_left();
 // orders. The second index runs through the quadrature points of 
 // the corresponding rule, and the third through the values of 
 // Lobatto polynomials at that point. 
-extern double HERMES_API legendre_val_ref_tab_right[MAX_QUAD_ORDER][MAX_QUAD_PTS_NUM][MAX_P + 1];
-extern double HERMES_API legendre_der_ref_tab_right[MAX_QUAD_ORDER][MAX_QUAD_PTS_NUM][MAX_P + 1];
+extern double HERMES_API (*legendre_val_ref_tab_right)[MAX_QUAD_PTS_NUM][MAX_P + 1];
+extern double HERMES_API (*legendre_der_ref_tab_right)[MAX_QUAD_PTS_NUM][MAX_P + 1];
 extern void HERMES_API precalculate_legendre_1d_right();
 
 // transforms point 'x_phys' from element (x1, x2) to (-1, 1)
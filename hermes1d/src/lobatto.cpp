@@ -6,12 +6,18 @@
 #include "lobatto.h"
 #include "legendre.h"
 
-double lobatto_val_ref_tab[MAX_QUAD_ORDER][MAX_QUAD_PTS_NUM][MAX_P + 1];
-double lobatto_der_ref_tab[MAX_QUAD_ORDER][MAX_QUAD_PTS_NUM][MAX_P + 1];
-double lobatto_val_ref_tab_left[MAX_QUAD_ORDER][MAX_QUAD_PTS_NUM][MAX_P + 1];
-double lobatto_der_ref_tab_left[MAX_QUAD_ORDER][MAX_QUAD_PTS_NUM][MAX_P + 1];
-double lobatto_val_ref_tab_right[MAX_QUAD_ORDER][MAX_QUAD_PTS_NUM][MAX_P + 1];
-double lobatto_der_ref_tab_right[MAX_QUAD_ORDER][MAX_QUAD_PTS_NUM][MAX_P + 1];
+static double lobatto_val_ref_tab_data[MAX_QUAD_ORDER][MAX_QUAD_PTS_NUM][MAX_P + 1];
+double (*lobatto_val_ref_tab)[MAX_QUAD_PTS_NUM][MAX_P + 1] = lobatto_val_ref_tab_data;
+static double lobatto_der_ref_tab_data[MAX_QUAD_ORDER][MAX_QUAD_PTS_NUM][MAX_P + 1];
+double (*lobatto_der_ref_tab)[MAX_QUAD_PTS_NUM][MAX_P + 1] = lobatto_der_ref_tab_data;
+static double lobatto_val_ref_tab_left_data[MAX_QUAD_ORDER][MAX_QUAD_PTS_NUM][MAX_P + 1];
+double (*lobatto_val_ref_tab_left)[MAX_QUAD_PTS_NUM][MAX_P + 1] = lobatto_val_ref_tab_left_data;
+static double lobatto_der_ref_tab_left_data[MAX_QUAD_ORDER][MAX_QUAD_PTS_NUM][MAX_P + 1];
+double (*lobatto_der_ref_tab_left)[MAX_QUAD_PTS_NUM][MAX_P + 1] = lobatto_der_ref_tab_left_data;
+static double lobatto_val_ref_tab_right_data[MAX_QUAD_ORDER][MAX_QUAD_PTS_NUM][MAX_P + 1];
+double (*lobatto_val_ref_tab_right)[MAX_QUAD_PTS_NUM][MAX_P + 1] = lobatto_val_ref_tab_right_data;
+static double lobatto_der_ref_tab_right_data[MAX_QUAD_ORDER][MAX_QUAD_PTS_NUM][MAX_P + 1];
+double (*lobatto_der_ref_tab_right)[MAX_QUAD_PTS_NUM][MAX_P + 1] = lobatto_der_ref_tab_right_data;
 
 int lobatto_order_1d[] = {
 1,
@@ -98,6 +104,10 @@ extern double lobatto_der_ref(double x, int n)
 // integrated Legendre polynomials in (-1, 1)
 void precalculate_lobatto_1d() 
 {
+  // the tables may point into a file of map_precalculated_tables()
+  lobatto_val_ref_tab = lobatto_val_ref_tab_data;
+  lobatto_der_ref_tab = lobatto_der_ref_tab_data;
+
   // erasing
   for (int quad_order=0; quad_order < MAX_QUAD_ORDER; quad_order++) {
     for (int point_id=0; point_id < MAX_QUAD_PTS_NUM; point_id++) {
@@ -121,6 +131,10 @@ void precalculate_lobatto_1d()
 // half-polynomials in (-1, 0)
 void precalculate_lobatto_1d_left() 
 {
+  // the tables may point into a file of map_precalculated_tables()
+  lobatto_val_ref_tab_left = lobatto_val_ref_tab_left_data;
+  lobatto_der_ref_tab_left = lobatto_der_ref_tab_left_data;
+
   // erasing
   for (int quad_order=0; quad_order < MAX_QUAD_ORDER; quad_order++) {
     for (int point_id=0; point_id < MAX_QUAD_PTS_NUM; point_id++) {
@@ -146,6 +160,10 @@ void precalculate_lobatto_1d_left()
 // half-polynomials in (0, 1)
 void precalculate_lobatto_1d_right() 
 {
+  // the tables may point into a file of map_precalculated_tables()
+  lobatto_val_ref_tab_right = lobatto_val_ref_tab_right_data;
+  lobatto_der_ref_tab_right = lobatto_der_ref_tab_right_data;
+
   // erasing
   for (int quad_order=0; quad_order < MAX_QUAD_ORDER; quad_order++) {
     for (int point_id=0; point_id < MAX_QUAD_PTS_NUM; point_id++) {
@@ -25,9 +25,11 @@ extern int HERMES_API lobatto_order_1d[];
 // The first index runs through Gauss quadrature 
 // orders. The second index runs through the quadrature points of 
 // the corresponding rule, and the third through the values of 
-// Legendre polynomials at that point. 
-extern double HERMES_API lobatto_val_ref_tab[MAX_QUAD_ORDER][MAX_QUAD_PTS_NUM][MAX_P + 1];
-extern double HERMES_API lobatto_der_ref_tab[MAX_QUAD_ORDER][MAX_QUAD_PTS_NUM][MAX_P + 1];
+// Legendre polynomials at that point. The tables below are filled by
+// the precalculate_*() functions or point into a file mapped by
+// map_precalculated_tables() (see precalc.h).
+extern double HERMES_API (*lobatto_val_ref_tab)[MAX_QUAD_PTS_NUM][MAX_P + 1];
+extern double HERMES_API (*lobatto_der_ref_tab)[MAX_QUAD_PTS_NUM][MAX_P + 1];
 extern void HERMES_API precalculate_lobatto_1d();
 
 // The first index runs through Gauss quadrature 
@@ -37,8 +39,8 @@ extern void HERMES_API precalculate_lobatto_1d();
 // The second index runs through the quadrature points of 
 // the corresponding rule, and the third through the values of 
 // Legendre polynomials at that point. 
-extern double HERMES_API lobatto_val_ref_tab_left[MAX_QUAD_ORDER][MAX_QUAD_PTS_NUM][MAX_P + 1];
-extern double HERMES_API lobatto_der_ref_tab_left[MAX_QUAD_ORDER][MAX_QUAD_PTS_NUM][MAX_P + 1];
+extern double HERMES_API (*lobatto_val_ref_tab_left)[MAX_QUAD_PTS_NUM][MAX_P + 1];
+extern double HERMES_API (*lobatto_der_ref_tab_left)[MAX_QUAD_PTS_NUM][MAX_P + 1];
 extern void HERMES_API precalculate_lobatto_1d_left();
 
 // Precalculated values of Lobatto polynomials and their derivatives 
@@ -48,8 +50,8 @@ extern void HERMES_API precalculate_lobatto_1d_left();
 // orders. The second index runs through the quadrature points of 
 // the corresponding rule, and the third through the values of 
 // Legendre polynomials at that point. 
-extern double HERMES_API lobatto_val_ref_tab_right[MAX_QUAD_ORDER][MAX_QUAD_PTS_NUM][MAX_P + 1];
-extern double HERMES_API lobatto_der_ref_tab_right[MAX_QUAD_ORDER][MAX_QUAD_PTS_NUM][MAX_P + 1];
+extern double HERMES_API (*lobatto_val_ref_tab_right)[MAX_QUAD_PTS_NUM][MAX_P + 1];
+extern double HERMES_API (*lobatto_der_ref_tab_right)[MAX_QUAD_PTS_NUM][MAX_P + 1];
 extern void HERMES_API precalculate_lobatto_1d_right();
 
 #endif /* SHAPESET_LOBATTO_H_ */
@@ -0,0 +1,170 @@
+// Copyright (c) 2009 hp-FEM group at the University of Nevada, Reno (UNR).
+// Distributed under the terms of the BSD license (see the LICENSE
+// file for the exact terms).
+// Email: hermes1d@googlegroups.com, home page: http://hpfem.org/
+
+#include "precalc.h"
+#include "legendre.h"
+#include "lobatto.h"
+#ifndef _MSC_VER
+  #include <fcntl.h>
+  #include <unistd.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+#endif
+
+typedef double (*Table)[MAX_QUAD_PTS_NUM][MAX_P + 1];
+
+// The file of save_precalculated_tables(): the header followed by
+// the tables in the order of get_tables().
+static const char TABLES_MAGIC[8] = "H1DTAB";
+static const int TABLES_VERSION = 1;
+static const int NUM_TABLES = 12;
+
+struct TablesFileHeader
+{
+  char magic[8];
+  int version;
+  int byte_order;          // 0x01020304 as written by the saving machine
+  int sizeof_double;
+  int max_p;
+  int max_quad_order;
+  int max_quad_pts_num;
+  int num_tables;
+  int padding;
+  uint64_t quad_checksum;  // of the points of g_quad_1d_std
+  uint64_t size;           // of the whole file
+};
+
+static const uint64_t TABLE_SIZE = sizeof(double) * MAX_QUAD_ORDER * MAX_QUAD_PTS_NUM * (MAX_P + 1);
+
+static bool tables_ready = false;
+
+static Table* get_tables(int i)
+{
+  static Table* tables[NUM_TABLES] = {
+    &legendre_val_ref_tab, &legendre_der_ref_tab,
+    &legendre_val_ref_tab_left, &legendre_der_ref_tab_left,
+    &legendre_val_ref_tab_right, &legendre_der_ref_tab_right,
+    &lobatto_val_ref_tab, &lobatto_der_ref_tab,
+    &lobatto_val_ref_tab_left, &lobatto_der_ref_tab_left,
+    &lobatto_val_ref_tab_right, &lobatto_der_ref_tab_right
+  };
+  return tables[i];
+}
+
+// FNV-1a hash of the quadrature points, the tables are only valid
+// for the points they were calculated at
+static uint64_t get_quad_checksum()
+{
+  uint64_t hash = 14695981039346656037ULL;
+  for (int quad_order=0; quad_order < MAX_QUAD_ORDER; quad_order++) {
+    int pts_num = g_quad_1d_std.get_num_points(quad_order);
+    const unsigned char* p = (const unsigned char*) g_quad_1d_std.get_points(quad_order);
+    for (unsigned i=0; i < pts_num * sizeof(double2); i++) {
+      hash ^= p[i];
+      hash *= 1099511628211ULL;
+    }
+    hash ^= pts_num;
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+static void fill_header(TablesFileHeader* hdr)
+{
+  memset(hdr, 0, sizeof(TablesFileHeader));
+  memcpy(hdr->magic, TABLES_MAGIC, sizeof(hdr->magic));
+  hdr->version = TABLES_VERSION;
+  hdr->byte_order = 0x01020304;
+  hdr->sizeof_double = sizeof(double);
+  hdr->max_p = MAX_P;
+  hdr->max_quad_order = MAX_QUAD_ORDER;
+  hdr->max_quad_pts_num = MAX_QUAD_PTS_NUM;
+  hdr->num_tables = NUM_TABLES;
+  hdr->quad_checksum = get_quad_checksum();
+  hdr->size = sizeof(TablesFileHeader) + NUM_TABLES * TABLE_SIZE;
+}
+
+void precalculate_tables()
+{
+  if (tables_ready) return;
+
+  // precalculating values and derivatives 
+  // of all polynomials at all possible 
+  // integration points
+  info("Precalculating Legendre polynomials...");
+  precalculate_legendre_1d();
+  precalculate_legendre_1d_left();
+  precalculate_legendre_1d_right();
+
+  info("Precalculating Lobatto shape functions...");
+  precalculate_lobatto_1d();
+  precalculate_lobatto_1d_left();
+  precalculate_lobatto_1d_right();
+  tables_ready = true;
+}
+
+void save_precalculated_tables(const char* filename)
+{
+  precalculate_tables();
+
+  TablesFileHeader hdr;
+  fill_header(&hdr);
+  FILE* f = fopen(filename, "wb");
+  if (f == NULL) error("Could not open %s for writing.", filename);
+  bool ok = fwrite(&hdr, sizeof(hdr), 1, f) == 1;
+  for (int i=0; i < NUM_TABLES && ok; i++)
+    ok = fwrite(*get_tables(i), 1, TABLE_SIZE, f) == TABLE_SIZE;
+  if (fclose(f) != 0 || !ok) error("Could not write %s.", filename);
+}
+
+bool map_precalculated_tables(const char* filename)
+{
+  // the file is never unmapped, the tables point into it
+  const char* base = NULL;
+  uint64_t size = 0;
+#ifndef _MSC_VER
+  int fd = open(filename, O_RDONLY);
+  if (fd < 0) { warn("Could not open %s.", filename); return false; }
+  struct stat st;
+  if (fstat(fd, &st) == 0 && st.st_size >= (off_t) sizeof(TablesFileHeader)) {
+    size = st.st_size;
+    void* p = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (p != MAP_FAILED) base = (const char*) p;
+  }
+  close(fd);
+#else
+  // no mmap(): read the file, it is not shared between processes then
+  FILE* f = fopen(filename, "rb");
+  if (f == NULL) { warn("Could not open %s.", filename); return false; }
+  fseek(f, 0, SEEK_END);
+  long len = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  if (len >= (long) sizeof(TablesFileHeader)) {
+    size = len;
+    char* p = (char*) malloc(size);
+    if (p != NULL && fread(p, 1, size, f) == size) base = p;
+    else ::free(p);
+  }
+  fclose(f);
+#endif
+
+  TablesFileHeader hdr;
+  fill_header(&hdr);
+  if (base == NULL || size != hdr.size || memcmp(base, &hdr, sizeof(hdr))) {
+    warn("%s is not a valid file of precalculated tables.", filename);
+    if (base != NULL)
+#ifndef _MSC_VER
+      munmap((void*) base, size);
+#else
+      ::free((void*) base);
+#endif
+    return false;
+  }
+
+  for (int i=0; i < NUM_TABLES; i++)
+    *get_tables(i) = (Table) (base + sizeof(TablesFileHeader) + i * TABLE_SIZE);
+  tables_ready = true;
+  return true;
+}
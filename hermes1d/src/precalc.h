@@ -0,0 +1,28 @@
+// Copyright (c) 2009 hp-FEM group at the University of Nevada, Reno (UNR).
+// Distributed under the terms of the BSD license (see the LICENSE
+// file for the exact terms).
+// Email: hermes1d@googlegroups.com, home page: http://hpfem.org/
+
+#ifndef __HERMES1D_PRECALC_H
+#define __HERMES1D_PRECALC_H
+
+#include "../../hermes_common/common.h"
+
+// Fills all tables of Legendre polynomials and Lobatto shape
+// functions (legendre.h, lobatto.h), unless this was done already
+// or the tables were mapped by map_precalculated_tables().
+void HERMES_API precalculate_tables();
+
+// Writes all tables of Legendre polynomials and Lobatto shape
+// functions to a binary file, to be used by map_precalculated_tables().
+void HERMES_API save_precalculated_tables(const char* filename);
+
+// Maps a file written by save_precalculated_tables() read-only into
+// memory and lets the tables point into it, so that they are not
+// calculated and all processes using the file share its pages. The
+// file stays mapped until the program exits. Returns false (with a
+// warning) if the file cannot be used, e.g. if it was written by a
+// different version or on a different machine.
+bool HERMES_API map_precalculated_tables(const char* filename);
+
+#endif
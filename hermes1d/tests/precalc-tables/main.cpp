@@ -0,0 +1,170 @@
+#define HERMES_REPORT_WARN
+#define HERMES_REPORT_INFO
+#define HERMES_REPORT_VERBOSE
+#define HERMES_REPORT_FILE "application.log"
+#include "hermes1d.h"
+
+// This test makes sure that the tables of Legendre 
+// polynomials and Lobatto shape functions written by 
+// save_precalculated_tables() and mapped by 
+// map_precalculated_tables() are bit for bit the 
+// calculated ones, and so are the Jacobian matrix and 
+// the residual vector assembled with them. Files that 
+// are missing or are not table files must be rejected.
+
+#define ERROR_SUCCESS                               0
+#define ERROR_FAILURE                               -1
+
+static int NEQ = 1;
+int NELEM = 5;                          // Number of elements.
+double A = -1, B = 1;                   // Domain end points.
+int P_INIT = 12;                        // Initial polynomial degree.
+
+MatrixSolverType matrix_solver = SOLVER_UMFPACK;  // Possibilities: SOLVER_AMESOS, SOLVER_MUMPS, SOLVER_NOX, 
+                                                  // SOLVER_PARDISO, SOLVER_PETSC, SOLVER_UMFPACK.
+
+// Boundary conditions.
+Tuple<BCSpec *>DIR_BC_LEFT =  Tuple<BCSpec *>(new BCSpec(0,1));
+Tuple<BCSpec *>DIR_BC_RIGHT = Tuple<BCSpec *>(new BCSpec(0,2));
+
+// Jacobian matrix and residual vector of the nonlinear 
+// problem -(u'(1 + u^2))' = f.
+double jacobian(int num, double *x, double *weights, 
+                double *u, double *dudx, double *v, double *dvdx, 
+                double u_prev[MAX_SLN_NUM][MAX_EQN_NUM][MAX_QUAD_PTS_NUM], 
+                double du_prevdx[MAX_SLN_NUM][MAX_EQN_NUM][MAX_QUAD_PTS_NUM], 
+                void *user_data)
+{
+  double val = 0;
+  for(int i = 0; i<num; i++) {
+    val += (2*u_prev[0][0][i]*u[i]*du_prevdx[0][0][i]*dvdx[i]
+            + (1 + u_prev[0][0][i]*u_prev[0][0][i])*dudx[i]*dvdx[i])*weights[i];
+  }
+  return val;
+};
+
+double residual(int num, double *x, double *weights, 
+                double u_prev[MAX_SLN_NUM][MAX_EQN_NUM][MAX_QUAD_PTS_NUM], 
+                double du_prevdx[MAX_SLN_NUM][MAX_EQN_NUM][MAX_QUAD_PTS_NUM],  
+                double *v, double *dvdx, void *user_data)
+{
+  double val = 0;
+  for(int i = 0; i<num; i++) {
+    val += ((1 + u_prev[0][0][i]*u_prev[0][0][i])*du_prevdx[0][0][i]*dvdx[i]
+            - (x[i] + 2)*v[i])*weights[i];
+  }
+  return val;
+};
+
+// Assembles the Jacobian matrix and the residual vector, 
+// returns them as dense arrays.
+void assemble(WeakForm* wf, Space* space, double* coeff_vec, 
+              double* mat_vals, double* rhs_vals)
+{
+  int ndof = Space::get_num_dofs(space);
+  DiscreteProblem dp(wf, space, false);
+  SparseMatrix* mat = create_matrix(matrix_solver);
+  Vector* rhs = create_vector(matrix_solver);
+  dp.assemble(coeff_vec, mat, rhs);
+  for (int i=0; i < ndof; i++) {
+    rhs_vals[i] = rhs->get(i);
+    for (int j=0; j < ndof; j++) mat_vals[i*ndof + j] = mat->get(i, j);
+  }
+  delete mat;
+  delete rhs;
+}
+
+typedef double (*Table)[MAX_QUAD_PTS_NUM][MAX_P + 1];
+
+// All tables of legendre.h and lobatto.h.
+Table get_table(int i)
+{
+  Table tables[] = {
+    legendre_val_ref_tab, legendre_der_ref_tab,
+    legendre_val_ref_tab_left, legendre_der_ref_tab_left,
+    legendre_val_ref_tab_right, legendre_der_ref_tab_right,
+    lobatto_val_ref_tab, lobatto_der_ref_tab,
+    lobatto_val_ref_tab_left, lobatto_der_ref_tab_left,
+    lobatto_val_ref_tab_right, lobatto_der_ref_tab_right
+  };
+  return tables[i];
+}
+const int NUM_TABLES = 12;
+const size_t TABLE_SIZE = sizeof(double) * MAX_QUAD_ORDER * MAX_QUAD_PTS_NUM * (MAX_P + 1);
+
+int main() {
+  // Create the space, the weak formulation and a coefficient vector.
+  Space* space = new Space(A, B, NELEM, DIR_BC_LEFT, DIR_BC_RIGHT, P_INIT, NEQ, NEQ);
+  int ndof = Space::get_num_dofs(space);
+  info("N_dof = %d.", ndof);
+  WeakForm wf;
+  wf.add_matrix_form(jacobian);
+  wf.add_vector_form(residual);
+  double *coeff_vec = new double[ndof];
+  for (int i=0; i < ndof; i++) coeff_vec[i] = 0.5 + 0.3*sin(0.37*i);
+
+  // Assemble with the calculated tables.
+  double *mat_ref = new double[ndof*ndof], *rhs_ref = new double[ndof];
+  assemble(&wf, space, coeff_vec, mat_ref, rhs_ref);
+  Table calculated[NUM_TABLES];
+  for (int i=0; i < NUM_TABLES; i++) calculated[i] = get_table(i);
+
+  // Write the table file and a file that is not a table file.
+  save_precalculated_tables("tables.dat");
+  FILE* f = fopen("bad.dat", "wb");
+  if (f == NULL) error("Cannot create bad.dat.");
+  for (int i=0; i < 100; i++) fprintf(f, "not a table file ");
+  fclose(f);
+
+  bool success = true;
+  if (map_precalculated_tables("bad.dat") || map_precalculated_tables("missing.dat")) {
+    info("An invalid file was mapped.");
+    success = false;
+  }
+  if (!map_precalculated_tables("tables.dat")) {
+    info("The table file could not be mapped.");
+    success = false;
+  }
+
+  // The tables have to point into the file and be identical.
+  for (int i=0; i < NUM_TABLES; i++) {
+    if (get_table(i) == calculated[i] || memcmp(get_table(i), calculated[i], TABLE_SIZE)) {
+      info("Table %d is not mapped or differs.", i);
+      success = false;
+    }
+  }
+
+  // Assemble again, now with the mapped tables.
+  double *mat = new double[ndof*ndof], *rhs = new double[ndof];
+  assemble(&wf, space, coeff_vec, mat, rhs);
+  if (memcmp(mat, mat_ref, ndof*ndof*sizeof(double)) || memcmp(rhs, rhs_ref, ndof*sizeof(double))) {
+    info("The assembled matrix or vector differs.");
+    success = false;
+  }
+
+  // Recalculating the tables has to switch back from the file.
+  Table mapped = lobatto_val_ref_tab;
+  precalculate_lobatto_1d();
+  if (lobatto_val_ref_tab != calculated[6] || memcmp(lobatto_val_ref_tab, mapped, TABLE_SIZE)) {
+    info("The recalculated table is not the calculated one.");
+    success = false;
+  }
+
+  remove("tables.dat");
+  remove("bad.dat");
+  delete [] coeff_vec;
+  delete [] mat_ref;
+  delete [] rhs_ref;
+  delete [] mat;
+  delete [] rhs;
+  delete space;
+
+  if (success) {
+    info("Success!");
+    return ERROR_SUCCESS;
+  }
+  else {
+    info("Failure!");
+    return ERROR_FAILURE;
+  }
+}
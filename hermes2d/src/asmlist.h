@@ -59,6 +59,16 @@ public:
     coef[cnt++] = c;
   }
 
+  /// Replaces the list by 'n' triples stored in separate arrays.
+  void copy(int n, const int* idx, const int* dof, const scalar* coef)
+  {
+    while (cap < n) enlarge();
+    memcpy(this->idx, idx, sizeof(int) * n);
+    memcpy(this->dof, dof, sizeof(int) * n);
+    memcpy(this->coef, coef, sizeof(scalar) * n);
+    cnt = n;
+  }
+
 protected:
 
   // this is the only non-inline method; defined in space.cpp
@@ -20,9 +20,85 @@
 #include "space/space.h"
 #include "precalc.h"
 #include "../../hermes_common/matrix.h"
+#include "../../hermes_common/solver/precond_native.h"
+#include "../../hermes_common/solver/umfpack_solver.h"
 #include "refmap.h"
 #include "solution.h"
 #include "config.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// Contributions of the states assembled by a worker of the parallel assembly. They are kept
+// until one thread adds them to the matrix and the right-hand sides in the order of the
+// traversal (see DiscreteProblem::assemble_parallel()).
+struct AsmBuffer
+{
+  std::vector<int> ints;        ///< kinds, sizes and indices of the contributions
+  std::vector<scalar> vals;     ///< their values
+  std::vector<void*> ptrs;      ///< scatter maps (blocks) or right-hand sides (vectors)
+  std::vector<size_t> ends;     ///< ends of the states in 'ints'
+  size_t next, pi, pv, pp;      ///< the next state to add and its positions
+
+  enum { BLOCK, VECTOR };
+
+  AsmBuffer() { clear(); }
+
+  void clear()
+  {
+    ints.clear(); vals.clear(); ptrs.clear(); ends.clear();
+    next = pi = pv = pp = 0;
+  }
+
+  void add_block(int m, int n, scalar** block, int* rows, int* cols, int* map)
+  {
+    ints.push_back(BLOCK); ints.push_back(m); ints.push_back(n);
+    ints.insert(ints.end(), rows, rows + m);
+    ints.insert(ints.end(), cols, cols + n);
+    for (int i = 0; i < m; i++)
+      vals.insert(vals.end(), block[i], block[i] + n);
+    ptrs.push_back(map);
+  }
+
+  void add_vector(Vector** rhs, int nrhs, int idx, scalar val)
+  {
+    ints.push_back(VECTOR); ints.push_back(nrhs); ints.push_back(idx);
+    vals.push_back(val);
+    ptrs.push_back(rhs);
+  }
+
+  void end_state() { ends.push_back(ints.size()); }
+
+  // Adds the contributions of the next state.
+  void flush_state(SparseMatrix* mat)
+  {
+    assert(next < ends.size());
+    std::vector<scalar*> block;
+    while (pi < ends[next])
+    {
+      int kind = ints[pi], m = ints[pi + 1], n = ints[pi + 2];
+      pi += 3;
+      if (kind == BLOCK)
+      {
+        block.resize(m);
+        for (int i = 0; i < m; i++) block[i] = &vals[pv + i * n];
+        int* map = (int*) ptrs[pp++];
+        if (map != NULL) mat->add_block_with_map(m, n, &block[0], map);
+        else mat->add(m, n, &block[0], &ints[pi], &ints[pi + m]);
+        pi += m + n;
+        pv += m * n;
+      }
+      else
+      {
+        Vector** rhs = (Vector**) ptrs[pp++];
+        for (int r = 0; r < m; r++)
+          rhs[r]->add(n, vals[pv]);
+        pv++;
+      }
+    }
+    next++;
+  }
+};
 
 DiscreteProblem::DiscreteProblem(WeakForm* wf, Tuple<Space *> spaces, bool is_linear)
 {
@@ -51,6 +127,29 @@ DiscreteProblem::DiscreteProblem(WeakForm* wf, Tuple<Space *> spaces, bool is_li
 
   have_matrix = false;
 
+  use_scatter_maps = false;
+  use_sym_storage = false;
+  use_interleaved_dofs = false;
+  scatter_mat = NULL;
+
+  use_parallel_assembly = false;
+  use_sum_factorization = false;
+  master = NULL;
+  asm_buffer = NULL;
+  matrix_free = false;
+  apply_x = apply_y = NULL;
+
+  order_cache_hits = order_cache_misses = 0;
+  fn_cache_stamp = 0;
+  fn_cache_reuses = fn_cache_updates = 0;
+
+  use_incremental = false;
+  incremental_max_changes = 0.5;
+  elem_cache_stamp = 0;
+  elem_cache_wf_seq = -1;
+  elem_cache_hits = elem_cache_misses = 0;
+  elem_entry = NULL;
+
   this->spaces = Tuple<Space *>();
   for (int i = 0; i < wf->neq; i++) this->spaces.push_back(spaces[i]);
   have_spaces = true;
@@ -72,10 +171,68 @@ DiscreteProblem::DiscreteProblem(WeakForm* wf, Tuple<Space *> spaces, bool is_li
   this->ndof = Space::assign_dofs(this->spaces);
 }
 
+DiscreteProblem::DiscreteProblem(DiscreteProblem* master)
+{
+  _F_
+  // the DOFs are numbered and the matrix is created by the master
+  this->wf = master->wf;
+  this->spaces = master->spaces;
+  this->is_linear = master->is_linear;
+  this->ndof = master->ndof;
+
+  sp_seq = new int[wf->neq];
+  memset(sp_seq, -1, sizeof(int) * wf->neq);
+  wf_seq = -1;
+
+  pss = new PrecalcShapeset*[wf->neq];
+  for (int i = 0; i < wf->neq; i++)
+    pss[i] = new PrecalcShapeset(spaces[i]->get_shapeset());
+  num_user_pss = wf->neq;
+
+  matrix_buffer = NULL;
+  matrix_buffer_dim = 0;
+
+  values_changed = true;
+  struct_changed = true;
+  have_spaces = true;
+  have_matrix = false;
+
+  use_scatter_maps = false;
+  use_sym_storage = false;
+  use_interleaved_dofs = false;
+  scatter_mat = NULL;
+
+  use_parallel_assembly = false;
+  use_sum_factorization = master->use_sum_factorization;
+  this->master = master;
+  asm_buffer = new AsmBuffer;
+  matrix_free = false;
+  apply_x = apply_y = NULL;
+
+  order_cache_hits = order_cache_misses = 0;
+  fn_cache_stamp = 0;
+  fn_cache_reuses = fn_cache_updates = 0;
+
+  use_incremental = false;
+  incremental_max_changes = 0.5;
+  elem_cache_stamp = 0;
+  elem_cache_wf_seq = -1;
+  elem_cache_hits = elem_cache_misses = 0;
+  elem_entry = NULL;
+}
+
 DiscreteProblem::~DiscreteProblem()
 {
   _F_
   free();
+  free_fn_cache();
+  free_ref_matrices();
+  if (master != NULL)
+  {
+    for (int i = 0; i < wf->neq; i++) delete pss[i];
+    if (matrix_buffer != NULL) delete [] matrix_buffer;
+    delete asm_buffer;
+  }
   if (sp_seq != NULL) delete [] sp_seq;
   if (pss != NULL) delete [] pss;
 }
@@ -86,6 +243,8 @@ void DiscreteProblem::free()
   struct_changed = values_changed = true;
   memset(sp_seq, -1, sizeof(int) * wf->neq);
   wf_seq = -1;
+  scatter_maps.free();
+  scatter_mat = NULL;
 }
 
 int DiscreteProblem::get_num_dofs()
@@ -97,6 +256,25 @@ int DiscreteProblem::get_num_dofs()
   return ndof;
 }
 
+void DiscreteProblem::set_interleaved_dofs(bool enable)
+{
+  _F_
+  use_interleaved_dofs = enable;
+  if (enable) this->ndof = Space::assign_dofs_interleaved(this->spaces);
+  else this->ndof = Space::assign_dofs(this->spaces);
+  // the spaces could not be interleaved (see Space::assign_dofs_interleaved())
+  if (enable && !Space::is_interleaved(this->spaces)) use_interleaved_dofs = false;
+  have_matrix = false;
+}
+
+void DiscreteProblem::set_incremental_assembly(bool enable, double max_changes)
+{
+  _F_
+  use_incremental = enable;
+  incremental_max_changes = max_changes;
+  elem_cache.clear();
+}
+
 scalar** DiscreteProblem::get_matrix_buffer(int n)
 {
   _F_
@@ -138,6 +316,14 @@ void DiscreteProblem::create(SparseMatrix* mat, Vector* rhs, bool rhsonly)
 {
   _F_
 
+  // the DOFs have been reassigned consecutively since set_interleaved_dofs()
+  if (use_interleaved_dofs && !Space::is_interleaved(spaces))
+  {
+    Space::assign_dofs_interleaved(spaces);
+    if (!Space::is_interleaved(spaces)) use_interleaved_dofs = false;
+    have_matrix = false;
+  }
+
   if (is_up_to_date())
   {
     if (!rhsonly && mat != NULL) 
@@ -150,11 +336,17 @@ void DiscreteProblem::create(SparseMatrix* mat, Vector* rhs, bool rhsonly)
   }
   
   int ndof = get_num_dofs();
+
+  // the scatter maps are bound to the old sparse structure
+  scatter_maps.free();
+  scatter_mat = NULL;
   
   if (mat != NULL)  // mat may be NULL when assembling the rhs for NOX
   {
     // spaces have changed: create the matrix from scratch
     mat->free();
+    if (!mat->set_symmetric_storage(use_sym_storage && wf->is_sym()))
+      verbose("The matrix does not support the symmetric storage.");
     mat->prealloc(ndof);
 
     AUTOLA_CL(AsmList, al, wf->neq);
@@ -175,7 +367,7 @@ void DiscreteProblem::create(SparseMatrix* mat, Vector* rhs, bool rhsonly)
       // obtain assembly lists for the element at all spaces
       for (int i = 0; i < wf->neq; i++)
       {
-        // TODO: do not get the assembly list again if the element was not changed
+        // the lists are kept by the spaces (see Space::get_element_assembly_list())
         if (e[i] != NULL) spaces[i]->get_element_assembly_list(e[i], &(al[i]));
       }
 
@@ -190,12 +382,8 @@ void DiscreteProblem::create(SparseMatrix* mat, Vector* rhs, bool rhsonly)
             AsmList *an = &(al[n]);
 
             // pretend assembling of the element stiffness matrix
-            // register nonzero elements
-            for (int i = 0; i < am->cnt; i++)
-              if (am->dof[i] >= 0)
-                for (int j = 0; j < an->cnt; j++)
-                  if (an->dof[j] >= 0)
-                    mat->pre_add_ij(am->dof[i], an->dof[j]);
+            // register nonzero elements (the whole block at once)
+            mat->pre_add_block(am->cnt, an->cnt, am->dof, an->dof);
           }
         }
       }
@@ -205,6 +393,8 @@ void DiscreteProblem::create(SparseMatrix* mat, Vector* rhs, bool rhsonly)
     delete [] blocks;
 
     mat->alloc();
+
+    if (use_scatter_maps) build_scatter_maps(mat);
   }
   
   // WARNING: unlike Matrix::alloc(), Vector::alloc(ndof) frees the memory occupied 
@@ -221,6 +411,130 @@ void DiscreteProblem::create(SparseMatrix* mat, Vector* rhs, bool rhsonly)
   have_matrix = true;
 }
 
+// Records the offsets of all local stiffness matrix blocks into the storage of 'mat', so
+// that assemble() can scatter the blocks without searching the sparse structure.
+void DiscreteProblem::build_scatter_maps(SparseMatrix* mat)
+{
+  _F_
+  AUTOLA_CL(AsmList, al, wf->neq);
+  AUTOLA_OR(Mesh*, meshes, wf->neq);
+  bool **blocks = wf->get_blocks();
+
+  for (int i = 0; i < wf->neq; i++)
+    meshes[i] = spaces[i]->get_mesh();
+
+  scatter_maps.init(wf->neq);
+  scatter_mat = mat;
+
+  Traverse trav;
+  trav.begin(wf->neq, meshes);
+
+  Element **e;
+  while ((e = trav.get_next_state(NULL, NULL)) != NULL)
+  {
+    for (int i = 0; i < wf->neq; i++)
+      if (e[i] != NULL) spaces[i]->get_element_assembly_list(e[i], &(al[i]));
+
+    for (int m = 0; m < wf->neq; m++)
+    {
+      for (int n = 0; n < wf->neq; n++)
+      {
+        if (!blocks[m][n] || e[m] == NULL || e[n] == NULL) continue;
+        // In multi-mesh problems, the same pair of elements is visited several times.
+        if (scatter_maps.get(m, n, e[m]->id, e[n]->id) != NULL) continue;
+
+        AsmList *am = &(al[m]);
+        AsmList *an = &(al[n]);
+        int *map = scatter_maps.add(m, n, e[m]->id, e[n]->id, am->cnt * an->cnt);
+        if (!mat->get_block_map(am->cnt, an->cnt, am->dof, an->dof, map))
+        {
+          // The matrix does not support scattering with maps.
+          scatter_maps.free();
+          scatter_mat = NULL;
+          trav.finish();
+          delete [] blocks;
+          return;
+        }
+      }
+    }
+  }
+
+  trav.finish();
+  delete [] blocks;
+
+  verbose("Scatter maps: %d kB.", scatter_maps.get_mem_size() / 1024);
+}
+
+// Returns the scatter map of the block (m, n) on the current elements (NULL if there is none).
+int* DiscreteProblem::get_scatter_map(SparseMatrix* mat, int m, int n, int* elem_id)
+{
+  if (master != NULL) return master->get_scatter_map(mat, m, n, elem_id);
+  if (mat != scatter_mat) return NULL;
+  return scatter_maps.get(m, n, elem_id[m], elem_id[n]);
+}
+
+void DiscreteProblem::get_element_blocks(BlockJacobiPrecond* pc)
+{
+  _F_
+  AsmList al;
+  pc->clear_blocks();
+  for (int i = 0; i < wf->neq; i++)
+  {
+    Element* e;
+    for_all_active_elements(e, spaces[i]->get_mesh())
+    {
+      spaces[i]->get_element_assembly_list(e, &al);
+      pc->add_block(al.cnt, al.dof);
+    }
+  }
+}
+
+void DiscreteProblem::get_p_levels(PMultigridPrecond* pc, int num_levels)
+{
+  _F_
+  pc->clear_levels();
+  int ndof = get_num_dofs();
+  bool* keep = new bool[ndof];
+  MEM_CHECK(keep);
+  int last = ndof;
+  AsmList al, cal;
+  for (int k = 1; k <= num_levels; k++)
+  {
+    memset(keep, 0, ndof * sizeof(bool));
+    for (int i = 0; i < wf->neq; i++)
+    {
+      // the shapesets are hierarchic: the lower order space has a subset of the basis
+      // functions, which are identified by their indices on the elements
+      Mesh* mesh = spaces[i]->get_mesh();
+      Space* coarse = spaces[i]->dup(mesh);
+      coarse->copy_orders(spaces[i], -k);
+      Element* e;
+      std::vector<int> cidx;
+      for_all_active_elements(e, mesh)
+      {
+        spaces[i]->get_element_assembly_list(e, &al);
+        coarse->get_element_assembly_list(e, &cal);
+        cidx.clear();
+        for (int j = 0; j < cal.cnt; j++)
+          if (cal.dof[j] >= 0) cidx.push_back(cal.idx[j]);
+        std::sort(cidx.begin(), cidx.end());
+        for (int j = 0; j < al.cnt; j++)
+          if (al.dof[j] >= 0 && std::binary_search(cidx.begin(), cidx.end(), al.idx[j]))
+            keep[al.dof[j]] = true;
+      }
+      delete coarse;
+    }
+
+    std::vector<int> dofs;
+    for (int j = 0; j < ndof; j++)
+      if (keep[j]) dofs.push_back(j);
+    if (dofs.empty() || (int) dofs.size() == last) break;
+    pc->add_level(dofs.size(), &dofs[0]);
+    last = dofs.size();
+  }
+  delete [] keep;
+}
+
 //// assembly //////////////////////////////////////////////////////////////////////////////////////
 
 // Light version for linear problems.
@@ -233,6 +547,16 @@ void DiscreteProblem::assemble(SparseMatrix* mat, Vector* rhs, bool rhsonly)
 // General assembling function for nonlinear problem. For linear problems use the 
 // light version above.
 void DiscreteProblem::assemble(scalar* coeff_vec, SparseMatrix* mat, Vector* rhs, bool rhsonly)
+{
+  _F_
+  assemble(coeff_vec, mat, rhs != NULL ? &rhs : NULL, rhs != NULL ? 1 : 0, rhsonly);
+}
+
+
+// General assembling function, several right-hand sides may be assembled in one traversal: 
+// every vector form is added to the right-hand side given by its index in the weak form 
+// (forms with an index >= nrhs are skipped).
+void DiscreteProblem::assemble(scalar* coeff_vec, SparseMatrix* mat, Vector** rhs, int nrhs, bool rhsonly)
 {
   /* BEGIN IDENTICAL CODE WITH H3D */
 
@@ -245,7 +569,13 @@ void DiscreteProblem::assemble(scalar* coeff_vec, SparseMatrix* mat, Vector* rhs
     if (this->spaces[i] == NULL) error("A space is NULL in assemble().");
   }
  
-  this->create(mat, rhs, rhsonly);
+  // the matrix-free products leave the sparse structure of the matrix as it is
+  if (!matrix_free) this->create(mat, nrhs > 0 ? rhs[0] : NULL, rhsonly);
+  for (int r = matrix_free ? 0 : 1; r < nrhs; r++)
+  {
+    if (rhs[r]->length() != get_num_dofs()) rhs[r]->alloc(get_num_dofs());
+    else rhs[r]->zero();
+  }
 
   // Convert the coefficient vector 'coeff_vec' into solutions Tuple 'u_ext'.
   Tuple<Solution*> u_ext;
@@ -262,17 +592,30 @@ void DiscreteProblem::assemble(scalar* coeff_vec, SparseMatrix* mat, Vector* rhs
  
   /* END IDENTICAL CODE WITH H3D */
 
+  // the 'ord' callbacks may depend on data changed between the assemblings
+  order_cache.clear();
+  order_cache_hits = order_cache_misses = 0;
+  fn_cache_reuses = fn_cache_updates = 0;
+  const_coefs.clear();
+
+  // the incremental assembly: the stored values belong to the weak form they were computed with
+  if (use_incremental)
+  {
+    if (wf->get_seq() != elem_cache_wf_seq) elem_cache.clear();
+    elem_cache_wf_seq = wf->get_seq();
+    elem_cache_stamp++;
+    elem_cache_limit = elem_cache.empty() ? -1 : (int) (incremental_max_changes * elem_cache.size());
+    elem_cache_dropped = false;
+  }
+  elem_cache_hits = elem_cache_misses = 0;
+
   bool bnd[4];			    // FIXME: magic number - maximal possible number of element surfaces
   SurfPos surf_pos[4];
   AUTOLA_CL(AsmList, al, wf->neq);
-  AUTOLA_OR(bool, nat, wf->neq);
-  AUTOLA_OR(bool, isempty, wf->neq);
-  AsmList *am, *an;
   reset_warn_order();
 
   // create slave pss's for test functions, init quadrature points
   AUTOLA_OR(PrecalcShapeset*, spss, wf->neq);
-  PrecalcShapeset *fu, *fv;
   AUTOLA_CL(RefMap, refmap, wf->neq);
   for (int i = 0; i < wf->neq; i++)
   {
@@ -285,7 +628,7 @@ void DiscreteProblem::assemble(scalar* coeff_vec, SparseMatrix* mat, Vector* rhs
   // initialize matrix buffer
   matrix_buffer = NULL;
   matrix_buffer_dim = 0;
-  if (mat != NULL) get_matrix_buffer(9);
+  if (mat != NULL || apply_y != NULL) get_matrix_buffer(9);
 
   // obtain a list of assembling stages
   std::vector<WeakForm::Stage> stages;
@@ -300,311 +643,818 @@ void DiscreteProblem::assemble(scalar* coeff_vec, SparseMatrix* mat, Vector* rhs
   for (unsigned ss = 0; ss < stages.size(); ss++)
   {
     WeakForm::Stage* s = &stages[ss];
+    elem_cache_stage = ss;
     for (unsigned i = 0; i < s->idx.size(); i++)
       s->fns[i] = pss[s->idx[i]];
     for (unsigned i = 0; i < s->ext.size(); i++)
       s->ext[i]->set_quad_2d(&g_quad_2d_std);
-    trav.begin(s->meshes.size(), &(s->meshes.front()), &(s->fns.front()));
 
     // assemble one stage
-    Element** e;
-    while ((e = trav.get_next_state(bnd, surf_pos)) != NULL)
+    if (!use_parallel_assembly || !assemble_parallel(s, coeff_vec, u_ext, mat, rhs, nrhs, rhsonly))
     {
-      // find a non-NULL e[i]
-      Element* e0;
-      for (unsigned int i = 0; i < s->idx.size(); i++)
-        if ((e0 = e[i]) != NULL) break;
-      if (e0 == NULL) continue;
-
-      // set maximum integration order for use in integrals, see limit_order()
-      update_limit_table(e0->get_mode());
-
-      // Obtain assembly lists for the element at all spaces of the stage, set appropriate mode for each pss.
-      // NOTE: Active elements and transformations for external functions (including the solutions from previous
-      // Newton's iteration) as well as basis functions (master PrecalcShapesets) have already been set in 
-      // trav.get_next_state(...).
-      memset(isempty, 0, sizeof(bool) * wf->neq);
-      for (unsigned int i = 0; i < s->idx.size(); i++)
-      {
-        int j = s->idx[i];
-        if (e[i] == NULL) 
-        { 
-          isempty[j] = true; 
-          continue; 
-        }
+      trav.begin(s->meshes.size(), &(s->meshes.front()), &(s->fns.front()));
+      Element** e;
+      while ((e = trav.get_next_state(bnd, surf_pos)) != NULL)
+        assemble_state(s, e, bnd, surf_pos, trav.get_base(), al, spss, refmap, u_ext, mat, rhs, nrhs, rhsonly);
+      trav.finish();
+    }
 
-        // TODO: do not obtain again if the element was not changed.
-        spaces[j]->get_element_assembly_list(e[i], &(al[j]));
+    if (mat != NULL) mat->finish();
+    for (int r = 0; r < nrhs; r++) rhs[r]->finish();
+  }
 
-        // This is different in H3D (PrecalcShapeset is not used)
-        spss[j]->set_active_element(e[i]);
-        spss[j]->set_master_transform();
+  for (int i = 0; i < wf->neq; i++) delete spss[i];  // This is different from H3D.
 
-        // This is different in H2D (PrecalcShapeset is not used).
-        refmap[j].set_active_element(e[i]);
-        refmap[j].force_transform(pss[j]->get_transform(), pss[j]->get_ctm());
-      }
-      int marker = e0->marker;
+  // drop the values of the states which no longer exist
+  if (use_incremental)
+  {
+    std::map<std::vector<int>, ElemCacheEntry>::iterator it = elem_cache.begin();
+    while (it != elem_cache.end())
+    {
+      if (it->second.stamp != elem_cache_stamp) elem_cache.erase(it++);
+      else it++;
+    }
+  }
 
-      init_cache();     // This is different in H2D.
+  // Cleaning up.
+  if (matrix_buffer != NULL) delete [] matrix_buffer;
+  matrix_buffer = NULL;
+  matrix_buffer_dim = 0;
 
-      //// assemble volume matrix forms //////////////////////////////////////
-      if (mat != NULL)
-      {
-        for (unsigned ww = 0; ww < s->mfvol.size(); ww++)
-        {
-          WeakForm::MatrixFormVol* mfv = s->mfvol[ww];
-          if (isempty[mfv->i] || isempty[mfv->j]) continue;
-          if (mfv->area != HERMES_ANY && !wf->is_in_area(marker, mfv->area)) continue;
-          int m = mfv->i;  
-          int n = mfv->j;  
-          fu = pss[n]; 
-          fv = spss[m];  
-          am = &al[m];  
-          an = &al[n];
-          bool tra = (m != n) && (mfv->sym != 0);
-          bool sym = (m == n) && (mfv->sym == 1);
+  // Delete temporary solutions.
+  for (int i = 0; i < wf->neq; i++) 
+  {
+    if (u_ext[i] != NULL) 
+    {
+      delete u_ext[i];
+      u_ext[i] = NULL;
+    }
+  }
+}
+
+/* BEGIN IDENTICAL CODE WITH H3D */
+
+void DiscreteProblem::apply(scalar* coeff_vec, scalar* x, scalar* y)
+{
+  _F_
+  memset(y, 0, get_num_dofs() * sizeof(scalar));
+  matrix_free = true;
+  apply_x = x;
+  apply_y = y;
+  assemble(coeff_vec, NULL, NULL, 0, false);
+  apply_x = apply_y = NULL;
+  matrix_free = false;
+}
+
+void DiscreteProblem::apply_fd(scalar* coeff_vec, scalar* x, scalar* y, scalar* f0, double eps)
+{
+  _F_
+  if (coeff_vec == NULL || this->is_linear) error("DiscreteProblem::apply_fd() is for nonlinear problems, use apply().");
+  int n = get_num_dofs();
+  double xnorm = 0.0, cnorm = 0.0;
+  for (int i = 0; i < n; i++)
+  {
+    xnorm += std::abs(x[i]) * std::abs(x[i]);
+    cnorm += std::abs(coeff_vec[i]) * std::abs(coeff_vec[i]);
+  }
+  if (xnorm == 0.0)
+  {
+    memset(y, 0, n * sizeof(scalar));
+    return;
+  }
+  if (eps == 0.0) eps = sqrt(DBL_EPSILON) * (1.0 + sqrt(cnorm)) / sqrt(xnorm);
+
+  // residual vectors at Y + eps x and at Y
+  scalar* shifted = new scalar[n];
+  MEM_CHECK(shifted);
+  for (int i = 0; i < n; i++) shifted[i] = coeff_vec[i] + eps * x[i];
+  assemble_residual(shifted, y);
+  if (f0 == NULL)
+  {
+    assemble_residual(coeff_vec, shifted);
+    f0 = shifted;
+  }
+  for (int i = 0; i < n; i++) y[i] = (y[i] - f0[i]) / eps;
+  delete [] shifted;
+}
+
+void DiscreteProblem::assemble_residual(scalar* coeff_vec, scalar* f)
+{
+  _F_
+  UMFPackVector vec;
+  Vector* pvec = &vec;
+  matrix_free = true;
+  assemble(coeff_vec, NULL, &pvec, 1, true);
+  matrix_free = false;
+  vec.extract(f);
+}
+
+/* END IDENTICAL CODE WITH H3D */
+
+// Assembles the forms of the stage on one state of the traversal.
+void DiscreteProblem::assemble_state(WeakForm::Stage* s, Element** e, bool* bnd, SurfPos* surf_pos, Element* base,
+                                     AsmList* al, PrecalcShapeset** spss, RefMap* refmap, Tuple<Solution*> u_ext,
+                                     SparseMatrix* mat, Vector** rhs, int nrhs, bool rhsonly)
+{
+  _F_
+  AUTOLA_OR(bool, nat, wf->neq);
+  AUTOLA_OR(bool, isempty, wf->neq);
+  AUTOLA_OR(int, elem_id, wf->neq);
+  AsmList *am, *an;
+  PrecalcShapeset *fu, *fv;
+
+  // find a non-NULL e[i]
+  Element* e0;
+  for (unsigned int i = 0; i < s->idx.size(); i++)
+    if ((e0 = e[i]) != NULL) break;
+  if (e0 == NULL) return;
+
+  // set maximum integration order for use in integrals, see limit_order()
+  // (set once for all the threads in the parallel assembly)
+  if (master == NULL) update_limit_table(e0->get_mode());
+
+  // Obtain assembly lists for the element at all spaces of the stage, set appropriate mode for each pss.
+  // NOTE: Active elements and transformations for external functions (including the solutions from previous
+  // Newton's iteration) as well as basis functions (master PrecalcShapesets) have already been set in 
+  // trav.get_next_state(...).
+  memset(isempty, 0, sizeof(bool) * wf->neq);
+  for (unsigned int i = 0; i < s->idx.size(); i++)
+  {
+    int j = s->idx[i];
+    if (e[i] == NULL) 
+    { 
+      isempty[j] = true; 
+      continue; 
+    }
+
+    // the lists are kept by the spaces (see Space::get_element_assembly_list())
+    spaces[j]->get_element_assembly_list(e[i], &(al[j]));
+    elem_id[j] = e[i]->id;
+
+    // This is different in H3D (PrecalcShapeset is not used)
+    spss[j]->set_active_element(e[i]);
+    spss[j]->set_master_transform();
+
+    // This is different in H2D (PrecalcShapeset is not used).
+    refmap[j].set_active_element(e[i]);
+    refmap[j].force_transform(pss[j]->get_transform(), pss[j]->get_ctm());
+  }
+  int marker = e0->marker;
+
+  init_cache();     // This is different in H2D.
+
+  // incremental assembly: the values of the forms may be stored from a previous assemble()
+  find_elem_cache_entry(s, e, bnd, surf_pos, al, mat != NULL || apply_y != NULL, nrhs, rhsonly);
+
+  //// assemble volume matrix forms //////////////////////////////////////
+  if (mat != NULL || apply_y != NULL)
+  {
+    for (unsigned ww = 0; ww < s->mfvol.size(); ww++)
+    {
+      WeakForm::MatrixFormVol* mfv = s->mfvol[ww];
+      if (isempty[mfv->i] || isempty[mfv->j]) continue;
+      if (mfv->area != HERMES_ANY && !wf->is_in_area(marker, mfv->area)) continue;
+      int m = mfv->i;  
+      int n = mfv->j;  
+      fu = pss[n]; 
+      fv = spss[m];  
+      am = &al[m];  
+      an = &al[n];
+      bool tra = (m != n) && (mfv->sym != 0);
+      bool sym = (m == n) && (mfv->sym == 1);
 
 	  /* BEGIN IDENTICAL CODE WITH H3D */
 
-          // assemble the local stiffness matrix for the form mfv
-          scalar **local_stiffness_matrix = get_matrix_buffer(std::max(am->cnt, an->cnt));
+      // assemble the local stiffness matrix for the form mfv
+      scalar **local_stiffness_matrix = get_matrix_buffer(std::max(am->cnt, an->cnt));
+      // constant-coefficient forms on affine elements are assembled from the reference integrals,
+      // on the other quads with tensor-product shapesets by sum factorization (the ordinary
+      // forms on all quads if enabled)
+      bool ref_form = mfv->const_coef && can_use_ref_matrices(fu, fv, an, am, &(refmap[n]), &(refmap[m]));
+      bool tensor_form = (mfv->const_coef || (use_sum_factorization && mfv->fn != NULL))
+                         && can_use_tensor_form(fu, fv, an, am, &(refmap[n]), &(refmap[m]));
+      // the matrix-free product of a sum-factorized form does not need the local matrix
+      if (tensor_form && apply_y != NULL && nrhs == 0 && elem_entry == NULL)
+      {
+        apply_tensor_form(mfv, u_ext, fu, fv, an, am, &(refmap[n]), &(refmap[m]), tra ? mfv->sym : 0);
+        continue;
+      }
+      // values stored by the incremental assembly
+      scalar* cached = mfv->ext.empty() ? get_elem_cache_values(am->cnt * an->cnt) : NULL;
+      if (mfv->elem_fn != NULL || ref_form || tensor_form || cached != NULL) // all the entries at once
+      {
+        if (cached != NULL || rhsonly == false || (nrhs > 0 && this->is_linear))
+        {
+          if (cached != NULL && elem_entry_hit)
+          {
+            for (int i = 0; i < am->cnt; i++)
+              memcpy(local_stiffness_matrix[i], cached + i * an->cnt, sizeof(scalar) * an->cnt);
+          }
+          else
+          {
+            if (ref_form)
+              eval_ref_form(mfv, fu, fv, an, am, &(refmap[n]), &(refmap[m]), local_stiffness_matrix);
+            else if (tensor_form)
+              eval_tensor_form(mfv, u_ext, fu, fv, an, am, &(refmap[n]), &(refmap[m]), local_stiffness_matrix);
+            else if (mfv->elem_fn != NULL)
+              eval_elem_form(mfv, u_ext, fu, fv, an, am, &(refmap[n]), &(refmap[m]), local_stiffness_matrix);
+            else
+              eval_pair_forms(mfv, u_ext, fu, fv, an, am, &(refmap[n]), &(refmap[m]), sym, local_stiffness_matrix);
+            if (cached != NULL)
+              for (int i = 0; i < am->cnt; i++)
+                memcpy(cached + i * an->cnt, local_stiffness_matrix[i], sizeof(scalar) * an->cnt);
+          }
+          for (int i = 0; i < am->cnt; i++)
+            for (int j = 0; j < an->cnt; j++)
+              local_stiffness_matrix[i][j] *= an->coef[j] * am->coef[i];
+        }
+
+        // Linear problems only: Subtracting Dirichlet lift contribution from the RHS:
+        if (nrhs > 0 && this->is_linear)
+        {
           for (int i = 0; i < am->cnt; i++)
           {
             if (!tra && am->dof[i] < 0) continue;
-            fv->set_active_shape(am->idx[i]);
+            for (int j = 0; j < an->cnt; j++)
+              if (an->dof[j] < 0)
+                add_to_rhs(rhs, nrhs, am->dof[i], -local_stiffness_matrix[i][j]);
+          }
+        }
+      }
+      else
+      {
+        for (int i = 0; i < am->cnt; i++)
+        {
+          if (!tra && am->dof[i] < 0) continue;
+          fv->set_active_shape(am->idx[i]);
 
-            if (!sym) // unsymmetric block
+          if (!sym) // unsymmetric block
+          {
+            for (int j = 0; j < an->cnt; j++) 
             {
-              for (int j = 0; j < an->cnt; j++) 
+              fu->set_active_shape(an->idx[j]);
+              if (an->dof[j] < 0) 
               {
-                fu->set_active_shape(an->idx[j]);
-                if (an->dof[j] < 0) 
-                {
-                  // Linear problems only: Subtracting Dirichlet lift contribution from the RHS:
-                  if (rhs != NULL && this->is_linear) 
-                  {
-                    scalar val = eval_form(mfv, u_ext, fu, fv, &(refmap[n]),
-                            &(refmap[m])) * an->coef[j] * am->coef[i];
-                    rhs->add(am->dof[i], -val);
-                  } 
-                }
-                else if (rhsonly == false) 
+                // Linear problems only: Subtracting Dirichlet lift contribution from the RHS:
+                if (nrhs > 0 && this->is_linear) 
                 {
                   scalar val = eval_form(mfv, u_ext, fu, fv, &(refmap[n]),
                           &(refmap[m])) * an->coef[j] * am->coef[i];
-                  local_stiffness_matrix[i][j] = val;
-                }
+                  add_to_rhs(rhs, nrhs, am->dof[i], -val);
+                } 
               }
-            }
-            else // symmetric block
-            {
-              for (int j = 0; j < an->cnt; j++) 
+              else if (rhsonly == false) 
               {
-                if (j < i && an->dof[j] >= 0) continue;
-                fu->set_active_shape(an->idx[j]);
-                if (an->dof[j] < 0) 
-                {
-                  // Linear problems only: Subtracting Dirichlet lift contribution from the RHS:
-                  if (rhs != NULL && this->is_linear) 
-                  {
-                    scalar val = eval_form(mfv, u_ext, fu, fv, &(refmap[n]),
-                            &(refmap[m])) * an->coef[j] * am->coef[i];
-                    rhs->add(am->dof[i], -val);
-                  }
-                } 
-                else if (rhsonly == false) 
-                {
-                  scalar val = eval_form(mfv, u_ext, fu, fv, &(refmap[n]),
-                          &(refmap[m])) * an->coef[j] * am->coef[i];
-                  local_stiffness_matrix[i][j] = local_stiffness_matrix[j][i] = val;
-                }
+                scalar val = eval_form(mfv, u_ext, fu, fv, &(refmap[n]),
+                        &(refmap[m])) * an->coef[j] * am->coef[i];
+                local_stiffness_matrix[i][j] = val;
               }
             }
           }
-
-          // insert the local stiffness matrix into the global one
-          if (rhsonly == false)
-            mat->add(am->cnt, an->cnt, local_stiffness_matrix, am->dof, an->dof);
-
-          // insert also the off-diagonal (anti-)symmetric block, if required
-          if (tra)
+          else // symmetric block
           {
-            if (mfv->sym < 0) 
-              chsgn(local_stiffness_matrix, am->cnt, an->cnt);
-            
-            transpose(local_stiffness_matrix, am->cnt, an->cnt);
-
-            if (rhsonly == false) 
-              mat->add(an->cnt, am->cnt, local_stiffness_matrix, an->dof, am->dof);
-
-            // Linear problems only: Subtracting Dirichlet lift contribution from the RHS:
-            if (rhs != NULL && this->is_linear) 
+            for (int j = 0; j < an->cnt; j++) 
             {
-              for (int j = 0; j < am->cnt; j++) 
+              if (j < i && an->dof[j] >= 0) continue;
+              fu->set_active_shape(an->idx[j]);
+              if (an->dof[j] < 0) 
               {
-                if (am->dof[j] < 0) 
+                // Linear problems only: Subtracting Dirichlet lift contribution from the RHS:
+                if (nrhs > 0 && this->is_linear) 
                 {
-                  for (int i = 0; i < an->cnt; i++) 
-                  {
-                    if (an->dof[i] >= 0) 
-                    {
-                      rhs->add(an->dof[i], -local_stiffness_matrix[i][j]);
-                    }
-                  }
+                  scalar val = eval_form(mfv, u_ext, fu, fv, &(refmap[n]),
+                          &(refmap[m])) * an->coef[j] * am->coef[i];
+                  add_to_rhs(rhs, nrhs, am->dof[i], -val);
                 }
+              } 
+              else if (rhsonly == false) 
+              {
+                scalar val = eval_form(mfv, u_ext, fu, fv, &(refmap[n]),
+                        &(refmap[m])) * an->coef[j] * am->coef[i];
+                local_stiffness_matrix[i][j] = local_stiffness_matrix[j][i] = val;
               }
             }
           }
         }
       }
 
-      /* END IDENTICAL CODE WITH H3D
-         Assembling of volume vector forms below is almost identical, there
-         is only one line of difference that is highlighted below */
-
-      //// assemble volume vector forms ////////////////////////////////////////
-      if (rhs != NULL)
+      // insert the local stiffness matrix into the global one
+      if (rhsonly == false)
       {
-        for (unsigned int ww = 0; ww < s->vfvol.size(); ww++)
-        {
-          WeakForm::VectorFormVol* vfv = s->vfvol[ww];
-          if (isempty[vfv->i]) continue;
-          if (vfv->area != HERMES_ANY && !wf->is_in_area(marker, vfv->area)) continue;
-          int m = vfv->i;  
-          fv = spss[m];    // H3D uses fv = test_fn + m;
-          am = &(al[m]);
-
-          for (int i = 0; i < am->cnt; i++)
-          {
-            if (am->dof[i] < 0) continue;
-            fv->set_active_shape(am->idx[i]);
-            scalar val = eval_form(vfv, u_ext, fv, &(refmap[m])) * am->coef[i];
-            rhs->add(am->dof[i], val);
-          }
-        }
+        add_to_matrix(mat, am->cnt, an->cnt, local_stiffness_matrix, am->dof, an->dof,
+                      get_scatter_map(mat, m, n, elem_id));
       }
 
-      // assemble surface integrals now: loop through surfaces of the element
-      for (unsigned int isurf = 0; isurf < e0->get_num_surf(); isurf++)
+      // insert also the off-diagonal (anti-)symmetric block, if required
+      if (tra)
       {
-        // H3D is freeing a fn_cache at this point
-
-        if (!bnd[isurf]) continue;
+        if (mfv->sym < 0) 
+          chsgn(local_stiffness_matrix, am->cnt, an->cnt);
         
-        int marker = surf_pos[isurf].marker;
+        transpose(local_stiffness_matrix, am->cnt, an->cnt);
 
-        // obtain the list of shape functions which are nonzero on this surface
-        for (unsigned int i = 0; i < s->idx.size(); i++) 
+        if (rhsonly == false) 
         {
-          if (e[i] == NULL) continue;
-          int j = s->idx[i];
-          if ((nat[j] = (spaces[j]->bc_type_callback(marker) == BC_NATURAL)))
-            spaces[j]->get_boundary_assembly_list(e[i], isurf, &(al[j]));
+          add_to_matrix(mat, an->cnt, am->cnt, local_stiffness_matrix, an->dof, am->dof,
+                        get_scatter_map(mat, n, m, elem_id));
         }
 
-        // assemble surface matrix forms ///////////////////////////////////
-        if (mat != NULL)
+        // Linear problems only: Subtracting Dirichlet lift contribution from the RHS:
+        if (nrhs > 0 && this->is_linear) 
         {
-          for (unsigned int ww = 0; ww < s->mfsurf.size(); ww++)
+          for (int j = 0; j < am->cnt; j++) 
           {
-            WeakForm::MatrixFormSurf* mfs = s->mfsurf[ww];
-            if (isempty[mfs->i] || isempty[mfs->j]) continue;
-            if (mfs->area != HERMES_ANY && !wf->is_in_area(marker, mfs->area)) continue;
-            int m = mfs->i;  
-            int n = mfs->j;  
-            fu = pss[n];      // This is different in H3D.
-            fv = spss[m];     // This is different in H3D.
-            am = &(al[m]);
-            an = &(al[n]);
-
-            if (!nat[m] || !nat[n]) continue;
-            surf_pos[isurf].base = trav.get_base();
-            surf_pos[isurf].space_v = spaces[m];
-            surf_pos[isurf].space_u = spaces[n];
-
-            scalar **local_stiffness_matrix = get_matrix_buffer(std::max(am->cnt, an->cnt));
-            for (int i = 0; i < am->cnt; i++)
+            if (am->dof[j] < 0) 
             {
-              if (am->dof[i] < 0) continue;
-              fv->set_active_shape(am->idx[i]);
-              for (int j = 0; j < an->cnt; j++)
+              for (int i = 0; i < an->cnt; i++) 
               {
-                fu->set_active_shape(an->idx[j]);
-                if (an->dof[j] < 0) 
+                if (an->dof[i] >= 0) 
                 {
-                  // Linear problems only: Subtracting Dirichlet lift contribution from the RHS:
-                  if (rhs != NULL && this->is_linear) 
-                  {
-                    scalar val = eval_form(mfs, u_ext, fu, fv, &(refmap[n]),
-                            &(refmap[m]), surf_pos + isurf) * an->coef[j] * am->coef[i];
-                    rhs->add(am->dof[i], -val);
-                  }
+                  add_to_rhs(rhs, nrhs, an->dof[i], -local_stiffness_matrix[i][j]);
                 }
-                else if (rhsonly == false) 
-                {
-                  scalar val = eval_form(mfs, u_ext, fu, fv, &(refmap[n]),
-                          &(refmap[m]), surf_pos + isurf) * an->coef[j] * am->coef[i];
-                  local_stiffness_matrix[i][j] = val;
-                } 
               }
             }
-            if (rhsonly == false) 
-              mat->add(am->cnt, an->cnt, local_stiffness_matrix, am->dof, an->dof);
-          }
-        }
-
-        // assemble surface vector forms /////////////////////////////////////
-        if (rhs != NULL)
-        {
-          for (unsigned int ww = 0; ww < s->vfsurf.size(); ww++)
-          {
-            WeakForm::VectorFormSurf* vfs = s->vfsurf[ww];
-            if (isempty[vfs->i]) continue;
-            if (vfs->area != HERMES_ANY && !wf->is_in_area(marker, vfs->area)) continue;
-            int m = vfs->i;  
-            fv = spss[m];        // This is different from H3D.  
-            am = &(al[m]);
-
-            if (!nat[m]) continue;
-            surf_pos[isurf].base = trav.get_base();
-            surf_pos[isurf].space_v = spaces[m];
-
-            for (int i = 0; i < am->cnt; i++)
-            {
-              if (am->dof[i] < 0) continue;
-              fv->set_active_shape(am->idx[i]);
-              scalar val = eval_form(vfs, u_ext, fv, &(refmap[m]), surf_pos + isurf) * am->coef[i];
-              rhs->add(am->dof[i], val);
-            }
           }
         }
       }
-
-      delete_cache();   // This is different in H3D.
     }
+  }
 
-    if (mat != NULL) mat->finish();
-    if (rhs != NULL) rhs->finish();
-    trav.finish();
+  /* END IDENTICAL CODE WITH H3D
+     Assembling of volume vector forms below is almost identical, there
+     is only one line of difference that is highlighted below */
+
+  //// assemble volume vector forms ////////////////////////////////////////
+  if (nrhs > 0)
+  {
+    for (unsigned int ww = 0; ww < s->vfvol.size(); ww++)
+    {
+      WeakForm::VectorFormVol* vfv = s->vfvol[ww];
+      if (vfv->rhs >= nrhs) continue;
+      if (isempty[vfv->i]) continue;
+      if (vfv->area != HERMES_ANY && !wf->is_in_area(marker, vfv->area)) continue;
+      int m = vfv->i;  
+      fv = spss[m];    // H3D uses fv = test_fn + m;
+      am = &(al[m]);
+
+      // values stored by the incremental assembly
+      scalar* cached = vfv->ext.empty() ? get_elem_cache_values(am->cnt) : NULL;
+      if (cached != NULL && !elem_entry_hit)
+      {
+        for (int i = 0; i < am->cnt; i++)
+        {
+          fv->set_active_shape(am->idx[i]);
+          cached[i] = eval_form(vfv, u_ext, fv, &(refmap[m]));
+        }
+      }
+
+      for (int i = 0; i < am->cnt; i++)
+      {
+        if (am->dof[i] < 0) continue;
+        fv->set_active_shape(am->idx[i]);
+        scalar val = (cached != NULL ? cached[i] : eval_form(vfv, u_ext, fv, &(refmap[m]))) * am->coef[i];
+        add_to_rhs(rhs + vfv->rhs, 1, am->dof[i], val);
+      }
+    }
   }
 
-  for (int i = 0; i < wf->neq; i++) delete spss[i];  // This is different from H3D.
+  // assemble surface integrals now: loop through surfaces of the element
+  for (unsigned int isurf = 0; isurf < e0->get_num_surf(); isurf++)
+  {
+    // H3D is freeing a fn_cache at this point
 
-  // Cleaning up.
-  if (matrix_buffer != NULL) delete [] matrix_buffer;
-  matrix_buffer = NULL;
-  matrix_buffer_dim = 0;
+    if (!bnd[isurf]) continue;
+    
+    int marker = surf_pos[isurf].marker;
 
-  // Delete temporary solutions.
-  for (int i = 0; i < wf->neq; i++) 
+    // obtain the list of shape functions which are nonzero on this surface
+    for (unsigned int i = 0; i < s->idx.size(); i++) 
+    {
+      if (e[i] == NULL) continue;
+      int j = s->idx[i];
+      if ((nat[j] = (spaces[j]->bc_type_callback(marker) == BC_NATURAL)))
+        spaces[j]->get_boundary_assembly_list(e[i], isurf, &(al[j]));
+    }
+
+    // assemble surface matrix forms ///////////////////////////////////
+    if (mat != NULL || apply_y != NULL)
+    {
+      for (unsigned int ww = 0; ww < s->mfsurf.size(); ww++)
+      {
+        WeakForm::MatrixFormSurf* mfs = s->mfsurf[ww];
+        if (isempty[mfs->i] || isempty[mfs->j]) continue;
+        if (mfs->area != HERMES_ANY && !wf->is_in_area(marker, mfs->area)) continue;
+        int m = mfs->i;  
+        int n = mfs->j;  
+        fu = pss[n];      // This is different in H3D.
+        fv = spss[m];     // This is different in H3D.
+        am = &(al[m]);
+        an = &(al[n]);
+
+        if (!nat[m] || !nat[n]) continue;
+        surf_pos[isurf].base = base;
+        surf_pos[isurf].space_v = spaces[m];
+        surf_pos[isurf].space_u = spaces[n];
+
+        // values stored by the incremental assembly
+        scalar* cached = mfs->ext.empty() ? get_elem_cache_values(am->cnt * an->cnt) : NULL;
+        if (cached != NULL && !elem_entry_hit)
+        {
+          for (int i = 0; i < am->cnt; i++)
+          {
+            fv->set_active_shape(am->idx[i]);
+            for (int j = 0; j < an->cnt; j++)
+            {
+              fu->set_active_shape(an->idx[j]);
+              cached[i * an->cnt + j] = eval_form(mfs, u_ext, fu, fv, &(refmap[n]), &(refmap[m]), surf_pos + isurf);
+            }
+          }
+        }
+
+        scalar **local_stiffness_matrix = get_matrix_buffer(std::max(am->cnt, an->cnt));
+        for (int i = 0; i < am->cnt; i++)
+        {
+          if (am->dof[i] < 0) continue;
+          fv->set_active_shape(am->idx[i]);
+          for (int j = 0; j < an->cnt; j++)
+          {
+            fu->set_active_shape(an->idx[j]);
+            if (an->dof[j] < 0) 
+            {
+              // Linear problems only: Subtracting Dirichlet lift contribution from the RHS:
+              if (nrhs > 0 && this->is_linear) 
+              {
+                scalar val = (cached != NULL ? cached[i * an->cnt + j] : eval_form(mfs, u_ext, fu, fv, &(refmap[n]),
+                        &(refmap[m]), surf_pos + isurf)) * an->coef[j] * am->coef[i];
+                add_to_rhs(rhs, nrhs, am->dof[i], -val);
+              }
+            }
+            else if (rhsonly == false) 
+            {
+              scalar val = (cached != NULL ? cached[i * an->cnt + j] : eval_form(mfs, u_ext, fu, fv, &(refmap[n]),
+                      &(refmap[m]), surf_pos + isurf)) * an->coef[j] * am->coef[i];
+              local_stiffness_matrix[i][j] = val;
+            } 
+          }
+        }
+        if (rhsonly == false) 
+          add_to_matrix(mat, am->cnt, an->cnt, local_stiffness_matrix, am->dof, an->dof, NULL);
+      }
+    }
+
+    // assemble surface vector forms /////////////////////////////////////
+    if (nrhs > 0)
+    {
+      for (unsigned int ww = 0; ww < s->vfsurf.size(); ww++)
+      {
+        WeakForm::VectorFormSurf* vfs = s->vfsurf[ww];
+        if (vfs->rhs >= nrhs) continue;
+        if (isempty[vfs->i]) continue;
+        if (vfs->area != HERMES_ANY && !wf->is_in_area(marker, vfs->area)) continue;
+        int m = vfs->i;  
+        fv = spss[m];        // This is different from H3D.  
+        am = &(al[m]);
+
+        if (!nat[m]) continue;
+        surf_pos[isurf].base = base;
+        surf_pos[isurf].space_v = spaces[m];
+
+        // values stored by the incremental assembly
+        scalar* cached = vfs->ext.empty() ? get_elem_cache_values(am->cnt) : NULL;
+        if (cached != NULL && !elem_entry_hit)
+        {
+          for (int i = 0; i < am->cnt; i++)
+          {
+            fv->set_active_shape(am->idx[i]);
+            cached[i] = eval_form(vfs, u_ext, fv, &(refmap[m]), surf_pos + isurf);
+          }
+        }
+
+        for (int i = 0; i < am->cnt; i++)
+        {
+          if (am->dof[i] < 0) continue;
+          fv->set_active_shape(am->idx[i]);
+          scalar val = (cached != NULL ? cached[i] : eval_form(vfs, u_ext, fv, &(refmap[m]), surf_pos + isurf)) * am->coef[i];
+          add_to_rhs(rhs + vfs->rhs, 1, am->dof[i], val);
+        }
+      }
+    }
+  }
+
+  if (elem_entry != NULL && elem_entry_hit && elem_entry_pos != elem_entry->values.size())
+    error("Internal in DiscreteProblem::assemble_state(): cached values not used.");
+
+  delete_cache();   // This is different in H3D.
+}
+
+// Adds the block to the matrix; a worker of the parallel assembly only records it.
+void DiscreteProblem::add_to_matrix(SparseMatrix* mat, int m, int n, scalar** block, int* rows, int* cols, int* map)
+{
+  if (apply_y != NULL)
   {
-    if (u_ext[i] != NULL) 
+    // matrix-free product, see apply()
+    for (int i = 0; i < m; i++)
     {
-      delete u_ext[i];
-      u_ext[i] = NULL;
+      if (rows[i] < 0) continue;
+      scalar sum = 0.0;
+      for (int j = 0; j < n; j++)
+        if (cols[j] >= 0) sum += block[i][j] * apply_x[cols[j]];
+      apply_y[rows[i]] += sum;
     }
   }
+  else if (asm_buffer != NULL)
+    asm_buffer->add_block(m, n, block, rows, cols, map);
+  else if (map != NULL)
+    mat->add_block_with_map(m, n, block, map);
+  else
+    mat->add(m, n, block, rows, cols);
+}
+
+// Adds the value to the right-hand sides rhs[0 .. nrhs-1] (all of them for the Dirichlet lift,
+// which is common to all of them); a worker of the parallel assembly only records it.
+void DiscreteProblem::add_to_rhs(Vector** rhs, int nrhs, int idx, scalar val)
+{
+  if (asm_buffer != NULL)
+    asm_buffer->add_vector(rhs, nrhs, idx, val);
+  else
+    for (int r = 0; r < nrhs; r++)
+      rhs[r]->add(idx, val);
+}
+
+// Appends the bytes of 'data' to the key of the incremental assembly.
+static void push_elem_key(std::vector<int> &key, const void* data, int size)
+{
+  int n = key.size();
+  key.resize(n + size / sizeof(int));
+  memcpy(&key[n], data, size);
+}
+
+// Finds the values of the forms on the current state in the cache of the incremental assembly
+// ('elem_entry_hit'), or creates the entry for them. Sets 'elem_entry' to NULL if the state
+// is not cached.
+void DiscreteProblem::find_elem_cache_entry(WeakForm::Stage* s, Element** e, bool* bnd, SurfPos* surf_pos,
+                                            AsmList* al, bool matrix, int nrhs, bool rhsonly)
+{
+  _F_
+  elem_entry = NULL;
+  if (!use_incremental || !this->is_linear) return;
+  if (elem_cache_dropped)
+  {
+    elem_cache_misses++;
+    return;
+  }
+
+  elem_key.clear();
+  elem_key.push_back(elem_cache_stage);
+  elem_key.push_back(matrix);
+  elem_key.push_back(nrhs);
+  elem_key.push_back(rhsonly);
+  Element* e0 = NULL;
+  for (unsigned int i = 0; i < s->idx.size(); i++)
+  {
+    if (e[i] == NULL) 
+    {
+      elem_key.push_back(-1);
+      continue;
+    }
+    if (e0 == NULL) e0 = e[i];
+    int j = s->idx[i];
+    elem_key.push_back(e[i]->nvert);
+    elem_key.push_back(e[i]->marker);
+    // the geometry of a curved element is not given by its vertices only
+    elem_key.push_back(e[i]->is_curved() ? e[i]->id : -1);
+    for (unsigned int k = 0; k < e[i]->nvert; k++)
+    {
+      push_elem_key(elem_key, &(e[i]->vn[k]->x), sizeof(double));
+      push_elem_key(elem_key, &(e[i]->vn[k]->y), sizeof(double));
+    }
+    uint64_t sub_idx = pss[j]->get_transform();
+    push_elem_key(elem_key, &sub_idx, sizeof(uint64_t));
+    elem_key.push_back(al[j].cnt);
+    elem_key.insert(elem_key.end(), al[j].idx, al[j].idx + al[j].cnt);
+  }
+
+  // the boundary conditions decide which surface forms are assembled
+  for (unsigned int isurf = 0; isurf < e0->get_num_surf(); isurf++)
+  {
+    if (!bnd[isurf])
+    {
+      elem_key.push_back(-1);
+      continue;
+    }
+    elem_key.push_back(surf_pos[isurf].marker);
+    for (unsigned int i = 0; i < s->idx.size(); i++)
+      elem_key.push_back(spaces[s->idx[i]]->bc_type_callback(surf_pos[isurf].marker));
+  }
+
+  std::map<std::vector<int>, ElemCacheEntry>::iterator it = elem_cache.find(elem_key);
+  if (it != elem_cache.end())
+  {
+    elem_cache_hits++;
+    elem_entry = &(it->second);
+    elem_entry_hit = true;
+  }
+  else
+  {
+    elem_cache_misses++;
+    if (elem_cache_limit >= 0 && elem_cache_misses > elem_cache_limit)
+    {
+      verbose("Too many elements changed, the incremental assembly falls back to the full one.");
+      elem_cache.clear();
+      elem_cache_dropped = true;
+      return;
+    }
+    elem_entry = &(elem_cache[elem_key]);
+    elem_entry->values.clear();
+    elem_entry_hit = false;
+  }
+  elem_entry->stamp = elem_cache_stamp;
+  elem_entry_pos = 0;
+}
+
+// Returns the next 'n' values of the current state in the cache of the incremental assembly
+// (to be read if 'elem_entry_hit', otherwise to be filled in), or NULL if the state is not cached.
+scalar* DiscreteProblem::get_elem_cache_values(int n)
+{
+  if (elem_entry == NULL || n == 0) return NULL;
+  std::vector<scalar> &values = elem_entry->values;
+  if (!elem_entry_hit) values.resize(elem_entry_pos + n);
+  else if (elem_entry_pos + n > values.size()) error("Internal in DiscreteProblem::get_elem_cache_values().");
+  scalar* v = &values[elem_entry_pos];
+  elem_entry_pos += n;
+  return v;
+}
+
+// Number of consecutive states of the traversal assembled by one thread.
+static const int H2D_ASM_CHUNK = 16;
+
+// Per-thread state of the parallel assembly.
+struct AsmThread
+{
+  DiscreteProblem* dp;
+  AsmBuffer* buffer;
+  PrecalcShapeset** spss;
+  RefMap* refmap;
+  AsmList* al;
+  Tuple<Solution*> u_ext;
+  WeakForm::Stage stage;
+};
+
+// Adds the contributions of the states [first, last) in the order of the traversal. Called by
+// all threads of the team: the buffers are flushed by the master thread and then cleared by
+// their threads.
+static void flush_states(AsmThread* th, int nth, int first, int last, SparseMatrix* mat)
+{
+#ifdef _OPENMP
+  #pragma omp barrier
+  #pragma omp master
+  {
+    for (int k = first; k < last; k++)
+      th[(k / H2D_ASM_CHUNK) % nth].buffer->flush_state(mat);
+  }
+  #pragma omp barrier
+  th[omp_get_thread_num()].buffer->clear();
+#endif
+}
+
+// Assembles the stage by several threads. Every thread traverses the meshes with its own
+// copies of the shape functions, reference maps and previous Newton iteration and assembles
+// the states k with (k / H2D_ASM_CHUNK) % (number of threads) equal to its number. The
+// contributions are recorded and added to the matrix and the right-hand sides in batches,
+// in the order of the traversal. Returns false if the stage has to be assembled serially.
+bool DiscreteProblem::assemble_parallel(WeakForm::Stage* s, scalar* coeff_vec, Tuple<Solution*> u_ext,
+                                        SparseMatrix* mat, Vector** rhs, int nrhs, bool rhsonly)
+{
+  _F_
+#ifdef _OPENMP
+  int nt = omp_get_max_threads();
+  if (nt < 2 || use_incremental || apply_y != NULL) return false;
+
+  // only the previous Newton iteration can be copied for the threads
+  for (unsigned i = 0; i < s->ext.size(); i++)
+  {
+    bool found = false;
+    for (int j = 0; j < u_ext.size(); j++)
+      if (u_ext[j] != NULL && s->ext[i] == u_ext[j]) found = true;
+    if (!found)
+    {
+      verbose("External functions in the weak form, the stage is assembled serially.");
+      return false;
+    }
+  }
+
+  // the mode (triangle/quad) of the shapesets and of the quadrature is global
+  int mode = -1;
+  for (unsigned i = 0; i < s->meshes.size(); i++)
+  {
+    Element* e;
+    for_all_active_elements(e, s->meshes[i])
+    {
+      if (mode < 0) mode = e->get_mode();
+      else if (mode != e->get_mode())
+      {
+        verbose("Both triangles and quads in the meshes, the stage is assembled serially.");
+        return false;
+      }
+    }
+  }
+  if (mode < 0) return false;
+  update_limit_table(mode);
+
+  // The copies are created serially (the constructors of reference maps and solutions
+  // use global data).
+  AsmThread* th = new AsmThread[nt];
+  MEM_CHECK(th);
+  for (int t = 0; t < nt; t++)
+  {
+    DiscreteProblem* dp = th[t].dp = new DiscreteProblem(this);
+    th[t].buffer = dp->asm_buffer;
+    th[t].spss = new PrecalcShapeset*[wf->neq];
+    th[t].refmap = new RefMap[wf->neq];
+    th[t].al = new AsmList[wf->neq];
+    for (int i = 0; i < wf->neq; i++)
+    {
+      th[t].spss[i] = new PrecalcShapeset(dp->pss[i]);
+      dp->pss[i]->set_quad_2d(&g_quad_2d_std);
+      th[t].spss[i]->set_quad_2d(&g_quad_2d_std);
+      th[t].refmap[i].set_quad_2d(&g_quad_2d_std);
+      Solution* sln = NULL;
+      if (u_ext[i] != NULL)
+      {
+        sln = new Solution(spaces[i]->get_mesh());
+        Solution::vector_to_solution(coeff_vec, spaces[i], sln);
+        sln->set_quad_2d(&g_quad_2d_std);
+      }
+      th[t].u_ext.push_back(sln);
+    }
+
+    // the same meshes and functions in the same order, so that all threads traverse
+    // the same states
+    th[t].stage = *s;
+    for (unsigned i = 0; i < s->idx.size(); i++)
+      th[t].stage.fns[i] = dp->pss[s->idx[i]];
+    for (unsigned i = 0; i < s->ext.size(); i++)
+      for (int j = 0; j < u_ext.size(); j++)
+        if (s->ext[i] == u_ext[j])
+          th[t].stage.fns[s->idx.size() + i] = th[t].stage.ext[i] = th[t].u_ext[j];
+  }
+
+  // the threads only read the assembly lists of the spaces
+  for (int i = 0; i < wf->neq; i++)
+    spaces[i]->update_assembly_lists();
+
+  #pragma omp parallel num_threads(nt)
+  {
+    int t = omp_get_thread_num(), nth = omp_get_num_threads();
+    AsmThread* my = th + t;
+    WeakForm::Stage* ms = &my->stage;
+    bool bnd[4];
+    SurfPos surf_pos[4];
+
+    Traverse trav;
+    trav.begin(ms->meshes.size(), &(ms->meshes.front()), &(ms->fns.front()));
+    Element** e;
+    int k = 0, first = 0;
+    while ((e = trav.get_next_state(bnd, surf_pos)) != NULL)
+    {
+      if ((k / H2D_ASM_CHUNK) % nth == t)
+      {
+        my->dp->assemble_state(ms, e, bnd, surf_pos, trav.get_base(), my->al, my->spss, my->refmap,
+                               my->u_ext, mat, rhs, nrhs, rhsonly);
+        my->buffer->end_state();
+      }
+      if (++k % (H2D_ASM_CHUNK * nth) == 0)
+      {
+        flush_states(th, nth, first, k, mat);
+        first = k;
+      }
+    }
+    trav.finish();
+    flush_states(th, nth, first, k, mat);
+  }
+
+  for (int t = 0; t < nt; t++)
+  {
+    order_cache_hits += th[t].dp->order_cache_hits;
+    order_cache_misses += th[t].dp->order_cache_misses;
+    fn_cache_reuses += th[t].dp->fn_cache_reuses;
+    fn_cache_updates += th[t].dp->fn_cache_updates;
+    for (int i = 0; i < wf->neq; i++)
+    {
+      delete th[t].spss[i];
+      if (th[t].u_ext[i] != NULL) delete th[t].u_ext[i];
+    }
+    delete [] th[t].spss;
+    delete [] th[t].refmap;
+    delete [] th[t].al;
+    delete th[t].dp;
+  }
+  delete [] th;
+  return true;
+#else
+  verbose("Hermes2D was built without OpenMP, assembling serially.");
+  return false;
+#endif
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -658,17 +1508,130 @@ ExtData<Ord>* DiscreteProblem::init_ext_fns_ord(std::vector<MeshFunction *> &ext
 Func<double>* DiscreteProblem::get_fn(PrecalcShapeset *fu, RefMap *rm, const int order)
 {
   _F_
+  // the shape indices and the numbers of the quadrature points depend on the mode
+  int mode = rm->get_active_element()->get_mode();
   PrecalcShapeset::Key key(256 - fu->get_active_shape(), order, fu->get_transform(), fu->get_shapeset()->get_id());
-  if (cache_fn[key] == NULL)
-    cache_fn[key] = init_fn(fu, rm, order);
+  FnCacheEntry &entry = fn_cache[find_fn_cache_entry(key, mode)];
+  if (entry.stamp == fn_cache_stamp) return entry.fn;
+
+  // the entry belongs to another element
+  bool affine = rm->is_jacobian_const();
+  double2x2 &irm = *rm->get_const_inv_ref_map();
+  if (entry.fn == NULL)
+    entry.fn = init_fn(fu, rm, order);
+  else if (affine && entry.affine && !memcmp(entry.irm, irm, sizeof(double2x2)))
+    fn_cache_reuses++;
+  else
+  {
+    update_fn(entry.fn, fu, rm, order);
+    fn_cache_updates++;
+  }
+
+  entry.stamp = fn_cache_stamp;
+  entry.affine = affine;
+  if (affine) memcpy(entry.irm, irm, sizeof(double2x2));
+  return entry.fn;
+}
+
+static inline unsigned fn_key_hash(const PrecalcShapeset::Key &key, int mode)
+{
+  unsigned hash = (unsigned) key.index * 2 + (unsigned) mode;
+  hash = hash * 31 + (unsigned) key.order;
+  hash = hash * 31 + (unsigned) key.sub_idx;
+  hash = hash * 31 + (unsigned) (key.sub_idx >> 32);
+  hash = hash * 31 + (unsigned) key.shapeset_type;
+  return hash ^ (hash >> 15);
+}
+
+// Returns the index of the entry of 'fn_cache' with the key 'key' and the element mode 'mode',
+// a new entry (with 'fn' NULL) is added if there is none.
+int DiscreteProblem::find_fn_cache_entry(const PrecalcShapeset::Key &key, int mode)
+{
+  unsigned hash = fn_key_hash(key, mode);
+  unsigned mask = fn_cache_slots.size() - 1;
+  if (!fn_cache_slots.empty())
+  {
+    for (unsigned i = hash & mask; fn_cache_slots[i] >= 0; i = (i + 1) & mask)
+    {
+      const PrecalcShapeset::Key &k = fn_cache[fn_cache_slots[i]].key;
+      if (k.index == key.index && k.order == key.order && k.sub_idx == key.sub_idx &&
+          k.shapeset_type == key.shapeset_type && fn_cache[fn_cache_slots[i]].mode == mode)
+        return fn_cache_slots[i];
+    }
+  }
+
+  // new entry, keep the table at most half full
+  FnCacheEntry entry = { key, NULL, -1, mode, false };
+  fn_cache.push_back(entry);
+  if (2 * fn_cache.size() > fn_cache_slots.size())
+  {
+    size_t size = 256;
+    while (size < 4 * fn_cache.size()) size *= 2;
+    fn_cache_slots.assign(size, -1);
+    mask = fn_cache_slots.size() - 1;
+    for (unsigned e = 0; e < fn_cache.size(); e++)
+    {
+      unsigned i = fn_key_hash(fn_cache[e].key, fn_cache[e].mode) & mask;
+      while (fn_cache_slots[i] >= 0) i = (i + 1) & mask;
+      fn_cache_slots[i] = e;
+    }
+  }
+  else
+  {
+    unsigned i = hash & mask;
+    while (fn_cache_slots[i] >= 0) i = (i + 1) & mask;
+    fn_cache_slots[i] = fn_cache.size() - 1;
+  }
+  return fn_cache.size() - 1;
+}
+
+void DiscreteProblem::free_fn_cache()
+{
+  _F_
+  for (unsigned i = 0; i < fn_cache.size(); i++)
+  {
+    if (fn_cache[i].fn != NULL) { fn_cache[i].fn->free_fn(); delete fn_cache[i].fn; }
+  }
+  fn_cache.clear();
+  fn_cache_slots.clear();
+}
+
+// Returns the cached order of the form (the result of its 'ord' callback) for the given orders of
+// the shape functions and the current orders of the previous Newton iteration and of the external
+// functions (on the edge 'edge' for surface forms, -1 for volume forms). A new entry is -1, the
+// caller evaluates the order and stores it.
+int* DiscreteProblem::get_cached_order(void* form, Tuple<Solution *> &u_ext, int inc, int ou, int ov,
+                                       std::vector<MeshFunction *> &ext, int edge)
+{
+  order_key.clear();
+  order_key.push_back(ou);
+  order_key.push_back(ov);
+  for (int i = 0; i < wf->neq; i++)
+  {
+    Solution* sln = (i < (int) u_ext.size()) ? u_ext[i] : NULL;
+    if (sln == NULL) order_key.push_back(0);
+    else order_key.push_back((edge < 0 ? sln->get_fn_order() : sln->get_edge_fn_order(edge)) + inc);
+  }
+  for (unsigned i = 0; i < ext.size(); i++)
+    order_key.push_back(edge < 0 ? ext[i]->get_fn_order() : ext[i]->get_edge_fn_order(edge));
 
-  return cache_fn[key];
+  std::map<std::vector<int>, int> &orders = order_cache[form];
+  std::map<std::vector<int>, int>::iterator it = orders.find(order_key);
+  if (it != orders.end())
+  {
+    order_cache_hits++;
+    return &(it->second);
+  }
+  order_cache_misses++;
+  return &(orders[order_key] = -1);
 }
 
 // Caching transformed values
 void DiscreteProblem::init_cache()
 {
   _F_
+  // invalidates the entries of 'fn_cache' computed on the previous elements
+  fn_cache_stamp++;
   for (int i = 0; i < g_max_quad + 1 + 4 * g_max_quad + 4; i++)
   {
     cache_e[i] = NULL;
@@ -676,80 +1639,471 @@ void DiscreteProblem::init_cache()
   }
 }
 
-void DiscreteProblem::delete_cache()
+void DiscreteProblem::delete_cache()
+{
+  _F_
+  for (int i = 0; i < g_max_quad + 1 + 4 * g_max_quad + 4; i++)
+  {
+    if (cache_e[i] != NULL)
+    {
+      cache_e[i]->free(); delete cache_e[i];
+      delete [] cache_jwt[i];
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Integration order of a volume matrix form for the basis and test functions of the orders
+// 'order_u' and 'order_v' (already increased by 'inc'), including the increase due to the
+// reference map.
+int DiscreteProblem::calc_order_matrix_form_vol(WeakForm::MatrixFormVol *mfv, Tuple<Solution *> u_ext,
+                                                int inc, int order_u, int order_v, RefMap *ru)
+{
+  _F_
+  int* form_order = get_cached_order(mfv, u_ext, inc, order_u, order_v, mfv->ext, -1);
+  if (*form_order < 0)
+  {
+    // Order of solutions from the previous Newton iteration.
+    AUTOLA_OR(Func<Ord>*, oi, wf->neq);
+    if (u_ext != Tuple<Solution *>()) {
+      for (int i = 0; i < wf->neq; i++) {
+        if (u_ext[i] != NULL) oi[i] = init_fn_ord(u_ext[i]->get_fn_order() + inc);
+        else oi[i] = init_fn_ord(0);
+      }
+    }
+    else {
+      for (int i = 0; i < wf->neq; i++) oi[i] = init_fn_ord(0);
+    }
+
+    // Order of shape functions.
+    Func<Ord>* ou = init_fn_ord(order_u);
+    Func<Ord>* ov = init_fn_ord(order_v);
+
+    // Order of additional external functions.
+    ExtData<Ord>* fake_ext = init_ext_fns_ord(mfv->ext);
+
+    // Order of geometric attributes (eg. for multiplication of a solution with coordinates, normals, etc.).
+    double fake_wt = 1.0;
+    Geom<Ord>* fake_e = init_geom_ord();
+
+    // Total order of the matrix form.
+    Ord o = mfv->ord(1, &fake_wt, oi, ou, ov, fake_e, fake_ext);
+
+    // Clean up.
+    for (int i = 0; i < wf->neq; i++) {  
+      if (oi[i] != NULL) { oi[i]->free_ord(); delete oi[i]; }
+    }
+    if (ou != NULL) {
+      ou->free_ord(); delete ou;
+    }
+    if (ov != NULL) {
+      ov->free_ord(); delete ov;
+    }
+    if (fake_e != NULL) delete fake_e;
+    if (fake_ext != NULL) {fake_ext->free_ord(); delete fake_ext;}
+
+    *form_order = o.get_order();
+  }
+
+  // Increase due to reference map.
+  int order = ru->get_inv_ref_order();
+  order += *form_order;
+  limit_order_nowarn(order);
+  return order;
+}
+
+// Actual evaluation of volume matrix form (calculates integral)
+scalar DiscreteProblem::eval_form(WeakForm::MatrixFormVol *mfv, Tuple<Solution *> u_ext, 
+                        PrecalcShapeset *fu, PrecalcShapeset *fv, RefMap *ru, RefMap *rv)
+{
+  _F_
+  // Determine the integration order.
+  int inc = (fu->get_num_components() == 2) ? 1 : 0;
+  int order = calc_order_matrix_form_vol(mfv, u_ext, inc, fu->get_fn_order() + inc,
+                                         fv->get_fn_order() + inc, ru);
+
+  // Evaluate the form using the quadrature of the just calculated order.
+  Quad2D* quad = fu->get_quad_2d();
+  double3* pt = quad->get_points(order);
+  int np = quad->get_num_points(order);
+
+  // Init geometry and jacobian*weights.
+  if (cache_e[order] == NULL)
+  {
+    cache_e[order] = init_geom_vol(ru, order);
+    double* jac = ru->get_jacobian(order);
+    cache_jwt[order] = new double[np];
+    for(int i = 0; i < np; i++)
+      cache_jwt[order][i] = pt[i][2] * jac[i];
+  }
+  Geom<double>* e = cache_e[order];
+  double* jwt = cache_jwt[order];
+
+  // Values of the previous Newton iteration, shape functions and external functions in quadrature points.
+  AUTOLA_OR(Func<scalar>*, prev, wf->neq);
+  //for (int i = 0; i < wf->neq; i++) prev[i]  = init_fn(sln[i], rv, order);
+  if (u_ext != Tuple<Solution *>()) {
+    for (int i = 0; i < wf->neq; i++) {
+      if (u_ext[i] != NULL) prev[i] = init_fn(u_ext[i], rv, order);
+      else prev[i] = NULL;
+    }
+  }
+  else {
+    for (int i = 0; i < wf->neq; i++) prev[i] = NULL;
+  }
+
+  Func<double>* u = get_fn(fu, ru, order);
+  Func<double>* v = get_fn(fv, rv, order);
+  ExtData<scalar>* ext = init_ext_fns(mfv->ext, rv, order);
+  
+  scalar res = mfv->fn(np, jwt, prev, u, v, e, ext);
+  
+  // Clean up.
+  for (int i = 0; i < wf->neq; i++) {  
+    if (prev[i] != NULL) prev[i]->free_fn(); delete prev[i]; 
+  }
+  if (ext != NULL) {ext->free(); delete ext;}
+
+  return res;
+}
+
+// Evaluation of a volume matrix form for all the pairs of the basis functions of 'an' and the
+// test functions of 'am' (the local matrix without the coefficients of the assembly lists).
+void DiscreteProblem::eval_pair_forms(WeakForm::MatrixFormVol *mfv, Tuple<Solution *> u_ext, PrecalcShapeset *fu,
+                                      PrecalcShapeset *fv, AsmList *an, AsmList *am, RefMap *ru, RefMap *rv,
+                                      bool sym, scalar **mat)
+{
+  _F_
+  for (int i = 0; i < am->cnt; i++)
+  {
+    fv->set_active_shape(am->idx[i]);
+    for (int j = sym ? i : 0; j < an->cnt; j++)
+    {
+      fu->set_active_shape(an->idx[j]);
+      mat[i][j] = eval_form(mfv, u_ext, fu, fv, ru, rv);
+      if (sym) mat[j][i] = mat[i][j];
+    }
+  }
+}
+
+// Evaluation of an element-level volume matrix form: the local matrix of all the basis functions
+// of 'an' and the test functions of 'am' at once (without the coefficients of the assembly lists).
+void DiscreteProblem::eval_elem_form(WeakForm::MatrixFormVol *mfv, Tuple<Solution *> u_ext,
+                                     PrecalcShapeset *fu, PrecalcShapeset *fv, AsmList *an, AsmList *am,
+                                     RefMap *ru, RefMap *rv, scalar **mat)
+{
+  _F_
+  if (an->cnt == 0 || am->cnt == 0) return;
+
+  // Determine the integration order: the one of the pair of the highest orders of the shape
+  // functions on the element (the order of a form does not decrease with the orders of its arguments).
+  int inc = (fu->get_num_components() == 2) ? 1 : 0;
+  int max_order_u = 0, max_order_v = 0;
+  for (int j = 0; j < an->cnt; j++)
+  {
+    fu->set_active_shape(an->idx[j]);
+    max_order_u = std::max(max_order_u, fu->get_fn_order());
+  }
+  for (int i = 0; i < am->cnt; i++)
+  {
+    fv->set_active_shape(am->idx[i]);
+    max_order_v = std::max(max_order_v, fv->get_fn_order());
+  }
+  int order = calc_order_matrix_form_vol(mfv, u_ext, inc, max_order_u + inc, max_order_v + inc, ru);
+
+  // Evaluate the form using the quadrature of the just calculated order.
+  Quad2D* quad = fu->get_quad_2d();
+  double3* pt = quad->get_points(order);
+  int np = quad->get_num_points(order);
+
+  // Init geometry and jacobian*weights.
+  if (cache_e[order] == NULL)
+  {
+    cache_e[order] = init_geom_vol(ru, order);
+    double* jac = ru->get_jacobian(order);
+    cache_jwt[order] = new double[np];
+    for(int i = 0; i < np; i++)
+      cache_jwt[order][i] = pt[i][2] * jac[i];
+  }
+  Geom<double>* e = cache_e[order];
+  double* jwt = cache_jwt[order];
+
+  // Values of the previous Newton iteration and external functions in quadrature points.
+  AUTOLA_OR(Func<scalar>*, prev, wf->neq);
+  if (u_ext != Tuple<Solution *>()) {
+    for (int i = 0; i < wf->neq; i++) {
+      if (u_ext[i] != NULL) prev[i] = init_fn(u_ext[i], rv, order);
+      else prev[i] = NULL;
+    }
+  }
+  else {
+    for (int i = 0; i < wf->neq; i++) prev[i] = NULL;
+  }
+  ExtData<scalar>* ext = init_ext_fns(mfv->ext, rv, order);
+
+  // Tables of the shape functions (the transformed values are taken from 'fn_cache').
+  for (int j = 0; j < an->cnt; j++)
+  {
+    fu->set_active_shape(an->idx[j]);
+    Func<double>* u = get_fn(fu, ru, order);
+    if (j == 0) elem_table_u.init(an->cnt, np, u);
+    elem_table_u.set_row(j, u);
+  }
+  for (int i = 0; i < am->cnt; i++)
+  {
+    fv->set_active_shape(am->idx[i]);
+    Func<double>* v = get_fn(fv, rv, order);
+    if (i == 0) elem_table_v.init(am->cnt, np, v);
+    elem_table_v.set_row(i, v);
+  }
+
+  mfv->elem_fn(np, jwt, prev, &elem_table_u, &elem_table_v, e, ext, mat);
+
+  // Clean up.
+  for (int i = 0; i < wf->neq; i++) {  
+    if (prev[i] != NULL) prev[i]->free_fn(); delete prev[i]; 
+  }
+  if (ext != NULL) {ext->free(); delete ext;}
+}
+
+// Constant-coefficient volume matrix forms on affine elements (see add_matrix_form_const()).
+
+bool DiscreteProblem::RefMatrixKey::operator<(const RefMatrixKey &o) const
+{
+  if (mode != o.mode) return mode < o.mode;
+  if (ss_u != o.ss_u) return ss_u < o.ss_u;
+  if (ss_v != o.ss_v) return ss_v < o.ss_v;
+  if (sub_u != o.sub_u) return sub_u < o.sub_u;
+  return sub_v < o.sub_v;
+}
+
+DiscreteProblem::RefMatrices::~RefMatrices()
+{
+  for (int i = 0; i < nu; i++)
+  {
+    delete [] rows[i];
+    delete [] done[i];
+  }
+}
+
+void DiscreteProblem::free_ref_matrices()
+{
+  _F_
+  for (std::map<RefMatrixKey, RefMatrices *>::iterator it = ref_matrices.begin(); it != ref_matrices.end(); it++)
+    delete it->second;
+  ref_matrices.clear();
+}
+
+// Returns the matrix C of the form: C[3*a + b] = a(U = e_a, V = e_b) evaluated in one point
+// with a unit weight.
+scalar* DiscreteProblem::get_const_coefs(WeakForm::MatrixFormVol *mfv)
+{
+  _F_
+  std::vector<scalar> &c = const_coefs[mfv];
+  if (!c.empty()) return &c[0];
+
+  double uval[3] = { 0.0, 0.0, 0.0 }, vval[3] = { 0.0, 0.0, 0.0 };
+  Func<double> u(1, 1), v(1, 1);
+  u.val = uval; u.dx = uval + 1; u.dy = uval + 2;
+  v.val = vval; v.dx = vval + 1; v.dy = vval + 2;
+
+  double zero = 0.0, wt = 1.0;
+  Geom<double> e;
+  e.x = e.y = &zero;
+  ExtData<scalar> ext;
+  AUTOLA_OR(Func<scalar>*, prev, wf->neq);
+  for (int i = 0; i < wf->neq; i++) prev[i] = NULL;
+
+  c.resize(9);
+  for (int a = 0; a < 3; a++)
+  {
+    uval[a] = 1.0;
+    for (int b = 0; b < 3; b++)
+    {
+      vval[b] = 1.0;
+      c[3*a + b] = mfv->fn(1, &wt, prev, &u, &v, &e, &ext);
+      vval[b] = 0.0;
+    }
+    uval[a] = 0.0;
+  }
+  return &c[0];
+}
+
+// True if the reference integrals can be used for the current element: both reference maps
+// are constant, the elements are of the same mode and the shape functions are scalar and
+// unconstrained.
+bool DiscreteProblem::can_use_ref_matrices(PrecalcShapeset *fu, PrecalcShapeset *fv, AsmList *an, AsmList *am,
+                                           RefMap *ru, RefMap *rv)
+{
+  if (!ru->is_jacobian_const() || !rv->is_jacobian_const()) return false;
+  if (ru->get_active_element()->get_mode() != rv->get_active_element()->get_mode()) return false;
+  if (fu->get_num_components() != 1 || fv->get_num_components() != 1) return false;
+  for (int j = 0; j < an->cnt; j++)
+    if (an->idx[j] < 0) return false;
+  for (int i = 0; i < am->cnt; i++)
+    if (am->idx[i] < 0) return false;
+  return true;
+}
+
+// Evaluation of a constant-coefficient volume matrix form on an affine element (the whole
+// local matrix, without the coefficients of the assembly lists).
+void DiscreteProblem::eval_ref_form(WeakForm::MatrixFormVol *mfv, PrecalcShapeset *fu, PrecalcShapeset *fv,
+                                    AsmList *an, AsmList *am, RefMap *ru, RefMap *rv, scalar **mat)
 {
   _F_
-  for (int i = 0; i < g_max_quad + 1 + 4 * g_max_quad + 4; i++)
+  if (an->cnt == 0 || am->cnt == 0) return;
+
+  // K = |J| T_u^T C T_v, T = [1 0 0; 0 m00 m01; 0 m10 m11]
+  scalar* c = get_const_coefs(mfv);
+  double2x2 &mu = *ru->get_const_inv_ref_map(), &mv = *rv->get_const_inv_ref_map();
+  double tu[3][3] = { { 1.0, 0.0, 0.0 }, { 0.0, mu[0][0], mu[0][1] }, { 0.0, mu[1][0], mu[1][1] } };
+  double tv[3][3] = { { 1.0, 0.0, 0.0 }, { 0.0, mv[0][0], mv[0][1] }, { 0.0, mv[1][0], mv[1][1] } };
+  double jac = ru->get_const_jacobian();
+  scalar k[9];
+  int nk = 0, kidx[9];
+  for (int cc = 0; cc < 3; cc++)
+    for (int d = 0; d < 3; d++)
+    {
+      scalar sum = 0.0;
+      for (int a = 0; a < 3; a++)
+        for (int b = 0; b < 3; b++)
+          sum += tu[a][cc] * c[3*a + b] * tv[b][d];
+      if (sum != 0.0)
+      {
+        k[nk] = jac * sum;
+        kidx[nk++] = 3*cc + d;
+      }
+    }
+
+  // reference integrals of the current pair of shapesets and sub-elements
+  int mode = ru->get_active_element()->get_mode();
+  Shapeset *ssu = fu->get_shapeset(), *ssv = fv->get_shapeset();
+  RefMatrixKey key = { mode, ssu->get_id(), ssv->get_id(), fu->get_transform(), fv->get_transform() };
+  RefMatrices* &rm = ref_matrices[key];
+  if (rm == NULL) rm = new RefMatrices(ssu->get_max_index() + 1, ssv->get_max_index() + 1);
+
+  Quad2D* quad = fu->get_quad_2d();
+  for (int j = 0; j < an->cnt; j++)
   {
-    if (cache_e[i] != NULL)
+    int iu = an->idx[j];
+    if (rm->rows[iu] == NULL)
     {
-      cache_e[i]->free(); delete cache_e[i];
-      delete [] cache_jwt[i];
+      rm->rows[iu] = new double[9 * rm->nv];
+      rm->done[iu] = new char[rm->nv];
+      memset(rm->done[iu], 0, rm->nv);
     }
+    for (int i = 0; i < am->cnt; i++)
+    {
+      int iv = am->idx[i];
+      double *r = rm->rows[iu] + 9 * iv;
+      if (!rm->done[iu][iv])
+      {
+        // exact for the polynomial integrand, the orders of the shape functions add up
+        fu->set_active_shape(iu);
+        fv->set_active_shape(iv);
+        int order = fu->get_fn_order() + fv->get_fn_order();
+        limit_order_nowarn(order);
+        double3* pt = quad->get_points(order);
+        int np = quad->get_num_points(order);
+
+        fu->set_quad_order(order, H2D_FN_ALL);
+        fv->set_quad_order(order, H2D_FN_ALL);
+        double *ru_[3] = { fu->get_fn_values(), fu->get_dx_values(), fu->get_dy_values() };
+        double *rv_[3] = { fv->get_fn_values(), fv->get_dx_values(), fv->get_dy_values() };
+        for (int cc = 0; cc < 3; cc++)
+          for (int d = 0; d < 3; d++)
+          {
+            double sum = 0.0;
+            for (int p = 0; p < np; p++)
+              sum += pt[p][2] * ru_[cc][p] * rv_[d][p];
+            r[3*cc + d] = sum;
+          }
+        rm->done[iu][iv] = 1;
+      }
+
+      scalar val = 0.0;
+      for (int q = 0; q < nk; q++)
+        val += k[q] * r[kidx[q]];
+      mat[i][j] = val;
+    }
+  }
+}
+
+// Constant-coefficient volume matrix forms by sum factorization (see add_matrix_form_const()),
+// the ordinary ones if enabled (see set_sum_factorization()).
+
+// True if the form can be integrated by sum factorization on the current element: both elements
+// are quads with the standard quadrature and the shape functions are unconstrained tensor products.
+bool DiscreteProblem::can_use_tensor_form(PrecalcShapeset *fu, PrecalcShapeset *fv, AsmList *an, AsmList *am,
+                                          RefMap *ru, RefMap *rv)
+{
+  if (ru->get_active_element()->get_mode() != H2D_MODE_QUAD) return false;
+  if (rv->get_active_element()->get_mode() != H2D_MODE_QUAD) return false;
+  if (fu->get_quad_2d() != &g_quad_2d_std || fv->get_quad_2d() != &g_quad_2d_std) return false;
+  if (fu->get_num_components() != 1 || fv->get_num_components() != 1) return false;
+  Shapeset *ssu = fu->get_shapeset(), *ssv = fv->get_shapeset();
+  int a, b;
+  double sign;
+  for (int j = 0; j < an->cnt; j++)
+    if (!ssu->get_tensor_index(an->idx[j], a, b, sign)) return false;
+  for (int i = 0; i < am->cnt; i++)
+    if (!ssv->get_tensor_index(am->idx[i], a, b, sign)) return false;
+  return true;
+}
+
+// The tensor indices of the shape functions of the assembly list and the 1D tables in the
+// points of the 1D rule, mapped to the sub-element of the shape functions (the quad
+// sub-element transformations are scalings in each direction).
+void DiscreteProblem::init_tensor_side(TensorSide &s, PrecalcShapeset *f, AsmList *al, double2 *pt1)
+{
+  Shapeset* ss = f->get_shapeset();
+  Trf* ctm = f->get_ctm();
+  int n1 = tensor_n1;
+  s.a.resize(al->cnt);
+  s.b.resize(al->cnt);
+  s.sign.resize(al->cnt);
+  s.p = 0;
+  for (int j = 0; j < al->cnt; j++)
+  {
+    ss->get_tensor_index(al->idx[j], s.a[j], s.b[j], s.sign[j]);
+    s.p = std::max(s.p, std::max(s.a[j], s.b[j]) + 1);
   }
-  for (std::map<PrecalcShapeset::Key, Func<double>*, PrecalcShapeset::Compare>::const_iterator it = cache_fn.begin(); it != cache_fn.end(); it++)
+  for (int n = 0; n < 2; n++)
   {
-    (it->second)->free_fn(); delete (it->second);
+    s.x[n].resize(s.p * n1);
+    s.y[n].resize(s.p * n1);
+    for (int a = 0; a < s.p; a++)
+      for (int i = 0; i < n1; i++)
+      {
+        s.x[n][a * n1 + i] = ss->get_tensor_value_1d(n, a, ctm->m[0] * pt1[i][0] + ctm->t[0]);
+        s.y[n][a * n1 + i] = ss->get_tensor_value_1d(n, a, ctm->m[1] * pt1[i][0] + ctm->t[1]);
+      }
   }
-  cache_fn.clear();
 }
 
-////////////////////////////////////////////////////////////////////////////////////////////////////
+// Points the arrays of 'view' (one point) to the point 'p' of the arrays of 'fn'.
+template<typename T>
+static void shift_fn(Func<T>* view, Func<T>* fn, int p)
+{
+#define H2D_SHIFT(__ATTRIB) view->__ATTRIB = (fn->__ATTRIB != NULL) ? fn->__ATTRIB + p : NULL;
+  H2D_SHIFT(val) H2D_SHIFT(dx) H2D_SHIFT(dy)
+#ifdef H2D_SECOND_DERIVATIVES_ENABLED
+  H2D_SHIFT(laplace)
+#endif
+  H2D_SHIFT(val0) H2D_SHIFT(val1) H2D_SHIFT(dx0) H2D_SHIFT(dx1) H2D_SHIFT(dy0) H2D_SHIFT(dy1) H2D_SHIFT(curl)
+#undef H2D_SHIFT
+}
 
-// Actual evaluation of volume matrix form (calculates integral)
-scalar DiscreteProblem::eval_form(WeakForm::MatrixFormVol *mfv, Tuple<Solution *> u_ext, 
-                        PrecalcShapeset *fu, PrecalcShapeset *fv, RefMap *ru, RefMap *rv)
+// The matrices C of an ordinary volume matrix form in the points of the quadrature of the order
+// 'order' (tensor_c): C[3*a + b] = a(U = e_a, V = e_b) as in get_const_coefs(), evaluated in
+// each point separately with the previous iterations, the external functions and the geometry
+// of the point (the arrays shifted, not copied).
+void DiscreteProblem::get_point_coefs(WeakForm::MatrixFormVol *mfv, Tuple<Solution *> u_ext,
+                                      RefMap *ru, RefMap *rv, int order)
 {
   _F_
-  // Determine the integration order.
-  int inc = (fu->get_num_components() == 2) ? 1 : 0;
-  
-  // Order of solutions from the previous Newton iteration.
-  AUTOLA_OR(Func<Ord>*, oi, wf->neq);
-  if (u_ext != Tuple<Solution *>()) {
-    for (int i = 0; i < wf->neq; i++) {
-      if (u_ext[i] != NULL) oi[i] = init_fn_ord(u_ext[i]->get_fn_order() + inc);
-      else oi[i] = init_fn_ord(0);
-    }
-  }
-  else {
-    for (int i = 0; i < wf->neq; i++) oi[i] = init_fn_ord(0);
-  }
-  
-  // Order of shape functions.
-  Func<Ord>* ou = init_fn_ord(fu->get_fn_order() + inc);
-  Func<Ord>* ov = init_fn_ord(fv->get_fn_order() + inc);
-  
-  // Order of additional external functions.
-  ExtData<Ord>* fake_ext = init_ext_fns_ord(mfv->ext);
-  
-  // Order of geometric attributes (eg. for multiplication of a solution with coordinates, normals, etc.).
-  double fake_wt = 1.0;
-  Geom<Ord>* fake_e = init_geom_ord();
-  
-  // Total order of the matrix form.
-  Ord o = mfv->ord(1, &fake_wt, oi, ou, ov, fake_e, fake_ext);
-  
-  // Increase due to reference map.
-  int order = ru->get_inv_ref_order();
-  order += o.get_order();
-  limit_order_nowarn(order);
-  
-  // Clean up.
-  for (int i = 0; i < wf->neq; i++) {  
-    if (oi[i] != NULL) { oi[i]->free_ord(); delete oi[i]; }
-  }
-  if (ou != NULL) {
-    ou->free_ord(); delete ou;
-  }
-  if (ov != NULL) {
-    ov->free_ord(); delete ov;
-  }
-  if (fake_e != NULL) delete fake_e;
-  if (fake_ext != NULL) {fake_ext->free_ord(); delete fake_ext;}
-  
-  // Evaluate the form using the quadrature of the just calculated order.
-  Quad2D* quad = fu->get_quad_2d();
+  Quad2D* quad = ru->get_quad_2d();
   double3* pt = quad->get_points(order);
   int np = quad->get_num_points(order);
 
@@ -763,11 +2117,9 @@ scalar DiscreteProblem::eval_form(WeakForm::MatrixFormVol *mfv, Tuple<Solution *
       cache_jwt[order][i] = pt[i][2] * jac[i];
   }
   Geom<double>* e = cache_e[order];
-  double* jwt = cache_jwt[order];
 
-  // Values of the previous Newton iteration, shape functions and external functions in quadrature points.
+  // Values of the previous Newton iteration and external functions in quadrature points.
   AUTOLA_OR(Func<scalar>*, prev, wf->neq);
-  //for (int i = 0; i < wf->neq; i++) prev[i]  = init_fn(sln[i], rv, order);
   if (u_ext != Tuple<Solution *>()) {
     for (int i = 0; i < wf->neq; i++) {
       if (u_ext[i] != NULL) prev[i] = init_fn(u_ext[i], rv, order);
@@ -777,20 +2129,294 @@ scalar DiscreteProblem::eval_form(WeakForm::MatrixFormVol *mfv, Tuple<Solution *
   else {
     for (int i = 0; i < wf->neq; i++) prev[i] = NULL;
   }
-
-  Func<double>* u = get_fn(fu, ru, order);
-  Func<double>* v = get_fn(fv, rv, order);
   ExtData<scalar>* ext = init_ext_fns(mfv->ext, rv, order);
-  
-  scalar res = mfv->fn(np, jwt, prev, u, v, e, ext);
-  
-  // Clean up.
+
+  // their views of one point
+  AUTOLA_OR(Func<scalar>*, prev_pt, wf->neq);
+  for (int i = 0; i < wf->neq; i++)
+    prev_pt[i] = (prev[i] != NULL) ? new Func<scalar>(1, prev[i]->nc) : NULL;
+  ExtData<scalar> ext_pt;
+  ext_pt.nf = ext->nf;
+  ext_pt.fn = new Func<scalar>*[ext->nf];
+  for (int i = 0; i < ext->nf; i++)
+    ext_pt.fn[i] = (ext->fn[i] != NULL) ? new Func<scalar>(1, ext->fn[i]->nc) : NULL;
+  Geom<double> e_pt = *e;
+
+  double uval[3] = { 0.0, 0.0, 0.0 }, vval[3] = { 0.0, 0.0, 0.0 };
+  Func<double> u(1, 1), v(1, 1);
+  u.val = uval; u.dx = uval + 1; u.dy = uval + 2;
+  v.val = vval; v.dx = vval + 1; v.dy = vval + 2;
+  double wt = 1.0;
+
+  tensor_c.resize(9 * np);
+  for (int p = 0; p < np; p++)
+  {
+    for (int i = 0; i < wf->neq; i++)
+      if (prev[i] != NULL) shift_fn(prev_pt[i], prev[i], p);
+    for (int i = 0; i < ext->nf; i++)
+      if (ext->fn[i] != NULL) shift_fn(ext_pt.fn[i], ext->fn[i], p);
+    e_pt.x = e->x + p;
+    e_pt.y = e->y + p;
+
+    scalar* c = &tensor_c[9 * p];
+    for (int a = 0; a < 3; a++)
+    {
+      uval[a] = 1.0;
+      for (int b = 0; b < 3; b++)
+      {
+        vval[b] = 1.0;
+        c[3*a + b] = mfv->fn(1, &wt, prev_pt, &u, &v, &e_pt, &ext_pt);
+        vval[b] = 0.0;
+      }
+      uval[a] = 0.0;
+    }
+  }
+
+  // Clean up (the views do not own their arrays).
+  for (int i = 0; i < wf->neq; i++) delete prev_pt[i];
+  for (int i = 0; i < ext->nf; i++) delete ext_pt.fn[i];
+  delete [] ext_pt.fn;
   for (int i = 0; i < wf->neq; i++) {  
     if (prev[i] != NULL) prev[i]->free_fn(); delete prev[i]; 
   }
-  if (ext != NULL) {ext->free(); delete ext;}
+  ext->free(); delete ext;
+}
 
-  return res;
+// Prepares the 1D tables of both sides and the coefficients K_cd = |J| w (T_u^T C T_v)_cd in
+// the points (the point i * n1 + j of the quad rule is (x_i, y_j)), only for the pairs of the
+// reference components (c, d) that are not identically zero.
+void DiscreteProblem::init_tensor_form(WeakForm::MatrixFormVol *mfv, Tuple<Solution *> u_ext,
+                                       PrecalcShapeset *fu, PrecalcShapeset *fv, AsmList *an, AsmList *am,
+                                       RefMap *ru, RefMap *rv)
+{
+  // the order of the pair of the highest orders on the element, as in eval_elem_form()
+  int max_order_u = 0, max_order_v = 0;
+  for (int j = 0; j < an->cnt; j++)
+  {
+    fu->set_active_shape(an->idx[j]);
+    max_order_u = std::max(max_order_u, fu->get_fn_order());
+  }
+  for (int i = 0; i < am->cnt; i++)
+  {
+    fv->set_active_shape(am->idx[i]);
+    max_order_v = std::max(max_order_v, fv->get_fn_order());
+  }
+  int order = calc_order_matrix_form_vol(mfv, u_ext, 0, max_order_u, max_order_v, ru);
+
+  tensor_n1 = g_quad_1d_std.get_num_points(order);
+  double2* pt1 = g_quad_1d_std.get_points(order);
+  int np = tensor_n1 * tensor_n1;
+  assert(np == g_quad_2d_std.get_num_points(order));
+  init_tensor_side(tensor_u, fu, an, pt1);
+  init_tensor_side(tensor_v, fv, am, pt1);
+
+  // the matrix C of a constant-coefficient form is the same in all the points
+  scalar* c;
+  int c_stride = 0;
+  if (mfv->const_coef) c = get_const_coefs(mfv);
+  else
+  {
+    get_point_coefs(mfv, u_ext, ru, rv, order);
+    c = &tensor_c[0];
+    c_stride = 9;
+  }
+  double3* pt = g_quad_2d_std.get_points(order);
+  double* jac = ru->get_jacobian(order);
+  double2x2 *mu = ru->get_inv_ref_map(order), *mv = rv->get_inv_ref_map(order);
+  tensor_k.resize(9 * np);
+  tensor_nk = 0;
+  for (int cc = 0; cc < 3; cc++)
+    for (int d = 0; d < 3; d++)
+    {
+      scalar* k = &tensor_k[tensor_nk * np];
+      bool nonzero = false;
+      for (int p = 0; p < np; p++)
+      {
+        // columns cc and d of T = [1 0 0; 0 m00 m01; 0 m10 m11]
+        double tu[3] = { cc == 0 ? 1.0 : 0.0, cc ? mu[p][0][cc-1] : 0.0, cc ? mu[p][1][cc-1] : 0.0 };
+        double tv[3] = { d == 0 ? 1.0 : 0.0, d ? mv[p][0][d-1] : 0.0, d ? mv[p][1][d-1] : 0.0 };
+        scalar sum = 0.0;
+        for (int a = 0; a < 3; a++)
+          for (int b = 0; b < 3; b++)
+            sum += tu[a] * c[p * c_stride + 3*a + b] * tv[b];
+        if (sum != 0.0) nonzero = true;
+        k[p] = pt[p][2] * jac[p] * sum;
+      }
+      if (nonzero) tensor_kidx[tensor_nk++] = 3*cc + d;
+    }
+}
+
+// Evaluation of a volume matrix form by sum factorization (the whole local matrix, without the
+// coefficients of the assembly lists). With the shape functions s_j f_a(x) f_b(y),
+// mat[i][j] = s_i s_j sum_cd sum_y T_cd(a_j, a_i, y) F_b_j(y) F_b_i(y),
+// where T_cd(a_u, a_v, y) = sum_x K_cd(x, y) F_a_u(x) F_a_v(x) is integrated first.
+void DiscreteProblem::eval_tensor_form(WeakForm::MatrixFormVol *mfv, Tuple<Solution *> u_ext,
+                                       PrecalcShapeset *fu, PrecalcShapeset *fv, AsmList *an, AsmList *am,
+                                       RefMap *ru, RefMap *rv, scalar **mat)
+{
+  _F_
+  if (an->cnt == 0 || am->cnt == 0) return;
+  init_tensor_form(mfv, u_ext, fu, fv, an, am, ru, rv);
+  int n1 = tensor_n1, pu = tensor_u.p, pv = tensor_v.p;
+
+  // integration in x
+  std::vector<scalar> &t = tensor_tmp;
+  t.assign(tensor_nk * pu * pv * n1, 0.0);
+  for (int q = 0; q < tensor_nk; q++)
+  {
+    int cc = tensor_kidx[q] / 3, d = tensor_kidx[q] % 3;
+    double* xu = &tensor_u.x[cc == 1][0];
+    double* xv = &tensor_v.x[d == 1][0];
+    scalar* k = &tensor_k[q * n1 * n1];
+    for (int au = 0; au < pu; au++)
+      for (int av = 0; av < pv; av++)
+      {
+        scalar* r = &t[((q * pu + au) * pv + av) * n1];
+        for (int i = 0; i < n1; i++)
+        {
+          double w = xu[au * n1 + i] * xv[av * n1 + i];
+          for (int j = 0; j < n1; j++)
+            r[j] += w * k[i * n1 + j];
+        }
+      }
+  }
+
+  // integration in y
+  for (int i = 0; i < am->cnt; i++)
+    for (int j = 0; j < an->cnt; j++)
+    {
+      scalar sum = 0.0;
+      for (int q = 0; q < tensor_nk; q++)
+      {
+        int cc = tensor_kidx[q] / 3, d = tensor_kidx[q] % 3;
+        double* yu = &tensor_u.y[cc == 2][tensor_u.b[j] * n1];
+        double* yv = &tensor_v.y[d == 2][tensor_v.b[i] * n1];
+        scalar* r = &t[((q * pu + tensor_u.a[j]) * pv + tensor_v.a[i]) * n1];
+        for (int l = 0; l < n1; l++)
+          sum += r[l] * yu[l] * yv[l];
+      }
+      mat[i][j] = tensor_u.sign[j] * tensor_v.sign[i] * sum;
+    }
+}
+
+// y += A x for the local matrix A of the prepared form (A^T x if 'transpose'), evaluated by sum
+// factorization without A: the reference components of the function x in the points, their
+// combination by the coefficients K_cd and the integration against the shape functions of 'to'.
+void DiscreteProblem::apply_tensor(TensorSide &from, TensorSide &to, bool transpose, scalar *x, scalar *y)
+{
+  int n1 = tensor_n1, np = n1 * n1;
+  bool need_from[3] = { false, false, false }, need_to[3] = { false, false, false };
+  for (int q = 0; q < tensor_nk; q++)
+  {
+    int cc = tensor_kidx[q] / 3, d = tensor_kidx[q] % 3;
+    need_from[transpose ? d : cc] = need_to[transpose ? cc : d] = true;
+  }
+
+  // the coefficients on the grid of the 1D indices
+  int pf = from.p, pt = to.p;
+  std::vector<scalar> &grid = tensor_grid;
+  grid.assign(std::max(pf * pf, pt * pt), 0.0);
+  for (unsigned int s = 0; s < from.a.size(); s++)
+    grid[from.a[s] * pf + from.b[s]] += from.sign[s] * x[s];
+
+  // the components in the points: integrated in x, then in y
+  std::vector<scalar> &in = tensor_in, &w = tensor_tmp;
+  in.assign(3 * np, 0.0);
+  w.resize(n1 * std::max(pf, pt));
+  for (int c = 0; c < 3; c++)
+  {
+    if (!need_from[c]) continue;
+    double *fx = &from.x[c == 1][0], *fy = &from.y[c == 2][0];
+    for (int i = 0; i < n1; i++)
+      for (int b = 0; b < pf; b++)
+      {
+        scalar sum = 0.0;
+        for (int a = 0; a < pf; a++)
+          sum += fx[a * n1 + i] * grid[a * pf + b];
+        w[i * pf + b] = sum;
+      }
+    scalar* f = &in[c * np];
+    for (int i = 0; i < n1; i++)
+      for (int j = 0; j < n1; j++)
+      {
+        scalar sum = 0.0;
+        for (int b = 0; b < pf; b++)
+          sum += w[i * pf + b] * fy[b * n1 + j];
+        f[i * n1 + j] = sum;
+      }
+  }
+
+  // combination by the coefficients
+  std::vector<scalar> &out = tensor_out;
+  out.assign(3 * np, 0.0);
+  for (int q = 0; q < tensor_nk; q++)
+  {
+    int cc = tensor_kidx[q] / 3, d = tensor_kidx[q] % 3;
+    if (transpose) std::swap(cc, d);
+    scalar *k = &tensor_k[q * np], *f = &in[cc * np], *g = &out[d * np];
+    for (int p = 0; p < np; p++)
+      g[p] += k[p] * f[p];
+  }
+
+  // integration against the shape functions: in y, then in x
+  grid.assign(pt * pt, 0.0);
+  for (int d = 0; d < 3; d++)
+  {
+    if (!need_to[d]) continue;
+    double *tx = &to.x[d == 1][0], *ty = &to.y[d == 2][0];
+    scalar* g = &out[d * np];
+    for (int i = 0; i < n1; i++)
+      for (int b = 0; b < pt; b++)
+      {
+        scalar sum = 0.0;
+        for (int j = 0; j < n1; j++)
+          sum += g[i * n1 + j] * ty[b * n1 + j];
+        w[i * pt + b] = sum;
+      }
+    for (int a = 0; a < pt; a++)
+      for (int b = 0; b < pt; b++)
+      {
+        scalar sum = 0.0;
+        for (int i = 0; i < n1; i++)
+          sum += tx[a * n1 + i] * w[i * pt + b];
+        grid[a * pt + b] += sum;
+      }
+  }
+  for (unsigned int t = 0; t < to.a.size(); t++)
+    y[t] += to.sign[t] * grid[to.a[t] * pt + to.b[t]];
+}
+
+// Matrix-free product (see apply()) of a constant-coefficient volume matrix form by sum
+// factorization. 'sym' is the symmetry flag of an off-diagonal block of a symmetric or
+// antisymmetric form, whose transposed block is added too (0 otherwise).
+void DiscreteProblem::apply_tensor_form(WeakForm::MatrixFormVol *mfv, Tuple<Solution *> u_ext,
+                                        PrecalcShapeset *fu, PrecalcShapeset *fv, AsmList *an, AsmList *am,
+                                        RefMap *ru, RefMap *rv, int sym)
+{
+  _F_
+  if (an->cnt == 0 || am->cnt == 0) return;
+  init_tensor_form(mfv, u_ext, fu, fv, an, am, ru, rv);
+
+  // the Dirichlet lift is not a part of the product
+  std::vector<scalar> &xl = tensor_xl, &yl = tensor_yl;
+  xl.resize(an->cnt);
+  for (int j = 0; j < an->cnt; j++)
+    xl[j] = (an->dof[j] >= 0) ? apply_x[an->dof[j]] * an->coef[j] : 0.0;
+  yl.assign(am->cnt, 0.0);
+  apply_tensor(tensor_u, tensor_v, false, &xl[0], &yl[0]);
+  for (int i = 0; i < am->cnt; i++)
+    if (am->dof[i] >= 0) apply_y[am->dof[i]] += am->coef[i] * yl[i];
+
+  if (sym != 0)
+  {
+    xl.resize(am->cnt);
+    for (int i = 0; i < am->cnt; i++)
+      xl[i] = (am->dof[i] >= 0) ? apply_x[am->dof[i]] * am->coef[i] : 0.0;
+    yl.assign(an->cnt, 0.0);
+    apply_tensor(tensor_v, tensor_u, true, &xl[0], &yl[0]);
+    for (int j = 0; j < an->cnt; j++)
+      if (an->dof[j] >= 0) apply_y[an->dof[j]] += (double) sym * an->coef[j] * yl[j];
+  }
 }
 
 // Actual evaluation of volume vector form (calculates integral)
@@ -799,48 +2425,54 @@ scalar DiscreteProblem::eval_form(WeakForm::VectorFormVol *vfv, Tuple<Solution *
   _F_
   // Determine the integration order.
   int inc = (fv->get_num_components() == 2) ? 1 : 0;
-  
-  // Order of solutions from the previous Newton iteration.
-  AUTOLA_OR(Func<Ord>*, oi, wf->neq);
-  //for (int i = 0; i < wf->neq; i++) oi[i] = init_fn_ord(sln[i]->get_fn_order() + inc);
-  if (u_ext != Tuple<Solution *>()) {
-    for (int i = 0; i < wf->neq; i++) {
-      if (u_ext[i] != NULL) oi[i] = init_fn_ord(u_ext[i]->get_fn_order() + inc);
-      else oi[i] = init_fn_ord(0);
+  int* form_order = get_cached_order(vfv, u_ext, inc, 0, fv->get_fn_order() + inc,
+                                     vfv->ext, -1);
+  if (*form_order < 0)
+  {
+    // Order of solutions from the previous Newton iteration.
+    AUTOLA_OR(Func<Ord>*, oi, wf->neq);
+    //for (int i = 0; i < wf->neq; i++) oi[i] = init_fn_ord(sln[i]->get_fn_order() + inc);
+    if (u_ext != Tuple<Solution *>()) {
+      for (int i = 0; i < wf->neq; i++) {
+        if (u_ext[i] != NULL) oi[i] = init_fn_ord(u_ext[i]->get_fn_order() + inc);
+        else oi[i] = init_fn_ord(0);
+      }
     }
+    else {
+      for (int i = 0; i < wf->neq; i++) oi[i] = init_fn_ord(0);
+    }
+
+    // Order of the shape function.
+    Func<Ord>* ov = init_fn_ord(fv->get_fn_order() + inc);
+
+    // Order of additional external functions.
+    ExtData<Ord>* fake_ext = init_ext_fns_ord(vfv->ext);
+
+    // Order of geometric attributes (eg. for multiplication of a solution with coordinates, normals, etc.).
+    double fake_wt = 1.0;
+    Geom<Ord>* fake_e = init_geom_ord();
+
+    // Total order of the vector form.
+    Ord o = vfv->ord(1, &fake_wt, oi, ov, fake_e, fake_ext);
+
+    // Clean up.
+    for (int i = 0; i < wf->neq; i++) { 
+      if (oi[i] != NULL) {
+        oi[i]->free_ord(); delete oi[i]; 
+      }
+    }
+    if (ov != NULL) {ov->free_ord(); delete ov;}
+    if (fake_e != NULL) delete fake_e;
+    if (fake_ext != NULL) {fake_ext->free_ord(); delete fake_ext;}
+
+    *form_order = o.get_order();
   }
-  else {
-    for (int i = 0; i < wf->neq; i++) oi[i] = init_fn_ord(0);
-  }
-  
-  // Order of the shape function.
-  Func<Ord>* ov = init_fn_ord(fv->get_fn_order() + inc);
-  
-  // Order of additional external functions.
-  ExtData<Ord>* fake_ext = init_ext_fns_ord(vfv->ext);
-  
-  // Order of geometric attributes (eg. for multiplication of a solution with coordinates, normals, etc.).
-  double fake_wt = 1.0;
-  Geom<Ord>* fake_e = init_geom_ord();
-  
-  // Total order of the vector form.
-  Ord o = vfv->ord(1, &fake_wt, oi, ov, fake_e, fake_ext);
-  
+
   // Increase due to reference map.
   int order = rv->get_inv_ref_order();
-  order += o.get_order();
+  order += *form_order;
   limit_order_nowarn(order);
 
-  // Clean up.
-  for (int i = 0; i < wf->neq; i++) { 
-    if (oi[i] != NULL) {
-      oi[i]->free_ord(); delete oi[i]; 
-    }
-  }
-  if (ov != NULL) {ov->free_ord(); delete ov;}
-  if (fake_e != NULL) delete fake_e;
-  if (fake_ext != NULL) {fake_ext->free_ord(); delete fake_ext;}
-
   // Evaluate the form using the quadrature of the just calculated order.
   Quad2D* quad = fv->get_quad_2d();
   double3* pt = quad->get_points(order);
@@ -894,53 +2526,58 @@ scalar DiscreteProblem::eval_form(WeakForm::MatrixFormSurf *mfs, Tuple<Solution
   _F_
   // Determine the integration order.
   int inc = (fu->get_num_components() == 2) ? 1 : 0;
-  
-  // Order of solutions from the previous Newton iteration.
-  AUTOLA_OR(Func<Ord>*, oi, wf->neq);
-  //for (int i = 0; i < wf->neq; i++) oi[i] = init_fn_ord(sln[i]->get_fn_order() + inc);
-  if (u_ext != Tuple<Solution *>()) {
-    for (int i = 0; i < wf->neq; i++) {
-      if (u_ext[i] != NULL) oi[i] = init_fn_ord(u_ext[i]->get_edge_fn_order(surf_pos->surf_num) + inc);
-      else oi[i] = init_fn_ord(0);
+  int* form_order = get_cached_order(mfs, u_ext, inc, fu->get_edge_fn_order(surf_pos->surf_num) + inc, fv->get_edge_fn_order(surf_pos->surf_num) + inc,
+                                     mfs->ext, surf_pos->surf_num);
+  if (*form_order < 0)
+  {
+    // Order of solutions from the previous Newton iteration.
+    AUTOLA_OR(Func<Ord>*, oi, wf->neq);
+    //for (int i = 0; i < wf->neq; i++) oi[i] = init_fn_ord(sln[i]->get_fn_order() + inc);
+    if (u_ext != Tuple<Solution *>()) {
+      for (int i = 0; i < wf->neq; i++) {
+        if (u_ext[i] != NULL) oi[i] = init_fn_ord(u_ext[i]->get_edge_fn_order(surf_pos->surf_num) + inc);
+        else oi[i] = init_fn_ord(0);
+      }
     }
+    else {
+      for (int i = 0; i < wf->neq; i++) oi[i] = init_fn_ord(0);
+    }
+
+    // Order of shape functions.
+    Func<Ord>* ou = init_fn_ord(fu->get_edge_fn_order(surf_pos->surf_num) + inc);
+    Func<Ord>* ov = init_fn_ord(fv->get_edge_fn_order(surf_pos->surf_num) + inc);
+
+    // Order of additional external functions.
+    ExtData<Ord>* fake_ext = init_ext_fns_ord(mfs->ext, surf_pos->surf_num);
+
+    // Order of geometric attributes (eg. for multiplication of a solution with coordinates, normals, etc.).
+    double fake_wt = 1.0;
+    Geom<Ord>* fake_e = init_geom_ord();
+
+    // Total order of the matrix form.
+    Ord o = mfs->ord(1, &fake_wt, oi, ou, ov, fake_e, fake_ext);
+
+    // Clean up.
+    for (int i = 0; i < wf->neq; i++) {  
+      if (oi[i] != NULL) { oi[i]->free_ord(); delete oi[i]; }
+    }
+    if (ou != NULL) {
+      ou->free_ord(); delete ou;
+    }
+    if (ov != NULL) {
+      ov->free_ord(); delete ov;
+    }
+    if (fake_e != NULL) delete fake_e;
+    if (fake_ext != NULL) {fake_ext->free_ord(); delete fake_ext;}
+
+    *form_order = o.get_order();
   }
-  else {
-    for (int i = 0; i < wf->neq; i++) oi[i] = init_fn_ord(0);
-  }
-  
-  // Order of shape functions.
-  Func<Ord>* ou = init_fn_ord(fu->get_edge_fn_order(surf_pos->surf_num) + inc);
-  Func<Ord>* ov = init_fn_ord(fv->get_edge_fn_order(surf_pos->surf_num) + inc);
-  
-  // Order of additional external functions.
-  ExtData<Ord>* fake_ext = init_ext_fns_ord(mfs->ext, surf_pos->surf_num);
-  
-  // Order of geometric attributes (eg. for multiplication of a solution with coordinates, normals, etc.).
-  double fake_wt = 1.0;
-  Geom<Ord>* fake_e = init_geom_ord();
-  
-  // Total order of the matrix form.
-  Ord o = mfs->ord(1, &fake_wt, oi, ou, ov, fake_e, fake_ext);
-  
+
   // Increase due to reference map.
   int order = ru->get_inv_ref_order();
-  
-  order += o.get_order();
+  order += *form_order;
   limit_order_nowarn(order);
-  
-  // Clean up.
-  for (int i = 0; i < wf->neq; i++) {  
-    if (oi[i] != NULL) { oi[i]->free_ord(); delete oi[i]; }
-  }
-  if (ou != NULL) {
-    ou->free_ord(); delete ou;
-  }
-  if (ov != NULL) {
-    ov->free_ord(); delete ov;
-  }
-  if (fake_e != NULL) delete fake_e;
-  if (fake_ext != NULL) {fake_ext->free_ord(); delete fake_ext;}
-  
+
   // Evaluate the form using the quadrature of the just calculated order.
   Quad2D* quad = fu->get_quad_2d();
   
@@ -999,49 +2636,54 @@ scalar DiscreteProblem::eval_form(WeakForm::VectorFormSurf *vfs, Tuple<Solution
   _F_
   // Determine the integration order.
   int inc = (fv->get_num_components() == 2) ? 1 : 0;
-  
-  // Order of solutions from the previous Newton iteration.
-  AUTOLA_OR(Func<Ord>*, oi, wf->neq);
-  //for (int i = 0; i < wf->neq; i++) oi[i] = init_fn_ord(sln[i]->get_fn_order() + inc);
-  if (u_ext != Tuple<Solution *>()) {
-    for (int i = 0; i < wf->neq; i++) {
-      if (u_ext[i] != NULL) oi[i] = init_fn_ord(u_ext[i]->get_edge_fn_order(surf_pos->surf_num) + inc);
-      else oi[i] = init_fn_ord(0);
+  int* form_order = get_cached_order(vfs, u_ext, inc, 0, fv->get_edge_fn_order(surf_pos->surf_num) + inc,
+                                     vfs->ext, surf_pos->surf_num);
+  if (*form_order < 0)
+  {
+    // Order of solutions from the previous Newton iteration.
+    AUTOLA_OR(Func<Ord>*, oi, wf->neq);
+    //for (int i = 0; i < wf->neq; i++) oi[i] = init_fn_ord(sln[i]->get_fn_order() + inc);
+    if (u_ext != Tuple<Solution *>()) {
+      for (int i = 0; i < wf->neq; i++) {
+        if (u_ext[i] != NULL) oi[i] = init_fn_ord(u_ext[i]->get_edge_fn_order(surf_pos->surf_num) + inc);
+        else oi[i] = init_fn_ord(0);
+      }
     }
+    else {
+      for (int i = 0; i < wf->neq; i++) oi[i] = init_fn_ord(0);
+    }
+
+    // Order of the shape function.
+    Func<Ord>* ov = init_fn_ord(fv->get_edge_fn_order(surf_pos->surf_num) + inc);
+
+    // Order of additional external functions.
+    ExtData<Ord>* fake_ext = init_ext_fns_ord(vfs->ext, surf_pos->surf_num);
+
+    // Order of geometric attributes (eg. for multiplication of a solution with coordinates, normals, etc.).
+    double fake_wt = 1.0;
+    Geom<Ord>* fake_e = init_geom_ord();
+
+    // Total order of the vector form.
+    Ord o = vfs->ord(1, &fake_wt, oi, ov, fake_e, fake_ext);
+
+    // Clean up.
+    for (int i = 0; i < wf->neq; i++) { 
+      if (oi[i] != NULL) {
+        oi[i]->free_ord(); delete oi[i]; 
+      }
+    }
+    if (ov != NULL) {ov->free_ord(); delete ov;}
+    if (fake_e != NULL) delete fake_e;
+    if (fake_ext != NULL) {fake_ext->free_ord(); delete fake_ext;}
+
+    *form_order = o.get_order();
   }
-  else {
-    for (int i = 0; i < wf->neq; i++) oi[i] = init_fn_ord(0);
-  }
-  
-  // Order of the shape function.
-  Func<Ord>* ov = init_fn_ord(fv->get_edge_fn_order(surf_pos->surf_num) + inc);
-  
-  // Order of additional external functions.
-  ExtData<Ord>* fake_ext = init_ext_fns_ord(vfs->ext, surf_pos->surf_num);
-  
-  // Order of geometric attributes (eg. for multiplication of a solution with coordinates, normals, etc.).
-  double fake_wt = 1.0;
-  Geom<Ord>* fake_e = init_geom_ord();
-  
-  // Total order of the vector form.
-  Ord o = vfs->ord(1, &fake_wt, oi, ov, fake_e, fake_ext);
-  
+
   // Increase due to reference map.
   int order = rv->get_inv_ref_order();
-  
-  order += o.get_order();
+  order += *form_order;
   limit_order_nowarn(order);
-  
-  // Clean up.
-  for (int i = 0; i < wf->neq; i++) { 
-    if (oi[i] != NULL) {
-      oi[i]->free_ord(); delete oi[i]; 
-    }
-  }
-  if (ov != NULL) {ov->free_ord(); delete ov;}
-  if (fake_e != NULL) delete fake_e;
-  if (fake_ext != NULL) {fake_ext->free_ord(); delete fake_ext;}
-  
+
   // Evaluate the form using the quadrature of the just calculated order.
   Quad2D* quad = fv->get_quad_2d();
   
@@ -1128,3 +2770,51 @@ Space* construct_refined_space(Space* coarse, int order_increase)
   ref_space->copy_orders(coarse, order_increase);
   return ref_space;
 }
+
+/* BEGIN IDENTICAL CODE WITH H3D */
+
+DiscreteProblemOperator::DiscreteProblemOperator(DiscreteProblem* dp, scalar* coeff_vec, bool finite_differences)
+{
+  _F_
+  if (dp == NULL) error("DiscreteProblem is NULL in DiscreteProblemOperator.");
+  this->dp = dp;
+  this->coeff_vec = coeff_vec;
+  this->finite_differences = finite_differences;
+  f0 = NULL;
+}
+
+DiscreteProblemOperator::~DiscreteProblemOperator()
+{
+  _F_
+  if (f0 != NULL) delete [] f0;
+}
+
+void DiscreteProblemOperator::set_coeff_vec(scalar* coeff_vec)
+{
+  _F_
+  this->coeff_vec = coeff_vec;
+  // the residual belongs to the previous coefficient vector
+  if (f0 != NULL) delete [] f0;
+  f0 = NULL;
+}
+
+void DiscreteProblemOperator::apply(scalar* x, scalar* y)
+{
+  _F_
+  if (!finite_differences)
+  {
+    dp->apply(coeff_vec, x, y);
+    return;
+  }
+
+  // F(Y) is assembled by the first product and kept for the next ones
+  if (f0 == NULL)
+  {
+    f0 = new scalar[dp->get_num_dofs()];
+    MEM_CHECK(f0);
+    dp->assemble_residual(coeff_vec, f0);
+  }
+  dp->apply_fd(coeff_vec, x, y, f0);
+}
+
+/* END IDENTICAL CODE WITH H3D */
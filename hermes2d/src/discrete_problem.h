@@ -18,6 +18,7 @@
 #define __H2D_FEPROBLEM_H
 
 #include "../../hermes_common/matrix.h"
+#include "../../hermes_common/scatter_map.h"
 #include "adapt/adapt.h"
 #include "graph.h"
 #include "forms.h"
@@ -36,6 +37,9 @@ class Matrix;
 class SparseMatrix;
 class Vector;
 class Solver;
+class BlockJacobiPrecond;
+class PMultigridPrecond;
+struct AsmBuffer;
 
 /// Instantiated template. It is used to create a clean Windows DLL interface.
 HERMES_API_USED_TEMPLATE(Tuple<ProjNormType>);
@@ -69,10 +73,30 @@ public:
   // previous Newton vector.
   void assemble(scalar* coeff_vec, SparseMatrix* mat, Vector* rhs = NULL, bool rhsonly = false);
 
+  // Assembling of several right-hand sides in one traversal of the mesh: the vector forms
+  // added to the weak form with the index 'r' are assembled into rhs[r] (see 
+  // WeakForm::add_vector_form()). The Dirichlet lift is subtracted from all of them.
+  void assemble(scalar* coeff_vec, SparseMatrix* mat, Vector** rhs, int nrhs, bool rhsonly = false);
+
   // Assembling for linear problems. Same as the previous functions, but 
   // does not need the coeff_vector.
   void assemble(SparseMatrix* mat, Vector* rhs = NULL, bool rhsonly = false);
 
+  // Matrix-free product with the matrix (with the Jacobian matrix at 'coeff_vec' for nonlinear
+  // problems): y = A x is accumulated from the local stiffness matrices element by element,
+  // neither the global matrix nor its sparse structure is created. 'x' and 'y' have
+  // get_num_dofs() entries. The Dirichlet lift is not applied.
+  void apply(scalar* coeff_vec, scalar* x, scalar* y);
+
+  // Finite-difference product with the Jacobian matrix of a nonlinear problem using the residual
+  // vector F (the vector forms) only: y = (F(Y + eps x) - F(Y)) / eps, Y = coeff_vec. 'f0' may hold
+  // F(Y) to save one assembling; eps = 0 selects sqrt(machine epsilon) * (1 + |Y|) / |x|.
+  void apply_fd(scalar* coeff_vec, scalar* x, scalar* y, scalar* f0 = NULL, double eps = 0.0);
+
+  // The residual vector F(Y) of apply_fd() as an array, the sparse structure of the matrix
+  // is not touched.
+  void assemble_residual(scalar* coeff_vec, scalar* f);
+
   // Get the number of unknowns.
   int get_num_dofs();
 
@@ -80,6 +104,71 @@ public:
 
   void invalidate_matrix() { have_matrix = false; }
 
+  // Precompute scatter maps of local stiffness matrices in create() and use them
+  // (instead of searching the sparse structure) in every assemble() until the
+  // spaces change. Costs one int per entry of every local stiffness matrix.
+  void set_scatter_maps(bool enable = true) { use_scatter_maps = enable; have_matrix = false; }
+
+  // Store only the upper triangle of the matrix if the weak form is symmetric (see
+  // WeakForm::is_sym()) and the matrix supports it. Halves the memory of the matrix
+  // and the scatter traffic; MUMPS and PARDISO then use their symmetric factorizations.
+  void set_symmetric_storage(bool enable = true) { use_sym_storage = enable; have_matrix = false; }
+
+  // Number the DOFs of the spaces interleaved (see Space::assign_dofs_interleaved()), so
+  // that the matrix consists of dense (neq x neq) blocks and can be stored in BSRMatrix.
+  // The numbering is applied again by create() whenever the DOFs of the spaces have been
+  // reassigned since (adaptivity, Space::assign_dofs() etc.).
+  void set_interleaved_dofs(bool enable = true);
+
+  // Assemble the elements in parallel (OpenMP threads, see OMP_NUM_THREADS). Every thread has
+  // its own shape functions, reference maps and caches; the contributions of the elements are
+  // added to the matrix and the right-hand sides by one thread in the order of the serial
+  // assembly, so the results are identical. The form callbacks have to be thread-safe. Stages
+  // with external functions (other than the previous Newton iteration) or with both triangles
+  // and quads in the meshes are assembled serially.
+  void set_parallel_assembly(bool enable = true) { use_parallel_assembly = enable; }
+
+  // Integrate also the ordinary volume matrix forms (not only the constant-coefficient ones,
+  // see WeakForm::add_matrix_form_const()) by sum factorization on the quads with tensor-product
+  // shapesets, with the quadrature of the highest orders on the element. The coefficients of
+  // the form in the points are obtained by evaluating it in each point for unit values of
+  // (u, du/dx, du/dy) and (v, dv/dx, dv/dy), so the form has to be a sum over the points of
+  // a bilinear function of them (which the usual forms are). Pays off at higher orders.
+  void set_sum_factorization(bool enable = true) { use_sum_factorization = enable; }
+
+  // Number of the orders of the forms taken from the cache and evaluated by the 'ord' callbacks
+  // in the last assemble() (see get_cached_order()).
+  int get_num_order_cache_hits() { return order_cache_hits; }
+  int get_num_order_cache_misses() { return order_cache_misses; }
+
+  // Number of the transformed shape functions taken from the persistent cache as they are
+  // (affine elements of the same shape) and recalculated in place in the last assemble().
+  int get_num_fn_cache_reuses() { return fn_cache_reuses; }
+  int get_num_fn_cache_updates() { return fn_cache_updates; }
+
+  // Keep the local matrices and vectors of the elements between the assemblings (linear problems)
+  // and compute only those of the elements whose geometry, sub-element transformation or shape
+  // functions changed; the stored values are added to the matrix with the current DOFs and
+  // coefficients of the assembly lists, so that a local refinement or a change of the orders only
+  // costs the changed elements. Forms with external functions are always evaluated, the other
+  // forms must not depend on anything else than their arguments. If more than the fraction
+  // 'max_changes' of the elements changed, the stored values are dropped and the rest of the
+  // mesh is assembled as without them. The elements are assembled serially.
+  void set_incremental_assembly(bool enable = true, double max_changes = 0.5);
+
+  // Number of the elements taken from the cache of the incremental assembly and computed
+  // in the last assemble().
+  int get_num_elem_cache_hits() { return elem_cache_hits; }
+  int get_num_elem_cache_misses() { return elem_cache_misses; }
+
+  // Passes the DOFs of every element (the assembly lists, for each space separately)
+  // to the block Jacobi preconditioner as its diagonal blocks.
+  void get_element_blocks(BlockJacobiPrecond* pc);
+
+  // Passes the levels of the p-multigrid to the preconditioner: level k keeps the DOFs
+  // of the basis functions present in the spaces with all orders decreased by k.
+  void get_p_levels(PMultigridPrecond* pc, int num_levels);
+
 protected:
   WeakForm* wf;
 
@@ -101,24 +190,182 @@ protected:
   bool struct_changed;
   bool is_up_to_date();
 
+  bool use_scatter_maps;
+  bool use_sym_storage;
+  bool use_interleaved_dofs;
+  ScatterMaps scatter_maps;              /// offsets of local stiffness matrices into 'scatter_mat'
+  SparseMatrix* scatter_mat;             /// the matrix the scatter maps were built for
+  void build_scatter_maps(SparseMatrix* mat);
+  inline int* get_scatter_map(SparseMatrix* mat, int m, int n, int* elem_id);
+
   PrecalcShapeset** pss;    // This is different from H3D.
   int num_user_pss;         // This is different from H3D.
 
+  bool use_parallel_assembly;
+  bool use_sum_factorization;
+  DiscreteProblem* master;               /// the problem assembled by this worker of the parallel assembly
+  AsmBuffer* asm_buffer;                 /// contributions of the worker, see assemble_parallel()
+
+  bool matrix_free;                      /// apply() or apply_fd(): the matrix and its structure are not touched
+  scalar* apply_x;                       /// the local stiffness matrices are multiplied by 'apply_x'
+  scalar* apply_y;                       /// and added to 'apply_y' instead of the matrix, see apply()
+
+  // Creates a worker of the parallel assembly (shares the weak form and the spaces).
+  DiscreteProblem(DiscreteProblem* master);
+
+  bool assemble_parallel(WeakForm::Stage* s, scalar* coeff_vec, Tuple<Solution*> u_ext,
+                         SparseMatrix* mat, Vector** rhs, int nrhs, bool rhsonly);
+  void assemble_state(WeakForm::Stage* s, Element** e, bool* bnd, SurfPos* surf_pos, Element* base,
+                      AsmList* al, PrecalcShapeset** spss, RefMap* refmap, Tuple<Solution*> u_ext,
+                      SparseMatrix* mat, Vector** rhs, int nrhs, bool rhsonly);
+  void add_to_matrix(SparseMatrix* mat, int m, int n, scalar** block, int* rows, int* cols, int* map);
+  void add_to_rhs(Vector** rhs, int nrhs, int idx, scalar val);
+
   ExtData<Ord>* init_ext_fns_ord(std::vector<MeshFunction *> &ext);
   ExtData<Ord>* init_ext_fns_ord(std::vector<MeshFunction *> &ext, int edge);
   ExtData<scalar>* init_ext_fns(std::vector<MeshFunction *> &ext, RefMap *rm, const int order);
   Func<double>* get_fn(PrecalcShapeset *fu, RefMap *rm, const int order);
 
+  // Persistent cache of the transformed shape functions (see get_fn()). The entries survive
+  // the elements: an entry is recalculated in place if it was computed on another element,
+  // unless both elements are affine of the same mode with the same inverse reference map, in
+  // which case the transformed values are the same and the entry is reused as it is.
+  struct FnCacheEntry
+  {
+    PrecalcShapeset::Key key;
+    Func<double>* fn;
+    int stamp;          // 'fn_cache_stamp' of the element the values belong to
+    int mode;           // mode of the elements (part of the key)
+    bool affine;        // that element has a constant inverse reference map 'irm'
+    double2x2 irm;
+  };
+  std::vector<FnCacheEntry> fn_cache;
+  std::vector<int> fn_cache_slots;  // open addressing hash table of the indices to 'fn_cache'
+  int fn_cache_stamp;
+  int fn_cache_reuses, fn_cache_updates;
+  int find_fn_cache_entry(const PrecalcShapeset::Key &key, int mode);
+  void free_fn_cache();
+
+  // Incremental assembly: the values of the forms on the states of the traversal (the local
+  // matrices without the coefficients of the assembly lists, in the order of assembling). The key
+  // consists of the elements (vertices, marker, sub-element transformation, indices of the shape
+  // functions) and of the boundary conditions on their edges.
+  struct ElemCacheEntry
+  {
+    std::vector<scalar> values;
+    int stamp;          // the last assemble() the entry was used in
+  };
+  bool use_incremental;
+  double incremental_max_changes;
+  std::map<std::vector<int>, ElemCacheEntry> elem_cache;
+  std::vector<int> elem_key;
+  int elem_cache_stamp, elem_cache_wf_seq, elem_cache_limit, elem_cache_stage;
+  int elem_cache_hits, elem_cache_misses;
+  bool elem_cache_dropped;        // too many elements changed, the rest is assembled without the cache
+  ElemCacheEntry* elem_entry;     // entry of the current state, NULL if it is not cached
+  bool elem_entry_hit;            // the values of 'elem_entry' are read, otherwise stored
+  unsigned elem_entry_pos;
+  void find_elem_cache_entry(WeakForm::Stage* s, Element** e, bool* bnd, SurfPos* surf_pos, AsmList* al,
+                             bool matrix, int nrhs, bool rhsonly);
+  scalar* get_elem_cache_values(int n);
+  void eval_pair_forms(WeakForm::MatrixFormVol *mfv, Tuple<Solution *> u_ext, PrecalcShapeset *fu,
+         PrecalcShapeset *fv, AsmList *an, AsmList *am, RefMap *ru, RefMap *rv, bool sym, scalar **mat);
+
   // Caching transformed values for element
-  std::map<PrecalcShapeset::Key, Func<double>*, PrecalcShapeset::Compare> cache_fn;
   Geom<double>* cache_e[g_max_quad + 1 + 4 * g_max_quad + 4];
   double* cache_jwt[g_max_quad + 1 + 4 * g_max_quad + 4];
 
   void init_cache();
   void delete_cache();
 
+  // The order of a form depends only on the orders of its arguments, so its 'ord' callback
+  // is evaluated once for every combination of them (per form, cleared in assemble()).
+  std::map<void*, std::map<std::vector<int>, int> > order_cache;
+  std::vector<int> order_key;
+  int order_cache_hits, order_cache_misses;
+  int* get_cached_order(void* form, Tuple<Solution *> &u_ext, int inc, int ou, int ov,
+                        std::vector<MeshFunction *> &ext, int edge);
+
+  int calc_order_matrix_form_vol(WeakForm::MatrixFormVol *mfv, Tuple<Solution *> u_ext,
+         int inc, int order_u, int order_v, RefMap *ru);
+
   scalar eval_form(WeakForm::MatrixFormVol *mfv, Tuple<Solution *> u_ext, 
          PrecalcShapeset *fu, PrecalcShapeset *fv, RefMap *ru, RefMap *rv);
+
+  // Constant-coefficient volume matrix forms (WeakForm::add_matrix_form_const()) on affine
+  // elements: the form is a(u,v) = int U^T C V, U = (u, du/dx, du/dy), V = (v, dv/dx, dv/dy),
+  // with the (3 x 3) matrix C obtained by evaluating the form for unit values of U and V.
+  // With U = T_u R_u, where R_u are the values and the derivatives on the reference element
+  // and T_u contains the constant inverse reference map, the local matrix is
+  // |J| sum (T_u^T C T_v)_cd int R_u,c R_v,d and the reference integrals are computed once.
+  std::map<WeakForm::MatrixFormVol *, std::vector<scalar> > const_coefs;
+  scalar* get_const_coefs(WeakForm::MatrixFormVol *mfv);
+
+  struct RefMatrixKey
+  {
+    int mode, ss_u, ss_v;
+    uint64_t sub_u, sub_v;      // sub-element transformations of the shape functions
+    bool operator<(const RefMatrixKey &o) const;
+  };
+  // reference integrals int R_u,c R_v,d (9 per pair of shape functions), the rows of the
+  // basis functions are allocated when needed
+  struct RefMatrices
+  {
+    int nu, nv;
+    std::vector<double *> rows;
+    std::vector<char *> done;
+    RefMatrices(int nu, int nv) : nu(nu), nv(nv), rows(nu, (double *) NULL), done(nu, (char *) NULL) {}
+    ~RefMatrices();
+  };
+  std::map<RefMatrixKey, RefMatrices *> ref_matrices;
+  void free_ref_matrices();
+  bool can_use_ref_matrices(PrecalcShapeset *fu, PrecalcShapeset *fv, AsmList *an, AsmList *am,
+         RefMap *ru, RefMap *rv);
+  void eval_ref_form(WeakForm::MatrixFormVol *mfv, PrecalcShapeset *fu, PrecalcShapeset *fv,
+         AsmList *an, AsmList *am, RefMap *ru, RefMap *rv, scalar **mat);
+
+  // Constant-coefficient volume matrix forms on the other quads (curved or not parallelograms)
+  // with tensor-product shapesets (Shapeset::get_tensor_index()): the shape functions are
+  // products of 1D functions and the quadrature is the Cartesian product of a 1D rule, so the
+  // integrals are computed by sum factorization, one direction at a time. The local matrix
+  // then costs O(p^5) operations instead of O(p^6) and the matrix-free product (apply())
+  // O(p^3) per element, without the local matrix (used on the affine quads, too). The ordinary
+  // forms (see set_sum_factorization()) are integrated in the same way on all quads, with the
+  // matrix C in each point.
+  struct TensorSide
+  {
+    int p;                            // number of the 1D functions (the highest index + 1)
+    std::vector<int> a, b;            // tensor indices of the shape functions of the assembly list
+    std::vector<double> sign;
+    std::vector<double> x[2], y[2];   // 1D values [0] and derivatives [1] in the points, [a * n1 + i]
+  };
+  TensorSide tensor_u, tensor_v;
+  int tensor_n1;                      // number of the points of the 1D rule
+  int tensor_nk, tensor_kidx[9];      // the pairs (c, d) with nonzero coefficients
+  std::vector<scalar> tensor_k;       // their coefficients |J| w (T_u^T C T_v)_cd in the points
+  std::vector<scalar> tensor_c;       // the matrices C of an ordinary form in the points, [9 * p]
+  void get_point_coefs(WeakForm::MatrixFormVol *mfv, Tuple<Solution *> u_ext, RefMap *ru, RefMap *rv,
+         int order);
+  std::vector<scalar> tensor_tmp, tensor_grid, tensor_in, tensor_out, tensor_xl, tensor_yl;
+  bool can_use_tensor_form(PrecalcShapeset *fu, PrecalcShapeset *fv, AsmList *an, AsmList *am,
+         RefMap *ru, RefMap *rv);
+  void init_tensor_side(TensorSide &s, PrecalcShapeset *f, AsmList *al, double2 *pt1);
+  void init_tensor_form(WeakForm::MatrixFormVol *mfv, Tuple<Solution *> u_ext,
+         PrecalcShapeset *fu, PrecalcShapeset *fv, AsmList *an, AsmList *am, RefMap *ru, RefMap *rv);
+  void eval_tensor_form(WeakForm::MatrixFormVol *mfv, Tuple<Solution *> u_ext,
+         PrecalcShapeset *fu, PrecalcShapeset *fv, AsmList *an, AsmList *am,
+         RefMap *ru, RefMap *rv, scalar **mat);
+  void apply_tensor_form(WeakForm::MatrixFormVol *mfv, Tuple<Solution *> u_ext,
+         PrecalcShapeset *fu, PrecalcShapeset *fv, AsmList *an, AsmList *am,
+         RefMap *ru, RefMap *rv, int sym);
+  void apply_tensor(TensorSide &from, TensorSide &to, bool transpose, scalar *x, scalar *y);
+
+  // Element-level volume matrix forms (WeakForm::matrix_form_elem_t): the tables of the basis
+  // and test functions passed to the form, reused for all the elements.
+  ShapeTable elem_table_u, elem_table_v;
+  void eval_elem_form(WeakForm::MatrixFormVol *mfv, Tuple<Solution *> u_ext,
+         PrecalcShapeset *fu, PrecalcShapeset *fv, AsmList *an, AsmList *am,
+         RefMap *ru, RefMap *rv, scalar **mat);
   scalar eval_form(WeakForm::VectorFormVol *vfv, Tuple<Solution *> u_ext, 
          PrecalcShapeset *fv, RefMap *rv);
   scalar eval_form(WeakForm::MatrixFormSurf *mfv, Tuple<Solution *> u_ext, 
@@ -134,6 +381,30 @@ HERMES_API Space* construct_refined_space(Space* coarse, int order_increase = 1)
 
 HERMES_API double get_l2_norm(Vector* vec); 
 
+/// The matrix of a DiscreteProblem (the Jacobian matrix at a coefficient vector for nonlinear
+/// problems) as a MatrixFreeOperator, e.g. for KrylovSolver without an assembled matrix. The
+/// products are computed by DiscreteProblem::apply(), or by DiscreteProblem::apply_fd() if
+/// 'finite_differences' is set (the residual at the coefficient vector is assembled once).
+class HERMES_API DiscreteProblemOperator : public MatrixFreeOperator
+{
+public:
+  DiscreteProblemOperator(DiscreteProblem* dp, scalar* coeff_vec = NULL, bool finite_differences = false);
+  virtual ~DiscreteProblemOperator();
+
+  // The coefficient vector the Jacobian matrix is taken at (not copied, set it again when
+  // it changes).
+  void set_coeff_vec(scalar* coeff_vec);
+
+  virtual int get_size() { return dp->get_num_dofs(); }
+  virtual void apply(scalar* x, scalar* y);
+
+protected:
+  DiscreteProblem* dp;
+  scalar* coeff_vec;
+  bool finite_differences;
+  scalar* f0;                  /// the residual at 'coeff_vec' for the finite differences
+};
+
 #endif
 
 
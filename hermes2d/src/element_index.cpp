@@ -0,0 +1,163 @@
+// This file is part of Hermes2D.
+//
+// Hermes2D is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Hermes2D is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Hermes2D.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "h2d_common.h"
+#include "element_index.h"
+#include "refmap.h"
+#include <algorithm>
+
+// maximum number of elements in a leaf of the hierarchy
+static const int LEAF_SIZE = 8;
+
+// curved elements: number of sampling intervals of the reference domain per direction
+// and the relative enlargement of the sampled box
+static const int CURV_SAMPLES = 8;
+static const double CURV_MARGIN = 0.1;
+
+
+ElementIndex::ElementIndex(Mesh* mesh, RefMap* refmap)
+{
+  _F_
+  this->mesh = mesh;
+  seq = mesh->get_seq();
+
+  Element* e;
+  items.reserve(mesh->get_num_active_elements());
+  for_all_active_elements(e, mesh)
+  {
+    Item it;
+    it.e = e;
+    calc_elem_box(e, refmap, it.box);
+    items.push_back(it);
+  }
+
+  nodes.reserve(2 * (items.size() / LEAF_SIZE + 1));
+  if (items.size()) build(0, items.size());
+}
+
+
+void ElementIndex::calc_elem_box(Element* e, RefMap* refmap, double* box)
+{
+  box[0] = box[2] = e->vn[0]->x;
+  box[1] = box[3] = e->vn[0]->y;
+  for (unsigned int i = 1; i < e->nvert; i++)
+  {
+    box[0] = std::min(box[0], e->vn[i]->x);  box[2] = std::max(box[2], e->vn[i]->x);
+    box[1] = std::min(box[1], e->vn[i]->y);  box[3] = std::max(box[3], e->vn[i]->y);
+  }
+  if (!e->is_curved()) return;
+
+  // sample the reference mapping, the curved edges may bulge out of the vertex box
+  refmap->set_active_element(e);
+  for (int i = 0; i <= CURV_SAMPLES; i++)
+    for (int j = 0; j <= CURV_SAMPLES; j++)
+    {
+      double xi1 = -1.0 + 2.0 * i / CURV_SAMPLES, xi2 = -1.0 + 2.0 * j / CURV_SAMPLES;
+      if (e->is_triangle() && xi1 + xi2 > 0.0) continue;
+      double x, y;
+      double2x2 m;
+      refmap->inv_ref_map_at_point(xi1, xi2, x, y, m);
+      box[0] = std::min(box[0], x);  box[2] = std::max(box[2], x);
+      box[1] = std::min(box[1], y);  box[3] = std::max(box[3], y);
+    }
+  double mx = CURV_MARGIN * (box[2] - box[0]), my = CURV_MARGIN * (box[3] - box[1]);
+  box[0] -= mx;  box[2] += mx;
+  box[1] -= my;  box[3] += my;
+}
+
+
+// orders the items by the center of their boxes in one direction
+struct ItemCenterLess
+{
+  int dir;
+  ItemCenterLess(int dir) : dir(dir) {}
+  template<typename T>
+  bool operator()(const T& a, const T& b) const
+    { return a.box[dir] + a.box[dir+2] < b.box[dir] + b.box[dir+2]; }
+};
+
+int ElementIndex::build(int first, int count)
+{
+  int id = nodes.size();
+  nodes.push_back(Node());
+
+  double box[4] = { items[first].box[0], items[first].box[1], items[first].box[2], items[first].box[3] };
+  for (int i = first + 1; i < first + count; i++)
+  {
+    box[0] = std::min(box[0], items[i].box[0]);  box[1] = std::min(box[1], items[i].box[1]);
+    box[2] = std::max(box[2], items[i].box[2]);  box[3] = std::max(box[3], items[i].box[3]);
+  }
+  memcpy(nodes[id].box, box, sizeof(box));
+
+  if (count <= LEAF_SIZE)
+  {
+    nodes[id].first = first;
+    nodes[id].count = count;
+    nodes[id].left = nodes[id].right = -1;
+    return id;
+  }
+
+  // split at the median of the element centers along the longer side
+  int dir = (box[2] - box[0] >= box[3] - box[1]) ? 0 : 1;
+  int half = count / 2;
+  std::nth_element(items.begin() + first, items.begin() + first + half,
+                   items.begin() + first + count, ItemCenterLess(dir));
+
+  int left = build(first, half);
+  int right = build(first + half, count - half);
+  nodes[id].first = first;
+  nodes[id].count = 0;
+  nodes[id].left = left;
+  nodes[id].right = right;
+  return id;
+}
+
+
+static inline bool box_contains(const double* box, double x, double y)
+{
+  return x >= box[0] && x <= box[2] && y >= box[1] && y <= box[3];
+}
+
+void ElementIndex::find(double x, double y, std::vector<Element*>& result) const
+{
+  if (nodes.empty()) return;
+
+  int stack[64], top = 0;
+  stack[top++] = 0;
+  while (top > 0)
+  {
+    const Node& n = nodes[stack[--top]];
+    if (!box_contains(n.box, x, y)) continue;
+    if (n.count > 0)
+    {
+      for (int i = n.first; i < n.first + n.count; i++)
+        if (box_contains(items[i].box, x, y))
+          result.push_back(items[i].e);
+    }
+    else
+    {
+      stack[top++] = n.right;
+      stack[top++] = n.left;
+    }
+  }
+}
+
+
+void ElementIndex::get_bbox(double& x0, double& y0, double& x1, double& y1) const
+{
+  if (nodes.empty()) { x0 = y0 = x1 = y1 = 0.0; return; }
+  x0 = nodes[0].box[0];  y0 = nodes[0].box[1];
+  x1 = nodes[0].box[2];  y1 = nodes[0].box[3];
+}
@@ -0,0 +1,69 @@
+// This file is part of Hermes2D.
+//
+// Hermes2D is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Hermes2D is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Hermes2D.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef __H2D_ELEMENT_INDEX_H
+#define __H2D_ELEMENT_INDEX_H
+
+#include "mesh.h"
+
+class RefMap;
+
+/// Bounding box hierarchy over the active elements of a mesh
+///
+/// Used by Solution::get_pt_value() to find the elements which may contain a physical point.
+/// The boxes of straight-edged elements are exact. The boxes of curved elements are obtained
+/// by sampling the reference mapping on a grid and enlarged by a margin which covers the
+/// bulging of the map between the samples. The index describes one state of the mesh, it has
+/// to be rebuilt when the mesh changes (see is_current()).
+///
+class HERMES_API ElementIndex
+{
+public:
+  ElementIndex(Mesh* mesh, RefMap* refmap);
+
+  /// Returns true if the index was built for the current state of 'mesh'.
+  bool is_current(Mesh* mesh) const { return this->mesh == mesh && seq == mesh->get_seq(); }
+
+  /// Appends to 'result' all active elements whose bounding boxes contain the point (x, y).
+  void find(double x, double y, std::vector<Element*>& result) const;
+
+  /// Returns the bounding box of the whole mesh.
+  void get_bbox(double& x0, double& y0, double& x1, double& y1) const;
+
+protected:
+  struct Item
+  {
+    Element* e;
+    double box[4]; ///< xmin, ymin, xmax, ymax
+  };
+
+  struct Node
+  {
+    double box[4];
+    int first, count; ///< range of 'items' (leaves only)
+    int left, right;  ///< children (inner nodes only, count == 0)
+  };
+
+  Mesh* mesh;
+  unsigned seq;
+  std::vector<Item> items;
+  std::vector<Node> nodes;
+
+  void calc_elem_box(Element* e, RefMap* refmap, double* box);
+  int build(int first, int count);
+};
+
+#endif
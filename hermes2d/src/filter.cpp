@@ -74,6 +74,7 @@ void Filter::init()
   // misc init
   num_components = 1;
   order = 0;
+  cache_class = "Filter";
   memset(tables, 0, sizeof(tables));
   memset(sln_sub, 0, sizeof(sln_sub));
   set_quad_2d(&g_quad_2d_std);
@@ -100,9 +100,6 @@ Func<double>* init_fn(PrecalcShapeset *fu, RefMap *rm, const int order)
 	int nc = fu->get_num_components();
   int space_type = fu->get_type();
   Quad2D* quad = fu->get_quad_2d();
-  if (nc == 1) fu->set_quad_order(order, H2D_FN_ALL);
-  else fu->set_quad_order(order);
-  double3* pt = quad->get_points(order);
   int np = quad->get_num_points(order);
   Func<double>* u = new Func<double>(np, nc);
 
@@ -115,6 +112,45 @@ Func<double>* init_fn(PrecalcShapeset *fu, RefMap *rm, const int order)
 #ifdef H2D_SECOND_DERIVATIVES_ENABLED
                 u->laplace = new double [np];
 #endif
+	}
+  // Hcurl space
+	else if (space_type == 1)
+  {
+    u->val0 = new double [np];
+    u->val1 = new double [np];
+    u->curl = new double [np];
+	}
+  // Hdiv space
+  else if (space_type == 2)
+  {
+    u->val0 = new double [np];
+    u->val1 = new double [np];
+  }
+  else
+    error("Wrong space type - space has to be either H1, Hcurl, Hdiv or L2");
+
+  update_fn(u, fu, rm, order);
+  return u;
+}
+
+// Transformation of shape functions using reference mapping (into the arrays allocated by init_fn())
+void update_fn(Func<double>* u, PrecalcShapeset *fu, RefMap *rm, const int order)
+{
+	int nc = fu->get_num_components();
+  int space_type = fu->get_type();
+  Quad2D* quad = fu->get_quad_2d();
+  if (nc == 1) fu->set_quad_order(order, H2D_FN_ALL);
+  else fu->set_quad_order(order);
+  int np = quad->get_num_points(order);
+
+  // On affine elements the constant inverse reference map is used, so that the values depend
+  // only on the shape of the element (see DiscreteProblem::get_fn()).
+  double2x2 *irm = rm->is_jacobian_const() ? rm->get_const_inv_ref_map() : rm->get_inv_ref_map(order);
+  int irm_inc = rm->is_jacobian_const() ? 0 : 1;
+
+  // H1 or L2 space
+  if (space_type == 0 || space_type == 3)
+  {
 		double *fn = fu->get_fn_values();
 		double *dx = fu->get_dx_values();
 		double *dy = fu->get_dy_values();
@@ -124,14 +160,14 @@ Func<double>* init_fn(PrecalcShapeset *fu, RefMap *rm, const int order)
                 double *dyy = fu->get_dyy_values();
 #endif
 
-		double2x2 *m = rm->get_inv_ref_map(order);
+		double2x2 *m = irm;
 #ifdef H2D_SECOND_DERIVATIVES_ENABLED
                 double3x2 *mm = rm->get_second_ref_map(order);
 #endif
 #ifdef H2D_SECOND_DERIVATIVES_ENABLED
-		for (int i = 0; i < np; i++, m++, mm++)
+		for (int i = 0; i < np; i++, m += irm_inc, mm++)
 #else
-		for (int i = 0; i < np; i++, m++)
+		for (int i = 0; i < np; i++, m += irm_inc)
 #endif
     {
 			u->val[i] = fn[i];
@@ -151,16 +187,12 @@ Func<double>* init_fn(PrecalcShapeset *fu, RefMap *rm, const int order)
   // Hcurl space
 	else if (space_type == 1)
   {
-    u->val0 = new double [np];
-    u->val1 = new double [np];
-    u->curl = new double [np];
-
     double *fn0 = fu->get_fn_values(0);
     double *fn1 = fu->get_fn_values(1);
     double *dx1 = fu->get_dx_values(1);
     double *dy0 = fu->get_dy_values(0);
-    double2x2 *m = rm->get_inv_ref_map(order);
-    for (int i = 0; i < np; i++, m++)
+    double2x2 *m = irm;
+    for (int i = 0; i < np; i++, m += irm_inc)
     {
       u->val0[i] = (fn0[i] * (*m)[0][0] + fn1[i] * (*m)[0][1]);
       u->val1[i] = (fn0[i] * (*m)[1][0] + fn1[i] * (*m)[1][1]);
@@ -170,24 +202,65 @@ Func<double>* init_fn(PrecalcShapeset *fu, RefMap *rm, const int order)
   // Hdiv space
   else if (space_type == 2)
   {
-    u->val0 = new double [np];
-    u->val1 = new double [np];
-
     double *fn0 = fu->get_fn_values(0);
     double *fn1 = fu->get_fn_values(1);
-    double2x2 *m = rm->get_inv_ref_map(order);
-    for (int i = 0; i < np; i++, m++)
+    double2x2 *m = irm;
+    for (int i = 0; i < np; i++, m += irm_inc)
     {
       u->val0[i] = (  fn0[i] * (*m)[1][1] - fn1[i] * (*m)[1][0]);
       u->val1[i] = (- fn0[i] * (*m)[0][1] + fn1[i] * (*m)[0][0]);
     }
   }
-  else
-    error("Wrong space type - space has to be either H1, Hcurl, Hdiv or L2");
+}
 
-  return u;
+// Tables of shape functions for the element-level forms
+void ShapeTable::set_null()
+{
+  val = dx = dy = NULL;
+#ifdef H2D_SECOND_DERIVATIVES_ENABLED
+  laplace = NULL;
+#endif
+  val0 = val1 = NULL;
+  dx0 = dx1 = NULL;
+  dy0 = dy1 = NULL;
+  curl = NULL;
 }
 
+#ifdef H2D_SECOND_DERIVATIVES_ENABLED
+  #define H2D_SHAPE_TABLES(FN) FN(val) FN(dx) FN(dy) FN(laplace) FN(val0) FN(val1) FN(dx0) FN(dx1) FN(dy0) FN(dy1) FN(curl)
+#else
+  #define H2D_SHAPE_TABLES(FN) FN(val) FN(dx) FN(dy) FN(val0) FN(val1) FN(dx0) FN(dx1) FN(dy0) FN(dy1) FN(curl)
+#endif
+
+void ShapeTable::init(int ns, int np, Func<double> *fn)
+{
+  this->ns = ns;
+  this->np = np;
+
+  int nt = 0;
+#define H2D_COUNT_TABLE(__ATTRIB) if (fn->__ATTRIB != NULL) nt++;
+  H2D_SHAPE_TABLES(H2D_COUNT_TABLE)
+#undef H2D_COUNT_TABLE
+  // the vector keeps its capacity, so there is no allocation after the first few elements
+  if (data.size() < (size_t) nt * ns * np) data.resize((size_t) nt * ns * np);
+
+  set_null();
+  double *table = nt > 0 ? &data[0] : NULL;
+#define H2D_ASSIGN_TABLE(__ATTRIB) if (fn->__ATTRIB != NULL) { __ATTRIB = table; table += ns * np; }
+  H2D_SHAPE_TABLES(H2D_ASSIGN_TABLE)
+#undef H2D_ASSIGN_TABLE
+}
+
+void ShapeTable::set_row(int k, Func<double> *fn)
+{
+  assert(k >= 0 && k < ns);
+#define H2D_COPY_ROW(__ATTRIB) if (__ATTRIB != NULL) memcpy(__ATTRIB + k * np, fn->__ATTRIB, sizeof(double) * np);
+  H2D_SHAPE_TABLES(H2D_COPY_ROW)
+#undef H2D_COPY_ROW
+}
+
+#undef H2D_SHAPE_TABLES
+
 // Preparation of mesh-functions
 Func<scalar>* init_fn(MeshFunction *fu, RefMap *rm, const int order)
 {
@@ -171,6 +171,39 @@ public:
 };
 
 
+/// Values of all the shape functions of an element (of one space) at the integration points,
+/// stored as dense row-major (ns x np) tables: the row k holds the values of the k-th shape
+/// function of the assembly list. Only the tables present in the Func<double> of the shape
+/// functions are allocated (val, dx, dy for H1 and L2, val0, val1 and curl for Hcurl, etc.),
+/// the others are NULL. Passed to the element-level matrix forms, see
+/// WeakForm::matrix_form_elem_t.
+class HERMES_API ShapeTable
+{
+public:
+  int ns;           // number of shape functions (rows)
+  int np;           // number of integration points (columns)
+  double *val, *dx, *dy;
+#ifdef H2D_SECOND_DERIVATIVES_ENABLED
+  double *laplace;
+#endif
+  double *val0, *val1;
+  double *dx0, *dx1;
+  double *dy0, *dy1;
+  double *curl;
+
+  ShapeTable() { ns = np = 0; set_null(); }
+
+  /// Prepares the tables for 'ns' shape functions with the same components as 'fn'.
+  void init(int ns, int np, Func<double> *fn);
+  /// Copies the values of 'fn' into the row 'k'.
+  void set_row(int k, Func<double> *fn);
+
+protected:
+  std::vector<double> data;   // all the tables, reused by the following init()s
+  void set_null();
+};
+
+
 /// Geometry (coordinates, normals, tangents) of either an element or an edge
 template<typename T>
 class Geom
@@ -222,6 +255,9 @@ Geom<double>* init_geom_surf(RefMap *rm, SurfPos* surf_pos, const int order);
 Func<Ord>* init_fn_ord(const int order);
 /// Init the shape function for the evaluation of the volumetric/surface integral (transformation of values)
 Func<double>* init_fn(PrecalcShapeset *fu, RefMap *rm, const int order);
+/// Recalculate the values of a shape function initialized by init_fn() (of the same type and order)
+/// for the current shape, transformation and reference map, without reallocating the arrays
+void update_fn(Func<double>* u, PrecalcShapeset *fu, RefMap *rm, const int order);
 /// Init the mesh-function for the evaluation of the volumetric/surface integral
 Func<scalar>* init_fn(MeshFunction *fu, RefMap *rm, const int order);
 
@@ -50,6 +50,33 @@ const int H2D_FN_ALL = H2D_FN_DEFAULT | H2D_FN_DXX | H2D_FN_DYY | H2D_FN_DXY; //
 const int H2D_FN_COMPONENT_0 = H2D_FN_VAL_0 | H2D_FN_DX_0 | H2D_FN_DY_0 | H2D_FN_DXX_0 | H2D_FN_DYY_0 | H2D_FN_DXY_0;
 const int H2D_FN_COMPONENT_1 = H2D_FN_VAL_1 | H2D_FN_DX_1 | H2D_FN_DY_1 | H2D_FN_DXX_1 | H2D_FN_DYY_1 | H2D_FN_DXY_1;
 
+/// Usage statistics of the precalculated tables (see Function::get_cache_stats()).
+struct FnCacheStats
+{
+  int instances;           ///< number of functions (summaries only)
+  unsigned long hits;      ///< calls to set_quad_order() which found the tables precalculated
+  unsigned long misses;    ///< calls to set_quad_order() which had to precalculate them
+  unsigned long evictions; ///< tables freed to keep the memory within the budget
+  long mem;                ///< current size of the tables in bytes
+  long peak_mem;           ///< peak size of the tables in bytes (summaries: sum of the peaks)
+  long budget;             ///< memory budget in bytes, 0 if unlimited (summaries: sum of the budgets)
+
+  FnCacheStats() { memset(this, 0, sizeof(FnCacheStats)); }
+
+  void add(const FnCacheStats& s)
+  {
+    instances += s.instances;  hits += s.hits;  misses += s.misses;  evictions += s.evictions;
+    mem += s.mem;  peak_mem += s.peak_mem;  budget += s.budget;
+  }
+};
+
+// Tables of this many recently created nodes are never evicted, so that the values of a few
+// functions (or shapes of one PrecalcShapeset) can be used together (see set_cache_budget())
+#define H2D_CACHE_KEEP_NODES  16
+
+// Maximum number of classes in the statistics (see Function::dump_cache_stats())
+#define H2D_CACHE_MAX_CLASSES 16
+
 // Plenty of checking stuff for the debug version
 #ifndef NDEBUG
   #define check_params \
@@ -90,6 +117,11 @@ const int H2D_FN_COMPONENT_1 = H2D_FN_VAL_1 | H2D_FN_DX_1 | H2D_FN_DY_1 | H2D_FN
 /// Since this class inherits from Transformable, you can obtain function values in integration
 /// points transformed to sub-areas of the current element (see push_transform(), pop_transform()).
 ///
+/// The precalculated tables are kept until free() is called. Their memory can be bounded by
+/// set_cache_budget(): the least recently used tables are then evicted as new ones are
+/// precalculated. Hit, miss and eviction counts of each function are kept and summarized per
+/// class by dump_cache_stats().
+///
 template<typename TYPE>
 class Function : public Transformable
 {
@@ -112,7 +144,7 @@ public:
   int get_num_components() const { return num_components; }
 
   /// Checks whether the function is ready to use.
-  bool initialized() {return nodes != NULL;};
+  bool initialized() {return nodes != NULL || flat_nodes != NULL;};
 
   /// Activates an integration rule of the specified order. Subsequent calls to
   /// get_values(), get_dx_values() etc. will be returning function values at these points.
@@ -122,14 +154,30 @@ public:
   ///   H2D_FN_VAL | H2D_FN_DX | H2D_FN_DY. You can also use H2D_FN_ALL to precalculate everything.
   void set_quad_order(int order, int mask = H2D_FN_DEFAULT)
   {
-    pp_cur_node = (void**) JudyLIns(nodes, order, NULL);
+    if (sub_idx == 0 && flat_nodes != NULL)
+    {
+      // untransformed function with directly indexed nodes (see PrecalcShapeset)
+      if (order >= num_flat_nodes) error("Order out of range (%d, %d).", order, num_flat_nodes);
+      pp_cur_node = flat_nodes + order;
+    }
+    else
+      pp_cur_node = (void**) JudyLIns(nodes, order, NULL);
     // if you get SIGSEGV here, you maybe forgot to include the function in the list
     // of external functions in WeakForm::add_biform()...
     cur_node = (Node*) *pp_cur_node;
     // another reason may be a bug in Judy array usage in Hermes2D (this needs to be fixed)
     // -- as a workaround, you may for the time being use more than one pss for problems
     // where the basis and test functions can be on different meshes (i.e., multi-mesh).
-    if (cur_node == NULL || (cur_node->mask & mask) != mask) precalculate(order, mask);
+    if (cur_node == NULL || (cur_node->mask & mask) != mask)
+    {
+      cache_misses++;
+      precalculate(order, mask);
+    }
+    else
+    {
+      cache_hits++;
+      if (!cur_node->used) cur_node->used = 1; // see evict_nodes()
+    }
   }
 
   /// \brief Returns function values.
@@ -227,6 +275,27 @@ public:
   virtual void free() = 0;
 
 
+  /// \brief Limits the memory used by the precalculated tables.
+  /// \details When new tables exceed the budget, the least recently used ones are freed
+  /// and precalculated again when they are needed. The recency is approximated as by the
+  /// clock algorithm: the nodes are kept in the order of creation and a node used since the
+  /// last eviction pass gets a second chance. The H2D_CACHE_KEEP_NODES most recently created
+  /// nodes are always kept. The slaves of a PrecalcShapeset share the budget of their master.
+  /// \param bytes [in] The budget in bytes, 0 means unlimited (the default).
+  void set_cache_budget(int bytes) { cache_owner->cache_budget = bytes; }
+
+  /// \brief Sets the budget of the functions created from now on (see set_cache_budget()).
+  static void set_default_cache_budget(int bytes) { default_cache_budget = bytes; }
+
+  /// \brief Returns the statistics of the precalculated tables of this function. For a slave
+  /// PrecalcShapeset, the memory, budget and evictions are those of its master.
+  void get_cache_stats(FnCacheStats& stats) const;
+
+  /// \brief Prints the statistics of the precalculated tables summarized per class, including
+  /// the functions already destroyed.
+  static void dump_cache_stats(FILE* f = stdout);
+
+
 protected:
 
   /// precalculates the current function at the current integration points.
@@ -235,33 +304,36 @@ protected:
   int order;          ///< current function polynomial order
   int num_components; ///< number of vector components
 
-# define H2D_Node_HDR_SIZE (sizeof(Node) - sizeof(TYPE)) ///< Size of the header part of the structure Node
+# define H2D_NODE_ALIGN 16 ///< Alignment of the value tables in bytes (a power of two)
+  /// The value tables are allocated separately, so that they can be evicted while the node
+  /// stays in its Judy array (with an empty mask).
   struct Node
   {
     int mask;           ///< a combination of H2D_FN_XXX: specifies which tables are present
-    int size;           ///< size in bytes of this struct (for maintaining total_mem)
+    int size;           ///< size in bytes of this struct and 'data' (for maintaining total_mem)
     TYPE* values[2][6]; ///< pointers to 'data'
 
-    TYPE data[1];       ///< value tables. The length may vary.
-  private: //operation that are not allowed due to the variable length of the Node structure
+    void* data;         ///< value tables, NULL if evicted
+    int used;           ///< set by set_quad_order(), cleared by evict_nodes()
+    Node* lru_prev;     ///< newer node (see set_cache_budget())
+    Node* lru_next;     ///< older node
+  private: //operation that are not allowed, the node owns 'data'
     Node(const Node& org) {}; ///< Copy constructor is disabled.
     Node& operator=(const Node& other) { return *this; }; ///< Assignment is not allowed.
   };
 
   void** sub_tables;  ///< pointer to the current secondary Judy array
   void** nodes;       ///< pointer to the current tertiary Judy array FIXME
+  void** flat_nodes;  ///< nodes of the untransformed function indexed by order, NULL if not used
+  int num_flat_nodes; ///< length of 'flat_nodes'
   void** pp_cur_node;
-  void*  overflow_nodes;
   Node*  cur_node;
 
   void update_nodes_ptr()
   {
-    if (sub_idx > H2D_MAX_IDX)
-      handle_overflow_idx();
-    else {
-      //debug_assert((sub_idx << (sizeof(Word_t) * 8)) == 0, "E index is larger than JudyLins can contain (Function::update_nodes_ptr)");
-      nodes = (void**) JudyLIns(sub_tables, (Word_t)sub_idx, NULL);
-    }
+    if (sub_idx == 0 && flat_nodes != NULL)
+      return; // see set_quad_order()
+    nodes = get_trf_slot(sub_tables, sub_idx);
   }
 
   /// For internal use only.
@@ -277,18 +349,44 @@ protected:
   int total_mem;    ///< total memory in bytes used by the tables
   int max_mem;      ///< peak memory usage
 
+  Function<TYPE>* cache_owner; ///< the function whose budget and statistics the tables count to
+  const char* cache_class;     ///< class name in the statistics, set by the constructors
+  int cache_budget;            ///< see set_cache_budget()
+  unsigned long cache_hits, cache_misses, cache_evictions;
+  Node* lru_first;             ///< newest node with tables
+  Node* lru_last;              ///< oldest node with tables
+  int lru_count;               ///< number of nodes in the list
+
   Node* new_node(int mask, int num_points); ///< allocates a new Node structure
+  void  free_node(Node* node);
   void  free_nodes(void** nodes);
   void  free_sub_tables(void** sub);
-  void  handle_overflow_idx();
 
   void replace_cur_node(Node* node)
   {
-    if (cur_node != NULL) { total_mem -= cur_node->size; ::free(cur_node); }
+    if (cur_node != NULL) free_node(cur_node);
     *pp_cur_node = node;
     cur_node = node;
   }
 
+  void lru_unlink(Node* node)
+  {
+    if (node->lru_prev != NULL) node->lru_prev->lru_next = node->lru_next; else lru_first = node->lru_next;
+    if (node->lru_next != NULL) node->lru_next->lru_prev = node->lru_prev; else lru_last = node->lru_prev;
+    lru_count--;
+  }
+
+  void lru_push(Node* node)
+  {
+    node->lru_prev = NULL;
+    node->lru_next = lru_first;
+    if (lru_first != NULL) lru_first->lru_prev = node; else lru_last = node;
+    lru_first = node;
+    lru_count++;
+  }
+
+  void evict_nodes(); ///< frees the least recently used tables exceeding the budget
+
   void H2D_CHECK_ORDER(Quad2D* quad, int order)
   {
     if (order < 0 || order >= quad->get_num_tables())
@@ -297,6 +395,16 @@ protected:
 
   static int idx2mask[6][2];  ///< index to mask table
 
+  static int default_cache_budget;
+  static Function<TYPE>* cache_registry;  ///< all existing functions, linked by 'cache_next'
+  Function<TYPE>* cache_prev;
+  Function<TYPE>* cache_next;
+  static const char* retired_class[H2D_CACHE_MAX_CLASSES]; ///< statistics of the destroyed functions
+  static FnCacheStats retired_stats[H2D_CACHE_MAX_CLASSES];
+
+  void get_class_stats(FnCacheStats& stats) const; ///< the share of this function in the summary
+  static void add_class_stats(const char** names, FnCacheStats* stats, const char* name, const FnCacheStats& s);
+
 };
 
 
@@ -325,17 +433,39 @@ Function<TYPE>::Function()
   nodes = NULL;
   cur_node = NULL;
   sub_tables = NULL;
-  overflow_nodes = NULL;
+  flat_nodes = NULL;
+  num_flat_nodes = 0;
 
   memset(quads, 0, sizeof(quads));
+
+  cache_owner = this;
+  cache_class = "Function";
+  cache_budget = default_cache_budget;
+  cache_hits = cache_misses = cache_evictions = 0;
+  lru_first = lru_last = NULL;
+  lru_count = 0;
+
+#pragma omp critical(fn_cache_registry)
+  {
+    cache_prev = NULL;
+    cache_next = cache_registry;
+    if (cache_registry != NULL) cache_registry->cache_prev = this;
+    cache_registry = this;
+  }
 }
 
 
 template<typename TYPE>
 Function<TYPE>::~Function()
 {
-  if (overflow_nodes != NULL)
-    free_nodes(&overflow_nodes);
+#pragma omp critical(fn_cache_registry)
+  {
+    FnCacheStats stats;
+    get_class_stats(stats);
+    add_class_stats(retired_class, retired_stats, cache_class, stats);
+    if (cache_prev != NULL) cache_prev->cache_next = cache_next; else cache_registry = cache_next;
+    if (cache_next != NULL) cache_next->cache_prev = cache_prev;
+  }
 }
 
 
@@ -395,28 +525,85 @@ typename Function<TYPE>::Node* Function<TYPE>::new_node(int mask, int num_points
   if (num_components < 2) m &= H2D_FN_VAL_0 | H2D_FN_DX_0 | H2D_FN_DY_0 | H2D_FN_DXX_0 | H2D_FN_DYY_0 | H2D_FN_DXY_0;
   while (m) { nt += m & 1; m >>= 1; }
 
-  // allocate a node including its data part, init table pointers
-  int size = H2D_Node_HDR_SIZE + sizeof(TYPE) * num_points * nt; //Due to impl. reasons, the structure Node has non-zero length of data even though they can be zero.
-  Node* node = (Node*) malloc(size);
+  // allocate a node including its data part, init table pointers; the tables start at
+  // H2D_NODE_ALIGN byte boundaries (malloc() guarantees at least the alignment of double),
+  // so that the loops over the integration points can use aligned SIMD loads
+  int stride = num_points;
+  if (sizeof(TYPE) < H2D_NODE_ALIGN) stride = (num_points + H2D_NODE_ALIGN / sizeof(TYPE) - 1) & ~(H2D_NODE_ALIGN / sizeof(TYPE) - 1);
+  int size = sizeof(TYPE) * stride * nt + H2D_NODE_ALIGN;
+  Node* node = (Node*) malloc(sizeof(Node));
   node->mask = mask;
-  node->size = size;
+  node->size = sizeof(Node) + size;
+  node->data = malloc(size);
+  node->used = 0;
   memset(node->values, 0, sizeof(node->values));
-  TYPE* data = node->data;
+  TYPE* data = (TYPE*) (((uintptr_t) node->data + H2D_NODE_ALIGN - 1) & ~(uintptr_t) (H2D_NODE_ALIGN - 1));
   for (int j = 0; j < num_components; j++) {
     for (int i = 0; i < 6; i++)
       if (mask & idx2mask[i][j]) {
         node->values[j][i] = data;
-        data += num_points;
+        data += stride;
       }
   }
   // todo: maybe put here copying of the old node
 
-  total_mem += size;
-  if (max_mem < total_mem) max_mem = total_mem;
+  Function<TYPE>* o = cache_owner;
+  o->total_mem += node->size;
+  if (o->max_mem < o->total_mem) o->max_mem = o->total_mem;
+  o->lru_push(node);
+  if (o->cache_budget > 0 && o->total_mem > o->cache_budget) evict_nodes();
   return node;
 }
 
 
+template<typename TYPE>
+void Function<TYPE>::free_node(Node* node)
+{
+  Function<TYPE>* o = cache_owner;
+  if (node->data != NULL)
+  {
+    o->lru_unlink(node);
+    ::free(node->data);
+  }
+  o->total_mem -= node->size;
+  ::free(node);
+}
+
+
+template<typename TYPE>
+void Function<TYPE>::evict_nodes()
+{
+  // walk from the oldest node; the nodes used since the last pass are moved to the front
+  // instead, the current node is skipped (precalculate() copies its tables to the new node)
+  Function<TYPE>* o = cache_owner;
+  Node* node = o->lru_last;
+  int n = o->lru_count - H2D_CACHE_KEEP_NODES;
+  while (n-- > 0 && o->total_mem > o->cache_budget)
+  {
+    Node* prev = node->lru_prev;
+    if (node->used)
+    {
+      node->used = 0;
+      o->lru_unlink(node);
+      o->lru_push(node);
+    }
+    else if (node != cur_node)
+    {
+      // the empty node stays in its Judy array, set_quad_order() sees the empty mask
+      o->lru_unlink(node);
+      ::free(node->data);
+      node->data = NULL;
+      o->total_mem -= node->size - sizeof(Node);
+      node->size = sizeof(Node);
+      node->mask = 0;
+      memset(node->values, 0, sizeof(node->values));
+      o->cache_evictions++;
+    }
+    node = prev;
+  }
+}
+
+
 template<typename TYPE>
 void Function<TYPE>::free_nodes(void** nodes)
 {
@@ -426,8 +613,7 @@ void Function<TYPE>::free_nodes(void** nodes)
   while (pp != NULL)
   {
     // free the concrete Node structure
-    total_mem -= ((Node*) *pp)->size;
-    ::free(*pp);
+    free_node((Node*) *pp);
     pp = JudyLNext(*nodes, &order, NULL);
   }
   JudyLFreeArray(nodes, NULL);
@@ -442,21 +628,104 @@ void Function<TYPE>::free_sub_tables(void** sub)
   void** nodes = (void**) JudyLFirst(*sub, &idx, NULL);
   while (nodes != NULL)
   {
-    free_nodes(nodes);
+    if (is_hashed_trf_key(idx))
+    {
+      for (TrfSlot* slot = (TrfSlot*) *nodes; slot != NULL; slot = slot->next)
+        free_nodes(&slot->value);
+      free_trf_slots((TrfSlot*) *nodes);
+    }
+    else
+      free_nodes(nodes);
     nodes = JudyLNext(*sub, &idx, NULL);
   }
   JudyLFreeArray(sub, NULL);
 }
 
+template<typename TYPE>
+void Function<TYPE>::get_cache_stats(FnCacheStats& stats) const
+{
+  const Function<TYPE>* o = cache_owner;
+  stats.instances = 1;
+  stats.hits = cache_hits;
+  stats.misses = cache_misses;
+  stats.evictions = o->cache_evictions;
+  stats.mem = o->total_mem;
+  stats.peak_mem = o->max_mem;
+  stats.budget = o->cache_budget;
+}
+
+
+template<typename TYPE>
+void Function<TYPE>::get_class_stats(FnCacheStats& stats) const
+{
+  // the tables of the slaves are counted by their owners
+  if (cache_owner == this)
+    get_cache_stats(stats);
+  else
+  {
+    stats.hits = cache_hits;
+    stats.misses = cache_misses;
+  }
+}
+
 
 template<typename TYPE>
-void Function<TYPE>::handle_overflow_idx()
+void Function<TYPE>::add_class_stats(const char** names, FnCacheStats* stats, const char* name, const FnCacheStats& s)
 {
-  if (overflow_nodes != NULL) free_nodes(&overflow_nodes);
-  overflow_nodes = NULL;
-  nodes = &overflow_nodes;
+  // the last entry collects the classes which do not fit
+  int i = 0;
+  while (i < H2D_CACHE_MAX_CLASSES - 1 && names[i] != NULL && strcmp(names[i], name))
+    i++;
+  if (names[i] == NULL) names[i] = (i < H2D_CACHE_MAX_CLASSES - 1) ? name : "(other)";
+  stats[i].add(s);
 }
 
+
+template<typename TYPE>
+void Function<TYPE>::dump_cache_stats(FILE* f)
+{
+  const char* names[H2D_CACHE_MAX_CLASSES];
+  FnCacheStats stats[H2D_CACHE_MAX_CLASSES];
+
+#pragma omp critical(fn_cache_registry)
+  {
+    memcpy(names, retired_class, sizeof(names));
+    for (int i = 0; i < H2D_CACHE_MAX_CLASSES; i++)
+      stats[i] = retired_stats[i];
+
+    for (Function<TYPE>* fn = cache_registry; fn != NULL; fn = fn->cache_next)
+    {
+      FnCacheStats s;
+      fn->get_class_stats(s);
+      add_class_stats(names, stats, fn->cache_class, s);
+    }
+  }
+
+  fprintf(f, "%-16s %9s %12s %12s %6s %12s %10s %10s %10s\n", "class", "functions", "hits", "misses",
+          "hit %", "evictions", "mem [kB]", "peak [kB]", "budget [kB]");
+  for (int i = 0; i < H2D_CACHE_MAX_CLASSES && names[i] != NULL; i++)
+  {
+    FnCacheStats& s = stats[i];
+    unsigned long n = s.hits + s.misses;
+    fprintf(f, "%-16s %9d %12lu %12lu %6.1f %12lu %10.1f %10.1f %10.1f\n", names[i], s.instances, s.hits,
+            s.misses, n ? 100.0 * s.hits / n : 0.0, s.evictions, s.mem / 1024.0, s.peak_mem / 1024.0,
+            s.budget / 1024.0);
+  }
+}
+
+
+template<typename TYPE>
+int Function<TYPE>::default_cache_budget = 0;
+
+template<typename TYPE>
+Function<TYPE>* Function<TYPE>::cache_registry = NULL;
+
+template<typename TYPE>
+const char* Function<TYPE>::retired_class[H2D_CACHE_MAX_CLASSES];
+
+template<typename TYPE>
+FnCacheStats Function<TYPE>::retired_stats[H2D_CACHE_MAX_CLASSES];
+
 #undef H2D_Node_HRD_SIZE
 
 #endif
@@ -58,11 +58,16 @@
 #include "../hermes_common/solver/petsc.h"
 #include "../hermes_common/solver/umfpack_solver.h"
 #include "../hermes_common/solver/superlu.h"
+#include "../hermes_common/solver/mixed_precision.h"
+#include "../hermes_common/solver/eigensolver.h"
+#include "../hermes_common/solver/krylov.h"
+#include "../hermes_common/solver/bsr.h"
 
 // preconditioners
 #include "../hermes_common/solver/precond.h"
 #include "../hermes_common/solver/precond_ifpack.h"
 #include "../hermes_common/solver/precond_ml.h"
+#include "../hermes_common/solver/precond_native.h"
 
 #include "integrals_h1.h"
 #include "integrals_hcurl.h"
@@ -96,6 +101,7 @@
 #include "adapt/adapt.h"
 
 #include "ogprojection.h"
+#include "newton_solver.h"
 
 /**
 
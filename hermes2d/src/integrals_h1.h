@@ -17,6 +17,7 @@
 #define __H2D_INTEGRALS_H1_H
 
 #include "limit_order.h"
+#include "forms.h"
 #include "weakform.h"
 
 //// the following integrals can be used in both volume and surface forms //////////////////////////////////////////////////////////////////////////////
@@ -138,6 +139,46 @@ Scalar int_w_nabla_u_v(int n, double *wt, Func<Real> *w1, Func<Real> *w2, Func<R
   return result;
 }
 
+//// element-level integrals (all the pairs of shape functions at once) /////////////////////////////////////////////////
+
+// The local matrices mat[i][j] = int(u_j, v_i) for the element-level matrix forms (see
+// WeakForm::matrix_form_elem_t). Every entry is a dot product of two contiguous rows of the
+// (ns x n) tables, so the whole matrix is the product V diag(wt) U^T and the inner loops
+// vectorize.
+
+inline void int_u_v_elem(int n, double *wt, ShapeTable *u, ShapeTable *v, scalar **mat)
+{
+  for (int i = 0; i < v->ns; i++)
+  {
+    double *vval = v->val + i * n;
+    for (int j = 0; j < u->ns; j++)
+    {
+      double *uval = u->val + j * n;
+      double result = 0;
+      for (int k = 0; k < n; k++)
+        result += wt[k] * (uval[k] * vval[k]);
+      mat[i][j] = result;
+    }
+  }
+}
+
+inline void int_grad_u_grad_v_elem(int n, double *wt, ShapeTable *u, ShapeTable *v, scalar **mat)
+{
+  for (int i = 0; i < v->ns; i++)
+  {
+    double *vdx = v->dx + i * n, *vdy = v->dy + i * n;
+    for (int j = 0; j < u->ns; j++)
+    {
+      double *udx = u->dx + j * n, *udy = u->dy + j * n;
+      double result = 0;
+      for (int k = 0; k < n; k++)
+        result += wt[k] * (udx[k] * vdx[k] + udy[k] * vdy[k]);
+      mat[i][j] = result;
+    }
+  }
+}
+
+
 //// error calculation for adaptivity  //////////////////////////////////////////////////////////////////////////////
 
 template<typename Real, typename Scalar>
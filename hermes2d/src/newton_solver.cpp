@@ -0,0 +1,164 @@
+// This file is part of Hermes2D.
+//
+// Hermes2D is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Hermes2D is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Hermes2D.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "hermes2d.h"
+
+/* BEGIN IDENTICAL CODE WITH H3D */
+
+NewtonSolver::NewtonSolver(DiscreteProblem* dp, MatrixSolverType matrix_solver)
+{
+  _F_
+  if (dp == NULL) error("DiscreteProblem is NULL in NewtonSolver.");
+  this->dp = dp;
+  matrix = create_matrix(matrix_solver);
+  rhs = create_vector(matrix_solver);
+  solver = create_linear_solver(matrix_solver, matrix, rhs);
+  // the sparse structure is created for the new matrix
+  dp->invalidate_matrix();
+
+  tol = 1e-6;
+  max_iters = 100;
+  jacobian_reuse = 1;
+  damping = false;
+  max_halvings = 10;
+  verbose_output = true;
+}
+
+NewtonSolver::~NewtonSolver()
+{
+  _F_
+  delete solver;
+  delete matrix;
+  delete rhs;
+}
+
+double NewtonSolver::get_rhs_norm()
+{
+  _F_
+  double norm = 0;
+  for (int i = 0; i < rhs->length(); i++)
+  {
+    scalar v = rhs->get(i);
+    norm += std::abs(v * v);
+  }
+  return sqrt(norm);
+}
+
+double NewtonSolver::get_assembly_time()
+{
+  double t = 0.0;
+  for (unsigned int i = 0; i < iter_info.size(); i++) t += iter_info[i].assembly_time;
+  return t;
+}
+
+double NewtonSolver::get_solver_time()
+{
+  double t = 0.0;
+  for (unsigned int i = 0; i < iter_info.size(); i++) t += iter_info[i].solver_time;
+  return t;
+}
+
+bool NewtonSolver::solve(scalar* coeff_vec)
+{
+  _F_
+  int ndof = dp->get_num_dofs();
+  iter_info.clear();
+
+  // previous coefficient vector, for the damping
+  scalar* prev = damping ? new scalar[ndof] : NULL;
+
+  TimePeriod timer;
+  int age = jacobian_reuse;       // iterations since the Jacobian matrix was assembled
+  bool factorized = false;        // the matrix was factorized in this solve()
+  bool have_residual = false;     // 'rhs' already holds the residual of 'coeff_vec'
+  bool converged = false;
+  while (1)
+  {
+    IterInfo it;
+    it.damping = 1.0;
+    it.solver_time = 0.0;
+
+    // Assemble the Jacobian matrix and the residual vector, or only the residual vector.
+    timer.tick(HERMES_SKIP);
+    it.jacobian = (age >= jacobian_reuse);
+    if (it.jacobian)
+    {
+      dp->assemble(coeff_vec, matrix, rhs, false);
+      age = 0;
+    }
+    else if (!have_residual)
+      dp->assemble(coeff_vec, matrix, rhs, true);
+    it.assembly_time = timer.tick().last();
+
+    it.residual_norm = get_rhs_norm();
+    info_if(verbose_output, "---- Newton iter %d, ndof %d, res. l2 norm %g%s", (int) iter_info.size() + 1,
+            ndof, it.residual_norm, it.jacobian ? "" : " (reused Jacobian)");
+    if (it.residual_norm < tol || (int) iter_info.size() >= max_iters)
+    {
+      converged = (it.residual_norm < tol);
+      iter_info.push_back(it);
+      break;
+    }
+
+    // J(Y^n) \deltaY^{n+1} = -F(Y^n), the factorization of J is reused when J was not assembled.
+    for (int i = 0; i < ndof; i++) rhs->set(i, -rhs->get(i));
+    if (!it.jacobian) solver->set_factorization_scheme(HERMES_REUSE_FACTORIZATION_COMPLETELY);
+    else if (factorized) solver->set_factorization_scheme(HERMES_REUSE_MATRIX_REORDERING);
+    else solver->set_factorization_scheme(HERMES_FACTORIZE_FROM_SCRATCH);
+    factorized = true;
+
+    timer.tick(HERMES_SKIP);
+    bool solved = solver->solve();
+    it.solver_time = timer.tick().last();
+    if (!solved)
+    {
+      warning("Matrix solver failed in NewtonSolver::solve().");
+      iter_info.push_back(it);
+      break;
+    }
+    scalar* delta = solver->get_solution();
+
+    // Add \deltaY^{n+1} to Y^n, halved until the residual decreases if damping is on.
+    if (damping)
+    {
+      memcpy(prev, coeff_vec, ndof * sizeof(scalar));
+      for (int h = 0; ; h++)
+      {
+        for (int i = 0; i < ndof; i++) coeff_vec[i] = prev[i] + it.damping * delta[i];
+        timer.tick(HERMES_SKIP);
+        dp->assemble(coeff_vec, matrix, rhs, true);
+        it.assembly_time += timer.tick().last();
+        if (get_rhs_norm() < it.residual_norm || h >= max_halvings) break;
+        it.damping *= 0.5;
+      }
+      if (it.damping < 1.0)
+        info_if(verbose_output, "---- Newton iter %d, damping factor %g", (int) iter_info.size() + 1, it.damping);
+      have_residual = true;
+    }
+    else
+    {
+      for (int i = 0; i < ndof; i++) coeff_vec[i] += delta[i];
+      have_residual = false;
+    }
+
+    iter_info.push_back(it);
+    age++;
+  }
+
+  if (prev != NULL) delete [] prev;
+  return converged;
+}
+
+/* END IDENTICAL CODE WITH H3D */
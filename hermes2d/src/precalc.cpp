@@ -16,6 +16,49 @@
 #include "h2d_common.h"
 #include "quad.h"
 #include "precalc.h"
+#include <vector>
+#ifndef _MSC_VER
+  #include <fcntl.h>
+  #include <unistd.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+#endif
+
+
+// The file of save_tables() and map_tables(): the header, the offsets of the tables for each
+// mode (a uint64_t for each shape and quadrature order, 0 if the order has no points), and the
+// tables. The tables of a node start at a H2D_NODE_ALIGN boundary and are laid out as in
+// Function::new_node(), so that the node can point into the mapped file.
+static const char TABLES_MAGIC[8] = "H2DPSS";
+static const int TABLES_VERSION = 1;
+
+struct TablesFileHeader
+{
+  char magic[8];
+  int version;
+  int byte_order;          ///< 0x01020304 as written by the saving machine
+  int sizeof_double;
+  int align;               ///< H2D_NODE_ALIGN
+  int shapeset_id;
+  int num_components;
+  int mask[2];             ///< tables stored for each shape (the defined expansions)
+  int max_index[2];
+  int num_tables[2];       ///< of the quadrature
+  uint64_t quad_checksum[2];
+  uint64_t offsets[2];     ///< position of the offset arrays in the file
+  uint64_t size;           ///< of the whole file
+};
+
+#define H2D_MAX_MAPPED_TABLES 16
+static const TablesFileHeader* mapped_files[H2D_MAX_MAPPED_TABLES];
+static int num_mapped_files = 0;
+
+// distance of the tables of a node, as in Function::new_node()
+static inline int get_table_stride(int np)
+{
+  if (sizeof(double) >= H2D_NODE_ALIGN) return np;
+  return (np + H2D_NODE_ALIGN / sizeof(double) - 1) & ~(H2D_NODE_ALIGN / sizeof(double) - 1);
+}
 
 
 
@@ -28,6 +71,9 @@ PrecalcShapeset::PrecalcShapeset(Shapeset* shapeset)
   num_components = shapeset->get_num_components();
   assert(num_components == 1 || num_components == 2);
   tables = NULL;
+  memset(flat_tables, 0, sizeof(flat_tables));
+  memset(mapped_tables, 0, sizeof(mapped_tables));
+  cache_class = "PrecalcShapeset";
   update_max_index();
   set_quad_2d(&g_quad_2d_std);
 }
@@ -42,6 +88,10 @@ PrecalcShapeset::PrecalcShapeset(PrecalcShapeset* pss)
   shapeset = pss->shapeset;
   num_components = pss->num_components;
   tables = NULL;
+  memset(flat_tables, 0, sizeof(flat_tables));
+  memset(mapped_tables, 0, sizeof(mapped_tables));
+  cache_owner = master_pss; // the tables are the master's
+  cache_class = "PrecalcShapeset";
   update_max_index();
   set_quad_2d(&g_quad_2d_std);
 }
@@ -89,10 +139,28 @@ void PrecalcShapeset::set_active_shape(int index)
   // is indexed solely by sub_idx. The last Judy array is the node table,
   // understood by the base class and indexed by order. The component and
   // val/d/dd indices are used directly in the Node structure.
-
-  unsigned key = cur_quad | (mode << 3) | ((unsigned) (max_index[mode] - index) << 4);
-  void** tab = (master_pss == NULL) ? &tables : &(master_pss->tables);
-  sub_tables = (void**) JudyLIns(tab, key, NULL);
+  //
+  // Shapes with index >= 0 (i.e., all except the constrained ones) have
+  // directly indexed rows instead (see 'flat_tables'), which replace the
+  // first Judy array, and the last one for sub_idx 0. The Judy arrays are
+  // only used for the sub-element transforms then.
+
+  PrecalcShapeset* master = (master_pss == NULL) ? this : master_pss;
+  void** row = NULL;
+  if (index >= 0 && index <= max_index[mode])
+    row = master->get_flat_row(cur_quad, get_quad_2d(), mode, index);
+  if (row != NULL)
+  {
+    sub_tables = row;
+    flat_nodes = row + 1;
+    num_flat_nodes = master->flat_row_size[cur_quad][mode] - 1;
+  }
+  else
+  {
+    unsigned key = cur_quad | (mode << 3) | ((unsigned) (max_index[mode] - index) << 4);
+    sub_tables = (void**) JudyLIns(&(master->tables), key, NULL);
+    flat_nodes = NULL;
+  }
   update_nodes_ptr();
 
   this->index = index;
@@ -101,6 +169,231 @@ void PrecalcShapeset::set_active_shape(int index)
 }
 
 
+void** PrecalcShapeset::get_flat_row(int quad, Quad2D* quad_2d, int mode, int index)
+{
+  void**& block = flat_tables[quad][mode];
+  if (block == NULL)
+  {
+    // global instances (ref_map_pss) may be set up before the quadrature tables
+    if (quad_2d->get_num_tables(mode) == 0) return NULL;
+    flat_row_size[quad][mode] = 1 + quad_2d->get_num_tables(mode);
+    int size = (max_index[mode] + 1) * flat_row_size[quad][mode];
+    block = new void*[size];
+    MEM_CHECK(block);
+    memset(block, 0, size * sizeof(void*));
+    find_mapped_tables(quad, quad_2d, mode);
+  }
+  return block + index * flat_row_size[quad][mode];
+}
+
+
+void PrecalcShapeset::find_mapped_tables(int quad, Quad2D* quad_2d, int mode)
+{
+  mapped_tables[quad][mode] = NULL;
+  if (num_mapped_files == 0) return;
+
+  uint64_t checksum = quad_2d->get_checksum(mode);
+  for (int i = 0; i < num_mapped_files; i++)
+  {
+    const TablesFileHeader* hdr = mapped_files[i];
+    if (hdr->shapeset_id == shapeset->get_id() && hdr->num_components == num_components &&
+        hdr->max_index[mode] == max_index[mode] && hdr->num_tables[mode] == quad_2d->get_num_tables(mode) &&
+        hdr->quad_checksum[mode] == checksum)
+    {
+      mapped_tables[quad][mode] = hdr;
+      return;
+    }
+  }
+}
+
+
+bool PrecalcShapeset::use_mapped_tables(int order, int mask)
+{
+  PrecalcShapeset* master = (master_pss == NULL) ? this : master_pss;
+  const TablesFileHeader* hdr = (const TablesFileHeader*) master->mapped_tables[cur_quad][mode];
+  if (hdr == NULL || (mask & ~hdr->mask[mode]) != 0) return false;
+
+  const uint64_t* offsets = (const uint64_t*) ((const char*) hdr + hdr->offsets[mode]);
+  uint64_t pos = offsets[(uint64_t) index * hdr->num_tables[mode] + order];
+  if (pos == 0) return false;
+
+  // the node does not own the tables (data is NULL) and is not in the LRU list, so it is
+  // never evicted; the tables are read-only
+  Node* node = (Node*) malloc(sizeof(Node));
+  node->mask = hdr->mask[mode];
+  node->size = sizeof(Node);
+  node->data = NULL;
+  node->used = 0;
+  node->lru_prev = node->lru_next = NULL;
+  memset(node->values, 0, sizeof(node->values));
+  int stride = get_table_stride(get_quad_2d()->get_num_points(order));
+  double* data = (double*) ((const char*) hdr + pos);
+  for (int j = 0; j < num_components; j++)
+    for (int k = 0; k < 6; k++)
+      if (node->mask & idx2mask[k][j])
+      {
+        node->values[j][k] = data;
+        data += stride;
+      }
+
+  master->total_mem += node->size; // the master is the cache owner
+  if (master->max_mem < master->total_mem) master->max_mem = master->total_mem;
+  replace_cur_node(node);
+  return true;
+}
+
+
+void PrecalcShapeset::save_tables(Shapeset* shapeset, const char* filename, Quad2D* quad_2d)
+{
+  _F_
+  PrecalcShapeset pss(shapeset);
+  pss.set_quad_2d(quad_2d);
+  int nc = pss.num_components;
+
+  TablesFileHeader hdr;
+  memset(&hdr, 0, sizeof(hdr));
+  memcpy(hdr.magic, TABLES_MAGIC, sizeof(hdr.magic));
+  hdr.version = TABLES_VERSION;
+  hdr.byte_order = 0x01020304;
+  hdr.sizeof_double = sizeof(double);
+  hdr.align = H2D_NODE_ALIGN;
+  hdr.shapeset_id = shapeset->get_id();
+  hdr.num_components = nc;
+
+  // the layout of the file
+  std::vector<uint64_t> offsets[2];
+  uint64_t pos = sizeof(hdr);
+  for (int m = 0; m < 2; m++)
+  {
+    shapeset->set_mode(m);
+    for (int k = 0; k < 6; k++)
+      if (shapeset->has_expansion(k))
+        hdr.mask[m] |= idx2mask[k][0] | idx2mask[k][1];
+    hdr.max_index[m] = pss.max_index[m];
+    hdr.num_tables[m] = quad_2d->get_num_tables(m);
+    hdr.quad_checksum[m] = quad_2d->get_checksum(m);
+    hdr.offsets[m] = pos;
+    offsets[m].resize((hdr.max_index[m] + 1) * hdr.num_tables[m], 0);
+    pos += offsets[m].size() * sizeof(uint64_t);
+  }
+  for (int m = 0; m < 2; m++)
+  {
+    int nt = 0;
+    for (int j = 0; j < nc; j++)
+      for (int k = 0; k < 6; k++)
+        if (hdr.mask[m] & idx2mask[k][j]) nt++;
+    quad_2d->set_mode(m);
+    for (int i = 0; i <= hdr.max_index[m]; i++)
+      for (int o = 0; o < hdr.num_tables[m]; o++)
+      {
+        int np = quad_2d->get_num_points(o);
+        if (np <= 0 || quad_2d->get_points(o) == NULL) continue;
+        pos = (pos + H2D_NODE_ALIGN - 1) & ~(uint64_t) (H2D_NODE_ALIGN - 1);
+        offsets[m][i * hdr.num_tables[m] + o] = pos;
+        pos += (uint64_t) get_table_stride(np) * nt * sizeof(double);
+      }
+  }
+  hdr.size = pos;
+
+  FILE* f = fopen(filename, "wb");
+  if (f == NULL) error("Could not open %s for writing.", filename);
+  hermes_fwrite(&hdr, sizeof(hdr), 1, f);
+  for (int m = 0; m < 2; m++)
+    hermes_fwrite(&offsets[m][0], sizeof(uint64_t), offsets[m].size(), f);
+
+  // the tables, calculated shape by shape
+  static const double zeros[H2D_NODE_ALIGN] = { 0 };
+  pos = ftell(f);
+  for (int m = 0; m < 2; m++)
+  {
+    pss.set_mode(m);
+    for (int i = 0; i <= hdr.max_index[m]; i++)
+    {
+      pss.set_active_shape(i);
+      for (int o = 0; o < hdr.num_tables[m]; o++)
+      {
+        uint64_t off = offsets[m][i * hdr.num_tables[m] + o];
+        if (off == 0) continue;
+        hermes_fwrite(zeros, 1, off - pos, f);
+        pss.set_quad_order(o, hdr.mask[m]);
+        int np = quad_2d->get_num_points(o), stride = get_table_stride(np);
+        for (int j = 0; j < nc; j++)
+          for (int k = 0; k < 6; k++)
+            if (hdr.mask[m] & idx2mask[k][j])
+            {
+              hermes_fwrite(pss.cur_node->values[j][k], sizeof(double), np, f);
+              hermes_fwrite(zeros, sizeof(double), stride - np, f);
+              off += stride * sizeof(double);
+            }
+        pos = off;
+      }
+      pss.free(); // the tables of one shape at a time
+    }
+  }
+  fclose(f);
+}
+
+
+bool PrecalcShapeset::map_tables(const char* filename)
+{
+  _F_
+  if (num_mapped_files >= H2D_MAX_MAPPED_TABLES)
+  {
+    warn("Too many files of precalculated tables, %s is not used.", filename);
+    return false;
+  }
+
+  // the file is never unmapped, the nodes point into it
+  const char* base = NULL;
+  uint64_t size = 0;
+#ifndef _MSC_VER
+  int fd = open(filename, O_RDONLY);
+  if (fd < 0) { warn("Could not open %s.", filename); return false; }
+  struct stat st;
+  if (fstat(fd, &st) == 0 && st.st_size >= (off_t) sizeof(TablesFileHeader))
+  {
+    size = st.st_size;
+    void* p = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (p != MAP_FAILED) base = (const char*) p;
+  }
+  close(fd);
+#else
+  // no mmap(): read the file, it is not shared between processes then
+  FILE* f = fopen(filename, "rb");
+  if (f == NULL) { warn("Could not open %s.", filename); return false; }
+  fseek(f, 0, SEEK_END);
+  long len = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  if (len >= (long) sizeof(TablesFileHeader))
+  {
+    size = len;
+    char* p = (char*) _aligned_malloc(size, H2D_NODE_ALIGN);
+    if (p != NULL && fread(p, 1, size, f) == size) base = p;
+    else if (p != NULL) _aligned_free(p);
+  }
+  fclose(f);
+#endif
+
+  const TablesFileHeader* hdr = (const TablesFileHeader*) base;
+  if (hdr == NULL || memcmp(hdr->magic, TABLES_MAGIC, sizeof(hdr->magic)) || hdr->version != TABLES_VERSION ||
+      hdr->byte_order != 0x01020304 || hdr->sizeof_double != sizeof(double) || hdr->align != H2D_NODE_ALIGN ||
+      hdr->size != size)
+  {
+    warn("%s is not a valid file of precalculated shapeset tables.", filename);
+    if (base != NULL)
+#ifndef _MSC_VER
+      munmap((void*) base, size);
+#else
+      _aligned_free((void*) base);
+#endif
+    return false;
+  }
+
+  mapped_files[num_mapped_files++] = hdr;
+  return true;
+}
+
+
 void PrecalcShapeset::set_active_element(Element* e)
 {
   mode = e->get_mode();
@@ -123,6 +416,13 @@ void PrecalcShapeset::precalculate(int order, int mask)
 {
   int i, j, k;
 
+  // untransformed shapes: the tables of a file of map_tables(), if there is one
+  if (sub_idx == 0 && flat_nodes != NULL)
+  {
+    get_quad_2d()->set_mode(mode);
+    if (use_mapped_tables(order, mask)) return;
+  }
+
   // initialization
   Quad2D* quad = get_quad_2d();
   quad->set_mode(mode);
@@ -158,6 +458,26 @@ void PrecalcShapeset::free()
 {
   if (master_pss != NULL) return;
 
+  // the directly indexed rows
+  for (int q = 0; q < 4; q++)
+    for (int m = 0; m < 2; m++)
+    {
+      void** block = flat_tables[q][m];
+      if (block == NULL) continue;
+      for (int i = 0; i <= max_index[m]; i++)
+      {
+        void** row = block + i * flat_row_size[q][m];
+        free_sub_tables(row);
+        for (int o = 1; o < flat_row_size[q][m]; o++)
+          if (row[o] != NULL)
+            free_node((Node*) row[o]);
+      }
+      delete [] block;
+      flat_tables[q][m] = NULL;
+    }
+  flat_nodes = NULL;
+  cur_node = NULL;
+
   // iterate through the primary Judy array
   unsigned long key = 0;
   void** sub = (void**) JudyLFirst(tables, &key, NULL);
@@ -171,6 +491,40 @@ void PrecalcShapeset::free()
 }
 
 
+void PrecalcShapeset::dump_nodes(FILE* f, uint64_t sub_idx, void** nodes,
+                                  unsigned long& n2, unsigned long& n3, unsigned long& size)
+{
+  fprintf(f, "   SUB TABLE, sub_idx=%llu\n      NODES: ", (unsigned long long) sub_idx); n2++;
+  unsigned long order = 0;
+  void** pp = (void**) JudyLFirst(*nodes, &order, NULL);
+  while (pp != NULL)
+  {
+    fprintf(f, "%ld ", order); n3++;
+    size += ((Node*) *pp)->size;
+    pp = JudyLNext(*nodes, &order, NULL);
+  }
+  fprintf(f, "\n");
+}
+
+
+void PrecalcShapeset::dump_sub_tables(FILE* f, void** sub, unsigned long& n2, unsigned long& n3, unsigned long& size)
+{
+  unsigned long idx = 0;
+  void** nodes = (void**) JudyLFirst(*sub, &idx, NULL);
+  while (nodes != NULL)
+  {
+    if (is_hashed_trf_key(idx))
+    {
+      for (TrfSlot* slot = (TrfSlot*) *nodes; slot != NULL; slot = slot->next)
+        dump_nodes(f, slot->sub_idx, &slot->value, n2, n3, size);
+    }
+    else
+      dump_nodes(f, idx, nodes, n2, n3, size);
+    nodes = JudyLNext(*sub, &idx, NULL);
+  }
+}
+
+
 void PrecalcShapeset::dump_info(int quad, const char* filename)
 {
   FILE* f = fopen(filename, "w");
@@ -183,25 +537,34 @@ void PrecalcShapeset::dump_info(int quad, const char* filename)
     if ((key & 7) == quad)
     {
       fprintf(f, "PRIMARY TABLE, mode=%ld, index=%ld\n", (key >> 3) & 1, max_index[mode] - (key >> 4));
-      unsigned long idx = 0;
-      void** nodes = (void**) JudyLFirst(*sub, &idx, NULL);
-      while (nodes != NULL)
-      {
-        fprintf(f, "   SUB TABLE, sub_idx=%ld\n      NODES: ", idx); n2++;
-        unsigned long order = 0;
-        void** pp = (void**) JudyLFirst(*nodes, &order, NULL);
-        while (pp != NULL)
+      dump_sub_tables(f, sub, n2, n3, size);
+      fprintf(f, "\n\n"); n1++;
+    }
+    sub = JudyLNext(tables, &key, NULL); m1++;
+  }
+
+  // the directly indexed rows
+  for (int m = 0; m < 2; m++)
+  {
+    if (flat_tables[quad][m] == NULL) continue;
+    for (int i = 0; i <= max_index[m]; i++)
+    {
+      void** row = flat_tables[quad][m] + i * flat_row_size[quad][m];
+      bool used = (*row != NULL);
+      for (int o = 1; o < flat_row_size[quad][m]; o++)
+        if (row[o] != NULL) used = true;
+      if (!used) continue;
+      fprintf(f, "DIRECT TABLE, mode=%d, index=%d\n   SUB TABLE, sub_idx=0\n      NODES: ", m, i); n2++;
+      for (int o = 1; o < flat_row_size[quad][m]; o++)
+        if (row[o] != NULL)
         {
-          fprintf(f, "%ld ", order); n3++;
-          size += ((Node*) *pp)->size;
-          pp = JudyLNext(*nodes, &order, NULL);
+          fprintf(f, "%d ", o - 1); n3++;
+          size += ((Node*) row[o])->size;
         }
-        fprintf(f, "\n");
-        nodes = JudyLNext(*sub, &idx, NULL);
-      }
+      fprintf(f, "\n");
+      dump_sub_tables(f, row, n2, n3, size);
       fprintf(f, "\n\n"); n1++;
     }
-    sub = JudyLNext(tables, &key, NULL); m1++;
   }
 
   fprintf(f, "Number of primary tables: %ld (%ld for all quadratures)\n"
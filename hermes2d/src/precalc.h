@@ -72,6 +72,18 @@ public:
   /// Internal. Use set_active_element() instead.
   void set_mode(int mode);
 
+  /// Writes the values and all defined derivatives of all shape functions of the shapeset at
+  /// all integration points of 'quad_2d' (both modes, all orders, including the edge points)
+  /// to a binary file, to be used by map_tables().
+  static void save_tables(Shapeset* shapeset, const char* filename, Quad2D* quad_2d = &g_quad_2d_std);
+
+  /// Maps a file written by save_tables() read-only into memory. The untransformed tables of the
+  /// PrecalcShapesets of the same shapeset and quadrature (allocated after this call) then point
+  /// into the file instead of being calculated, so that all processes using the file share its
+  /// pages. The file stays mapped until the program exits. Returns false (with a warning) if the
+  /// file cannot be used, e.g. if it was written by a different version or on a different machine.
+  static bool map_tables(const char* filename);
+
   /// For internal use only.
   void set_master_transform()
   {
@@ -93,6 +105,29 @@ protected:
 
   void* tables; ///< primary Judy array of shapes
 
+  /// Directly indexed tables of the shapes with index >= 0, one block per quadrature and mode,
+  /// allocated on first use. The row of a shape is flat_tables[quad][mode] + index * row_size,
+  /// its first entry is the secondary (sub_idx) Judy array for the sub-element transforms, the
+  /// remaining entries are the nodes of the untransformed shape (sub_idx 0) indexed by order.
+  void** flat_tables[4][2];
+  int flat_row_size[4][2];
+
+  /// Returns the row of the shape, or NULL if the quadrature is not initialized yet.
+  void** get_flat_row(int quad, Quad2D* quad_2d, int mode, int index);
+
+  /// Header of the file of map_tables() matching the quadrature and mode, NULL if none.
+  const void* mapped_tables[4][2];
+
+  /// Looks up the file for 'mapped_tables' when the block of the rows is allocated.
+  void find_mapped_tables(int quad, Quad2D* quad_2d, int mode);
+
+  /// Attaches the tables of the file as the current node, returns false if the file has not all of them.
+  bool use_mapped_tables(int order, int mask);
+
+  // dump_info() of one secondary (sub_idx) Judy array and of one node table
+  void dump_sub_tables(FILE* f, void** sub, unsigned long& n2, unsigned long& n3, unsigned long& size);
+  void dump_nodes(FILE* f, uint64_t sub_idx, void** nodes, unsigned long& n2, unsigned long& n3, unsigned long& size);
+
   int mode;
   int index;
   int max_index[2];
@@ -123,10 +158,10 @@ public:
     {
       int index;
       int order;
-      int sub_idx;
+      uint64_t sub_idx;
       int shapeset_type;
       
-      Key(int index, int order, int sub_idx, int shapeset_type)
+      Key(int index, int order, uint64_t sub_idx, int shapeset_type)
       {
         this->index = index;
         this->order = order;
@@ -80,9 +80,26 @@ public:
   int get_max_order() const { return max_order[mode]; }
   int get_safe_max_order() const { return safe_max_order[mode]; }
   int get_num_tables() const { return num_tables[mode]; }
+  int get_num_tables(int mode) const { return num_tables[mode]; }
 
   double2* get_ref_vertex(int n) { return &ref_vert[mode][n]; }
 
+  /// Returns a checksum (FNV-1a) of the points of all tables of the mode. Used to check that
+  /// tables precalculated at the points belong to this quadrature (see PrecalcShapeset::map_tables()).
+  uint64_t get_checksum(int mode) const
+  {
+    uint64_t h = 14695981039346656037ULL;
+    for (int o = 0; o < num_tables[mode]; o++)
+    {
+      const unsigned char* p = (const unsigned char*) &np[mode][o];
+      for (unsigned i = 0; i < sizeof(int); i++) h = (h ^ p[i]) * 1099511628211ULL;
+      if (tables[mode][o] == NULL) continue;
+      p = (const unsigned char*) tables[mode][o];
+      for (unsigned i = 0; i < np[mode][o] * sizeof(double3); i++) h = (h ^ p[i]) * 1099511628211ULL;
+    }
+    return h;
+  }
+
 protected:
 
   int mode;
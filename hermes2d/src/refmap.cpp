@@ -22,6 +22,10 @@
 H1ShapesetJacobi ref_map_shapeset;
 PrecalcShapeset ref_map_pss(&ref_map_shapeset);
 
+// ref_map_pss is shared by all reference maps; in the parallel assembly (see
+// DiscreteProblem::set_parallel_assembly) it is only used in the "ref_map_pss" critical
+// sections, which activate the element of the calling reference map first.
+
 
 RefMap::RefMap()
 {
@@ -29,7 +33,6 @@ RefMap::RefMap()
   num_tables = 0;
   nodes = NULL;
   cur_node = NULL;
-  overflow = NULL;
   set_quad_2d(&g_quad_2d_std); // default quadrature
 }
 
@@ -47,7 +50,6 @@ void RefMap::set_active_element(Element* e)
 {
   if (e != element) free();
 
-  ref_map_pss.set_active_element(e);
   quad_2d->set_mode(e->get_mode());
   num_tables = quad_2d->get_num_tables();
   assert(num_tables <= H2D_MAX_TABLES);
@@ -61,35 +63,40 @@ void RefMap::set_active_element(Element* e)
   is_const = !element->is_curved() &&
              (element->is_triangle() || is_parallelogram());
 
-  // prepare the shapes and coefficients of the reference map
+  // prepare the shapes and coefficients of the reference map (the indices depend on
+  // the mode of the shared shapeset, which need not be the mode of this element)
   int j, k = 0;
-  for (unsigned int i = 0; i < e->nvert; i++)
-    indices[k++] = ref_map_shapeset.get_vertex_index(i);
-
-  // straight-edged element
-  if (e->cm == NULL)
+#pragma omp critical(ref_map_pss)
   {
+    ref_map_shapeset.set_mode(e->get_mode());
     for (unsigned int i = 0; i < e->nvert; i++)
+      indices[k++] = ref_map_shapeset.get_vertex_index(i);
+
+    // straight-edged element
+    if (e->cm == NULL)
     {
-      lin_coeffs[i][0] = e->vn[i]->x;
-      lin_coeffs[i][1] = e->vn[i]->y;
+      for (unsigned int i = 0; i < e->nvert; i++)
+      {
+        lin_coeffs[i][0] = e->vn[i]->x;
+        lin_coeffs[i][1] = e->vn[i]->y;
+      }
+      coeffs = lin_coeffs;
+      nc = e->nvert;
     }
-    coeffs = lin_coeffs;
-    nc = e->nvert;
-  }
-  else // curvilinear element - edge and bubble shapes
-  {
-    int o = e->cm->order;
-    for (unsigned int i = 0; i < e->nvert; i++)
-      for (j = 2; j <= o; j++)
-        indices[k++] = ref_map_shapeset.get_edge_index(i, 0, j);
+    else // curvilinear element - edge and bubble shapes
+    {
+      int o = e->cm->order;
+      for (unsigned int i = 0; i < e->nvert; i++)
+        for (j = 2; j <= o; j++)
+          indices[k++] = ref_map_shapeset.get_edge_index(i, 0, j);
 
-    if (e->is_quad()) o = H2D_MAKE_QUAD_ORDER(o, o);
-    memcpy(indices + k, ref_map_shapeset.get_bubble_indices(o),
-           ref_map_shapeset.get_num_bubbles(o) * sizeof(int));
+      if (e->is_quad()) o = H2D_MAKE_QUAD_ORDER(o, o);
+      memcpy(indices + k, ref_map_shapeset.get_bubble_indices(o),
+             ref_map_shapeset.get_num_bubbles(o) * sizeof(int));
 
-    coeffs = e->cm->coeffs;
-    nc = e->cm->nc;
+      coeffs = e->cm->coeffs;
+      nc = e->cm->nc;
+    }
   }
 
   // calculate the order of the inverse reference map
@@ -129,19 +136,23 @@ void RefMap::calc_inv_ref_map(int order)
 
   AUTOLA_OR(double2x2, m, np);
   memset(m, 0, m.size);
-  ref_map_pss.force_transform(sub_idx, ctm);
-  for (i = 0; i < nc; i++)
+#pragma omp critical(ref_map_pss)
   {
-    double *dx, *dy;
-    ref_map_pss.set_active_shape(indices[i]);
-    ref_map_pss.set_quad_order(order);
-    ref_map_pss.get_dx_dy_values(dx, dy);
-    for (j = 0; j < np; j++)
+    ref_map_pss.set_active_element(element);
+    ref_map_pss.force_transform(sub_idx, ctm);
+    for (i = 0; i < nc; i++)
     {
-      m[j][0][0] += coeffs[i][0] * dx[j];
-      m[j][0][1] += coeffs[i][0] * dy[j];
-      m[j][1][0] += coeffs[i][1] * dx[j];
-      m[j][1][1] += coeffs[i][1] * dy[j];
+      double *dx, *dy;
+      ref_map_pss.set_active_shape(indices[i]);
+      ref_map_pss.set_quad_order(order);
+      ref_map_pss.get_dx_dy_values(dx, dy);
+      for (j = 0; j < np; j++)
+      {
+        m[j][0][0] += coeffs[i][0] * dx[j];
+        m[j][0][1] += coeffs[i][0] * dy[j];
+        m[j][1][0] += coeffs[i][1] * dx[j];
+        m[j][1][1] += coeffs[i][1] * dy[j];
+      }
     }
   }
 
@@ -174,23 +185,27 @@ void RefMap::calc_second_ref_map(int order)
 
   AUTOLA_OR(double3x2, k, np);
   memset(k, 0, k.size);
-  ref_map_pss.force_transform(sub_idx, ctm);
-  for (i = 0; i < nc; i++)
+#pragma omp critical(ref_map_pss)
   {
-    double *dxy, *dxx, *dyy;
-    ref_map_pss.set_active_shape(indices[i]);
-    ref_map_pss.set_quad_order(order, H2D_FN_ALL);
-    dxx = ref_map_pss.get_dxx_values();
-    dyy = ref_map_pss.get_dyy_values();
-    dxy = ref_map_pss.get_dxy_values();
-    for (j = 0; j < np; j++)
+    ref_map_pss.set_active_element(element);
+    ref_map_pss.force_transform(sub_idx, ctm);
+    for (i = 0; i < nc; i++)
     {
-      k[j][0][0] += coeffs[i][0] * dxx[j];
-      k[j][0][1] += coeffs[i][1] * dxx[j];
-      k[j][1][0] += coeffs[i][0] * dxy[j];
-      k[j][1][1] += coeffs[i][1] * dxy[j];
-      k[j][2][0] += coeffs[i][0] * dyy[j];
-      k[j][2][1] += coeffs[i][1] * dyy[j];
+      double *dxy, *dxx, *dyy;
+      ref_map_pss.set_active_shape(indices[i]);
+      ref_map_pss.set_quad_order(order, H2D_FN_ALL);
+      dxx = ref_map_pss.get_dxx_values();
+      dyy = ref_map_pss.get_dyy_values();
+      dxy = ref_map_pss.get_dxy_values();
+      for (j = 0; j < np; j++)
+      {
+        k[j][0][0] += coeffs[i][0] * dxx[j];
+        k[j][0][1] += coeffs[i][1] * dxx[j];
+        k[j][1][0] += coeffs[i][0] * dxy[j];
+        k[j][1][1] += coeffs[i][1] * dxy[j];
+        k[j][2][0] += coeffs[i][0] * dyy[j];
+        k[j][2][1] += coeffs[i][1] * dyy[j];
+      }
     }
   }
 
@@ -263,14 +278,18 @@ void RefMap::calc_phys_x(int order)
   int i, j, np = quad_2d->get_num_points(order);
   double* x = cur_node->phys_x[order] = new double[np];
   memset(x, 0, np * sizeof(double));
-  ref_map_pss.force_transform(sub_idx, ctm);
-  for (i = 0; i < nc; i++)
+#pragma omp critical(ref_map_pss)
   {
-    ref_map_pss.set_active_shape(indices[i]);
-    ref_map_pss.set_quad_order(order);
-    double* fn = ref_map_pss.get_fn_values();
-    for (j = 0; j < np; j++)
-      x[j] += coeffs[i][0] * fn[j];
+    ref_map_pss.set_active_element(element);
+    ref_map_pss.force_transform(sub_idx, ctm);
+    for (i = 0; i < nc; i++)
+    {
+      ref_map_pss.set_active_shape(indices[i]);
+      ref_map_pss.set_quad_order(order);
+      double* fn = ref_map_pss.get_fn_values();
+      for (j = 0; j < np; j++)
+        x[j] += coeffs[i][0] * fn[j];
+    }
   }
 }
 
@@ -281,14 +300,18 @@ void RefMap::calc_phys_y(int order)
   int i, j, np = quad_2d->get_num_points(order);
   double* y = cur_node->phys_y[order] = new double[np];
   memset(y, 0, np * sizeof(double));
-  ref_map_pss.force_transform(sub_idx, ctm);
-  for (i = 0; i < nc; i++)
+#pragma omp critical(ref_map_pss)
   {
-    ref_map_pss.set_active_shape(indices[i]);
-    ref_map_pss.set_quad_order(order);
-    double* fn = ref_map_pss.get_fn_values();
-    for (j = 0; j < np; j++)
-      y[j] += coeffs[i][1] * fn[j];
+    ref_map_pss.set_active_element(element);
+    ref_map_pss.force_transform(sub_idx, ctm);
+    for (i = 0; i < nc; i++)
+    {
+      ref_map_pss.set_active_shape(indices[i]);
+      ref_map_pss.set_quad_order(order);
+      double* fn = ref_map_pss.get_fn_values();
+      for (j = 0; j < np; j++)
+        y[j] += coeffs[i][1] * fn[j];
+    }
   }
 }
 
@@ -317,22 +340,26 @@ void RefMap::calc_tangent(int edge, int eo)
   else
   {
     // construct jacobi matrices of the direct reference map at integration points along the edge
-    static double2x2 m[15];
+    double2x2 m[15];
     assert(np <= 15);
     memset(m, 0, np*sizeof(double2x2));
-    ref_map_pss.force_transform(sub_idx, ctm);
-    for (i = 0; i < nc; i++)
+#pragma omp critical(ref_map_pss)
     {
-      double *dx, *dy;
-      ref_map_pss.set_active_shape(indices[i]);
-      ref_map_pss.set_quad_order(eo);
-      ref_map_pss.get_dx_dy_values(dx, dy);
-      for (j = 0; j < np; j++)
+      ref_map_pss.set_active_element(element);
+      ref_map_pss.force_transform(sub_idx, ctm);
+      for (i = 0; i < nc; i++)
       {
-        m[j][0][0] += coeffs[i][0] * dx[j];
-        m[j][0][1] += coeffs[i][0] * dy[j];
-        m[j][1][0] += coeffs[i][1] * dx[j];
-        m[j][1][1] += coeffs[i][1] * dy[j];
+        double *dx, *dy;
+        ref_map_pss.set_active_shape(indices[i]);
+        ref_map_pss.set_quad_order(eo);
+        ref_map_pss.get_dx_dy_values(dx, dy);
+        for (j = 0; j < np; j++)
+        {
+          m[j][0][0] += coeffs[i][0] * dx[j];
+          m[j][0][1] += coeffs[i][0] * dy[j];
+          m[j][1][0] += coeffs[i][1] * dx[j];
+          m[j][1][1] += coeffs[i][1] * dy[j];
+        }
       }
     }
 
@@ -404,18 +431,22 @@ void RefMap::inv_ref_map_at_point(double xi1, double xi2, double& x, double& y,
   double2x2 tmp;
   memset(tmp, 0, sizeof(double2x2));
   x = y = 0;
-  for (int i = 0; i < nc; i++)
+#pragma omp critical(ref_map_pss)
   {
-    double val = ref_map_shapeset.get_fn_value(indices[i], xi1, xi2, 0);
-    x += coeffs[i][0] * val;
-    y += coeffs[i][1] * val;
-
-    double dx =  ref_map_shapeset.get_dx_value(indices[i], xi1, xi2, 0);
-    double dy =  ref_map_shapeset.get_dy_value(indices[i], xi1, xi2, 0);
-    tmp[0][0] += coeffs[i][0] * dx;
-    tmp[0][1] += coeffs[i][0] * dy;
-    tmp[1][0] += coeffs[i][1] * dx;
-    tmp[1][1] += coeffs[i][1] * dy;
+    ref_map_shapeset.set_mode(element->get_mode());
+    for (int i = 0; i < nc; i++)
+    {
+      double val = ref_map_shapeset.get_fn_value(indices[i], xi1, xi2, 0);
+      x += coeffs[i][0] * val;
+      y += coeffs[i][1] * val;
+
+      double dx =  ref_map_shapeset.get_dx_value(indices[i], xi1, xi2, 0);
+      double dy =  ref_map_shapeset.get_dy_value(indices[i], xi1, xi2, 0);
+      tmp[0][0] += coeffs[i][0] * dx;
+      tmp[0][1] += coeffs[i][0] * dy;
+      tmp[1][0] += coeffs[i][1] * dx;
+      tmp[1][1] += coeffs[i][1] * dy;
+    }
   }
 
   // inverse matrix
@@ -502,18 +533,15 @@ void RefMap::free()
   Node** pp = (Node**) JudyLFirst(nodes, &idx, NULL);
   while (pp != NULL)
   {
-    free_node(*pp);
+    if (is_hashed_trf_key(idx))
+    {
+      for (TrfSlot* slot = (TrfSlot*) *pp; slot != NULL; slot = slot->next)
+        free_node((Node*) slot->value);
+      free_trf_slots((TrfSlot*) *pp);
+    }
+    else
+      free_node(*pp);
     pp = (Node**) JudyLNext(nodes, &idx, NULL);
   }
   JudyLFreeArray(&nodes, NULL);
-
-  if (overflow != NULL) { free_node(overflow); overflow = NULL; }
-}
-
-
-RefMap::Node** RefMap::handle_overflow()
-{
-  if (overflow != NULL) free_node(overflow);
-  overflow = NULL;
-  return &overflow;
 }
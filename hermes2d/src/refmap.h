@@ -184,17 +184,10 @@ protected:
 
   void* nodes;
   Node* cur_node;
-  Node* overflow;
 
   void update_cur_node()
   {
-    Node** pp = NULL;
-    if (sub_idx > H2D_MAX_IDX)
-      pp = handle_overflow();
-    else {
-      pp = (Node**) JudyLIns(&nodes, (Word_t)sub_idx, NULL);
-      //debug_assert((sub_idx >> (sizeof(Word_t) * 8)) == 0, "E index is larger than JudyLins can contain (RefMap::update_cur_node)");
-    }
+    Node** pp = (Node**) get_trf_slot(&nodes, sub_idx);
     if (*pp == NULL) init_node(pp);
     cur_node = *pp;
   }
@@ -215,7 +208,6 @@ protected:
 
   void init_node(Node** pp);
   void free_node(Node* node);
-  Node** handle_overflow();
 
   Quad1DStd quad_1d;
 
@@ -127,36 +127,42 @@ double* Shapeset::calculate_constrained_edge_combination(int order, int part, in
 double* Shapeset::get_constrained_edge_combination(int order, int part, int ori, int& nitems)
 {
   int index = 2*((max_order + 1 - ebias)*part + (order - ebias)) + ori;
+  double* comb;
 
-  // allocate/reallocate the array if necessary
-  if (comb_table == NULL)
+  // the table is shared by all threads of the parallel assembly
+#pragma omp critical(shapeset_comb_table)
   {
-    table_size = 1024;
-    while (table_size <= index) table_size *= 2;
-    comb_table = (double**) malloc(table_size * sizeof(double*));
-    memset(comb_table, 0, table_size * sizeof(double*));
-  }
-  else if (index >= table_size)
-  {
-    // adjust table_size to accommodate the required depth
-    int old_size = table_size;
-    while (index >= table_size) table_size *= 2;
-
-    // reallocate the table
-    verbose("Shapeset::get_constrained_edge_combination(): realloc to table_size=%d", table_size);
-    comb_table = (double**) realloc(comb_table, table_size * sizeof(double*));
-    memset(comb_table + old_size, 0,(table_size - old_size) * sizeof(double*));
-  }
-
-  // do we have the required linear combination yet?
-  if (comb_table[index] == NULL)
-  {
-    // no, calculate it
-    comb_table[index] = calculate_constrained_edge_combination(order, part, ori);
+    // allocate/reallocate the array if necessary
+    if (comb_table == NULL)
+    {
+      table_size = 1024;
+      while (table_size <= index) table_size *= 2;
+      comb_table = (double**) malloc(table_size * sizeof(double*));
+      memset(comb_table, 0, table_size * sizeof(double*));
+    }
+    else if (index >= table_size)
+    {
+      // adjust table_size to accommodate the required depth
+      int old_size = table_size;
+      while (index >= table_size) table_size *= 2;
+
+      // reallocate the table
+      verbose("Shapeset::get_constrained_edge_combination(): realloc to table_size=%d", table_size);
+      comb_table = (double**) realloc(comb_table, table_size * sizeof(double*));
+      memset(comb_table + old_size, 0,(table_size - old_size) * sizeof(double*));
+    }
+
+    // do we have the required linear combination yet?
+    if (comb_table[index] == NULL)
+    {
+      // no, calculate it
+      comb_table[index] = calculate_constrained_edge_combination(order, part, ori);
+    }
+    comb = comb_table[index];
   }
 
   nitems = order + 1 - ebias;
-  return comb_table[index];
+  return comb;
 }
 
 
@@ -73,6 +73,7 @@ class HERMES_API Shapeset
 {
 public:
 
+  Shapeset() { tensor_index = NULL; tensor_fn_1d[0] = tensor_fn_1d[1] = NULL; num_tensor_fns_1d = 0; }
   ~Shapeset() { free_constrained_edge_combinations(); }
 
   /// Selects H2D_MODE_TRIANGLE or H2D_MODE_QUAD.
@@ -174,6 +175,10 @@ public:
       return get_constrained_value(n, index, x, y, component);
   }
 
+  /// Returns true if the values (n = 0) or the derivative n (see get_value()) of the shape
+  /// functions are defined in the current mode.
+  bool has_expansion(int n) const { return shape_table[n] != NULL && shape_table[n][mode] != NULL; }
+
   inline double get_fn_value (int index, double x, double y, int component) { return get_value(0, index, x, y, component); }
   inline double get_dx_value (int index, double x, double y, int component) { return get_value(1, index, x, y, component); }
   inline double get_dy_value (int index, double x, double y, int component) { return get_value(2, index, x, y, component); }
@@ -182,6 +187,28 @@ public:
   inline double get_dxy_value(int index, double x, double y, int component) { return get_value(5, index, x, y, component); }
 
 
+  /// Tensor-product shapesets (H1 on quads): returns true if the shape function 'index' is
+  /// sign * f_a(x) * f_b(y) with the 1D functions f_a, f_b (see get_tensor_value_1d()).
+  /// False for the constrained functions and in the modes without the tensor structure.
+  bool get_tensor_index(int index, int& a, int& b, double& sign) const
+  {
+    if (index < 0 || tensor_index == NULL || tensor_index[mode] == NULL) return false;
+    H2D_CHECK_INDEX;
+    int* t = tensor_index[mode] + 3*index;
+    a = t[0]; b = t[1]; sign = t[2];
+    return true;
+  }
+
+  /// Returns the number of the 1D functions of a tensor-product shapeset.
+  int get_num_tensor_fns_1d() const { return num_tensor_fns_1d; }
+
+  /// Value (n = 0) or derivative (n = 1) of the 1D function 'a' of a tensor-product shapeset.
+  double get_tensor_value_1d(int n, int a, double x) const
+  {
+    assert(n == 0 || n == 1); assert(a >= 0 && a < num_tensor_fns_1d);
+    return tensor_fn_1d[n][a](x);
+  }
+
   /// Returns the coordinates of the reference domain vertices.
   double2* get_ref_vertex(int vertex)
   {
@@ -190,6 +217,7 @@ public:
 
   /// Shape-function function type. Internal.
   typedef double (*shape_fn_t)(double, double);
+  typedef double (*shape_fn_1d_t)(double);
 
   /// Returns shapeset identifier. Internal.
   virtual int get_id() const = 0;
@@ -208,6 +236,10 @@ protected:
   int**  bubble_count;
   int**  index_to_order;
 
+  int**  tensor_index;         ///< (a, b, sign) for every index, per mode, NULL if not a tensor product
+  shape_fn_1d_t* tensor_fn_1d[2];
+  int num_tensor_fns_1d;
+
   double2 ref_vert[2][4];
   int max_order;
   int max_index[2];
@@ -4221,6 +4221,12 @@ static int* jacobi_index_to_order[2] =
   simple_quad_index_to_order
 };
 
+static int* jacobi_tensor_index[2] =
+{
+  NULL,
+  simple_quad_tensor_index
+};
+
 
 H1ShapesetJacobi::H1ShapesetJacobi()
 {
@@ -4237,6 +4243,11 @@ H1ShapesetJacobi::H1ShapesetJacobi()
   bubble_count = jacobi_bubble_count;
   index_to_order = jacobi_index_to_order;
 
+  tensor_index = jacobi_tensor_index;
+  tensor_fn_1d[0] = simple_quad_tensor_fn_1d;
+  tensor_fn_1d[1] = simple_quad_tensor_der_1d;
+  num_tensor_fns_1d = 11;
+
   ref_vert[0][0][0] = -1.0;
   ref_vert[0][0][1] = -1.0;
   ref_vert[0][1][0] =  1.0;
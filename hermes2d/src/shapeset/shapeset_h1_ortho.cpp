@@ -16999,6 +16999,12 @@ static int* ortho2_index_to_order[2] =
   simple_quad_index_to_order
 };
 
+static int* ortho2_tensor_index[2] =
+{
+  NULL,
+  simple_quad_tensor_index
+};
+
 
 
 H1ShapesetOrtho::H1ShapesetOrtho()
@@ -17016,6 +17022,11 @@ H1ShapesetOrtho::H1ShapesetOrtho()
   bubble_count = ortho2_bubble_count;
   index_to_order = ortho2_index_to_order;
 
+  tensor_index = ortho2_tensor_index;
+  tensor_fn_1d[0] = simple_quad_tensor_fn_1d;
+  tensor_fn_1d[1] = simple_quad_tensor_der_1d;
+  num_tensor_fns_1d = 11;
+
   ref_vert[0][0][0] = -1.0;
   ref_vert[0][0][1] = -1.0;
   ref_vert[0][1][0] =  1.0;
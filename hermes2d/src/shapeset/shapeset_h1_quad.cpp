@@ -4473,3 +4473,75 @@ int simple_quad_index_to_order[] = {
   XX(9,1),   XX(9,1),   oo(9,2),   oo(9,3),   oo(9,4),   oo(9,5),   oo(9,6),   oo(9,7),   oo(9,8),   oo(9,9),   oo(9,10),
   oo(10,1),  oo(10,1),  oo(10,2),  oo(10,3),  oo(10,4),  oo(10,5),  oo(10,6),  oo(10,7),  oo(10,8),  oo(10,9),  oo(10,10),
 };
+
+
+// The functions are products of the 1D Lobatto functions, simple_quad_l<a>_l<b> = sign * l<a>(x) * l<b>(y):
+// (a, b, sign) for every index, used by the sum-factorized assembling (see Shapeset::get_tensor_index()).
+
+int simple_quad_tensor_index[] =
+{
+   0, 0, 1,  0, 1, 1,  0, 2, 1,  0, 3,-1,  0, 3, 1,
+   0, 4, 1,  0, 5,-1,  0, 5, 1,  0, 6, 1,  0, 7,-1,
+   0, 7, 1,  0, 8, 1,  0, 9,-1,  0, 9, 1,  0,10, 1,
+   1, 0, 1,  1, 1, 1,  1, 2, 1,  1, 3, 1,  1, 3,-1,
+   1, 4, 1,  1, 5, 1,  1, 5,-1,  1, 6, 1,  1, 7, 1,
+   1, 7,-1,  1, 8, 1,  1, 9, 1,  1, 9,-1,  1,10, 1,
+   2, 0, 1,  2, 1, 1,  2, 2, 1,  2, 3, 1,  2, 4, 1,
+   2, 5, 1,  2, 6, 1,  2, 7, 1,  2, 8, 1,  2, 9, 1,
+   2,10, 1,  3, 0, 1,  3, 0,-1,  3, 1,-1,  3, 1, 1,
+   3, 2, 1,  3, 3, 1,  3, 4, 1,  3, 5, 1,  3, 6, 1,
+   3, 7, 1,  3, 8, 1,  3, 9, 1,  3,10, 1,  4, 0, 1,
+   4, 1, 1,  4, 2, 1,  4, 3, 1,  4, 4, 1,  4, 5, 1,
+   4, 6, 1,  4, 7, 1,  4, 8, 1,  4, 9, 1,  4,10, 1,
+   5, 0, 1,  5, 0,-1,  5, 1,-1,  5, 1, 1,  5, 2, 1,
+   5, 3, 1,  5, 4, 1,  5, 5, 1,  5, 6, 1,  5, 7, 1,
+   5, 8, 1,  5, 9, 1,  5,10, 1,  6, 0, 1,  6, 1, 1,
+   6, 2, 1,  6, 3, 1,  6, 4, 1,  6, 5, 1,  6, 6, 1,
+   6, 7, 1,  6, 8, 1,  6, 9, 1,  6,10, 1,  7, 0, 1,
+   7, 0,-1,  7, 1,-1,  7, 1, 1,  7, 2, 1,  7, 3, 1,
+   7, 4, 1,  7, 5, 1,  7, 6, 1,  7, 7, 1,  7, 8, 1,
+   7, 9, 1,  7,10, 1,  8, 0, 1,  8, 1, 1,  8, 2, 1,
+   8, 3, 1,  8, 4, 1,  8, 5, 1,  8, 6, 1,  8, 7, 1,
+   8, 8, 1,  8, 9, 1,  8,10, 1,  9, 0, 1,  9, 0,-1,
+   9, 1,-1,  9, 1, 1,  9, 2, 1,  9, 3, 1,  9, 4, 1,
+   9, 5, 1,  9, 6, 1,  9, 7, 1,  9, 8, 1,  9, 9, 1,
+   9,10, 1, 10, 0, 1, 10, 1, 1, 10, 2, 1, 10, 3, 1,
+  10, 4, 1, 10, 5, 1, 10, 6, 1, 10, 7, 1, 10, 8, 1,
+  10, 9, 1, 10,10, 1,
+};
+
+static double simple_quad_lob0(double x) { return l0(x); }
+static double simple_quad_lob1(double x) { return l1(x); }
+static double simple_quad_lob2(double x) { return l2(x); }
+static double simple_quad_lob3(double x) { return l3(x); }
+static double simple_quad_lob4(double x) { return l4(x); }
+static double simple_quad_lob5(double x) { return l5(x); }
+static double simple_quad_lob6(double x) { return l6(x); }
+static double simple_quad_lob7(double x) { return l7(x); }
+static double simple_quad_lob8(double x) { return l8(x); }
+static double simple_quad_lob9(double x) { return l9(x); }
+static double simple_quad_lob10(double x) { return l10(x); }
+
+static double simple_quad_dlob0(double x) { return dl0(x); }
+static double simple_quad_dlob1(double x) { return dl1(x); }
+static double simple_quad_dlob2(double x) { return dl2(x); }
+static double simple_quad_dlob3(double x) { return dl3(x); }
+static double simple_quad_dlob4(double x) { return dl4(x); }
+static double simple_quad_dlob5(double x) { return dl5(x); }
+static double simple_quad_dlob6(double x) { return dl6(x); }
+static double simple_quad_dlob7(double x) { return dl7(x); }
+static double simple_quad_dlob8(double x) { return dl8(x); }
+static double simple_quad_dlob9(double x) { return dl9(x); }
+static double simple_quad_dlob10(double x) { return dl10(x); }
+
+Shapeset::shape_fn_1d_t simple_quad_tensor_fn_1d[] =
+{
+  simple_quad_lob0, simple_quad_lob1, simple_quad_lob2, simple_quad_lob3, simple_quad_lob4, simple_quad_lob5,
+  simple_quad_lob6, simple_quad_lob7, simple_quad_lob8, simple_quad_lob9, simple_quad_lob10
+};
+
+Shapeset::shape_fn_1d_t simple_quad_tensor_der_1d[] =
+{
+  simple_quad_dlob0, simple_quad_dlob1, simple_quad_dlob2, simple_quad_dlob3, simple_quad_dlob4, simple_quad_dlob5,
+  simple_quad_dlob6, simple_quad_dlob7, simple_quad_dlob8, simple_quad_dlob9, simple_quad_dlob10
+};
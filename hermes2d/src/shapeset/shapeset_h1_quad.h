@@ -30,5 +30,9 @@ extern int* simple_quad_bubble_indices[];
 extern int simple_quad_bubble_count[];
 extern int simple_quad_index_to_order[];
 
+extern int simple_quad_tensor_index[];
+extern Shapeset::shape_fn_1d_t simple_quad_tensor_fn_1d[];
+extern Shapeset::shape_fn_1d_t simple_quad_tensor_der_1d[];
+
 
 #endif
@@ -18,6 +18,7 @@
 #include "../../hermes_common/matrix.h"
 #include "precalc.h"
 #include "refmap.h"
+#include "element_index.h"
 #include "auto_local_array.h"
 
 //// MeshFunction //////////////////////////////////////////////////////////////////////////////////
@@ -28,6 +29,7 @@ MeshFunction::MeshFunction()
   refmap = new RefMap;
   mesh = NULL;
   element = NULL;
+  cache_class = "MeshFunction";
 }
 
 MeshFunction::MeshFunction(Mesh *mesh) :
@@ -37,6 +39,7 @@ MeshFunction::MeshFunction(Mesh *mesh) :
 	this->refmap = new RefMap;
 	// FIXME - this was in H3D: MEM_CHECK(this->refmap);
 	this->element = NULL;		// this comes with Transformable
+	this->cache_class = "MeshFunction";
 }
 
 MeshFunction::~MeshFunction()
@@ -162,7 +165,9 @@ void Solution::init()
   own_mesh = false;
   num_components = 0;
   e_last = NULL;
+  pt_index = NULL;
   exact_mult = 1.0;
+  cache_class = "Solution";
 
   mono_coefs = NULL;
   elem_coefs[0] = elem_coefs[1] = NULL;
@@ -309,6 +314,7 @@ void Solution::free()
   }
 
   e_last = NULL;
+  if (pt_index != NULL) { delete pt_index;  pt_index = NULL; }
 
   free_tables();
 }
@@ -472,6 +478,7 @@ void Solution::set_coeff_vector(Space* space, PrecalcShapeset* pss, scalar* coef
   Quad2D* quad = &g_quad_2d_cheb;
   pss->set_quad_2d(quad);
   scalar* mono = mono_coefs;
+  AsmList al;
   for_all_active_elements(e, mesh)
   {
     mode = e->get_mode();
@@ -479,7 +486,6 @@ void Solution::set_coeff_vector(Space* space, PrecalcShapeset* pss, scalar* coef
     o = elem_orders[e->id];
     int np = quad->get_num_points(o);
 
-    AsmList al;
     space->get_element_assembly_list(e, &al);
     pss->set_active_element(e);
 
@@ -1327,6 +1333,25 @@ scalar Solution::get_pt_value(double x, double y, int item)
           "the solution on its right-hand side.");
   }
 
+  Element* e = find_pt_element(x, y, xi1, xi2);
+  if (e != NULL)
+    return get_ref_value_transformed(e, xi1, xi2, a, b);
+
+  warn("Point (%g, %g) does not lie in any element.", x, y);
+  return NAN;
+}
+
+
+Element* Solution::find_pt_element(double x, double y, double& xi1, double& xi2)
+{
+  // the index (and the last visited element) belong to one state of the mesh
+  if (pt_index != NULL && !pt_index->is_current(mesh))
+  {
+    delete pt_index;
+    pt_index = NULL;
+    e_last = NULL;
+  }
+
   // try the last visited element and its neighbours
   if (e_last != NULL)
   {
@@ -1341,27 +1366,75 @@ scalar Solution::get_pt_value(double x, double y, int item)
         refmap->set_active_element(elem[i]);
         refmap->untransform(elem[i], x, y, xi1, xi2);
         if (is_in_ref_domain(elem[i], xi1, xi2))
-        {
-          e_last = elem[i];
-          return get_ref_value_transformed(elem[i], xi1, xi2, a, b);
-        }
+          return e_last = elem[i];
       }
   }
 
-  // go through all elements
-  Element *e;
-  for_all_active_elements(e, mesh)
+  // try the elements whose bounding boxes contain the point
+  if (pt_index == NULL)
+    pt_index = new ElementIndex(mesh, refmap);
+
+  pt_candidates.clear();
+  pt_index->find(x, y, pt_candidates);
+  for (unsigned int i = 0; i < pt_candidates.size(); i++)
   {
+    Element* e = pt_candidates[i];
     refmap->set_active_element(e);
     refmap->untransform(e, x, y, xi1, xi2);
     if (is_in_ref_domain(e, xi1, xi2))
-    {
-      e_last = e;
-      return get_ref_value_transformed(e, xi1, xi2, a, b);
-    }
+      return e_last = e;
   }
 
-  warn("Point (%g, %g) does not lie in any element.", x, y);
-  return NAN;
+  return NULL;
+}
+
+
+// interleaves the bits of two 16-bit numbers (Z-order curve)
+static inline unsigned morton_key(unsigned x, unsigned y)
+{
+  unsigned key = 0;
+  for (int i = 0; i < 16; i++)
+    key |= ((x >> i) & 1) << (2*i) | ((y >> i) & 1) << (2*i + 1);
+  return key;
+}
+
+void Solution::get_pt_values(int n, double* x, double* y, int item, scalar* val)
+{
+  _F_
+  if (type != HERMES_SLN || n <= 1)
+  {
+    for (int i = 0; i < n; i++)
+      val[i] = get_pt_value(x[i], y[i], item);
+    return;
+  }
+
+  // sort the points along a Z-order curve over the bounding box of the mesh, so that
+  // the search mostly succeeds already with the last visited element or its neighbours
+  if (pt_index == NULL || !pt_index->is_current(mesh))
+  {
+    delete pt_index;
+    pt_index = new ElementIndex(mesh, refmap);
+    e_last = NULL;
+  }
+  double x0, y0, x1, y1;
+  pt_index->get_bbox(x0, y0, x1, y1);
+  double sx = (x1 > x0) ? 65535.0 / (x1 - x0) : 0.0;
+  double sy = (y1 > y0) ? 65535.0 / (y1 - y0) : 0.0;
+
+  std::vector<std::pair<unsigned, int> > order(n);
+  for (int i = 0; i < n; i++)
+  {
+    double qx = std::max(0.0, std::min(65535.0, (x[i] - x0) * sx));
+    double qy = std::max(0.0, std::min(65535.0, (y[i] - y0) * sy));
+    order[i].first = morton_key((unsigned) qx, (unsigned) qy);
+    order[i].second = i;
+  }
+  std::sort(order.begin(), order.end());
+
+  for (int k = 0; k < n; k++)
+  {
+    int i = order[k].second;
+    val[i] = get_pt_value(x[i], y[i], item);
+  }
 }
 
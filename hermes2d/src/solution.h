@@ -22,6 +22,7 @@
 #include "../../hermes_common/matrix.h"
 
 class PrecalcShapeset;
+class ElementIndex;
 
 
 /// \brief Represents a function defined on a mesh.
@@ -150,10 +151,17 @@ public:
   /// Returns solution value or derivatives at the physical domain point (x, y).
   /// 'item' controls the returned value: H2D_FN_VAL_0, H2D_FN_VAL_1, H2D_FN_DX_0, H2D_FN_DX_1, H2D_FN_DY_0,....
   /// NOTE: This function should be used for postprocessing only, it is not effective
-  /// enough for calculations. Since it searches for an element sequentinally, it is extremelly
-  /// slow. Prefer Solution::get_ref_value if possible.
+  /// enough for calculations. The element containing the point is searched for in a bounding
+  /// box hierarchy of the mesh elements, built on the first call and after every change of the
+  /// mesh. Prefer Solution::get_ref_value if possible.
   virtual scalar get_pt_value(double x, double y, int item = H2D_FN_VAL_0);
 
+  /// Returns the solution values or derivatives at the physical domain points (x[i], y[i]),
+  /// i = 0, ..., n-1, in 'val'. 'item' has the same meaning as in get_pt_value(). The points
+  /// are visited along a space-filling curve, so that consecutive points mostly lie in the
+  /// same or in neighbouring elements.
+  void get_pt_values(int n, double* x, double* y, int item, scalar* val);
+
   /// Returns the number of degrees of freedom of the solution.
   /// Returns -1 for exact or constant solutions.
   int get_num_dofs() const { return num_dofs; };
@@ -219,6 +227,12 @@ protected:
   void free_tables();
 
   Element* e_last; ///< last visited element when getting solution values at specific points
+  ElementIndex* pt_index; ///< element search structure for get_pt_value()
+  std::vector<Element*> pt_candidates;
+
+  /// Finds the active element containing the point (x, y) and the reference coordinates
+  /// of the point. Returns NULL if the point does not lie in the mesh.
+  Element* find_pt_element(double x, double y, double& xi1, double& xi2);
 
 };
 
@@ -17,6 +17,9 @@
 #include "space.h"
 #include "../../../hermes_common/matrix.h"
 #include "../auto_local_array.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 Space::Space(Mesh* mesh, Shapeset* shapeset, BCType (*bc_type_callback)(int), 
         scalar (*bc_value_callback_by_coord)(int, double, double), Ord2 p_init)
@@ -34,6 +37,7 @@ Space::Space(Mesh* mesh, Shapeset* shapeset, BCType (*bc_type_callback)(int),
   this->seq = 0;
   this->was_assigned = false;
   this->ndof = 0;
+  this->al_cache_valid = false;
 
   this->set_bc_types_init(bc_type_callback);
   this->set_essential_bc_values(bc_value_callback_by_coord);
@@ -51,6 +55,7 @@ void Space::free()
 {
   _F_
   free_extra_data();
+  invalidate_al_cache();
   if (nsize) { ::free(ndata); ndata=NULL; }
   if (esize) { ::free(edata); edata=NULL; }
 }
@@ -375,6 +380,7 @@ int Space::assign_dofs(int first_dof, int stride)
 
   mesh_seq = mesh->get_seq();
   was_assigned = true;
+  invalidate_al_cache();
   this->ndof = (next_dof - first_dof) / stride;
 
   return this->ndof;
@@ -424,13 +430,69 @@ void AsmList::enlarge()
 void Space::get_element_assembly_list(Element* e, AsmList* al)
 {
   _F_
-  // some checks
-  if (e->id >= esize || edata[e->id].order < 0)
-    error("Uninitialized element order (id = #%d).", e->id);
   if (!is_up_to_date())
     error("The space is out of date. You need to update it with assign_dofs()"
           " any time the mesh changes.");
 
+  // the parallel assembly builds the lists before its threads start (see update_assembly_lists());
+  // in a parallel region the check is synchronized in case they have not been built
+#ifdef _OPENMP
+  if (omp_in_parallel())
+  {
+#pragma omp critical(space_al_cache)
+    update_assembly_lists();
+  }
+  else
+#endif
+  update_assembly_lists();
+
+  if (e->id < (int) al_cache_cnt.size() && al_cache_cnt[e->id] >= 0)
+  {
+    int n = al_cache_cnt[e->id], k = al_cache_start[e->id];
+    if (n > 0) al->copy(n, &al_cache_idx[k], &al_cache_dof[k], &al_cache_coef[k]);
+    else al->clear();
+    shapeset->set_mode(e->get_mode());
+  }
+  else
+    get_element_assembly_list_internal(e, al);
+}
+
+
+void Space::update_al_cache()
+{
+  _F_
+  int n = mesh->get_max_element_id();
+  al_cache_start.assign(n, 0);
+  al_cache_cnt.assign(n, -1);
+  al_cache_idx.clear();
+  al_cache_dof.clear();
+  al_cache_coef.clear();
+
+  AsmList al;
+  Element* e;
+  for_all_active_elements(e, mesh)
+  {
+    get_element_assembly_list_internal(e, &al);
+    al_cache_start[e->id] = al_cache_idx.size();
+    al_cache_cnt[e->id] = al.cnt;
+    al_cache_idx.insert(al_cache_idx.end(), al.idx, al.idx + al.cnt);
+    al_cache_dof.insert(al_cache_dof.end(), al.dof, al.dof + al.cnt);
+    al_cache_coef.insert(al_cache_coef.end(), al.coef, al.coef + al.cnt);
+  }
+
+  al_cache_seq = seq;
+  al_cache_mesh_seq = mesh->get_seq();
+  al_cache_valid = true;
+}
+
+
+void Space::get_element_assembly_list_internal(Element* e, AsmList* al)
+{
+  _F_
+  // some checks
+  if (e->id >= esize || edata[e->id].order < 0)
+    error("Uninitialized element order (id = #%d).", e->id);
+
   // add vertex, edge and bubble functions to the assembly list
   al->clear();
   shapeset->set_mode(e->get_mode());
@@ -604,6 +666,8 @@ void Space::update_edge_bc(Element* e, SurfPos* surf_pos)
 void Space::update_essential_bc_values()
 {
   _F_
+  // the coefficients of the Dirichlet lift in the assembly lists change
+  invalidate_al_cache();
   Element* e;
   for_all_base_elements(e, mesh)
   {
@@ -677,6 +741,32 @@ int Space::assign_dofs(Tuple<Space*> spaces)
   return ndof;
 }
 
+int Space::assign_dofs_interleaved(Tuple<Space*> spaces)
+{
+  _F_
+  int n = spaces.size();
+  // the spaces have to have the same number of DOFs
+  int ndof = spaces[0]->assign_dofs();
+  for (int i = 1; i < n; i++)
+    if (spaces[i]->assign_dofs() != ndof) {
+      warning("Spaces with different numbers of DOFs cannot be interleaved.");
+      return assign_dofs(spaces);
+    }
+
+  for (int i = 0; i < n; i++)
+    spaces[i]->assign_dofs(i, n);
+  return n * ndof;
+}
+
+bool Space::is_interleaved(Tuple<Space*> spaces)
+{
+  _F_
+  int n = spaces.size();
+  for (int i = 0; i < n; i++)
+    if (spaces[i]->first_dof != i || spaces[i]->stride != n) return false;
+  return true;
+}
+
 // updating time-dependent essential BC
 HERMES_API void update_essential_bc_values(Tuple<Space*> spaces) {
   int n = spaces.size();
@@ -180,9 +180,15 @@ public:
   /// Number of degrees of freedom (dimension of the space)
   int ndof;
 
-  /// Obtains an assembly list for the given element.
+  /// Obtains an assembly list for the given element. The lists of all active elements
+  /// are built at once and kept until the space (see get_seq()) or the mesh changes, or
+  /// the DOFs or the essential BC values are updated.
   virtual void get_element_assembly_list(Element* e, AsmList* al);
 
+  /// Builds the cached assembly lists of all elements if they are out of date. Called by
+  /// the parallel assembly before its threads start, so that the threads only read them.
+  void update_assembly_lists() { if (!is_al_cache_current()) update_al_cache(); }
+
   /// Obtains an edge assembly list (contains shape functions that are nonzero on the specified edge).
   void get_boundary_assembly_list(Element* e, int surf_num, AsmList* al);
 
@@ -196,6 +202,15 @@ public:
   /// \brief Assings the degrees of freedom to all Spaces in the Tuple.
   static int assign_dofs(Tuple<Space*> spaces);
 
+  /// \brief Assings the degrees of freedom to all Spaces in the Tuple interleaved: the k-th
+  /// DOF of the i-th space gets the number k * n + i (n is the number of spaces), so the
+  /// matrix of a system consists of dense (n x n) blocks (see BSRMatrix). All spaces must
+  /// have the same number of DOFs, otherwise they are assigned one after another.
+  static int assign_dofs_interleaved(Tuple<Space*> spaces);
+
+  /// \brief Returns true if the DOFs of the spaces are numbered by assign_dofs_interleaved().
+  static bool is_interleaved(Tuple<Space*> spaces);
+
   
 protected:
   static const int H2D_UNASSIGNED_DOF = -2; ///< DOF which was not assigned yet.
@@ -274,6 +289,8 @@ protected: //debugging support
   virtual void assign_edge_dofs() = 0;
   virtual void assign_bubble_dofs() = 0;
 
+  /// Builds the assembly list of the element (vertex, edge and bubble functions).
+  virtual void get_element_assembly_list_internal(Element* e, AsmList* al);
   virtual void get_vertex_assembly_list(Element* e, int iv, AsmList* al) = 0;
   virtual void get_boundary_assembly_list_internal(Element* e, int surf_num, AsmList* al) = 0;
   virtual void get_bubble_assembly_list(Element* e, AsmList* al);
@@ -301,6 +318,21 @@ protected: //debugging support
 
   void propagate_zero_orders(Element* e);
 
+  /// Cache of the element assembly lists (see get_element_assembly_list()), indexed by the
+  /// element id: the list of the element 'id' has al_cache_cnt[id] triples stored from
+  /// al_cache_start[id] in the arrays al_cache_idx, al_cache_dof and al_cache_coef
+  /// (al_cache_cnt[id] is -1 for inactive elements).
+  std::vector<int> al_cache_start, al_cache_cnt;
+  std::vector<int> al_cache_idx, al_cache_dof;
+  std::vector<scalar> al_cache_coef;
+  bool al_cache_valid;
+  int al_cache_seq;
+  unsigned al_cache_mesh_seq;
+  bool is_al_cache_current() const
+  { return al_cache_valid && al_cache_seq == seq && al_cache_mesh_seq == mesh->get_seq(); }
+  void update_al_cache();
+  void invalidate_al_cache() { al_cache_valid = false; }
+
 public:
 
   BCType (*bc_type_callback)(int);
@@ -100,16 +100,11 @@ void L2Space::assign_bubble_dofs()
 
 //// assembly lists ////////////////////////////////////////////////////////////////////////////////
 
-void L2Space::get_element_assembly_list(Element* e, AsmList* al)
+void L2Space::get_element_assembly_list_internal(Element* e, AsmList* al)
 {
-  int i;
-
   // some checks
   if (e->id >= esize || edata[e->id].order < 0)
     error("Uninitialized element order (id = #%d).", e->id);
-  if (!is_up_to_date())
-    error("The space is out of date. You need to update it with assign_dofs()"
-          " any time the mesh changes.");
 
   // add bubble functions to the assembly list
   al->clear();
@@ -44,10 +44,10 @@ public:
 
   virtual int get_type() const { return 3; }
 
-  virtual void get_element_assembly_list(Element* e, AsmList* al);
-
 protected:
 
+  virtual void get_element_assembly_list_internal(Element* e, AsmList* al);
+
   struct L2Data
   {
     int vdof[4];
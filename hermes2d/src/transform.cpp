@@ -45,6 +45,40 @@ Trf quad_trf[H2D_TRF_NUM] =
 };
 
 
+void** Transformable::get_hashed_trf_slot(void** judy, uint64_t sub_idx)
+{
+  // mix the bits of the index, the transformations of a deep element differ in the low bits only
+  uint64_t h = sub_idx;
+  h ^= h >> 33;  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+
+  void** pp = (void**) JudyLIns(judy, (Word_t) (H2D_MAX_IDX + 1 + (h & H2D_MAX_IDX)), NULL);
+  TrfSlot* slot;
+  for (slot = (TrfSlot*) *pp; slot != NULL; slot = slot->next)
+    if (slot->sub_idx == sub_idx)
+      return &slot->value;
+
+  slot = new TrfSlot;
+  slot->sub_idx = sub_idx;
+  slot->value = NULL;
+  slot->next = (TrfSlot*) *pp;
+  *pp = slot;
+  return &slot->value;
+}
+
+
+void Transformable::free_trf_slots(TrfSlot* slot)
+{
+  while (slot != NULL)
+  {
+    TrfSlot* next = slot->next;
+    delete slot;
+    slot = next;
+  }
+}
+
+
 void Transformable::set_transform(uint64_t idx)
 {
   int son[25];
@@ -33,6 +33,14 @@ struct Trf
 extern HERMES_API Trf tri_trf[H2D_TRF_NUM];  ///< A table of triangle sub-subdomain transforms. Only first ::H2D_TRF_TRI_NUM transformations are valid, the rest are identity transformation.
 extern HERMES_API Trf quad_trf[H2D_TRF_NUM]; ///< A table of quad sub-subdomain transforms. Only first ::H2D_TRF_QUAD_NUM transformations are valid, the rest are identity transformation.
 
+/// An entry of the list stored under a hashed key (see Transformable::get_trf_slot()).
+struct TrfSlot
+{
+  uint64_t sub_idx; ///< the transformation index
+  void* value;      ///< the value stored for it
+  TrfSlot* next;    ///< the next entry with the same hashed key
+};
+
 
 /// Transformable is a base class for all classes that perform some kind of precalculation of
 /// function values on elements. These classes (PrecalcShapeset, Solution, RefMap) inherit
@@ -127,7 +135,30 @@ protected:
   Trf* ctm;  ///< current sub-element transformation matrix
   uint64_t sub_idx; ///< sub-element transformation index. Data type is equal to the type used by Judy.
   //static const unsigned H2D_MAX_IDX = 0x49249248; ///< largest sub_idx for top <= 10
-  static const uint64_t H2D_MAX_IDX = 0x4000; ///< largest sub_idx for top <= 10. Data type is equal to the type used by Judy.
+  static const uint64_t H2D_MAX_IDX = 0x7fffffff; ///< largest sub_idx used as a key if Word_t has 32 bits (top <= 10)
+
+  /// Returns the address of the value stored for the transformation 'sub_idx' in the Judy
+  /// array 'judy', a NULL value is inserted if there is none. All indices are used as the keys
+  /// directly if Word_t has 64 bits. Otherwise the indices above H2D_MAX_IDX are hashed to the
+  /// keys above H2D_MAX_IDX, whose values are lists of TrfSlot (see is_hashed_trf_key()). The
+  /// returned address is valid until the next insertion into 'judy'.
+  static void** get_trf_slot(void** judy, uint64_t sub_idx)
+  {
+    if (sizeof(Word_t) >= sizeof(uint64_t) || sub_idx <= H2D_MAX_IDX)
+      return (void**) JudyLIns(judy, (Word_t) sub_idx, NULL);
+    return get_hashed_trf_slot(judy, sub_idx);
+  }
+
+  /// Returns true if 'key' of a Judy array of get_trf_slot() holds a list of TrfSlot.
+  static bool is_hashed_trf_key(Word_t key)
+  {
+    return sizeof(Word_t) < sizeof(uint64_t) && key > H2D_MAX_IDX;
+  }
+
+  /// Frees a list of TrfSlot (the values have to be freed by the caller).
+  static void free_trf_slots(TrfSlot* slot);
+
+  static void** get_hashed_trf_slot(void** judy, uint64_t sub_idx);
 
   Trf stack[21]; ///< transformation matrix stack
   int top;       ///< stack top
@@ -77,6 +77,36 @@ void WeakForm::add_matrix_form(matrix_form_val_t fn, matrix_form_ord_t ord, SymF
   seq++;
 }
 
+void WeakForm::add_matrix_form(int i, int j, matrix_form_elem_t fn, 
+                               matrix_form_ord_t ord, SymFlag sym, int area, Tuple<MeshFunction*>ext)
+{
+  _F_
+  add_matrix_form(i, j, (matrix_form_val_t) NULL, ord, sym, area, ext);
+  mfvol.back().elem_fn = fn;
+}
+
+// single equation case
+void WeakForm::add_matrix_form(matrix_form_elem_t fn, matrix_form_ord_t ord, SymFlag sym, int area, Tuple<MeshFunction*>ext)
+{
+  _F_
+  add_matrix_form(0, 0, fn, ord, sym, area, ext);
+}
+
+void WeakForm::add_matrix_form_const(int i, int j, matrix_form_val_t fn, 
+                                     matrix_form_ord_t ord, SymFlag sym, int area)
+{
+  _F_
+  add_matrix_form(i, j, fn, ord, sym, area);
+  mfvol.back().const_coef = true;
+}
+
+// single equation case
+void WeakForm::add_matrix_form_const(matrix_form_val_t fn, matrix_form_ord_t ord, SymFlag sym, int area)
+{
+  _F_
+  add_matrix_form_const(0, 0, fn, ord, sym, area);
+}
+
 void WeakForm::add_matrix_form_surf(int i, int j, matrix_form_val_t fn, matrix_form_ord_t ord, int area, Tuple<MeshFunction*>ext)
 {
   _F_
@@ -113,15 +143,18 @@ void WeakForm::add_matrix_form_surf(matrix_form_val_t fn, matrix_form_ord_t ord,
   seq++;
 }
 
-void WeakForm::add_vector_form(int i, vector_form_val_t fn, vector_form_ord_t ord, int area, Tuple<MeshFunction*>ext)
+void WeakForm::add_vector_form(int i, vector_form_val_t fn, vector_form_ord_t ord, int area, Tuple<MeshFunction*>ext, int rhs)
 {
   _F_
   if (i < 0 || i >= neq)
     error("Invalid equation number.");
   if (area != HERMES_ANY && area < 0 && -area > areas.size())
     error("Invalid area number.");
+  if (rhs < 0)
+    error("Invalid right-hand side number.");
 
   VectorFormVol form = { i, area, fn, ord };
+  form.rhs = rhs;
   if (ext.size() != 0) {
     int nx = ext.size(); 
     for (int i = 0; i < nx; i++) form.ext.push_back(ext[i]);
@@ -131,7 +164,7 @@ void WeakForm::add_vector_form(int i, vector_form_val_t fn, vector_form_ord_t or
 }
 
 // single equation case
-void WeakForm::add_vector_form(vector_form_val_t fn, vector_form_ord_t ord, int area, Tuple<MeshFunction*>ext)
+void WeakForm::add_vector_form(vector_form_val_t fn, vector_form_ord_t ord, int area, Tuple<MeshFunction*>ext, int rhs)
 {
   _F_
   int i = 0;
@@ -139,8 +172,11 @@ void WeakForm::add_vector_form(vector_form_val_t fn, vector_form_ord_t ord, int
   // FIXME: the code below should be replaced with a call to the full function. 
   if (area != HERMES_ANY && area < 0 && -area > areas.size())
     error("Invalid area number.");
+  if (rhs < 0)
+    error("Invalid right-hand side number.");
 
   VectorFormVol form = { i, area, fn, ord };
+  form.rhs = rhs;
   if (ext.size() != 0) {
     int nx = ext.size(); 
     for (int i = 0; i < nx; i++) form.ext.push_back(ext[i]);
@@ -149,15 +185,18 @@ void WeakForm::add_vector_form(vector_form_val_t fn, vector_form_ord_t ord, int
   seq++;
 }
 
-void WeakForm::add_vector_form_surf(int i, vector_form_val_t fn, vector_form_ord_t ord, int area, Tuple<MeshFunction*>ext)
+void WeakForm::add_vector_form_surf(int i, vector_form_val_t fn, vector_form_ord_t ord, int area, Tuple<MeshFunction*>ext, int rhs)
 {
   _F_
   if (i < 0 || i >= neq)
     error("Invalid equation number.");
   if (area != HERMES_ANY && area < 0 && -area > areas.size())
     error("Invalid area number.");
+  if (rhs < 0)
+    error("Invalid right-hand side number.");
 
   VectorFormSurf form = { i, area, fn, ord };
+  form.rhs = rhs;
   if (ext.size() != 0) {
     int nx = ext.size(); 
     for (int i = 0; i < nx; i++) form.ext.push_back(ext[i]);
@@ -167,7 +206,7 @@ void WeakForm::add_vector_form_surf(int i, vector_form_val_t fn, vector_form_ord
 }
 
 // single equation case
-void WeakForm::add_vector_form_surf(vector_form_val_t fn, vector_form_ord_t ord, int area, Tuple<MeshFunction*>ext)
+void WeakForm::add_vector_form_surf(vector_form_val_t fn, vector_form_ord_t ord, int area, Tuple<MeshFunction*>ext, int rhs)
 {
   _F_
   int i = 0;
@@ -175,8 +214,11 @@ void WeakForm::add_vector_form_surf(vector_form_val_t fn, vector_form_ord_t ord,
   // FIXME: the code below should be replaced with a call to the full function. 
   if (area != HERMES_ANY && area < 0 && -area > areas.size())
     error("Invalid area number.");
+  if (rhs < 0)
+    error("Invalid right-hand side number.");
 
   VectorFormSurf form = { i, area, fn, ord };
+  form.rhs = rhs;
   if (ext.size() != 0) {
     int nx = ext.size(); 
     for (int i = 0; i < nx; i++) form.ext.push_back(ext[i]);
@@ -361,6 +403,15 @@ bool** WeakForm::get_blocks()
   return blocks;
 }
 
+bool WeakForm::is_sym() const
+{
+  _F_
+  if (mfvol.empty() || !mfsurf.empty()) return false;
+  for (unsigned i = 0; i < mfvol.size(); i++)
+    if (mfvol[i].sym != HERMES_SYM) return false;
+  return true;
+}
+
 
 //// areas /////////////////////////////////////////////////////////////////////////////////////////
 
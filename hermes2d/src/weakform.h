@@ -32,6 +32,7 @@ class Shapeset;
 template<typename T> class Func;
 template<typename T> class Geom;
 template<typename T> class ExtData;
+class ShapeTable;
 
 // Bilinear form symmetry flag, see WeakForm::add_matrix_form
 enum SymFlag
@@ -64,23 +65,48 @@ public:
   typedef scalar (*vector_form_val_t)(int n, double *wt, Func<scalar> *u[], Func<double> *vi, Geom<double> *e, ExtData<scalar> *);
   typedef Ord (*vector_form_ord_t)(int n, double *wt, Func<Ord> *u[], Func<Ord> *vi, Geom<Ord> *e, ExtData<Ord> *);
 
+  // element-level volume matrix form: evaluates the form for all the pairs of the basis
+  // functions (u) and the test functions (v) of the element at once, i.e. fills the local
+  // matrix mat[i][j] = a(u_j, v_i), i < v->ns, j < u->ns. The shape functions are passed as
+  // dense (ns x n) tables (see ShapeTable), so that the form can be evaluated by a few
+  // matrix-matrix products (see integrals_h1.h). The order is still determined by the
+  // ordinary 'ord' callback (for the highest orders of the shape functions on the element).
+  typedef void (*matrix_form_elem_t)(int n, double *wt, Func<scalar> *u[], ShapeTable *vu, ShapeTable *vv, Geom<double> *e, ExtData<scalar> *, scalar **mat);
+
   // general case
   void add_matrix_form(int i, int j, matrix_form_val_t fn, matrix_form_ord_t ord, 
 		   SymFlag sym = HERMES_UNSYM, int area = HERMES_ANY, Tuple<MeshFunction*>ext = Tuple<MeshFunction*>());
   void add_matrix_form(matrix_form_val_t fn, matrix_form_ord_t ord, 
 		   SymFlag sym = HERMES_UNSYM, int area = HERMES_ANY, Tuple<MeshFunction*>ext = Tuple<MeshFunction*>()); // single equation case
+  // element-level volume matrix forms (see matrix_form_elem_t)
+  void add_matrix_form(int i, int j, matrix_form_elem_t fn, matrix_form_ord_t ord, 
+		   SymFlag sym = HERMES_UNSYM, int area = HERMES_ANY, Tuple<MeshFunction*>ext = Tuple<MeshFunction*>());
+  void add_matrix_form(matrix_form_elem_t fn, matrix_form_ord_t ord, 
+		   SymFlag sym = HERMES_UNSYM, int area = HERMES_ANY, Tuple<MeshFunction*>ext = Tuple<MeshFunction*>()); // single equation case
+  // constant-coefficient volume matrix forms: the integrand of 'fn' must be a bilinear function
+  // of (u, du/dx, du/dy) and (v, dv/dx, dv/dy) with constant coefficients, i.e. independent of
+  // the coordinates, of the previous solutions and of the external functions (like Laplace or
+  // mass forms). On affine elements DiscreteProblem then assembles them without quadrature,
+  // from precomputed integrals of the products of the shape functions on the reference element,
+  // on the other quads with tensor-product shapesets (H1) by sum factorization.
+  void add_matrix_form_const(int i, int j, matrix_form_val_t fn, matrix_form_ord_t ord, 
+		   SymFlag sym = HERMES_UNSYM, int area = HERMES_ANY);
+  void add_matrix_form_const(matrix_form_val_t fn, matrix_form_ord_t ord, 
+		   SymFlag sym = HERMES_UNSYM, int area = HERMES_ANY); // single equation case
   void add_matrix_form_surf(int i, int j, matrix_form_val_t fn, matrix_form_ord_t ord, 
 			int area = HERMES_ANY, Tuple<MeshFunction*>ext = Tuple<MeshFunction*>());
   void add_matrix_form_surf(matrix_form_val_t fn, matrix_form_ord_t ord, 
 			int area = HERMES_ANY, Tuple<MeshFunction*>ext = Tuple<MeshFunction*>()); // single equation case
+  // 'rhs' is the index of the right-hand side the form contributes to when several
+  // right-hand sides are assembled at once (see DiscreteProblem::assemble())
   void add_vector_form(int i, vector_form_val_t fn, vector_form_ord_t ord, 
-		   int area = HERMES_ANY, Tuple<MeshFunction*>ext = Tuple<MeshFunction*>());
+		   int area = HERMES_ANY, Tuple<MeshFunction*>ext = Tuple<MeshFunction*>(), int rhs = 0);
   void add_vector_form(vector_form_val_t fn, vector_form_ord_t ord, 
-		   int area = HERMES_ANY, Tuple<MeshFunction*>ext = Tuple<MeshFunction*>()); // single equation case
+		   int area = HERMES_ANY, Tuple<MeshFunction*>ext = Tuple<MeshFunction*>(), int rhs = 0); // single equation case
   void add_vector_form_surf(int i, vector_form_val_t fn, vector_form_ord_t ord, 
-			int area = HERMES_ANY, Tuple<MeshFunction*>ext = Tuple<MeshFunction*>());
+			int area = HERMES_ANY, Tuple<MeshFunction*>ext = Tuple<MeshFunction*>(), int rhs = 0);
   void add_vector_form_surf(vector_form_val_t fn, vector_form_ord_t ord, 
-			int area = HERMES_ANY, Tuple<MeshFunction*>ext = Tuple<MeshFunction*>()); // single equation case
+			int area = HERMES_ANY, Tuple<MeshFunction*>ext = Tuple<MeshFunction*>(), int rhs = 0); // single equation case
 
   void set_ext_fns(void* fn, Tuple<MeshFunction*>ext = Tuple<MeshFunction*>());
 
@@ -110,10 +136,12 @@ protected:
     Ord evaluate_ord(int point_cnt, double *weights, Func<Ord> *values_v, Geom<Ord> *geometry, ExtData<Ord> *values_ext_fnc, Element* element, Shapeset* shape_set, int shape_inx); ///< Evaluate order of the user defined function.
 
   // general case
-  struct MatrixFormVol  {  int i, j, sym, area;  matrix_form_val_t fn;  matrix_form_ord_t ord;  std::vector<MeshFunction *> ext; };
+  // ('elem_fn' is set instead of 'fn' for the element-level forms, 'const_coef' for the
+  // constant-coefficient ones)
+  struct MatrixFormVol  {  int i, j, sym, area;  matrix_form_val_t fn;  matrix_form_ord_t ord;  std::vector<MeshFunction *> ext;  matrix_form_elem_t elem_fn;  bool const_coef; };
   struct MatrixFormSurf {  int i, j, area;       matrix_form_val_t fn;  matrix_form_ord_t ord;  std::vector<MeshFunction *> ext; };
-  struct VectorFormVol  {  int i, area;          vector_form_val_t fn;  vector_form_ord_t ord;  std::vector<MeshFunction *> ext; };
-  struct VectorFormSurf {  int i, area;          vector_form_val_t fn;  vector_form_ord_t ord;  std::vector<MeshFunction *> ext; };
+  struct VectorFormVol  {  int i, area;          vector_form_val_t fn;  vector_form_ord_t ord;  std::vector<MeshFunction *> ext;  int rhs; };
+  struct VectorFormSurf {  int i, area;          vector_form_val_t fn;  vector_form_ord_t ord;  std::vector<MeshFunction *> ext;  int rhs; };
 
   // general case
   std::vector<MatrixFormVol>  mfvol;
@@ -146,7 +174,9 @@ protected:
   bool is_in_area(int marker, int area) const
     { return area >= 0 ? area == marker : is_in_area_2(marker, area); }
 
-  bool is_sym() const { return false; /* not impl. yet */ }
+  // true if the matrix of the weak form is symmetric: all volume matrix forms are
+  // HERMES_SYM and there are no surface matrix forms
+  bool is_sym() const;
 
 //  friend class DiscreteProblem;
 //  friend class RefDiscreteProblem;
@@ -0,0 +1,144 @@
+#define HERMES_REPORT_WARN
+#define HERMES_REPORT_INFO
+#define HERMES_REPORT_VERBOSE
+#define HERMES_REPORT_FILE "application.log"
+#include "hermes2d.h"
+
+//  This test makes sure that the memory budget of the precalculated tables of the functions
+//  (Function::set_cache_budget(), RealFunction::set_default_cache_budget()) does not change the
+//  results. A matrix and a right-hand side are assembled and the H1 norm of the difference of two
+//  solutions on different meshes is computed without a budget, with a small and with a tiny one
+//  (the evicted tables are precalculated again): the results have to be the same bit for bit,
+//  the tables of the shape functions of the assembly have to be evicted only with a budget, and
+//  the smaller the budget, the less memory they may take at the peak.
+
+const int P_INIT = 4;                             // Polynomial degree of the elements.
+const int INIT_REF_NUM = 3;                       // Number of initial uniform mesh refinements.
+
+// Boundary condition types.
+BCType bc_types(int marker)
+{
+  return BC_ESSENTIAL;
+}
+
+// Essential (Dirichlet) boundary condition values.
+scalar essential_bc_values(int marker, double x, double y)
+{
+  return 1.0 + x * y;
+}
+
+// Weak forms.
+template<typename Real, typename Scalar>
+Scalar bilinear_form(int n, double *wt, Func<Real> *u_ext[], Func<Real> *u, Func<Real> *v, Geom<Real> *e, ExtData<Scalar> *ext)
+{
+  Scalar result = 0;
+  for (int i = 0; i < n; i++)
+    result += wt[i] * (u->dx[i] * v->dx[i] + u->dy[i] * v->dy[i] + e->x[i] * u->val[i] * v->val[i]);
+  return result;
+}
+
+template<typename Real, typename Scalar>
+Scalar linear_form(int n, double *wt, Func<Real> *u_ext[], Func<Real> *v, Geom<Real> *e, ExtData<Scalar> *ext)
+{
+  Scalar result = 0;
+  for (int i = 0; i < n; i++)
+    result += wt[i] * (e->x[i] + 2) * v->val[i];
+  return result;
+}
+
+// The results computed with one budget.
+struct Results
+{
+  int nnz, ndof;
+  scalar *ax, *rhs;
+  double norm;
+  FnCacheStats stats;      // the shape functions of the assembly
+};
+
+// Assembles the system and computes the norm with the functions created with the budget 'bytes'.
+void compute(Mesh* mesh, Mesh* mesh_2, int bytes, Results& r)
+{
+  RealFunction::set_default_cache_budget(bytes);
+
+  H1Space space(mesh, bc_types, essential_bc_values, P_INIT);
+  WeakForm wf;
+  wf.add_matrix_form(callback(bilinear_form), HERMES_SYM);
+  wf.add_vector_form(callback(linear_form));
+  DiscreteProblem dp(&wf, &space, true);
+  UMFPackMatrix matrix;
+  UMFPackVector rhs;
+  dp.assemble(&matrix, &rhs);
+  dp.get_pss(0)->get_cache_stats(r.stats);
+
+  int *ap, *ai;
+  r.nnz = matrix.get_full_csc(ap, ai, r.ax);
+  r.ndof = matrix.get_size();
+  r.rhs = new scalar[r.ndof];
+  rhs.extract(r.rhs);
+  delete [] ap;
+  delete [] ai;
+
+  // Two solutions on different meshes (transformed tables of both).
+  H1Space space_2(mesh_2, bc_types, essential_bc_values, P_INIT - 1);
+  int ndof_2 = Space::get_num_dofs(&space_2);
+  scalar* coeffs = new scalar[r.ndof];
+  scalar* coeffs_2 = new scalar[ndof_2];
+  for (int i = 0; i < r.ndof; i++) coeffs[i] = sin(i);
+  for (int i = 0; i < ndof_2; i++) coeffs_2[i] = cos(0.3 * i);
+  Solution sln, sln_2;
+  Solution::vector_to_solution(coeffs, &space, &sln);
+  Solution::vector_to_solution(coeffs_2, &space_2, &sln_2);
+  r.norm = calc_abs_error(&sln, &sln_2, HERMES_H1_NORM);
+  delete [] coeffs;
+  delete [] coeffs_2;
+
+  info("budget %d: norm %.15g, shape function tables: %lu hits, %lu misses, %lu evictions, peak memory %ld",
+       bytes, r.norm, r.stats.hits, r.stats.misses, r.stats.evictions, r.stats.peak_mem);
+}
+
+// True if the results are the same bit for bit.
+bool same(Results& a, Results& b)
+{
+  return a.nnz == b.nnz && a.ndof == b.ndof && !memcmp(a.ax, b.ax, a.nnz * sizeof(scalar))
+         && !memcmp(a.rhs, b.rhs, a.ndof * sizeof(scalar)) && a.norm == b.norm;
+}
+
+int main(int argc, char* argv[])
+{
+  // Load the mesh, the second mesh is refined once more.
+  Mesh mesh, mesh_2;
+  H2DReader mloader;
+  mloader.load("domain.mesh", &mesh);
+  for (int i = 0; i < INIT_REF_NUM; i++) mesh.refine_all_elements();
+  mesh_2.copy(&mesh);
+  mesh_2.refine_all_elements();
+
+  // Without a budget, with a small one and with a tiny one.
+  Results unlimited, small, tiny;
+  compute(&mesh, &mesh_2, 0, unlimited);
+  compute(&mesh, &mesh_2, 64 * 1024, small);
+  compute(&mesh, &mesh_2, 1, tiny);
+  RealFunction::set_default_cache_budget(0);
+
+  bool success = same(unlimited, small) && same(unlimited, tiny);
+  if (unlimited.stats.evictions != 0 || small.stats.evictions == 0 || tiny.stats.evictions == 0) success = false;
+  if (small.stats.peak_mem >= unlimited.stats.peak_mem || tiny.stats.peak_mem > small.stats.peak_mem) success = false;
+
+  Results* results[3] = { &unlimited, &small, &tiny };
+  for (int i = 0; i < 3; i++)
+  {
+    delete [] results[i]->ax;
+    delete [] results[i]->rhs;
+  }
+
+#define ERROR_SUCCESS                               0
+#define ERROR_FAILURE                               -1
+  if (success) {
+    printf("Success!\n");
+    return ERROR_SUCCESS;
+  }
+  else {
+    printf("Failure!\n");
+    return ERROR_FAILURE;
+  }
+}
@@ -0,0 +1,156 @@
+#define HERMES_REPORT_WARN
+#define HERMES_REPORT_INFO
+#define HERMES_REPORT_VERBOSE
+#define HERMES_REPORT_FILE "application.log"
+#include "hermes2d.h"
+
+//  This test makes sure that the constant-coefficient volume matrix forms (added by
+//  WeakForm::add_matrix_form_const(), assembled from the precomputed reference integrals on
+//  the affine elements) give the same matrix as the same forms added as the ordinary ones.
+//  The system of two equations lives on two different meshes with hanging nodes (the
+//  constrained shape functions are integrated by quadrature), and the curved triangles
+//  along one of the edges of the domain have to fall back to the quadrature as well.
+
+const int INIT_REF_NUM = 2;                       // Number of initial uniform mesh refinements.
+const double TOLERANCE = 1e-12;                   // Tolerance for the relative difference of the matrices.
+
+// Boundary condition types.
+BCType bc_types(int marker)
+{
+  return marker == 1 ? BC_ESSENTIAL : BC_NATURAL;
+}
+
+// Essential (Dirichlet) boundary condition values.
+scalar essential_bc_values(int marker, double x, double y)
+{
+  return 1.0 + x * y;
+}
+
+// Weak forms, the matrix forms have constant coefficients.
+template<typename Real, typename Scalar>
+Scalar bilinear_form_0_0(int n, double *wt, Func<Real> *u_ext[], Func<Real> *u, Func<Real> *v, Geom<Real> *e, ExtData<Scalar> *ext)
+{
+  return int_grad_u_grad_v<Real, Scalar>(n, wt, u, v) + int_u_v<Real, Scalar>(n, wt, u, v);
+}
+
+template<typename Real, typename Scalar>
+Scalar bilinear_form_0_1(int n, double *wt, Func<Real> *u_ext[], Func<Real> *u, Func<Real> *v, Geom<Real> *e, ExtData<Scalar> *ext)
+{
+  Scalar result = 0;
+  for (int i = 0; i < n; i++)
+    result += wt[i] * (u->dy[i] * v->dx[i] + 0.5 * u->dx[i] * v->dy[i]);
+  return result;
+}
+
+template<typename Real, typename Scalar>
+Scalar bilinear_form_1_0(int n, double *wt, Func<Real> *u_ext[], Func<Real> *u, Func<Real> *v, Geom<Real> *e, ExtData<Scalar> *ext)
+{
+  Scalar result = 0;
+  for (int i = 0; i < n; i++)
+    result += wt[i] * (u->val[i] * v->dx[i] - 2.0 * u->dy[i] * v->val[i]);
+  return result;
+}
+
+template<typename Real, typename Scalar>
+Scalar bilinear_form_1_1(int n, double *wt, Func<Real> *u_ext[], Func<Real> *u, Func<Real> *v, Geom<Real> *e, ExtData<Scalar> *ext)
+{
+  Scalar result = 0;
+  for (int i = 0; i < n; i++)
+    result += wt[i] * (u->dx[i] * v->dx[i] + u->dy[i] * v->dy[i] + (3.0 * u->dx[i] + u->dy[i]) * v->val[i]);
+  return result;
+}
+
+template<typename Real, typename Scalar>
+Scalar linear_form(int n, double *wt, Func<Real> *u_ext[], Func<Real> *v, Geom<Real> *e, ExtData<Scalar> *ext)
+{
+  Scalar result = 0;
+  for (int i = 0; i < n; i++)
+    result += wt[i] * (e->x[i] + 2) * v->val[i];
+  return result;
+}
+
+int main(int argc, char* argv[])
+{
+  // Load the mesh, the second mesh is refined differently.
+  Mesh mesh, mesh_2;
+  H2DReader mloader;
+  mloader.load("domain.mesh", &mesh);
+  for (int i = 0; i < INIT_REF_NUM; i++) mesh.refine_all_elements();
+  mesh_2.copy(&mesh);
+  mesh_2.refine_all_elements();
+  mesh_2.refine_towards_vertex(2, 2);
+
+  // Create the spaces.
+  H1Space space_0(&mesh, bc_types, essential_bc_values, 4);
+  H1Space space_1(&mesh_2, bc_types, essential_bc_values, 3);
+  Tuple<Space*> spaces(&space_0, &space_1);
+
+  // The weak formulation with the ordinary forms.
+  WeakForm wf(2);
+  wf.add_matrix_form(0, 0, callback(bilinear_form_0_0), HERMES_SYM);
+  wf.add_matrix_form(0, 1, callback(bilinear_form_0_1), HERMES_SYM);
+  wf.add_matrix_form(1, 0, callback(bilinear_form_1_0), HERMES_UNSYM);
+  wf.add_matrix_form(1, 1, callback(bilinear_form_1_1), HERMES_UNSYM);
+  wf.add_vector_form(0, callback(linear_form));
+
+  // The weak formulation with the constant-coefficient forms.
+  WeakForm wf_const(2);
+  wf_const.add_matrix_form_const(0, 0, callback(bilinear_form_0_0), HERMES_SYM);
+  wf_const.add_matrix_form_const(0, 1, callback(bilinear_form_0_1), HERMES_SYM);
+  wf_const.add_matrix_form_const(1, 0, callback(bilinear_form_1_0), HERMES_UNSYM);
+  wf_const.add_matrix_form_const(1, 1, callback(bilinear_form_1_1), HERMES_UNSYM);
+  wf_const.add_vector_form(0, callback(linear_form));
+
+  // Assemble both, the second one twice (the reference integrals are computed once).
+  DiscreteProblem dp(&wf, spaces, true);
+  DiscreteProblem dp_const(&wf_const, spaces, true);
+  UMFPackMatrix mat, mat_const;
+  UMFPackVector rhs, rhs_const;
+  dp.assemble(&mat, &rhs);
+  bool success = true;
+  for (int k = 0; k < 2; k++)
+  {
+    dp_const.assemble(&mat_const, &rhs_const);
+
+    // Compare the matrices (the sparse structures have to be the same) and the right-hand
+    // sides (the Dirichlet lift includes the matrix forms).
+    int *ap, *ai, *ap_const, *ai_const;
+    scalar *ax, *ax_const;
+    int nnz = mat.get_full_csc(ap, ai, ax);
+    int nnz_const = mat_const.get_full_csc(ap_const, ai_const, ax_const);
+    int ndof = mat.get_size();
+    bool same = nnz == nnz_const && mat_const.get_size() == ndof
+                && !memcmp(ap, ap_const, (ndof + 1) * sizeof(int)) && !memcmp(ai, ai_const, nnz * sizeof(int));
+    double diff = 0, norm = 0, diff_rhs = 0, norm_rhs = 0;
+    if (same)
+    {
+      for (int i = 0; i < nnz; i++)
+      {
+        diff = std::max(diff, std::abs(ax[i] - ax_const[i]));
+        norm = std::max(norm, std::abs(ax[i]));
+      }
+      for (int i = 0; i < ndof; i++)
+      {
+        diff_rhs = std::max(diff_rhs, std::abs(rhs.get(i) - rhs_const.get(i)));
+        norm_rhs = std::max(norm_rhs, std::abs(rhs.get(i)));
+      }
+      info("ndof = %d, nnz = %d, relative difference: matrix %g, rhs %g", ndof, nnz, diff / norm, diff_rhs / norm_rhs);
+      if (diff > TOLERANCE * norm || diff_rhs > TOLERANCE * norm_rhs) same = false;
+    }
+    if (!same) success = false;
+
+    delete [] ap; delete [] ai; delete [] ax;
+    delete [] ap_const; delete [] ai_const; delete [] ax_const;
+  }
+
+#define ERROR_SUCCESS                               0
+#define ERROR_FAILURE                               -1
+  if (success) {
+    printf("Success!\n");
+    return ERROR_SUCCESS;
+  }
+  else {
+    printf("Failure!\n");
+    return ERROR_FAILURE;
+  }
+}
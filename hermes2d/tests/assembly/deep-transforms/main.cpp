@@ -0,0 +1,191 @@
+#define HERMES_REPORT_WARN
+#define HERMES_REPORT_INFO
+#define HERMES_REPORT_VERBOSE
+#define HERMES_REPORT_FILE "application.log"
+#include "hermes2d.h"
+
+//  This test makes sure that the tables of the deep sub-element transforms (the sub_idx of
+//  more than ten levels, see Transformable::get_trf_slot()) are cached correctly. One mesh is
+//  refined 16 levels towards a vertex shared by a quadrilateral and two triangles, the other
+//  one is refined uniformly. The functions on the coarse mesh are evaluated on the deep
+//  sub-elements of the fine one when
+//   - the H1 norm of a solution on the coarse mesh is integrated over the union mesh (it has
+//     to be the norm on the coarse mesh),
+//   - the coupling block of a system on the two meshes is assembled (its product with the
+//     coefficients of two solutions has to be their L2 product, obtained from the norms).
+//  Both are repeated with the cached tables and have to give the same results. The lists
+//  behind the hashed keys used where Word_t has 32 bits (Transformable::get_hashed_trf_slot())
+//  are tested directly, with the indices of sub-elements up to the full stack depth.
+
+const int P_INIT = 3;                             // Polynomial degree of the elements.
+const int REF_DEPTH = 16;                         // Depth of the refinement towards the vertex.
+const int REF_VERTEX = 1;                         // The vertex.
+const int NUM_PATHS = 2000;                       // Number of random sub-element paths.
+const double TOLERANCE = 1e-12;                   // Tolerance for the relative differences.
+
+// Boundary condition types.
+BCType bc_types(int marker)
+{
+  return BC_NATURAL;
+}
+
+// Weak forms.
+template<typename Real, typename Scalar>
+Scalar bilinear_form(int n, double *wt, Func<Real> *u_ext[], Func<Real> *u, Func<Real> *v, Geom<Real> *e, ExtData<Scalar> *ext)
+{
+  return int_u_v<Real, Scalar>(n, wt, u, v);
+}
+
+// Exposes the hashed transformation slots.
+class TrfSlots : public Transformable
+{
+public:
+  static void** get(void** judy, uint64_t sub_idx) { return get_hashed_trf_slot(judy, sub_idx); }
+  static bool is_hashed_key(Word_t key) { return key > H2D_MAX_IDX; }
+  static void free(TrfSlot* slot) { free_trf_slots(slot); }
+};
+
+// Stores a value for every one of the sub-element indices in the hashed slots, checks that the
+// values stay at their addresses and are found again. The indices of the paths towards a
+// vertex (all the sons on every level) and of random paths are used.
+bool test_hashed_slots()
+{
+  std::set<uint64_t> indices;
+  uint64_t corner = 0;
+  for (int level = 0; level < 20; level++)
+  {
+    for (int son = 0; son < 8; son++)
+      indices.insert((corner << 3) + son + 1);
+    corner = (corner << 3) + 1 + 1;
+  }
+  for (int i = 0; i < NUM_PATHS; i++)
+  {
+    uint64_t idx = 0;
+    int depth = 1 + rand() % 20;
+    for (int level = 0; level < depth; level++)
+      idx = (idx << 3) + rand() % 8 + 1;
+    indices.insert(idx);
+  }
+
+  void* judy = NULL;
+  std::map<uint64_t, void**> slots;
+  bool ok = true;
+  for (std::set<uint64_t>::iterator it = indices.begin(); it != indices.end(); ++it)
+  {
+    void** slot = TrfSlots::get(&judy, *it);
+    if (*slot != NULL) ok = false;
+    *slot = (void*) (size_t) *it;
+    slots[*it] = slot;
+  }
+
+  // the values are found at the same addresses after all the insertions
+  std::set<void**> addresses;
+  for (std::map<uint64_t, void**>::iterator it = slots.begin(); it != slots.end(); ++it)
+  {
+    void** slot = TrfSlots::get(&judy, it->first);
+    if (slot != it->second || *slot != (void*) (size_t) it->first) ok = false;
+    addresses.insert(slot);
+  }
+
+  // all the keys hold lists, which hold every index once
+  unsigned num_keys = 0, num_slots = 0;
+  Word_t key = 0;
+  void** pp = (void**) JudyLFirst(judy, &key, NULL);
+  while (pp != NULL)
+  {
+    if (!TrfSlots::is_hashed_key(key)) ok = false;
+    num_keys++;
+    for (TrfSlot* slot = (TrfSlot*) *pp; slot != NULL; slot = slot->next) num_slots++;
+    TrfSlots::free((TrfSlot*) *pp);
+    pp = (void**) JudyLNext(judy, &key, NULL);
+  }
+  JudyLFreeArray(&judy, NULL);
+
+  info("hashed slots: %d indices, %d keys, %d slots", (int) indices.size(), num_keys, num_slots);
+  return ok && addresses.size() == indices.size() && num_slots == indices.size();
+}
+
+int main(int argc, char* argv[])
+{
+  // Load the mesh, the second one is refined towards the vertex.
+  Mesh mesh, mesh_deep;
+  H2DReader mloader;
+  mloader.load("domain.mesh", &mesh);
+  mesh_deep.copy(&mesh);
+  mesh.refine_all_elements();
+  mesh_deep.refine_towards_vertex(REF_VERTEX, REF_DEPTH);
+
+  // Create the spaces.
+  H1Space space(&mesh, bc_types, NULL, P_INIT);
+  H1Space space_deep(&mesh_deep, bc_types, NULL, P_INIT);
+  Tuple<Space*> spaces(&space, &space_deep);
+
+  // The coupling block of the two meshes (the diagonal blocks are there to make the system
+  // well-defined).
+  WeakForm wf(2);
+  wf.add_matrix_form(0, 0, callback(bilinear_form), HERMES_SYM);
+  wf.add_matrix_form(0, 1, callback(bilinear_form), HERMES_UNSYM);
+  wf.add_matrix_form(1, 1, callback(bilinear_form), HERMES_SYM);
+  DiscreteProblem dp(&wf, spaces, true);
+  int ndof = dp.get_num_dofs();
+  int ndof_0 = Space::get_num_dofs(&space);
+  info("ndof = %d, elements = %d and %d", ndof, mesh.get_num_active_elements(), mesh_deep.get_num_active_elements());
+
+  // Solutions with random coefficients.
+  scalar* coeffs = new scalar[ndof];
+  for (int i = 0; i < ndof; i++) coeffs[i] = rand() / (double) RAND_MAX - 0.5;
+  Solution sln, sln_deep, zero;
+  Solution::vector_to_solution(coeffs, &space, &sln);
+  Solution::vector_to_solution(coeffs, &space_deep, &sln_deep);
+  zero.set_zero(&mesh_deep);
+
+  double norm = calc_norm(&sln, HERMES_H1_NORM);
+  double norm_l2 = calc_norm(&sln, HERMES_L2_NORM);
+  double norm_deep_l2 = calc_norm(&sln_deep, HERMES_L2_NORM);
+
+  bool success = true;
+  double err_first = 0, product_first = 0;
+  scalar* y = new scalar[ndof];
+  scalar* my = new scalar[ndof];
+  UMFPackMatrix mat;
+  for (int k = 0; k < 2; k++)
+  {
+    // The norm of the coarse solution on the union mesh.
+    double err = calc_abs_error(&sln, &zero, HERMES_H1_NORM);
+
+    // The L2 product of the solutions from the coupling block and from the norms.
+    dp.assemble(&mat);
+    memset(y, 0, ndof * sizeof(scalar));
+    memcpy(y + ndof_0, coeffs + ndof_0, (ndof - ndof_0) * sizeof(scalar));
+    mat.multiply(y, my);
+    scalar product = 0;
+    for (int i = 0; i < ndof_0; i++) product += coeffs[i] * my[i];
+    double diff_l2 = calc_abs_error(&sln, &sln_deep, HERMES_L2_NORM);
+    double product_norms = (sqr(norm_l2) + sqr(norm_deep_l2) - sqr(diff_l2)) / 2;
+
+    info("pass %d: relative difference: norm %g, product %g", k, fabs(err - norm) / norm,
+         std::abs(product - product_norms) / fabs(product_norms));
+    if (fabs(err - norm) > TOLERANCE * norm) success = false;
+    if (std::abs(product - product_norms) > TOLERANCE * sqr(norm_l2 + norm_deep_l2)) success = false;
+
+    // the cached tables give the same results
+    if (k == 0) { err_first = err; product_first = std::abs(product); }
+    else if (err != err_first || std::abs(product) != product_first) success = false;
+  }
+  delete [] y;
+  delete [] my;
+  delete [] coeffs;
+
+  if (!test_hashed_slots()) success = false;
+
+#define ERROR_SUCCESS                               0
+#define ERROR_FAILURE                               -1
+  if (success) {
+    printf("Success!\n");
+    return ERROR_SUCCESS;
+  }
+  else {
+    printf("Failure!\n");
+    return ERROR_FAILURE;
+  }
+}
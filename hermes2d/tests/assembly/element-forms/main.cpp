@@ -0,0 +1,192 @@
+#define HERMES_REPORT_WARN
+#define HERMES_REPORT_INFO
+#define HERMES_REPORT_VERBOSE
+#define HERMES_REPORT_FILE "application.log"
+#include "hermes2d.h"
+
+//  This test makes sure that the element-level volume matrix forms (WeakForm::matrix_form_elem_t,
+//  filling the whole local matrix at once) give the same matrix as the ordinary forms evaluated
+//  for every pair of the shape functions. The system of two equations lives on two different
+//  meshes of triangles and quadrilaterals with hanging nodes, and has symmetric and unsymmetric
+//  blocks (one of them with a coefficient depending on the coordinates). The meshes are affine:
+//  the element-level forms are integrated with the order for the highest orders of the shape
+//  functions on the element, so on curved elements the results differ by the quadrature error.
+
+const int INIT_REF_NUM = 2;                       // Number of initial uniform mesh refinements.
+const double TOLERANCE = 1e-12;                   // Tolerance for the relative difference of the matrices.
+
+// Boundary condition types.
+BCType bc_types(int marker)
+{
+  return marker == 1 ? BC_ESSENTIAL : BC_NATURAL;
+}
+
+// Essential (Dirichlet) boundary condition values.
+scalar essential_bc_values(int marker, double x, double y)
+{
+  return 1.0 + x * y;
+}
+
+// Weak forms evaluated for every pair of the shape functions.
+template<typename Real, typename Scalar>
+Scalar bilinear_form_0_0(int n, double *wt, Func<Real> *u_ext[], Func<Real> *u, Func<Real> *v, Geom<Real> *e, ExtData<Scalar> *ext)
+{
+  return int_grad_u_grad_v<Real, Scalar>(n, wt, u, v) + int_u_v<Real, Scalar>(n, wt, u, v);
+}
+
+template<typename Real, typename Scalar>
+Scalar bilinear_form_0_1(int n, double *wt, Func<Real> *u_ext[], Func<Real> *u, Func<Real> *v, Geom<Real> *e, ExtData<Scalar> *ext)
+{
+  Scalar result = 0;
+  for (int i = 0; i < n; i++)
+    result += wt[i] * (u->dy[i] * v->dx[i] + 0.5 * u->dx[i] * v->dy[i]);
+  return result;
+}
+
+template<typename Real, typename Scalar>
+Scalar bilinear_form_1_0(int n, double *wt, Func<Real> *u_ext[], Func<Real> *u, Func<Real> *v, Geom<Real> *e, ExtData<Scalar> *ext)
+{
+  Scalar result = 0;
+  for (int i = 0; i < n; i++)
+    result += wt[i] * (u->val[i] * v->dx[i] + e->y[i] * u->dx[i] * v->val[i]);
+  return result;
+}
+
+template<typename Real, typename Scalar>
+Scalar bilinear_form_1_1(int n, double *wt, Func<Real> *u_ext[], Func<Real> *u, Func<Real> *v, Geom<Real> *e, ExtData<Scalar> *ext)
+{
+  return int_grad_u_grad_v<Real, Scalar>(n, wt, u, v);
+}
+
+template<typename Real, typename Scalar>
+Scalar linear_form(int n, double *wt, Func<Real> *u_ext[], Func<Real> *v, Geom<Real> *e, ExtData<Scalar> *ext)
+{
+  Scalar result = 0;
+  for (int i = 0; i < n; i++)
+    result += wt[i] * (e->x[i] + 2) * v->val[i];
+  return result;
+}
+
+// The same weak forms at the element level.
+void bilinear_form_elem_0_0(int n, double *wt, Func<scalar> *u_ext[], ShapeTable *u, ShapeTable *v, Geom<double> *e, ExtData<scalar> *ext, scalar **mat)
+{
+  int_grad_u_grad_v_elem(n, wt, u, v, mat);
+  for (int i = 0; i < v->ns; i++)
+    for (int j = 0; j < u->ns; j++)
+    {
+      double result = 0;
+      for (int k = 0; k < n; k++)
+        result += wt[k] * (u->val[j*n + k] * v->val[i*n + k]);
+      mat[i][j] += result;
+    }
+}
+
+void bilinear_form_elem_0_1(int n, double *wt, Func<scalar> *u_ext[], ShapeTable *u, ShapeTable *v, Geom<double> *e, ExtData<scalar> *ext, scalar **mat)
+{
+  for (int i = 0; i < v->ns; i++)
+    for (int j = 0; j < u->ns; j++)
+    {
+      double result = 0;
+      for (int k = 0; k < n; k++)
+        result += wt[k] * (u->dy[j*n + k] * v->dx[i*n + k] + 0.5 * u->dx[j*n + k] * v->dy[i*n + k]);
+      mat[i][j] = result;
+    }
+}
+
+void bilinear_form_elem_1_0(int n, double *wt, Func<scalar> *u_ext[], ShapeTable *u, ShapeTable *v, Geom<double> *e, ExtData<scalar> *ext, scalar **mat)
+{
+  for (int i = 0; i < v->ns; i++)
+    for (int j = 0; j < u->ns; j++)
+    {
+      double result = 0;
+      for (int k = 0; k < n; k++)
+        result += wt[k] * (u->val[j*n + k] * v->dx[i*n + k] + e->y[k] * u->dx[j*n + k] * v->val[i*n + k]);
+      mat[i][j] = result;
+    }
+}
+
+void bilinear_form_elem_1_1(int n, double *wt, Func<scalar> *u_ext[], ShapeTable *u, ShapeTable *v, Geom<double> *e, ExtData<scalar> *ext, scalar **mat)
+{
+  int_grad_u_grad_v_elem(n, wt, u, v, mat);
+}
+
+int main(int argc, char* argv[])
+{
+  // Load the mesh, the second mesh is refined differently.
+  Mesh mesh, mesh_2;
+  H2DReader mloader;
+  mloader.load("domain.mesh", &mesh);
+  for (int i = 0; i < INIT_REF_NUM; i++) mesh.refine_all_elements();
+  mesh_2.copy(&mesh);
+  mesh_2.refine_all_elements();
+  mesh_2.refine_towards_vertex(2, 2);
+
+  // Create the spaces.
+  H1Space space_0(&mesh, bc_types, essential_bc_values, 4);
+  H1Space space_1(&mesh_2, bc_types, essential_bc_values, 3);
+  Tuple<Space*> spaces(&space_0, &space_1);
+
+  // The weak formulation with the ordinary forms.
+  WeakForm wf(2);
+  wf.add_matrix_form(0, 0, callback(bilinear_form_0_0), HERMES_SYM);
+  wf.add_matrix_form(0, 1, callback(bilinear_form_0_1), HERMES_SYM);
+  wf.add_matrix_form(1, 0, callback(bilinear_form_1_0), HERMES_UNSYM);
+  wf.add_matrix_form(1, 1, callback(bilinear_form_1_1), HERMES_SYM);
+  wf.add_vector_form(0, callback(linear_form));
+
+  // The weak formulation with the element-level forms.
+  WeakForm wf_elem(2);
+  wf_elem.add_matrix_form(0, 0, bilinear_form_elem_0_0, bilinear_form_0_0<Ord, Ord>, HERMES_SYM);
+  wf_elem.add_matrix_form(0, 1, bilinear_form_elem_0_1, bilinear_form_0_1<Ord, Ord>, HERMES_SYM);
+  wf_elem.add_matrix_form(1, 0, bilinear_form_elem_1_0, bilinear_form_1_0<Ord, Ord>, HERMES_UNSYM);
+  wf_elem.add_matrix_form(1, 1, bilinear_form_elem_1_1, bilinear_form_1_1<Ord, Ord>, HERMES_SYM);
+  wf_elem.add_vector_form(0, callback(linear_form));
+
+  // Assemble both.
+  DiscreteProblem dp(&wf, spaces, true);
+  DiscreteProblem dp_elem(&wf_elem, spaces, true);
+  UMFPackMatrix mat, mat_elem;
+  UMFPackVector rhs, rhs_elem;
+  dp.assemble(&mat, &rhs);
+  dp_elem.assemble(&mat_elem, &rhs_elem);
+
+  // Compare the matrices (the sparse structures have to be the same) and the right-hand sides
+  // (the Dirichlet lift includes the matrix forms).
+  int *ap, *ai, *ap_elem, *ai_elem;
+  scalar *ax, *ax_elem;
+  int nnz = mat.get_full_csc(ap, ai, ax);
+  int nnz_elem = mat_elem.get_full_csc(ap_elem, ai_elem, ax_elem);
+  int ndof = mat.get_size();
+  bool success = nnz == nnz_elem && mat_elem.get_size() == ndof
+                 && !memcmp(ap, ap_elem, (ndof + 1) * sizeof(int)) && !memcmp(ai, ai_elem, nnz * sizeof(int));
+  double diff = 0, norm = 0, diff_rhs = 0, norm_rhs = 0;
+  if (success)
+  {
+    for (int i = 0; i < nnz; i++)
+    {
+      diff = std::max(diff, std::abs(ax[i] - ax_elem[i]));
+      norm = std::max(norm, std::abs(ax[i]));
+    }
+    for (int i = 0; i < ndof; i++)
+    {
+      diff_rhs = std::max(diff_rhs, std::abs(rhs.get(i) - rhs_elem.get(i)));
+      norm_rhs = std::max(norm_rhs, std::abs(rhs.get(i)));
+    }
+    info("ndof = %d, nnz = %d, relative difference: matrix %g, rhs %g", ndof, nnz, diff / norm, diff_rhs / norm_rhs);
+    if (diff > TOLERANCE * norm || diff_rhs > TOLERANCE * norm_rhs) success = false;
+  }
+
+  delete [] ap; delete [] ai; delete [] ax;
+  delete [] ap_elem; delete [] ai_elem; delete [] ax_elem;
+
+#define ERROR_SUCCESS                               0
+#define ERROR_FAILURE                               -1
+  if (success) {
+    printf("Success!\n");
+    return ERROR_SUCCESS;
+  }
+  else {
+    printf("Failure!\n");
+    return ERROR_FAILURE;
+  }
+}
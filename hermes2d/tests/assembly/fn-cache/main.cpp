@@ -0,0 +1,131 @@
+#define HERMES_REPORT_WARN
+#define HERMES_REPORT_INFO
+#define HERMES_REPORT_VERBOSE
+#define HERMES_REPORT_FILE "application.log"
+#include "hermes2d.h"
+
+//  This test makes sure that the transformed shape functions kept by DiscreteProblem across
+//  the elements (the function cache) are correct. The problem -Laplace u + u = f has the exact
+//  solution u = x^3 - 3xy^2 + x^2 + xy - y^2, which lies in the finite element space on the
+//  affine mesh of triangles and quadrilaterals, so the discrete solution has to match it up to
+//  the rounding errors. The same DiscreteProblem is assembled again after a refinement of the
+//  mesh. The triangles and the quadrilaterals share shape indices and quadrature orders, but
+//  not the numbers of the quadrature points.
+
+const int P_INIT = 3;                             // Polynomial degree of the elements.
+const int INIT_REF_NUM = 1;                       // Number of initial uniform mesh refinements.
+const int CORNER_REF_NUM = 2;                     // Number of refinements towards the vertex (1, 1).
+const double TOLERANCE = 1e-10;                   // Tolerance for the maximum error of the solution.
+MatrixSolverType matrix_solver = SOLVER_UMFPACK;  // Possibilities: SOLVER_UMFPACK, SOLVER_PETSC,
+                                                  // SOLVER_MUMPS, and more are coming.
+
+// Exact solution.
+template<typename Real>
+Real exact(Real x, Real y)
+{
+  return x*x*x - 3*x*y*y + x*x + x*y - y*y;
+}
+
+// Boundary condition types.
+BCType bc_types(int marker)
+{
+  return BC_ESSENTIAL;
+}
+
+// Essential (Dirichlet) boundary condition values.
+scalar essential_bc_values(int marker, double x, double y)
+{
+  return exact(x, y);
+}
+
+// Weak forms.
+template<typename Real, typename Scalar>
+Scalar bilinear_form(int n, double *wt, Func<Real> *u_ext[], Func<Real> *u, Func<Real> *v, Geom<Real> *e, ExtData<Scalar> *ext)
+{
+  return int_grad_u_grad_v<Real, Scalar>(n, wt, u, v) + int_u_v<Real, Scalar>(n, wt, u, v);
+}
+
+template<typename Real, typename Scalar>
+Scalar linear_form(int n, double *wt, Func<Real> *u_ext[], Func<Real> *v, Geom<Real> *e, ExtData<Scalar> *ext)
+{
+  Scalar result = 0;
+  for (int i = 0; i < n; i++)
+    result += wt[i] * exact(e->x[i], e->y[i]) * v->val[i];
+  return result;
+}
+
+// Assembles and solves the problem, returns the maximum error of the solution on a grid of points.
+double solve(DiscreteProblem* dp, Space* space)
+{
+  SparseMatrix* matrix = create_matrix(matrix_solver);
+  Vector* rhs = create_vector(matrix_solver);
+  Solver* solver = create_linear_solver(matrix_solver, matrix, rhs);
+
+  dp->assemble(matrix, rhs);
+  info("ndof = %d, function cache: %d reused, %d updated", Space::get_num_dofs(space),
+       dp->get_num_fn_cache_reuses(), dp->get_num_fn_cache_updates());
+
+  double err = 1e100;
+  if (solver->solve())
+  {
+    Solution sln;
+    Solution::vector_to_solution(solver->get_solution(), space, &sln);
+    err = 0;
+    for (int i = 0; i <= 20; i++)
+      for (int j = 0; j <= 10; j++)
+      {
+        double x = 0.1 * i, y = 0.1 * j;
+        err = std::max(err, std::abs(sln.get_pt_value(x, y) - exact(x, y)));
+      }
+  }
+  info("maximum error = %g", err);
+
+  delete solver;
+  delete matrix;
+  delete rhs;
+  return err;
+}
+
+int main(int argc, char* argv[])
+{
+  // Load the mesh.
+  Mesh mesh;
+  H2DReader mloader;
+  mloader.load("domain.mesh", &mesh);
+
+  // Perform initial mesh refinements (with hanging nodes between the quadrilaterals and the triangles).
+  for (int i = 0; i < INIT_REF_NUM; i++) mesh.refine_all_elements();
+  mesh.refine_towards_vertex(2, CORNER_REF_NUM);
+
+  // Create an H1 space with default shapeset.
+  H1Space space(&mesh, bc_types, essential_bc_values, P_INIT);
+
+  // Initialize the weak formulation.
+  WeakForm wf;
+  wf.add_matrix_form(callback(bilinear_form), HERMES_SYM);
+  wf.add_vector_form(callback(linear_form));
+
+  // Initialize the FE problem.
+  bool is_linear = true;
+  DiscreteProblem dp(&wf, &space, is_linear);
+
+  bool success = solve(&dp, &space) < TOLERANCE;
+  // most of the elements are affine and of the same size
+  if (dp.get_num_fn_cache_reuses() == 0) success = false;
+
+  // Refine the mesh and assemble with the values kept from the coarse mesh.
+  mesh.refine_all_elements();
+  space.set_uniform_order(P_INIT);
+  if (solve(&dp, &space) >= TOLERANCE) success = false;
+
+#define ERROR_SUCCESS                               0
+#define ERROR_FAILURE                               -1
+  if (success) {
+    printf("Success!\n");
+    return ERROR_SUCCESS;
+  }
+  else {
+    printf("Failure!\n");
+    return ERROR_FAILURE;
+  }
+}
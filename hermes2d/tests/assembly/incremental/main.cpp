@@ -0,0 +1,212 @@
+#define HERMES_REPORT_WARN
+#define HERMES_REPORT_INFO
+#define HERMES_REPORT_VERBOSE
+#define HERMES_REPORT_FILE "application.log"
+#include "hermes2d.h"
+
+//  This test makes sure that the incremental assembly (DiscreteProblem::set_incremental_assembly())
+//  gives the same matrix and right-hand side as the full assembly. A system of two equations with
+//  volume and surface forms and an external function is assembled again without changes, after
+//  a change of the external function, after a local refinement, after a change of the order of
+//  one element and after a global refinement (the stored values are dropped and stored again by
+//  the next assembling). Only the changed elements may be computed again: without changes every
+//  element has to come from the cache, after the local changes most of them.
+
+const int INIT_REF_NUM = 3;                       // Number of initial uniform mesh refinements.
+const double TOLERANCE = 1e-13;                   // Tolerance for the relative difference of the matrices.
+
+// Boundary condition types.
+BCType bc_types(int marker)
+{
+  return marker == 1 ? BC_ESSENTIAL : BC_NATURAL;
+}
+
+// Essential (Dirichlet) boundary condition values.
+scalar essential_bc_values(int marker, double x, double y)
+{
+  return 1.0 + x * y;
+}
+
+// Weak forms.
+template<typename Real, typename Scalar>
+Scalar bilinear_form_0_0(int n, double *wt, Func<Real> *u_ext[], Func<Real> *u, Func<Real> *v, Geom<Real> *e, ExtData<Scalar> *ext)
+{
+  Scalar result = 0;
+  for (int i = 0; i < n; i++)
+    result += wt[i] * (u->dx[i] * v->dx[i] + u->dy[i] * v->dy[i] + (1 + e->x[i] * e->x[i]) * u->val[i] * v->val[i]);
+  return result;
+}
+
+template<typename Real, typename Scalar>
+Scalar bilinear_form_0_1(int n, double *wt, Func<Real> *u_ext[], Func<Real> *u, Func<Real> *v, Geom<Real> *e, ExtData<Scalar> *ext)
+{
+  Scalar result = 0;
+  for (int i = 0; i < n; i++)
+    result += wt[i] * (u->dy[i] * v->dx[i] + 0.5 * u->dx[i] * v->dy[i]);
+  return result;
+}
+
+template<typename Real, typename Scalar>
+Scalar bilinear_form_1_1(int n, double *wt, Func<Real> *u_ext[], Func<Real> *u, Func<Real> *v, Geom<Real> *e, ExtData<Scalar> *ext)
+{
+  return int_grad_u_grad_v<Real, Scalar>(n, wt, u, v);
+}
+
+template<typename Real, typename Scalar>
+Scalar bilinear_form_surf(int n, double *wt, Func<Real> *u_ext[], Func<Real> *u, Func<Real> *v, Geom<Real> *e, ExtData<Scalar> *ext)
+{
+  Scalar result = 0;
+  for (int i = 0; i < n; i++)
+    result += wt[i] * (2 + e->y[i]) * u->val[i] * v->val[i];
+  return result;
+}
+
+template<typename Real, typename Scalar>
+Scalar linear_form_0(int n, double *wt, Func<Real> *u_ext[], Func<Real> *v, Geom<Real> *e, ExtData<Scalar> *ext)
+{
+  Scalar result = 0;
+  for (int i = 0; i < n; i++)
+    result += wt[i] * (e->x[i] + 2) * v->val[i];
+  return result;
+}
+
+template<typename Real, typename Scalar>
+Scalar linear_form_1(int n, double *wt, Func<Real> *u_ext[], Func<Real> *v, Geom<Real> *e, ExtData<Scalar> *ext)
+{
+  Scalar result = 0;
+  for (int i = 0; i < n; i++)
+    result += wt[i] * ext->fn[0]->val[i] * v->val[i];
+  return result;
+}
+
+template<typename Real, typename Scalar>
+Scalar linear_form_surf(int n, double *wt, Func<Real> *u_ext[], Func<Real> *v, Geom<Real> *e, ExtData<Scalar> *ext)
+{
+  Scalar result = 0;
+  for (int i = 0; i < n; i++)
+    result += wt[i] * (1 + e->x[i]) * v->val[i];
+  return result;
+}
+
+// Assembles the system incrementally and fully, compares the matrices and the right-hand sides.
+bool compare(const char* stage, DiscreteProblem* dp_inc, DiscreteProblem* dp_full,
+             UMFPackMatrix* mat_inc, UMFPackVector* rhs_inc, UMFPackMatrix* mat_full, UMFPackVector* rhs_full)
+{
+  dp_inc->assemble(mat_inc, rhs_inc);
+  dp_full->assemble(mat_full, rhs_full);
+
+  int *ap, *ai, *ap_full, *ai_full;
+  scalar *ax, *ax_full;
+  int nnz = mat_inc->get_full_csc(ap, ai, ax);
+  int nnz_full = mat_full->get_full_csc(ap_full, ai_full, ax_full);
+  int ndof = mat_inc->get_size();
+  bool success = nnz == nnz_full && mat_full->get_size() == ndof
+                 && !memcmp(ap, ap_full, (ndof + 1) * sizeof(int)) && !memcmp(ai, ai_full, nnz * sizeof(int));
+  double diff = 0, norm = 0, diff_rhs = 0, norm_rhs = 0;
+  if (success)
+  {
+    for (int i = 0; i < nnz; i++)
+    {
+      diff = std::max(diff, std::abs(ax[i] - ax_full[i]));
+      norm = std::max(norm, std::abs(ax_full[i]));
+    }
+    for (int i = 0; i < ndof; i++)
+    {
+      diff_rhs = std::max(diff_rhs, std::abs(rhs_inc->get(i) - rhs_full->get(i)));
+      norm_rhs = std::max(norm_rhs, std::abs(rhs_full->get(i)));
+    }
+    if (diff > TOLERANCE * norm || diff_rhs > TOLERANCE * norm_rhs) success = false;
+  }
+  info("%s: ndof = %d, elements: %d from the cache, %d computed, relative difference: matrix %g, rhs %g",
+       stage, ndof, dp_inc->get_num_elem_cache_hits(), dp_inc->get_num_elem_cache_misses(), diff / norm, diff_rhs / norm_rhs);
+
+  delete [] ap; delete [] ai; delete [] ax;
+  delete [] ap_full; delete [] ai_full; delete [] ax_full;
+  return success;
+}
+
+int main(int argc, char* argv[])
+{
+  // Load the mesh.
+  Mesh mesh;
+  H2DReader mloader;
+  mloader.load("domain.mesh", &mesh);
+  for (int i = 0; i < INIT_REF_NUM; i++) mesh.refine_all_elements();
+
+  // Create the spaces and the external function.
+  H1Space space_0(&mesh, bc_types, essential_bc_values, 3);
+  H1Space space_1(&mesh, bc_types, essential_bc_values, 2);
+  Tuple<Space*> spaces(&space_0, &space_1);
+  Solution ext;
+  ext.set_const(&mesh, 1.0);
+
+  // Initialize the weak formulation.
+  WeakForm wf(2);
+  wf.add_matrix_form(0, 0, callback(bilinear_form_0_0), HERMES_SYM);
+  wf.add_matrix_form(0, 1, callback(bilinear_form_0_1), HERMES_SYM);
+  wf.add_matrix_form_const(1, 1, callback(bilinear_form_1_1), HERMES_SYM);
+  wf.add_matrix_form_surf(0, 0, callback(bilinear_form_surf), 2);
+  wf.add_vector_form(0, callback(linear_form_0));
+  wf.add_vector_form(1, callback(linear_form_1), HERMES_ANY, Tuple<MeshFunction*>(&ext));
+  wf.add_vector_form_surf(1, callback(linear_form_surf), 2);
+
+  // Initialize the FE problems, the first one assembles incrementally.
+  DiscreteProblem dp_inc(&wf, spaces, true);
+  DiscreteProblem dp_full(&wf, spaces, true);
+  dp_inc.set_incremental_assembly();
+  UMFPackMatrix mat_inc, mat_full;
+  UMFPackVector rhs_inc, rhs_full;
+
+  bool success = compare("first", &dp_inc, &dp_full, &mat_inc, &rhs_inc, &mat_full, &rhs_full);
+  if (dp_inc.get_num_elem_cache_hits() != 0) success = false;
+
+  // Nothing changed.
+  if (!compare("again", &dp_inc, &dp_full, &mat_inc, &rhs_inc, &mat_full, &rhs_full)) success = false;
+  if (dp_inc.get_num_elem_cache_misses() != 0 || dp_inc.get_num_elem_cache_hits() == 0) success = false;
+
+  // The forms with the external function are always evaluated.
+  ext.set_const(&mesh, 3.0);
+  if (!compare("external function", &dp_inc, &dp_full, &mat_inc, &rhs_inc, &mat_full, &rhs_full)) success = false;
+  if (dp_inc.get_num_elem_cache_misses() != 0) success = false;
+
+  // Refine three elements (one of them anisotropically if it is a quad).
+  std::vector<int> ids;
+  Element* e;
+  for_all_active_elements(e, &mesh) ids.push_back(e->id);
+  mesh.refine_element(ids[5]);
+  mesh.refine_element(ids[40]);
+  mesh.refine_element(ids[ids.size() - 1], mesh.get_element(ids[ids.size() - 1])->is_quad() ? 1 : 0);
+  space_0.set_uniform_order(3);
+  space_1.set_uniform_order(2);
+  Space::assign_dofs(spaces);
+  if (!compare("local refinement", &dp_inc, &dp_full, &mat_inc, &rhs_inc, &mat_full, &rhs_full)) success = false;
+  if (dp_inc.get_num_elem_cache_misses() == 0 || dp_inc.get_num_elem_cache_misses() >= dp_inc.get_num_elem_cache_hits()) success = false;
+
+  // Change the order of one element.
+  int id = ids[20];
+  space_0.set_element_order(id, mesh.get_element(id)->is_quad() ? H2D_MAKE_QUAD_ORDER(5, 4) : 5);
+  Space::assign_dofs(spaces);
+  if (!compare("order change", &dp_inc, &dp_full, &mat_inc, &rhs_inc, &mat_full, &rhs_full)) success = false;
+  if (dp_inc.get_num_elem_cache_misses() == 0 || dp_inc.get_num_elem_cache_misses() >= dp_inc.get_num_elem_cache_hits()) success = false;
+
+  // Refine all elements, the stored values are dropped, the next assemble() stores them again.
+  mesh.refine_all_elements();
+  space_0.set_uniform_order(3);
+  space_1.set_uniform_order(2);
+  Space::assign_dofs(spaces);
+  if (!compare("global refinement", &dp_inc, &dp_full, &mat_inc, &rhs_inc, &mat_full, &rhs_full)) success = false;
+  if (!compare("storing again", &dp_inc, &dp_full, &mat_inc, &rhs_inc, &mat_full, &rhs_full)) success = false;
+  if (!compare("again", &dp_inc, &dp_full, &mat_inc, &rhs_inc, &mat_full, &rhs_full)) success = false;
+  if (dp_inc.get_num_elem_cache_misses() != 0) success = false;
+
+#define ERROR_SUCCESS                               0
+#define ERROR_FAILURE                               -1
+  if (success) {
+    printf("Success!\n");
+    return ERROR_SUCCESS;
+  }
+  else {
+    printf("Failure!\n");
+    return ERROR_FAILURE;
+  }
+}
@@ -0,0 +1,168 @@
+#define HERMES_REPORT_WARN
+#define HERMES_REPORT_INFO
+#define HERMES_REPORT_VERBOSE
+#define HERMES_REPORT_FILE "application.log"
+#include "hermes2d.h"
+
+//  This test makes sure that the interleaved DOF numbering (DiscreteProblem::set_interleaved_dofs())
+//  survives the reassignment of the DOFs after a mesh refinement: a system of two equations is
+//  assembled with the consecutive and the interleaved numbering, before and after the refinement,
+//  and the two matrices and right-hand sides have to be the same up to the permutation of the DOFs.
+
+const int P_INIT = 3;                             // Polynomial degree of the elements.
+const int INIT_REF_NUM = 2;                       // Number of initial uniform mesh refinements.
+
+// Boundary condition types.
+BCType bc_types(int marker)
+{
+  return marker == 1 ? BC_ESSENTIAL : BC_NATURAL;
+}
+
+// Essential (Dirichlet) boundary condition values.
+scalar essential_bc_values(int marker, double x, double y)
+{
+  return 1.0 + x * y;
+}
+
+// Weak forms.
+template<typename Real, typename Scalar>
+Scalar bilinear_form_0_0(int n, double *wt, Func<Real> *u_ext[], Func<Real> *u, Func<Real> *v, Geom<Real> *e, ExtData<Scalar> *ext)
+{
+  Scalar result = 0;
+  for (int i = 0; i < n; i++)
+    result += wt[i] * ((1 + e->x[i] * e->x[i]) * u->dx[i] * v->dx[i] + u->dy[i] * v->dy[i] + u->val[i] * v->val[i]);
+  return result;
+}
+
+template<typename Real, typename Scalar>
+Scalar bilinear_form_0_1(int n, double *wt, Func<Real> *u_ext[], Func<Real> *u, Func<Real> *v, Geom<Real> *e, ExtData<Scalar> *ext)
+{
+  Scalar result = 0;
+  for (int i = 0; i < n; i++)
+    result += wt[i] * (u->dy[i] * v->dx[i] + 0.5 * u->dx[i] * v->dy[i]);
+  return result;
+}
+
+template<typename Real, typename Scalar>
+Scalar bilinear_form_1_0(int n, double *wt, Func<Real> *u_ext[], Func<Real> *u, Func<Real> *v, Geom<Real> *e, ExtData<Scalar> *ext)
+{
+  Scalar result = 0;
+  for (int i = 0; i < n; i++)
+    result += wt[i] * (u->val[i] * v->dx[i] + e->y[i] * u->dx[i] * v->val[i]);
+  return result;
+}
+
+template<typename Real, typename Scalar>
+Scalar bilinear_form_1_1(int n, double *wt, Func<Real> *u_ext[], Func<Real> *u, Func<Real> *v, Geom<Real> *e, ExtData<Scalar> *ext)
+{
+  return int_grad_u_grad_v<Real, Scalar>(n, wt, u, v);
+}
+
+template<typename Real, typename Scalar>
+Scalar linear_form_0(int n, double *wt, Func<Real> *u_ext[], Func<Real> *v, Geom<Real> *e, ExtData<Scalar> *ext)
+{
+  Scalar result = 0;
+  for (int i = 0; i < n; i++)
+    result += wt[i] * (e->x[i] + 2) * v->val[i];
+  return result;
+}
+
+template<typename Real, typename Scalar>
+Scalar linear_form_surf_1(int n, double *wt, Func<Real> *u_ext[], Func<Real> *v, Geom<Real> *e, ExtData<Scalar> *ext)
+{
+  return int_v<Real, Scalar>(n, wt, v);
+}
+
+// Position of the DOF 'dof' of the consecutive numbering in the interleaved one.
+int interleaved(int dof, int ndof_0)
+{
+  return dof < ndof_0 ? 2 * dof : 2 * (dof - ndof_0) + 1;
+}
+
+// Assembles the system with the consecutive and the interleaved numbering and compares them.
+bool compare(DiscreteProblem* dp_cons, DiscreteProblem* dp_intl, Tuple<Space*> spaces_cons, Tuple<Space*> spaces_intl)
+{
+  UMFPackMatrix mat_cons, mat_intl;
+  UMFPackVector rhs_cons, rhs_intl;
+  dp_cons->assemble(&mat_cons, &rhs_cons);
+  dp_intl->assemble(&mat_intl, &rhs_intl);
+
+  if (!Space::is_interleaved(spaces_intl))
+  {
+    info("The DOFs are not interleaved.");
+    return false;
+  }
+
+  int ndof = Space::get_num_dofs(spaces_cons);
+  int ndof_0 = Space::get_num_dofs(spaces_cons[0]);
+  info("ndof = %d", ndof);
+  if (Space::get_num_dofs(spaces_intl) != ndof || 2 * ndof_0 != ndof) return false;
+
+  for (int i = 0; i < ndof; i++)
+  {
+    if (rhs_cons.get(i) != rhs_intl.get(interleaved(i, ndof_0))) return false;
+    for (int j = 0; j < ndof; j++)
+      if (mat_cons.get(i, j) != mat_intl.get(interleaved(i, ndof_0), interleaved(j, ndof_0))) return false;
+  }
+  return true;
+}
+
+int main(int argc, char* argv[])
+{
+  // Load the mesh.
+  Mesh mesh;
+  H2DReader mloader;
+  mloader.load("domain.mesh", &mesh);
+
+  // Perform initial mesh refinements.
+  for (int i = 0; i < INIT_REF_NUM; i++) mesh.refine_all_elements();
+
+  // Create the spaces: one pair with the consecutive, one with the interleaved numbering.
+  H1Space u_cons(&mesh, bc_types, essential_bc_values, P_INIT);
+  H1Space v_cons(&mesh, bc_types, essential_bc_values, P_INIT);
+  H1Space u_intl(&mesh, bc_types, essential_bc_values, P_INIT);
+  H1Space v_intl(&mesh, bc_types, essential_bc_values, P_INIT);
+  Tuple<Space*> spaces_cons(&u_cons, &v_cons);
+  Tuple<Space*> spaces_intl(&u_intl, &v_intl);
+
+  // Initialize the weak formulation.
+  WeakForm wf(2);
+  wf.add_matrix_form(0, 0, callback(bilinear_form_0_0), HERMES_SYM);
+  wf.add_matrix_form(0, 1, callback(bilinear_form_0_1), HERMES_UNSYM);
+  wf.add_matrix_form(1, 0, callback(bilinear_form_1_0), HERMES_UNSYM);
+  wf.add_matrix_form(1, 1, callback(bilinear_form_1_1), HERMES_SYM);
+  wf.add_vector_form(0, callback(linear_form_0));
+  wf.add_vector_form_surf(1, callback(linear_form_surf_1), 2);
+
+  // Initialize the FE problems.
+  DiscreteProblem dp_cons(&wf, spaces_cons, true);
+  DiscreteProblem dp_intl(&wf, spaces_intl, true);
+  dp_intl.set_interleaved_dofs();
+
+  bool success = compare(&dp_cons, &dp_intl, spaces_cons, spaces_intl);
+
+  // Refine the mesh, set_uniform_order() numbers the DOFs consecutively again
+  // (as the adaptivity does); the next assembling has to interleave them.
+  mesh.refine_all_elements();
+  for (int i = 0; i < 2; i++)
+  {
+    spaces_cons[i]->set_uniform_order(P_INIT);
+    spaces_intl[i]->set_uniform_order(P_INIT);
+  }
+  Space::assign_dofs(spaces_cons);
+  Space::assign_dofs(spaces_intl);
+  if (Space::is_interleaved(spaces_intl)) success = false;
+
+  success = success && compare(&dp_cons, &dp_intl, spaces_cons, spaces_intl);
+
+#define ERROR_SUCCESS                               0
+#define ERROR_FAILURE                               -1
+  if (success) {
+    printf("Success!\n");
+    return ERROR_SUCCESS;
+  }
+  else {
+    printf("Failure!\n");
+    return ERROR_FAILURE;
+  }
+}
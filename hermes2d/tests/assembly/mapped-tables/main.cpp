@@ -0,0 +1,163 @@
+#define HERMES_REPORT_WARN
+#define HERMES_REPORT_INFO
+#define HERMES_REPORT_VERBOSE
+#define HERMES_REPORT_FILE "application.log"
+#include "hermes2d.h"
+
+//  This test makes sure that the shape function tables written by PrecalcShapeset::save_tables()
+//  and mapped by PrecalcShapeset::map_tables() give bit for bit the same matrices and right-hand
+//  sides as the tables calculated by the PrecalcShapesets. An H1 and an Hcurl problem (with
+//  hanging nodes) are assembled before the files are mapped and again after that. Files that
+//  are missing or are not table files have to be rejected.
+
+const int INIT_REF_NUM = 2;                       // Number of initial uniform mesh refinements.
+const int P_INIT = 5;                             // Initial polynomial degree of all elements.
+
+// Boundary condition types.
+BCType bc_types(int marker)
+{
+  return marker == 1 ? BC_ESSENTIAL : BC_NATURAL;
+}
+
+// Essential (Dirichlet) boundary condition values.
+scalar essential_bc_values(int marker, double x, double y)
+{
+  return 1.0 + x * y;
+}
+
+// Weak forms of the H1 problem.
+template<typename Real, typename Scalar>
+Scalar bilinear_form_h1(int n, double *wt, Func<Real> *u_ext[], Func<Real> *u, Func<Real> *v, Geom<Real> *e, ExtData<Scalar> *ext)
+{
+  Scalar result = 0;
+  for (int i = 0; i < n; i++)
+    result += wt[i] * (u->dx[i] * v->dx[i] + u->dy[i] * v->dy[i] + e->x[i] * u->val[i] * v->val[i]);
+  return result;
+}
+
+template<typename Real, typename Scalar>
+Scalar linear_form_h1(int n, double *wt, Func<Real> *u_ext[], Func<Real> *v, Geom<Real> *e, ExtData<Scalar> *ext)
+{
+  Scalar result = 0;
+  for (int i = 0; i < n; i++)
+    result += wt[i] * (e->x[i] + 2) * v->val[i];
+  return result;
+}
+
+// Weak forms of the Hcurl problem.
+template<typename Real, typename Scalar>
+Scalar bilinear_form_hcurl(int n, double *wt, Func<Real> *u_ext[], Func<Real> *u, Func<Real> *v, Geom<Real> *e, ExtData<Scalar> *ext)
+{
+  return int_curl_e_curl_f<Real, Scalar>(n, wt, u, v) - int_e_f<Real, Scalar>(n, wt, u, v);
+}
+
+template<typename Real, typename Scalar>
+Scalar linear_form_hcurl(int n, double *wt, Func<Real> *u_ext[], Func<Real> *v, Geom<Real> *e, ExtData<Scalar> *ext)
+{
+  Scalar result = 0;
+  for (int i = 0; i < n; i++)
+    result += wt[i] * (e->y[i] * v->val0[i] + e->x[i] * v->val1[i]);
+  return result;
+}
+
+// Assembled matrix and right-hand side, in the CSC format.
+struct Assembled
+{
+  int ndof, nnz;
+  int *ap, *ai;
+  scalar *ax, *rhs;
+
+  Assembled() : ap(NULL), ai(NULL), ax(NULL), rhs(NULL) {}
+  ~Assembled() { delete [] ap; delete [] ai; delete [] ax; delete [] rhs; }
+};
+
+void assemble(WeakForm* wf, Space* space, Assembled* a)
+{
+  DiscreteProblem dp(wf, space, true);
+  UMFPackMatrix mat;
+  UMFPackVector rhs;
+  dp.assemble(&mat, &rhs);
+  a->ndof = mat.get_size();
+  a->nnz = mat.get_full_csc(a->ap, a->ai, a->ax);
+  a->rhs = new scalar[a->ndof];
+  rhs.extract(a->rhs);
+}
+
+bool compare(const char* what, Assembled* a, Assembled* a_ref)
+{
+  bool success = a->ndof == a_ref->ndof && a->nnz == a_ref->nnz
+                 && !memcmp(a->ap, a_ref->ap, (a->ndof + 1) * sizeof(int))
+                 && !memcmp(a->ai, a_ref->ai, a->nnz * sizeof(int))
+                 && !memcmp(a->ax, a_ref->ax, a->nnz * sizeof(scalar))
+                 && !memcmp(a->rhs, a_ref->rhs, a->ndof * sizeof(scalar));
+  info("%s: ndof = %d, nnz = %d, %s", what, a->ndof, a->nnz, success ? "identical" : "different");
+  return success;
+}
+
+int main(int argc, char* argv[])
+{
+  // Load the mesh and refine it towards a vertex (hanging nodes).
+  Mesh mesh;
+  H2DReader mloader;
+  mloader.load("domain.mesh", &mesh);
+  for (int i = 0; i < INIT_REF_NUM; i++) mesh.refine_all_elements();
+  mesh.refine_towards_vertex(4, 1);
+
+  // Create the spaces and the weak forms.
+  H1Space space_h1(&mesh, bc_types, essential_bc_values, P_INIT);
+  HcurlSpace space_hcurl(&mesh, bc_types, NULL, P_INIT);
+  WeakForm wf_h1, wf_hcurl;
+  wf_h1.add_matrix_form(callback(bilinear_form_h1), HERMES_SYM);
+  wf_h1.add_vector_form(callback(linear_form_h1));
+  wf_hcurl.add_matrix_form(callback(bilinear_form_hcurl), HERMES_SYM);
+  wf_hcurl.add_vector_form(callback(linear_form_hcurl));
+
+  // Assemble with the calculated tables.
+  Assembled h1_ref, hcurl_ref;
+  assemble(&wf_h1, &space_h1, &h1_ref);
+  assemble(&wf_hcurl, &space_hcurl, &hcurl_ref);
+
+  // Write the table files and a file that is not a table file.
+  H1Shapeset shapeset_h1;
+  HcurlShapeset shapeset_hcurl;
+  PrecalcShapeset::save_tables(&shapeset_h1, "h1.tab");
+  PrecalcShapeset::save_tables(&shapeset_hcurl, "hcurl.tab");
+  FILE* f = fopen("bad.tab", "wb");
+  if (f == NULL) error("Cannot create bad.tab.");
+  for (int i = 0; i < 100; i++) fprintf(f, "not a table file ");
+  fclose(f);
+
+  bool success = true;
+  if (PrecalcShapeset::map_tables("bad.tab") || PrecalcShapeset::map_tables("missing.tab"))
+  {
+    info("An invalid file was mapped.");
+    success = false;
+  }
+  if (!PrecalcShapeset::map_tables("h1.tab") || !PrecalcShapeset::map_tables("hcurl.tab"))
+  {
+    info("The table files could not be mapped.");
+    success = false;
+  }
+
+  // Assemble again, now with the mapped tables.
+  Assembled h1, hcurl;
+  assemble(&wf_h1, &space_h1, &h1);
+  assemble(&wf_hcurl, &space_hcurl, &hcurl);
+  if (!compare("H1", &h1, &h1_ref)) success = false;
+  if (!compare("Hcurl", &hcurl, &hcurl_ref)) success = false;
+
+  remove("h1.tab");
+  remove("hcurl.tab");
+  remove("bad.tab");
+
+#define ERROR_SUCCESS                               0
+#define ERROR_FAILURE                               -1
+  if (success) {
+    printf("Success!\n");
+    return ERROR_SUCCESS;
+  }
+  else {
+    printf("Failure!\n");
+    return ERROR_FAILURE;
+  }
+}
@@ -0,0 +1,161 @@
+#define HERMES_REPORT_WARN
+#define HERMES_REPORT_INFO
+#define HERMES_REPORT_VERBOSE
+#define HERMES_REPORT_FILE "application.log"
+#include "hermes2d.h"
+
+//  This test makes sure that several right-hand sides assembled in one traversal (the
+//  vector forms are given the index of their right-hand side in WeakForm::add_vector_form()
+//  and add_vector_form_surf()) are the same as the right-hand sides assembled one by one,
+//  every one of them including the Dirichlet lift, and that a form with an index beyond
+//  the number of the assembled right-hand sides is skipped. The solutions of
+//  LinearSolver::solve_multiple() have to be the ones of separate solve() calls.
+
+const int P_INIT = 3;                             // Polynomial degree of the elements.
+const int INIT_REF_NUM = 2;                       // Number of initial uniform mesh refinements.
+const int NRHS = 3;                               // Number of the right-hand sides.
+const double TOLERANCE = 1e-12;                   // Tolerance for the relative differences.
+
+// Boundary condition types.
+BCType bc_types(int marker)
+{
+  return marker == 1 ? BC_ESSENTIAL : BC_NATURAL;
+}
+
+// Essential (Dirichlet) boundary condition values.
+scalar essential_bc_values(int marker, double x, double y)
+{
+  return 1.0 + x * y;
+}
+
+// Weak forms.
+template<typename Real, typename Scalar>
+Scalar bilinear_form(int n, double *wt, Func<Real> *u_ext[], Func<Real> *u, Func<Real> *v, Geom<Real> *e, ExtData<Scalar> *ext)
+{
+  return int_grad_u_grad_v<Real, Scalar>(n, wt, u, v) + int_u_v<Real, Scalar>(n, wt, u, v);
+}
+
+template<typename Real, typename Scalar>
+Scalar linear_form_0(int n, double *wt, Func<Real> *u_ext[], Func<Real> *v, Geom<Real> *e, ExtData<Scalar> *ext)
+{
+  Scalar result = 0;
+  for (int i = 0; i < n; i++)
+    result += wt[i] * (e->x[i] + 2) * v->val[i];
+  return result;
+}
+
+template<typename Real, typename Scalar>
+Scalar linear_form_1(int n, double *wt, Func<Real> *u_ext[], Func<Real> *v, Geom<Real> *e, ExtData<Scalar> *ext)
+{
+  Scalar result = 0;
+  for (int i = 0; i < n; i++)
+    result += wt[i] * (e->y[i] * v->val[i] + v->dx[i]);
+  return result;
+}
+
+template<typename Real, typename Scalar>
+Scalar linear_form_surf(int n, double *wt, Func<Real> *u_ext[], Func<Real> *v, Geom<Real> *e, ExtData<Scalar> *ext)
+{
+  Scalar result = 0;
+  for (int i = 0; i < n; i++)
+    result += wt[i] * (1.0 - e->y[i] * e->y[i]) * v->val[i];
+  return result;
+}
+
+// Adds the vector forms of the k-th right-hand side with the given index.
+void add_rhs_forms(WeakForm* wf, int k, int rhs)
+{
+  if (k == 0) wf->add_vector_form(callback(linear_form_0), HERMES_ANY, Tuple<MeshFunction*>(), rhs);
+  if (k == 1) wf->add_vector_form_surf(callback(linear_form_surf), 2, Tuple<MeshFunction*>(), rhs);
+  if (k == 2)
+  {
+    wf->add_vector_form(callback(linear_form_1), HERMES_ANY, Tuple<MeshFunction*>(), rhs);
+    wf->add_vector_form_surf(callback(linear_form_surf), 2, Tuple<MeshFunction*>(), rhs);
+  }
+}
+
+double max_diff(int n, scalar* x, scalar* y, double &norm)
+{
+  double diff = 0;
+  norm = 0;
+  for (int i = 0; i < n; i++)
+  {
+    diff = std::max(diff, std::abs(x[i] - y[i]));
+    norm = std::max(norm, std::abs(y[i]));
+  }
+  return diff;
+}
+
+int main(int argc, char* argv[])
+{
+  // Load the mesh.
+  Mesh mesh;
+  H2DReader mloader;
+  mloader.load("domain.mesh", &mesh);
+  for (int i = 0; i < INIT_REF_NUM; i++) mesh.refine_all_elements();
+  mesh.refine_towards_vertex(2, 2);
+
+  // Create an H1 space with default shapeset.
+  H1Space space(&mesh, bc_types, essential_bc_values, P_INIT);
+  int ndof = Space::get_num_dofs(&space);
+  info("ndof = %d", ndof);
+
+  // The weak formulation with all the right-hand sides, and a form beyond them.
+  WeakForm wf;
+  wf.add_matrix_form(callback(bilinear_form), HERMES_SYM);
+  for (int k = 0; k < NRHS; k++) add_rhs_forms(&wf, k, k);
+  wf.add_vector_form(callback(linear_form_1), HERMES_ANY, Tuple<MeshFunction*>(), NRHS);
+
+  // Assemble all the right-hand sides at once.
+  DiscreteProblem dp(&wf, &space, true);
+  UMFPackMatrix mat;
+  UMFPackVector rhs_vec[NRHS];
+  Vector* rhs[NRHS];
+  for (int k = 0; k < NRHS; k++) rhs[k] = rhs_vec + k;
+  dp.assemble(NULL, &mat, rhs, NRHS);
+
+  // Solve for all of them.
+  UMFPackLinearSolver solver(&mat, rhs_vec);
+  bool success = solver.solve_multiple(NRHS, rhs) && solver.get_num_solutions() == NRHS;
+
+  for (int k = 0; k < NRHS; k++)
+  {
+    // Assemble the k-th right-hand side alone.
+    WeakForm wf_k;
+    wf_k.add_matrix_form(callback(bilinear_form), HERMES_SYM);
+    add_rhs_forms(&wf_k, k, 0);
+    DiscreteProblem dp_k(&wf_k, &space, true);
+    UMFPackMatrix mat_k;
+    UMFPackVector rhs_k;
+    dp_k.assemble(&mat_k, &rhs_k);
+
+    scalar* b = new scalar[ndof];
+    scalar* b_k = new scalar[ndof];
+    rhs_vec[k].extract(b);
+    rhs_k.extract(b_k);
+    double norm, norm_sln;
+    double diff = max_diff(ndof, b, b_k, norm);
+
+    // Solve for it alone.
+    UMFPackLinearSolver solver_k(&mat_k, &rhs_k);
+    if (!solver_k.solve()) success = false;
+    double diff_sln = max_diff(ndof, solver.get_solution(k), solver_k.get_solution(), norm_sln);
+
+    info("right-hand side %d: relative difference: rhs %g, solution %g", k, diff / norm, diff_sln / norm_sln);
+    if (diff > TOLERANCE * norm || diff_sln > TOLERANCE * norm_sln) success = false;
+
+    delete [] b;
+    delete [] b_k;
+  }
+
+#define ERROR_SUCCESS                               0
+#define ERROR_FAILURE                               -1
+  if (success) {
+    printf("Success!\n");
+    return ERROR_SUCCESS;
+  }
+  else {
+    printf("Failure!\n");
+    return ERROR_FAILURE;
+  }
+}
@@ -0,0 +1,161 @@
+#define HERMES_REPORT_WARN
+#define HERMES_REPORT_INFO
+#define HERMES_REPORT_VERBOSE
+#define HERMES_REPORT_FILE "application.log"
+#include "hermes2d.h"
+
+//  This test makes sure that the integration orders cached by DiscreteProblem (the results of
+//  the 'ord' callbacks of the forms) are correct. The 'ord' callbacks have to be called exactly
+//  once for every miss of the cache, and the problem -div((1 + x^2) grad u) + u = f with the
+//  exact solution u = x^3 - 3xy^2 + x^2 + xy - y^2 is solved on an affine mesh with the orders
+//  of the elements varying from 3 to 5 (anisotropic on the quadrilaterals): the solution lies
+//  in the finite element space and is reproduced up to the rounding errors only if every
+//  integral uses a sufficient quadrature.
+
+const int INIT_REF_NUM = 2;                       // Number of initial uniform mesh refinements.
+const double TOLERANCE = 1e-10;                   // Tolerance for the maximum error of the solution.
+MatrixSolverType matrix_solver = SOLVER_UMFPACK;  // Possibilities: SOLVER_UMFPACK, SOLVER_PETSC,
+                                                  // SOLVER_MUMPS, and more are coming.
+
+// Exact solution and its x-derivative.
+template<typename Real>
+Real exact(Real x, Real y)
+{
+  return x*x*x - 3*x*y*y + x*x + x*y - y*y;
+}
+
+template<typename Real>
+Real exact_dx(Real x, Real y)
+{
+  return 3*x*x - 3*y*y + 2*x + y;
+}
+
+// Boundary condition types.
+BCType bc_types(int marker)
+{
+  return BC_ESSENTIAL;
+}
+
+// Essential (Dirichlet) boundary condition values.
+scalar essential_bc_values(int marker, double x, double y)
+{
+  return exact(x, y);
+}
+
+// Weak forms.
+template<typename Real, typename Scalar>
+Scalar bilinear_form(int n, double *wt, Func<Real> *u_ext[], Func<Real> *u, Func<Real> *v, Geom<Real> *e, ExtData<Scalar> *ext)
+{
+  Scalar result = 0;
+  for (int i = 0; i < n; i++)
+    result += wt[i] * ((1 + e->x[i] * e->x[i]) * (u->dx[i] * v->dx[i] + u->dy[i] * v->dy[i]) + u->val[i] * v->val[i]);
+  return result;
+}
+
+// the exact solution is harmonic: f = -2x du/dx + u
+template<typename Real, typename Scalar>
+Scalar linear_form(int n, double *wt, Func<Real> *u_ext[], Func<Real> *v, Geom<Real> *e, ExtData<Scalar> *ext)
+{
+  Scalar result = 0;
+  for (int i = 0; i < n; i++)
+    result += wt[i] * (exact(e->x[i], e->y[i]) - 2 * e->x[i] * exact_dx(e->x[i], e->y[i])) * v->val[i];
+  return result;
+}
+
+// The 'ord' callbacks, counting the calls.
+int num_ord_calls = 0;
+
+Ord bilinear_form_ord(int n, double *wt, Func<Ord> *u_ext[], Func<Ord> *u, Func<Ord> *v, Geom<Ord> *e, ExtData<Ord> *ext)
+{
+  num_ord_calls++;
+  return bilinear_form<Ord, Ord>(n, wt, u_ext, u, v, e, ext);
+}
+
+Ord linear_form_ord(int n, double *wt, Func<Ord> *u_ext[], Func<Ord> *v, Geom<Ord> *e, ExtData<Ord> *ext)
+{
+  num_ord_calls++;
+  return linear_form<Ord, Ord>(n, wt, u_ext, v, e, ext);
+}
+
+// Assembles and solves the problem, checks the solution and the number of the 'ord' calls.
+bool solve(DiscreteProblem* dp, Space* space, SparseMatrix* matrix, Vector* rhs, Solver* solver)
+{
+  num_ord_calls = 0;
+  dp->assemble(matrix, rhs);
+  int hits = dp->get_num_order_cache_hits(), misses = dp->get_num_order_cache_misses();
+  info("ndof = %d, order cache: %d hits, %d misses, %d calls of the 'ord' callbacks",
+       Space::get_num_dofs(space), hits, misses, num_ord_calls);
+
+  double err = 1e100;
+  if (solver->solve())
+  {
+    Solution sln;
+    Solution::vector_to_solution(solver->get_solution(), space, &sln);
+    err = 0;
+    for (int i = 0; i <= 20; i++)
+      for (int j = 0; j <= 10; j++)
+      {
+        double x = 0.1 * i, y = 0.1 * j;
+        err = std::max(err, std::abs(sln.get_pt_value(x, y) - exact(x, y)));
+      }
+  }
+  info("maximum error = %g", err);
+
+  return err < TOLERANCE && num_ord_calls == misses && hits > misses;
+}
+
+int main(int argc, char* argv[])
+{
+  // Load the mesh.
+  Mesh mesh;
+  H2DReader mloader;
+  mloader.load("domain.mesh", &mesh);
+
+  // Perform initial mesh refinements.
+  for (int i = 0; i < INIT_REF_NUM; i++) mesh.refine_all_elements();
+
+  // Create an H1 space with the orders 3, 4 and 5 of the elements (anisotropic on the quads).
+  H1Space space(&mesh, bc_types, essential_bc_values, 3);
+  Element* e;
+  for_all_active_elements(e, &mesh)
+  {
+    int order = 3 + e->id % 3;
+    if (e->is_quad()) order = H2D_MAKE_QUAD_ORDER(order, 3 + (e->id + 1) % 3);
+    space.set_element_order_internal(e->id, order);
+  }
+  space.assign_dofs();
+
+  // Initialize the weak formulation.
+  WeakForm wf;
+  wf.add_matrix_form(bilinear_form<double, scalar>, bilinear_form_ord, HERMES_SYM);
+  wf.add_vector_form(linear_form<double, scalar>, linear_form_ord);
+
+  // Initialize the FE problem.
+  bool is_linear = true;
+  DiscreteProblem dp(&wf, &space, is_linear);
+
+  // Set up the solver, matrix, and rhs according to the solver selection.
+  SparseMatrix* matrix = create_matrix(matrix_solver);
+  Vector* rhs = create_vector(matrix_solver);
+  Solver* solver = create_linear_solver(matrix_solver, matrix, rhs);
+
+  // The cache is cleared by every assemble().
+  bool success = solve(&dp, &space, matrix, rhs, solver);
+  if (!solve(&dp, &space, matrix, rhs, solver)) success = false;
+
+  // Cleanup.
+  delete solver;
+  delete matrix;
+  delete rhs;
+
+#define ERROR_SUCCESS                               0
+#define ERROR_FAILURE                               -1
+  if (success) {
+    printf("Success!\n");
+    return ERROR_SUCCESS;
+  }
+  else {
+    printf("Failure!\n");
+    return ERROR_FAILURE;
+  }
+}
@@ -0,0 +1,221 @@
+#define HERMES_REPORT_WARN
+#define HERMES_REPORT_INFO
+#define HERMES_REPORT_VERBOSE
+#define HERMES_REPORT_FILE "application.log"
+#include "hermes2d.h"
+
+//  This test makes sure that the parallel assembling (DiscreteProblem::set_parallel_assembly())
+//  gives the same matrices and right-hand sides as the serial one, bit for bit. Checked are
+//  a linear system of two equations on two different meshes (volume and surface forms,
+//  Dirichlet lift, two right-hand sides, with and without the scatter maps) and a Newton
+//  iteration of a nonlinear problem (the previous iteration passed in the coefficient vector).
+
+const int INIT_REF_NUM = 3;                       // Number of initial uniform mesh refinements.
+
+// Thermal conductivity (temperature-dependent) and its derivative.
+template<typename Real>
+Real lam(Real u) { return 1 + pow(u, 4); }
+
+template<typename Real>
+Real dlam_du(Real u) { return 4*pow(u, 3); }
+
+// Boundary condition types.
+BCType bc_types(int marker)
+{
+  return marker == 1 ? BC_ESSENTIAL : BC_NATURAL;
+}
+
+// Essential (Dirichlet) boundary condition values.
+scalar essential_bc_values(int marker, double x, double y)
+{
+  return 1.0 + x * y;
+}
+
+// Weak forms of the linear system.
+template<typename Real, typename Scalar>
+Scalar bilinear_form_0_0(int n, double *wt, Func<Real> *u_ext[], Func<Real> *u, Func<Real> *v, Geom<Real> *e, ExtData<Scalar> *ext)
+{
+  Scalar result = 0;
+  for (int i = 0; i < n; i++)
+    result += wt[i] * ((1 + e->x[i] * e->x[i]) * u->dx[i] * v->dx[i] + u->dy[i] * v->dy[i] + u->val[i] * v->val[i]);
+  return result;
+}
+
+template<typename Real, typename Scalar>
+Scalar bilinear_form_0_1(int n, double *wt, Func<Real> *u_ext[], Func<Real> *u, Func<Real> *v, Geom<Real> *e, ExtData<Scalar> *ext)
+{
+  Scalar result = 0;
+  for (int i = 0; i < n; i++)
+    result += wt[i] * (u->dy[i] * v->dx[i] + 0.5 * u->dx[i] * v->dy[i]);
+  return result;
+}
+
+template<typename Real, typename Scalar>
+Scalar bilinear_form_1_0(int n, double *wt, Func<Real> *u_ext[], Func<Real> *u, Func<Real> *v, Geom<Real> *e, ExtData<Scalar> *ext)
+{
+  Scalar result = 0;
+  for (int i = 0; i < n; i++)
+    result += wt[i] * (u->val[i] * v->dx[i] + e->y[i] * u->dx[i] * v->val[i]);
+  return result;
+}
+
+template<typename Real, typename Scalar>
+Scalar bilinear_form_1_1(int n, double *wt, Func<Real> *u_ext[], Func<Real> *u, Func<Real> *v, Geom<Real> *e, ExtData<Scalar> *ext)
+{
+  return int_grad_u_grad_v<Real, Scalar>(n, wt, u, v);
+}
+
+template<typename Real, typename Scalar>
+Scalar bilinear_form_surf_1_1(int n, double *wt, Func<Real> *u_ext[], Func<Real> *u, Func<Real> *v, Geom<Real> *e, ExtData<Scalar> *ext)
+{
+  return int_u_v<Real, Scalar>(n, wt, u, v);
+}
+
+template<typename Real, typename Scalar>
+Scalar linear_form_0(int n, double *wt, Func<Real> *u_ext[], Func<Real> *v, Geom<Real> *e, ExtData<Scalar> *ext)
+{
+  Scalar result = 0;
+  for (int i = 0; i < n; i++)
+    result += wt[i] * (e->x[i] + 2) * v->val[i];
+  return result;
+}
+
+template<typename Real, typename Scalar>
+Scalar linear_form_1(int n, double *wt, Func<Real> *u_ext[], Func<Real> *v, Geom<Real> *e, ExtData<Scalar> *ext)
+{
+  Scalar result = 0;
+  for (int i = 0; i < n; i++)
+    result += wt[i] * e->y[i] * v->val[i];
+  return result;
+}
+
+template<typename Real, typename Scalar>
+Scalar linear_form_surf_1(int n, double *wt, Func<Real> *u_ext[], Func<Real> *v, Geom<Real> *e, ExtData<Scalar> *ext)
+{
+  return int_v<Real, Scalar>(n, wt, v);
+}
+
+// Weak forms of the nonlinear problem (the Jacobian and the residual).
+template<typename Real, typename Scalar>
+Scalar jac(int n, double *wt, Func<Real> *u_ext[], Func<Real> *u, Func<Real> *v, Geom<Real> *e, ExtData<Scalar> *ext)
+{
+  Scalar result = 0;
+  Func<Scalar>* u_prev = u_ext[0];
+  for (int i = 0; i < n; i++)
+    result += wt[i] * (dlam_du(u_prev->val[i]) * u->val[i] * (u_prev->dx[i] * v->dx[i] + u_prev->dy[i] * v->dy[i])
+                       + lam(u_prev->val[i]) * (u->dx[i] * v->dx[i] + u->dy[i] * v->dy[i]));
+  return result;
+}
+
+template<typename Real, typename Scalar>
+Scalar res(int n, double *wt, Func<Real> *u_ext[], Func<Real> *v, Geom<Real> *e, ExtData<Scalar> *ext)
+{
+  Scalar result = 0;
+  Func<Scalar>* u_prev = u_ext[0];
+  for (int i = 0; i < n; i++)
+    result += wt[i] * (lam(u_prev->val[i]) * (u_prev->dx[i] * v->dx[i] + u_prev->dy[i] * v->dy[i])
+                       - e->x[i] * v->val[i]);
+  return result;
+}
+
+// Assembles the problem serially and in parallel and compares the results bit for bit.
+bool compare(const char* name, DiscreteProblem* dp, scalar* coeff_vec, int nrhs, bool scatter_maps)
+{
+  UMFPackMatrix mat[2];
+  UMFPackVector rhs[2][2];
+  for (int p = 0; p < 2; p++)
+  {
+    dp->set_parallel_assembly(p == 1);
+    dp->set_scatter_maps(scatter_maps);
+    Vector* rhs_p[2] = { &rhs[p][0], &rhs[p][1] };
+    dp->assemble(coeff_vec, &mat[p], rhs_p, nrhs);
+  }
+
+  int *ap[2], *ai[2];
+  scalar *ax[2];
+  int nnz[2];
+  for (int p = 0; p < 2; p++)
+    nnz[p] = mat[p].get_full_csc(ap[p], ai[p], ax[p]);
+
+  int ndof = mat[0].get_size();
+  bool same = mat[1].get_size() == ndof && nnz[0] == nnz[1];
+  if (same)
+  {
+    same = !memcmp(ap[0], ap[1], (ndof + 1) * sizeof(int)) && !memcmp(ai[0], ai[1], nnz[0] * sizeof(int))
+           && !memcmp(ax[0], ax[1], nnz[0] * sizeof(scalar));
+    for (int r = 0; r < nrhs; r++)
+      for (int i = 0; i < ndof; i++)
+        if (rhs[0][r].get(i) != rhs[1][r].get(i)) same = false;
+  }
+  info("%s: ndof = %d, nnz = %d, %s", name, ndof, nnz[0], same ? "identical" : "different");
+
+  for (int p = 0; p < 2; p++)
+  {
+    delete [] ap[p];
+    delete [] ai[p];
+    delete [] ax[p];
+  }
+  return same;
+}
+
+int main(int argc, char* argv[])
+{
+  // Load the mesh, the second mesh is refined differently.
+  Mesh mesh, mesh_2;
+  H2DReader mloader;
+  mloader.load("domain.mesh", &mesh);
+  for (int i = 0; i < INIT_REF_NUM; i++) mesh.refine_all_elements();
+  mesh_2.copy(&mesh);
+  mesh_2.refine_all_elements();
+  mesh_2.refine_towards_vertex(4, 2);
+
+  bool success = true;
+
+  // Linear system.
+  {
+    H1Space space_0(&mesh, bc_types, essential_bc_values, 3);
+    H1Space space_1(&mesh_2, bc_types, essential_bc_values, 2);
+
+    WeakForm wf(2);
+    wf.add_matrix_form(0, 0, callback(bilinear_form_0_0), HERMES_SYM);
+    wf.add_matrix_form(0, 1, callback(bilinear_form_0_1), HERMES_SYM);
+    wf.add_matrix_form(1, 0, callback(bilinear_form_1_0), HERMES_UNSYM);
+    wf.add_matrix_form(1, 1, callback(bilinear_form_1_1), HERMES_SYM);
+    wf.add_matrix_form_surf(1, 1, callback(bilinear_form_surf_1_1));
+    wf.add_vector_form(0, callback(linear_form_0));
+    // added to the second right-hand side
+    wf.add_vector_form(1, callback(linear_form_1), HERMES_ANY, Tuple<MeshFunction*>(), 1);
+    wf.add_vector_form_surf(1, callback(linear_form_surf_1));
+
+    DiscreteProblem dp(&wf, Tuple<Space*>(&space_0, &space_1), true);
+    if (!compare("linear", &dp, NULL, 2, false)) success = false;
+    if (!compare("linear, scatter maps", &dp, NULL, 2, true)) success = false;
+  }
+
+  // Nonlinear problem.
+  {
+    H1Space space(&mesh, bc_types, essential_bc_values, 4);
+
+    WeakForm wf;
+    wf.add_matrix_form(callback(jac), HERMES_UNSYM, HERMES_ANY);
+    wf.add_vector_form(callback(res), HERMES_ANY);
+
+    DiscreteProblem dp(&wf, &space, false);
+    int ndof = Space::get_num_dofs(&space);
+    scalar* coeff_vec = new scalar[ndof];
+    for (int i = 0; i < ndof; i++) coeff_vec[i] = 0.5 + 0.1 * sin((double) i);
+    if (!compare("nonlinear", &dp, coeff_vec, 1, false)) success = false;
+    delete [] coeff_vec;
+  }
+
+#define ERROR_SUCCESS                               0
+#define ERROR_FAILURE                               -1
+  if (success) {
+    printf("Success!\n");
+    return ERROR_SUCCESS;
+  }
+  else {
+    printf("Failure!\n");
+    return ERROR_FAILURE;
+  }
+}
@@ -0,0 +1,203 @@
+#define HERMES_REPORT_WARN
+#define HERMES_REPORT_INFO
+#define HERMES_REPORT_VERBOSE
+#define HERMES_REPORT_FILE "application.log"
+#include "hermes2d.h"
+
+//  This test makes sure that the symmetric storage of the matrix (only the upper triangle,
+//  DiscreteProblem::set_symmetric_storage()) of a problem with the HERMES_SYM forms only
+//  holds about half of the entries of the full storage, and that its product with a vector,
+//  its full CSC structure and the solution of the system are those of the full storage.
+//  The system of two equations lives on two different meshes with hanging nodes. With an
+//  unsymmetric form in the weak formulation (WeakForm::is_sym() is false) the full matrix
+//  has to be stored although the symmetric storage is asked for.
+
+const int INIT_REF_NUM = 2;                       // Number of initial uniform mesh refinements.
+const double TOLERANCE = 1e-12;                   // Tolerance for the relative differences.
+
+// Boundary condition types.
+BCType bc_types(int marker)
+{
+  return marker == 1 ? BC_ESSENTIAL : BC_NATURAL;
+}
+
+// Essential (Dirichlet) boundary condition values.
+scalar essential_bc_values(int marker, double x, double y)
+{
+  return 1.0 + x * y;
+}
+
+// Weak forms.
+template<typename Real, typename Scalar>
+Scalar bilinear_form_0_0(int n, double *wt, Func<Real> *u_ext[], Func<Real> *u, Func<Real> *v, Geom<Real> *e, ExtData<Scalar> *ext)
+{
+  return int_grad_u_grad_v<Real, Scalar>(n, wt, u, v) + int_u_v<Real, Scalar>(n, wt, u, v);
+}
+
+template<typename Real, typename Scalar>
+Scalar bilinear_form_0_1(int n, double *wt, Func<Real> *u_ext[], Func<Real> *u, Func<Real> *v, Geom<Real> *e, ExtData<Scalar> *ext)
+{
+  Scalar result = 0;
+  for (int i = 0; i < n; i++)
+    result += wt[i] * 0.5 * (1.0 + e->x[i]) * u->val[i] * v->val[i];
+  return result;
+}
+
+template<typename Real, typename Scalar>
+Scalar bilinear_form_1_1(int n, double *wt, Func<Real> *u_ext[], Func<Real> *u, Func<Real> *v, Geom<Real> *e, ExtData<Scalar> *ext)
+{
+  Scalar result = 0;
+  for (int i = 0; i < n; i++)
+    result += wt[i] * (2.0 * u->dx[i] * v->dx[i] + u->dy[i] * v->dy[i] + u->val[i] * v->val[i]);
+  return result;
+}
+
+template<typename Real, typename Scalar>
+Scalar linear_form(int n, double *wt, Func<Real> *u_ext[], Func<Real> *v, Geom<Real> *e, ExtData<Scalar> *ext)
+{
+  Scalar result = 0;
+  for (int i = 0; i < n; i++)
+    result += wt[i] * (e->x[i] + 2) * v->val[i];
+  return result;
+}
+
+// Number of the stored entries of the matrix.
+int get_nnz(UMFPackMatrix* mat)
+{
+  return (int) floor(mat->get_fill_in() * mat->get_size() * mat->get_size() + 0.5);
+}
+
+double max_diff(int n, scalar* x, scalar* y, double &norm)
+{
+  double diff = 0;
+  norm = 0;
+  for (int i = 0; i < n; i++)
+  {
+    diff = std::max(diff, std::abs(x[i] - y[i]));
+    norm = std::max(norm, std::abs(y[i]));
+  }
+  return diff;
+}
+
+// Assembles the problem and solves the system.
+void assemble_and_solve(WeakForm* wf, Tuple<Space*> spaces, bool sym_storage, UMFPackMatrix* mat, scalar* sln)
+{
+  DiscreteProblem dp(wf, spaces, true);
+  if (sym_storage) dp.set_symmetric_storage();
+  UMFPackVector rhs;
+  dp.assemble(mat, &rhs);
+  UMFPackLinearSolver solver(mat, &rhs);
+  if (!solver.solve()) error("Matrix solver failed.");
+  memcpy(sln, solver.get_solution(), mat->get_size() * sizeof(scalar));
+}
+
+// Compares the matrix and the solution with the full ones.
+bool compare(const char* what, UMFPackMatrix* mat, scalar* sln, UMFPackMatrix* mat_full, scalar* sln_full)
+{
+  int ndof = mat_full->get_size();
+  int *ap, *ai, *ap_full, *ai_full;
+  scalar *ax, *ax_full;
+  int nnz = mat->get_full_csc(ap, ai, ax);
+  int nnz_full = mat_full->get_full_csc(ap_full, ai_full, ax_full);
+  bool same = nnz == nnz_full && mat->get_size() == ndof
+              && !memcmp(ap, ap_full, (ndof + 1) * sizeof(int)) && !memcmp(ai, ai_full, nnz * sizeof(int));
+  if (same)
+  {
+    double norm, norm_y, norm_sln;
+    double diff = max_diff(nnz, ax, ax_full, norm);
+
+    // The product with a vector.
+    scalar* x = new scalar[ndof];
+    scalar* y = new scalar[ndof];
+    scalar* y_full = new scalar[ndof];
+    for (int i = 0; i < ndof; i++) x[i] = sin(1.0 + i);
+    mat->multiply(x, y);
+    mat_full->multiply(x, y_full);
+    double diff_y = max_diff(ndof, y, y_full, norm_y);
+    double diff_sln = max_diff(ndof, sln, sln_full, norm_sln);
+    delete [] x; delete [] y; delete [] y_full;
+
+    info("%s: stored entries %d of %d, relative difference: matrix %g, product %g, solution %g", what,
+         get_nnz(mat), get_nnz(mat_full), diff / norm, diff_y / norm_y, diff_sln / norm_sln);
+    if (diff > TOLERANCE * norm || diff_y > TOLERANCE * norm_y || diff_sln > TOLERANCE * norm_sln) same = false;
+  }
+  else
+    info("%s: the sparse structure differs from the full one", what);
+
+  delete [] ap; delete [] ai; delete [] ax;
+  delete [] ap_full; delete [] ai_full; delete [] ax_full;
+  return same;
+}
+
+int main(int argc, char* argv[])
+{
+  // Load the mesh, the second mesh is refined differently.
+  Mesh mesh, mesh_2;
+  H2DReader mloader;
+  mloader.load("domain.mesh", &mesh);
+  for (int i = 0; i < INIT_REF_NUM; i++) mesh.refine_all_elements();
+  mesh_2.copy(&mesh);
+  mesh_2.refine_all_elements();
+  mesh_2.refine_towards_vertex(2, 2);
+
+  // Create the spaces.
+  H1Space space_0(&mesh, bc_types, essential_bc_values, 4);
+  H1Space space_1(&mesh_2, bc_types, essential_bc_values, 3);
+  Tuple<Space*> spaces(&space_0, &space_1);
+  int ndof = Space::get_num_dofs(spaces);
+  info("ndof = %d", ndof);
+
+  // The symmetric weak formulation.
+  WeakForm wf(2);
+  wf.add_matrix_form(0, 0, callback(bilinear_form_0_0), HERMES_SYM);
+  wf.add_matrix_form(0, 1, callback(bilinear_form_0_1), HERMES_SYM);
+  wf.add_matrix_form(1, 1, callback(bilinear_form_1_1), HERMES_SYM);
+  wf.add_vector_form(0, callback(linear_form));
+  wf.add_vector_form(1, callback(linear_form));
+
+  // The same one with a form declared unsymmetric.
+  WeakForm wf_unsym(2);
+  wf_unsym.add_matrix_form(0, 0, callback(bilinear_form_0_0), HERMES_SYM);
+  wf_unsym.add_matrix_form(0, 1, callback(bilinear_form_0_1), HERMES_SYM);
+  wf_unsym.add_matrix_form(1, 1, callback(bilinear_form_1_1), HERMES_UNSYM);
+  wf_unsym.add_vector_form(0, callback(linear_form));
+  wf_unsym.add_vector_form(1, callback(linear_form));
+
+  bool success = true;
+  if (!wf.is_sym() || wf_unsym.is_sym()) success = false;
+
+  // The full storage.
+  UMFPackMatrix mat_full;
+  scalar* sln_full = new scalar[ndof];
+  assemble_and_solve(&wf, spaces, false, &mat_full, sln_full);
+  int nnz_full = get_nnz(&mat_full);
+
+  // The symmetric storage: the upper triangle with the diagonal.
+  UMFPackMatrix mat_sym;
+  scalar* sln_sym = new scalar[ndof];
+  assemble_and_solve(&wf, spaces, true, &mat_sym, sln_sym);
+  if (!mat_sym.is_symmetric_storage() || get_nnz(&mat_sym) != (nnz_full + ndof) / 2) success = false;
+  if (!compare("symmetric storage", &mat_sym, sln_sym, &mat_full, sln_full)) success = false;
+
+  // The fallback to the full storage.
+  UMFPackMatrix mat_unsym;
+  scalar* sln_unsym = new scalar[ndof];
+  assemble_and_solve(&wf_unsym, spaces, true, &mat_unsym, sln_unsym);
+  if (mat_unsym.is_symmetric_storage() || get_nnz(&mat_unsym) != nnz_full) success = false;
+  if (!compare("unsymmetric weak form", &mat_unsym, sln_unsym, &mat_full, sln_full)) success = false;
+
+  delete [] sln_full;
+  delete [] sln_sym;
+  delete [] sln_unsym;
+
+#define ERROR_SUCCESS                               0
+#define ERROR_FAILURE                               -1
+  if (success) {
+    printf("Success!\n");
+    return ERROR_SUCCESS;
+  }
+  else {
+    printf("Failure!\n");
+    return ERROR_FAILURE;
+  }
+}
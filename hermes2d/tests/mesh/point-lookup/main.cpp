@@ -0,0 +1,153 @@
+#define HERMES_REPORT_INFO
+#define HERMES_REPORT_FILE "application.log"
+#include "hermes2d.h"
+#include "element_index.h"
+
+//  This test makes sure that the physical points are found in the right elements by the
+//  bounding box hierarchy (ElementIndex) used by Solution::get_pt_value() and the batched
+//  Solution::get_pt_values(). Random points, some of them outside of the domain, are looked
+//  up on a mesh of triangles and quadrilaterals with curved edges (bulging out and in), and
+//  the values are compared with the ones in the elements found by a linear scan over all
+//  elements; the points outside have to give NAN (the warnings about them are not reported).
+//  After Mesh::refine_all_elements() the index of the old mesh must not be current any
+//  more, and the points are looked up again in the solution on the refined mesh.
+
+const int P_INIT = 3;                             // Polynomial degree of the elements.
+const int INIT_REF_NUM = 2;                       // Number of initial uniform mesh refinements.
+const int NUM_POINTS = 1000;                      // Number of the random points.
+const double TOLERANCE = 1e-10;                   // Tolerance for the difference of the values.
+
+// Boundary condition types.
+BCType bc_types(int marker)
+{
+  return BC_NATURAL;
+}
+
+// The reference domain test of Solution::get_pt_value().
+bool is_in_ref_domain(Element* e, double xi1, double xi2)
+{
+  const double TOL = 1e-11;
+  if (e->is_triangle())
+    return (xi1 + xi2 <= TOL) && (xi1 + 1.0 >= -TOL) && (xi2 + 1.0 >= -TOL);
+  else
+    return (xi1 - 1.0 <= TOL) && (xi1 + 1.0 >= -TOL) && (xi2 - 1.0 <= TOL) && (xi2 + 1.0 >= -TOL);
+}
+
+// Finds the element containing the point (x, y) by going through all active elements.
+Element* find_linear(Mesh* mesh, RefMap* refmap, double x, double y, double& xi1, double& xi2)
+{
+  Element* e;
+  for_all_active_elements(e, mesh)
+  {
+    refmap->set_active_element(e);
+    refmap->untransform(e, x, y, xi1, xi2);
+    if (is_in_ref_domain(e, xi1, xi2)) return e;
+  }
+  return NULL;
+}
+
+bool is_nan(scalar val)
+{
+  return std::abs(val) != std::abs(val);
+}
+
+// Sets the solution from a coefficient vector with random values.
+void set_random_solution(Space* space, Solution* sln)
+{
+  int ndof = Space::get_num_dofs(space);
+  scalar* coeffs = new scalar[ndof];
+  for (int i = 0; i < ndof; i++) coeffs[i] = rand() / (double) RAND_MAX - 0.5;
+  Solution::vector_to_solution(coeffs, space, sln);
+  delete [] coeffs;
+  info("ndof = %d, elements = %d", ndof, space->get_mesh()->get_num_active_elements());
+}
+
+// Looks up the points one by one and all at once, compares the values with the ones in the
+// elements found by the linear scan; the index of the mesh has to list these elements.
+bool check(Solution* sln, int n, double* x, double* y)
+{
+  Mesh* mesh = sln->get_mesh();
+  RefMap refmap;
+  ElementIndex index(mesh, &refmap);
+  std::vector<Element*> candidates;
+
+  scalar* val = new scalar[n];
+  sln->get_pt_values(n, x, y, H2D_FN_VAL_0, val);
+
+  int outside = 0, wrong = 0;
+  for (int i = 0; i < n; i++)
+  {
+    scalar single = sln->get_pt_value(x[i], y[i]);
+    double xi1, xi2;
+    Element* e = find_linear(mesh, &refmap, x[i], y[i], xi1, xi2);
+    if (e == NULL)
+    {
+      outside++;
+      if (!is_nan(single) || !is_nan(val[i])) wrong++;
+      continue;
+    }
+
+    candidates.clear();
+    index.find(x[i], y[i], candidates);
+    bool listed = std::find(candidates.begin(), candidates.end(), e) != candidates.end();
+
+    // the point may lie on an edge, the solution is continuous
+    scalar ref = sln->get_ref_value(e, xi1, xi2);
+    if (!listed || is_nan(single) || is_nan(val[i])
+        || std::abs(single - ref) > TOLERANCE * (1.0 + std::abs(ref))
+        || std::abs(val[i] - ref) > TOLERANCE * (1.0 + std::abs(ref)))
+      wrong++;
+  }
+  delete [] val;
+
+  info("%d points (%d outside of the domain), %d wrong", n, outside, wrong);
+  return wrong == 0 && outside > 0 && outside < n;
+}
+
+int main(int argc, char* argv[])
+{
+  // Load the mesh.
+  Mesh mesh;
+  H2DReader mloader;
+  mloader.load("domain.mesh", &mesh);
+  for (int i = 0; i < INIT_REF_NUM; i++) mesh.refine_all_elements();
+
+  // Create an H1 space with default shapeset, the solution has random coefficients.
+  H1Space space(&mesh, bc_types, NULL, P_INIT);
+  Solution sln;
+  srand(1);
+  set_random_solution(&space, &sln);
+
+  // Random points in a box around the domain (the curved edges bulge out by up to 0.14).
+  double x[NUM_POINTS], y[NUM_POINTS];
+  for (int i = 0; i < NUM_POINTS; i++)
+  {
+    x[i] = -0.3 + 2.6 * rand() / (double) RAND_MAX;
+    y[i] = -0.2 + 1.4 * rand() / (double) RAND_MAX;
+  }
+
+  bool success = check(&sln, NUM_POINTS, x, y);
+
+  // Refine the mesh, the index of the old mesh has to be rebuilt.
+  RefMap refmap;
+  ElementIndex index(&mesh, &refmap);
+  if (!index.is_current(&mesh)) success = false;
+  mesh.refine_all_elements();
+  if (index.is_current(&mesh)) success = false;
+
+  // Look up the points again in a solution on the refined mesh.
+  space.set_uniform_order(P_INIT);
+  set_random_solution(&space, &sln);
+  if (!check(&sln, NUM_POINTS, x, y)) success = false;
+
+#define ERROR_SUCCESS                               0
+#define ERROR_FAILURE                               -1
+  if (success) {
+    printf("Success!\n");
+    return ERROR_SUCCESS;
+  }
+  else {
+    printf("Failure!\n");
+    return ERROR_FAILURE;
+  }
+}
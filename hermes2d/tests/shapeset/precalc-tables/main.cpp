@@ -0,0 +1,251 @@
+#define HERMES_REPORT_WARN
+#define HERMES_REPORT_INFO
+#define HERMES_REPORT_VERBOSE
+#define HERMES_REPORT_FILE "application.log"
+#include "hermes2d.h"
+
+//  This test makes sure that the values precalculated by PrecalcShapeset are the values of
+//  Shapeset::get_value() at the integration points, for all shapes of the H1 and the Hcurl
+//  shapeset in both modes and all quadrature orders, including the edge points:
+//   - for the untransformed shapes, which use the directly indexed rows of the tables and the
+//     fast path of Function::set_quad_order() (the tables have to start at H2D_NODE_ALIGN byte
+//     boundaries and have to be found again by a slave PrecalcShapeset),
+//   - for the shapes on sub-elements up to three levels deep of a triangle and a quadrilateral,
+//     which use the Judy arrays,
+//   - for a PrecalcShapeset set up before its quadrature has tables (as the global ref_map_pss
+//     may be), which falls back to the Judy arrays and switches to the rows once they exist.
+
+const int NUM_TRANSFORMS = 20;                    // Number of the random sub-element paths.
+const double TOLERANCE = 1e-12;                   // Tolerance for the differences of the values.
+
+// Exposes which tables the active shape of the PrecalcShapeset uses.
+class PssTables : public PrecalcShapeset
+{
+public:
+  PssTables(Shapeset* shapeset) : PrecalcShapeset(shapeset) {}
+  bool uses_rows() const { return flat_nodes != NULL; }
+};
+
+// A copy of the standard quadrature whose tables are set up only by init().
+class DelayedQuad2D : public Quad2D
+{
+public:
+  DelayedQuad2D()
+  {
+    mode = 0;
+    tables = NULL;
+    np = NULL;
+    num_tables[0] = num_tables[1] = 0;
+  }
+
+  ~DelayedQuad2D()
+  {
+    if (tables == NULL) return;
+    for (int m = 0; m < 2; m++) { delete [] tables[m]; delete [] np[m]; }
+    delete [] tables;
+    delete [] np;
+  }
+
+  void init(Quad2D* quad)
+  {
+    tables = new double3**[2];
+    np = new int*[2];
+    for (int m = 0; m < 2; m++)
+    {
+      quad->set_mode(m);
+      num_tables[m] = quad->get_num_tables();
+      max_order[m] = quad->get_max_order();
+      safe_max_order[m] = quad->get_safe_max_order();
+      tables[m] = new double3*[num_tables[m]];
+      np[m] = new int[num_tables[m]];
+      for (int o = 0; o < num_tables[m]; o++)
+      {
+        np[m][o] = quad->get_num_points(o);
+        tables[m][o] = quad->get_points(o);
+      }
+      for (int i = 0; i < 4; i++)
+      {
+        ref_vert[m][i][0] = (*quad->get_ref_vertex(i))[0];
+        ref_vert[m][i][1] = (*quad->get_ref_vertex(i))[1];
+      }
+    }
+    max_edge_order = 0;
+  }
+
+  virtual void dummy_fn() {}
+};
+
+// Compares the values, dx and dy tables of the active shape at the given order with the
+// shapeset; 'ctm' maps the points to the sub-element.
+bool check_shape(PrecalcShapeset* pss, Quad2D* quad, int mode, int index, int order, Trf* ctm)
+{
+  Shapeset* shapeset = pss->get_shapeset();
+  quad->set_mode(mode);
+  int np = quad->get_num_points(order);
+  double3* pt = quad->get_points(order);
+  bool ok = true;
+  for (int c = 0; c < shapeset->get_num_components(); c++)
+  {
+    double* table[3] = { pss->get_fn_values(c), pss->get_dx_values(c), pss->get_dy_values(c) };
+    for (int k = 0; k < 3; k++)
+    {
+      if ((uintptr_t) table[k] % H2D_NODE_ALIGN) ok = false;
+      for (int i = 0; i < np; i++)
+      {
+        double value = shapeset->get_value(k, index, ctm->m[0] * pt[i][0] + ctm->t[0],
+                                           ctm->m[1] * pt[i][1] + ctm->t[1], c);
+        if (fabs(table[k][i] - value) > TOLERANCE * (1.0 + fabs(value))) ok = false;
+      }
+    }
+  }
+  return ok;
+}
+
+// Checks all shapes and orders of the untransformed PrecalcShapeset and a slave of it; the
+// tables are precalculated on the first pass and found again on the second one.
+bool test_untransformed(Shapeset* shapeset)
+{
+  PssTables pss(shapeset);
+  PrecalcShapeset slave(&pss);
+  bool ok = true;
+  int checked = 0;
+  for (int mode = 0; mode < 2; mode++)
+  {
+    pss.set_mode(mode);
+    slave.set_mode(mode);
+    int num_tables = g_quad_2d_std.get_num_tables();
+    for (int pass = 0; pass < 2; pass++)
+      for (int index = 0; index <= shapeset->get_max_index(); index++)
+      {
+        pss.set_active_shape(index);
+        if (!pss.uses_rows()) ok = false;
+        for (int order = 0; order < num_tables; order++)
+        {
+          if (g_quad_2d_std.get_num_points(order) == 0) continue;
+          pss.set_quad_order(order);
+          double* values = pss.get_fn_values();
+          if (!check_shape(&pss, &g_quad_2d_std, mode, index, order, pss.get_ctm())) ok = false;
+          slave.set_active_shape(index);
+          slave.set_quad_order(order);
+          if (slave.get_fn_values() != values) ok = false;
+          checked++;
+        }
+      }
+  }
+  info("untransformed shapes (shapeset %d): %d tables checked", shapeset->get_id(), checked);
+  return ok;
+}
+
+// Checks all shapes on random sub-elements of the elements of both modes, the untransformed
+// tables of the same shapes have to stay as they were.
+bool test_transformed(Shapeset* shapeset, Mesh* mesh)
+{
+  PssTables pss(shapeset);
+  bool ok = true;
+  int checked = 0;
+  Element* e;
+  for_all_active_elements(e, mesh)
+  {
+    int mode = e->get_mode();
+    pss.set_active_element(e);
+    int num_tables = g_quad_2d_std.get_num_tables();
+    for (int t = 0; t < NUM_TRANSFORMS; t++)
+    {
+      int depth = 1 + t % 3;
+      for (int level = 0; level < depth; level++)
+        pss.push_transform(rand() % (mode == H2D_MODE_TRIANGLE ? 4 : 8));
+      for (int index = 0; index <= shapeset->get_max_index(); index++)
+      {
+        pss.set_active_shape(index);
+        for (int order = t % 4; order < num_tables; order += 4)
+        {
+          if (g_quad_2d_std.get_num_points(order) == 0) continue;
+          pss.set_quad_order(order);
+          if (!check_shape(&pss, &g_quad_2d_std, mode, index, order, pss.get_ctm())) ok = false;
+          checked++;
+        }
+      }
+      pss.reset_transform();
+
+      // the untransformed tables
+      for (int index = t; index <= shapeset->get_max_index(); index += NUM_TRANSFORMS)
+      {
+        pss.set_active_shape(index);
+        pss.set_quad_order(t);
+        if (!pss.uses_rows() || !check_shape(&pss, &g_quad_2d_std, mode, index, t, pss.get_ctm())) ok = false;
+      }
+    }
+  }
+  info("transformed shapes (shapeset %d): %d tables checked", shapeset->get_id(), checked);
+  return ok;
+}
+
+// Checks a PrecalcShapeset whose quadrature has no tables when the shape is activated: the shape
+// has to use the Judy arrays then, and the rows when it is activated after the quadrature is
+// set up.
+bool test_fallback(Shapeset* shapeset)
+{
+  bool ok = true;
+  int checked = 0;
+  for (int mode = 0; mode < 2; mode++)
+    for (int index = 0; index <= shapeset->get_max_index(); index++)
+    {
+      DelayedQuad2D quad;
+      PssTables pss(shapeset);
+      pss.set_quad_2d(&quad);
+      pss.set_mode(mode);
+      pss.set_active_shape(index);
+      if (pss.uses_rows()) ok = false;
+
+      quad.init(&g_quad_2d_std);
+      for (int pass = 0; pass < 2; pass++)
+      {
+        pss.set_mode(mode);
+        if (pass == 1)
+        {
+          pss.set_active_shape(index);
+          if (!pss.uses_rows()) ok = false;
+        }
+        for (int order = index % 5; order < quad.get_num_tables(); order += 5)
+        {
+          if (quad.get_num_points(order) == 0) continue;
+          pss.set_quad_order(order);
+          if (!check_shape(&pss, &quad, mode, index, order, pss.get_ctm())) ok = false;
+          checked++;
+        }
+      }
+    }
+  info("fallback (shapeset %d): %d tables checked", shapeset->get_id(), checked);
+  return ok;
+}
+
+int main(int argc, char* argv[])
+{
+  // Load the mesh.
+  Mesh mesh;
+  H2DReader mloader;
+  mloader.load("domain.mesh", &mesh);
+
+  H1Shapeset h1_shapeset;
+  HcurlShapeset hcurl_shapeset;
+  Shapeset* shapesets[2] = { &h1_shapeset, &hcurl_shapeset };
+
+  bool success = true;
+  for (int i = 0; i < 2; i++)
+  {
+    if (!test_untransformed(shapesets[i])) success = false;
+    if (!test_transformed(shapesets[i], &mesh)) success = false;
+    if (!test_fallback(shapesets[i])) success = false;
+  }
+
+#define ERROR_SUCCESS                               0
+#define ERROR_FAILURE                               -1
+  if (success) {
+    printf("Success!\n");
+    return ERROR_SUCCESS;
+  }
+  else {
+    printf("Failure!\n");
+    return ERROR_FAILURE;
+  }
+}
@@ -0,0 +1,134 @@
+#define HERMES_REPORT_WARN
+#define HERMES_REPORT_INFO
+#define HERMES_REPORT_VERBOSE
+#define HERMES_REPORT_FILE "application.log"
+#include "hermes2d.h"
+
+//  This test makes sure that the native Krylov solvers (KrylovSolver, SOLVER_KRYLOV) solve
+//  the systems of a symmetric (-Laplace u + u = f) and of a nonsymmetric (-Laplace u +
+//  b . grad u = f) problem: every method has to converge and its solution has to agree
+//  with the one of UMFPack.
+
+const int P_INIT = 3;                             // Polynomial degree of the elements.
+const int INIT_REF_NUM = 3;                       // Number of initial uniform mesh refinements.
+const double KRYLOV_TOL = 1e-12;                  // Tolerance of the Krylov solvers (relative residual).
+const double TOLERANCE = 1e-8;                    // Tolerance for the difference of the solutions.
+
+// Boundary condition types.
+BCType bc_types(int marker)
+{
+  return BC_ESSENTIAL;
+}
+
+// Essential (Dirichlet) boundary condition values.
+scalar essential_bc_values(int marker, double x, double y)
+{
+  return x * y;
+}
+
+// Weak forms.
+template<typename Real, typename Scalar>
+Scalar bilinear_form_sym(int n, double *wt, Func<Real> *u_ext[], Func<Real> *u, Func<Real> *v, Geom<Real> *e, ExtData<Scalar> *ext)
+{
+  return int_grad_u_grad_v<Real, Scalar>(n, wt, u, v) + int_u_v<Real, Scalar>(n, wt, u, v);
+}
+
+template<typename Real, typename Scalar>
+Scalar bilinear_form_unsym(int n, double *wt, Func<Real> *u_ext[], Func<Real> *u, Func<Real> *v, Geom<Real> *e, ExtData<Scalar> *ext)
+{
+  Scalar result = 0;
+  for (int i = 0; i < n; i++)
+    result += wt[i] * (u->dx[i] * v->dx[i] + u->dy[i] * v->dy[i] + (10.0 * u->dx[i] + 5.0 * u->dy[i]) * v->val[i]);
+  return result;
+}
+
+template<typename Real, typename Scalar>
+Scalar linear_form(int n, double *wt, Func<Real> *u_ext[], Func<Real> *v, Geom<Real> *e, ExtData<Scalar> *ext)
+{
+  Scalar result = 0;
+  for (int i = 0; i < n; i++)
+    result += wt[i] * (1.0 + e->x[i] * e->y[i]) * v->val[i];
+  return result;
+}
+
+// Solves the assembled system by the Krylov method 'method', compares the solution with 'sln_ref'.
+bool solve_krylov(const char* method, UMFPackMatrix* matrix, UMFPackVector* rhs, scalar* sln_ref)
+{
+  KrylovSolver solver(matrix, rhs);
+  solver.set_solver(method);
+  solver.set_tolerance(KRYLOV_TOL);
+  solver.set_restart(50);
+  bool converged = solver.solve();
+
+  int ndof = matrix->get_size();
+  double diff = 0, norm = 0;
+  for (int i = 0; i < ndof; i++)
+  {
+    diff = std::max(diff, std::abs(solver.get_solution()[i] - sln_ref[i]));
+    norm = std::max(norm, std::abs(sln_ref[i]));
+  }
+  info("%s: %s after %d iterations, residual %g, difference from UMFPack %g", method,
+       converged ? "converged" : "did not converge", solver.get_num_iters(), solver.get_residual(), diff / norm);
+
+  return converged && solver.get_residual() <= KRYLOV_TOL && diff <= TOLERANCE * norm;
+}
+
+// Assembles the problem given by the weak form, solves it by UMFPack and by the Krylov methods.
+bool test(WeakForm* wf, Space* space, int num_methods, const char** methods)
+{
+  DiscreteProblem dp(wf, space, true);
+  UMFPackMatrix matrix;
+  UMFPackVector rhs;
+  dp.assemble(&matrix, &rhs);
+  info("ndof = %d", Space::get_num_dofs(space));
+
+  UMFPackLinearSolver umfpack(&matrix, &rhs);
+  if (!umfpack.solve()) return false;
+
+  bool success = true;
+  for (int i = 0; i < num_methods; i++)
+    if (!solve_krylov(methods[i], &matrix, &rhs, umfpack.get_solution())) success = false;
+  return success;
+}
+
+int main(int argc, char* argv[])
+{
+  // Load the mesh.
+  Mesh mesh;
+  H2DReader mloader;
+  mloader.load("domain.mesh", &mesh);
+
+  // Perform initial mesh refinements.
+  for (int i = 0; i < INIT_REF_NUM; i++) mesh.refine_all_elements();
+  mesh.refine_towards_vertex(2, 2);
+
+  // Create an H1 space with default shapeset.
+  H1Space space(&mesh, bc_types, essential_bc_values, P_INIT);
+
+  bool success = true;
+
+  // Symmetric problem.
+  WeakForm wf_sym;
+  wf_sym.add_matrix_form(callback(bilinear_form_sym), HERMES_SYM);
+  wf_sym.add_vector_form(callback(linear_form));
+  const char* methods_sym[] = { "cg", "gmres", "bicgstab" };
+  if (!test(&wf_sym, &space, 3, methods_sym)) success = false;
+
+  // Nonsymmetric problem.
+  WeakForm wf_unsym;
+  wf_unsym.add_matrix_form(callback(bilinear_form_unsym), HERMES_UNSYM);
+  wf_unsym.add_vector_form(callback(linear_form));
+  const char* methods_unsym[] = { "gmres", "bicgstab" };
+  if (!test(&wf_unsym, &space, 2, methods_unsym)) success = false;
+
+#define ERROR_SUCCESS                               0
+#define ERROR_FAILURE                               -1
+  if (success) {
+    printf("Success!\n");
+    return ERROR_SUCCESS;
+  }
+  else {
+    printf("Failure!\n");
+    return ERROR_FAILURE;
+  }
+}
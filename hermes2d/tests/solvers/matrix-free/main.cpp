@@ -0,0 +1,256 @@
+#define HERMES_REPORT_WARN
+#define HERMES_REPORT_INFO
+#define HERMES_REPORT_VERBOSE
+#define HERMES_REPORT_FILE "application.log"
+#include "hermes2d.h"
+
+//  This test makes sure that the matrix-free products of DiscreteProblem work. For a linear
+//  system of two equations (volume, surface and constant-coefficient forms) apply() has to give
+//  the product with the assembled matrix, before and after the matrix is created, and GMRES with
+//  DiscreteProblemOperator has to converge to the solution of UMFPack. For the nonlinear problem
+//  -div(lambda(u) grad u) = 1, lambda(u) = 1 + u^4, apply() has to give the product with the
+//  assembled Jacobian matrix, apply_fd() its finite-difference approximation, and one Newton step
+//  with both operators has to agree with the direct solve.
+
+const int INIT_REF_NUM = 2;                       // Number of initial uniform mesh refinements.
+const double TOLERANCE = 1e-13;                   // Tolerance for the relative difference of the products.
+const double TOLERANCE_FD = 1e-5;                 // The same for the finite-difference products.
+const double KRYLOV_TOL = 1e-12;                  // Tolerance of the Krylov solver (relative residual).
+const double TOLERANCE_SLN = 1e-7;                // Tolerance for the difference of the solutions.
+const double TOLERANCE_SLN_FD = 1e-5;             // The same with the finite-difference products.
+
+// Boundary condition types.
+BCType bc_types(int marker)
+{
+  return marker == 1 ? BC_ESSENTIAL : BC_NATURAL;
+}
+
+// Essential (Dirichlet) boundary condition values.
+scalar essential_bc_values(int marker, double x, double y)
+{
+  return 1.0 + x * y;
+}
+
+// Weak forms of the linear problem.
+template<typename Real, typename Scalar>
+Scalar bilinear_form_0_0(int n, double *wt, Func<Real> *u_ext[], Func<Real> *u, Func<Real> *v, Geom<Real> *e, ExtData<Scalar> *ext)
+{
+  Scalar result = 0;
+  for (int i = 0; i < n; i++)
+    result += wt[i] * (u->dx[i] * v->dx[i] + u->dy[i] * v->dy[i] + (1 + e->x[i] * e->x[i]) * u->val[i] * v->val[i]);
+  return result;
+}
+
+template<typename Real, typename Scalar>
+Scalar bilinear_form_0_1(int n, double *wt, Func<Real> *u_ext[], Func<Real> *u, Func<Real> *v, Geom<Real> *e, ExtData<Scalar> *ext)
+{
+  Scalar result = 0;
+  for (int i = 0; i < n; i++)
+    result += wt[i] * (u->dy[i] * v->dx[i] + 0.5 * u->dx[i] * v->dy[i]);
+  return result;
+}
+
+template<typename Real, typename Scalar>
+Scalar bilinear_form_1_1(int n, double *wt, Func<Real> *u_ext[], Func<Real> *u, Func<Real> *v, Geom<Real> *e, ExtData<Scalar> *ext)
+{
+  return int_grad_u_grad_v<Real, Scalar>(n, wt, u, v);
+}
+
+template<typename Real, typename Scalar>
+Scalar bilinear_form_surf(int n, double *wt, Func<Real> *u_ext[], Func<Real> *u, Func<Real> *v, Geom<Real> *e, ExtData<Scalar> *ext)
+{
+  Scalar result = 0;
+  for (int i = 0; i < n; i++)
+    result += wt[i] * (2 + e->y[i]) * u->val[i] * v->val[i];
+  return result;
+}
+
+template<typename Real, typename Scalar>
+Scalar linear_form(int n, double *wt, Func<Real> *u_ext[], Func<Real> *v, Geom<Real> *e, ExtData<Scalar> *ext)
+{
+  Scalar result = 0;
+  for (int i = 0; i < n; i++)
+    result += wt[i] * (e->x[i] + 2) * v->val[i];
+  return result;
+}
+
+// Thermal conductivity of the nonlinear problem and its derivative.
+template<typename Real>
+Real lam(Real u)
+{
+  return 1 + pow(u, 4);
+}
+
+template<typename Real>
+Real dlam_du(Real u)
+{
+  return 4 * pow(u, 3);
+}
+
+// Jacobian matrix and residual vector of the nonlinear problem.
+template<typename Real, typename Scalar>
+Scalar jac(int n, double *wt, Func<Real> *u_ext[], Func<Real> *u, Func<Real> *v, Geom<Real> *e, ExtData<Scalar> *ext)
+{
+  Scalar result = 0;
+  Func<Scalar>* u_prev = u_ext[0];
+  for (int i = 0; i < n; i++)
+    result += wt[i] * (dlam_du(u_prev->val[i]) * u->val[i] * (u_prev->dx[i] * v->dx[i] + u_prev->dy[i] * v->dy[i])
+                       + lam(u_prev->val[i]) * (u->dx[i] * v->dx[i] + u->dy[i] * v->dy[i]));
+  return result;
+}
+
+template<typename Real, typename Scalar>
+Scalar res(int n, double *wt, Func<Real> *u_ext[], Func<Real> *v, Geom<Real> *e, ExtData<Scalar> *ext)
+{
+  Scalar result = 0;
+  Func<Scalar>* u_prev = u_ext[0];
+  for (int i = 0; i < n; i++)
+    result += wt[i] * (lam(u_prev->val[i]) * (u_prev->dx[i] * v->dx[i] + u_prev->dy[i] * v->dy[i]) - v->val[i]);
+  return result;
+}
+
+// Relative difference of the arrays.
+double rel_diff(scalar* a, scalar* b, int n)
+{
+  double diff = 0, norm = 0;
+  for (int i = 0; i < n; i++)
+  {
+    diff = std::max(diff, std::abs(a[i] - b[i]));
+    norm = std::max(norm, std::abs(b[i]));
+  }
+  return diff / norm;
+}
+
+// Solves the system with the operator by GMRES, compares the solution with 'sln_ref'.
+bool solve_gmres(const char* what, MatrixFreeOperator* op, Vector* rhs, scalar* sln_ref, double tol)
+{
+  KrylovSolver solver(op, rhs);
+  solver.set_solver("gmres");
+  solver.set_tolerance(KRYLOV_TOL);
+  solver.set_max_iters(5000);
+  solver.set_restart(200);
+  bool converged = solver.solve();
+  double diff = rel_diff(solver.get_solution(), sln_ref, op->get_size());
+  info("%s: %s after %d iterations, residual %g, difference from UMFPack %g", what,
+       converged ? "converged" : "did not converge", solver.get_num_iters(), solver.get_residual(), diff);
+  return converged && diff < tol;
+}
+
+int main(int argc, char* argv[])
+{
+  // Load the mesh.
+  Mesh mesh;
+  H2DReader mloader;
+  mloader.load("domain.mesh", &mesh);
+  for (int i = 0; i < INIT_REF_NUM; i++) mesh.refine_all_elements();
+
+  // Create the spaces.
+  H1Space space_0(&mesh, bc_types, essential_bc_values, 3);
+  H1Space space_1(&mesh, bc_types, essential_bc_values, 2);
+  Tuple<Space*> spaces(&space_0, &space_1);
+
+  bool success = true;
+
+  // Linear problem.
+  {
+    WeakForm wf(2);
+    wf.add_matrix_form(0, 0, callback(bilinear_form_0_0), HERMES_SYM);
+    wf.add_matrix_form(0, 1, callback(bilinear_form_0_1), HERMES_SYM);
+    wf.add_matrix_form_const(1, 1, callback(bilinear_form_1_1), HERMES_SYM);
+    wf.add_matrix_form_surf(0, 0, callback(bilinear_form_surf), 2);
+    wf.add_vector_form(0, callback(linear_form));
+    DiscreteProblem dp(&wf, spaces, true);
+
+    int ndof = dp.get_num_dofs();
+    scalar* x = new scalar[ndof];
+    scalar* y = new scalar[ndof];
+    scalar* y_ref = new scalar[ndof];
+    for (int i = 0; i < ndof; i++) x[i] = 1.0 + (i * 7919 % 1000) / 1000.0;
+
+    // Before and after the matrix is created.
+    dp.apply(NULL, x, y);
+    UMFPackMatrix matrix;
+    UMFPackVector rhs;
+    dp.assemble(&matrix, &rhs);
+    matrix.multiply(x, y_ref);
+    double diff_before = rel_diff(y, y_ref, ndof);
+    dp.apply(NULL, x, y);
+    double diff_after = rel_diff(y, y_ref, ndof);
+    info("linear: ndof = %d, relative difference of the products: %g (no matrix), %g (matrix created)",
+         ndof, diff_before, diff_after);
+    if (diff_before > TOLERANCE || diff_after > TOLERANCE) success = false;
+
+    // Matrix-free solve.
+    UMFPackLinearSolver umfpack(&matrix, &rhs);
+    if (!umfpack.solve()) error("UMFPack failed.");
+    DiscreteProblemOperator op(&dp);
+    if (!solve_gmres("linear, matrix-free gmres", &op, &rhs, umfpack.get_solution(), TOLERANCE_SLN)) success = false;
+
+    delete [] x;
+    delete [] y;
+    delete [] y_ref;
+  }
+
+  // Nonlinear problem.
+  {
+    WeakForm wf;
+    wf.add_matrix_form(callback(jac), HERMES_UNSYM, HERMES_ANY);
+    wf.add_vector_form(callback(res), HERMES_ANY);
+    DiscreteProblem dp(&wf, &space_0, false);
+
+    int ndof = dp.get_num_dofs();
+    scalar* coeff_vec = new scalar[ndof];
+    scalar* x = new scalar[ndof];
+    scalar* y = new scalar[ndof];
+    scalar* y_ref = new scalar[ndof];
+    scalar* f = new scalar[ndof];
+    for (int i = 0; i < ndof; i++)
+    {
+      coeff_vec[i] = 0.5 + 0.3 * sin(i * 0.37);
+      x[i] = cos(i * 0.11);
+    }
+
+    // Products with the Jacobian matrix at 'coeff_vec'.
+    UMFPackMatrix jacobian;
+    UMFPackVector residual;
+    dp.assemble(coeff_vec, &jacobian, &residual);
+    jacobian.multiply(x, y_ref);
+    dp.apply(coeff_vec, x, y);
+    double diff = rel_diff(y, y_ref, ndof);
+    dp.apply_fd(coeff_vec, x, y);
+    double diff_fd = rel_diff(y, y_ref, ndof);
+    dp.assemble_residual(coeff_vec, f);
+    residual.extract(y);
+    double diff_res = rel_diff(f, y, ndof);
+    info("nonlinear: ndof = %d, relative difference of the products: %g, finite differences %g, residual %g",
+         ndof, diff, diff_fd, diff_res);
+    if (diff > TOLERANCE || diff_fd > TOLERANCE_FD || diff_res > TOLERANCE) success = false;
+
+    // One Newton step.
+    UMFPackVector minus_residual(ndof);
+    for (int i = 0; i < ndof; i++) minus_residual.set(i, -residual.get(i));
+    UMFPackLinearSolver umfpack(&jacobian, &minus_residual);
+    if (!umfpack.solve()) error("UMFPack failed.");
+    DiscreteProblemOperator op(&dp, coeff_vec);
+    if (!solve_gmres("Newton step, matrix-free gmres", &op, &minus_residual, umfpack.get_solution(), TOLERANCE_SLN)) success = false;
+    DiscreteProblemOperator op_fd(&dp, coeff_vec, true);
+    if (!solve_gmres("Newton step, finite-difference gmres", &op_fd, &minus_residual, umfpack.get_solution(), TOLERANCE_SLN_FD)) success = false;
+
+    delete [] coeff_vec;
+    delete [] x;
+    delete [] y;
+    delete [] y_ref;
+    delete [] f;
+  }
+
+#define ERROR_SUCCESS                               0
+#define ERROR_FAILURE                               -1
+  if (success) {
+    printf("Success!\n");
+    return ERROR_SUCCESS;
+  }
+  else {
+    printf("Failure!\n");
+    return ERROR_FAILURE;
+  }
+}
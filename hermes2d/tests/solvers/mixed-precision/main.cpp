@@ -0,0 +1,218 @@
+#define HERMES_REPORT_WARN
+#define HERMES_REPORT_INFO
+#define HERMES_REPORT_VERBOSE
+#define HERMES_REPORT_FILE "application.log"
+#include "hermes2d.h"
+
+//  This test makes sure that the mixed precision solver (MixedPrecisionSolver) recovers the
+//  double precision accuracy by the iterative refinement: the system of a well-conditioned
+//  Poisson problem has to reach the residual tolerance in a few steps, the system of a
+//  problem with a jumping coefficient (condition number about 1e6, estimated in the test)
+//  has to converge as well, and the solutions have to agree with the ones of UMFPack. The
+//  solutions of solve_multiple() have to be the ones of separate solve() calls.
+
+const int P_INIT = 2;                             // Polynomial degree of the elements.
+const int INIT_REF_NUM = 3;                       // Number of initial uniform mesh refinements.
+const double KAPPA = 1e4;                         // Diffusion coefficient in the right part of the domain.
+const double MP_TOL = 1e-12;                      // Tolerance of the refinement (relative residual).
+const int MAX_STEPS_WELL = 5;                     // Allowed refinement steps of the well-conditioned problem.
+const int MAX_STEPS_ILL = 20;                      // Allowed refinement steps of the ill-conditioned problem.
+const double MAX_RESIDUAL_ILL = 1e-9;             // Allowed residual of the ill-conditioned problem.
+const double TOLERANCE = 1e-9;                    // Tolerance for the difference from UMFPack.
+
+// Boundary condition types.
+BCType bc_types(int marker)
+{
+  return BC_ESSENTIAL;
+}
+
+// Essential (Dirichlet) boundary condition values.
+scalar essential_bc_values(int marker, double x, double y)
+{
+  return x * y;
+}
+
+// Weak forms.
+template<typename Real, typename Scalar>
+Scalar bilinear_form_poisson(int n, double *wt, Func<Real> *u_ext[], Func<Real> *u, Func<Real> *v, Geom<Real> *e, ExtData<Scalar> *ext)
+{
+  return int_grad_u_grad_v<Real, Scalar>(n, wt, u, v);
+}
+
+// Diffusion coefficient (constant for the integration order).
+double kappa(double x) { return x > 1.0 ? KAPPA : 1.0; }
+Ord kappa(Ord x) { return Ord(0); }
+
+template<typename Real, typename Scalar>
+Scalar bilinear_form_jump(int n, double *wt, Func<Real> *u_ext[], Func<Real> *u, Func<Real> *v, Geom<Real> *e, ExtData<Scalar> *ext)
+{
+  Scalar result = 0;
+  for (int i = 0; i < n; i++)
+    result += wt[i] * kappa(e->x[i]) * (u->dx[i] * v->dx[i] + u->dy[i] * v->dy[i]);
+  return result;
+}
+
+template<typename Real, typename Scalar>
+Scalar linear_form(int n, double *wt, Func<Real> *u_ext[], Func<Real> *v, Geom<Real> *e, ExtData<Scalar> *ext)
+{
+  Scalar result = 0;
+  for (int i = 0; i < n; i++)
+    result += wt[i] * (1.0 + e->x[i] * e->y[i]) * v->val[i];
+  return result;
+}
+
+template<typename Real, typename Scalar>
+Scalar linear_form_2(int n, double *wt, Func<Real> *u_ext[], Func<Real> *v, Geom<Real> *e, ExtData<Scalar> *ext)
+{
+  Scalar result = 0;
+  for (int i = 0; i < n; i++)
+    result += wt[i] * sin(3.0 * e->x[i]) * v->val[i];
+  return result;
+}
+
+double norm2(int n, scalar* x)
+{
+  double sum = 0;
+  for (int i = 0; i < n; i++) sum += std::abs(x[i]) * std::abs(x[i]);
+  return sqrt(sum);
+}
+
+// Estimates the condition number of a symmetric positive definite matrix: the largest
+// eigenvalue by the power iteration, the smallest one by the inverse iteration.
+double estimate_cond(UMFPackMatrix* matrix)
+{
+  int ndof = matrix->get_size();
+  scalar* x = new scalar[ndof];
+  scalar* y = new scalar[ndof];
+  UMFPackVector rhs;
+  rhs.alloc(ndof);
+  Solver* solver = new UMFPackLinearSolver(matrix, &rhs);
+
+  double lambda_max = 0, lambda_min = 0;
+  for (int pass = 0; pass < 2; pass++)
+  {
+    for (int i = 0; i < ndof; i++) x[i] = 1.0 + 0.5 * sin(1.0 + i);
+    double lambda = 0;
+    for (int it = 0; it < 200; it++)
+    {
+      double nrm = norm2(ndof, x);
+      for (int i = 0; i < ndof; i++) x[i] /= nrm;
+      if (pass == 0) matrix->multiply(x, y);
+      else
+      {
+        for (int i = 0; i < ndof; i++) rhs.set(i, x[i]);
+        solver->solve();
+        solver->set_factorization_scheme(HERMES_REUSE_FACTORIZATION_COMPLETELY);
+        memcpy(y, solver->get_solution(), ndof * sizeof(scalar));
+      }
+      lambda = norm2(ndof, y);
+      memcpy(x, y, ndof * sizeof(scalar));
+    }
+    if (pass == 0) lambda_max = lambda;
+    else lambda_min = 1.0 / lambda;
+  }
+
+  delete solver;
+  delete [] x;
+  delete [] y;
+  return lambda_max / lambda_min;
+}
+
+// Solves the system by UMFPack and by the mixed precision solver, compares the solutions.
+// The refinement of an ill-conditioned system may also stop on the backward error test
+// (the accuracy of a double precision factorization), with the residual above MP_TOL.
+bool solve(const char* what, UMFPackMatrix* matrix, UMFPackVector* rhs, int max_steps, double max_residual)
+{
+  UMFPackLinearSolver umfpack(matrix, rhs);
+  if (!umfpack.solve()) return false;
+
+  MixedPrecisionSolver solver(matrix, rhs);
+  solver.set_tolerance(MP_TOL);
+  bool converged = solver.solve();
+
+  int ndof = matrix->get_size();
+  double diff = 0, norm = 0;
+  for (int i = 0; i < ndof; i++)
+  {
+    diff = std::max(diff, std::abs(solver.get_solution()[i] - umfpack.get_solution()[i]));
+    norm = std::max(norm, std::abs(umfpack.get_solution()[i]));
+  }
+  info("%s: %s after %d refinement steps, residual %g, difference from UMFPack %g", what,
+       converged ? "converged" : "did not converge", solver.get_num_refinements(), solver.get_residual(), diff / norm);
+
+  return converged && solver.get_num_refinements() <= max_steps && solver.get_residual() <= max_residual
+         && diff <= TOLERANCE * norm;
+}
+
+int main(int argc, char* argv[])
+{
+  // Load the mesh.
+  Mesh mesh;
+  H2DReader mloader;
+  mloader.load("domain.mesh", &mesh);
+
+  // Perform initial mesh refinements.
+  for (int i = 0; i < INIT_REF_NUM; i++) mesh.refine_all_elements();
+
+  // Create an H1 space with default shapeset.
+  H1Space space(&mesh, bc_types, essential_bc_values, P_INIT);
+  info("ndof = %d", Space::get_num_dofs(&space));
+
+  bool success = true;
+
+  // Well-conditioned Poisson problem.
+  {
+    WeakForm wf;
+    wf.add_matrix_form(callback(bilinear_form_poisson), HERMES_SYM);
+    wf.add_vector_form(callback(linear_form));
+    DiscreteProblem dp(&wf, &space, true);
+    UMFPackMatrix matrix;
+    UMFPackVector rhs;
+    dp.assemble(&matrix, &rhs);
+    info("Poisson: condition number %g", estimate_cond(&matrix));
+    if (!solve("Poisson", &matrix, &rhs, MAX_STEPS_WELL, MP_TOL)) success = false;
+  }
+
+  // Ill-conditioned problem with the jumping coefficient, and two right-hand sides.
+  {
+    WeakForm wf;
+    wf.add_matrix_form(callback(bilinear_form_jump), HERMES_SYM);
+    wf.add_vector_form(callback(linear_form));
+    wf.add_vector_form(callback(linear_form_2), HERMES_ANY, Tuple<MeshFunction*>(), 1);
+    DiscreteProblem dp(&wf, &space, true);
+    UMFPackMatrix matrix;
+    UMFPackVector rhs_0, rhs_1;
+    Vector* rhs[2] = { &rhs_0, &rhs_1 };
+    dp.assemble(NULL, &matrix, rhs, 2);
+    double cond = estimate_cond(&matrix);
+    info("Jumping coefficient: condition number %g", cond);
+    if (cond < 1e5 || cond > 1e7) success = false;
+    if (!solve("Jumping coefficient", &matrix, &rhs_0, MAX_STEPS_ILL, MAX_RESIDUAL_ILL)) success = false;
+
+    // solve_multiple() against separate solve() calls.
+    int ndof = matrix.get_size();
+    MixedPrecisionSolver multiple(&matrix, &rhs_0);
+    multiple.set_tolerance(MP_TOL);
+    bool ok = multiple.solve_multiple(2, rhs);
+    for (int k = 0; k < 2; k++)
+    {
+      MixedPrecisionSolver single(&matrix, (UMFPackVector*) rhs[k]);
+      single.set_tolerance(MP_TOL);
+      if (!single.solve()) ok = false;
+      if (memcmp(single.get_solution(), multiple.get_solution(k), ndof * sizeof(scalar))) ok = false;
+    }
+    info("solve_multiple(): %s", ok ? "the same solutions as solve()" : "different solutions");
+    if (!ok) success = false;
+  }
+
+#define ERROR_SUCCESS                               0
+#define ERROR_FAILURE                               -1
+  if (success) {
+    printf("Success!\n");
+    return ERROR_SUCCESS;
+  }
+  else {
+    printf("Failure!\n");
+    return ERROR_FAILURE;
+  }
+}
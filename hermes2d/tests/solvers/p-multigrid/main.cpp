@@ -0,0 +1,146 @@
+#define HERMES_REPORT_WARN
+#define HERMES_REPORT_INFO
+#define HERMES_REPORT_VERBOSE
+#define HERMES_REPORT_FILE "application.log"
+#include "hermes2d.h"
+
+//  This test makes sure that the p-multigrid preconditioner works: the levels are built by
+//  DiscreteProblem::get_p_levels() for the orders 3, 2 and 1 of the space of order 4, CG with
+//  the preconditioner has to converge to the solution of UMFPack in fewer iterations than
+//  with SSOR (the smoother of the multigrid), and solving the system again (with the coarsest
+//  level factorized already) has to give the same result.
+
+const int P_INIT = 4;                             // Polynomial degree of the elements.
+const int INIT_REF_NUM = 3;                       // Number of initial uniform mesh refinements.
+const int NUM_LEVELS = 3;                         // Number of the coarse levels of the multigrid.
+const double KRYLOV_TOL = 1e-12;                  // Tolerance of the Krylov solver (relative residual).
+const double TOLERANCE = 1e-8;                    // Tolerance for the difference of the solutions.
+
+// Boundary condition types.
+BCType bc_types(int marker)
+{
+  return BC_ESSENTIAL;
+}
+
+// Essential (Dirichlet) boundary condition values.
+scalar essential_bc_values(int marker, double x, double y)
+{
+  return x * y;
+}
+
+// Weak forms.
+template<typename Real, typename Scalar>
+Scalar bilinear_form(int n, double *wt, Func<Real> *u_ext[], Func<Real> *u, Func<Real> *v, Geom<Real> *e, ExtData<Scalar> *ext)
+{
+  return int_grad_u_grad_v<Real, Scalar>(n, wt, u, v) + int_u_v<Real, Scalar>(n, wt, u, v);
+}
+
+template<typename Real, typename Scalar>
+Scalar linear_form(int n, double *wt, Func<Real> *u_ext[], Func<Real> *v, Geom<Real> *e, ExtData<Scalar> *ext)
+{
+  Scalar result = 0;
+  for (int i = 0; i < n; i++)
+    result += wt[i] * (1.0 + e->x[i] * e->y[i]) * v->val[i];
+  return result;
+}
+
+// Solves the system by 'solver' (CG with a preconditioner), compares the solution with 'sln_ref'.
+// Returns the number of iterations, -1 on failure.
+int solve_cg(KrylovSolver* solver, const char* pc_name, int ndof, scalar* sln_ref)
+{
+  bool converged = solver->solve();
+
+  double diff = 0, norm = 0;
+  for (int i = 0; i < ndof; i++)
+  {
+    diff = std::max(diff, std::abs(solver->get_solution()[i] - sln_ref[i]));
+    norm = std::max(norm, std::abs(sln_ref[i]));
+  }
+  info("cg, %s: %s after %d iterations, residual %g, difference from UMFPack %g", pc_name,
+       converged ? "converged" : "did not converge", solver->get_num_iters(), solver->get_residual(), diff / norm);
+
+  if (!converged || solver->get_residual() > KRYLOV_TOL || diff > TOLERANCE * norm) return -1;
+  return solver->get_num_iters();
+}
+
+// Passes the preconditioner to the solver.
+void set_precond(KrylovSolver* solver, NativePrecond* pc)
+{
+#ifdef HAVE_TEUCHOS
+  Teuchos::RCP<Precond> rcp_pc = Teuchos::rcp(pc, false);
+  solver->set_precond(rcp_pc);
+#else
+  solver->set_precond(pc);
+#endif
+}
+
+int main(int argc, char* argv[])
+{
+  // Load the mesh.
+  Mesh mesh;
+  H2DReader mloader;
+  mloader.load("domain.mesh", &mesh);
+
+  // Perform initial mesh refinements.
+  for (int i = 0; i < INIT_REF_NUM; i++) mesh.refine_all_elements();
+  mesh.refine_towards_vertex(2, 2);
+
+  // Create an H1 space with default shapeset.
+  H1Space space(&mesh, bc_types, essential_bc_values, P_INIT);
+  int ndof = Space::get_num_dofs(&space);
+  info("ndof = %d", ndof);
+
+  // Initialize the weak formulation.
+  WeakForm wf;
+  wf.add_matrix_form(callback(bilinear_form), HERMES_SYM);
+  wf.add_vector_form(callback(linear_form));
+
+  // Initialize the FE problem and assemble the system.
+  DiscreteProblem dp(&wf, &space, true);
+  UMFPackMatrix matrix;
+  UMFPackVector rhs;
+  dp.assemble(&matrix, &rhs);
+
+  // Reference solution.
+  UMFPackLinearSolver umfpack(&matrix, &rhs);
+  if (!umfpack.solve()) error("UMFPack failed.");
+  scalar* sln_ref = umfpack.get_solution();
+
+  bool success = true;
+
+  // CG with SSOR.
+  SSORPrecond ssor;
+  KrylovSolver solver_ssor(&matrix, &rhs);
+  solver_ssor.set_solver("cg");
+  solver_ssor.set_tolerance(KRYLOV_TOL);
+  set_precond(&solver_ssor, &ssor);
+  int it_ssor = solve_cg(&solver_ssor, "SSOR", ndof, sln_ref);
+  if (it_ssor < 0) success = false;
+
+  // CG with the p-multigrid.
+  PMultigridPrecond pmg;
+  dp.get_p_levels(&pmg, NUM_LEVELS);
+  info("p-multigrid levels: %d", pmg.get_num_levels());
+  if (pmg.get_num_levels() != NUM_LEVELS + 1) success = false;
+
+  KrylovSolver solver_pmg(&matrix, &rhs);
+  solver_pmg.set_solver("cg");
+  solver_pmg.set_tolerance(KRYLOV_TOL);
+  set_precond(&solver_pmg, &pmg);
+  int it_pmg = solve_cg(&solver_pmg, "p-multigrid", ndof, sln_ref);
+  if (it_pmg < 0 || it_pmg >= it_ssor) success = false;
+
+  // Solve again, the factorization of the coarsest level is reused.
+  if (solve_cg(&solver_pmg, "p-multigrid again", ndof, sln_ref) != it_pmg) success = false;
+
+#define ERROR_SUCCESS                               0
+#define ERROR_FAILURE                               -1
+  if (success) {
+    printf("Success!\n");
+    return ERROR_SUCCESS;
+  }
+  else {
+    printf("Failure!\n");
+    return ERROR_FAILURE;
+  }
+}
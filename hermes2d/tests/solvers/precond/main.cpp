@@ -0,0 +1,176 @@
+#define HERMES_REPORT_WARN
+#define HERMES_REPORT_INFO
+#define HERMES_REPORT_VERBOSE
+#define HERMES_REPORT_FILE "application.log"
+#include "hermes2d.h"
+
+//  This test makes sure that the native preconditioners (Jacobi, block Jacobi, ILU(0), SSOR)
+//  work with the Krylov solvers: the preconditioned methods have to converge to the solution
+//  of UMFPack, ILU(0), SSOR and the block Jacobi preconditioner with the element blocks have
+//  to need fewer iterations than the unpreconditioned CG, and the block Jacobi preconditioner
+//  with a single block of all DOFs (the exact inverse) has to give the solution at once.
+
+const int P_INIT = 3;                             // Polynomial degree of the elements.
+const int INIT_REF_NUM = 3;                       // Number of initial uniform mesh refinements.
+const double KRYLOV_TOL = 1e-12;                  // Tolerance of the Krylov solvers (relative residual).
+const double TOLERANCE = 1e-8;                    // Tolerance for the difference of the solutions.
+
+// Boundary condition types.
+BCType bc_types(int marker)
+{
+  return BC_ESSENTIAL;
+}
+
+// Essential (Dirichlet) boundary condition values.
+scalar essential_bc_values(int marker, double x, double y)
+{
+  return x * y;
+}
+
+// Weak forms.
+template<typename Real, typename Scalar>
+Scalar bilinear_form_sym(int n, double *wt, Func<Real> *u_ext[], Func<Real> *u, Func<Real> *v, Geom<Real> *e, ExtData<Scalar> *ext)
+{
+  return int_grad_u_grad_v<Real, Scalar>(n, wt, u, v) + int_u_v<Real, Scalar>(n, wt, u, v);
+}
+
+template<typename Real, typename Scalar>
+Scalar bilinear_form_unsym(int n, double *wt, Func<Real> *u_ext[], Func<Real> *u, Func<Real> *v, Geom<Real> *e, ExtData<Scalar> *ext)
+{
+  Scalar result = 0;
+  for (int i = 0; i < n; i++)
+    result += wt[i] * (u->dx[i] * v->dx[i] + u->dy[i] * v->dy[i] + (10.0 * u->dx[i] + 5.0 * u->dy[i]) * v->val[i]);
+  return result;
+}
+
+template<typename Real, typename Scalar>
+Scalar linear_form(int n, double *wt, Func<Real> *u_ext[], Func<Real> *v, Geom<Real> *e, ExtData<Scalar> *ext)
+{
+  Scalar result = 0;
+  for (int i = 0; i < n; i++)
+    result += wt[i] * (1.0 + e->x[i] * e->y[i]) * v->val[i];
+  return result;
+}
+
+// Solves the system by the Krylov method 'method' with the preconditioner 'pc' (none if NULL),
+// compares the solution with 'sln_ref'. Returns the number of iterations, -1 on failure.
+int solve_krylov(const char* method, NativePrecond* pc, const char* pc_name,
+                 UMFPackMatrix* matrix, UMFPackVector* rhs, scalar* sln_ref)
+{
+  KrylovSolver solver(matrix, rhs);
+  solver.set_solver(method);
+  solver.set_tolerance(KRYLOV_TOL);
+  solver.set_restart(50);
+  if (pc != NULL)
+  {
+#ifdef HAVE_TEUCHOS
+    Teuchos::RCP<Precond> rcp_pc = Teuchos::rcp(pc, false);
+    solver.set_precond(rcp_pc);
+#else
+    solver.set_precond(pc);
+#endif
+  }
+  bool converged = solver.solve();
+
+  int ndof = matrix->get_size();
+  double diff = 0, norm = 0;
+  for (int i = 0; i < ndof; i++)
+  {
+    diff = std::max(diff, std::abs(solver.get_solution()[i] - sln_ref[i]));
+    norm = std::max(norm, std::abs(sln_ref[i]));
+  }
+  info("%s, %s: %s after %d iterations, residual %g, difference from UMFPack %g", method, pc_name,
+       converged ? "converged" : "did not converge", solver.get_num_iters(), solver.get_residual(), diff / norm);
+
+  if (!converged || solver.get_residual() > KRYLOV_TOL || diff > TOLERANCE * norm) return -1;
+  return solver.get_num_iters();
+}
+
+int main(int argc, char* argv[])
+{
+  // Load the mesh.
+  Mesh mesh;
+  H2DReader mloader;
+  mloader.load("domain.mesh", &mesh);
+
+  // Perform initial mesh refinements.
+  for (int i = 0; i < INIT_REF_NUM; i++) mesh.refine_all_elements();
+  mesh.refine_towards_vertex(2, 2);
+
+  // Create an H1 space with default shapeset.
+  H1Space space(&mesh, bc_types, essential_bc_values, P_INIT);
+  int ndof = Space::get_num_dofs(&space);
+  info("ndof = %d", ndof);
+
+  bool success = true;
+
+  // Symmetric problem, CG.
+  {
+    WeakForm wf;
+    wf.add_matrix_form(callback(bilinear_form_sym), HERMES_SYM);
+    wf.add_vector_form(callback(linear_form));
+    DiscreteProblem dp(&wf, &space, true);
+    UMFPackMatrix matrix;
+    UMFPackVector rhs;
+    dp.assemble(&matrix, &rhs);
+
+    UMFPackLinearSolver umfpack(&matrix, &rhs);
+    if (!umfpack.solve()) error("UMFPack failed.");
+    scalar* sln_ref = umfpack.get_solution();
+
+    JacobiPrecond jacobi;
+    BlockJacobiPrecond block_jacobi;
+    dp.get_element_blocks(&block_jacobi);
+    ILUPrecond ilu;
+    SSORPrecond ssor(1.2);
+
+    int it_none = solve_krylov("cg", NULL, "none", &matrix, &rhs, sln_ref);
+    int it_jacobi = solve_krylov("cg", &jacobi, "Jacobi", &matrix, &rhs, sln_ref);
+    int it_block_jacobi = solve_krylov("cg", &block_jacobi, "block Jacobi", &matrix, &rhs, sln_ref);
+    int it_ilu = solve_krylov("cg", &ilu, "ILU(0)", &matrix, &rhs, sln_ref);
+    int it_ssor = solve_krylov("cg", &ssor, "SSOR", &matrix, &rhs, sln_ref);
+    if (it_none < 0 || it_jacobi < 0 || it_block_jacobi < 0 || it_ilu < 0 || it_ssor < 0) success = false;
+    if (it_block_jacobi >= it_none || it_ilu >= it_none || it_ssor >= it_none) success = false;
+
+    // one block of all DOFs: the preconditioner is the inverse of the matrix
+    BlockJacobiPrecond exact;
+    int* dofs = new int[ndof];
+    for (int i = 0; i < ndof; i++) dofs[i] = i;
+    exact.add_block(ndof, dofs);
+    delete [] dofs;
+    int it_exact = solve_krylov("cg", &exact, "single block", &matrix, &rhs, sln_ref);
+    if (it_exact < 0 || it_exact > 2) success = false;
+  }
+
+  // Nonsymmetric problem, GMRES and BiCGStab.
+  {
+    WeakForm wf;
+    wf.add_matrix_form(callback(bilinear_form_unsym), HERMES_UNSYM);
+    wf.add_vector_form(callback(linear_form));
+    DiscreteProblem dp(&wf, &space, true);
+    UMFPackMatrix matrix;
+    UMFPackVector rhs;
+    dp.assemble(&matrix, &rhs);
+
+    UMFPackLinearSolver umfpack(&matrix, &rhs);
+    if (!umfpack.solve()) error("UMFPack failed.");
+    scalar* sln_ref = umfpack.get_solution();
+
+    ILUPrecond ilu;
+    SSORPrecond ssor;
+    if (solve_krylov("gmres", &ilu, "ILU(0)", &matrix, &rhs, sln_ref) < 0) success = false;
+    if (solve_krylov("bicgstab", &ilu, "ILU(0)", &matrix, &rhs, sln_ref) < 0) success = false;
+    if (solve_krylov("gmres", &ssor, "SSOR", &matrix, &rhs, sln_ref) < 0) success = false;
+  }
+
+#define ERROR_SUCCESS                               0
+#define ERROR_FAILURE                               -1
+  if (success) {
+    printf("Success!\n");
+    return ERROR_SUCCESS;
+  }
+  else {
+    printf("Failure!\n");
+    return ERROR_FAILURE;
+  }
+}
@@ -66,10 +66,12 @@ int main(int argc, char* argv[])
   bool is_linear = false;
   DiscreteProblem dp(&wf, &space, is_linear);
 
-  // Set up the solver, matrix, and rhs according to the solver selection.
-  SparseMatrix* matrix = create_matrix(matrix_solver);
-  Vector* rhs = create_vector(matrix_solver);
-  Solver* solver = create_linear_solver(matrix_solver, matrix, rhs);
+  // Set up the Newton's method (the matrix, rhs and the linear solver are created
+  // according to the solver selection).
+  NewtonSolver newton(&dp, matrix_solver);
+  newton.set_tolerance(NEWTON_TOL);
+  newton.set_max_iters(NEWTON_MAX_ITER);
+  newton.set_verbose_output(true);
 
   // Initialize the solution.
   Solution sln;
@@ -84,55 +86,19 @@ int main(int argc, char* argv[])
   delete init_sln;
 
   // Perform Newton's iteration.
-  int it = 1;
-  bool success = false;
-  while (1)
-  {
-    // Obtain the number of degrees of freedom.
-    int ndof = Space::get_num_dofs(&space);
-
-    // Assemble the Jacobian matrix and residual vector.
-    dp.assemble(coeff_vec, matrix, rhs, false);
-
-    // Multiply the residual vector with -1 since the matrix 
-    // equation reads J(Y^n) \deltaY^{n+1} = -F(Y^n).
-    for (int i = 0; i < ndof; i++) rhs->set(i, -rhs->get(i));
-    
-    // Calculate the l2-norm of residual vector.
-    double res_l2_norm = get_l2_norm(rhs);
-
-    // Info for user.
-    info("---- Newton iter %d, ndof %d, res. l2 norm %g", it, Space::get_num_dofs(&space), res_l2_norm);
-
-    // If l2 norm of the residual vector is within tolerance, or the maximum number 
-    // of iteration has been reached, then quit.
-    if (res_l2_norm < NEWTON_TOL || it > NEWTON_MAX_ITER) break;
-
-    // Solve the linear system.
-    if(!(success = solver->solve()))
-      error ("Matrix solver failed.\n");
-
-    // Add \deltaY^{n+1} to Y^n.
-    for (int i = 0; i < ndof; i++) coeff_vec[i] += solver->get_solution()[i];
-    
-    if (it >= NEWTON_MAX_ITER)
-      error ("Newton method did not converge.");
-
-    it++;
-  }
+  bool success = newton.solve(coeff_vec);
+  info("Newton's method %s after %d iterations, res. l2 norm %g.", success ? "converged" : "did not converge",
+       newton.get_num_iters(), newton.get_residual_norm());
 
   // Translate the resulting coefficient vector into the Solution sln.
   Solution::vector_to_solution(coeff_vec, &space, &sln);
 
   // Cleanup.
   delete [] coeff_vec;
-  delete matrix;
-  delete rhs;
-  delete solver;
-  
+
 #define ERROR_SUCCESS                               0
 #define ERROR_FAILURE                               -1
-  if (success) {  // should pass with NEWTON_MAX_ITER = 7 and fail with NEWTON_MAX_ITER = 6
+  if (success) {  // 6 solved iterations: should pass with NEWTON_MAX_ITER >= 6 and fail with NEWTON_MAX_ITER = 5
     printf("Success!\n");
     return ERROR_SUCCESS;
   }
@@ -7,11 +7,11 @@
 int NUMBER_OF_EIGENVALUES = 6;                    // Desired number of eigenvalues.
 int P_INIT = 4;                                   // Uniform polynomial degree of mesh elements.
 const int INIT_REF_NUM = 0;                       // Number of initial mesh refinements.
-double TARGET_VALUE = 2.0;                        // PySparse parameter: Eigenvalues in the vicinity of this number will be computed. 
-double TOL = 1e-10;                               // Pysparse parameter: Error tolerance.
-int MAX_ITER = 1000;                              // PySparse parameter: Maximum number of iterations.
-MatrixSolverType matrix_solver = SOLVER_UMFPACK;  // Possibilities: SOLVER_AMESOS, SOLVER_MUMPS, 
-                                                  // SOLVER_PARDISO, SOLVER_PETSC, SOLVER_UMFPACK
+double TARGET_VALUE = 2.0;                        // Eigensolver parameter: Eigenvalues in the vicinity of this number will be computed.
+double TOL = 1e-10;                               // Eigensolver parameter: Error tolerance.
+int MAX_ITER = 1000;                              // Eigensolver parameter: Maximum number of iterations.
+MatrixSolverType matrix_solver = SOLVER_UMFPACK;  // Possibilities: SOLVER_UMFPACK, SOLVER_MIXED_PRECISION
+                                                  // (the eigensolver needs the matrices in the CSC storage).
 
 // Boundary condition types.
 // Note: "essential" means that solution value is prescribed.
@@ -29,30 +29,6 @@ scalar essential_bc_values(int ess_bdy_marker, double x, double y)
 // Weak forms.
 #include "forms.cpp"
 
-// Write the matrix in Matrix Market format.
-void write_matrix_mm(const char* filename, Matrix* mat) 
-{
-  int ndof = mat->get_size();
-  FILE *out = fopen(filename, "w" );
-  int nz=0;
-  for (int i=0; i < ndof; i++) {
-    for (int j=0; j <=i; j++) { 
-      double tmp = mat->get(i,j);
-      if (fabs(tmp) > 1e-15) nz++;
-    }
-  } 
-
-  fprintf(out,"%%%%MatrixMarket matrix coordinate real symmetric\n");
-  fprintf(out,"%d %d %d\n", ndof, ndof, nz);
-  for (int i=0; i < ndof; i++) {
-    for (int j=0; j <=i; j++) { 
-      double tmp = mat->get(i,j);
-      if (fabs(tmp) > 1e-15) fprintf(out, "%d %d %24.15e\n", i+1, j+1, tmp);
-    }
-  } 
-  fclose(out);
-}
-
 int main(int argc, char* argv[])
 {
   info("Desired number of eigenvalues: %d.", NUMBER_OF_EIGENVALUES);
@@ -75,57 +51,51 @@ int main(int argc, char* argv[])
   wf_left.add_matrix_form(callback(bilinear_form_left));
   wf_right.add_matrix_form(callback(bilinear_form_right));
 
-  // Initialize matrices and matrix solver.
+  // Initialize matrices.
   SparseMatrix* matrix_left = create_matrix(matrix_solver);
   SparseMatrix* matrix_right = create_matrix(matrix_solver);
-  Vector* eivec = create_vector(matrix_solver);
-  Solver* solver = create_linear_solver(matrix_solver, matrix_left, eivec);
 
   // Assemble the matrices.
   bool is_linear = true;
   DiscreteProblem dp_left(&wf_left, &space, is_linear);
-  dp_left.assemble(matrix_left, eivec);
+  dp_left.assemble(matrix_left);
   DiscreteProblem dp_right(&wf_right, &space, is_linear);
-  dp_right.assemble(matrix_right, eivec);
-
-  // Write matrix_left in MatrixMarket format.
-  write_matrix_mm("mat_left.mtx", matrix_left);
-
-  // Write matrix_left in MatrixMarket format.
-  write_matrix_mm("mat_right.mtx", matrix_right);
-
-  // Calling Python eigensolver. Solution will be written to "eivecs.dat".
-  char call_cmd[255];
-  sprintf(call_cmd, "python solveGenEigenFromMtx.py mat_left.mtx mat_right.mtx %g %d %g %d", 
-	  TARGET_VALUE, NUMBER_OF_EIGENVALUES, TOL, MAX_ITER);
-  system(call_cmd);
-
-  // Initializing solution vector, solution and ScalarView.
-  double* coeff_vec = new double(ndof);
+  dp_right.assemble(matrix_right);
+
+  // Solve the generalized eigenproblem.
+  EigenSolver eigensolver(matrix_left, matrix_right);
+  eigensolver.set_shift_solver(matrix_solver);
+  eigensolver.set_tolerance(TOL);
+  eigensolver.set_max_iters(MAX_ITER);
+  bool success = eigensolver.solve(NUMBER_OF_EIGENVALUES, TARGET_VALUE);
+
+  // The exact eigenvalues are m^2 + n^2 (2, 5, 5, 8, 10, 10), the discrete ones approximate
+  // them from above. The reference values are the eigenvalues of the same (9 x 9) discrete
+  // problem computed by a dense (Cholesky + Jacobi) eigensolver.
+  double ref[] = { 2.000029427770661, 5.255504426863319, 5.255504426863323,
+                   8.510979425955961, 11.347972567941195, 11.347972567941527 };
   Solution sln;
-
-  // Reading solution vectors from file and visualizing.
-  FILE *file = fopen("eivecs.dat", "r");
-  char line [64];                  // Maximum line size.
-  fgets(line, sizeof line, file);  // ndof
-  int n = atoi(line);            
-  if (n != ndof) error("Mismatched ndof in the eigensolver output file.");  
-  fgets(line, sizeof line, file);  // Number of eigenvectors in the file.
-  int neig = atoi(line);
-  if (neig != NUMBER_OF_EIGENVALUES) error("Mismatched number of eigenvectors in the eigensolver output file.");  
-  for (int ieig = 0; ieig < neig; ieig++) {
-    // Get next eigenvector from the file.
-    for (int i = 0; i < ndof; i++) {  
-      fgets(line, sizeof line, file);
-      coeff_vec[i] = atof(line);
-    }
-
-    // Convert coefficient vector into a Solution.
-    Solution::vector_to_solution(coeff_vec, &space, &sln);
+  if (eigensolver.get_num_eigenvalues() != NUMBER_OF_EIGENVALUES) success = false;
+  for (int ieig = 0; success && ieig < eigensolver.get_num_eigenvalues(); ieig++) {
+    double lambda = eigensolver.get_eigenvalue(ieig);
+    info("Eigenvalue %d: %.15g (reference %.15g)", ieig + 1, lambda, ref[ieig]);
+    if (fabs(lambda - ref[ieig]) > TOL * ref[ieig]) success = false;
+
+    // Convert the eigenvector into a Solution.
+    Solution::vector_to_solution(eigensolver.get_eigenvector(ieig), &space, &sln);
   }  
-  fclose(file);
 
-  delete [] coeff_vec;
-  // wait for test functions. 
+  delete matrix_left;
+  delete matrix_right;
+
+#define ERROR_SUCCESS                               0
+#define ERROR_FAILURE                               -1
+  if (success) {
+    printf("Success!\n");
+    return ERROR_SUCCESS;
+  }
+  else {
+    printf("Failure!\n");
+    return ERROR_FAILURE;
+  }
 };
-
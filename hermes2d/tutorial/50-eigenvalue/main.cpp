@@ -3,8 +3,8 @@
 #include <stdio.h>
 
 //  This example solves the eigenproblem for the Laplace operator in 
-//  a square with zero boundary conditions. Python and Pysparse must
-//  be installed. 
+//  a square with zero boundary conditions. The generalized eigenproblem
+//  is solved by the native shift-invert Lanczos solver (EigenSolver).
 //
 //  PDE: -Laplace u = lambda_k u,
 //  where lambda_0, lambda_1, ... are the eigenvalues.
@@ -18,11 +18,11 @@
 int NUMBER_OF_EIGENVALUES = 6;                    // Desired number of eigenvalues.
 int P_INIT = 4;                                   // Uniform polynomial degree of mesh elements.
 const int INIT_REF_NUM = 2;                       // Number of initial mesh refinements.
-double TARGET_VALUE = 2.0;                        // PySparse parameter: Eigenvalues in the vicinity of this number will be computed. 
-double TOL = 1e-10;                               // Pysparse parameter: Error tolerance.
-int MAX_ITER = 1000;                              // PySparse parameter: Maximum number of iterations.
-MatrixSolverType matrix_solver = SOLVER_UMFPACK;  // Possibilities: SOLVER_AMESOS, SOLVER_MUMPS, 
-                                                  // SOLVER_PARDISO, SOLVER_PETSC, SOLVER_UMFPACK
+double TARGET_VALUE = 2.0;                        // Eigensolver parameter: Eigenvalues in the vicinity of this number will be computed.
+double TOL = 1e-10;                               // Eigensolver parameter: Error tolerance.
+int MAX_ITER = 1000;                              // Eigensolver parameter: Maximum number of iterations.
+MatrixSolverType matrix_solver = SOLVER_UMFPACK;  // Possibilities: SOLVER_UMFPACK, SOLVER_MIXED_PRECISION
+                                                  // (the eigensolver needs the matrices in the CSC storage).
 
 // Boundary condition types.
 // Note: "essential" means that solution value is prescribed.
@@ -40,36 +40,6 @@ scalar essential_bc_values(int ess_bdy_marker, double x, double y)
 // Weak forms.
 #include "forms.cpp"
 
-// Write the matrix in Matrix Market format.
-void write_matrix_mm(const char* filename, Matrix* mat) 
-{
-  // Get matrix size.
-  int ndof = mat->get_size();
-  FILE *out = fopen(filename, "w" );
-  if (out == NULL) error("failed to open file for writing.");
-
-  // Calculate the number of nonzeros.
-  int nz = 0;
-  for (int i = 0; i < ndof; i++) {
-    for (int j = 0; j <= i; j++) { 
-      double tmp = mat->get(i, j);
-      if (fabs(tmp) > 1e-15) nz++;
-    }
-  } 
-
-  // Write the matrix in MatrixMarket format
-  fprintf(out,"%%%%MatrixMarket matrix coordinate real symmetric\n");
-  fprintf(out,"%d %d %d\n", ndof, ndof, nz);
-  for (int i = 0; i < ndof; i++) {
-    for (int j = 0; j <= i; j++) { 
-      double tmp = mat->get(i, j);
-      if (fabs(tmp) > 1e-15) fprintf(out, "%d %d %24.15e\n", i + 1, j + 1, tmp);
-    }
-  } 
-
-  fclose(out);
-}
-
 int main(int argc, char* argv[])
 {
   info("Desired number of eigenvalues: %d.", NUMBER_OF_EIGENVALUES);
@@ -92,10 +62,9 @@ int main(int argc, char* argv[])
   wf_left.add_matrix_form(callback(bilinear_form_left));
   wf_right.add_matrix_form(callback(bilinear_form_right));
 
-  // Initialize matrices and matrix solver.
+  // Initialize matrices.
   SparseMatrix* matrix_left = create_matrix(matrix_solver);
   SparseMatrix* matrix_right = create_matrix(matrix_solver);
-  Solver* solver = create_linear_solver(matrix_solver, matrix_left);
 
   // Assemble the matrices.
   bool is_linear = true;
@@ -104,41 +73,25 @@ int main(int argc, char* argv[])
   DiscreteProblem dp_right(&wf_right, &space, is_linear);
   dp_right.assemble(matrix_right);
 
-  // Write matrix_left in MatrixMarket format.
-  write_matrix_mm("mat_left.mtx", matrix_left);
-
-  // Write matrix_left in MatrixMarket format.
-  write_matrix_mm("mat_right.mtx", matrix_right);
+  // Solve the generalized eigenproblem matrix_left x = lambda matrix_right x. 
+  // The shifted matrix is factorized by the matrix solver only once.
+  EigenSolver eigensolver(matrix_left, matrix_right);
+  eigensolver.set_shift_solver(matrix_solver);
+  eigensolver.set_tolerance(TOL);
+  eigensolver.set_max_iters(MAX_ITER);
+  if (!eigensolver.solve(NUMBER_OF_EIGENVALUES, TARGET_VALUE)) error("Eigensolver did not converge.");
+  info("Eigensolver: %d iterations, %g s.", eigensolver.get_num_iters(), eigensolver.get_time());
 
-  // Calling Python eigensolver. Solution will be written to "eivecs.dat".
-  char call_cmd[255];
-  sprintf(call_cmd, "python solveGenEigenFromMtx.py mat_left.mtx mat_right.mtx %g %d %g %d", 
-	  TARGET_VALUE, NUMBER_OF_EIGENVALUES, TOL, MAX_ITER);
-  system(call_cmd);
-
-  // Initializing solution vector, solution and ScalarView.
-  double* coeff_vec = new double[ndof];
+  // Initializing solution and ScalarView.
   Solution sln;
   ScalarView view("Solution", new WinGeom(0, 0, 440, 350));
 
-  // Reading solution vectors from file and visualizing.
-  FILE *file = fopen("eivecs.dat", "r");
-  char line [64];                  // Maximum line size.
-  fgets(line, sizeof line, file);  // ndof
-  int n = atoi(line);            
-  if (n != ndof) error("Mismatched ndof in the eigensolver output file.");  
-  fgets(line, sizeof line, file);  // Number of eigenvectors in the file.
-  int neig = atoi(line);
-  if (neig != NUMBER_OF_EIGENVALUES) error("Mismatched number of eigenvectors in the eigensolver output file.");  
-  for (int ieig = 0; ieig < neig; ieig++) {
-    // Get next eigenvector from the file.
-    for (int i = 0; i < ndof; i++) {  
-      fgets(line, sizeof line, file);
-      coeff_vec[i] = atof(line);
-    }
-
-    // Convert coefficient vector into a Solution.
-    Solution::vector_to_solution(coeff_vec, &space, &sln);
+  // Visualizing the eigenvectors.
+  for (int ieig = 0; ieig < eigensolver.get_num_eigenvalues(); ieig++) {
+    info("Eigenvalue %d: %.12g", ieig + 1, eigensolver.get_eigenvalue(ieig));
+
+    // Convert the eigenvector into a Solution.
+    Solution::vector_to_solution(eigensolver.get_eigenvector(ieig), &space, &sln);
 
     // Visualize the solution.
     view.show(&sln);
@@ -146,10 +99,9 @@ int main(int argc, char* argv[])
     // Wait for keypress.
     View::wait(HERMES_WAIT_KEYPRESS);
   }  
-  fclose(file);
 
-  delete [] coeff_vec;
+  delete matrix_left;
+  delete matrix_right;
 
   return 0; 
 };
-
@@ -5,8 +5,8 @@
 using namespace RefinementSelectors;
 
 //  This example uses automatic adaptivity to solve the eigenproblem for the 
-//  Laplace operator in a square with zero boundary conditions. Python and 
-//  Pysparse must be installed. 
+//  Laplace operator in a square with zero boundary conditions. The generalized
+//  eigenproblem is solved by the native shift-invert Lanczos solver (EigenSolver).
 //
 //  PDE: -Laplace u = lambda_k u,
 //  where lambda_0, lambda_1, ... are the eigenvalues.
@@ -20,10 +20,10 @@ using namespace RefinementSelectors;
 const int NUMBER_OF_EIGENVALUES = 5;              // Desired number of eigenvalues. Maximum is 6.
 int P_INIT = 2;                                   // Uniform polynomial degree of mesh elements.
 const int INIT_REF_NUM = 2;                       // Number of initial mesh refinements.
-double TARGET_VALUE = 2.0;                        // PySparse parameter: Eigenvalues in the vicinity of 
+double TARGET_VALUE = 2.0;                        // Eigensolver parameter: Eigenvalues in the vicinity of 
                                                   // this number will be computed. 
-double TOL = 1e-10;                               // Pysparse parameter: Error tolerance.
-int MAX_ITER = 1000;                              // PySparse parameter: Maximum number of iterations.
+double TOL = 1e-10;                               // Eigensolver parameter: Error tolerance.
+int MAX_ITER = 1000;                              // Eigensolver parameter: Maximum number of iterations.
 const double THRESHOLD = 0.3;                     // This is a quantitative parameter of the adapt(...) function and
                                                   // it has different meanings for various adaptive strategies (see below).
 const int STRATEGY = 0;                           // Adaptive strategy:
@@ -51,8 +51,8 @@ const double ERR_STOP = 0.001;                    // Stopping criterion for adap
                                                   // reference mesh and coarse mesh solution in percent).
 const int NDOF_STOP = 100000;                     // Adaptivity process stops when the number of degrees of freedom grows
                                                   // over this limit. This is to prevent h-adaptivity to go on forever.
-MatrixSolverType matrix_solver = SOLVER_UMFPACK;  // Possibilities: SOLVER_AMESOS, SOLVER_MUMPS, 
-                                                  // SOLVER_PARDISO, SOLVER_PETSC, SOLVER_UMFPACK
+MatrixSolverType matrix_solver = SOLVER_UMFPACK;  // Possibilities: SOLVER_UMFPACK, SOLVER_MIXED_PRECISION
+                                                  // (the eigensolver needs the matrices in the CSC storage).
 
 // Boundary condition types.
 // Note: "essential" means that solution value is prescribed.
@@ -70,30 +70,6 @@ scalar essential_bc_values(int ess_bdy_marker, double x, double y)
 // Weak forms.
 #include "forms.cpp"
 
-// Write the matrix in Matrix Market format.
-void write_matrix_mm(const char* filename, Matrix* mat) 
-{
-  int ndof = mat->get_size();
-  FILE *out = fopen(filename, "w" );
-  int nz=0;
-  for (int i=0; i < ndof; i++) {
-    for (int j=0; j <=i; j++) { 
-      double tmp = mat->get(i,j);
-      if (fabs(tmp) > 1e-15) nz++;
-    }
-  } 
-
-  fprintf(out,"%%%%MatrixMarket matrix coordinate real symmetric\n");
-  fprintf(out,"%d %d %d\n", ndof, ndof, nz);
-  for (int i=0; i < ndof; i++) {
-    for (int j=0; j <=i; j++) { 
-      double tmp = mat->get(i,j);
-      if (fabs(tmp) > 1e-15) fprintf(out, "%d %d %24.15e\n", i+1, j+1, tmp);
-    }
-  } 
-  fclose(out);
-}
-
 int main(int argc, char* argv[])
 {
   if (NUMBER_OF_EIGENVALUES > 6) error("Maximum number of eigenvalues is 6.");
@@ -159,10 +135,9 @@ int main(int argc, char* argv[])
     int ref_ndof = Space::get_num_dofs(ref_space);
     info("ref_ndof: %d.", ref_ndof);
 
-    // Initialize matrices and matrix solver on referenc emesh.
+    // Initialize matrices on reference mesh.
     SparseMatrix* matrix_left = create_matrix(matrix_solver);
     SparseMatrix* matrix_right = create_matrix(matrix_solver);
-    Solver* solver = create_linear_solver(matrix_solver, matrix_left);
 
     // Assemble the matrices on reference mesh.
     bool is_linear = true;
@@ -171,54 +146,24 @@ int main(int argc, char* argv[])
     DiscreteProblem* dp_right = new DiscreteProblem(&wf_right, ref_space, is_linear);
     dp_right->assemble(matrix_right);
 
-    // Time measurement.
-    cpu_time.tick();
-
-    // Write matrix_left in MatrixMarket format.
-    write_matrix_mm("mat_left.mtx", matrix_left);
-
-    // Write matrix_left in MatrixMarket format.
-    write_matrix_mm("mat_right.mtx", matrix_right);
-
-    // Time measurement.
-    cpu_time.tick(HERMES_SKIP);
-
-    // Calling Python eigensolver. Solution will be written to "eivecs.dat".
-    char call_cmd[255];
-    sprintf(call_cmd, "python solveGenEigenFromMtx.py mat_left.mtx mat_right.mtx %g %d %g %d", 
-	    TARGET_VALUE, NUMBER_OF_EIGENVALUES, TOL, MAX_ITER);
-    system(call_cmd);
+    // Solve the generalized eigenproblem on reference mesh.
+    EigenSolver eigensolver(matrix_left, matrix_right);
+    eigensolver.set_shift_solver(matrix_solver);
+    eigensolver.set_tolerance(TOL);
+    eigensolver.set_max_iters(MAX_ITER);
+    if (!eigensolver.solve(NUMBER_OF_EIGENVALUES, TARGET_VALUE)) error("Eigensolver did not converge.");
 
-    // Initializing solution vector, solution and ScalarView.
-    double* ref_coeff_vec = new double[ref_ndof];
     Solution sln[NUMBER_OF_EIGENVALUES], ref_sln[NUMBER_OF_EIGENVALUES];
-    ScalarView view("Solution", new WinGeom(0, 0, 440, 350));
-
-    // Reading solution vectors from file and visualizing.
-    FILE *file = fopen("eivecs.dat", "r");
-    char line [64];                  // Maximum line size.
-    fgets(line, sizeof line, file);  // ref_ndof
-    int n = atoi(line);            
-    if (n != ref_ndof) error("Mismatched ndof in the eigensolver output file.");  
-    fgets(line, sizeof line, file);  // Number of eigenvectors in the file.
-    int neig = atoi(line);
-    if (neig != NUMBER_OF_EIGENVALUES) error("Mismatched number of eigenvectors in the eigensolver output file.");  
     for (int ieig = 0; ieig < NUMBER_OF_EIGENVALUES; ieig++) {
-      // Get next eigenvector from the file.
-      for (int i = 0; i < ref_ndof; i++) {  
-        fgets(line, sizeof line, file);
-        ref_coeff_vec[i] = atof(line);
-      }
+      info("Eigenvalue %d: %.12g", ieig + 1, eigensolver.get_eigenvalue(ieig));
 
-      // Convert coefficient vector into a Solution.
-      Solution::vector_to_solution(ref_coeff_vec, ref_space, &(ref_sln[ieig]));
+      // Convert the eigenvector into a Solution.
+      Solution::vector_to_solution(eigensolver.get_eigenvector(ieig), ref_space, &(ref_sln[ieig]));
 
       // Project the fine mesh solution onto the coarse mesh.
       info("Projecting reference solution %d on coarse mesh.", ieig);
       OGProjection::project_global(&space, &(ref_sln[ieig]), &(sln[ieig]), matrix_solver);
     }  
-    fclose(file);
-    delete [] ref_coeff_vec;
 
     // FIXME: Below, the adaptivity is done for the last eigenvector only,
     // this needs to be changed to take into account all eigenvectors.
@@ -296,7 +241,6 @@ int main(int argc, char* argv[])
     if (Space::get_num_dofs(&space) >= NDOF_STOP) done = true;
 
     // Clean up.
-    delete solver;
     delete matrix_left;
     delete matrix_right;
     delete adaptivity;
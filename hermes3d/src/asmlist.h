@@ -64,6 +64,15 @@ public:
 		cnt++;
 	}
 
+	/// Replaces the list with n triples copied from the arrays.
+	void copy(int n, const long int *idx, const int *dof, const scalar *coef) {
+		while (cap < n) enlarge();
+		memcpy(this->idx, idx, sizeof(long int) * n);
+		memcpy(this->dof, dof, sizeof(int) * n);
+		memcpy(this->coef, coef, sizeof(scalar) * n);
+		cnt = n;
+	}
+
 	void dump(FILE *stream = stdout) {
 		fprintf(stream, "\nasmlist:\n");
 		for (int i = 0; i < cnt; i++)
@@ -21,6 +21,8 @@
 #include "discrete_problem.h"
 #include "traverse.h"
 #include "../../hermes_common/matrix.h"
+#include "../../hermes_common/solver/precond_native.h"
+#include "../../hermes_common/solver/umfpack_solver.h"
 #include "../../hermes_common/error.h"
 #include "../../hermes_common/callstack.h"
 
@@ -77,6 +79,16 @@ DiscreteProblem::DiscreteProblem(WeakForm *wf, Tuple<Space *> spaces, bool is_li
 
   have_matrix = false;
 
+  use_scatter_maps = false;
+  use_sym_storage = false;
+  use_interleaved_dofs = false;
+  use_sum_factorization = false;
+  order_cache_hits = order_cache_misses = 0;
+  scatter_mat = NULL;
+
+  matrix_free = false;
+  apply_x = apply_y = NULL;
+
   this->spaces = Tuple<Space *>();
   for (int i = 0; i < wf->neq; i++) this->spaces.push_back(spaces[i]);
   have_spaces = true;
@@ -101,6 +113,8 @@ void DiscreteProblem::free()
   struct_changed = values_changed = true;
   memset(sp_seq, -1, sizeof(int) * wf->neq);
   wf_seq = -1;
+  scatter_maps.free();
+  scatter_mat = NULL;
 }
 
 int DiscreteProblem::get_num_dofs()
@@ -115,6 +129,17 @@ int DiscreteProblem::get_num_dofs()
   return this->ndof;
 }
 
+void DiscreteProblem::set_interleaved_dofs(bool enable)
+{
+  _F_
+  use_interleaved_dofs = enable;
+  if (enable) this->ndof = Space::assign_dofs_interleaved(this->spaces);
+  else this->ndof = Space::assign_dofs(this->spaces);
+  // the spaces could not be interleaved (see Space::assign_dofs_interleaved())
+  if (enable && !Space::is_interleaved(this->spaces)) use_interleaved_dofs = false;
+  have_matrix = false;
+}
+
 scalar **DiscreteProblem::get_matrix_buffer(int n)
 {
   _F_
@@ -156,6 +181,14 @@ void DiscreteProblem::create(SparseMatrix *mat, Vector* rhs, bool rhsonly)
 {
   _F_
 
+  // the DOFs have been reassigned consecutively since set_interleaved_dofs()
+  if (use_interleaved_dofs && !Space::is_interleaved(spaces))
+  {
+    Space::assign_dofs_interleaved(spaces);
+    if (!Space::is_interleaved(spaces)) use_interleaved_dofs = false;
+    have_matrix = false;
+  }
+
   if (is_up_to_date())
   {
     if (!rhsonly && mat != NULL) 
@@ -168,11 +201,17 @@ void DiscreteProblem::create(SparseMatrix *mat, Vector* rhs, bool rhsonly)
   }
   
   int ndof = get_num_dofs();
+
+  // the scatter maps are bound to the old sparse structure
+  scatter_maps.free();
+  scatter_mat = NULL;
   
   if (mat != NULL)  // mat may be NULL when assembling the rhs for NOX
   {
     // spaces have changed: create the matrix from scratch
     mat->free();
+    if (!mat->set_symmetric_storage(use_sym_storage && wf->is_sym()))
+      verbose("The matrix does not support the symmetric storage.");
     mat->prealloc(ndof);
 
     AsmList *al = new AsmList[wf->neq];
@@ -188,13 +227,16 @@ void DiscreteProblem::create(SparseMatrix *mat, Vector* rhs, bool rhsonly)
 
     // Loop through all elements.
     Element **e;
+    Element **al_elem = new Element*[wf->neq];
+    memset(al_elem, 0, sizeof(Element*) * wf->neq);
     while ((e = trav.get_next_state(NULL, NULL)) != NULL)
     {
-      // obtain assembly lists for the element at all spaces
+      // obtain assembly lists for the element at all spaces (the element of a coarser
+      // mesh stays the same in several states of the traversal)
       for (int i = 0; i < wf->neq; i++)
       {
-        // TODO: do not get the assembly list again if the element was not changed
-        if (e[i] != NULL) spaces[i]->get_element_assembly_list(e[i], al + i);
+        if (e[i] != NULL && e[i] != al_elem[i]) spaces[i]->get_element_assembly_list(e[i], al + i);
+        if (e[i] != NULL) al_elem[i] = e[i];
       }
 
       // go through all equation-blocks of the local stiffness matrix
@@ -208,23 +250,22 @@ void DiscreteProblem::create(SparseMatrix *mat, Vector* rhs, bool rhsonly)
             AsmList *an = al + n;
 
             // pretend assembling of the element stiffness matrix
-            // register nonzero elements
-            for (int i = 0; i < am->cnt; i++)
-              if (am->dof[i] >= 0)
-                for (int j = 0; j < an->cnt; j++)
-                  if (an->dof[j] >= 0)
-                    mat->pre_add_ij(am->dof[i], an->dof[j]);
+            // register nonzero elements (the whole block at once)
+            mat->pre_add_block(am->cnt, an->cnt, am->dof, an->dof);
           }
         }
       }
     }
 
     trav.finish();
+    delete [] al_elem;
     delete [] al;
     delete [] meshes;
     delete [] blocks;
 
     mat->alloc();
+
+    if (use_scatter_maps) build_scatter_maps(mat);
   }
   
   // WARNING: unlike Matrix::alloc(), Vector::alloc(ndof) frees the memory occupied 
@@ -241,6 +282,141 @@ void DiscreteProblem::create(SparseMatrix *mat, Vector* rhs, bool rhsonly)
   have_matrix = true;
 }
 
+// Records the offsets of all local stiffness matrix blocks into the storage of 'mat', so
+// that assemble() can scatter the blocks without searching the sparse structure.
+void DiscreteProblem::build_scatter_maps(SparseMatrix *mat)
+{
+  _F_
+  AsmList *al = new AsmList[wf->neq];
+  Mesh **meshes = new Mesh*[wf->neq];
+  bool **blocks = wf->get_blocks();
+
+  for (int i = 0; i < wf->neq; i++)
+    meshes[i] = spaces[i]->get_mesh();
+
+  scatter_maps.init(wf->neq);
+  scatter_mat = mat;
+
+  Traverse trav;
+  trav.begin(wf->neq, meshes);
+
+  bool supported = true;
+  Element **e;
+  while (supported && (e = trav.get_next_state(NULL, NULL)) != NULL)
+  {
+    for (int i = 0; i < wf->neq; i++)
+      if (e[i] != NULL) spaces[i]->get_element_assembly_list(e[i], al + i);
+
+    for (int m = 0; m < wf->neq && supported; m++)
+    {
+      for (int n = 0; n < wf->neq && supported; n++)
+      {
+        if (!blocks[m][n] || e[m] == NULL || e[n] == NULL) continue;
+        // In multi-mesh problems, the same pair of elements is visited several times.
+        if (scatter_maps.get(m, n, e[m]->id, e[n]->id) != NULL) continue;
+
+        AsmList *am = al + m;
+        AsmList *an = al + n;
+        int *map = scatter_maps.add(m, n, e[m]->id, e[n]->id, am->cnt * an->cnt);
+        // The matrix may not support scattering with maps.
+        supported = mat->get_block_map(am->cnt, an->cnt, am->dof, an->dof, map);
+      }
+    }
+  }
+
+  trav.finish();
+  delete [] al;
+  delete [] meshes;
+  delete [] blocks;
+
+  if (!supported)
+  {
+    scatter_maps.free();
+    scatter_mat = NULL;
+  }
+}
+
+// Returns the scatter map of the block (m, n) on the current elements (NULL if there is none).
+int *DiscreteProblem::get_scatter_map(SparseMatrix *mat, int m, int n, int *elem_id)
+{
+  if (mat != scatter_mat) return NULL;
+  return scatter_maps.get(m, n, elem_id[m], elem_id[n]);
+}
+
+void DiscreteProblem::get_element_blocks(BlockJacobiPrecond *pc)
+{
+  _F_
+  AsmList al;
+  pc->clear_blocks();
+  for (int i = 0; i < wf->neq; i++)
+  {
+    Mesh *mesh = spaces[i]->get_mesh();
+    FOR_ALL_ACTIVE_ELEMENTS(idx, mesh)
+    {
+      spaces[i]->get_element_assembly_list(mesh->elements[idx], &al);
+      pc->add_block(al.cnt, al.dof);
+    }
+  }
+}
+
+void DiscreteProblem::get_p_levels(PMultigridPrecond *pc, int num_levels)
+{
+  _F_
+  pc->clear_levels();
+
+  // Ord3 can not hold negative orders, so the lowest order must stay at least 1
+  for (int i = 0; i < wf->neq; i++)
+  {
+    Mesh *mesh = spaces[i]->get_mesh();
+    FOR_ALL_ACTIVE_ELEMENTS(idx, mesh)
+    {
+      Ord3 o = spaces[i]->get_element_order(idx);
+      int mo = (o.type == MODE_TETRAHEDRON) ? o.order : std::min(o.x, std::min(o.y, o.z));
+      num_levels = std::min(num_levels, mo - 1);
+    }
+  }
+
+  int ndof = get_num_dofs();
+  bool *keep = new bool[ndof];
+  MEM_CHECK(keep);
+  int last = ndof;
+  AsmList al, cal;
+  for (int k = 1; k <= num_levels; k++)
+  {
+    memset(keep, 0, ndof * sizeof(bool));
+    for (int i = 0; i < wf->neq; i++)
+    {
+      // the shapesets are hierarchic: the lower order space has a subset of the basis
+      // functions, which are identified by their indices on the elements
+      Mesh *mesh = spaces[i]->get_mesh();
+      Space *coarse = spaces[i]->dup(mesh);
+      coarse->copy_orders(*spaces[i], -k);
+      std::vector<int> cidx;
+      FOR_ALL_ACTIVE_ELEMENTS(idx, mesh)
+      {
+        spaces[i]->get_element_assembly_list(mesh->elements[idx], &al);
+        coarse->get_element_assembly_list(mesh->elements[idx], &cal);
+        cidx.clear();
+        for (int j = 0; j < cal.cnt; j++)
+          if (cal.dof[j] >= 0) cidx.push_back(cal.idx[j]);
+        std::sort(cidx.begin(), cidx.end());
+        for (int j = 0; j < al.cnt; j++)
+          if (al.dof[j] >= 0 && std::binary_search(cidx.begin(), cidx.end(), (int) al.idx[j]))
+            keep[al.dof[j]] = true;
+      }
+      delete coarse;
+    }
+
+    std::vector<int> dofs;
+    for (int j = 0; j < ndof; j++)
+      if (keep[j]) dofs.push_back(j);
+    if (dofs.empty() || (int) dofs.size() == last) break;
+    pc->add_level(dofs.size(), &dofs[0]);
+    last = dofs.size();
+  }
+  delete [] keep;
+}
+
 //// assembly //////////////////////////////////////////////////////////////////////////////////////
 
 // Light version for linear problems.
@@ -250,7 +426,45 @@ void DiscreteProblem::assemble(SparseMatrix* mat, Vector* rhs, bool rhsonly)
   assemble(NULL, mat, rhs, rhsonly);
 }
 
+// General assembling function for nonlinear problem (single right-hand side).
 void DiscreteProblem::assemble(scalar* coeff_vec, SparseMatrix* mat, Vector* rhs, bool rhsonly)
+{
+  _F_
+  assemble(coeff_vec, mat, rhs != NULL ? &rhs : NULL, rhs != NULL ? 1 : 0, rhsonly);
+}
+
+// Adds the value to all right-hand sides (used for the Dirichlet lift, which is common to all of them).
+static inline void add_to_rhs(Vector** rhs, int nrhs, int idx, scalar val)
+{
+  for (int r = 0; r < nrhs; r++)
+    rhs[r]->add(idx, val);
+}
+
+// Adds the block to the matrix, or multiplies it by 'apply_x' into 'apply_y' in apply().
+void DiscreteProblem::add_to_matrix(SparseMatrix* mat, int m, int n, scalar** block, int* rows, int* cols, int* map)
+{
+  if (apply_y != NULL)
+  {
+    // matrix-free product, see apply()
+    for (int i = 0; i < m; i++)
+    {
+      if (rows[i] < 0) continue;
+      scalar sum = 0.0;
+      for (int j = 0; j < n; j++)
+        if (cols[j] >= 0) sum += block[i][j] * apply_x[cols[j]];
+      apply_y[rows[i]] += sum;
+    }
+  }
+  else if (map != NULL)
+    mat->add_block_with_map(m, n, block, map);
+  else
+    mat->add(m, n, block, rows, cols);
+}
+
+// General assembling function, several right-hand sides may be assembled in one traversal: 
+// every vector form is added to the right-hand side given by its index in the weak form 
+// (forms with an index >= nrhs are skipped).
+void DiscreteProblem::assemble(scalar* coeff_vec, SparseMatrix* mat, Vector** rhs, int nrhs, bool rhsonly)
 {
   /* BEGIN IDENTICAL CODE WITH H2D */
 
@@ -263,7 +477,13 @@ void DiscreteProblem::assemble(scalar* coeff_vec, SparseMatrix* mat, Vector* rhs
     if (this->spaces[i] == NULL) error("A space is NULL in assemble().");
   }
  
-  this->create(mat, rhs, rhsonly);
+  // the matrix-free products leave the sparse structure of the matrix as it is
+  if (!matrix_free) this->create(mat, nrhs > 0 ? rhs[0] : NULL, rhsonly);
+  for (int r = matrix_free ? 0 : 1; r < nrhs; r++)
+  {
+    if (rhs[r]->length() != get_num_dofs()) rhs[r]->alloc(get_num_dofs());
+    else rhs[r]->zero();
+  }
 
   // Convert the coefficient vector 'coeff_vec' into solutions Tuple 'u_ext'.
   Tuple<Solution*> u_ext;
@@ -280,11 +500,17 @@ void DiscreteProblem::assemble(scalar* coeff_vec, SparseMatrix* mat, Vector* rhs
 
   /* END IDENTICAL CODE WITH H2D */
 
+  order_cache.clear();
+  order_cache_hits = order_cache_misses = 0;
+
   bool bnd[10];         // FIXME: magic number - maximal possible number of element surfaces
   SurfPos surf_pos[10];
   AsmList *al = new AsmList[wf->neq];
   bool *nat = new bool[wf->neq];
   bool *isempty = new bool[wf->neq];
+  int *elem_id = new int[wf->neq];
+  Element **al_elem = new Element*[wf->neq];
+  memset(al_elem, 0, sizeof(Element*) * wf->neq);
   AsmList *am, *an;
 
   ShapeFunction *base_fn = new ShapeFunction[wf->neq];
@@ -301,7 +527,7 @@ void DiscreteProblem::assemble(scalar* coeff_vec, SparseMatrix* mat, Vector* rhs
   // initialize matrix buffer
   matrix_buffer = NULL;
   matrix_buffer_dim = 0;
-  if (mat != NULL) get_matrix_buffer(10);
+  if (mat != NULL || apply_y != NULL) get_matrix_buffer(10);
 
   // obtain a list of assembling stages
   std::vector<WeakForm::Stage> stages;
@@ -346,8 +572,10 @@ void DiscreteProblem::assemble(scalar* coeff_vec, SparseMatrix* mat, Vector* rhs
           continue; 
         }
 
-        // TODO: do not obtain again if the element was not changed.
-        spaces[j]->get_element_assembly_list(e[i], al + j);
+        // the element of a coarser mesh stays the same in several states of the traversal
+        if (e[i] != al_elem[j]) spaces[j]->get_element_assembly_list(e[i], al + j);
+        al_elem[j] = e[i];
+        elem_id[j] = e[i]->id;
 
         // This is different in H2D (PrecalcShapeset is used).
         test_fn[j].set_active_element(e[i]);
@@ -361,7 +589,7 @@ void DiscreteProblem::assemble(scalar* coeff_vec, SparseMatrix* mat, Vector* rhs
 
       fn_cache.free();  // This is different in H2D.
 
-      if (mat != NULL) 
+      if (mat != NULL || apply_y != NULL) 
       {
         // assemble volume matrix forms //////////////////////////////////////
         for (unsigned ww = 0; ww < s->mfvol.size(); ww++) 
@@ -378,51 +606,84 @@ void DiscreteProblem::assemble(scalar* coeff_vec, SparseMatrix* mat, Vector* rhs
 
           // assemble the local stiffness matrix for the form mfv
           scalar **local_stiffness_matrix = get_matrix_buffer(std::max(am->cnt, an->cnt));
-          for (int i = 0; i < am->cnt; i++)
+          // the forms on the hexahedra with tensor-product shapesets by sum factorization if enabled
+          bool tensor_form = use_sum_factorization && can_use_tensor_form(fu, fv, an, am, refmap + n, refmap + m);
+          // the matrix-free product of a sum-factorized form does not need the local matrix
+          if (tensor_form && apply_y != NULL && nrhs == 0)
           {
-            if (!tra && am->dof[i] < 0) continue;
-            fv->set_active_shape(am->idx[i]);
+            apply_tensor_form(mfv, u_ext, fu, fv, an, am, refmap + n, refmap + m, tra ? mfv->sym : 0);
+            continue;
+          }
+          if (tensor_form) // all the entries at once
+          {
+            if (rhsonly == false || (nrhs > 0 && this->is_linear))
+            {
+              eval_tensor_form(mfv, u_ext, fu, fv, an, am, refmap + n, refmap + m, local_stiffness_matrix);
+              for (int i = 0; i < am->cnt; i++)
+                for (int j = 0; j < an->cnt; j++)
+                  local_stiffness_matrix[i][j] *= an->coef[j] * am->coef[i];
+            }
 
-            if (!sym) // unsymmetric block
+            // Linear problems only: Subtracting Dirichlet lift contribution from the RHS:
+            if (nrhs > 0 && this->is_linear)
             {
-              for (int j = 0; j < an->cnt; j++) 
+              for (int i = 0; i < am->cnt; i++)
               {
-                fu->set_active_shape(an->idx[j]);
-                if (an->dof[j] < 0) 
+                if (!tra && am->dof[i] < 0) continue;
+                for (int j = 0; j < an->cnt; j++)
+                  if (an->dof[j] < 0)
+                    add_to_rhs(rhs, nrhs, am->dof[i], -local_stiffness_matrix[i][j]);
+              }
+            }
+          }
+          else
+          {
+            for (int i = 0; i < am->cnt; i++)
+            {
+              if (!tra && am->dof[i] < 0) continue;
+              fv->set_active_shape(am->idx[i]);
+
+              if (!sym) // unsymmetric block
+              {
+                for (int j = 0; j < an->cnt; j++) 
                 {
-                  // Linear problems only: Subtracting Dirichlet lift contribution from the RHS:
-                  if (rhs != NULL && this->is_linear) 
+                  fu->set_active_shape(an->idx[j]);
+                  if (an->dof[j] < 0) 
+                  {
+                    // Linear problems only: Subtracting Dirichlet lift contribution from the RHS:
+                    if (nrhs > 0 && this->is_linear) 
+                    {
+                      scalar val = eval_form(mfv, u_ext, fu, fv, refmap + n, refmap + m) * an->coef[j] * am->coef[i];
+                      add_to_rhs(rhs, nrhs, am->dof[i], -val);
+                    } 
+                  }
+                  else if (rhsonly == false) 
                   {
                     scalar val = eval_form(mfv, u_ext, fu, fv, refmap + n, refmap + m) * an->coef[j] * am->coef[i];
-                    rhs->add(am->dof[i], -val);
-                  } 
-                }
-                else if (rhsonly == false) 
-                {
-                  scalar val = eval_form(mfv, u_ext, fu, fv, refmap + n, refmap + m) * an->coef[j] * am->coef[i];
-                  local_stiffness_matrix[i][j] = val;
+                    local_stiffness_matrix[i][j] = val;
+                  }
                 }
               }
-            }
-            else // symmetric block
-            {
-              for (int j = 0; j < an->cnt; j++) 
+              else // symmetric block
               {
-                if (j < i && an->dof[j] >= 0) continue;
-                fu->set_active_shape(an->idx[j]);
-                if (an->dof[j] < 0) 
+                for (int j = 0; j < an->cnt; j++) 
                 {
-                  // Linear problems only: Subtracting Dirichlet lift contribution from the RHS:
-                  if (rhs != NULL && this->is_linear) 
+                  if (j < i && an->dof[j] >= 0) continue;
+                  fu->set_active_shape(an->idx[j]);
+                  if (an->dof[j] < 0) 
+                  {
+                    // Linear problems only: Subtracting Dirichlet lift contribution from the RHS:
+                    if (nrhs > 0 && this->is_linear) 
+                    {
+                      scalar val = eval_form(mfv, u_ext, fu, fv, refmap + n, refmap + m) * an->coef[j] * am->coef[i];
+                      add_to_rhs(rhs, nrhs, am->dof[i], -val);
+                    }
+                  } 
+                  else if (rhsonly == false) 
                   {
                     scalar val = eval_form(mfv, u_ext, fu, fv, refmap + n, refmap + m) * an->coef[j] * am->coef[i];
-                    rhs->add(am->dof[i], -val);
+                    local_stiffness_matrix[i][j] = local_stiffness_matrix[j][i] = val;
                   }
-                } 
-                else if (rhsonly == false) 
-                {
-                  scalar val = eval_form(mfv, u_ext, fu, fv, refmap + n, refmap + m) * an->coef[j] * am->coef[i];
-                  local_stiffness_matrix[i][j] = local_stiffness_matrix[j][i] = val;
                 }
               }
             }
@@ -430,7 +691,10 @@ void DiscreteProblem::assemble(scalar* coeff_vec, SparseMatrix* mat, Vector* rhs
 
           // insert the local stiffness matrix into the global one
           if (rhsonly == false)
-            mat->add(am->cnt, an->cnt, local_stiffness_matrix, am->dof, an->dof);
+          {
+            add_to_matrix(mat, am->cnt, an->cnt, local_stiffness_matrix, am->dof, an->dof,
+                          get_scatter_map(mat, m, n, elem_id));
+          }
 
           // insert also the off-diagonal (anti-)symmetric block, if required
           if (tra)
@@ -441,10 +705,13 @@ void DiscreteProblem::assemble(scalar* coeff_vec, SparseMatrix* mat, Vector* rhs
             transpose(local_stiffness_matrix, am->cnt, an->cnt);
 
             if (rhsonly == false) 
-              mat->add(an->cnt, am->cnt, local_stiffness_matrix, an->dof, am->dof);
+            {
+              add_to_matrix(mat, an->cnt, am->cnt, local_stiffness_matrix, an->dof, am->dof,
+                            get_scatter_map(mat, n, m, elem_id));
+            }
 
             // Linear problems only: Subtracting Dirichlet lift contribution from the RHS:
-            if (rhs != NULL && this->is_linear) 
+            if (nrhs > 0 && this->is_linear) 
             {
               for (int j = 0; j < am->cnt; j++) 
               {
@@ -454,7 +721,7 @@ void DiscreteProblem::assemble(scalar* coeff_vec, SparseMatrix* mat, Vector* rhs
                   {
                     if (an->dof[i] >= 0) 
                     {
-                      rhs->add(an->dof[i], -local_stiffness_matrix[i][j]);
+                      add_to_rhs(rhs, nrhs, an->dof[i], -local_stiffness_matrix[i][j]);
                     }
                   }
                 }
@@ -469,11 +736,12 @@ void DiscreteProblem::assemble(scalar* coeff_vec, SparseMatrix* mat, Vector* rhs
          is only one line of difference that is highlighted below */
 
       //// assemble volume vector forms ////////////////////////////////////////
-      if (rhs != NULL)
+      if (nrhs > 0)
       {
         for (unsigned int ww = 0; ww < s->vfvol.size(); ww++)
         {
           WeakForm::VectorFormVol* vfv = s->vfvol[ww];
+          if (vfv->rhs >= nrhs) continue;
           if (isempty[vfv->i]) continue;
           if (vfv->area != HERMES_ANY && !wf->is_in_area(marker, vfv->area)) continue;
           int m = vfv->i;  
@@ -485,7 +753,7 @@ void DiscreteProblem::assemble(scalar* coeff_vec, SparseMatrix* mat, Vector* rhs
             if (am->dof[i] < 0) continue;
             fv->set_active_shape(am->idx[i]);
             scalar val = eval_form(vfv, u_ext, fv, refmap + m) * am->coef[i];
-            rhs->add(am->dof[i], val);
+            rhs[vfv->rhs]->add(am->dof[i], val);
           }
         }
       }
@@ -509,7 +777,7 @@ void DiscreteProblem::assemble(scalar* coeff_vec, SparseMatrix* mat, Vector* rhs
         }
 
         // assemble surface matrix forms ///////////////////////////////////
-        if (mat != NULL)
+        if (mat != NULL || apply_y != NULL)
         {
           for (unsigned int ww = 0; ww < s->mfsurf.size(); ww++)
           {
@@ -539,11 +807,11 @@ void DiscreteProblem::assemble(scalar* coeff_vec, SparseMatrix* mat, Vector* rhs
                 if (an->dof[j] < 0) 
                 {
                   // Linear problems only: Subtracting Dirichlet lift contribution from the RHS:
-                  if (rhs != NULL && this->is_linear) 
+                  if (nrhs > 0 && this->is_linear) 
                   {
                     scalar val = eval_form(mfs, u_ext, fu, fv, refmap + n, refmap + m, 
                                            surf_pos + isurf) * an->coef[j] * am->coef[i];
-                    rhs->add(am->dof[i], -val);
+                    add_to_rhs(rhs, nrhs, am->dof[i], -val);
                   }
                 }
                 else if (rhsonly == false) 
@@ -555,16 +823,17 @@ void DiscreteProblem::assemble(scalar* coeff_vec, SparseMatrix* mat, Vector* rhs
               }
             }
             if (rhsonly == false) 
-              mat->add(am->cnt, an->cnt, local_stiffness_matrix, am->dof, an->dof);
+              add_to_matrix(mat, am->cnt, an->cnt, local_stiffness_matrix, am->dof, an->dof, NULL);
           }
         }
 
         // assemble surface vector forms /////////////////////////////////////
-        if (rhs != NULL)
+        if (nrhs > 0)
         {
           for (unsigned int ww = 0; ww < s->vfsurf.size(); ww++)
           {
             WeakForm::VectorFormSurf* vfs = s->vfsurf[ww];
+            if (vfs->rhs >= nrhs) continue;
             if (isempty[vfs->i]) continue;
             if (vfs->area != HERMES_ANY && !wf->is_in_area(marker, vfs->area)) continue;
             int m = vfs->i; 
@@ -580,7 +849,7 @@ void DiscreteProblem::assemble(scalar* coeff_vec, SparseMatrix* mat, Vector* rhs
               if (am->dof[i] < 0) continue;
               fv->set_active_shape(am->idx[i]);
               scalar val = eval_form(vfs, u_ext, fv, refmap + m, surf_pos + isurf) * am->coef[i];
-              rhs->add(am->dof[i], val);
+              rhs[vfs->rhs]->add(am->dof[i], val);
             }
           }
         }
@@ -590,7 +859,7 @@ void DiscreteProblem::assemble(scalar* coeff_vec, SparseMatrix* mat, Vector* rhs
     }
 
     if (mat != NULL) mat->finish();
-    if (rhs != NULL) rhs->finish();
+    for (int r = 0; r < nrhs; r++) rhs[r]->finish();
     trav.finish();
   }
  
@@ -611,6 +880,8 @@ void DiscreteProblem::assemble(scalar* coeff_vec, SparseMatrix* mat, Vector* rhs
 
   // Clean up.
   delete [] isempty;
+  delete [] elem_id;
+  delete [] al_elem;
   delete [] nat;
   delete [] al;
   delete [] base_fn;
@@ -618,6 +889,65 @@ void DiscreteProblem::assemble(scalar* coeff_vec, SparseMatrix* mat, Vector* rhs
   delete [] refmap;
 }
 
+/* BEGIN IDENTICAL CODE WITH H2D */
+
+void DiscreteProblem::apply(scalar* coeff_vec, scalar* x, scalar* y)
+{
+  _F_
+  memset(y, 0, get_num_dofs() * sizeof(scalar));
+  matrix_free = true;
+  apply_x = x;
+  apply_y = y;
+  assemble(coeff_vec, NULL, NULL, 0, false);
+  apply_x = apply_y = NULL;
+  matrix_free = false;
+}
+
+void DiscreteProblem::apply_fd(scalar* coeff_vec, scalar* x, scalar* y, scalar* f0, double eps)
+{
+  _F_
+  if (coeff_vec == NULL || this->is_linear) error("DiscreteProblem::apply_fd() is for nonlinear problems, use apply().");
+  int n = get_num_dofs();
+  double xnorm = 0.0, cnorm = 0.0;
+  for (int i = 0; i < n; i++)
+  {
+    xnorm += std::abs(x[i]) * std::abs(x[i]);
+    cnorm += std::abs(coeff_vec[i]) * std::abs(coeff_vec[i]);
+  }
+  if (xnorm == 0.0)
+  {
+    memset(y, 0, n * sizeof(scalar));
+    return;
+  }
+  if (eps == 0.0) eps = sqrt(DBL_EPSILON) * (1.0 + sqrt(cnorm)) / sqrt(xnorm);
+
+  // residual vectors at Y + eps x and at Y
+  scalar* shifted = new scalar[n];
+  MEM_CHECK(shifted);
+  for (int i = 0; i < n; i++) shifted[i] = coeff_vec[i] + eps * x[i];
+  assemble_residual(shifted, y);
+  if (f0 == NULL)
+  {
+    assemble_residual(coeff_vec, shifted);
+    f0 = shifted;
+  }
+  for (int i = 0; i < n; i++) y[i] = (y[i] - f0[i]) / eps;
+  delete [] shifted;
+}
+
+void DiscreteProblem::assemble_residual(scalar* coeff_vec, scalar* f)
+{
+  _F_
+  UMFPackVector vec;
+  Vector* pvec = &vec;
+  matrix_free = true;
+  assemble(coeff_vec, NULL, &pvec, 1, true);
+  matrix_free = false;
+  vec.extract(f);
+}
+
+/* END IDENTICAL CODE WITH H2D */
+
 //////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 void DiscreteProblem::init_ext_fns(ExtData<scalar> &ext_data, std::vector<MeshFunction *> &ext, int order,
@@ -655,6 +985,32 @@ void DiscreteProblem::init_ext_fns(ExtData<Ord> &fake_ext_data, std::vector<Mesh
   fake_ext_data.fn = fake_ext_fn;
 }
 
+int *DiscreteProblem::get_cached_order(void *form, Tuple<Solution *> &u_ext, int ou, int ov,
+                                       std::vector<MeshFunction *> &ext, int marker)
+{
+  order_key.clear();
+  order_key.push_back(ou);
+  order_key.push_back(ov);
+  order_key.push_back(marker);
+  for (int i = 0; i < wf->neq; i++)
+  {
+    Solution *sln = (i < (int) u_ext.size()) ? u_ext[i] : NULL;
+    order_key.push_back(sln == NULL ? 0 : sln->get_fn_order().get_ord());
+  }
+  for (unsigned i = 0; i < ext.size(); i++)
+    order_key.push_back(ext[i]->get_fn_order().get_ord());
+
+  std::map<std::vector<int>, int> &orders = order_cache[form];
+  std::map<std::vector<int>, int>::iterator it = orders.find(order_key);
+  if (it != orders.end())
+  {
+    order_cache_hits++;
+    return &(it->second);
+  }
+  order_cache_misses++;
+  return &(orders[order_key] = -1);
+}
+
 sFunc *DiscreteProblem::get_fn(ShapeFunction *fu, int order, RefMap *rm, const int np, const QuadPt3D *pt)
 {
   fn_key_t key(fu->get_active_shape(), order, fu->get_transform(), fu->get_shapeset()->id);
@@ -692,6 +1048,57 @@ mFunc *DiscreteProblem::get_fn(Solution *fu, int order, RefMap *rm, const int np
   return u;
 }
 
+// The integration order of a volume matrix form for the shape functions of the orders 'ou' and
+// 'ov' (without the increase due to the reference map).
+int DiscreteProblem::calc_order_matrix_form_vol(WeakForm::MatrixFormVol *mfv, Tuple<Solution *> u_ext,
+                                                const Ord3 &ou, const Ord3 &ov, int marker)
+{
+  _F_
+  int *form_order = get_cached_order(mfv, u_ext, ou.get_ord(), ov.get_ord(), mfv->ext, marker);
+  if (*form_order < 0)
+  {
+    Func<Ord> *oi = new Func<Ord>[wf->neq];
+
+    // Order of solutions from the previous Newton iteration.
+    if (u_ext != Tuple<Solution *>()) 
+    {
+      for (int i = 0; i < wf->neq; i++) 
+      {
+        if (u_ext[i] != NULL) oi[i] = init_fn_ord(u_ext[i]->get_fn_order());
+        else oi[i] = init_fn_ord(0);
+      }
+    } 
+    else 
+    {
+      for (int i = 0; i < wf->neq; i++) oi[i] = init_fn_ord(0);
+    }
+
+    // Order of shape functions.
+    Func<Ord> fake_u = init_fn_ord(ou);
+    Func<Ord> fake_v = init_fn_ord(ov);
+
+    // Order of additional external functions.
+    ExtData<Ord> fake_ext;
+    init_ext_fns(fake_ext, mfv->ext);
+
+    // Order of geometric attributes (eg. for multiplication of a solution with coordinates, normals, etc.).
+    double fake_wt = 1.0;
+    Geom<Ord> fake_e = init_geom(marker);
+
+    // Total order of the matrix form.
+    Ord o = mfv->ord(1, &fake_wt, &oi, &fake_u, &fake_v, &fake_e, &fake_ext);
+
+    // Clean up.
+    for (int i = 0; i < wf->neq; i++) free_fn(oi + i);
+    delete [] oi;
+    free_fn(&fake_u);
+    free_fn(&fake_v);
+
+    *form_order = o.get_order();
+  }
+  return *form_order;
+}
+
 scalar DiscreteProblem::eval_form(WeakForm::MatrixFormVol *mfv, Tuple<Solution *> u_ext, ShapeFunction *fu,
                             ShapeFunction *fv, RefMap *ru, RefMap *rv)
 {
@@ -703,52 +1110,17 @@ scalar DiscreteProblem::eval_form(WeakForm::MatrixFormVol *mfv, Tuple<Solution *
   Element *elem = fv->get_active_element();
 
   // Determine the integration order
-  Func<Ord> *oi = new Func<Ord>[wf->neq];
-
-  // Order of solutions from the previous Newton iteration.
-  if (u_ext != Tuple<Solution *>()) 
-  {
-    for (int i = 0; i < wf->neq; i++) 
-    {
-      if (u_ext[i] != NULL) oi[i] = init_fn_ord(u_ext[i]->get_fn_order());
-      else oi[i] = init_fn_ord(0);
-    }
-  } 
-  else 
-  {
-    for (int i = 0; i < wf->neq; i++) oi[i] = init_fn_ord(0);
-  }
-
-  // Order of shape functions.
-  Func<Ord> ou = init_fn_ord(fu->get_fn_order());
-  Func<Ord> ov = init_fn_ord(fv->get_fn_order());
-
-  // Order of additional external functions.
-  ExtData<Ord> fake_ext;
-  init_ext_fns(fake_ext, mfv->ext);
-
-  // Order of geometric attributes (eg. for multiplication of a solution with coordinates, normals, etc.).
-  double fake_wt = 1.0;
-  Geom<Ord> fake_e = init_geom(elem->marker);
-
-  // Total order of the matrix form.
-  Ord o = mfv->ord(1, &fake_wt, &oi, &ou, &ov, &fake_e, &fake_ext);
+  int form_order = calc_order_matrix_form_vol(mfv, u_ext, fu->get_fn_order(), fv->get_fn_order(), elem->marker);
 
   // Increase due to reference map.
   Ord3 order = ru->get_inv_ref_order();
   switch (order.type) {
-    case MODE_TETRAHEDRON: order += Ord3(o.get_order()); break;
-    case MODE_HEXAHEDRON: order += Ord3(o.get_order(), o.get_order(), o.get_order()); break;
+    case MODE_TETRAHEDRON: order += Ord3(form_order); break;
+    case MODE_HEXAHEDRON: order += Ord3(form_order, form_order, form_order); break;
   }
   order.limit();
   int ord_idx = order.get_idx();
 
-  // Clean up.
-  for (int i = 0; i < wf->neq; i++) free_fn(oi + i);
-  delete [] oi;
-  free_fn(&ou);
-  free_fn(&ov);
-
   // Evaluate the form using the quadrature of the just calculated order.
   Quad3D *quad = get_quadrature(elem->get_mode());
   int np = quad->get_num_points(order);
@@ -794,6 +1166,447 @@ scalar DiscreteProblem::eval_form(WeakForm::MatrixFormVol *mfv, Tuple<Solution *
   return res;
 }
 
+// Volume matrix forms by sum factorization on the hexahedra (see set_sum_factorization()).
+
+// True if the form can be integrated by sum factorization on the current element: both elements
+// are hexahedra and the shape functions are unconstrained tensor products.
+bool DiscreteProblem::can_use_tensor_form(ShapeFunction *fu, ShapeFunction *fv, AsmList *an, AsmList *am,
+                                          RefMap *ru, RefMap *rv)
+{
+  if (ru->get_active_element()->get_mode() != MODE_HEXAHEDRON) return false;
+  if (rv->get_active_element()->get_mode() != MODE_HEXAHEDRON) return false;
+  if (fu->get_num_components() != 1 || fv->get_num_components() != 1) return false;
+  Shapeset *ssu = fu->get_shapeset(), *ssv = fv->get_shapeset();
+  int idx[3];
+  double sign;
+  for (int j = 0; j < an->cnt; j++)
+    if (!ssu->get_tensor_index(an->idx[j], idx, sign)) return false;
+  for (int i = 0; i < am->cnt; i++)
+    if (!ssv->get_tensor_index(am->idx[i], idx, sign)) return false;
+  return true;
+}
+
+// The tensor indices of the shape functions of the assembly list and the 1D tables in the
+// points of the 1D rules, mapped to the sub-element of the shape functions (the hexahedral
+// sub-element transformations are scalings in each direction).
+void DiscreteProblem::init_tensor_side(TensorSide &s, ShapeFunction *f, AsmList *al, QuadPt1D *pt1[3])
+{
+  Shapeset *ss = f->get_shapeset();
+  Trf *ctm = f->get_ctm();
+  for (int k = 0; k < 3; k++) s.idx[k].resize(al->cnt);
+  s.sign.resize(al->cnt);
+  s.p = 0;
+  for (int j = 0; j < al->cnt; j++)
+  {
+    int idx[3];
+    ss->get_tensor_index(al->idx[j], idx, s.sign[j]);
+    for (int k = 0; k < 3; k++)
+    {
+      s.idx[k][j] = idx[k];
+      s.p = std::max(s.p, idx[k] + 1);
+    }
+  }
+  for (int k = 0; k < 3; k++)
+  {
+    int n1 = tensor_n[k];
+    for (int n = 0; n < 2; n++)
+    {
+      s.tab[k][n].resize(s.p * n1);
+      for (int a = 0; a < s.p; a++)
+        for (int i = 0; i < n1; i++)
+          s.tab[k][n][a * n1 + i] = ss->get_tensor_value_1d(n, a, ctm->m[k] * pt1[k][i].x + ctm->t[k]);
+    }
+  }
+}
+
+// Points the arrays of 'view' (one point) to the point 'p' of the arrays of 'fn'.
+template<typename T>
+static void shift_fn(Func<T> *view, Func<T> *fn, int p)
+{
+#define H3D_SHIFT(__ATTRIB) view->__ATTRIB = (fn->__ATTRIB != NULL) ? fn->__ATTRIB + p : NULL;
+  H3D_SHIFT(val) H3D_SHIFT(dx) H3D_SHIFT(dy) H3D_SHIFT(dz)
+  H3D_SHIFT(val0) H3D_SHIFT(val1) H3D_SHIFT(val2)
+  H3D_SHIFT(dx0) H3D_SHIFT(dx1) H3D_SHIFT(dx2) H3D_SHIFT(dy0) H3D_SHIFT(dy1) H3D_SHIFT(dy2)
+  H3D_SHIFT(dz0) H3D_SHIFT(dz1) H3D_SHIFT(dz2) H3D_SHIFT(curl0) H3D_SHIFT(curl1) H3D_SHIFT(curl2)
+#undef H3D_SHIFT
+  view->num_gip = 1;
+  view->nc = fn->nc;
+}
+
+// The matrices C of a volume matrix form in the points of the hexahedral quadrature of the order
+// 'order' (tensor_c): C[4*a + b] = a(U = e_a, V = e_b) for the unit vectors of the values
+// (val, dx, dy, dz) of the basis and the test function, evaluated in each point separately with
+// the previous iterations, the external functions and the geometry of the point (the arrays of
+// the cache shifted, not copied).
+void DiscreteProblem::get_point_coefs(WeakForm::MatrixFormVol *mfv, Tuple<Solution *> u_ext,
+                                      RefMap *ru, RefMap *rv, const Ord3 &order)
+{
+  _F_
+  Quad3D *quad = get_quadrature(MODE_HEXAHEDRON);
+  int np = quad->get_num_points(order);
+  QuadPt3D *pt = quad->get_points(order);
+  int ord_idx = order.get_idx();
+
+  // Init geometry and jacobian*weights (as in eval_form()).
+  if (!fn_cache.e.exists(ord_idx))
+  {
+    fn_cache.jwt[ord_idx] = ru->get_jacobian(np, pt);
+    fn_cache.e[ord_idx] = init_geom(rv->get_active_element()->marker, ru, np, pt);
+  }
+  Geom<double> e = fn_cache.e[ord_idx];
+
+  // Values of the previous Newton iteration and external functions in quadrature points.
+  mFunc **prev = new mFunc *[wf->neq];
+  if (u_ext != Tuple<Solution *>())
+  {
+    for (int i = 0; i < wf->neq; i++)
+    {
+      if (u_ext[i] != NULL) prev[i] = get_fn(u_ext[i], ord_idx, rv, np, pt);
+      else prev[i] = NULL;
+    }
+  }
+  else
+  {
+    for (int i = 0; i < wf->neq; i++) prev[i] = NULL;
+  }
+  ExtData<scalar> ext;
+  init_ext_fns(ext, mfv->ext, ord_idx, rv, np, pt);
+
+  // their views of one point
+  mFunc *prev_view = new mFunc[wf->neq];
+  mFunc **prev_pt = new mFunc *[wf->neq];
+  for (int i = 0; i < wf->neq; i++)
+    prev_pt[i] = (prev[i] != NULL) ? prev_view + i : NULL;
+  ExtData<scalar> ext_pt;
+  ext_pt.nf = ext.nf;
+  ext_pt.fn = new mFunc[ext.nf];
+  Geom<double> e_pt = e;
+
+  double uval[4] = { 0.0, 0.0, 0.0, 0.0 }, vval[4] = { 0.0, 0.0, 0.0, 0.0 };
+  sFunc u, v;
+  u.num_gip = v.num_gip = 1;
+  u.nc = v.nc = 1;
+  u.val = uval; u.dx = uval + 1; u.dy = uval + 2; u.dz = uval + 3;
+  v.val = vval; v.dx = vval + 1; v.dy = vval + 2; v.dz = vval + 3;
+  double wt = 1.0;
+
+  tensor_c.resize(16 * np);
+  for (int p = 0; p < np; p++)
+  {
+    for (int i = 0; i < wf->neq; i++)
+      if (prev[i] != NULL) shift_fn(prev_pt[i], prev[i], p);
+    for (int i = 0; i < ext.nf; i++)
+      shift_fn(ext_pt.fn + i, ext.fn + i, p);
+    e_pt.x = e.x + p;
+    e_pt.y = e.y + p;
+    e_pt.z = e.z + p;
+
+    scalar *c = &tensor_c[16 * p];
+    for (int a = 0; a < 4; a++)
+    {
+      uval[a] = 1.0;
+      for (int b = 0; b < 4; b++)
+      {
+        vval[b] = 1.0;
+        c[4*a + b] = mfv->fn(1, &wt, prev_pt, &u, &v, &e_pt, &ext_pt);
+        vval[b] = 0.0;
+      }
+      uval[a] = 0.0;
+    }
+  }
+
+  // Clean up (the views do not own their arrays, the values stay in the cache).
+  delete [] prev_pt;
+  delete [] prev_view;
+  delete [] prev;
+}
+
+// Prepares the 1D tables of both sides and the coefficients K_cd = |J| w (T_u^T C T_v)_cd in the
+// points (the point (i * n_y + j) * n_z + l of the hexahedral rule is (x_i, y_j, z_l)), only for
+// the pairs of the reference components (c, d) that are not identically zero.
+void DiscreteProblem::init_tensor_form(WeakForm::MatrixFormVol *mfv, Tuple<Solution *> u_ext, ShapeFunction *fu,
+                                       ShapeFunction *fv, AsmList *an, AsmList *am, RefMap *ru, RefMap *rv)
+{
+  _F_
+  // the order of the pair of the highest orders on the element
+  Ord3 max_order_u, max_order_v;
+  for (int j = 0; j < an->cnt; j++)
+  {
+    fu->set_active_shape(an->idx[j]);
+    max_order_u = max(max_order_u, fu->get_fn_order());
+  }
+  for (int i = 0; i < am->cnt; i++)
+  {
+    fv->set_active_shape(am->idx[i]);
+    max_order_v = max(max_order_v, fv->get_fn_order());
+  }
+  int form_order = calc_order_matrix_form_vol(mfv, u_ext, max_order_u, max_order_v,
+                                              rv->get_active_element()->marker);
+  Ord3 order = ru->get_inv_ref_order();
+  order += Ord3(form_order, form_order, form_order);
+  order.limit();
+
+  Quad1D *quad_1d = get_quadrature_1d();
+  QuadPt1D *pt1[3] = { quad_1d->get_points(order.x), quad_1d->get_points(order.y), quad_1d->get_points(order.z) };
+  tensor_n[0] = quad_1d->get_num_points(order.x);
+  tensor_n[1] = quad_1d->get_num_points(order.y);
+  tensor_n[2] = quad_1d->get_num_points(order.z);
+  Quad3D *quad = get_quadrature(MODE_HEXAHEDRON);
+  int np = tensor_n[0] * tensor_n[1] * tensor_n[2];
+  assert(np == quad->get_num_points(order));
+  init_tensor_side(tensor_u, fu, an, pt1);
+  init_tensor_side(tensor_v, fv, am, pt1);
+
+  get_point_coefs(mfv, u_ext, ru, rv, order);
+  QuadPt3D *pt = quad->get_points(order);
+  double *jwt = fn_cache.jwt[order.get_idx()];
+  double3x3 *mu = ru->get_inv_ref_map(np, pt), *mv = rv->get_inv_ref_map(np, pt);
+  tensor_k.resize(16 * np);
+  tensor_nk = 0;
+  for (int cc = 0; cc < 4; cc++)
+    for (int d = 0; d < 4; d++)
+    {
+      scalar *k = &tensor_k[tensor_nk * np];
+      bool nonzero = false;
+      for (int p = 0; p < np; p++)
+      {
+        // columns cc and d of T = [1 0; 0 M], M the inverse reference map
+        double tu[4] = { cc == 0 ? 1.0 : 0.0, 0.0, 0.0, 0.0 };
+        double tv[4] = { d == 0 ? 1.0 : 0.0, 0.0, 0.0, 0.0 };
+        for (int a = 1; a < 4; a++)
+        {
+          if (cc) tu[a] = mu[p][a-1][cc-1];
+          if (d) tv[a] = mv[p][a-1][d-1];
+        }
+        scalar *c = &tensor_c[16 * p];
+        scalar sum = 0.0;
+        for (int a = 0; a < 4; a++)
+          for (int b = 0; b < 4; b++)
+            sum += tu[a] * c[4*a + b] * tv[b];
+        if (sum != 0.0) nonzero = true;
+        k[p] = jwt[p] * sum;
+      }
+      if (nonzero) tensor_kidx[tensor_nk++] = 4*cc + d;
+    }
+  delete [] mu;
+  delete [] mv;
+}
+
+// Evaluation of a volume matrix form by sum factorization (the whole local matrix, without the
+// coefficients of the assembly lists). With the shape functions s_j f_a(x) f_b(y) f_h(z),
+// mat[i][j] = s_i s_j sum_cd sum_z T_cd(a_j, a_i, b_j, b_i, z) F_h_j(z) F_h_i(z), where
+// T_cd(a_u, a_v, b_u, b_v, z) = sum_y sum_x K_cd(x, y, z) F_a_u(x) F_a_v(x) F_b_u(y) F_b_v(y)
+// is integrated in x, then in y.
+void DiscreteProblem::eval_tensor_form(WeakForm::MatrixFormVol *mfv, Tuple<Solution *> u_ext, ShapeFunction *fu,
+                                       ShapeFunction *fv, AsmList *an, AsmList *am, RefMap *ru, RefMap *rv,
+                                       scalar **mat)
+{
+  _F_
+  if (an->cnt == 0 || am->cnt == 0) return;
+  init_tensor_form(mfv, u_ext, fu, fv, an, am, ru, rv);
+  int nx = tensor_n[0], ny = tensor_n[1], nz = tensor_n[2], pu = tensor_u.p, pv = tensor_v.p;
+
+  for (int i = 0; i < am->cnt; i++)
+    for (int j = 0; j < an->cnt; j++)
+      mat[i][j] = 0.0;
+
+  std::vector<scalar> &tx = tensor_tmp, &ty = tensor_tmp2;
+  for (int q = 0; q < tensor_nk; q++)
+  {
+    int cc = tensor_kidx[q] / 4, d = tensor_kidx[q] % 4;
+    double *xu = &tensor_u.tab[0][cc == 1][0], *xv = &tensor_v.tab[0][d == 1][0];
+    double *yu = &tensor_u.tab[1][cc == 2][0], *yv = &tensor_v.tab[1][d == 2][0];
+    double *zu = &tensor_u.tab[2][cc == 3][0], *zv = &tensor_v.tab[2][d == 3][0];
+    scalar *k = &tensor_k[q * nx * ny * nz];
+
+    // integration in x, tx[au][av][y][z]
+    tx.assign(pu * pv * ny * nz, 0.0);
+    for (int au = 0; au < pu; au++)
+      for (int av = 0; av < pv; av++)
+      {
+        scalar *r = &tx[(au * pv + av) * ny * nz];
+        for (int i = 0; i < nx; i++)
+        {
+          double w = xu[au * nx + i] * xv[av * nx + i];
+          for (int jl = 0; jl < ny * nz; jl++)
+            r[jl] += w * k[i * ny * nz + jl];
+        }
+      }
+
+    // integration in y, ty[au][av][bu][bv][z]
+    ty.assign(pu * pv * pu * pv * nz, 0.0);
+    for (int a = 0; a < pu * pv; a++)
+      for (int bu = 0; bu < pu; bu++)
+        for (int bv = 0; bv < pv; bv++)
+        {
+          scalar *r = &ty[((a * pu + bu) * pv + bv) * nz];
+          for (int j = 0; j < ny; j++)
+          {
+            double w = yu[bu * ny + j] * yv[bv * ny + j];
+            scalar *s = &tx[(a * ny + j) * nz];
+            for (int l = 0; l < nz; l++)
+              r[l] += w * s[l];
+          }
+        }
+
+    // integration in z
+    for (int i = 0; i < am->cnt; i++)
+      for (int j = 0; j < an->cnt; j++)
+      {
+        int a = tensor_u.idx[0][j] * pv + tensor_v.idx[0][i];
+        scalar *r = &ty[((a * pu + tensor_u.idx[1][j]) * pv + tensor_v.idx[1][i]) * nz];
+        double *hu = &zu[tensor_u.idx[2][j] * nz], *hv = &zv[tensor_v.idx[2][i] * nz];
+        scalar sum = 0.0;
+        for (int l = 0; l < nz; l++)
+          sum += r[l] * hu[l] * hv[l];
+        mat[i][j] += sum;
+      }
+  }
+
+  for (int i = 0; i < am->cnt; i++)
+    for (int j = 0; j < an->cnt; j++)
+      mat[i][j] *= tensor_u.sign[j] * tensor_v.sign[i];
+}
+
+// y += A x for the local matrix A of the prepared form (A^T x if 'transpose'), evaluated by sum
+// factorization without A: the reference components of the function x in the points, their
+// combination by the coefficients K_cd and the integration against the shape functions of 'to'.
+void DiscreteProblem::apply_tensor(TensorSide &from, TensorSide &to, bool transpose, scalar *x, scalar *y)
+{
+  int nx = tensor_n[0], ny = tensor_n[1], nz = tensor_n[2], np = nx * ny * nz;
+  bool need_from[4] = { false, false, false, false }, need_to[4] = { false, false, false, false };
+  for (int q = 0; q < tensor_nk; q++)
+  {
+    int cc = tensor_kidx[q] / 4, d = tensor_kidx[q] % 4;
+    need_from[transpose ? d : cc] = need_to[transpose ? cc : d] = true;
+  }
+
+  // the coefficients on the grid of the 1D indices, [(a * p + b) * p + h]
+  int pf = from.p, pt = to.p, pm = std::max(pf, pt);
+  std::vector<scalar> &grid = tensor_grid;
+  grid.assign(pm * pm * pm, 0.0);
+  for (unsigned int s = 0; s < from.sign.size(); s++)
+    grid[(from.idx[0][s] * pf + from.idx[1][s]) * pf + from.idx[2][s]] += from.sign[s] * x[s];
+
+  // the components in the points: integrated in x, then in y and in z
+  std::vector<scalar> &in = tensor_in, &w1 = tensor_tmp, &w2 = tensor_tmp2;
+  in.assign(4 * np, 0.0);
+  w1.resize(nx * pm * pm);
+  w2.resize(nx * ny * pm);
+  for (int c = 0; c < 4; c++)
+  {
+    if (!need_from[c]) continue;
+    double *fx = &from.tab[0][c == 1][0], *fy = &from.tab[1][c == 2][0], *fz = &from.tab[2][c == 3][0];
+    for (int i = 0; i < nx; i++)
+      for (int bh = 0; bh < pf * pf; bh++)
+      {
+        scalar sum = 0.0;
+        for (int a = 0; a < pf; a++)
+          sum += fx[a * nx + i] * grid[a * pf * pf + bh];
+        w1[i * pf * pf + bh] = sum;
+      }
+    for (int i = 0; i < nx; i++)
+      for (int j = 0; j < ny; j++)
+        for (int h = 0; h < pf; h++)
+        {
+          scalar sum = 0.0;
+          for (int b = 0; b < pf; b++)
+            sum += fy[b * ny + j] * w1[(i * pf + b) * pf + h];
+          w2[(i * ny + j) * pf + h] = sum;
+        }
+    scalar *f = &in[c * np];
+    for (int ij = 0; ij < nx * ny; ij++)
+      for (int l = 0; l < nz; l++)
+      {
+        scalar sum = 0.0;
+        for (int h = 0; h < pf; h++)
+          sum += w2[ij * pf + h] * fz[h * nz + l];
+        f[ij * nz + l] = sum;
+      }
+  }
+
+  // combination by the coefficients
+  std::vector<scalar> &out = tensor_out;
+  out.assign(4 * np, 0.0);
+  for (int q = 0; q < tensor_nk; q++)
+  {
+    int cc = tensor_kidx[q] / 4, d = tensor_kidx[q] % 4;
+    if (transpose) std::swap(cc, d);
+    scalar *k = &tensor_k[q * np], *f = &in[cc * np], *g = &out[d * np];
+    for (int p = 0; p < np; p++)
+      g[p] += k[p] * f[p];
+  }
+
+  // integration against the shape functions: in z, then in y and in x
+  grid.assign(pt * pt * pt, 0.0);
+  for (int d = 0; d < 4; d++)
+  {
+    if (!need_to[d]) continue;
+    double *tx = &to.tab[0][d == 1][0], *ty = &to.tab[1][d == 2][0], *tz = &to.tab[2][d == 3][0];
+    scalar *g = &out[d * np];
+    for (int ij = 0; ij < nx * ny; ij++)
+      for (int h = 0; h < pt; h++)
+      {
+        scalar sum = 0.0;
+        for (int l = 0; l < nz; l++)
+          sum += g[ij * nz + l] * tz[h * nz + l];
+        w2[ij * pt + h] = sum;
+      }
+    for (int i = 0; i < nx; i++)
+      for (int b = 0; b < pt; b++)
+        for (int h = 0; h < pt; h++)
+        {
+          scalar sum = 0.0;
+          for (int j = 0; j < ny; j++)
+            sum += w2[(i * ny + j) * pt + h] * ty[b * ny + j];
+          w1[(i * pt + b) * pt + h] = sum;
+        }
+    for (int a = 0; a < pt; a++)
+      for (int bh = 0; bh < pt * pt; bh++)
+      {
+        scalar sum = 0.0;
+        for (int i = 0; i < nx; i++)
+          sum += tx[a * nx + i] * w1[i * pt * pt + bh];
+        grid[a * pt * pt + bh] += sum;
+      }
+  }
+  for (unsigned int t = 0; t < to.sign.size(); t++)
+    y[t] += to.sign[t] * grid[(to.idx[0][t] * pt + to.idx[1][t]) * pt + to.idx[2][t]];
+}
+
+// Matrix-free product (see apply()) of a volume matrix form by sum factorization. 'sym' is the
+// symmetry flag of an off-diagonal block of a symmetric or antisymmetric form, whose transposed
+// block is added too (0 otherwise).
+void DiscreteProblem::apply_tensor_form(WeakForm::MatrixFormVol *mfv, Tuple<Solution *> u_ext, ShapeFunction *fu,
+                                        ShapeFunction *fv, AsmList *an, AsmList *am, RefMap *ru, RefMap *rv,
+                                        int sym)
+{
+  _F_
+  if (an->cnt == 0 || am->cnt == 0) return;
+  init_tensor_form(mfv, u_ext, fu, fv, an, am, ru, rv);
+
+  // the Dirichlet lift is not a part of the product
+  std::vector<scalar> &xl = tensor_xl, &yl = tensor_yl;
+  xl.resize(an->cnt);
+  for (int j = 0; j < an->cnt; j++)
+    xl[j] = (an->dof[j] >= 0) ? apply_x[an->dof[j]] * an->coef[j] : 0.0;
+  yl.assign(am->cnt, 0.0);
+  apply_tensor(tensor_u, tensor_v, false, &xl[0], &yl[0]);
+  for (int i = 0; i < am->cnt; i++)
+    if (am->dof[i] >= 0) apply_y[am->dof[i]] += am->coef[i] * yl[i];
+
+  if (sym != 0)
+  {
+    xl.resize(am->cnt);
+    for (int i = 0; i < am->cnt; i++)
+      xl[i] = (am->dof[i] >= 0) ? apply_x[am->dof[i]] * am->coef[i] : 0.0;
+    yl.assign(an->cnt, 0.0);
+    apply_tensor(tensor_v, tensor_u, true, &xl[0], &yl[0]);
+    for (int j = 0; j < an->cnt; j++)
+      if (an->dof[j] >= 0) apply_y[an->dof[j]] += (double) sym * an->coef[j] * yl[j];
+  }
+}
+
 scalar DiscreteProblem::eval_form(WeakForm::VectorFormVol *vfv, Tuple<Solution *> u_ext, ShapeFunction *fv, RefMap *rv)
 {
   _F_
@@ -804,51 +1617,57 @@ scalar DiscreteProblem::eval_form(WeakForm::VectorFormVol *vfv, Tuple<Solution *
   Element *elem = fv->get_active_element();
 
   // Determine the integration order.
-  Func<Ord> *oi = new Func<Ord>[wf->neq];
-
-  // Order of solutions from the previous Newton iteration.
-  if (u_ext != Tuple<Solution *>()) 
+  int *form_order = get_cached_order(vfv, u_ext, 0, fv->get_fn_order().get_ord(), vfv->ext, elem->marker);
+  if (*form_order < 0)
   {
-    for (int i = 0; i < wf->neq; i++) 
+    Func<Ord> *oi = new Func<Ord>[wf->neq];
+
+    // Order of solutions from the previous Newton iteration.
+    if (u_ext != Tuple<Solution *>()) 
+    {
+      for (int i = 0; i < wf->neq; i++) 
+      {
+        if (u_ext[i] != NULL) oi[i] = init_fn_ord(u_ext[i]->get_fn_order());
+        else oi[i] = init_fn_ord(0);
+      }
+    } 
+    else 
     {
-      if (u_ext[i] != NULL) oi[i] = init_fn_ord(u_ext[i]->get_fn_order());
-      else oi[i] = init_fn_ord(0);
+      for (int i = 0; i < wf->neq; i++) oi[i] = init_fn_ord(0);
     }
-  } 
-  else 
-  {
-    for (int i = 0; i < wf->neq; i++) oi[i] = init_fn_ord(0);
-  }
 
-  // Order of the shape function.
-  Func<Ord> ov = init_fn_ord(fv->get_fn_order());
+    // Order of the shape function.
+    Func<Ord> ov = init_fn_ord(fv->get_fn_order());
+
+    // Order of additional external functions.
+    ExtData<Ord> fake_ext;
+    init_ext_fns(fake_ext, vfv->ext);
+
+    // Order of geometric attributes (eg. for multiplication of a solution with coordinates, normals, etc.).
+    double fake_wt = 1.0;
+    Geom<Ord> fake_e = init_geom(elem->marker);
 
-  // Order of additional external functions.
-  ExtData<Ord> fake_ext;
-  init_ext_fns(fake_ext, vfv->ext);
+    // Total order of the vector form.
+    Ord o = vfv->ord(1, &fake_wt, &oi, &ov, &fake_e, &fake_ext);
 
-  // Order of geometric attributes (eg. for multiplication of a solution with coordinates, normals, etc.).
-  double fake_wt = 1.0;
-  Geom<Ord> fake_e = init_geom(elem->marker);
+    // Clean up.
+    for (int i = 0; i < wf->neq; i++) free_fn(oi + i);
+    delete [] oi;
+    free_fn(&ov);
 
-  // Total order of the vector form.
-  Ord o = vfv->ord(1, &fake_wt, &oi, &ov, &fake_e, &fake_ext);
+    *form_order = o.get_order();
+  }
 
   // Increase due to reference map.
   Ord3 order = rv->get_inv_ref_order();
   switch (order.type) 
   {
-    case MODE_TETRAHEDRON: order += Ord3(o.get_order()); break;
-    case MODE_HEXAHEDRON: order += Ord3(o.get_order(), o.get_order(), o.get_order()); break;
+    case MODE_TETRAHEDRON: order += Ord3(*form_order); break;
+    case MODE_HEXAHEDRON: order += Ord3(*form_order, *form_order, *form_order); break;
   }
   order.limit();
   int ord_idx = order.get_idx();
 
-  // Clean up.
-  for (int i = 0; i < wf->neq; i++) free_fn(oi + i);
-  delete [] oi;
-  free_fn(&ov);
-
   // Evaluate the form using the quadrature of the just calculated order.
   Quad3D *quad = get_quadrature(elem->get_mode());
   int np = quad->get_num_points(order);
@@ -902,54 +1721,60 @@ scalar DiscreteProblem::eval_form(WeakForm::MatrixFormSurf *mfs, Tuple<Solution
   // fu->get_num_components() == 2.
 
   // Determine the integration order.
-  Func<Ord> *oi = new Func<Ord>[wf->neq];
-  
-  // Order of solutions from the previous Newton iteration.
-  if (u_ext != Tuple<Solution *>()) 
+  int *form_order = get_cached_order(mfs, u_ext, fu->get_fn_order().get_ord(), fv->get_fn_order().get_ord(), mfs->ext, surf_pos->marker);
+  if (*form_order < 0)
   {
-    for (int i = 0; i < wf->neq; i++) 
+    Func<Ord> *oi = new Func<Ord>[wf->neq];
+
+    // Order of solutions from the previous Newton iteration.
+    if (u_ext != Tuple<Solution *>()) 
     {
-      if (u_ext[i] != NULL) oi[i] = init_fn_ord(u_ext[i]->get_fn_order());
-      else oi[i] = init_fn_ord(0);
+      for (int i = 0; i < wf->neq; i++) 
+      {
+        if (u_ext[i] != NULL) oi[i] = init_fn_ord(u_ext[i]->get_fn_order());
+        else oi[i] = init_fn_ord(0);
+      }
+    } 
+    else 
+    {
+      for (int i = 0; i < wf->neq; i++) oi[i] = init_fn_ord(0);
     }
-  } 
-  else 
-  {
-    for (int i = 0; i < wf->neq; i++) oi[i] = init_fn_ord(0);
-  }
 
-  // Order of the shape functions.
-  Func<Ord> ou = init_fn_ord(fu->get_fn_order());
-  Func<Ord> ov = init_fn_ord(fv->get_fn_order());
+    // Order of the shape functions.
+    Func<Ord> ou = init_fn_ord(fu->get_fn_order());
+    Func<Ord> ov = init_fn_ord(fv->get_fn_order());
+
+    // Order of additional external functions.
+    ExtData<Ord> fake_ext;
+    init_ext_fns(fake_ext, mfs->ext);
+
+    // Order of geometric attributes (eg. for multiplication of a solution with coordinates, normals, etc.).
+    double fake_wt = 1.0;
+    Geom<Ord> fake_e = init_geom(surf_pos->marker);
 
-  // Order of additional external functions.
-  ExtData<Ord> fake_ext;
-  init_ext_fns(fake_ext, mfs->ext);
+    // Total order of the surface matrix form.
+    Ord o = mfs->ord(1, &fake_wt, &oi, &ou, &ov, &fake_e, &fake_ext);
 
-  // Order of geometric attributes (eg. for multiplication of a solution with coordinates, normals, etc.).
-  double fake_wt = 1.0;
-  Geom<Ord> fake_e = init_geom(surf_pos->marker);
+    // Clean up.
+    for (int i = 0; i < wf->neq; i++) free_fn(oi + i);
+    delete [] oi;
+    free_fn(&ou);
+    free_fn(&ov);
 
-  // Total order of the surface matrix form.
-  Ord o = mfs->ord(1, &fake_wt, &oi, &ou, &ov, &fake_e, &fake_ext);
+    *form_order = o.get_order();
+  }
 
   // Increase due to reference map.
   Ord3 order = ru->get_inv_ref_order();
   switch (order.type) 
   {
-    case MODE_TETRAHEDRON: order += Ord3(o.get_order()); break;
-    case MODE_HEXAHEDRON: order += Ord3(o.get_order(), o.get_order(), o.get_order()); break;
+    case MODE_TETRAHEDRON: order += Ord3(*form_order); break;
+    case MODE_HEXAHEDRON: order += Ord3(*form_order, *form_order, *form_order); break;
   }
   order.limit();
   Ord2 face_order = order.get_face_order(surf_pos->surf_num);
   int ord_idx = face_order.get_idx();
 
-  // Clean up.
-  for (int i = 0; i < wf->neq; i++) free_fn(oi + i);
-  delete [] oi;
-  free_fn(&ou);
-  free_fn(&ov);
-
   // Evaluate the form using the quadrature of the just calculated order.
   Quad3D *quad = get_quadrature(fu->get_active_element()->get_mode());
   int np = quad->get_face_num_points(surf_pos->surf_num, face_order);
@@ -1003,51 +1828,57 @@ scalar DiscreteProblem::eval_form(WeakForm::VectorFormSurf *vfs, Tuple<Solution
   _F_
 
   // Determine the integration order.
-  Func<Ord> *oi = new Func<Ord>[wf->neq];
-
-  // Order of solutions from the previous Newton iteration.
-  if (u_ext != Tuple<Solution *>()) 
+  int *form_order = get_cached_order(vfs, u_ext, 0, fv->get_fn_order().get_ord(), vfs->ext, surf_pos->marker);
+  if (*form_order < 0)
   {
-    for (int i = 0; i < wf->neq; i++) 
+    Func<Ord> *oi = new Func<Ord>[wf->neq];
+
+    // Order of solutions from the previous Newton iteration.
+    if (u_ext != Tuple<Solution *>()) 
+    {
+      for (int i = 0; i < wf->neq; i++) 
+      {
+        if (u_ext[i] != NULL) oi[i] = init_fn_ord(u_ext[i]->get_fn_order());
+        else oi[i] = init_fn_ord(0);
+      }
+    } 
+    else 
     {
-      if (u_ext[i] != NULL) oi[i] = init_fn_ord(u_ext[i]->get_fn_order());
-      else oi[i] = init_fn_ord(0);
+      for (int i = 0; i < wf->neq; i++) oi[i] = init_fn_ord(0);
     }
-  } 
-  else 
-  {
-    for (int i = 0; i < wf->neq; i++) oi[i] = init_fn_ord(0);
-  }
 
-  // Order of the shape function.
-  Func<Ord> ov = init_fn_ord(fv->get_fn_order());
+    // Order of the shape function.
+    Func<Ord> ov = init_fn_ord(fv->get_fn_order());
+
+    // Order of additional external functions.
+    ExtData<Ord> fake_ext;
+    init_ext_fns(fake_ext, vfs->ext);
+
+    // Order of geometric attributes (eg. for multiplication of a solution with coordinates, normals, etc.).
+    double fake_wt = 1.0;
+    Geom<Ord> fake_e = init_geom(surf_pos->marker);
 
-  // Order of additional external functions.
-  ExtData<Ord> fake_ext;
-  init_ext_fns(fake_ext, vfs->ext);
+    // Total order of the surface vector form.
+    Ord o = vfs->ord(1, &fake_wt, &oi, &ov, &fake_e, &fake_ext);
 
-  // Order of geometric attributes (eg. for multiplication of a solution with coordinates, normals, etc.).
-  double fake_wt = 1.0;
-  Geom<Ord> fake_e = init_geom(surf_pos->marker);
+    // Clean up.
+    for (int i = 0; i < wf->neq; i++) free_fn(oi + i);
+    delete [] oi;
+    free_fn(&ov);
 
-  // Total order of the surface vector form.
-  Ord o = vfs->ord(1, &fake_wt, &oi, &ov, &fake_e, &fake_ext);
+    *form_order = o.get_order();
+  }
 
   // Increase due to reference map.
   Ord3 order = rv->get_inv_ref_order();
   switch (order.type) 
   {
-    case MODE_TETRAHEDRON: order += Ord3(o.get_order()); break;
-    case MODE_HEXAHEDRON: order += Ord3(o.get_order(), o.get_order(), o.get_order()); break;
+    case MODE_TETRAHEDRON: order += Ord3(*form_order); break;
+    case MODE_HEXAHEDRON: order += Ord3(*form_order, *form_order, *form_order); break;
   }
   order.limit();
   Ord2 face_order = order.get_face_order(surf_pos->surf_num);
   int ord_idx = face_order.get_idx();
- 
-  // Clean up.
-  for (int i = 0; i < wf->neq; i++) free_fn(oi + i);
-  delete [] oi;
-  free_fn(&ov);
 
   // Evaluate the form using the quadrature of the just calculated order.
   Quad3D *quad = get_quadrature(fv->get_active_element()->get_mode());
@@ -1121,3 +1952,51 @@ Space* construct_refined_space(Space* coarse, int order_increase, int refinement
   ref_space->copy_orders(*coarse, order_increase);
   return ref_space;
 }
+
+/* BEGIN IDENTICAL CODE WITH H2D */
+
+DiscreteProblemOperator::DiscreteProblemOperator(DiscreteProblem* dp, scalar* coeff_vec, bool finite_differences)
+{
+  _F_
+  if (dp == NULL) error("DiscreteProblem is NULL in DiscreteProblemOperator.");
+  this->dp = dp;
+  this->coeff_vec = coeff_vec;
+  this->finite_differences = finite_differences;
+  f0 = NULL;
+}
+
+DiscreteProblemOperator::~DiscreteProblemOperator()
+{
+  _F_
+  if (f0 != NULL) delete [] f0;
+}
+
+void DiscreteProblemOperator::set_coeff_vec(scalar* coeff_vec)
+{
+  _F_
+  this->coeff_vec = coeff_vec;
+  // the residual belongs to the previous coefficient vector
+  if (f0 != NULL) delete [] f0;
+  f0 = NULL;
+}
+
+void DiscreteProblemOperator::apply(scalar* x, scalar* y)
+{
+  _F_
+  if (!finite_differences)
+  {
+    dp->apply(coeff_vec, x, y);
+    return;
+  }
+
+  // F(Y) is assembled by the first product and kept for the next ones
+  if (f0 == NULL)
+  {
+    f0 = new scalar[dp->get_num_dofs()];
+    MEM_CHECK(f0);
+    dp->assemble_residual(coeff_vec, f0);
+  }
+  dp->apply_fd(coeff_vec, x, y, f0);
+}
+
+/* END IDENTICAL CODE WITH H2D */
@@ -25,12 +25,16 @@
 #include "tuple.h"
 #include "../../hermes_common/array.h"
 #include "../../hermes_common/solver/solver.h"
+#include "../../hermes_common/scatter_map.h"
 
 class Space;
+class AsmList;
 class Matrix;
 class SparseMatrix;
 class Vector;
 class SurfPos;
+class BlockJacobiPrecond;
+class PMultigridPrecond;
 
 /// Discrete problem class
 ///
@@ -57,6 +61,27 @@ public:
 	void assemble(scalar* coeff_vec, SparseMatrix* mat, Vector* rhs = NULL,
                       bool rhsonly = false);
 
+        // Assembling of several right-hand sides in one traversal of the mesh: the vector forms
+        // added to the weak form with the index 'r' are assembled into rhs[r] (see 
+        // WeakForm::add_vector_form()). The Dirichlet lift is subtracted from all of them.
+	void assemble(scalar* coeff_vec, SparseMatrix* mat, Vector** rhs, int nrhs,
+                      bool rhsonly = false);
+
+        // Matrix-free product with the matrix (with the Jacobian matrix at 'coeff_vec' for nonlinear
+        // problems): y = A x is accumulated from the local stiffness matrices element by element,
+        // neither the global matrix nor its sparse structure is created. 'x' and 'y' have
+        // get_num_dofs() entries. The Dirichlet lift is not applied.
+        void apply(scalar* coeff_vec, scalar* x, scalar* y);
+
+        // Finite-difference product with the Jacobian matrix of a nonlinear problem using the residual
+        // vector F (the vector forms) only: y = (F(Y + eps x) - F(Y)) / eps, Y = coeff_vec. 'f0' may hold
+        // F(Y) to save one assembling; eps = 0 selects sqrt(machine epsilon) * (1 + |Y|) / |x|.
+        void apply_fd(scalar* coeff_vec, scalar* x, scalar* y, scalar* f0 = NULL, double eps = 0.0);
+
+        // The residual vector F(Y) of apply_fd() as an array, the sparse structure of the matrix
+        // is not touched.
+        void assemble_residual(scalar* coeff_vec, scalar* f);
+
         // Get the number of unknowns.
 	int get_num_dofs();
 
@@ -64,6 +89,43 @@ public:
   
         void invalidate_matrix() { have_matrix = false; }
 
+        // Precompute scatter maps of local stiffness matrices in create() and use them
+        // (instead of searching the sparse structure) in every assemble() until the
+        // spaces change. Costs one int per entry of every local stiffness matrix.
+        void set_scatter_maps(bool enable = true) { use_scatter_maps = enable; have_matrix = false; }
+
+        // Store only the upper triangle of the matrix if the weak form is symmetric (see
+        // WeakForm::is_sym()) and the matrix supports it. Halves the memory of the matrix
+        // and the scatter traffic; MUMPS and PARDISO then use their symmetric factorizations.
+        void set_symmetric_storage(bool enable = true) { use_sym_storage = enable; have_matrix = false; }
+
+        // Integrate the volume matrix forms by sum factorization on the hexahedra with tensor-product
+        // shapesets (see Shapeset::get_tensor_index()), with the quadrature of the highest orders on
+        // the element. The coefficients of the form in the points are obtained by evaluating it in
+        // each point for unit values of (u, du/dx, du/dy, du/dz) and (v, dv/dx, dv/dy, dv/dz), so the
+        // form has to be a sum over the points of a bilinear function of them (which the usual forms
+        // are). Pays off at higher orders.
+        void set_sum_factorization(bool enable = true) { use_sum_factorization = enable; }
+
+        // Number of the orders of the forms taken from the cache and evaluated by the 'ord'
+        // callbacks in the last assemble() (see get_cached_order()).
+        int get_num_order_cache_hits() { return order_cache_hits; }
+        int get_num_order_cache_misses() { return order_cache_misses; }
+
+        // Number the DOFs of the spaces interleaved (see Space::assign_dofs_interleaved()), so
+        // that the matrix consists of dense (neq x neq) blocks and can be stored in BSRMatrix.
+        // The numbering is applied again by create() whenever the DOFs of the spaces have been
+        // reassigned since (adaptivity, Space::assign_dofs() etc.).
+        void set_interleaved_dofs(bool enable = true);
+
+        // Passes the DOFs of every element (the assembly lists, for each space separately)
+        // to the block Jacobi preconditioner as its diagonal blocks.
+        void get_element_blocks(BlockJacobiPrecond *pc);
+
+        // Passes the levels of the p-multigrid to the preconditioner: level k keeps the DOFs
+        // of the basis functions present in the spaces with all orders decreased by k.
+        void get_p_levels(PMultigridPrecond *pc, int num_levels);
+
 protected:
 	WeakForm* wf;
 
@@ -85,6 +147,20 @@ protected:
         bool struct_changed;
 	bool is_up_to_date();
 
+	bool use_scatter_maps;
+	bool use_sym_storage;
+	bool use_interleaved_dofs;
+	bool use_sum_factorization;
+	ScatterMaps scatter_maps;	/// offsets of local stiffness matrices into 'scatter_mat'
+	SparseMatrix *scatter_mat;	/// the matrix the scatter maps were built for
+	void build_scatter_maps(SparseMatrix *mat);
+	inline int *get_scatter_map(SparseMatrix *mat, int m, int n, int *elem_id);
+
+	bool matrix_free;		/// apply() or apply_fd(): the matrix and its structure are not touched
+	scalar *apply_x;		/// the local stiffness matrices are multiplied by 'apply_x'
+	scalar *apply_y;		/// and added to 'apply_y' instead of the matrix, see apply()
+	void add_to_matrix(SparseMatrix *mat, int m, int n, scalar **block, int *rows, int *cols, int *map);
+
 	// pre-transforming and fn. caching
 	struct fn_key_t {
 		int index;
@@ -111,6 +187,17 @@ protected:
 		void free();
 	} fn_cache;
 
+	// The order of a form depends only on the orders of its arguments (and on the marker
+	// passed in the geometry), so its 'ord' callback is evaluated once for every combination
+	// of them (per form, cleared in assemble()).
+	std::map<void *, std::map<std::vector<int>, int> > order_cache;
+	std::vector<int> order_key;
+	int order_cache_hits, order_cache_misses;
+	int *get_cached_order(void *form, Tuple<Solution *> &u_ext, int ou, int ov,
+	                      std::vector<MeshFunction *> &ext, int marker);
+
+	int calc_order_matrix_form_vol(WeakForm::MatrixFormVol *mfv, Tuple<Solution *> u_ext,
+	                               const Ord3 &ou, const Ord3 &ov, int marker);
 	scalar eval_form(WeakForm::MatrixFormVol *mfv, Tuple<Solution *> u_ext, ShapeFunction *fu,
 	                 ShapeFunction *fv, RefMap *ru, RefMap *rv);
 	scalar eval_form(WeakForm::VectorFormVol *vfv, Tuple<Solution *> u_ext, ShapeFunction *fv, RefMap *rv);
@@ -127,6 +214,61 @@ protected:
 	void init_ext_fns(ExtData<Ord> &fake_ud, std::vector<MeshFunction *> &ext);
 	void init_ext_fns(ExtData<scalar> &ud, std::vector<MeshFunction *> &ext, int order,
 	                  RefMap *rm, const int np, const QuadPt3D *pt);
+
+	// Volume matrix forms on the hexahedra with tensor-product shapesets by sum factorization (see
+	// set_sum_factorization()): the shape functions are products of 1D functions and the quadrature
+	// is the Cartesian product of 1D rules, so the integrals are computed one direction at a time.
+	// The local matrix then costs O(p^7) operations instead of O(p^9), the matrix-free product
+	// (apply()) O(p^4) per element without the local matrix.
+	struct TensorSide {
+		int p;				// number of the 1D functions (the highest index + 1)
+		std::vector<int> idx[3];	// tensor indices of the shape functions of the assembly list
+		std::vector<double> sign;
+		std::vector<double> tab[3][2];	// 1D values [0] and derivatives [1] in the points of the
+						// 1D rules in x, y, z, [a * n + i]
+	};
+	TensorSide tensor_u, tensor_v;
+	int tensor_n[3];			// numbers of the points of the 1D rules in x, y, z
+	int tensor_nk, tensor_kidx[16];		// the pairs (c, d) with nonzero coefficients
+	std::vector<scalar> tensor_k;		// their coefficients |J| w (T_u^T C T_v)_cd in the points
+	std::vector<scalar> tensor_c;		// the matrices C of the form in the points, [16 * p]
+	std::vector<scalar> tensor_tmp, tensor_tmp2, tensor_grid, tensor_in, tensor_out, tensor_xl, tensor_yl;
+	bool can_use_tensor_form(ShapeFunction *fu, ShapeFunction *fv, AsmList *an, AsmList *am,
+	                         RefMap *ru, RefMap *rv);
+	void init_tensor_side(TensorSide &s, ShapeFunction *f, AsmList *al, QuadPt1D *pt1[3]);
+	void get_point_coefs(WeakForm::MatrixFormVol *mfv, Tuple<Solution *> u_ext, RefMap *ru, RefMap *rv,
+	                     const Ord3 &order);
+	void init_tensor_form(WeakForm::MatrixFormVol *mfv, Tuple<Solution *> u_ext, ShapeFunction *fu,
+	                      ShapeFunction *fv, AsmList *an, AsmList *am, RefMap *ru, RefMap *rv);
+	void eval_tensor_form(WeakForm::MatrixFormVol *mfv, Tuple<Solution *> u_ext, ShapeFunction *fu,
+	                      ShapeFunction *fv, AsmList *an, AsmList *am, RefMap *ru, RefMap *rv, scalar **mat);
+	void apply_tensor_form(WeakForm::MatrixFormVol *mfv, Tuple<Solution *> u_ext, ShapeFunction *fu,
+	                       ShapeFunction *fv, AsmList *an, AsmList *am, RefMap *ru, RefMap *rv, int sym);
+	void apply_tensor(TensorSide &from, TensorSide &to, bool transpose, scalar *x, scalar *y);
+};
+
+/// The matrix of a DiscreteProblem (the Jacobian matrix at a coefficient vector for nonlinear
+/// problems) as a MatrixFreeOperator, e.g. for KrylovSolver without an assembled matrix. The
+/// products are computed by DiscreteProblem::apply(), or by DiscreteProblem::apply_fd() if
+/// 'finite_differences' is set (the residual at the coefficient vector is assembled once).
+class HERMES_API DiscreteProblemOperator : public MatrixFreeOperator
+{
+public:
+  DiscreteProblemOperator(DiscreteProblem* dp, scalar* coeff_vec = NULL, bool finite_differences = false);
+  virtual ~DiscreteProblemOperator();
+
+  // The coefficient vector the Jacobian matrix is taken at (not copied, set it again when
+  // it changes).
+  void set_coeff_vec(scalar* coeff_vec);
+
+  virtual int get_size() { return dp->get_num_dofs(); }
+  virtual void apply(scalar* x, scalar* y);
+
+protected:
+  DiscreteProblem* dp;
+  scalar* coeff_vec;
+  bool finite_differences;
+  scalar* f0;                  /// the residual at 'coeff_vec' for the finite differences
 };
 
 HERMES_API Tuple<Space *> * construct_refined_spaces(Tuple<Space *> coarse, int order_increase, int refinement);
@@ -0,0 +1,129 @@
+// This file is part of Hermes3D
+//
+// Copyright (c) 2009 hp-FEM group at the University of Nevada, Reno (UNR).
+// Email: hpfem-group@unr.edu, home page: http://hpfem.org/.
+//
+// Hermes3D is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published
+// by the Free Software Foundation; either version 2 of the License,
+// or (at your option) any later version.
+//
+// Hermes3D is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Hermes3D; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include "h3d_common.h"
+#include "element_index.h"
+#include "../../hermes_common/callstack.h"
+#include <algorithm>
+
+// maximum number of elements in a leaf of the hierarchy
+static const int LEAF_SIZE = 8;
+
+ElementIndex::ElementIndex(Mesh *mesh) {
+	_F_
+	this->mesh = mesh;
+	seq = mesh->get_seq();
+
+	FOR_ALL_ACTIVE_ELEMENTS(idx, mesh) {
+		Element *e = mesh->elements[idx];
+		Item it;
+		it.e = e;
+		for (int i = 0; i < e->get_num_vertices(); i++) {
+			Vertex *v = mesh->vertices[e->get_vertex(i)];
+			double c[3] = { v->x, v->y, v->z };
+			for (int k = 0; k < 3; k++) {
+				if (i == 0 || c[k] < it.box[k]) it.box[k] = c[k];
+				if (i == 0 || c[k] > it.box[k + 3]) it.box[k + 3] = c[k];
+			}
+		}
+		items.push_back(it);
+	}
+
+	nodes.reserve(2 * (items.size() / LEAF_SIZE + 1));
+	if (items.size()) build(0, items.size());
+}
+
+// orders the items by the center of their boxes in one direction
+struct ItemCenterLess {
+	int dir;
+	ItemCenterLess(int dir) : dir(dir) { }
+	template<typename T>
+	bool operator()(const T &a, const T &b) const {
+		return a.box[dir] + a.box[dir + 3] < b.box[dir] + b.box[dir + 3];
+	}
+};
+
+int ElementIndex::build(int first, int count) {
+	_F_
+	int id = nodes.size();
+	nodes.push_back(Node());
+
+	double box[6];
+	memcpy(box, items[first].box, sizeof(box));
+	for (int i = first + 1; i < first + count; i++)
+		for (int k = 0; k < 3; k++) {
+			box[k] = std::min(box[k], items[i].box[k]);
+			box[k + 3] = std::max(box[k + 3], items[i].box[k + 3]);
+		}
+	memcpy(nodes[id].box, box, sizeof(box));
+
+	if (count <= LEAF_SIZE) {
+		nodes[id].first = first;
+		nodes[id].count = count;
+		nodes[id].left = nodes[id].right = -1;
+		return id;
+	}
+
+	// split at the median of the element centers along the longest side
+	int dir = 0;
+	for (int k = 1; k < 3; k++)
+		if (box[k + 3] - box[k] > box[dir + 3] - box[dir]) dir = k;
+	int half = count / 2;
+	std::nth_element(items.begin() + first, items.begin() + first + half,
+	                 items.begin() + first + count, ItemCenterLess(dir));
+
+	int left = build(first, half);
+	int right = build(first + half, count - half);
+	nodes[id].first = first;
+	nodes[id].count = 0;
+	nodes[id].left = left;
+	nodes[id].right = right;
+	return id;
+}
+
+static inline bool box_contains(const double *box, double x, double y, double z) {
+	return x >= box[0] && x <= box[3] && y >= box[1] && y <= box[4] && z >= box[2] && z <= box[5];
+}
+
+void ElementIndex::find(double x, double y, double z, std::vector<Element *> &result) const {
+	if (nodes.empty()) return;
+
+	int stack[64], top = 0;
+	stack[top++] = 0;
+	while (top > 0) {
+		const Node &n = nodes[stack[--top]];
+		if (!box_contains(n.box, x, y, z)) continue;
+		if (n.count > 0) {
+			for (int i = n.first; i < n.first + n.count; i++)
+				if (box_contains(items[i].box, x, y, z))
+					result.push_back(items[i].e);
+		}
+		else {
+			stack[top++] = n.right;
+			stack[top++] = n.left;
+		}
+	}
+}
+
+void ElementIndex::get_bbox(double *lo, double *hi) const {
+	for (int k = 0; k < 3; k++) {
+		lo[k] = nodes.empty() ? 0.0 : nodes[0].box[k];
+		hi[k] = nodes.empty() ? 0.0 : nodes[0].box[k + 3];
+	}
+}
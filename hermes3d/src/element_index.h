@@ -0,0 +1,67 @@
+// This file is part of Hermes3D
+//
+// Copyright (c) 2009 hp-FEM group at the University of Nevada, Reno (UNR).
+// Email: hpfem-group@unr.edu, home page: http://hpfem.org/.
+//
+// Hermes3D is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published
+// by the Free Software Foundation; either version 2 of the License,
+// or (at your option) any later version.
+//
+// Hermes3D is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Hermes3D; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#ifndef _ELEMENT_INDEX_H_
+#define _ELEMENT_INDEX_H_
+
+#include "h3d_common.h"
+#include "mesh.h"
+
+/// Bounding box hierarchy over the active elements of a mesh
+///
+/// Used by Solution::get_phys_value() to find the elements which may contain a physical point.
+/// The elements have straight edges, so the boxes of their vertices are exact. The boxes are
+/// split at the median of the element centers along the longest side of the enclosing box, so
+/// unlike an octree no element is stored twice. The index describes one state of the mesh,
+/// it has to be rebuilt when the mesh changes (see is_current()).
+///
+class HERMES_API ElementIndex {
+public:
+	ElementIndex(Mesh *mesh);
+
+	/// @return true if the index was built for the current state of 'mesh'
+	bool is_current(Mesh *mesh) const { return this->mesh == mesh && seq == mesh->get_seq(); }
+
+	/// Appends to 'result' all active elements whose bounding boxes contain the point (x, y, z).
+	void find(double x, double y, double z, std::vector<Element *> &result) const;
+
+	/// Gets the bounding box of the whole mesh (min. and max. coordinates).
+	void get_bbox(double *lo, double *hi) const;
+
+protected:
+	struct Item {
+		Element *e;
+		double box[6];		// xmin, ymin, zmin, xmax, ymax, zmax
+	};
+
+	struct Node {
+		double box[6];
+		int first, count;	// range of 'items' (leaves only)
+		int left, right;	// children (inner nodes only, count == 0)
+	};
+
+	Mesh *mesh;
+	int seq;
+	std::vector<Item> items;
+	std::vector<Node> nodes;
+
+	int build(int first, int count);
+};
+
+#endif
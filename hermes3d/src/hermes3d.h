@@ -34,6 +34,10 @@
 #include "../../hermes_common/solver/solver.h"
 #include "../../hermes_common/solver/umfpack_solver.h"
 #include "../../hermes_common/solver/superlu.h"
+#include "../../hermes_common/solver/mixed_precision.h"
+#include "../../hermes_common/solver/eigensolver.h"
+#include "../../hermes_common/solver/krylov.h"
+#include "../../hermes_common/solver/bsr.h"
 #include "../../hermes_common/solver/pardiso.h"
 #include "../../hermes_common/solver/petsc.h"
 #include "../../hermes_common/solver/epetra.h"
@@ -46,6 +50,7 @@
 #include "../../hermes_common/solver/precond.h"
 #include "../../hermes_common/solver/precond_ifpack.h"
 #include "../../hermes_common/solver/precond_ml.h"
+#include "../../hermes_common/solver/precond_native.h"
 
 #include "h3d_common.h"
 
@@ -104,6 +109,7 @@
 #include "adapt/h1projipol.h"
 
 #include "ogprojection.h"
+#include "newton_solver.h"
 
 // global H3D iface
 void set_verbose(bool verb = true);
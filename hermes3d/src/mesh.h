@@ -720,6 +720,7 @@ protected:
 
 	friend class Space;
 	friend class WeakForm;
+	friend class ElementIndex;
 };
 
 
@@ -0,0 +1,96 @@
+// This file is part of Hermes3D
+//
+// Copyright (c) 2009 hp-FEM group at the University of Nevada, Reno (UNR).
+// Email: hpfem-group@unr.edu, home page: http://hpfem.org/.
+//
+// Hermes3D is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published
+// by the Free Software Foundation; either version 2 of the License,
+// or (at your option) any later version.
+//
+// Hermes3D is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Hermes3D; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#ifndef __H3D_NEWTON_SOLVER_H
+#define __H3D_NEWTON_SOLVER_H
+
+#include "discrete_problem.h"
+
+/// Newton's method for the nonlinear problem given by a DiscreteProblem
+///
+/// Every iteration assembles the Jacobian matrix J and the residual vector F for the current
+/// coefficient vector Y, solves J dY = -F and adds dY to Y, until the l2 norm of F is below
+/// the tolerance. The matrix, the right-hand side and the linear solver are owned by the class.
+///
+class HERMES_API NewtonSolver
+{
+public:
+  NewtonSolver(DiscreteProblem* dp, MatrixSolverType matrix_solver = SOLVER_UMFPACK);
+  virtual ~NewtonSolver();
+
+  // The iteration stops when the l2 norm of the residual vector is below 'tol'.
+  void set_tolerance(double tol) { this->tol = tol; }
+  void set_max_iters(int max_iters) { this->max_iters = max_iters; }
+
+  // Modified Newton's method: the Jacobian matrix and its factorization are reused in 'k'
+  // consecutive iterations (k = 1 is the full Newton's method), only the residual vector is
+  // assembled in the iterations in between (see DiscreteProblem::assemble(), 'rhsonly').
+  void set_jacobian_reuse(int k) { jacobian_reuse = std::max(k, 1); }
+
+  // Backtracking: the update dY is halved (at most 'max_halvings' times) until the l2 norm of
+  // the residual decreases. Costs one assembling of the residual vector per trial.
+  void set_damping(bool enable = true, int max_halvings = 10)
+  { damping = enable; this->max_halvings = max_halvings; }
+
+  // Report the residual of every iteration (info()).
+  void set_verbose_output(bool verbose) { verbose_output = verbose; }
+
+  // Iterates from the coefficient vector 'coeff_vec', which is updated in place. Returns false
+  // if the iteration did not converge in 'max_iters' iterations or the linear solver failed.
+  bool solve(scalar* coeff_vec);
+
+  // The iterations of the last solve() (the last one only checks the residual): the l2 norm
+  // of the residual at the beginning of the iteration, whether the Jacobian matrix was assembled,
+  // the damping factor of the update and the time spent on assembling and in the linear solver.
+  struct IterInfo
+  {
+    double residual_norm;
+    bool jacobian;
+    double damping;
+    double assembly_time;
+    double solver_time;
+  };
+  const std::vector<IterInfo> &get_iter_info() { return iter_info; }
+  int get_num_iters() { return iter_info.size(); }
+  double get_residual_norm() { return iter_info.empty() ? -1.0 : iter_info.back().residual_norm; }
+  double get_assembly_time();
+  double get_solver_time();
+
+  SparseMatrix* get_matrix() { return matrix; }
+  Vector* get_rhs() { return rhs; }
+
+protected:
+  DiscreteProblem* dp;
+  SparseMatrix* matrix;
+  Vector* rhs;
+  Solver* solver;
+
+  double tol;
+  int max_iters;
+  int jacobian_reuse;
+  bool damping;
+  int max_halvings;
+  bool verbose_output;
+
+  std::vector<IterInfo> iter_info;
+
+  double get_rhs_norm();
+};
+
+#endif
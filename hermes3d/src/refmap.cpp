@@ -246,6 +246,61 @@ double3x3 *RefMap::get_inv_ref_map(const int np, const QuadPt3D *pt) {
 	return irm;
 }
 
+void RefMap::untransform(double x, double y, double z, double &xi1, double &xi2, double &xi3) {
+	_F_
+	const double TOL = 1e-12;
+	const Point3D *rv = (element->get_mode() == MODE_HEXAHEDRON) ? RefHex::get_vertices() : RefTetra::get_vertices();
+	int nv = element->get_num_vertices();
+
+	// Newton's method on the vertex map (trilinear for hexahedra, affine for tetrahedra,
+	// where it converges in one step)
+	double xi[3] = { 0.0, 0.0, 0.0 };
+	for (int it = 0; it <= 100; it++) {
+		double p[3] = { -x, -y, -z };
+		double3x3 m;
+		memset(m, 0, sizeof(double3x3));
+		for (int i = 0; i < nv; i++) {
+			double f[3], d[3];
+			if (element->get_mode() == MODE_HEXAHEDRON) {
+				double l[3] = { 1.0 + rv[i].x * xi[0], 1.0 + rv[i].y * xi[1], 1.0 + rv[i].z * xi[2] };
+				f[0] = l[0] * l[1] * l[2] / 8.0;
+				d[0] = rv[i].x * l[1] * l[2] / 8.0;
+				d[1] = l[0] * rv[i].y * l[2] / 8.0;
+				d[2] = l[0] * l[1] * rv[i].z / 8.0;
+			}
+			else {
+				// barycentric coordinates on the reference tetrahedron
+				d[0] = d[1] = d[2] = 0.0;
+				if (i == 0) { f[0] = -(xi[0] + xi[1] + xi[2] + 1.0) / 2.0; d[0] = d[1] = d[2] = -0.5; }
+				else { f[0] = (xi[i - 1] + 1.0) / 2.0; d[i - 1] = 0.5; }
+			}
+			double c[3] = { vertex[i].x, vertex[i].y, vertex[i].z };
+			for (int k = 0; k < 3; k++) {
+				p[k] += c[k] * f[0];
+				for (int l = 0; l < 3; l++)
+					m[k][l] += c[k] * d[l];
+			}
+		}
+
+		// solve m * dxi = p by Cramer's rule
+		double ij = 1.0 / det(m);
+		double dxi[3];
+		for (int l = 0; l < 3; l++) {
+			double3x3 ml;
+			memcpy(ml, m, sizeof(double3x3));
+			for (int k = 0; k < 3; k++) ml[k][l] = p[k];
+			dxi[l] = det(ml) * ij;
+		}
+		for (int l = 0; l < 3; l++) xi[l] -= dxi[l];
+
+		xi1 = xi[0]; xi2 = xi[1]; xi3 = xi[2];
+		if (fabs(dxi[0]) < TOL && fabs(dxi[1]) < TOL && fabs(dxi[2]) < TOL) return;
+		// far outside of the element, the point can not lie inside
+		if (it > 1 && (fabs(xi[0]) > 1.5 || fabs(xi[1]) > 1.5 || fabs(xi[2]) > 1.5)) return;
+	}
+	warning("Could not find reference coordinates - Newton method did not converge.");
+}
+
 double *RefMap::get_phys_x(const int np, const QuadPt3D *pt) {
 	_F_
 	// transform all x coordinates of the integration points
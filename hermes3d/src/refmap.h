@@ -92,6 +92,10 @@ public:
 	/// @param[in] trans - set to true if you want transformed values
 	double *get_face_jacobian(int face, const int np, const QuadPt3D *pt, bool trans = true);
 
+	/// Finds the reference coordinates (xi1, xi2, xi3) of the physical point (x, y, z) with respect
+	/// to the active element. The point lies in the element iff the result is in the reference domain.
+	void untransform(double x, double y, double z, double &xi1, double &xi2, double &xi3);
+
 	/// Calculate normals on the face
 	void calc_face_normal(int iface, const int np, const QuadPt3D *pt, double *&nx, double *&ny, double *&nz);
 
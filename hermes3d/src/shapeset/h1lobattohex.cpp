@@ -285,6 +285,32 @@ Ord3 H1ShapesetLobattoHex::get_dcmp(int index) const
 		return Ord3(-1);
 }
 
+bool H1ShapesetLobattoHex::get_tensor_index(int index, int idx[3], double &sign) const
+{
+	_F_
+#ifdef WITH_HEX
+	if (index < 0) return false;
+	int oris[3];
+	decompose(h1_hex_index_t(index), idx, oris);
+	// l_a(-x) = (-1)^a l_a(x) for the functions of degree a >= 2 (the only oriented ones)
+	sign = 1.0;
+	for (int k = 0; k < 3; k++)
+		if (oris[k]) {
+			assert(idx[k] >= 2);
+			if (idx[k] % 2 == 1) sign = -sign;
+		}
+	return true;
+#else
+	return false;
+#endif
+}
+
+double H1ShapesetLobattoHex::get_tensor_value_1d(int n, int a, double x) const
+{
+	assert(n == 0 || n == 1);
+	return (n == 0) ? lobatto_fn_tab_1d[a](x) : lobatto_der_tab_1d[a](x);
+}
+
 int H1ShapesetLobattoHex::get_shape_type(int index) const
 {
 	_F_
@@ -74,6 +74,10 @@ public:
 
 	virtual Ord3 get_dcmp(int index) const;
 
+	virtual bool get_tensor_index(int index, int idx[3], double &sign) const;
+
+	virtual double get_tensor_value_1d(int n, int a, double x) const;
+
 	virtual int get_shape_type(int index) const;
 
 	virtual void get_values(int n, int index, int np, QuadPt3D *pt, int component, double *vals) {
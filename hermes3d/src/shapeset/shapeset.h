@@ -188,6 +188,14 @@ public:
 	/// Get function decomposition for product shapesets
 	virtual Ord3 get_dcmp(int index) const = 0;
 
+	/// Tensor-product shapesets: returns true if the shape function 'index' is
+	/// sign * f_a(x) * f_b(y) * f_c(z), idx = (a, b, c), with the 1D functions f of
+	/// get_tensor_value_1d() (the orientation of the function included), false otherwise.
+	virtual bool get_tensor_index(int index, int idx[3], double &sign) const { return false; }
+
+	/// Value (n = 0) or derivative (n = 1) of the 1D function 'a' of a tensor-product shapeset.
+	virtual double get_tensor_value_1d(int n, int a, double x) const { return 0.0; }
+
 	/// Get index of a constrained edge function.
 	/// @return The index of a constrained edge function.
 	/// @param[in] edge The local number of an edge.
@@ -21,6 +21,7 @@
 #include "solution.h"
 #include "function.cpp" // non-inline template members
 #include "quadcheb.h"
+#include "element_index.h"
 #include "../../hermes_common/error.h"
 #include "../../hermes_common/matrix.h"
 #include "../../hermes_common/callstack.h"
@@ -99,6 +100,8 @@ Solution::Solution(Mesh *mesh) : MeshFunction(mesh) {
 	dxdydz_buffer = NULL;
 	num_coefs = num_elems = 0;
 	num_dofs = -1;
+	pt_last = NULL;
+	pt_index = NULL;
 }
 
 Solution::~Solution() {
@@ -119,6 +122,9 @@ void Solution::free() {
 			delete [] elem_coefs[i];
 			elem_coefs[i] = NULL;
 		}
+
+	pt_last = NULL;
+	if (pt_index != NULL) { delete pt_index; pt_index = NULL; }
 }
 
 void Solution::assign(Solution *sln) {
@@ -866,6 +872,102 @@ void Solution::enable_transform(bool enable) {
 	transform = enable;
 }
 
+static inline bool is_in_ref_domain(Element *e, double xi1, double xi2, double xi3) {
+	const double TOL = 1e-11;
+	if (e->get_mode() == MODE_TETRAHEDRON)
+		return xi1 + xi2 + xi3 <= -1.0 + TOL && xi1 >= -1.0 - TOL && xi2 >= -1.0 - TOL && xi3 >= -1.0 - TOL;
+	return fabs(xi1) <= 1.0 + TOL && fabs(xi2) <= 1.0 + TOL && fabs(xi3) <= 1.0 + TOL;
+}
+
+Element *Solution::find_pt_element(double x, double y, double z, double &xi1, double &xi2, double &xi3) {
+	_F_
+	// the index (and the last found element) belong to one state of the mesh
+	if (pt_index == NULL || !pt_index->is_current(mesh)) {
+		delete pt_index;
+		pt_index = new ElementIndex(mesh);
+		pt_last = NULL;
+	}
+
+	// try the last found element first
+	if (pt_last != NULL) {
+		refmap->set_active_element(pt_last);
+		refmap->untransform(x, y, z, xi1, xi2, xi3);
+		if (is_in_ref_domain(pt_last, xi1, xi2, xi3)) return pt_last;
+	}
+
+	pt_candidates.clear();
+	pt_index->find(x, y, z, pt_candidates);
+	for (unsigned int i = 0; i < pt_candidates.size(); i++) {
+		Element *e = pt_candidates[i];
+		if (e == pt_last) continue;
+		refmap->set_active_element(e);
+		refmap->untransform(x, y, z, xi1, xi2, xi3);
+		if (is_in_ref_domain(e, xi1, xi2, xi3)) return pt_last = e;
+	}
+
+	return NULL;
+}
+
+scalar Solution::get_phys_value(double x, double y, double z, int comp) {
+	_F_
+	if (type == HERMES_UNDEF) EXIT("Cannot obtain values -- uninitialized solution.");
+
+	double xi1, xi2, xi3;
+	Element *e = find_pt_element(x, y, z, xi1, xi2, xi3);
+	if (e == NULL) {
+		warning("Point (%g, %g, %g) does not lie in any element.", x, y, z);
+		return NAN;
+	}
+	set_active_element(e);
+	return get_pt_value(xi1, xi2, xi3, comp);
+}
+
+// spreads the lower 10 bits of 'x' to every third bit (3D Z-order curve)
+static inline unsigned spread_bits(unsigned x) {
+	unsigned r = 0;
+	for (int i = 0; i < 10; i++)
+		r |= ((x >> i) & 1) << (3 * i);
+	return r;
+}
+
+void Solution::get_phys_values(int n, double *x, double *y, double *z, int comp, scalar *val) {
+	_F_
+	if (n <= 1) {
+		for (int i = 0; i < n; i++) val[i] = get_phys_value(x[i], y[i], z[i], comp);
+		return;
+	}
+
+	// sort the points along a Z-order curve over the bounding box of the mesh, so that
+	// the search mostly succeeds already with the last found element
+	if (pt_index == NULL || !pt_index->is_current(mesh)) {
+		delete pt_index;
+		pt_index = new ElementIndex(mesh);
+		pt_last = NULL;
+	}
+	double lo[3], hi[3];
+	pt_index->get_bbox(lo, hi);
+	double scale[3];
+	for (int k = 0; k < 3; k++) scale[k] = (hi[k] > lo[k]) ? 1023.0 / (hi[k] - lo[k]) : 0.0;
+
+	std::vector<std::pair<unsigned, int> > order(n);
+	for (int i = 0; i < n; i++) {
+		double pt[3] = { x[i], y[i], z[i] };
+		unsigned key = 0;
+		for (int k = 0; k < 3; k++) {
+			double q = std::max(0.0, std::min(1023.0, (pt[k] - lo[k]) * scale[k]));
+			key |= spread_bits((unsigned) q) << k;
+		}
+		order[i].first = key;
+		order[i].second = i;
+	}
+	std::sort(order.begin(), order.end());
+
+	for (int k = 0; k < n; k++) {
+		int i = order[k].second;
+		val[i] = get_phys_value(x[i], y[i], z[i], comp);
+	}
+}
+
 Ord3 Solution::get_order()
 {
 	_F_
@@ -26,6 +26,8 @@
 #include "asmlist.h"
 #include "refmap.h"
 
+class ElementIndex;
+
 /// @defgroup solutions Solutions
 ///
 /// TODO: description
@@ -121,6 +123,18 @@ public:
 		return get_fn_values(comp)[0];
 	}
 
+	/// @return The value of the component 'comp' at the physical point (x, y, z) or NAN if
+	/// the point does not lie in the mesh. Unlike get_pt_value(), which takes a point of the
+	/// active element's reference domain, this searches for the element in a bounding box
+	/// hierarchy of the mesh elements (built on the first call and after every mesh change).
+	/// NOTE: This function should be used for postprocessing only.
+	scalar get_phys_value(double x, double y, double z, int comp = 0);
+
+	/// Evaluates get_phys_value() at the points (x[i], y[i], z[i]), i = 0, ..., n-1, into
+	/// 'val'. The points are visited along a space-filling curve, so that consecutive
+	/// points mostly lie in the same element.
+	void get_phys_values(int n, double *x, double *y, double *z, int comp, scalar *val);
+
 	virtual void precalculate(const int np, const QuadPt3D *pt, int mask);
 
 	virtual Ord3 get_order();
@@ -160,6 +174,14 @@ protected:
 	void precalculate_fe(const int np, const QuadPt3D *pt, int mask);
 	void precalculate_exact(const int np, const QuadPt3D *pt, int mask);
 	void precalculate_const(const int np, const QuadPt3D *pt, int mask);
+
+	Element *pt_last;						/// last element found by get_phys_value()
+	ElementIndex *pt_index;					/// element search structure for get_phys_value()
+	std::vector<Element *> pt_candidates;
+
+	/// Finds the active element containing the physical point (x, y, z) and the reference
+	/// coordinates of the point. @return NULL if the point does not lie in the mesh.
+	Element *find_pt_element(double x, double y, double z, double &xi1, double &xi2, double &xi3);
 };
 
 
@@ -170,7 +170,7 @@ void H1Space::assign_dofs_internal() {
 
 // assembly lists ////
 
-void H1Space::get_element_assembly_list(Element *e, AsmList *al) {
+void H1Space::get_element_assembly_list_internal(Element *e, AsmList *al) {
 	_F_
 	al->clear();
 	for (int i = 0; i < e->get_num_vertices(); i++) get_vertex_assembly_list(e, i, al);
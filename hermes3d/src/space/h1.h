@@ -36,7 +36,6 @@ public:
 
   virtual void set_shapeset(Shapeset* shapeset);
 
-   	virtual void get_element_assembly_list(Element *e, AsmList *al);
 	virtual void get_boundary_assembly_list(Element *e, int face, AsmList *al);
 
 protected:
@@ -47,6 +46,8 @@ protected:
 
 	virtual void assign_dofs_internal();
 
+	virtual void get_element_assembly_list_internal(Element *e, AsmList *al);
+
 	virtual void calc_vertex_boundary_projection(Element *elem, int ivertex);
 	virtual void calc_edge_boundary_projection(Element *elem, int iedge);
 	virtual void calc_face_boundary_projection(Element *elem, int iface);
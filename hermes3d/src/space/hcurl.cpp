@@ -125,7 +125,7 @@ void HcurlSpace::assign_dofs_internal() {
 
 // assembly lists ////
 
-void HcurlSpace::get_element_assembly_list(Element *e, AsmList *al) {
+void HcurlSpace::get_element_assembly_list_internal(Element *e, AsmList *al) {
 	_F_
 	al->clear();
 	for (int i = 0; i < e->get_num_edges(); i++) get_edge_assembly_list(e, i, al);
@@ -36,7 +36,6 @@ public:
 
   virtual void set_shapeset(Shapeset* shapeset);
 
-	virtual void get_element_assembly_list(Element *e, AsmList *al);
 	virtual void get_boundary_assembly_list(Element *e, int face, AsmList *al);
 
 protected:
@@ -47,6 +46,8 @@ protected:
 
 	virtual void assign_dofs_internal();
 
+	virtual void get_element_assembly_list_internal(Element *e, AsmList *al);
+
 	// For now we do not implement boundary projections of nonzero functions
 	// it does not have much physical sense (even though some artifical situations
 	// using nonzero dirichlet BC could be considered) and its implementation is
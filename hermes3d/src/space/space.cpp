@@ -122,6 +122,7 @@ Space::Space(Mesh *mesh, Shapeset *shapeset, BCType (*bc_type_callback)(int),
   this->seq = 0;
   this->was_assigned = false;
   this->ndof = 0;
+  this->al_cache_valid = false;
 
   init_data_tables();
 }
@@ -386,6 +387,44 @@ void Space::assign_bubble_dofs(unsigned int idx) {
 
 // assembly lists ////
 
+void Space::get_element_assembly_list(Element *e, AsmList *al) {
+	_F_
+	// the lists are stored only for the assigned DOFs, the elements of other meshes
+	// (with the same id) are not stored
+	if (is_up_to_date()) update_assembly_lists();
+	if (is_up_to_date() && e->id < al_cache_cnt.size() && al_cache_cnt[e->id] >= 0 && mesh->elements[e->id] == e) {
+		int n = al_cache_cnt[e->id], k = al_cache_start[e->id];
+		if (n > 0) al->copy(n, &al_cache_idx[k], &al_cache_dof[k], &al_cache_coef[k]);
+		else al->clear();
+	}
+	else
+		get_element_assembly_list_internal(e, al);
+}
+
+void Space::update_al_cache() {
+	_F_
+	int n = mesh->get_max_element_id() + 1;
+	al_cache_start.assign(n, 0);
+	al_cache_cnt.assign(n, -1);
+	al_cache_idx.clear();
+	al_cache_dof.clear();
+	al_cache_coef.clear();
+
+	AsmList al;
+	FOR_ALL_ACTIVE_ELEMENTS(eid, mesh) {
+		get_element_assembly_list_internal(mesh->elements[eid], &al);
+		al_cache_start[eid] = al_cache_idx.size();
+		al_cache_cnt[eid] = al.cnt;
+		al_cache_idx.insert(al_cache_idx.end(), al.idx, al.idx + al.cnt);
+		al_cache_dof.insert(al_cache_dof.end(), al.dof, al.dof + al.cnt);
+		al_cache_coef.insert(al_cache_coef.end(), al.coef, al.coef + al.cnt);
+	}
+
+	al_cache_seq = seq;
+	al_cache_mesh_seq = mesh->get_seq();
+	al_cache_valid = true;
+}
+
 void Space::get_vertex_assembly_list(Element *e, int ivertex, AsmList *al) {
 	_F_
 	unsigned int vtx = e->get_vertex(ivertex);
@@ -2447,6 +2486,32 @@ int Space::assign_dofs(Tuple<Space*> spaces)
   return ndof;
 }
 
+int Space::assign_dofs_interleaved(Tuple<Space*> spaces)
+{
+  _F_
+  int n = spaces.size();
+  // the spaces have to have the same number of DOFs
+  int ndof = spaces[0]->assign_dofs();
+  for (int i = 1; i < n; i++)
+    if (spaces[i]->assign_dofs() != ndof) {
+      warning("Spaces with different numbers of DOFs cannot be interleaved.");
+      return assign_dofs(spaces);
+    }
+
+  for (int i = 0; i < n; i++)
+    spaces[i]->assign_dofs(i, n);
+  return n * ndof;
+}
+
+bool Space::is_interleaved(Tuple<Space*> spaces)
+{
+  _F_
+  int n = spaces.size();
+  for (int i = 0; i < n; i++)
+    if (spaces[i]->first_dof != i || spaces[i]->stride != n) return false;
+  return true;
+}
+
 int Space::get_num_dofs(Tuple<Space *> spaces)
 {
   _F_
@@ -28,6 +28,7 @@
 #include "../order.h"
 
 #include "../../../hermes_common/bitarray.h"
+#include <vector>
 
 /// @defgroup spaces Spaces
 ///
@@ -119,9 +120,14 @@ public:
   Shapeset *get_shapeset() const { return shapeset; }
   Mesh *get_mesh() const { return mesh; }
 
-  virtual void get_element_assembly_list(Element *e, AsmList *al) = 0;
+  /// Returns the assembly list of the element. The lists of all active elements are built
+  /// at once and stored until the space or its mesh changes (see update_assembly_lists()).
+  virtual void get_element_assembly_list(Element *e, AsmList *al);
   virtual void get_boundary_assembly_list(Element *e, int face, AsmList *al) = 0;
 
+  /// Builds the stored assembly lists of all active elements if they are out of date.
+  void update_assembly_lists() { if (!is_al_cache_current()) update_al_cache(); }
+
   void dump();
 
   /// Returns true if the space is ready for computation, false otherwise.
@@ -135,6 +141,13 @@ public:
 
   static int get_num_dofs(Tuple<Space *> spaces);
   static int assign_dofs(Tuple<Space*> spaces) ;
+  /// Assigns the DOFs of all spaces interleaved: the k-th DOF of the i-th space gets the number
+  /// k * n + i (n is the number of spaces), so the matrix of a system consists of dense (n x n)
+  /// blocks (see BSRMatrix). All spaces must have the same number of DOFs, otherwise they are
+  /// assigned one after another.
+  static int assign_dofs_interleaved(Tuple<Space*> spaces);
+  /// Returns true if the DOFs of the spaces are numbered by assign_dofs_interleaved().
+  static bool is_interleaved(Tuple<Space*> spaces);
 
 protected:
   Shapeset *shapeset;
@@ -146,6 +159,20 @@ protected:
   int seq, mesh_seq;
   bool was_assigned;
 
+  /// Stored element assembly lists (see get_element_assembly_list()), indexed by the element
+  /// id: the list of the element 'id' has al_cache_cnt[id] triples stored from
+  /// al_cache_start[id] in the arrays al_cache_idx, al_cache_dof and al_cache_coef
+  /// (al_cache_cnt[id] is -1 for inactive elements).
+  std::vector<int> al_cache_start, al_cache_cnt;
+  std::vector<long int> al_cache_idx;
+  std::vector<int> al_cache_dof;
+  std::vector<scalar> al_cache_coef;
+  bool al_cache_valid;
+  int al_cache_seq, al_cache_mesh_seq;
+  bool is_al_cache_current() const
+  { return al_cache_valid && al_cache_seq == seq && al_cache_mesh_seq == mesh->get_seq(); }
+  void update_al_cache();
+
   // CED
   struct BaseVertexComponent {
     int dof;
@@ -308,6 +335,8 @@ protected:
 
   virtual void assign_dofs_internal() = 0;
 
+  /// Computes the assembly list of the element (without the stored lists).
+  virtual void get_element_assembly_list_internal(Element *e, AsmList *al) = 0;
   virtual void get_vertex_assembly_list(Element *e, int ivertex, AsmList *al);
   virtual void get_edge_assembly_list(Element *e, int iedge, AsmList *al);
   virtual void get_face_assembly_list(Element *e, int iface, AsmList *al);
@@ -70,26 +70,32 @@ void WeakForm::add_matrix_form_surf(int i, int j, matrix_form_val_t fn, matrix_f
 }
 
 void WeakForm::add_vector_form(int i, vector_form_val_t fn, vector_form_ord_t ord, int area, 
-                               Tuple<MeshFunction*> ext)
+                               Tuple<MeshFunction*> ext, int rhs)
 {
 	_F_
 	if (i < 0 || i >= neq) error("Invalid equation number.");
 	if (area != HERMES_ANY && area < 0 && -area > (signed) areas.size()) error("Invalid area number.");
 
+	if (rhs < 0) error("Invalid right-hand side number.");
+
 	VectorFormVol form = { i, area, fn, ord };
+	form.rhs = rhs;
 	int nx = ext.size();
 	for (int i = 0; i < nx; i++) form.ext.push_back(ext[i]);
 	vfvol.push_back(form);
 }
 
 void WeakForm::add_vector_form_surf(int i, vector_form_val_t fn, vector_form_ord_t ord, int area, 
-                                    Tuple<MeshFunction*> ext)
+                                    Tuple<MeshFunction*> ext, int rhs)
 {
 	_F_
 	if (i < 0 || i >= neq) error("Invalid equation number.");
 	if (area != HERMES_ANY && area < 0 && -area > (signed) areas.size()) error("Invalid area number.");
 
+	if (rhs < 0) error("Invalid right-hand side number.");
+
 	VectorFormSurf form = { i, area, fn, ord };
+	form.rhs = rhs;
 	int nx = ext.size();
 	for (int i = 0; i < nx; i++) form.ext.push_back(ext[i]);
 	vfsurf.push_back(form);
@@ -269,6 +275,15 @@ bool **WeakForm::get_blocks()
   return blocks;
 }
 
+bool WeakForm::is_sym() const
+{
+  _F_
+  if (mfvol.empty() || !mfsurf.empty()) return false;
+  for (unsigned i = 0; i < mfvol.size(); i++)
+    if (mfvol[i].sym != HERMES_SYM) return false;
+  return true;
+}
+
 //// areas /////////////////////////////////////////////////////////////////////////////////////////
 
 int WeakForm::def_area(Tuple<int> area_markers)
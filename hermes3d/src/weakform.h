@@ -81,21 +81,23 @@ public:
 
         }
 
+	// 'rhs' is the index of the right-hand side the form contributes to when several
+	// right-hand sides are assembled at once (see DiscreteProblem::assemble())
 	void add_vector_form(int i, vector_form_val_t fn, vector_form_ord_t ord, int area = HERMES_ANY, 
-                             Tuple<MeshFunction*> ext = Tuple<MeshFunction*> ());
+                             Tuple<MeshFunction*> ext = Tuple<MeshFunction*> (), int rhs = 0);
         // single equation case
 	void add_vector_form(vector_form_val_t fn, vector_form_ord_t ord, int area = HERMES_ANY, 
-                             Tuple<MeshFunction*> ext = Tuple<MeshFunction*> ())
+                             Tuple<MeshFunction*> ext = Tuple<MeshFunction*> (), int rhs = 0)
         {
-  	  add_vector_form(0, fn, ord, area, ext);
+  	  add_vector_form(0, fn, ord, area, ext, rhs);
         };
 	void add_vector_form_surf(int i, vector_form_val_t fn, vector_form_ord_t ord, int area = HERMES_ANY, 
-                                  Tuple<MeshFunction*> ext = Tuple<MeshFunction*> ());
+                                  Tuple<MeshFunction*> ext = Tuple<MeshFunction*> (), int rhs = 0);
         // single equation case
 	void add_vector_form_surf(vector_form_val_t fn, vector_form_ord_t ord, int area = HERMES_ANY, 
-                                  Tuple<MeshFunction*> ext = Tuple<MeshFunction*> ()) 
+                                  Tuple<MeshFunction*> ext = Tuple<MeshFunction*> (), int rhs = 0) 
         {
-	  add_vector_form_surf(0, fn, ord, area, ext); 
+	  add_vector_form_surf(0, fn, ord, area, ext, rhs); 
 
         };
 
@@ -140,12 +142,14 @@ protected:
 		vector_form_val_t fn;
 		vector_form_ord_t ord;
 		std::vector<MeshFunction *> ext;
+		int rhs;			// index of the right-hand side
 	};
 	struct VectorFormSurf {
 		int i, area;
 		vector_form_val_t fn;
 		vector_form_ord_t ord;
 		std::vector<MeshFunction *> ext;
+		int rhs;			// index of the right-hand side
 	};
 
 	std::vector<MatrixFormVol> mfvol;
@@ -181,10 +185,9 @@ protected:
 		return area >= 0 ? area == marker : is_in_area_2(marker, area);
 	}
 
-	bool is_sym() const
-	{
-		return false; /* not impl. yet */
-	}
+	// true if the matrix of the weak form is symmetric: all volume matrix forms are
+	// HERMES_SYM and there are no surface matrix forms
+	bool is_sym() const;
 
 private:
 
@@ -0,0 +1,171 @@
+#define HERMES_REPORT_WARN
+#define HERMES_REPORT_INFO
+#define HERMES_REPORT_VERBOSE
+#include "config.h"
+#include <hermes3d.h>
+
+//  This test makes sure that NewtonSolver works: the nonlinear problem
+//
+//  PDE: stationary heat transfer with nonlinear thermal conductivity
+//  - div[lambda(u) grad u] = 0
+//                lambda(u) = 10 + 0.1 u^2
+//
+//  BC:  u = 100 on all faces but one, du/dn = 0 on the remaining face
+//
+//  Exact solution: u(x,y,z) = 100
+//
+//  is solved from the zero coefficient vector by the Newton's method, by the modified Newton's
+//  method (reusing the Jacobian matrix) and with damping. All have to converge to the exact
+//  solution, the modified method with fewer assemblings of the Jacobian matrix than iterations.
+
+// The following parameters can be changed:
+MatrixSolverType matrix_solver = SOLVER_UMFPACK;  // Possibilities: SOLVER_AMESOS, SOLVER_MUMPS,
+                                                  // SOLVER_PARDISO, SOLVER_PETSC, SOLVER_UMFPACK.
+const double NEWTON_TOL = 1e-8;                   // Stopping criterion for the Newton's method.
+const int NEWTON_MAX_ITER = 100;                  // Maximum allowed number of Newton iterations.
+const int JACOBIAN_REUSE = 3;                     // Iterations with one Jacobian matrix (modified method).
+
+// Error should be smaller than this epsilon.
+#define EPS								10e-10F
+
+#define grad_grad(u, v) (u->dx[i] * v->dx[i] + u->dy[i] * v->dy[i] + u->dz[i] * v->dz[i])
+
+// Thermal conductivity (temperature-dependent).
+// For any u, this function has to be positive in the entire domain!
+template<typename T>
+inline T lambda(T temp)  { return 10 + 0.1 * pow(temp, 2); }
+
+// Derivative of the thermal conductivity with respect to the temperature.
+template<typename T>
+inline T dlambda(T temp) { return 0.2 * temp; }
+
+const int marker_right = 2;
+
+// Boundary condition types.
+BCType bc_types(int marker)
+{
+	if (marker == marker_right) return BC_NATURAL;
+	else return BC_ESSENTIAL;
+}
+
+// Essential (Dirichlet) boundary condition values.
+scalar essential_bc_values(int ess_bdy_marker, double x, double y, double z)
+{
+	return 100.0;
+}
+
+// Jacobian matrix.
+template<typename Real, typename Scalar>
+Scalar jacobian_form(int n, double *wt, Func<Scalar> *u_ext[], Func<Real> *u, Func<Real> *v, Geom<Real> *e,
+                     ExtData<Scalar> *data)
+{
+	Scalar res = 0.0;
+	for (int i = 0; i < n; i++)
+		res += wt[i] *
+			(dlambda(u_ext[0]->val[i]) * u->val[i] * grad_grad(u_ext[0], v) +
+			  lambda(u_ext[0]->val[i]) * grad_grad(u, v));
+	return res;
+}
+
+// Residual vector.
+template<typename Real, typename Scalar>
+Scalar residual_form(int n, double *wt, Func<Scalar> *u_ext[], Func<Real> *v, Geom<Real> *e,
+                     ExtData<Scalar> *data)
+{
+	Scalar res = 0.0;
+	for (int i = 0; i < n; i++)
+		res += wt[i] * (lambda(u_ext[0]->val[i]) * grad_grad(u_ext[0], v));
+	return res;
+}
+
+// Solves the problem from the zero coefficient vector, checks the error of the solution.
+bool solve(const char *name, NewtonSolver *newton, Mesh *mesh, Space *space)
+{
+	int ndof = Space::get_num_dofs(space);
+	scalar *coeff_vec = new scalar[ndof];
+	memset(coeff_vec, 0, ndof * sizeof(scalar));
+
+	bool converged = newton->solve(coeff_vec);
+	int jacobians = 0;
+	for (int i = 0; i < newton->get_num_iters(); i++)
+		if (newton->get_iter_info()[i].jacobian) jacobians++;
+
+	Solution sln(mesh);
+	Solution::vector_to_solution(coeff_vec, space, &sln);
+	Solution ex_sln(mesh);
+	ex_sln.set_const(100.0);
+	double h1_err = h1_error(&sln, &ex_sln);
+	info("%s: %s after %d iterations (%d Jacobian matrices), res. l2 norm %g, H1 error %g", name,
+	     converged ? "converged" : "did not converge", newton->get_num_iters(), jacobians,
+	     newton->get_residual_norm(), h1_err);
+
+	delete [] coeff_vec;
+	return converged && h1_err < EPS;
+}
+
+int main(int argc, char **args)
+{
+  // Test variable.
+  int success_test = 1;
+
+	if (argc < 2) error("Not enough parameters");
+
+  // Load the mesh.
+	Mesh mesh;
+	H3DReader mloader;
+  if (!mloader.load(args[1], &mesh)) error("Loading mesh file '%s'\n", args[1]);
+
+	// Initialize the space.
+	Ord3 order(1, 1, 1);
+	H1Space space(&mesh, bc_types, essential_bc_values, order);
+	info("ndof: %d", Space::get_num_dofs(&space));
+
+  // Initialize the weak formulation.
+	WeakForm wf;
+	wf.add_matrix_form(jacobian_form<double, scalar>, jacobian_form<Ord, Ord>, HERMES_UNSYM);
+	wf.add_vector_form(residual_form<double, scalar>, residual_form<Ord, Ord>);
+
+	// Initialize the FE problem.
+  bool is_linear = false;
+  DiscreteProblem dp(&wf, &space, is_linear);
+
+  // Initialize the solver in the case of SOLVER_PETSC or SOLVER_MUMPS.
+  initialize_solution_environment(matrix_solver, argc, args);
+
+  // Newton's method.
+  NewtonSolver newton(&dp, matrix_solver);
+  newton.set_tolerance(NEWTON_TOL);
+  newton.set_max_iters(NEWTON_MAX_ITER);
+  if (!solve("Newton's method", &newton, &mesh, &space)) success_test = 0;
+  int iters = newton.get_num_iters();
+
+  // Modified Newton's method.
+  NewtonSolver modified(&dp, matrix_solver);
+  modified.set_tolerance(NEWTON_TOL);
+  modified.set_max_iters(NEWTON_MAX_ITER);
+  modified.set_jacobian_reuse(JACOBIAN_REUSE);
+  if (!solve("modified Newton's method", &modified, &mesh, &space)) success_test = 0;
+  int jacobians = 0;
+  for (int i = 0; i < modified.get_num_iters(); i++)
+    if (modified.get_iter_info()[i].jacobian) jacobians++;
+  if (modified.get_num_iters() < iters || jacobians >= modified.get_num_iters()) success_test = 0;
+
+  // Newton's method with damping.
+  NewtonSolver damped(&dp, matrix_solver);
+  damped.set_tolerance(NEWTON_TOL);
+  damped.set_max_iters(NEWTON_MAX_ITER);
+  damped.set_damping();
+  if (!solve("damped Newton's method", &damped, &mesh, &space)) success_test = 0;
+
+  // Properly terminate the solver in the case of SOLVER_PETSC or SOLVER_MUMPS.
+  finalize_solution_environment(matrix_solver);
+
+  if (success_test) {
+    info("Success!");
+    return ERR_SUCCESS;
+  }
+  else {
+    info("Failure!");
+    return ERR_FAILURE;
+  }
+}
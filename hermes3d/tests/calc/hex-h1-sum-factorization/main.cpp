@@ -0,0 +1,223 @@
+#define HERMES_REPORT_WARN
+#define HERMES_REPORT_INFO
+#define HERMES_REPORT_VERBOSE
+#include "config.h"
+#include <hermes3d.h>
+
+//  This test makes sure that the sum-factorized assembling of the volume matrix forms on hexahedra
+//  (DiscreteProblem::set_sum_factorization()) gives the same matrices as the evaluation of the
+//  forms for every pair of the shape functions (eval_form()). One vertex of the mesh is moved,
+//  so the elements around it are not parallelepipeds. Checked are a system of two equations on
+//  two different meshes (one element of the second mesh is refined, so there are hanging nodes
+//  and sub-elements) with coefficients depending on the coordinates and on an external function,
+//  and the Jacobian matrix of a nonlinear problem; the right-hand sides (the Dirichlet lift) and
+//  the matrix-free products (apply()) have to agree as well. All forms are integrated with the
+//  same quadrature order in both assemblings.
+
+const int ORDER = 10;                             // Quadrature order of the matrix forms.
+const double TOLERANCE = 1e-12;                   // Tolerance for the relative difference of the matrices.
+
+#define grad_grad(u, v) (u->dx[i] * v->dx[i] + u->dy[i] * v->dy[i] + u->dz[i] * v->dz[i])
+
+// Thermal conductivity (temperature-dependent) and its derivative.
+template<typename Real>
+Real lam(Real u) { return 1 + pow(u, 4); }
+
+template<typename Real>
+Real dlam_du(Real u) { return 4 * pow(u, 3); }
+
+// Boundary condition types.
+BCType bc_types(int marker)
+{
+	return BC_ESSENTIAL;
+}
+
+// Essential (Dirichlet) boundary condition values.
+scalar essential_bc_values(int ess_bdy_marker, double x, double y, double z)
+{
+	return 1.0 + x * y - 0.5 * z;
+}
+
+// The same quadrature order for all the pairs of the shape functions.
+Ord ord_fixed(int n, double *wt, Func<Ord> *u_ext[], Func<Ord> *u, Func<Ord> *v, Geom<Ord> *e,
+              ExtData<Ord> *ext)
+{
+	return Ord(ORDER);
+}
+
+// Weak forms with variable coefficients.
+template<typename Real, typename Scalar>
+Scalar bilinear_form_0_0(int n, double *wt, Func<Scalar> *u_ext[], Func<Real> *u, Func<Real> *v, Geom<Real> *e,
+                         ExtData<Scalar> *ext)
+{
+	Scalar result = 0;
+	for (int i = 0; i < n; i++)
+		result += wt[i] * ((1 + e->x[i] * e->x[i] + ext->fn[0].val[i] * ext->fn[0].val[i]) * grad_grad(u, v)
+		                   + e->y[i] * u->dx[i] * v->val[i] + 0.5 * u->dz[i] * v->dy[i]
+		                   + ext->fn[0].dx[i] * u->val[i] * v->val[i]);
+	return result;
+}
+
+template<typename Real, typename Scalar>
+Scalar bilinear_form_0_1(int n, double *wt, Func<Scalar> *u_ext[], Func<Real> *u, Func<Real> *v, Geom<Real> *e,
+                         ExtData<Scalar> *ext)
+{
+	Scalar result = 0;
+	for (int i = 0; i < n; i++)
+		result += wt[i] * (1 + e->x[i] * e->z[i]) * (u->dy[i] * v->dx[i] + 0.5 * u->val[i] * v->val[i]);
+	return result;
+}
+
+template<typename Real, typename Scalar>
+Scalar bilinear_form_1_1(int n, double *wt, Func<Scalar> *u_ext[], Func<Real> *u, Func<Real> *v, Geom<Real> *e,
+                         ExtData<Scalar> *ext)
+{
+	return int_grad_u_grad_v<Real, Scalar>(n, wt, u, v, e) + int_u_v<Real, Scalar>(n, wt, u, v, e);
+}
+
+template<typename Real, typename Scalar>
+Scalar linear_form(int n, double *wt, Func<Scalar> *u_ext[], Func<Real> *v, Geom<Real> *e, ExtData<Scalar> *ext)
+{
+	Scalar result = 0;
+	for (int i = 0; i < n; i++)
+		result += wt[i] * (e->x[i] + 2) * v->val[i];
+	return result;
+}
+
+// Jacobian matrix and residual vector of the nonlinear problem -div(lambda(u) grad u) = 1.
+template<typename Real, typename Scalar>
+Scalar jac(int n, double *wt, Func<Scalar> *u_ext[], Func<Real> *u, Func<Real> *v, Geom<Real> *e,
+           ExtData<Scalar> *ext)
+{
+	Scalar result = 0;
+	Func<Scalar> *u_prev = u_ext[0];
+	for (int i = 0; i < n; i++)
+		result += wt[i] * (dlam_du(u_prev->val[i]) * u->val[i] * grad_grad(u_prev, v)
+		                   + lam(u_prev->val[i]) * grad_grad(u, v));
+	return result;
+}
+
+template<typename Real, typename Scalar>
+Scalar res(int n, double *wt, Func<Scalar> *u_ext[], Func<Real> *v, Geom<Real> *e, ExtData<Scalar> *ext)
+{
+	Scalar result = 0;
+	Func<Scalar> *u_prev = u_ext[0];
+	for (int i = 0; i < n; i++)
+		result += wt[i] * (lam(u_prev->val[i]) * grad_grad(u_prev, v) - v->val[i]);
+	return result;
+}
+
+// Relative difference of the arrays.
+double rel_diff(scalar *a, scalar *b, int n)
+{
+	double diff = 0, norm = 0;
+	for (int i = 0; i < n; i++) {
+		diff = std::max(diff, std::abs(a[i] - b[i]));
+		norm = std::max(norm, std::abs(b[i]));
+	}
+	return diff / norm;
+}
+
+// Assembles the matrix with sum factorization (dp) and by the pairs of the shape functions
+// (dp_ref), compares the matrices, the right-hand sides and the matrix-free products.
+bool compare(const char *what, DiscreteProblem *dp, DiscreteProblem *dp_ref, scalar *coeff_vec)
+{
+	UMFPackMatrix mat, mat_ref;
+	UMFPackVector rhs, rhs_ref;
+	dp->assemble(coeff_vec, &mat, &rhs);
+	dp_ref->assemble(coeff_vec, &mat_ref, &rhs_ref);
+
+	int *ap, *ai, *ap_ref, *ai_ref;
+	scalar *ax, *ax_ref;
+	int nnz = mat.get_full_csc(ap, ai, ax);
+	int nnz_ref = mat_ref.get_full_csc(ap_ref, ai_ref, ax_ref);
+	int ndof = mat.get_size();
+	bool success = nnz == nnz_ref && mat_ref.get_size() == ndof
+	               && !memcmp(ap, ap_ref, (ndof + 1) * sizeof(int)) && !memcmp(ai, ai_ref, nnz * sizeof(int));
+	double diff = 1.0, diff_rhs = 1.0, diff_apply = 1.0;
+	if (success) {
+		diff = rel_diff(ax, ax_ref, nnz);
+		scalar *b = new scalar[ndof];
+		scalar *b_ref = new scalar[ndof];
+		rhs.extract(b);
+		rhs_ref.extract(b_ref);
+		diff_rhs = rel_diff(b, b_ref, ndof);
+
+		scalar *x = new scalar[ndof];
+		for (int i = 0; i < ndof; i++) x[i] = 1.0 + (i * 7919 % 1000) / 1000.0;
+		mat_ref.multiply(x, b_ref);
+		dp->apply(coeff_vec, x, b);
+		diff_apply = rel_diff(b, b_ref, ndof);
+
+		delete [] b;
+		delete [] b_ref;
+		delete [] x;
+	}
+	info("%s: ndof = %d, relative difference: matrix %g, rhs %g, apply() %g", what, ndof, diff, diff_rhs,
+	     diff_apply);
+	if (diff > TOLERANCE || diff_rhs > TOLERANCE || diff_apply > TOLERANCE) success = false;
+
+	delete [] ap; delete [] ai; delete [] ax;
+	delete [] ap_ref; delete [] ai_ref; delete [] ax_ref;
+	return success;
+}
+
+int main(int argc, char **args)
+{
+	if (argc < 2) error("Not enough parameters");
+
+	// Load the mesh, one element of the second mesh is refined (hanging nodes).
+	Mesh mesh, mesh_2;
+	H3DReader mloader;
+	if (!mloader.load(args[1], &mesh)) error("Loading mesh file '%s'\n", args[1]);
+	mesh_2.copy(mesh);
+	mesh_2.refine_element(1, H3D_H3D_H3D_REFT_HEX_XYZ);
+
+	// Create the spaces (with different orders in the directions) and the external function.
+	H1Space space_0(&mesh, bc_types, essential_bc_values, Ord3(4, 3, 5));
+	H1Space space_1(&mesh_2, bc_types, essential_bc_values, Ord3(3, 3, 3));
+	Tuple<Space *> spaces(&space_0, &space_1);
+	int ndof_0 = Space::get_num_dofs(&space_0);
+	scalar *coeff_vec = new scalar[ndof_0];
+	for (int i = 0; i < ndof_0; i++) coeff_vec[i] = 0.5 + 0.3 * sin(i * 0.37);
+	Solution ext(&mesh);
+	Solution::vector_to_solution(coeff_vec, &space_0, &ext);
+
+	bool success = true;
+
+	// Variable coefficients: the same forms with and without set_sum_factorization().
+	{
+		WeakForm wf(2);
+		wf.add_matrix_form(0, 0, bilinear_form_0_0<double, scalar>, ord_fixed, HERMES_UNSYM, HERMES_ANY,
+		                   Tuple<MeshFunction *>(&ext));
+		wf.add_matrix_form(0, 1, bilinear_form_0_1<double, scalar>, ord_fixed, HERMES_SYM);
+		wf.add_matrix_form(1, 1, bilinear_form_1_1<double, scalar>, ord_fixed, HERMES_SYM);
+		wf.add_vector_form(0, callback(linear_form));
+		DiscreteProblem dp(&wf, spaces, true);
+		DiscreteProblem dp_ref(&wf, spaces, true);
+		dp.set_sum_factorization();
+		if (!compare("variable coefficients", &dp, &dp_ref, NULL)) success = false;
+	}
+
+	// Jacobian matrix of the nonlinear problem.
+	{
+		WeakForm wf;
+		wf.add_matrix_form(jac<double, scalar>, ord_fixed, HERMES_UNSYM, HERMES_ANY);
+		wf.add_vector_form(callback(res), HERMES_ANY);
+		DiscreteProblem dp(&wf, &space_0, false);
+		DiscreteProblem dp_ref(&wf, &space_0, false);
+		dp.set_sum_factorization();
+		if (!compare("nonlinear", &dp, &dp_ref, coeff_vec)) success = false;
+	}
+
+	delete [] coeff_vec;
+
+	if (success) {
+		info("Success!");
+		return ERR_SUCCESS;
+	}
+	else {
+		info("Failure!");
+		return ERR_FAILURE;
+	}
+}
@@ -0,0 +1,139 @@
+// This file is part of Hermes3D
+//
+// Copyright (c) 2009 hp-FEM group at the University of Nevada, Reno (UNR).
+// Email: hpfem-group@unr.edu, home page: http://hpfem.org/.
+//
+// Hermes3D is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published
+// by the Free Software Foundation; either version 2 of the License,
+// or (at your option) any later version.
+//
+// Hermes3D is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Hermes3D; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+/*
+ * point-lookup.cc
+ *
+ * usage: $0 <mesh file>
+ *
+ * Looks up random points, some of them outside of the domain, by Solution::get_phys_value()
+ * and get_phys_values() and compares them with a linear scan over all elements. The mesh is
+ * refined afterwards and the points are looked up again in the same solution, so that the
+ * element index has to be rebuilt.
+ *
+ */
+
+#include "config.h"
+#include <hermes3d.h>
+#include "../../../../hermes_common/trace.h"
+#include "../../../../hermes_common/error.h"
+#ifdef WITH_PETSC
+#include "../../../../hermes_common/solver/petsc.h"
+#endif
+
+#define NUM_POINTS						1000
+// the values of the exact solution have to be reproduced up to this epsilon
+#define EPS								1e-10
+
+scalar fnc(double x, double y, double z, scalar &dx, scalar &dy, scalar &dz) {
+	dx = 2 * x + y;
+	dy = x - 3 * z * z;
+	dz = -6 * y * z;
+	return x * x + x * y - 3 * y * z * z;
+}
+
+// the reference domain test of Solution::get_phys_value()
+bool is_in_ref_domain(double xi1, double xi2, double xi3) {
+	const double TOL = 1e-11;
+	return fabs(xi1) <= 1.0 + TOL && fabs(xi2) <= 1.0 + TOL && fabs(xi3) <= 1.0 + TOL;
+}
+
+// finds the element containing the point by going through all active elements
+Element *find_linear(Mesh *mesh, RefMap *refmap, double x, double y, double z) {
+	double xi1, xi2, xi3;
+	FOR_ALL_ACTIVE_ELEMENTS(idx, mesh) {
+		Element *e = mesh->elements[idx];
+		refmap->set_active_element(e);
+		refmap->untransform(x, y, z, xi1, xi2, xi3);
+		if (is_in_ref_domain(xi1, xi2, xi3)) return e;
+	}
+	return NULL;
+}
+
+bool check(Mesh *mesh, Solution *sln, int n, double *x, double *y, double *z) {
+	RefMap refmap(mesh);
+	scalar *val = new scalar[n];
+	sln->get_phys_values(n, x, y, z, 0, val);
+
+	int outside = 0, wrong = 0;
+	for (int i = 0; i < n; i++) {
+		scalar single = sln->get_phys_value(x[i], y[i], z[i]);
+		if (find_linear(mesh, &refmap, x[i], y[i], z[i]) == NULL) {
+			outside++;
+			if (!isnan(single) || !isnan(val[i])) wrong++;
+			continue;
+		}
+
+		scalar dx, dy, dz;
+		scalar exact = fnc(x[i], y[i], z[i], dx, dy, dz);
+		if (isnan(single) || isnan(val[i]) || fabs(single - exact) > EPS || fabs(val[i] - exact) > EPS)
+			wrong++;
+	}
+	delete [] val;
+
+	printf("%d points (%d outside of the domain), %d wrong\n", n, outside, wrong);
+	return wrong == 0 && outside > 0 && outside < n;
+}
+
+// main ///////////////////////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char **args) {
+	int res = ERR_SUCCESS;
+
+#ifdef WITH_PETSC
+	PetscInitialize(&argc, &args, (char *) PETSC_NULL, PETSC_NULL);
+#endif
+	set_verbose(false);
+
+	TRACE_START("trace.txt");
+	DEBUG_OUTPUT_ON;
+	SET_VERBOSE_LEVEL(0);
+
+	if (argc < 2) error("Not enough parameters");
+
+	Mesh mesh;
+	H3DReader mesh_loader;
+	if (!mesh_loader.load(args[1], &mesh)) error("Loading mesh file '%s'\n", args[1]);
+
+	// the solution is evaluated on the elements of the mesh, so it follows the refinements
+	ExactSolution sln(&mesh, fnc);
+
+	// random points in a box around the domain
+	double x[NUM_POINTS], y[NUM_POINTS], z[NUM_POINTS];
+	srand(1);
+	for (int i = 0; i < NUM_POINTS; i++) {
+		x[i] = -1.2 + 2.4 * rand() / (double) RAND_MAX;
+		y[i] = -1.2 + 2.4 * rand() / (double) RAND_MAX;
+		z[i] = -1.2 + 2.4 * rand() / (double) RAND_MAX;
+	}
+
+	if (!check(&mesh, &sln, NUM_POINTS, x, y, z)) res = ERR_FAILURE;
+
+	// the index of the solution belongs to the old mesh
+	mesh.refine_all_elements(H3D_H3D_H3D_REFT_HEX_XYZ);
+	if (!check(&mesh, &sln, NUM_POINTS, x, y, z)) res = ERR_FAILURE;
+
+#ifdef WITH_PETSC
+	PetscFinalize();
+#endif
+
+	TRACE_END;
+
+	return res;
+}
@@ -21,6 +21,9 @@
 #include "Teuchos_stacktrace.hpp"
 #include <signal.h>
 #include <stdlib.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 // global instance of the call stack object
 static CallStack callstack;
@@ -32,6 +35,11 @@ CallStackObj::CallStackObj(int ln, const char *func, const char *file) {
 	this->func = func;
 	this->file = file;
 
+#ifdef _OPENMP
+	// the call stack is recorded for the master thread only
+	if (omp_get_thread_num() != 0) return;
+#endif
+
 	// add this object to the call stack
 	if (callstack.size < callstack.max_size) {
 		callstack.stack[callstack.size] = this;
@@ -40,6 +48,9 @@ CallStackObj::CallStackObj(int ln, const char *func, const char *file) {
 }
 
 CallStackObj::~CallStackObj() {
+#ifdef _OPENMP
+	if (omp_get_thread_num() != 0) return;
+#endif
 	// remove the object only if it is on the top of the call stack
 	if (callstack.size > 0 && callstack.stack[callstack.size - 1] == this) {
 		callstack.size--;
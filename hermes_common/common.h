@@ -87,12 +87,14 @@ enum MatrixSolverType
    SOLVER_SUPERLU,
    SOLVER_NOX,
    SOLVER_AMESOS,
-   SOLVER_AZTECOO
+   SOLVER_AZTECOO,
+   SOLVER_KRYLOV,
+   SOLVER_MIXED_PRECISION
 };
 
 // Should be in the same order as MatrixSolverTypes above, so that the
 // names may be accessed by the same enumeration variable.
-const std::string MatrixSolverNames[8] = {
+const std::string MatrixSolverNames[10] = {
   "UMFPACK",
   "PETSc",
   "MUMPS",
@@ -100,7 +102,9 @@ const std::string MatrixSolverNames[8] = {
   "SuperLU",
   "Trilinos/NOX",
   "Trilinos/Amesos",
-  "Trilinos/AztecOO"
+  "Trilinos/AztecOO",
+  "Krylov",
+  "SuperLU (mixed precision)"
 };
 
 #define UMFPACK_NOT_COMPILED  HERMES " was not built with UMFPACK support."
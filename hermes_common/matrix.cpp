@@ -32,6 +32,8 @@
 #include "solver/mumps.h"
 #include "solver/nox.h"
 #include "solver/aztecoo.h"
+#include "solver/krylov.h"
+#include "solver/mixed_precision.h"
 
 #define HERMES_TINY 1.0e-20
 
@@ -136,89 +138,54 @@ double vec_dot(Vector *r, Vector *s, int n_dof)
 
 // SparseMatrix ////////////////////////////////////////////////////////////////////////////////////
 
-void qsort_int(int* pbase, size_t total_elems); // defined in qsort.cpp
-
 SparseMatrix::SparseMatrix()
 {
 	_F_
 	size = 0;
-	pages = NULL;
 
 	row_storage = false;
 	col_storage = false;
+	sym_storage = false;
 }
 
 SparseMatrix::SparseMatrix(int size)
 {
 	_F_
 	this->size = size;
-	pages = NULL;
 
 	row_storage = false;
 	col_storage = false;
+	sym_storage = false;
 }
 
 SparseMatrix::~SparseMatrix()
 {
 	_F_
-	delete [] pages;
 }
 
 void SparseMatrix::prealloc(int n)
 {
 	_F_
 	this->size = n;
-
-	pages = new Page *[n];
-	MEM_CHECK(pages);
-	memset(pages, 0, n * sizeof(Page *));
+	pattern.init(n);
 }
 
 void SparseMatrix::pre_add_ij(int row, int col)
 {
 	_F_
-	if (pages[col] == NULL || pages[col]->count >= PAGE_SIZE) {
-		Page *new_page = new Page;
-		MEM_CHECK(new_page);
-		new_page->count = 0;
-		new_page->next = pages[col];
-		pages[col] = new_page;
-	}
-	pages[col]->idx[pages[col]->count++] = row;
+	pattern.add(row, col);
 }
 
-int SparseMatrix::sort_and_store_indices(Page *page, int *buffer, int *max)
+void SparseMatrix::pre_add_block(int m, int n, int *rows, int *cols)
 {
 	_F_
-	// gather all pages in the buffer, deleting them along the way
-	int *end = buffer;
-	while (page != NULL) {
-		memcpy(end, page->idx, sizeof(int) * page->count);
-		end += page->count;
-		Page *tmp = page;
-		page = page->next;
-		delete tmp;
-	}
-
-	// sort the indices and remove duplicities
-	qsort_int(buffer, end - buffer);
-	int *q = buffer;
-	for (int *p = buffer, last = -1; p < end; p++)
-		if (*p != last)
-			*q++ = last = *p;
-
-	return q - buffer;
+	pattern.add_block(m, n, rows, cols);
 }
 
-int SparseMatrix::get_num_indices()
+void SparseMatrix::add_block_with_map(int m, int n, scalar **mat, int *map)
 {
 	_F_
-	int total = 0;
-	for (int i = 0; i < size; i++)
-		for (Page *page = pages[i]; page != NULL; page = page->next)
-			total += page->count;
-
-	return total;
+	EXIT(HERMES_ERR_NOT_IMPLEMENTED);
 }
 
 bool initialize_solution_environment(MatrixSolverType matrix_solver, int argc, char* argv[])
@@ -293,6 +260,8 @@ SparseMatrix* create_matrix(MatrixSolverType matrix_solver)
         break;
       }
     case SOLVER_UMFPACK: 
+    case SOLVER_KRYLOV: 
+    case SOLVER_MIXED_PRECISION: 
       {
         return new UMFPackMatrix;
         break;
@@ -363,6 +332,20 @@ Solver* create_linear_solver(MatrixSolverType matrix_solver, Matrix* matrix, Vec
       info("Using SuperLU."); 
       break;
     }
+    case SOLVER_KRYLOV: 
+    {
+      if (rhs != NULL) return new KrylovSolver(static_cast<UMFPackMatrix*>(matrix), static_cast<UMFPackVector*>(rhs)); 
+      else return new KrylovSolver(static_cast<UMFPackMatrix*>(matrix), static_cast<UMFPackVector*>(rhs_dummy)); 
+      info("Using the native Krylov solver."); 
+      break;
+    }
+    case SOLVER_MIXED_PRECISION: 
+    {
+      if (rhs != NULL) return new MixedPrecisionSolver(static_cast<UMFPackMatrix*>(matrix), static_cast<UMFPackVector*>(rhs)); 
+      else return new MixedPrecisionSolver(static_cast<UMFPackMatrix*>(matrix), static_cast<UMFPackVector*>(rhs_dummy)); 
+      info("Using SuperLU in mixed precision."); 
+      break;
+    }
     default: 
       error("Unknown matrix solver requested.");
   }
@@ -395,6 +378,8 @@ Vector* create_vector(MatrixSolverType matrix_solver)
         break;
       }
     case SOLVER_UMFPACK: 
+    case SOLVER_KRYLOV: 
+    case SOLVER_MIXED_PRECISION: 
       {
         return new UMFPackVector;
         break;
@@ -22,6 +22,7 @@
 
 #include "common.h"
 #include "error.h"
+#include "sparsity.h"
 #
 
 
@@ -315,6 +316,14 @@ public:
 	/// @param[in] col  - column index
 	virtual void pre_add_ij(int row, int col);
 
+	/// add indices of all entries of a dense block (e.g. of an element stiffness matrix)
+	///
+	/// @param[in] m    - number of rows of the block
+	/// @param[in] n    - number of columns of the block
+	/// @param[in] rows - array with row indexes (negative indices are ignored)
+	/// @param[in] cols - array with column indexes (negative indices are ignored)
+	virtual void pre_add_block(int m, int n, int *rows, int *cols);
+
 	virtual void finish() { }
 
 	virtual int get_size() { return size; }
@@ -351,22 +360,48 @@ public:
 
 	virtual double get_fill_in() const = 0;
 
-	unsigned row_storage:1;
-	unsigned col_storage:1;
+	/// Compute the scatter map of a local block, i.e. offsets of its entries into the
+	/// internal storage of the matrix. Must be called after alloc().
+	///
+	/// @param[in] m     - number of rows of given block
+	/// @param[in] n     - number of columns of given block
+	/// @param[in] rows  - array with row indexes
+	/// @param[in] cols  - array with column indexes
+	/// @param[out] map  - m*n offsets (row-wise), -1 for entries that are not stored (dirichlet DOFs)
+	/// @return - false if the matrix does not support scattering with maps
+	virtual bool get_block_map(int m, int n, int *rows, int *cols, int *map) { return false; }
+
+	/// update the stiffness matrix using a scatter map obtained by get_block_map()
+	/// (no searching in the sparse structure is done)
+	///
+	/// @param[in] m         - number of rows of given block
+	/// @param[in] n         - number of columns of given block
+	/// @param[in] matrix    - block of values
+	/// @param[in] map       - scatter map of the block
+	virtual void add_block_with_map(int m, int n, scalar **mat, int *map);
 
-protected:
-	static const int PAGE_SIZE = 62;
+	/// Store only the upper triangle (row <= col) of a symmetric matrix, entries added
+	/// below the diagonal are ignored. Must be called before prealloc().
+	///
+	/// @param[in] sym - true to switch the symmetric storage on
+	/// @return - false if the matrix does not support symmetric storage
+	virtual bool set_symmetric_storage(bool sym) { sym_storage = false; return !sym; }
+	bool is_symmetric_storage() const { return sym_storage; }
 
-	struct Page {
-		int count;
-		int idx[PAGE_SIZE];
-		Page *next;
-	};
+	/// Matrix-vector product y = A x
+	///
+	/// @param[in] x - vector of length size
+	/// @param[out] y - vector of length size
+	virtual void multiply(scalar *x, scalar *y) { EXIT(HERMES_ERR_NOT_IMPLEMENTED); }
 
-	Page **pages;
+	unsigned row_storage:1;
+	unsigned col_storage:1;
 
-	int sort_and_store_indices(Page *page, int *buffer, int *max);
-	int get_num_indices();
+protected:
+	/// structure of the matrix collected by pre_add_ij() / pre_add_block()
+	SparsityPattern pattern;
+	/// only the upper triangle is stored (see set_symmetric_storage())
+	bool sym_storage;
 
 	// mem stat
 	int mem_size;
@@ -425,6 +460,22 @@ protected:
 	int size;
 };
 
+/// Linear operator given only by its action y = A x, for the matrix-free iterative solvers
+/// (see KrylovSolver); e.g. the Jacobian matrix of a nonlinear problem applied element by
+/// element or approximated by finite differences of the residual.
+class HERMES_API MatrixFreeOperator {
+public:
+	virtual ~MatrixFreeOperator() { }
+
+	/// @return the number of rows (and columns) of the operator
+	virtual int get_size() = 0;
+
+	/// y = A x
+	/// @param[in] x - vector of length get_size()
+	/// @param[out] y - vector of length get_size()
+	virtual void apply(scalar *x, scalar *y) = 0;
+};
+
 /// Calls the required (de)initialization routines of the selected matrix solver.
 HERMES_API bool initialize_solution_environment(MatrixSolverType matrix_solver, int argc, char* argv[]);
 HERMES_API bool finalize_solution_environment(MatrixSolverType matrix_solver);
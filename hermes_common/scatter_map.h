@@ -0,0 +1,128 @@
+// This file is part of Hermes3D
+//
+// Copyright (c) 2009 hp-FEM group at the University of Nevada, Reno (UNR).
+// Email: hpfem-group@unr.edu, home page: http://hpfem.org/.
+//
+// Hermes3D is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published
+// by the Free Software Foundation; either version 2 of the License,
+// or (at your option) any later version.
+//
+// Hermes3D is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Hermes3D; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#ifndef _SCATTER_MAP_H_
+#define _SCATTER_MAP_H_
+
+#include "common.h"
+
+/// \class ScatterMaps
+/// \brief Storage for precomputed scatter maps of local stiffness matrices.
+///
+/// A scatter map of an (m x n) local block holds m*n offsets (row-wise) directly
+/// into the value array of a SparseMatrix, -1 marks entries that are not assembled
+/// (Dirichlet DOFs). Maps are filled by SparseMatrix::get_block_map() right after
+/// the sparsity pattern has been built and used by SparseMatrix::add_block_with_map().
+///
+/// Maps are stored per equation block (bi, bj) in a flat array indexed by the id of
+/// the element of the bi-th space. If the element of the bj-th space differs for two
+/// maps sharing the same slot (multi-mesh problems), the latter map goes to a sorted
+/// overflow map.
+class ScatterMaps {
+public:
+	ScatterMaps() : neq(0), slots(NULL), mem_size(0) { }
+	~ScatterMaps() { free(); }
+
+	/// Prepare empty storage for a system of neq equations.
+	void init(int neq) {
+		free();
+		this->neq = neq;
+		slots = new std::vector<Slot>[neq * neq];
+		MEM_CHECK(slots);
+	}
+
+	/// Release all stored maps.
+	void free() {
+		if (slots != NULL) {
+			for (int i = 0; i < neq * neq; i++)
+				for (unsigned int k = 0; k < slots[i].size(); k++)
+					delete [] slots[i][k].map;
+			delete [] slots;
+			slots = NULL;
+		}
+		for (std::map<Key, int *>::iterator it = overflow.begin(); it != overflow.end(); it++)
+			delete [] it->second;
+		overflow.clear();
+		neq = 0;
+		mem_size = 0;
+	}
+
+	bool is_empty() const { return slots == NULL; }
+
+	/// Return the map for the block (bi, bj) on the element pair (id_i, id_j), NULL if there is none.
+	int *get(int bi, int bj, int id_i, int id_j) const {
+		if (slots == NULL) return NULL;
+		const std::vector<Slot> &s = slots[bi * neq + bj];
+		if (id_i < (int) s.size() && s[id_i].id_j == id_j)
+			return s[id_i].map;
+		if (overflow.empty()) return NULL;
+		std::map<Key, int *>::const_iterator it = overflow.find(Key(bi, bj, id_i, id_j));
+		return (it != overflow.end()) ? it->second : NULL;
+	}
+
+	/// Allocate a map with 'len' entries for the block (bi, bj) on the element pair (id_i, id_j).
+	/// @return - the map to be filled by the caller
+	int *add(int bi, int bj, int id_i, int id_j, int len) {
+		assert(slots != NULL);
+		int *map = get(bi, bj, id_i, id_j);
+		if (map != NULL) return map;
+
+		map = new int[len];
+		MEM_CHECK(map);
+		mem_size += len * sizeof(int);
+
+		std::vector<Slot> &s = slots[bi * neq + bj];
+		if (id_i >= (int) s.size()) s.resize(id_i + 1);
+		if (s[id_i].map == NULL) {
+			s[id_i].id_j = id_j;
+			s[id_i].map = map;
+		}
+		else
+			overflow[Key(bi, bj, id_i, id_j)] = map;
+		return map;
+	}
+
+	/// Memory occupied by the maps (in bytes).
+	int get_mem_size() const { return mem_size; }
+
+protected:
+	struct Slot {
+		int id_j;
+		int *map;
+		Slot() : id_j(-1), map(NULL) { }
+	};
+
+	struct Key {
+		int bi, bj, id_i, id_j;
+		Key(int bi, int bj, int id_i, int id_j) : bi(bi), bj(bj), id_i(id_i), id_j(id_j) { }
+		bool operator<(const Key &o) const {
+			if (bi != o.bi) return bi < o.bi;
+			if (bj != o.bj) return bj < o.bj;
+			if (id_i != o.id_i) return id_i < o.id_i;
+			return id_j < o.id_j;
+		}
+	};
+
+	int neq;
+	std::vector<Slot> *slots;
+	std::map<Key, int *> overflow;
+	int mem_size;
+};
+
+#endif
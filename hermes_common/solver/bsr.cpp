@@ -0,0 +1,294 @@
+// This file is part of Hermes3D
+//
+// Copyright (c) 2009 hp-FEM group at the University of Nevada, Reno (UNR).
+// Email: hpfem-group@unr.edu, home page: http://hpfem.org/.
+//
+// Hermes3D is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published
+// by the Free Software Foundation; either version 2 of the License,
+// or (at your option) any later version.
+//
+// Hermes3D is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Hermes3D; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include "bsr.h"
+#include "../trace.h"
+#include "../error.h"
+#include "../utils.h"
+#include "../callstack.h"
+
+// Block kernels ///////////////////////////////////////////////////////////////////////////////////
+// (the block size is a template parameter, so that the loops over the block get unrolled and
+// vectorized by the compiler; block rows are split among threads if Hermes is built with OpenMP)
+
+/// y = y + A x, A is a dense (BS x BS) block stored row-wise
+template<int BS>
+static inline void block_mult_add(const scalar *a, const scalar *x, scalar *y)
+{
+  for (int i = 0; i < BS; i++) {
+    scalar sum = 0.0;
+    for (int j = 0; j < BS; j++) sum += a[i * BS + j] * x[j];
+    y[i] += sum;
+  }
+}
+
+template<int BS>
+static void bsr_multiply(int nb, const int *Bp, const int *Bj, const scalar *Bx, scalar *x, scalar *y)
+{
+#pragma omp parallel for schedule(static)
+  for (int br = 0; br < nb; br++) {
+    scalar sum[BS];
+    for (int i = 0; i < BS; i++) sum[i] = 0.0;
+    for (int k = Bp[br]; k < Bp[br + 1]; k++)
+      block_mult_add<BS>(Bx + k * BS * BS, x + Bj[k] * BS, sum);
+    for (int i = 0; i < BS; i++) y[br * BS + i] = sum[i];
+  }
+}
+
+/// the same for a block size not known at compile time
+static void bsr_multiply(int bs, int nb, const int *Bp, const int *Bj, const scalar *Bx, scalar *x, scalar *y)
+{
+  int bs2 = bs * bs;
+#pragma omp parallel for schedule(static)
+  for (int br = 0; br < nb; br++) {
+    scalar *yb = y + br * bs;
+    for (int i = 0; i < bs; i++) yb[i] = 0.0;
+    for (int k = Bp[br]; k < Bp[br + 1]; k++) {
+      const scalar *a = Bx + k * bs2, *xb = x + Bj[k] * bs;
+      for (int i = 0; i < bs; i++) {
+        scalar sum = 0.0;
+        for (int j = 0; j < bs; j++) sum += a[i * bs + j] * xb[j];
+        yb[i] += sum;
+      }
+    }
+  }
+}
+
+static int find_position(int *Bj, int len, int idx) {
+  int lo = 0, hi = len - 1;
+  while (lo <= hi) {
+    int mid = (lo + hi) >> 1;
+    if (idx < Bj[mid]) hi = mid - 1;
+    else if (idx > Bj[mid]) lo = mid + 1;
+    else return mid;
+  }
+  return -1;
+}
+
+// BSRMatrix ///////////////////////////////////////////////////////////////////////////////////////
+
+BSRMatrix::BSRMatrix(int bs) {
+  _F_
+  if (bs < 1) error("Invalid block size.");
+  this->bs = bs;
+  size = nb = nnzb = 0;
+  Bp = NULL;
+  Bj = NULL;
+  Bx = NULL;
+}
+
+BSRMatrix::~BSRMatrix() {
+  _F_
+  free();
+}
+
+void BSRMatrix::prealloc(int n) {
+  _F_
+  if (n % bs != 0)
+    error("The size of the matrix (%d) is not a multiple of the block size (%d).", n, bs);
+  size = n;
+  nb = n / bs;
+  // the pattern is collected for the blocks only
+  pattern.init(nb);
+}
+
+void BSRMatrix::pre_add_ij(int row, int col) {
+  _F_
+  if (row >= 0 && col >= 0) pattern.add(row / bs, col / bs);
+}
+
+void BSRMatrix::pre_add_block(int m, int n, int *rows, int *cols) {
+  _F_
+  // negative (dirichlet) DOFs have to stay negative
+  brows.resize(m);
+  bcols.resize(n);
+  for (int i = 0; i < m; i++) brows[i] = rows[i] >= 0 ? rows[i] / bs : -1;
+  for (int j = 0; j < n; j++) bcols[j] = cols[j] >= 0 ? cols[j] / bs : -1;
+  pattern.add_block(m, n, &brows[0], &bcols[0]);
+}
+
+void BSRMatrix::alloc() {
+  _F_
+  assert(pattern.is_initialized());
+  assert(size > 0);
+
+  // block rows with sorted block column indices, without duplicities
+  nnzb = pattern.build(false, Bp, Bj);
+  pattern.free();
+  std::vector<int>().swap(brows);
+  std::vector<int>().swap(bcols);
+
+  Bx = new scalar [nnzb * bs * bs];
+  MEM_CHECK(Bx);
+  memset(Bx, 0, sizeof(scalar) * nnzb * bs * bs);
+}
+
+void BSRMatrix::free() {
+  _F_
+  nnzb = 0;
+  delete [] Bp; Bp = NULL;
+  delete [] Bj; Bj = NULL;
+  delete [] Bx; Bx = NULL;
+}
+
+int BSRMatrix::find_entry(int m, int n) const {
+  int br = m / bs, bc = n / bs;
+  int pos = find_position(Bj + Bp[br], Bp[br + 1] - Bp[br], bc);
+  if (pos < 0) return -1;
+  return (Bp[br] + pos) * bs * bs + (m % bs) * bs + n % bs;
+}
+
+scalar BSRMatrix::get(int m, int n) {
+  _F_
+  int pos = find_entry(m, n);
+  return pos < 0 ? 0.0 : Bx[pos];
+}
+
+void BSRMatrix::zero() {
+  _F_
+  memset(Bx, 0, sizeof(scalar) * nnzb * bs * bs);
+}
+
+void BSRMatrix::add(int m, int n, scalar v) {
+  _F_
+  if (v != 0.0 && m >= 0 && n >= 0)   // ignore dirichlet DOFs
+  {
+    int pos = find_entry(m, n);
+    // Make sure we are adding to an existing non-zero entry.
+    if (pos < 0)
+      error("Sparse matrix entry not found");
+    Bx[pos] += v;
+  }
+}
+
+void BSRMatrix::add(int m, int n, scalar **mat, int *rows, int *cols) {
+  _F_
+  for (int i = 0; i < m; i++)       // rows
+    for (int j = 0; j < n; j++)     // cols
+      add(rows[i], cols[j], mat[i][j]);
+}
+
+bool BSRMatrix::get_block_map(int m, int n, int *rows, int *cols, int *map) {
+  _F_
+  for (int i = 0; i < m; i++)       // rows
+    for (int j = 0; j < n; j++)     // cols
+    {
+      if (rows[i] < 0 || cols[j] < 0)   // dirichlet DOFs are not stored
+      {
+        map[i * n + j] = -1;
+        continue;
+      }
+      int pos = find_entry(rows[i], cols[j]);
+      if (pos < 0)
+        error("Sparse matrix entry not found");
+      map[i * n + j] = pos;
+    }
+  return true;
+}
+
+void BSRMatrix::add_block_with_map(int m, int n, scalar **mat, int *map) {
+  _F_
+  for (int i = 0; i < m; i++)       // rows
+  {
+    scalar *row = mat[i];
+    int *row_map = map + i * n;
+    for (int j = 0; j < n; j++)     // cols
+      if (row_map[j] >= 0)
+        Bx[row_map[j]] += row[j];
+  }
+}
+
+bool BSRMatrix::dump(FILE *file, const char *var_name, EMatrixDumpFormat fmt) {
+  _F_
+  int bs2 = bs * bs;
+  switch (fmt)
+  {
+    case DF_MATLAB_SPARSE:
+      // all entries of the blocks are written (explicit zeros included)
+      fprintf(file, "%% Size: %dx%d\n%% Nonzeros: %d\ntemp = zeros(%d, 3);\ntemp = [\n",
+              size, size, nnzb * bs2, nnzb * bs2);
+      for (int br = 0; br < nb; br++)
+        for (int k = Bp[br]; k < Bp[br + 1]; k++)
+          for (int i = 0; i < bs; i++)
+            for (int j = 0; j < bs; j++)
+              fprintf(file, "%d %d " SCALAR_FMT "\n", br * bs + i + 1, Bj[k] * bs + j + 1,
+                      SCALAR(Bx[k * bs2 + i * bs + j]));
+      fprintf(file, "];\n%s = spconvert(temp);\n", var_name);
+      return true;
+
+    case DF_HERMES_BIN:
+    case DF_PLAIN_ASCII:
+      EXIT(HERMES_ERR_NOT_IMPLEMENTED);
+      return false;
+
+    default:
+      return false;
+  }
+}
+
+int BSRMatrix::get_matrix_size() const {
+  _F_
+  assert(Bp != NULL);
+  /*          Bj                     Bx                            Bp                  nnzb  */
+  return sizeof(int) * nnzb + sizeof(scalar) * nnzb * bs * bs + sizeof(int) * (nb + 1) + sizeof(int);
+}
+
+double BSRMatrix::get_fill_in() const {
+  _F_
+  return nnzb * bs * bs / ((double) size * size);
+}
+
+void BSRMatrix::multiply(scalar *x, scalar *y) {
+  _F_
+  switch (bs)
+  {
+    case 1: bsr_multiply<1>(nb, Bp, Bj, Bx, x, y); break;
+    case 2: bsr_multiply<2>(nb, Bp, Bj, Bx, x, y); break;
+    case 3: bsr_multiply<3>(nb, Bp, Bj, Bx, x, y); break;
+    case 4: bsr_multiply<4>(nb, Bp, Bj, Bx, x, y); break;
+    default: bsr_multiply(bs, nb, Bp, Bj, Bx, x, y); break;
+  }
+}
+
+int BSRMatrix::get_csr(int *&rp, int *&rj, scalar *&rx) const {
+  _F_
+  int bs2 = bs * bs, nnz = nnzb * bs2;
+  rp = new int[size + 1];
+  MEM_CHECK(rp);
+  rj = new int[nnz];
+  MEM_CHECK(rj);
+  rx = new scalar[nnz];
+  MEM_CHECK(rx);
+
+  // every scalar row of a block row has the same (sorted) columns
+  rp[0] = 0;
+  for (int br = 0; br < nb; br++) {
+    int len = (Bp[br + 1] - Bp[br]) * bs;
+    for (int i = 0; i < bs; i++) {
+      int row = br * bs + i, p = rp[row];
+      for (int k = Bp[br]; k < Bp[br + 1]; k++)
+        for (int j = 0; j < bs; j++, p++) {
+          rj[p] = Bj[k] * bs + j;
+          rx[p] = Bx[k * bs2 + i * bs + j];
+        }
+      rp[row + 1] = rp[row] + len;
+    }
+  }
+  return nnz;
+}
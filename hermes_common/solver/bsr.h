@@ -0,0 +1,84 @@
+// This file is part of Hermes3D
+//
+// Copyright (c) 2009 hp-FEM group at the University of Nevada, Reno (UNR).
+// Email: hpfem-group@unr.edu, home page: http://hpfem.org/.
+//
+// Hermes3D is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published
+// by the Free Software Foundation; either version 2 of the License,
+// or (at your option) any later version.
+//
+// Hermes3D is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Hermes3D; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#ifndef _BSR_MATRIX_H_
+#define _BSR_MATRIX_H_
+
+#include "../matrix.h"
+
+/// Block compressed sparse row (BSR) matrix with dense square blocks of a fixed size.
+///
+/// Meant for systems of equations with the DOFs interleaved (see
+/// Space::assign_dofs_interleaved()): the DOFs k * neq, ..., k * neq + neq - 1 then
+/// belong to one node and couple with the same DOFs, so the matrix consists of dense
+/// (neq x neq) blocks. One column index is stored per block (instead of one row index
+/// per entry) and the pattern is collected for the blocks only. The blocks are stored
+/// row-wise; the block products are unrolled for the block sizes 1 to 4.
+///
+/// The matrix is solved by the native Krylov solver (KrylovSolver), the native
+/// preconditioners (NativePrecond) take it as well.
+///
+/// @ingroup solvers
+class HERMES_API BSRMatrix : public SparseMatrix {
+public:
+  /// @param[in] bs - size of the blocks (the number of equations)
+  BSRMatrix(int bs = 1);
+  virtual ~BSRMatrix();
+
+  /// @param[in] n - number of unknowns, must be a multiple of the block size
+  virtual void prealloc(int n);
+  virtual void pre_add_ij(int row, int col);
+  virtual void pre_add_block(int m, int n, int *rows, int *cols);
+
+  virtual void alloc();
+  virtual void free();
+  virtual scalar get(int m, int n);
+  virtual void zero();
+  virtual void add(int m, int n, scalar v);
+  virtual void add(int m, int n, scalar **mat, int *rows, int *cols);
+  virtual bool get_block_map(int m, int n, int *rows, int *cols, int *map);
+  virtual void add_block_with_map(int m, int n, scalar **mat, int *map);
+  virtual bool dump(FILE *file, const char *var_name, EMatrixDumpFormat fmt = DF_MATLAB_SPARSE);
+  virtual int get_matrix_size() const;
+  virtual double get_fill_in() const;
+  virtual void multiply(scalar *x, scalar *y);
+
+  int get_block_size() const { return bs; }
+  int get_num_blocks() const { return nnzb; }
+
+  /// Build the scalar CSR structure of the matrix (every block expanded, column
+  /// indices sorted within rows), the arrays are allocated by new[].
+  /// @return - number of entries
+  int get_csr(int *&rp, int *&rj, scalar *&rx) const;
+
+protected:
+  int bs;       // Size of the blocks.
+  int nb;       // Number of block rows (= size / bs).
+  int *Bp;      // Index to Bj, where each block row starts.
+  int *Bj;      // Block column indices (sorted within block rows).
+  scalar *Bx;   // Blocks (bs * bs entries each, row-wise).
+  int nnzb;     // Number of blocks (= Bp[nb]).
+
+  std::vector<int> brows, bcols;   // block indices of a block passed to pre_add_block()
+
+  /// position of the entry (m, n) in Bx, -1 if it is not in the structure
+  int find_entry(int m, int n) const;
+};
+
+#endif
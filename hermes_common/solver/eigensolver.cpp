@@ -0,0 +1,404 @@
+// This file is part of Hermes3D
+//
+// Copyright (c) 2009 hp-FEM group at the University of Nevada, Reno (UNR).
+// Email: hpfem-group@unr.edu, home page: http://hpfem.org/.
+//
+// Hermes3D is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published
+// by the Free Software Foundation; either version 2 of the License,
+// or (at your option) any later version.
+//
+// Hermes3D is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Hermes3D; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include "eigensolver.h"
+#include "../trace.h"
+#include "../error.h"
+#include "../utils.h"
+#include "../callstack.h"
+#include <algorithm>
+
+// Helpers /////////////////////////////////////////////////////////////////////////////////////////
+
+/// x^H y
+static scalar dot(int n, const scalar *x, const scalar *y)
+{
+  scalar s = 0.0;
+  for (int i = 0; i < n; i++) s += conj(x[i]) * y[i];
+  return s;
+}
+
+/// y = y + a x
+static void axpy(int n, scalar a, const scalar *x, scalar *y)
+{
+  for (int i = 0; i < n; i++) y[i] += a * x[i];
+}
+
+/// Eigenvalues and eigenvectors of a dense symmetric matrix by the cyclic Jacobi method.
+/// a[n][n] is destroyed, d[n] gets the eigenvalues, v[n][n] the eigenvectors (in columns).
+static void jacobi_eig(double **a, int n, double *d, double **v)
+{
+  for (int i = 0; i < n; i++) {
+    for (int j = 0; j < n; j++) v[i][j] = 0.0;
+    v[i][i] = 1.0;
+  }
+
+  for (int sweep = 0; sweep < 100; sweep++) {
+    // an entry is negligible relative to its own diagonal entries, not to the norm of
+    // the matrix: the Ritz values near the shift are orders of magnitude above the others
+    bool done = true;
+    for (int p = 0; p < n && done; p++)
+      for (int q = p + 1; q < n; q++)
+        if (fabs(a[p][q]) > 1e-16 * sqrt(fabs(a[p][p] * a[q][q]))) { done = false; break; }
+    if (done) break;
+
+    for (int p = 0; p < n; p++)
+      for (int q = p + 1; q < n; q++) {
+        if (fabs(a[p][q]) <= 1e-16 * sqrt(fabs(a[p][p] * a[q][q]))) continue;
+        double theta = (a[q][q] - a[p][p]) / (2.0 * a[p][q]);
+        double t = (theta >= 0.0 ? 1.0 : -1.0) / (fabs(theta) + sqrt(theta * theta + 1.0));
+        double c = 1.0 / sqrt(t * t + 1.0), s = t * c;
+
+        // A = J^T A J
+        for (int k = 0; k < n; k++) {
+          double akp = a[k][p], akq = a[k][q];
+          a[k][p] = c * akp - s * akq;
+          a[k][q] = s * akp + c * akq;
+        }
+        for (int k = 0; k < n; k++) {
+          double apk = a[p][k], aqk = a[q][k];
+          a[p][k] = c * apk - s * aqk;
+          a[q][k] = s * apk + c * aqk;
+        }
+        for (int k = 0; k < n; k++) {
+          double vkp = v[k][p], vkq = v[k][q];
+          v[k][p] = c * vkp - s * vkq;
+          v[k][q] = s * vkp + c * vkq;
+        }
+      }
+  }
+
+  for (int i = 0; i < n; i++) d[i] = a[i][i];
+}
+
+/// Sorts the Ritz values by the distance of the eigenvalues from the shift (the largest |theta| first)
+struct ThetaCmp {
+  const double *theta;
+  ThetaCmp(const double *theta) : theta(theta) { }
+  bool operator()(int a, int b) const { return fabs(theta[a]) > fabs(theta[b]); }
+};
+
+// EigenSolver /////////////////////////////////////////////////////////////////////////////////////
+
+EigenSolver::EigenSolver(SparseMatrix *A, SparseMatrix *B)
+{
+  _F_
+#if defined(H1D_COMPLEX) || defined(H2D_COMPLEX) || defined(H3D_COMPLEX)
+  // the projected matrix H is real symmetric, complex Hermitian problems would need a
+  // complex one (and a Hermitian eigensolver for it)
+  error("EigenSolver does not support the complex version of Hermes.");
+#endif
+  this->A = dynamic_cast<UMFPackMatrix *>(A);
+  this->B = dynamic_cast<UMFPackMatrix *>(B);
+  if (this->A == NULL || this->B == NULL)
+    error("EigenSolver needs the matrices in the CSC storage (UMFPackMatrix).");
+  if (A->get_size() != B->get_size())
+    error("The matrices A and B have different sizes.");
+
+  shift_solver = SOLVER_UMFPACK;
+  tolerance = 1e-10;
+  max_iters = 1000;
+  subspace_size = -1;
+
+  size = A->get_size();
+  num_eig = 0;
+  num_iters = 0;
+  time = -1.0;
+  eigval = NULL;
+  eigvec = NULL;
+
+  shifted = NULL;
+  shifted_rhs = NULL;
+  solver = NULL;
+  factorized = false;
+}
+
+EigenSolver::~EigenSolver()
+{
+  _F_
+  free();
+  delete [] eigval;
+  delete [] eigvec;
+}
+
+void EigenSolver::free()
+{
+  _F_
+  delete solver; solver = NULL;
+  delete shifted; shifted = NULL;
+  delete shifted_rhs; shifted_rhs = NULL;
+  factorized = false;
+}
+
+void EigenSolver::create_shifted(double sigma)
+{
+  _F_
+  free();
+
+  // full CSC structures of A and B
+  int *ap, *ai, *bp, *bi;
+  scalar *ax, *bx;
+  if (A->is_symmetric_storage()) A->get_full_csc(ap, ai, ax);
+  else { ap = A->Ap; ai = A->Ai; ax = A->Ax; }
+  if (B->is_symmetric_storage()) B->get_full_csc(bp, bi, bx);
+  else { bp = B->Ap; bi = B->Ai; bx = B->Ax; }
+
+  shifted = create_matrix(shift_solver);
+  shifted_rhs = create_vector(shift_solver);
+  shifted->prealloc(size);
+  for (int j = 0; j < size; j++) {
+    for (int k = ap[j]; k < ap[j + 1]; k++) shifted->pre_add_ij(ai[k], j);
+    for (int k = bp[j]; k < bp[j + 1]; k++) shifted->pre_add_ij(bi[k], j);
+  }
+  shifted->alloc();
+  for (int j = 0; j < size; j++) {
+    for (int k = ap[j]; k < ap[j + 1]; k++) shifted->add(ai[k], j, ax[k]);
+    for (int k = bp[j]; k < bp[j + 1]; k++) shifted->add(bi[k], j, -sigma * bx[k]);
+  }
+  shifted->finish();
+  shifted_rhs->alloc(size);
+
+  if (A->is_symmetric_storage()) { delete [] ap; delete [] ai; delete [] ax; }
+  if (B->is_symmetric_storage()) { delete [] bp; delete [] bi; delete [] bx; }
+
+  solver = create_linear_solver(shift_solver, shifted, shifted_rhs);
+}
+
+bool EigenSolver::solve_shifted(scalar *x, scalar *y)
+{
+  _F_
+  shifted_rhs->zero();
+  for (int i = 0; i < size; i++) shifted_rhs->set(i, x[i]);
+  shifted_rhs->finish();
+
+  if (!solver->solve()) return false;
+  memcpy(y, solver->get_solution(), size * sizeof(scalar));
+
+  // the matrix is the same for all the iterations
+  if (!factorized) {
+    solver->set_factorization_scheme(HERMES_REUSE_FACTORIZATION_COMPLETELY);
+    factorized = true;
+  }
+  num_iters++;
+  return true;
+}
+
+bool EigenSolver::solve(int nev, double target)
+{
+  _F_
+  TimePeriod tmr;
+
+  int n = size;
+  if (nev < 1 || nev > n) error("Invalid number of eigenvalues (%d) for a problem of size %d.", nev, n);
+  int m = subspace_size > 0 ? subspace_size : 2 * nev + 20;
+  if (m < nev + 2) m = nev + 2;
+  if (m > n) m = n;
+
+  delete [] eigval; eigval = NULL;
+  delete [] eigvec; eigvec = NULL;
+  num_eig = 0;
+  num_iters = 0;
+
+  // the pole is kept off the target: a target equal to an eigenvalue (to the working
+  // precision) would make the shifted matrix singular, and the round-off amplified by
+  // 1 / (lambda - sigma) would then swamp the other Ritz pairs
+  double sigma = target + 1e-4 * std::max(1.0, fabs(target));
+  create_shifted(sigma);
+
+  // Lanczos vectors (B-orthonormal) and their B-multiples
+  scalar *V = new scalar[(size_t) (m + 1) * n];
+  MEM_CHECK(V);
+  scalar *BV = new scalar[(size_t) (m + 1) * n];
+  MEM_CHECK(BV);
+  scalar *w = new scalar[n];
+  MEM_CHECK(w);
+  scalar *coef = new scalar[m + 1];
+  MEM_CHECK(coef);
+  double **H = new_matrix<double>(m, m);      // projection of the operator
+  double **T = new_matrix<double>(m, m);      // a copy of H (destroyed by jacobi_eig)
+  double **S = new_matrix<double>(m, m);      // Ritz vectors in the basis V
+  double *theta = new double[m];
+  MEM_CHECK(theta);
+  int *order = new int[m];
+  MEM_CHECK(order);
+  bool *locked = new bool[m];               // converged pairs kept from the last restart
+  MEM_CHECK(locked);
+  for (int i = 0; i < m; i++) locked[i] = false;
+  scalar *x = new scalar[n];
+  MEM_CHECK(x);
+  scalar *bx = new scalar[n];
+  MEM_CHECK(bx);
+
+  // deterministic starting vector (not orthogonal to any smooth eigenvector)
+  for (int i = 0; i < n; i++) V[i] = 1.0 + 0.5 * sin(1.0 + i);
+  int restart_seed = 0;
+
+  bool ok = true, converged = false;
+  int k = 0;                  // number of the vectors kept from the last restart
+  double beta = 0.0;          // norm of the residual vector of the last step
+
+  // B-normalize the starting vector
+  B->multiply(V, BV);
+  double nrm = sqrt(REAL(dot(n, V, BV)));
+  if (nrm == 0.0) error("The matrix B is singular.");
+  for (int i = 0; i < n; i++) { V[i] /= nrm; BV[i] /= nrm; }
+
+  while (ok && !converged) {
+    // extend the basis to m vectors: v_{j+1} ~ (A - sigma B)^{-1} B v_j
+    for (int j = k; j < m && ok; j++) {
+      if (num_iters >= max_iters) { ok = false; break; }
+      if (!solve_shifted(BV + (size_t) j * n, w)) {
+        warning("EigenSolver: the shifted system could not be solved.");
+        ok = false;
+        break;
+      }
+
+      // full reorthogonalization (classical Gram-Schmidt, twice) in the B-inner product
+      for (int i = 0; i <= j; i++) coef[i] = 0.0;
+      for (int pass = 0; pass < 2; pass++)
+        for (int i = 0; i <= j; i++) {
+          scalar c = dot(n, BV + (size_t) i * n, w);
+          axpy(n, -c, V + (size_t) i * n, w);
+          coef[i] += c;
+        }
+      // the converged Ritz vectors are eigenvectors, their coupling to the new vector is
+      // only the round-off
+      for (int i = 0; i <= j; i++) H[i][j] = H[j][i] = locked[i] ? 0.0 : REAL(coef[i]);
+
+      scalar *vn = V + (size_t) (j + 1) * n, *bvn = BV + (size_t) (j + 1) * n;
+      B->multiply(w, bvn);
+      beta = sqrt(fabs(REAL(dot(n, w, bvn))));
+
+      double hnorm = 0.0;
+      for (int i = 0; i <= j; i++) hnorm = std::max(hnorm, fabs(H[i][j]));
+      if (beta <= 1e-12 * hnorm) {
+        // invariant subspace found: continue with a new vector orthogonal to the basis
+        beta = 0.0;
+        for (int i = 0; i < n; i++) w[i] = sin(2.0 + i * (3.0 + restart_seed));
+        restart_seed++;
+        for (int pass = 0; pass < 2; pass++)
+          for (int i = 0; i <= j; i++)
+            axpy(n, -dot(n, BV + (size_t) i * n, w), V + (size_t) i * n, w);
+        B->multiply(w, bvn);
+        double wn = sqrt(fabs(REAL(dot(n, w, bvn))));
+        if (wn > 0.0) wn = 1.0 / wn;      // zero if the basis spans the whole space
+        for (int i = 0; i < n; i++) { vn[i] = w[i] * wn; bvn[i] *= wn; }
+      }
+      else
+        for (int i = 0; i < n; i++) { vn[i] = w[i] / beta; bvn[i] /= beta; }
+    }
+    if (!ok) break;
+
+    // Rayleigh-Ritz: H S = S diag(theta)
+    copy_matrix(T, H, m);
+    jacobi_eig(T, m, theta, S);
+    for (int i = 0; i < m; i++) order[i] = i;
+    std::sort(order, order + m, ThetaCmp(theta));
+
+    // the wanted pairs are converged when || A x - lambda B x || <= tol |lambda| || B x ||;
+    // the estimate |beta * S[m-1][i]| of the Ritz residual includes the round-off along the
+    // eigenvectors near the shift and need not get below the tolerance
+    converged = true;
+    for (int i = 0; i < m; i++) locked[i] = false;
+    for (int i = 0; i < nev; i++) {
+      int r = order[i];
+      double lambda = sigma + 1.0 / theta[r];
+      memset(x, 0, n * sizeof(scalar));
+      memset(bx, 0, n * sizeof(scalar));
+      for (int l = 0; l < m; l++) {
+        axpy(n, S[l][r], V + (size_t) l * n, x);
+        axpy(n, S[l][r], BV + (size_t) l * n, bx);
+      }
+      A->multiply(x, w);
+      axpy(n, -lambda, bx, w);
+      locked[i] = REAL(dot(n, w, w)) <= sqr(tolerance * lambda) * REAL(dot(n, bx, bx));
+      if (!locked[i]) converged = false;
+    }
+    if (converged) break;
+
+    // thick restart: keep the wanted Ritz vectors and the residual vector
+    k = std::min(m - 1, nev + (m - nev) / 2);
+    scalar *Y = new scalar[(size_t) k * n];
+    MEM_CHECK(Y);
+    for (int pass = 0; pass < 2; pass++) {
+      scalar *X = pass == 0 ? V : BV;
+      memset(Y, 0, (size_t) k * n * sizeof(scalar));
+      for (int i = 0; i < k; i++)
+        for (int l = 0; l < m; l++)
+          axpy(n, S[l][order[i]], X + (size_t) l * n, Y + (size_t) i * n);
+      memcpy(X, Y, (size_t) k * n * sizeof(scalar));
+      memcpy(X + (size_t) k * n, X + (size_t) m * n, n * sizeof(scalar));
+    }
+    delete [] Y;
+
+    for (int i = 0; i < m; i++)
+      for (int l = 0; l < m; l++) H[i][l] = 0.0;
+    for (int i = 0; i < k; i++) H[i][i] = theta[order[i]];
+  }
+
+  if (!ok && num_iters >= max_iters)
+    warning("EigenSolver: the maximum number of iterations (%d) reached.", max_iters);
+
+  if (ok) {
+    // eigenpairs sorted by the eigenvalues
+    num_eig = nev;
+    eigval = new double[nev];
+    MEM_CHECK(eigval);
+    eigvec = new scalar[(size_t) nev * n];
+    MEM_CHECK(eigvec);
+
+    double *lambda = new double[nev];
+    MEM_CHECK(lambda);
+    int *idx = new int[nev];
+    MEM_CHECK(idx);
+    for (int i = 0; i < nev; i++) { lambda[i] = sigma + 1.0 / theta[order[i]]; idx[i] = i; }
+    for (int i = 1; i < nev; i++)   // insertion sort, nev is small
+      for (int l = i; l > 0 && lambda[idx[l]] < lambda[idx[l - 1]]; l--)
+        std::swap(idx[l], idx[l - 1]);
+
+    for (int i = 0; i < nev; i++) {
+      int r = order[idx[i]];
+      eigval[i] = lambda[idx[i]];
+      scalar *y = eigvec + (size_t) i * n;
+      memset(y, 0, n * sizeof(scalar));
+      for (int l = 0; l < m; l++) axpy(n, S[l][r], V + (size_t) l * n, y);
+    }
+    delete [] lambda;
+    delete [] idx;
+  }
+
+  delete [] V;
+  delete [] BV;
+  delete [] w;
+  delete [] coef;
+  delete [] H;
+  delete [] T;
+  delete [] S;
+  delete [] theta;
+  delete [] order;
+  delete [] locked;
+  delete [] x;
+  delete [] bx;
+  free();
+
+  tmr.tick();
+  time = tmr.accumulated();
+
+  return ok && converged;
+}
@@ -0,0 +1,100 @@
+// This file is part of Hermes3D
+//
+// Copyright (c) 2009 hp-FEM group at the University of Nevada, Reno (UNR).
+// Email: hpfem-group@unr.edu, home page: http://hpfem.org/.
+//
+// Hermes3D is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published
+// by the Free Software Foundation; either version 2 of the License,
+// or (at your option) any later version.
+//
+// Hermes3D is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Hermes3D; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#ifndef _EIGENSOLVER_H_
+#define _EIGENSOLVER_H_
+
+#include "solver.h"
+#include "umfpack_solver.h"
+
+/// Generalized symmetric eigensolver A x = lambda B x (A symmetric, B symmetric positive
+/// definite, typically the stiffness and the mass matrix) for the eigenvalues closest to
+/// a target value sigma.
+///
+/// The shift-invert Lanczos method with thick restarts is used: the operator
+/// (A - sigma B)^{-1} B is self-adjoint in the B-inner product and its dominant eigenvalues
+/// theta = 1 / (lambda - sigma) belong to the eigenvalues lambda closest to sigma. The shifted
+/// matrix is factorized once by the chosen matrix solver and the factorization is reused
+/// (HERMES_REUSE_FACTORIZATION_COMPLETELY) for all the iterations. The Lanczos vectors are
+/// fully reorthogonalized, so no spurious copies of the eigenvalues appear. The pole sigma is
+/// moved slightly off the target (by 1e-4 max(1, |target|)), so that a target equal to an
+/// eigenvalue does not make the shifted matrix singular; the converged eigenpairs are locked.
+///
+/// The matrices are read in the CSC storage (UMFPackMatrix, the symmetric storage included),
+/// the shifted matrix is created by create_matrix() of the chosen solver. The eigenvectors
+/// are B-orthonormal and can be passed to Solution::vector_to_solution() directly.
+///
+/// Real problems only: the constructor fails in the complex version of Hermes.
+///
+/// @ingroup solvers
+class HERMES_API EigenSolver {
+public:
+  EigenSolver(SparseMatrix *A, SparseMatrix *B);
+  virtual ~EigenSolver();
+
+  /// Set the matrix solver the shifted matrix is factorized by (default SOLVER_UMFPACK)
+  void set_shift_solver(MatrixSolverType solver) { this->shift_solver = solver; }
+  /// Set the relative residual || A x - lambda B x || / (|lambda| || B x ||) of the eigenpairs (default 1e-10)
+  void set_tolerance(double tol) { this->tolerance = tol; }
+  /// Set the maximum number of operator applications (default 1000)
+  void set_max_iters(int iters) { this->max_iters = iters; }
+  /// Set the dimension of the Krylov subspace kept between restarts (default 2 nev + 20)
+  void set_subspace_size(int m) { this->subspace_size = m; }
+
+  /// Compute the eigenpairs
+  /// @param[in] nev - number of eigenvalues
+  /// @param[in] target - the eigenvalues closest to 'target' are computed
+  /// @return - true if all the eigenpairs converged
+  bool solve(int nev, double target);
+
+  /// Number of the computed eigenpairs (sorted by the eigenvalues in ascending order)
+  int get_num_eigenvalues() const { return num_eig; }
+  double get_eigenvalue(int i) const { assert(i < num_eig); return eigval[i]; }
+  scalar *get_eigenvector(int i) { assert(i < num_eig); return eigvec + (size_t) i * size; }
+
+  int get_num_iters() const { return num_iters; }
+  double get_time() const { return time; }
+
+protected:
+  UMFPackMatrix *A, *B;
+  MatrixSolverType shift_solver;
+  double tolerance;
+  int max_iters;
+  int subspace_size;
+
+  int size;
+  int num_eig;
+  int num_iters;
+  double time;
+  double *eigval;
+  scalar *eigvec;
+
+  SparseMatrix *shifted;        ///< A - sigma B
+  Vector *shifted_rhs;
+  Solver *solver;
+  bool factorized;
+
+  void free();
+  /// Create and assemble A - sigma B
+  void create_shifted(double sigma);
+  /// y = (A - sigma B)^{-1} x
+  bool solve_shifted(scalar *x, scalar *y);
+};
+
+#endif
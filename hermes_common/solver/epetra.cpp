@@ -89,6 +89,23 @@ void EpetraMatrix::pre_add_ij(int row, int col)
 #endif
 }
 
+void EpetraMatrix::pre_add_block(int m, int n, int *rows, int *cols)
+{
+  _F_
+#ifdef HAVE_EPETRA
+  // the graph takes whole rows, so insert the valid columns at once
+  int *valid = new int[n];
+  MEM_CHECK(valid);
+  int nv = 0;
+  for (int j = 0; j < n; j++)
+    if (cols[j] >= 0) valid[nv++] = cols[j];
+  if (nv > 0)
+    for (int i = 0; i < m; i++)
+      if (rows[i] >= 0) grph->InsertGlobalIndices(rows[i], nv, valid);
+  delete [] valid;
+#endif
+}
+
 void EpetraMatrix::finish()
 {
   _F_
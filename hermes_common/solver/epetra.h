@@ -46,6 +46,7 @@ public:
 
   virtual void prealloc(int n);
   virtual void pre_add_ij(int row, int col);
+  virtual void pre_add_block(int m, int n, int *rows, int *cols);
   virtual void finish();
 
   virtual void alloc();
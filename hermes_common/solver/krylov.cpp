@@ -0,0 +1,505 @@
+// This file is part of Hermes3D
+//
+// Copyright (c) 2009 hp-FEM group at the University of Nevada, Reno (UNR).
+// Email: hpfem-group@unr.edu, home page: http://hpfem.org/.
+//
+// Hermes3D is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published
+// by the Free Software Foundation; either version 2 of the License,
+// or (at your option) any later version.
+//
+// Hermes3D is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Hermes3D; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include "krylov.h"
+#include "../trace.h"
+#include "../error.h"
+#include "../utils.h"
+#include "../callstack.h"
+
+// Vector kernels //////////////////////////////////////////////////////////////////////////////////
+// (the loops are split among threads if Hermes is built with OpenMP)
+
+/// y = x
+static void par_copy(int n, scalar *x, scalar *y)
+{
+#pragma omp parallel for schedule(static)
+  for (int i = 0; i < n; i++) y[i] = x[i];
+}
+
+/// y = y + a x
+static void par_axpy(int n, scalar a, scalar *x, scalar *y)
+{
+#pragma omp parallel for schedule(static)
+  for (int i = 0; i < n; i++) y[i] += a * x[i];
+}
+
+/// y = x + a y
+static void par_xpay(int n, scalar *x, scalar a, scalar *y)
+{
+#pragma omp parallel for schedule(static)
+  for (int i = 0; i < n; i++) y[i] = x[i] + a * y[i];
+}
+
+/// x = a x
+static void par_scal(int n, scalar a, scalar *x)
+{
+#pragma omp parallel for schedule(static)
+  for (int i = 0; i < n; i++) x[i] *= a;
+}
+
+/// (x, y) = sum conj(x_i) y_i
+static scalar par_dot(int n, scalar *x, scalar *y)
+{
+  scalar result = 0.0;
+#pragma omp parallel
+  {
+    scalar part = 0.0;
+#pragma omp for schedule(static)
+    for (int i = 0; i < n; i++) part += conj(x[i]) * y[i];
+#pragma omp critical
+    result += part;
+  }
+  return result;
+}
+
+static double par_norm(int n, scalar *x)
+{
+  return sqrt(REAL(par_dot(n, x, x)));
+}
+
+// Krylov solver ///////////////////////////////////////////////////////////////////////////////////
+
+KrylovSolver::KrylovSolver(UMFPackMatrix *m, UMFPackVector *rhs)
+  : IterSolver(), m(m), bm(NULL), mat(m), op(NULL), rhs(rhs)
+{
+  _F_
+  init();
+}
+
+KrylovSolver::KrylovSolver(BSRMatrix *m, UMFPackVector *rhs)
+  : IterSolver(), m(NULL), bm(m), mat(m), op(NULL), rhs(rhs)
+{
+  _F_
+  init();
+}
+
+KrylovSolver::KrylovSolver(MatrixFreeOperator *op, UMFPackVector *rhs)
+  : IterSolver(), m(NULL), bm(NULL), mat(NULL), op(op), rhs(rhs)
+{
+  _F_
+  init();
+}
+
+void KrylovSolver::init()
+{
+  _F_
+  method = KRYLOV_GMRES;
+  restart = 30;
+  num_iters = 0;
+  residual = 0.0;
+  Rp = Rj = Rk = NULL;
+  pc = NULL;
+  own_pc = false;
+}
+
+KrylovSolver::~KrylovSolver()
+{
+  _F_
+  free_row_storage();
+  free_precond();
+}
+
+void KrylovSolver::free_precond()
+{
+  _F_
+  if (own_pc) delete pc;
+  pc = NULL;
+  own_pc = false;
+#ifdef HAVE_TEUCHOS
+  pc_rcp = Teuchos::null;
+#endif
+  precond_yes = false;
+}
+
+void KrylovSolver::set_solver(const char *name)
+{
+  _F_
+  if (strcasecmp(name, "cg") == 0) method = KRYLOV_CG;
+  else if (strcasecmp(name, "bicgstab") == 0) method = KRYLOV_BICGSTAB;
+  else if (strcasecmp(name, "gmres") == 0) method = KRYLOV_GMRES;
+  else {
+    warning("Unknown Krylov method '%s', using GMRES.", name);
+    method = KRYLOV_GMRES;
+  }
+}
+
+void KrylovSolver::set_precond(const char *name)
+{
+  _F_
+  free_precond();
+  if (strcasecmp(name, "jacobi") == 0) pc = new JacobiPrecond;
+  else if (strcasecmp(name, "ilu") == 0) pc = new ILUPrecond;
+  else if (strcasecmp(name, "ssor") == 0) pc = new SSORPrecond;
+  else if (strcasecmp(name, "none") != 0)
+    warning("Unknown preconditioner '%s', using none.", name);
+  own_pc = precond_yes = (pc != NULL);
+}
+
+#ifdef HAVE_TEUCHOS
+void KrylovSolver::set_precond(Teuchos::RCP<Precond> &pc)
+#else
+void KrylovSolver::set_precond(Precond *pc)
+#endif
+{
+  _F_
+  free_precond();
+#ifdef HAVE_TEUCHOS
+  pc_rcp = pc;
+  this->pc = dynamic_cast<NativePrecond *>(pc.get());
+#else
+  this->pc = dynamic_cast<NativePrecond *>(pc);
+#endif
+  if (this->pc == NULL)
+    warning("Only native preconditioners can be used with the native Krylov solver.");
+  precond_yes = (this->pc != NULL);
+}
+
+void KrylovSolver::free_row_storage()
+{
+  _F_
+  delete [] Rp; Rp = NULL;
+  delete [] Rj; Rj = NULL;
+  delete [] Rk; Rk = NULL;
+}
+
+void KrylovSolver::prepare_row_storage()
+{
+  _F_
+  // transpose the structure of the CSC matrix, keeping just the positions
+  // of the values, so that changes of the matrix entries are seen; the symmetric
+  // storage is expanded to whole rows (both the entry and its mirror point to one value)
+  free_row_storage();
+  int n = m->size;
+  bool sym = m->is_symmetric_storage();
+
+  Rp = new int[n + 1];
+  MEM_CHECK(Rp);
+  memset(Rp, 0, (n + 1) * sizeof(int));
+  for (int col = 0; col < n; col++)
+    for (int k = m->Ap[col]; k < m->Ap[col + 1]; k++) {
+      Rp[m->Ai[k] + 1]++;
+      if (sym && m->Ai[k] != col) Rp[col + 1]++;
+    }
+  for (int i = 0; i < n; i++) Rp[i + 1] += Rp[i];
+
+  Rj = new int[Rp[n]];
+  MEM_CHECK(Rj);
+  Rk = new int[Rp[n]];
+  MEM_CHECK(Rk);
+
+  int *pos = new int[n];
+  MEM_CHECK(pos);
+  memcpy(pos, Rp, n * sizeof(int));
+  for (int col = 0; col < n; col++)
+    for (int k = m->Ap[col]; k < m->Ap[col + 1]; k++) {
+      int row = m->Ai[k];
+      int p = pos[row]++;
+      Rj[p] = col;
+      Rk[p] = k;
+      if (sym && row != col) {
+        p = pos[col]++;
+        Rj[p] = row;
+        Rk[p] = k;
+      }
+    }
+  delete [] pos;
+}
+
+void KrylovSolver::mat_vec(scalar *x, scalar *y)
+{
+  if (op != NULL) {
+    op->apply(x, y);
+    return;
+  }
+  if (bm != NULL) {
+    bm->multiply(x, y);
+    return;
+  }
+
+  int n = m->size;
+  scalar *Ax = m->Ax;
+#pragma omp parallel for schedule(static)
+  for (int i = 0; i < n; i++) {
+    scalar sum = 0.0;
+    for (int k = Rp[i]; k < Rp[i + 1]; k++)
+      sum += Ax[Rk[k]] * x[Rj[k]];
+    y[i] = sum;
+  }
+}
+
+void KrylovSolver::apply_precond(scalar *r, scalar *z)
+{
+  if (pc != NULL && mat != NULL) pc->apply(r, z);
+  else par_copy(get_system_size(), r, z);
+}
+
+bool KrylovSolver::solve()
+{
+  _F_
+  assert(mat != NULL || op != NULL);
+  assert(rhs != NULL);
+  assert(get_system_size() == rhs->length());
+
+  TimePeriod tmr;
+
+  int n = get_system_size();
+  if (sln) delete [] sln;
+  sln = new scalar[n];
+  MEM_CHECK(sln);
+  memset(sln, 0, n * sizeof(scalar));
+
+  num_iters = 0;
+  residual = 0.0;
+
+  double bnorm = par_norm(n, rhs->v);
+  if (bnorm == 0.0) {
+    // zero right-hand side => zero solution
+    tmr.tick();
+    time = tmr.accumulated();
+    return true;
+  }
+
+  if (m != NULL) prepare_row_storage();
+  if (pc != NULL && mat == NULL)
+    warning("The preconditioner needs the matrix, it is not used with a MatrixFreeOperator.");
+  else if (pc != NULL) {
+    pc->create(mat);
+    pc->compute();
+  }
+
+  bool converged = false;
+  switch (method) {
+    case KRYLOV_CG:       converged = solve_cg(sln, rhs->v, bnorm); break;
+    case KRYLOV_GMRES:    converged = solve_gmres(sln, rhs->v, bnorm); break;
+    case KRYLOV_BICGSTAB: converged = solve_bicgstab(sln, rhs->v, bnorm); break;
+  }
+
+  free_row_storage();
+
+  tmr.tick();
+  time = tmr.accumulated();
+
+  if (!converged)
+    warning("Krylov solver did not converge (%d iterations, residual %g).", num_iters, residual);
+  return converged;
+}
+
+bool KrylovSolver::solve_cg(scalar *x, scalar *b, double bnorm)
+{
+  _F_
+  int n = get_system_size();
+  scalar *r = new scalar[n]; MEM_CHECK(r);
+  scalar *z = new scalar[n]; MEM_CHECK(z);
+  scalar *p = new scalar[n]; MEM_CHECK(p);
+  scalar *q = new scalar[n]; MEM_CHECK(q);
+
+  // x = 0 => r = b
+  par_copy(n, b, r);
+  apply_precond(r, z);
+  par_copy(n, z, p);
+  scalar rz = par_dot(n, r, z);
+
+  bool converged = false;
+  residual = 1.0;
+  while (num_iters < max_iters) {
+    mat_vec(p, q);
+    scalar pq = par_dot(n, p, q);
+    if (pq == 0.0) break;                 // breakdown
+    scalar alpha = rz / pq;
+    par_axpy(n, alpha, p, x);
+    par_axpy(n, -alpha, q, r);
+    num_iters++;
+
+    residual = par_norm(n, r) / bnorm;
+    if (residual <= tolerance) { converged = true; break; }
+
+    apply_precond(r, z);
+    scalar rz_new = par_dot(n, r, z);
+    par_xpay(n, z, rz_new / rz, p);
+    rz = rz_new;
+  }
+
+  delete [] r;
+  delete [] z;
+  delete [] p;
+  delete [] q;
+  return converged;
+}
+
+bool KrylovSolver::solve_bicgstab(scalar *x, scalar *b, double bnorm)
+{
+  _F_
+  int n = get_system_size();
+  scalar *r = new scalar[n]; MEM_CHECK(r);
+  scalar *r0 = new scalar[n]; MEM_CHECK(r0);
+  scalar *p = new scalar[n]; MEM_CHECK(p);
+  scalar *v = new scalar[n]; MEM_CHECK(v);
+  scalar *ph = new scalar[n]; MEM_CHECK(ph);
+  scalar *sh = new scalar[n]; MEM_CHECK(sh);
+  scalar *t = new scalar[n]; MEM_CHECK(t);
+
+  // x = 0 => r = b
+  par_copy(n, b, r);
+  par_copy(n, b, r0);
+  memset(p, 0, n * sizeof(scalar));
+  memset(v, 0, n * sizeof(scalar));
+  scalar rho = 1.0, alpha = 1.0, omega = 1.0;
+
+  bool converged = false;
+  residual = 1.0;
+  while (num_iters < max_iters) {
+    scalar rho_new = par_dot(n, r0, r);
+    if (rho_new == 0.0) break;            // breakdown
+
+    // p = r + beta (p - omega v)
+    scalar beta = (rho_new / rho) * (alpha / omega);
+    par_axpy(n, -omega, v, p);
+    par_xpay(n, r, beta, p);
+
+    apply_precond(p, ph);
+    mat_vec(ph, v);
+    scalar r0v = par_dot(n, r0, v);
+    if (r0v == 0.0) break;
+    alpha = rho_new / r0v;
+
+    // s = r - alpha v (stored in r)
+    par_axpy(n, -alpha, v, r);
+    par_axpy(n, alpha, ph, x);
+    num_iters++;
+
+    residual = par_norm(n, r) / bnorm;
+    if (residual <= tolerance) { converged = true; break; }
+
+    apply_precond(r, sh);
+    mat_vec(sh, t);
+    double tt = REAL(par_dot(n, t, t));
+    if (tt == 0.0) break;
+    omega = par_dot(n, t, r) / tt;
+    par_axpy(n, omega, sh, x);
+    par_axpy(n, -omega, t, r);
+
+    residual = par_norm(n, r) / bnorm;
+    if (residual <= tolerance) { converged = true; break; }
+    if (omega == 0.0) break;
+    rho = rho_new;
+  }
+
+  delete [] r;
+  delete [] r0;
+  delete [] p;
+  delete [] v;
+  delete [] ph;
+  delete [] sh;
+  delete [] t;
+  return converged;
+}
+
+bool KrylovSolver::solve_gmres(scalar *x, scalar *b, double bnorm)
+{
+  _F_
+  int n = get_system_size();
+  int k = restart > 0 ? restart : 30;
+
+  // Krylov basis, Hessenberg matrix (column-wise) and Givens rotations
+  scalar *V = new scalar[(k + 1) * n]; MEM_CHECK(V);
+  scalar *H = new scalar[(k + 1) * k]; MEM_CHECK(H);
+  scalar *g = new scalar[k + 1]; MEM_CHECK(g);
+  scalar *y = new scalar[k]; MEM_CHECK(y);
+  double *cs = new double[k]; MEM_CHECK(cs);
+  scalar *sn = new scalar[k]; MEM_CHECK(sn);
+  scalar *w = new scalar[n]; MEM_CHECK(w);
+  scalar *z = new scalar[n]; MEM_CHECK(z);
+
+  bool converged = false;
+  residual = 1.0;
+  while (num_iters < max_iters && !converged) {
+    // r = b - A x
+    scalar *v0 = V;
+    mat_vec(x, v0);
+    par_xpay(n, b, -1.0, v0);
+    double beta = par_norm(n, v0);
+    residual = beta / bnorm;
+    if (residual <= tolerance) { converged = true; break; }
+
+    par_scal(n, 1.0 / beta, v0);
+    for (int i = 0; i <= k; i++) g[i] = 0.0;
+    g[0] = beta;
+
+    int j;
+    for (j = 0; j < k && num_iters < max_iters; j++) {
+      scalar *h = H + j * (k + 1);
+      // w = A M^{-1} v_j
+      apply_precond(V + j * n, z);
+      mat_vec(z, w);
+
+      // modified Gram-Schmidt
+      for (int i = 0; i <= j; i++) {
+        h[i] = par_dot(n, V + i * n, w);
+        par_axpy(n, -h[i], V + i * n, w);
+      }
+      double hn = par_norm(n, w);
+      h[j + 1] = hn;
+      if (hn != 0.0) {
+        par_copy(n, w, V + (j + 1) * n);
+        par_scal(n, 1.0 / hn, V + (j + 1) * n);
+      }
+
+      // apply previous rotations to the new column
+      for (int i = 0; i < j; i++) {
+        scalar t = cs[i] * h[i] + sn[i] * h[i + 1];
+        h[i + 1] = -conj(sn[i]) * h[i] + cs[i] * h[i + 1];
+        h[i] = t;
+      }
+      // new rotation eliminating h[j + 1]
+      double a = magn(h[j]), d = sqrt(a * a + hn * hn);
+      if (a == 0.0) { cs[j] = 0.0; sn[j] = 1.0; }
+      else { cs[j] = a / d; sn[j] = (h[j] / a) * hn / d; }
+      h[j] = cs[j] * h[j] + sn[j] * h[j + 1];
+      h[j + 1] = 0.0;
+      g[j + 1] = -conj(sn[j]) * g[j];
+      g[j] = cs[j] * g[j];
+
+      num_iters++;
+      residual = magn(g[j + 1]) / bnorm;
+      if (residual <= tolerance || hn == 0.0) { converged = (residual <= tolerance); j++; break; }
+    }
+
+    // solve the upper triangular system H y = g and update x += M^{-1} V y
+    for (int i = j - 1; i >= 0; i--) {
+      scalar s = g[i];
+      for (int l = i + 1; l < j; l++) s -= H[l * (k + 1) + i] * y[l];
+      y[i] = s / H[i * (k + 1) + i];
+    }
+    memset(w, 0, n * sizeof(scalar));
+    for (int i = 0; i < j; i++) par_axpy(n, y[i], V + i * n, w);
+    apply_precond(w, z);
+    par_axpy(n, 1.0, z, x);
+  }
+
+  delete [] V;
+  delete [] H;
+  delete [] g;
+  delete [] y;
+  delete [] cs;
+  delete [] sn;
+  delete [] w;
+  delete [] z;
+  return converged;
+}
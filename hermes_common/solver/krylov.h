@@ -0,0 +1,109 @@
+// This file is part of Hermes3D
+//
+// Copyright (c) 2009 hp-FEM group at the University of Nevada, Reno (UNR).
+// Email: hpfem-group@unr.edu, home page: http://hpfem.org/.
+//
+// Hermes3D is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published
+// by the Free Software Foundation; either version 2 of the License,
+// or (at your option) any later version.
+//
+// Hermes3D is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Hermes3D; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#ifndef _KRYLOV_SOLVER_H_
+#define _KRYLOV_SOLVER_H_
+
+#include "solver.h"
+#include "umfpack_solver.h"
+#include "bsr.h"
+#include "precond_native.h"
+
+/// Native Krylov subspace solvers (CG, GMRES(m), BiCGStab) working directly on the CSC
+/// storage of UMFPackMatrix or on the block storage of BSRMatrix. They need no external
+/// library; the matrix-vector product and the vector kernels run in parallel if Hermes
+/// is built with OpenMP. With a MatrixFreeOperator the matrix is not needed at all, only
+/// its action on vectors (no preconditioner is applied then).
+///
+/// @ingroup solvers
+class HERMES_API KrylovSolver : public IterSolver {
+public:
+  KrylovSolver(UMFPackMatrix *m, UMFPackVector *rhs);
+  KrylovSolver(BSRMatrix *m, UMFPackVector *rhs);
+  KrylovSolver(MatrixFreeOperator *op, UMFPackVector *rhs);
+  virtual ~KrylovSolver();
+
+  virtual bool solve();
+
+  virtual int get_num_iters() { return num_iters; }
+  /// Relative residual (|| b - A x || / || b ||) of the last solution.
+  virtual double get_residual() { return residual; }
+
+  /// Set the type of the solver
+  /// @param[in] solver - name of the solver [ gmres | cg | bicgstab ]
+  void set_solver(const char *solver);
+  /// Set the number of iterations after which GMRES is restarted
+  /// @param[in] restart - dimension of the Krylov subspace
+  void set_restart(int restart) { this->restart = restart; }
+
+  /// Set preconditioner
+  /// @param[in] name - name of the preconditioner [ none | jacobi | ilu | ssor ]
+  virtual void set_precond(const char *name);
+
+  /// Set preconditioner (must be a NativePrecond). It is created and computed
+  /// from the matrix at the beginning of every solve().
+#ifdef HAVE_TEUCHOS
+  virtual void set_precond(Teuchos::RCP<Precond> &pc);
+#else
+  virtual void set_precond(Precond *pc);
+#endif
+
+protected:
+  enum EMethod { KRYLOV_CG, KRYLOV_GMRES, KRYLOV_BICGSTAB };
+
+  UMFPackMatrix *m;
+  BSRMatrix *bm;
+  SparseMatrix *mat;    ///< the matrix being solved (m or bm)
+  MatrixFreeOperator *op;  ///< the operator being solved instead of a matrix
+  UMFPackVector *rhs;
+
+  EMethod method;
+  int restart;          ///< Restart parameter of GMRES.
+  int num_iters;        ///< Number of iterations of the last solve.
+  double residual;      ///< Relative residual of the last solve.
+
+  NativePrecond *pc;
+  bool own_pc;          ///< The preconditioner was created by set_precond(const char *).
+#ifdef HAVE_TEUCHOS
+  Teuchos::RCP<Precond> pc_rcp;
+#endif
+  void init();
+  int get_system_size() { return op != NULL ? op->get_size() : mat->get_size(); }
+  void free_precond();
+
+  // Row-wise (CSR) view of the structure of UMFPackMatrix, so that the rows of the
+  // matrix-vector product can be split among threads (BSRMatrix is row-wise already).
+  int *Rp;              ///< Index to Rj/Rk, where each row starts.
+  int *Rj;              ///< Column indices.
+  int *Rk;              ///< Positions of the entries in the value array of the matrix.
+
+  void prepare_row_storage();
+  void free_row_storage();
+
+  /// y = A x
+  void mat_vec(scalar *x, scalar *y);
+  /// z = M^{-1} r (copy if there is no preconditioner)
+  void apply_precond(scalar *r, scalar *z);
+
+  bool solve_cg(scalar *x, scalar *b, double bnorm);
+  bool solve_gmres(scalar *x, scalar *b, double bnorm);
+  bool solve_bicgstab(scalar *x, scalar *b, double bnorm);
+};
+
+#endif
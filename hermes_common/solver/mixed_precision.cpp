@@ -0,0 +1,385 @@
+// This file is part of Hermes3D
+//
+// Copyright (c) 2009 hp-FEM group at the University of Nevada, Reno (UNR).
+// Email: hpfem-group@unr.edu, home page: http://hpfem.org/.
+//
+// Hermes3D is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published
+// by the Free Software Foundation; either version 2 of the License,
+// or (at your option) any later version.
+//
+// Hermes3D is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Hermes3D; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include "mixed_precision.h"
+#include "../trace.h"
+#include "../error.h"
+#include "../utils.h"
+#include "../callstack.h"
+
+// The single precision routines of the sequential SuperLU. Their headers (slu_sdefs.h,
+// slu_cdefs.h) cannot be included together with the double precision ones included by
+// superlu.h, so the few routines needed are declared here; the types they use come from
+// supermatrix.h and slu_util.h.
+#if defined(WITH_SUPERLU) && !defined(SLU_MT)
+  #define WITH_SUPERLU_SINGLE
+
+  #if !defined(H1D_COMPLEX) && !defined(H2D_COMPLEX) && !defined(H3D_COMPLEX)
+    typedef float slu_single;
+    #define SLU_SINGLE_DTYPE        SLU_S
+    #define SLU_SINGLE_CREATE_CSC   sCreate_CompCol_Matrix
+    #define SLU_SINGLE_CREATE_DENSE sCreate_Dense_Matrix
+    #define SLU_SINGLE_GSTRF        sgstrf
+    #define SLU_SINGLE_GSTRS        sgstrs
+  #else
+    typedef struct { float r, i; } slu_single;    // SuperLU's 'complex'
+    #define SLU_SINGLE_DTYPE        SLU_C
+    #define SLU_SINGLE_CREATE_CSC   cCreate_CompCol_Matrix
+    #define SLU_SINGLE_CREATE_DENSE cCreate_Dense_Matrix
+    #define SLU_SINGLE_GSTRF        cgstrf
+    #define SLU_SINGLE_GSTRS        cgstrs
+  #endif
+
+  extern "C" {
+    void SLU_SINGLE_CREATE_CSC(SuperMatrix *, int, int, int, slu_single *, int *, int *,
+                               Stype_t, Dtype_t, Mtype_t);
+    void SLU_SINGLE_CREATE_DENSE(SuperMatrix *, int, int, slu_single *, int,
+                                 Stype_t, Dtype_t, Mtype_t);
+    void SLU_SINGLE_GSTRF(superlu_options_t *, SuperMatrix *, int, int, int *, void *, int,
+                          int *, int *, SuperMatrix *, SuperMatrix *, SuperLUStat_t *, int *);
+    void SLU_SINGLE_GSTRS(trans_t, SuperMatrix *, SuperMatrix *, int *, int *, SuperMatrix *,
+                          SuperLUStat_t *, int *);
+  }
+
+  static inline void to_single(scalar a, slu_single &s)
+  {
+  #if !defined(H1D_COMPLEX) && !defined(H2D_COMPLEX) && !defined(H3D_COMPLEX)
+    s = (float) a;
+  #else
+    s.r = (float) a.real(); s.i = (float) a.imag();
+  #endif
+  }
+
+  static inline scalar from_single(const slu_single &s)
+  {
+  #if !defined(H1D_COMPLEX) && !defined(H2D_COMPLEX) && !defined(H3D_COMPLEX)
+    return s;
+  #else
+    return cplx(s.r, s.i);
+  #endif
+  }
+
+  struct SingleLU {
+    SuperMatrix L, U;     // L/U factors of Pr A Pc (single precision)
+    int *perm_r;          // Row permutation from partial pivoting.
+    int *perm_c;          // Column permutation to reduce fill-in.
+    slu_single *work;     // Right-hand side / solution of the triangular solves.
+  };
+#else
+  struct SingleLU { };
+#endif
+
+static double norm2(int n, scalar *x)
+{
+  double sum = 0.0;
+  for (int i = 0; i < n; i++) sum += sqr(magn(x[i]));
+  return sqrt(sum);
+}
+
+static double norm_inf(int n, scalar *x)
+{
+  double mx = 0.0;
+  for (int i = 0; i < n; i++) mx = std::max(mx, (double) magn(x[i]));
+  return mx;
+}
+
+// Mixed precision solver //////////////////////////////////////////////////////////////////////////
+
+MixedPrecisionSolver::MixedPrecisionSolver(UMFPackMatrix *m, UMFPackVector *rhs)
+  : LinearSolver(HERMES_FACTORIZE_FROM_SCRATCH), m(m), rhs(rhs)
+{
+  _F_
+  init();
+}
+
+MixedPrecisionSolver::MixedPrecisionSolver(SuperLUMatrix *m, SuperLUVector *rhs)
+  : LinearSolver(HERMES_FACTORIZE_FROM_SCRATCH), m(m), rhs(rhs)
+{
+  _F_
+  init();
+}
+
+void MixedPrecisionSolver::init()
+{
+  _F_
+#ifndef WITH_SUPERLU
+  error(SUPERLU_NOT_COMPILED);
+#elif defined(SLU_MT)
+  error("The mixed precision solver needs the sequential SuperLU, not SuperLU_MT.");
+#endif
+  tolerance = 1e-12;
+  max_refinements = 20;
+  num_refinements = 0;
+  residual = 0.0;
+  lu = NULL;
+  factorized = false;
+  anorm = 0.0;
+  size = 0;
+  Ap = Ai = NULL;
+  Ax = NULL;
+}
+
+MixedPrecisionSolver::~MixedPrecisionSolver()
+{
+  _F_
+  free_factors();
+}
+
+void MixedPrecisionSolver::get_csc()
+{
+  _F_
+  // the arrays may have been reallocated since the last solve
+  UMFPackMatrix *um = dynamic_cast<UMFPackMatrix *>(m);
+  if (um != NULL) {
+    size = um->size;
+    Ap = um->Ap; Ai = um->Ai; Ax = um->Ax;
+  }
+  else {
+    SuperLUMatrix *sm = static_cast<SuperLUMatrix *>(m);
+    size = sm->size;
+    // slu_scalar has the same layout as scalar
+    Ap = sm->Ap; Ai = sm->Ai; Ax = (scalar *) sm->Ax;
+  }
+}
+
+void MixedPrecisionSolver::free_factors()
+{
+  _F_
+#ifdef WITH_SUPERLU_SINGLE
+  if (lu != NULL) {
+    if (factorized) {
+      Destroy_SuperNode_Matrix(&lu->L);
+      Destroy_CompCol_Matrix(&lu->U);
+    }
+    delete [] lu->perm_r;
+    delete [] lu->perm_c;
+    delete [] lu->work;
+    delete lu;
+  }
+#endif
+  lu = NULL;
+  factorized = false;
+}
+
+bool MixedPrecisionSolver::factorize()
+{
+  _F_
+#ifdef WITH_SUPERLU_SINGLE
+  free_factors();
+
+  // single precision copy of the whole matrix (the symmetric storage is expanded)
+  int *ap = Ap, *ai = Ai;
+  scalar *ax = Ax;
+  int nnz = Ap[size];
+  if (m->is_symmetric_storage())
+    nnz = static_cast<UMFPackMatrix *>(m)->get_full_csc(ap, ai, ax);
+
+  int *sap = new int[size + 1]; MEM_CHECK(sap);
+  int *sai = new int[nnz]; MEM_CHECK(sai);
+  slu_single *sax = new slu_single[nnz]; MEM_CHECK(sax);
+  memcpy(sap, ap, (size + 1) * sizeof(int));
+  memcpy(sai, ai, nnz * sizeof(int));
+  for (int k = 0; k < nnz; k++) to_single(ax[k], sax[k]);
+
+  // || A ||_inf for the stopping test of the refinement
+  double *row_sum = new double[size]; MEM_CHECK(row_sum);
+  memset(row_sum, 0, size * sizeof(double));
+  for (int k = 0; k < nnz; k++) row_sum[ai[k]] += magn(ax[k]);
+  anorm = 0.0;
+  for (int i = 0; i < size; i++) anorm = std::max(anorm, row_sum[i]);
+  delete [] row_sum;
+  if (ap != Ap) {
+    delete [] ap;
+    delete [] ai;
+    delete [] ax;
+  }
+
+  lu = new SingleLU;
+  MEM_CHECK(lu);
+  lu->perm_r = new int[size]; MEM_CHECK(lu->perm_r);
+  lu->perm_c = new int[size]; MEM_CHECK(lu->perm_c);
+  lu->work = new slu_single[size]; MEM_CHECK(lu->work);
+  int *etree = new int[size]; MEM_CHECK(etree);
+
+  superlu_options_t options;
+  set_default_options(&options);
+  options.ColPerm = COLAMD;
+
+  SuperMatrix A, AC;
+  SLU_SINGLE_CREATE_CSC(&A, size, size, nnz, sax, sai, sap, SLU_NC, SLU_SINGLE_DTYPE, SLU_GE);
+
+  SuperLUStat_t stat;
+  StatInit(&stat);
+
+  // column ordering (COLAMD), elimination tree and the factorization
+  get_perm_c(3, &A, lu->perm_c);
+  sp_preorder(&options, &A, lu->perm_c, etree, &AC);
+  int panel_size = sp_ienv(1);
+  int relax = sp_ienv(2);
+  int info;
+  SLU_SINGLE_GSTRF(&options, &AC, relax, panel_size, etree, NULL, 0, lu->perm_c, lu->perm_r,
+                   &lu->L, &lu->U, &stat, &info);
+
+  StatFree(&stat);
+  Destroy_CompCol_Permuted(&AC);
+  Destroy_SuperMatrix_Store(&A);
+  // the single precision copy of the matrix is not needed any more
+  delete [] sap;
+  delete [] sai;
+  delete [] sax;
+  delete [] etree;
+
+  if (info != 0) {
+    if (info > 0 && info <= size)
+      warning("Mixed precision solver: the single precision factor U is singular.");
+    else
+      warning("Mixed precision solver: the factorization failed (info = %d).", info);
+    // L and U are allocated even if the factorization failed in the middle
+    if (info > 0 && info <= size) factorized = true;
+    free_factors();
+    return false;
+  }
+
+  factorized = true;
+  return true;
+#else
+  return false;
+#endif
+}
+
+void MixedPrecisionSolver::solve_single(scalar *r, scalar *d)
+{
+  _F_
+#ifdef WITH_SUPERLU_SINGLE
+  for (int i = 0; i < size; i++) to_single(r[i], lu->work[i]);
+
+  SuperMatrix B;
+  SLU_SINGLE_CREATE_DENSE(&B, size, 1, lu->work, size, SLU_DN, SLU_SINGLE_DTYPE, SLU_GE);
+  SuperLUStat_t stat;
+  StatInit(&stat);
+  int info;
+  SLU_SINGLE_GSTRS(NOTRANS, &lu->L, &lu->U, lu->perm_c, lu->perm_r, &B, &stat, &info);
+  StatFree(&stat);
+  Destroy_SuperMatrix_Store(&B);
+
+  for (int i = 0; i < size; i++) d[i] = from_single(lu->work[i]);
+#endif
+}
+
+void MixedPrecisionSolver::residual_vec(scalar *b, scalar *x, scalar *r)
+{
+  _F_
+  bool sym = m->is_symmetric_storage();
+  memcpy(r, b, size * sizeof(scalar));
+  for (int j = 0; j < size; j++)
+    for (int k = Ap[j]; k < Ap[j + 1]; k++) {
+      int i = Ai[k];
+      r[i] -= Ax[k] * x[j];
+      if (sym && i != j) r[j] -= Ax[k] * x[i];
+    }
+}
+
+bool MixedPrecisionSolver::refine(scalar *b, scalar *x)
+{
+  _F_
+  scalar *r = new scalar[size]; MEM_CHECK(r);
+  scalar *d = new scalar[size]; MEM_CHECK(d);
+
+  double bnorm = norm2(size, b);
+  if (bnorm == 0.0) bnorm = 1.0;
+
+  // x_0 = (LU)^{-1} b is the plain single precision solution
+  memset(x, 0, size * sizeof(scalar));
+  memcpy(r, b, size * sizeof(scalar));
+  double res = 1.0, prev = HUGE_VAL;
+  int steps = 0;
+  bool converged = false, stagnated = false;
+  while (true) {
+    solve_single(r, d);
+    for (int i = 0; i < size; i++) x[i] += d[i];
+    residual_vec(b, x, r);
+    res = norm2(size, r) / bnorm;
+    if (res <= tolerance) { converged = true; break; }
+    // the solution is as accurate as the double precision factorization would give
+    // (the backward error test of LAPACK's dsgesv)
+    if (norm_inf(size, r) <= norm_inf(size, x) * anorm * DBL_EPSILON * sqrt((double) size)) {
+      converged = true;
+      break;
+    }
+    // the refinement converges linearly (slowly for ill-conditioned matrices), stop only
+    // if the residual does not decrease at all
+    if (res >= prev) { stagnated = true; break; }
+    if (steps >= max_refinements) break;
+    prev = res;
+    steps++;
+  }
+
+  delete [] r;
+  delete [] d;
+
+  num_refinements = std::max(num_refinements, steps);
+  residual = std::max(residual, res);
+  if (!converged)
+    warning("Mixed precision solver: the tolerance %g was not reached, the residual is %g after %d "
+            "refinement steps (%s).", tolerance, res, steps,
+            stagnated ? "the refinement stagnates, the matrix may be too ill-conditioned for the "
+                        "single precision factorization" : "the maximum number of steps was reached");
+  return converged;
+}
+
+bool MixedPrecisionSolver::solve()
+{
+  _F_
+  assert(m != NULL);
+  assert(rhs != NULL);
+  Vector *b = rhs;
+  return solve_multiple(1, &b);
+}
+
+bool MixedPrecisionSolver::solve_multiple(int nrhs, Vector **rhs)
+{
+  _F_
+  assert(m != NULL);
+  assert(nrhs > 0);
+
+  TimePeriod tmr;
+
+  get_csc();
+  if (!factorized || factorization_scheme != HERMES_REUSE_FACTORIZATION_COMPLETELY)
+    if (!factorize()) return false;
+
+  scalar *b = gather_rhs(size, nrhs, rhs);
+  delete [] sln;
+  sln = new scalar[size * nrhs];
+  MEM_CHECK(sln);
+  num_sln = nrhs;
+  sln_size = size;
+
+  num_refinements = 0;
+  residual = 0.0;
+  bool ok = true;
+  for (int k = 0; k < nrhs; k++)
+    if (!refine(b + k * size, sln + k * size)) ok = false;
+  delete [] b;
+
+  tmr.tick();
+  time = tmr.accumulated();
+
+  return ok;
+}
@@ -0,0 +1,97 @@
+// This file is part of Hermes3D
+//
+// Copyright (c) 2009 hp-FEM group at the University of Nevada, Reno (UNR).
+// Email: hpfem-group@unr.edu, home page: http://hpfem.org/.
+//
+// Hermes3D is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published
+// by the Free Software Foundation; either version 2 of the License,
+// or (at your option) any later version.
+//
+// Hermes3D is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Hermes3D; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#ifndef _MIXED_PRECISION_SOLVER_H_
+#define _MIXED_PRECISION_SOLVER_H_
+
+#include "solver.h"
+#include "umfpack_solver.h"
+#include "superlu.h"
+
+struct SingleLU;
+
+/// Mixed precision direct solver
+///
+/// A single precision copy of the matrix is factorized by SuperLU (sgstrf, cgstrf in the
+/// complex case), which takes half of the memory and of the memory traffic of the double
+/// precision factorization. The double precision accuracy is then recovered by iterative
+/// refinement against the original (double precision) matrix:
+///   r = b - A x,  d = (LU)^{-1} r  (single precision),  x = x + d,
+/// until || r || / || b || drops below the tolerance or the solution is as accurate as the
+/// double precision factorization would give. The refinement converges as long as
+/// the matrix is reasonably conditioned (cond(A) well below 1e7), slowly for the worse
+/// conditioned ones. If the residual stops decreasing or the maximum number of steps is
+/// reached before the tolerance, the solve fails with a warning.
+///
+/// Only the complete reuse of the factorization (HERMES_REUSE_FACTORIZATION_COMPLETELY) is
+/// distinguished, the other schemes factorize the matrix from scratch.
+///
+/// @ingroup solvers
+class HERMES_API MixedPrecisionSolver : public LinearSolver {
+public:
+  MixedPrecisionSolver(UMFPackMatrix *m, UMFPackVector *rhs);
+  MixedPrecisionSolver(SuperLUMatrix *m, SuperLUVector *rhs);
+  virtual ~MixedPrecisionSolver();
+
+  virtual bool solve();
+  virtual bool solve_multiple(int nrhs, Vector **rhs);
+
+  /// Set the relative residual the refinement stops at
+  void set_tolerance(double tol) { this->tolerance = tol; }
+  /// Set the maximum number of refinement steps
+  void set_max_refinements(int steps) { this->max_refinements = steps; }
+
+  /// Number of refinement steps of the last solve (the maximum over all right-hand sides)
+  int get_num_refinements() const { return num_refinements; }
+  /// Relative residual (|| b - A x || / || b ||) of the last solve (the maximum over all
+  /// right-hand sides)
+  double get_residual() const { return residual; }
+
+protected:
+  SparseMatrix *m;
+  Vector *rhs;
+
+  double tolerance;
+  int max_refinements;
+  int num_refinements;
+  double residual;
+
+  SingleLU *lu;         ///< Single precision LU factors (SuperLU structures).
+  bool factorized;
+  double anorm;         ///< || A ||_inf
+
+  // CSC storage of the (double precision) matrix
+  int size;
+  int *Ap, *Ai;
+  scalar *Ax;
+
+  void init();
+  void get_csc();
+  bool factorize();
+  void free_factors();
+
+  /// d = (LU)^{-1} r in single precision
+  void solve_single(scalar *r, scalar *d);
+  /// r = b - A x
+  void residual_vec(scalar *b, scalar *x, scalar *r);
+  /// Solve A x = b by the refinement, x is overwritten
+  bool refine(scalar *b, scalar *x);
+};
+
+#endif
@@ -90,36 +90,28 @@ MumpsMatrix::~MumpsMatrix()
 void MumpsMatrix::alloc()
 {
   _F_
-  assert(pages != NULL);
+  assert(pattern.is_initialized());
   assert(size > 0);
 
-  // initialize the arrays Ap and Ai
-  Ap = new int [size + 1];
-  MEM_CHECK(Ap);
-  int aisize = get_num_indices();
-  Ai = new int [aisize];
-  MEM_CHECK(Ai);
-
-  // sort the indices and remove duplicities, insert into Ai
-  int i, pos = 0;
-  for (i = 0; i < size; i++) {
-    Ap[i] = pos;
-    pos += sort_and_store_indices(pages[i], Ai + pos, Ai + aisize);
-  }
-  Ap[i] = pos;
-
-  delete [] pages;
-  pages = NULL;
-
-  nnz = Ap[size];
+  // build the CSC structure: sorted row indices of every column, without duplicities
+  nnz = pattern.build(true, Ap, Ai, sym_storage);
+  pattern.free();
 
   Ax = new mumps_scalar[nnz];
   memset(Ax, 0, sizeof(mumps_scalar) * nnz);
 
   irn = new int[nnz];
-  memset(irn, 0, sizeof(int) * nnz);
   jcn = new int[nnz];
-  memset(jcn, 0, sizeof(int) * nnz);
+  // The coordinates of the entries are known from the sparse structure
+  // (MUMPS is indexing from 1).
+  for (int col = 0; col < size; col++)
+  {
+    for (int k = Ap[col]; k < Ap[col + 1]; k++)
+    {
+      irn[k] = Ai[k] + 1;
+      jcn[k] = col + 1;
+    }
+  }
 }
 
 void MumpsMatrix::free()
@@ -136,6 +128,7 @@ void MumpsMatrix::free()
 scalar MumpsMatrix::get(int m, int n)
 {
   _F_
+  if (sym_storage && m > n) std::swap(m, n);
   // Find m-th row in the n-th column.
   int mid = find_position(Ai + Ap[n], Ap[n + 1] - Ap[n], m);
   // Return 0 if the entry has not been found.
@@ -163,6 +156,7 @@ void MumpsMatrix::add(int m, int n, scalar v)
   //          ran well).
   if (m >= 0 && n >= 0) // ignore dirichlet DOFs
   {   
+    if (sym_storage && m > n) return;   // the lower triangle is not stored
     // Find m-th row in the n-th column.
     int pos = find_position(Ai + Ap[n], Ap[n + 1] - Ap[n], m);
     // Make sure we are adding to an existing non-zero entry.
@@ -189,6 +183,51 @@ void MumpsMatrix::add(int m, int n, scalar **mat, int *rows, int *cols)
       add(rows[i], cols[j], mat[i][j]);
 }
 
+bool MumpsMatrix::get_block_map(int m, int n, int *rows, int *cols, int *map)
+{
+  _F_
+  for (int j = 0; j < n; j++)       // cols
+  {
+    int col = cols[j];
+    for (int i = 0; i < m; i++)     // rows
+    {
+      if (rows[i] < 0 || col < 0 || (sym_storage && rows[i] > col))   // dirichlet DOFs (and the lower
+      {                                                                 // triangle if symmetric) are not stored
+        map[i * n + j] = -1;
+        continue;
+      }
+      // Find i-th row in the j-th column.
+      int pos = find_position(Ai + Ap[col], Ap[col + 1] - Ap[col], rows[i]);
+      if (pos < 0) 
+        error("Sparse matrix entry not found");
+      map[i * n + j] = Ap[col] + pos;
+    }
+  }
+  return true;
+}
+
+void MumpsMatrix::add_block_with_map(int m, int n, scalar **mat, int *map)
+{
+  _F_
+  // NOTE: irn, jcn have already been filled in alloc().
+  for (int i = 0; i < m; i++)       // rows
+  {
+    scalar *row = mat[i];
+    int *row_map = map + i * n;
+    for (int j = 0; j < n; j++)     // cols
+    {
+      int pos = row_map[j];
+      if (pos < 0) continue;
+#if !defined(H2D_COMPLEX) && !defined(H3D_COMPLEX)
+      Ax[pos] += row[j];
+#else
+      Ax[pos].r += row[j].real();
+      Ax[pos].i += row[j].imag();
+#endif
+    }
+  }
+}
+
 /// dumping matrix and right-hand side
 ///
 bool MumpsMatrix::dump(FILE *file, const char *var_name, EMatrixDumpFormat fmt)
@@ -215,6 +254,8 @@ bool MumpsMatrix::dump(FILE *file, const char *var_name, EMatrixDumpFormat fmt)
           fprintf(file, "%d %d %lf+%lfi\n", Ai[i] + 1, j + 1, MUMPS_SCALAR(Ax[i]));
 #endif          
       fprintf(file, "];\n%s = spconvert(temp);\n", var_name);
+      if (sym_storage)  // only the upper triangle was written
+        fprintf(file, "%s = %s + %s.' - diag(diag(%s));\n", var_name, var_name, var_name, var_name);
 
       return true;
 
@@ -412,10 +453,38 @@ bool MumpsSolver::solve()
 {
   _F_
 #ifdef WITH_MUMPS
-  bool ret = false;
   assert(m != NULL);
   assert(rhs != NULL);
 
+  return solve_block(1, rhs->v);
+#else
+  return false;
+#endif
+}
+
+bool MumpsSolver::solve_multiple(int nrhs, Vector **rhs)
+{
+  _F_
+#ifdef WITH_MUMPS
+  assert(m != NULL);
+  assert(nrhs > 0);
+
+  // mumps_scalar has the same layout as scalar
+  scalar *b = gather_rhs(m->size, nrhs, rhs);
+  bool ret = solve_block(nrhs, (mumps_scalar *) b);
+  delete [] b;
+  return ret;
+#else
+  return false;
+#endif
+}
+
+bool MumpsSolver::solve_block(int nrhs, mumps_scalar *b)
+{
+  _F_
+#ifdef WITH_MUMPS
+  bool ret = false;
+
   TimePeriod tmr;
 
   MUMPS_STRUCT id;
@@ -423,7 +492,7 @@ bool MumpsSolver::solve()
   // Initialize a MUMPS instance
   id.job = JOB_INIT;
   id.par = 1; // host also performs calculations
-  id.sym = 0; // 0 = unsymmetric
+  id.sym = m->sym_storage ? 2 : 0; // 0 = unsymmetric, 2 = general symmetric (LDL^T, upper triangle given)
   id.comm_fortran=USE_COMM_WORLD;
   
   MUMPS(&id);
@@ -436,9 +505,11 @@ bool MumpsSolver::solve()
   id.jcn = m->jcn;
   id.a = m->Ax;
 
-  // right-hand side
-  id.rhs = new mumps_scalar[m->size];
-  memcpy(id.rhs, rhs->v, m->size * sizeof(mumps_scalar));
+  // right-hand sides (overwritten by the solutions)
+  id.rhs = new mumps_scalar[m->size * nrhs];
+  memcpy(id.rhs, b, m->size * nrhs * sizeof(mumps_scalar));
+  id.nrhs = nrhs;
+  id.lrhs = m->size;
 
   // No printings
   id.ICNTL(1) = -1;
@@ -456,12 +527,14 @@ bool MumpsSolver::solve()
 
   if (ret) {
     delete [] sln;
-    sln = new scalar[m->size];
+    sln = new scalar[m->size * nrhs];
+    num_sln = nrhs;
+    sln_size = m->size;
 #if !defined(H2D_COMPLEX) && !defined(H3D_COMPLEX)
-    for (int i = 0; i < rhs->size; i++)
+    for (int i = 0; i < m->size * nrhs; i++)
       sln[i] = id.rhs[i];
 #else
-    for (int i = 0; i < rhs->size; i++)
+    for (int i = 0; i < m->size * nrhs; i++)
       sln[i] = cplx(id.rhs[i].r, id.rhs[i].i);
 #endif
   }
@@ -64,12 +64,17 @@ public:
   virtual void zero();
   virtual void add(int m, int n, scalar v);
   virtual void add(int m, int n, scalar **mat, int *rows, int *cols);
+  virtual bool get_block_map(int m, int n, int *rows, int *cols, int *map);
+  virtual void add_block_with_map(int m, int n, scalar **mat, int *map);
   virtual bool dump(FILE *file, const char *var_name, EMatrixDumpFormat fmt = DF_MATLAB_SPARSE);
   virtual int get_matrix_size() const;
   virtual double get_fill_in() const;
+  /// The symmetric storage is factorized by the LDL^T factorization of MUMPS.
+  virtual bool set_symmetric_storage(bool sym) { sym_storage = sym; return true; }
 
 protected:
   // MUMPS specific data structures for storing the system matrix (CSC format).
+  // Only the upper triangle is stored in the case of the symmetric storage.
   int nnz;          // Number of non-zero elements. 
   int *irn;         // Row indices.
   int *jcn;         // Column indices.
@@ -117,10 +122,14 @@ public:
   virtual ~MumpsSolver();
 
   virtual bool solve();
+  virtual bool solve_multiple(int nrhs, Vector **rhs);
 
 protected:
   MumpsMatrix *m;
   MumpsVector *rhs;
+
+  /// Factorize the matrix and solve for the block of nrhs right-hand sides (column-major)
+  bool solve_block(int nrhs, mumps_scalar *b);
 };
 
 #endif
@@ -83,35 +83,14 @@ PardisoMatrix::~PardisoMatrix() {
   free();
 }
 
-void PardisoMatrix::pre_add_ij(int row, int col) {
-  _F_
-  SparseMatrix::pre_add_ij(col, row);
-}
-
 void PardisoMatrix::alloc() {
   _F_
-  assert(pages != NULL);
+  assert(pattern.is_initialized());
   assert(size > 0);
 
-  // initialize the arrays Ap and Ai
-  Ap = new int[size + 1];
-  MEM_CHECK(Ap);
-  int aisize = get_num_indices();
-  Ai = new int[aisize];
-  MEM_CHECK(Ai);
-
-  // sort the indices and remove duplicities, insert into Ai
-  int i, pos = 0;
-  for (i = 0; i < size; i++) {
-    Ap[i] = pos;
-    pos += sort_and_store_indices(pages[i], Ai + pos, Ai + aisize);
-  }
-  Ap[i] = pos;
-
-  delete[] pages;
-  pages = NULL;
-
-  nnz = Ap[size];
+  // build the CSR structure: sorted column indices of every row, without duplicities
+  nnz = pattern.build(false, Ap, Ai, sym_storage);
+  pattern.free();
   
   Ax = new scalar[nnz];
   MEM_CHECK(Ax);
@@ -129,6 +108,7 @@ void PardisoMatrix::free() {
 scalar PardisoMatrix::get(int m, int n)
 {
   _F_
+  if (sym_storage && m > n) std::swap(m, n);
   // Find n-th column in the m-th row.
   int mid = find_position(Ai + Ap[m], Ap[m + 1] - Ap[m], n);
 
@@ -147,6 +127,7 @@ void PardisoMatrix::add(int m, int n, scalar v) {
   _F_
   if (v != 0.0 && m >= 0 && n >= 0) // ignore dirichlet DOFs
   {   
+    if (sym_storage && m > n) return;   // the lower triangle is not stored
     // Find n-th column in the m-th row.
     int pos = find_position(Ai + Ap[m], Ap[m + 1] - Ap[m], n);
     // Make sure we are adding to an existing non-zero entry.
@@ -164,6 +145,40 @@ void PardisoMatrix::add(int m, int n, scalar **mat, int *rows, int *cols) {
       add(rows[i], cols[j], mat[i][j]);
 }
 
+bool PardisoMatrix::get_block_map(int m, int n, int *rows, int *cols, int *map) {
+  _F_
+  for (int i = 0; i < m; i++)       // rows
+  {
+    int row = rows[i];
+    for (int j = 0; j < n; j++)     // cols
+    {
+      if (row < 0 || cols[j] < 0 || (sym_storage && row > cols[j]))   // dirichlet DOFs (and the lower
+      {                                                                 // triangle if symmetric) are not stored
+        map[i * n + j] = -1;
+        continue;
+      }
+      // Find j-th column in the i-th row.
+      int pos = find_position(Ai + Ap[row], Ap[row + 1] - Ap[row], cols[j]);
+      if (pos < 0) 
+        error("Sparse matrix entry not found");
+      map[i * n + j] = Ap[row] + pos;
+    }
+  }
+  return true;
+}
+
+void PardisoMatrix::add_block_with_map(int m, int n, scalar **mat, int *map) {
+  _F_
+  for (int i = 0; i < m; i++)       // rows
+  {
+    scalar *row = mat[i];
+    int *row_map = map + i * n;
+    for (int j = 0; j < n; j++)     // cols
+      if (row_map[j] >= 0)
+        Ax[row_map[j]] += row[j];
+  }
+}
+
 /// dumping matrix and right-hand side
 ///
 bool PardisoMatrix::dump(FILE *file, const char *var_name, EMatrixDumpFormat fmt) {
@@ -176,6 +191,8 @@ bool PardisoMatrix::dump(FILE *file, const char *var_name, EMatrixDumpFormat fmt
         for (int i = Ap[j]; i < Ap[j + 1]; i++)
           fprintf(file, "%d %d " SCALAR_FMT ";\n", Ai[i] + 1, j + 1, SCALAR(Ax[i]));
       fprintf(file, "];\n%s = spconvert(temp);\n", var_name);
+      if (sym_storage)  // only the upper triangle was written
+        fprintf(file, "%s = %s + %s.' - diag(diag(%s));\n", var_name, var_name, var_name, var_name);
 
       return true;
 
@@ -302,7 +319,7 @@ bool PardisoVector::dump(FILE *file, const char *var_name, EMatrixDumpFormat fmt
 // PARDISO solver //////
 
 PardisoLinearSolver::PardisoLinearSolver(PardisoMatrix *m, PardisoVector *rhs)
-  : LinearSolver(), m(m), rhs(rhs)
+  : LinearSolver(), m(m), rhs(rhs), spd(false)
 {
   _F_
 #ifdef WITH_PARDISO
@@ -325,6 +342,30 @@ bool PardisoLinearSolver::solve() {
   assert(m != NULL);
   assert(rhs != NULL);
 
+  return solve_block(1, rhs->v);
+#else
+  return false;
+#endif
+}
+
+bool PardisoLinearSolver::solve_multiple(int nrhs, Vector **rhs) {
+  _F_
+#ifdef WITH_PARDISO
+  assert(m != NULL);
+  assert(nrhs > 0);
+
+  scalar *b = gather_rhs(m->size, nrhs, rhs);
+  bool res = solve_block(nrhs, b);
+  delete [] b;
+  return res;
+#else
+  return false;
+#endif
+}
+
+bool PardisoLinearSolver::solve_block(int nrhs, scalar *b) {
+  _F_
+#ifdef WITH_PARDISO
   bool res = true;
   int n = m->size;
 
@@ -337,11 +378,12 @@ bool PardisoLinearSolver::solve() {
 
 #if defined (H2D_COMPLEX) || defined (H3D_COMPLEX)
     int mtype = 13;		// Complex unsymmetric matrix
+    if (m->sym_storage) mtype = 6;     // Complex symmetric matrix (upper triangle)
 #else    
     int mtype = 11;   // Real unsymmetric matrix
+    if (m->sym_storage) mtype = spd ? 2 : -2;  // Real symmetric positive definite / indefinite matrix (upper triangle)
 #endif
 
-    int nrhs = 1;		// Number of right hand sides
     int nnz = m->Ap[n];	// The number of nonzero elements
 
     // Internal solver memory pointer pt,
@@ -395,13 +437,15 @@ bool PardisoLinearSolver::solve() {
 
     // .. Back substitution and iterative refinement.
     delete [] sln;
-    sln = new scalar[m->size];
+    sln = new scalar[m->size * nrhs];
     MEM_CHECK(sln);
-    memset(sln, 0, (m->size) * sizeof(scalar));
+    memset(sln, 0, (m->size * nrhs) * sizeof(scalar));
+    num_sln = nrhs;
+    sln_size = m->size;
 
     phase = 33;
     iparm[7] = 1; // Max numbers of iterative refinement steps.
-    PARDISO(pt, &maxfct, &mnum, &mtype, &phase, &n, m->Ax, m->Ap, m->Ai, &idum, &nrhs, iparm, &msglvl, rhs->v, sln, &err, dparm);
+    PARDISO(pt, &maxfct, &mnum, &mtype, &phase, &n, m->Ax, m->Ap, m->Ai, &idum, &nrhs, iparm, &msglvl, b, sln, &err, dparm);
     if (err != 0) {
       // ERROR during solution: err
       throw ERR_FAILURE;
@@ -29,19 +29,23 @@ public:
   PardisoMatrix();
   virtual ~PardisoMatrix();
 
-  virtual void pre_add_ij(int row, int col);
   virtual void alloc();
   virtual void free();
   virtual scalar get(int m, int n);
   virtual void zero();
   virtual void add(int m, int n, scalar v);
   virtual void add(int m, int n, scalar **mat, int *rows, int *cols);
+  virtual bool get_block_map(int m, int n, int *rows, int *cols, int *map);
+  virtual void add_block_with_map(int m, int n, scalar **mat, int *map);
   virtual bool dump(FILE *file, const char *var_name, EMatrixDumpFormat fmt = DF_MATLAB_SPARSE);
   virtual int get_matrix_size() const;
   virtual double get_fill_in() const;
+  /// The symmetric storage is factorized by the symmetric (LDL^T or Cholesky) solver of PARDISO.
+  virtual bool set_symmetric_storage(bool sym) { sym_storage = sym; return true; }
 
 protected:
   // PARDISO specific data structures for storing the system matrix (CSR format).
+  // Only the upper triangle is stored in the case of the symmetric storage.
   scalar *Ax;   // Matrix entries (row-wise). 
   int *Ai;      // Column indices of values in Ax.
   int *Ap;      // Index to Ax/Ai, where each row starts.
@@ -81,10 +85,19 @@ public:
   virtual ~PardisoLinearSolver();
 
   virtual bool solve();
+  virtual bool solve_multiple(int nrhs, Vector **rhs);
+
+  /// The matrix (with the symmetric storage) is known to be positive definite, so that
+  /// the Cholesky factorization is used (real matrices only).
+  void set_positive_definite(bool spd = true) { this->spd = spd; }
 
 protected:
   PardisoMatrix *m;
   PardisoVector *rhs;
+  bool spd;
+
+  /// Factorize the matrix and solve for the block of nrhs right-hand sides (column-major)
+  bool solve_block(int nrhs, scalar *b);
 };
 
 #endif /* _PARDISO_SOLVER_H_*/
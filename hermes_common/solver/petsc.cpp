@@ -41,24 +41,18 @@ PetscMatrix::~PetscMatrix() {
 void PetscMatrix::alloc() {
   _F_
 #ifdef WITH_PETSC
-  assert(pages != NULL);
+  assert(pattern.is_initialized());
+
+  // number of nonzeros in every row
+  int *ap, *ai;
+  pattern.build(false, ap, ai);
+  pattern.free();
 
-  // calc nnz
   int *nnz = new int[size];
   MEM_CHECK(nnz);
-
-  // fill in nnz
-  int aisize = get_num_indices();
-  int *ai = new int[aisize];
-  MEM_CHECK(ai);
-
-  // sort the indices and remove duplicities, insert into ai
-  int pos = 0;
-  for (int i = 0; i < size; i++) {
-    nnz[i] = sort_and_store_indices(pages[i], ai + pos, ai + aisize);
-    pos += nnz[i];
-  }
-  delete [] pages; pages = NULL;
+  for (int i = 0; i < size; i++)
+    nnz[i] = ap[i + 1] - ap[i];
+  delete [] ap;
   delete [] ai;
 
   //
@@ -0,0 +1,801 @@
+// This file is part of Hermes3D
+//
+// Copyright (c) 2009 hp-FEM group at the University of Nevada, Reno (UNR).
+// Email: hpfem-group@unr.edu, home page: http://hpfem.org/.
+//
+// Hermes3D is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published
+// by the Free Software Foundation; either version 2 of the License,
+// or (at your option) any later version.
+//
+// Hermes3D is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Hermes3D; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include "precond_native.h"
+#include "umfpack_solver.h"
+#include "bsr.h"
+#include "solver.h"
+#include "../error.h"
+#include "../callstack.h"
+
+#include <algorithm>
+
+// NativePrecond ///////////////////////////////////////////////////////////////////////////////////
+
+NativePrecond::NativePrecond()
+{
+  _F_
+  size = 0;
+  Rp = Rj = diag = NULL;
+  Rx = NULL;
+  n_lower = n_upper = 0;
+  lower_ptr = lower_rows = upper_ptr = upper_rows = NULL;
+#ifdef HAVE_EPETRA
+  std_map = NULL;
+#endif
+}
+
+NativePrecond::~NativePrecond()
+{
+  _F_
+  NativePrecond::destroy();
+}
+
+void NativePrecond::destroy()
+{
+  _F_
+  delete [] Rp; Rp = NULL;
+  delete [] Rj; Rj = NULL;
+  delete [] Rx; Rx = NULL;
+  delete [] diag; diag = NULL;
+  delete [] lower_ptr; lower_ptr = NULL;
+  delete [] lower_rows; lower_rows = NULL;
+  delete [] upper_ptr; upper_ptr = NULL;
+  delete [] upper_rows; upper_rows = NULL;
+  n_lower = n_upper = 0;
+#ifdef HAVE_EPETRA
+  delete std_map; std_map = NULL;
+#endif
+  size = 0;
+}
+
+void NativePrecond::create(Matrix *mat)
+{
+  _F_
+  int n, *rp, *rj;
+  scalar *rx;
+
+  UMFPackMatrix *csc = dynamic_cast<UMFPackMatrix *>(mat);
+  BSRMatrix *bsr = dynamic_cast<BSRMatrix *>(mat);
+  if (bsr != NULL) {
+    // expand the blocks
+    n = bsr->get_size();
+    bsr->get_csr(rp, rj, rx);
+  }
+  else if (csc != NULL && csc->is_symmetric_storage()) {
+    // the whole symmetric matrix in CSC is its CSR as well
+    n = csc->size;
+    csc->get_full_csc(rp, rj, rx);
+  }
+  else if (csc != NULL) {
+    // transpose the CSC storage, walking the columns in ascending order
+    // leaves the column indices of every row sorted
+    n = csc->size;
+    int nnz = csc->nnz;
+    rp = new int[n + 1]; MEM_CHECK(rp);
+    rj = new int[nnz]; MEM_CHECK(rj);
+    rx = new scalar[nnz]; MEM_CHECK(rx);
+
+    memset(rp, 0, (n + 1) * sizeof(int));
+    for (int k = 0; k < nnz; k++) rp[csc->Ai[k] + 1]++;
+    for (int i = 0; i < n; i++) rp[i + 1] += rp[i];
+    int *pos = new int[n]; MEM_CHECK(pos);
+    memcpy(pos, rp, n * sizeof(int));
+    for (int col = 0; col < n; col++)
+      for (int k = csc->Ap[col]; k < csc->Ap[col + 1]; k++) {
+        int p = pos[csc->Ai[k]]++;
+        rj[p] = col;
+        rx[p] = csc->Ax[k];
+      }
+    delete [] pos;
+  }
+  else {
+#if !defined(H2D_COMPLEX) && !defined(H3D_COMPLEX)
+    // generic matrix providing its rows
+    SparseMatrix *sm = dynamic_cast<SparseMatrix *>(mat);
+    if (sm == NULL || sm->get_num_row_entries(0) < 0)
+      error("Native preconditioners need a matrix in CSC storage or providing its rows.");
+    n = sm->get_size();
+    rp = new int[n + 1]; MEM_CHECK(rp);
+    rp[0] = 0;
+    for (int i = 0; i < n; i++) rp[i + 1] = rp[i] + sm->get_num_row_entries(i);
+    rj = new int[rp[n]]; MEM_CHECK(rj);
+    rx = new scalar[rp[n]]; MEM_CHECK(rx);
+    std::vector<std::pair<int, double> > row;
+    for (int i = 0; i < n; i++) {
+      int len = rp[i + 1] - rp[i], cnt;
+      sm->extract_row_copy(i, len, cnt, rx + rp[i], rj + rp[i]);
+      row.resize(len);
+      for (int k = 0; k < len; k++) row[k] = std::make_pair(rj[rp[i] + k], rx[rp[i] + k]);
+      std::sort(row.begin(), row.end());
+      for (int k = 0; k < len; k++) { rj[rp[i] + k] = row[k].first; rx[rp[i] + k] = row[k].second; }
+    }
+#else
+    error("Native preconditioners need a matrix in CSC storage.");
+#endif
+  }
+
+  create_from_rows(n, rp, rj, rx);
+}
+
+void NativePrecond::create_from_rows(int n, int *rp, int *rj, scalar *rx)
+{
+  _F_
+  NativePrecond::destroy();
+  size = n;
+  Rp = rp;
+  Rj = rj;
+  Rx = rx;
+
+  // positions of the diagonal entries
+  diag = new int[size]; MEM_CHECK(diag);
+  for (int i = 0; i < size; i++) {
+    diag[i] = -1;
+    for (int k = Rp[i]; k < Rp[i + 1]; k++)
+      if (Rj[k] == i) { diag[i] = k; break; }
+    if (diag[i] < 0) error("Missing diagonal entry in row %d.", i);
+  }
+
+#ifdef HAVE_EPETRA
+  std_map = new Epetra_Map(size, 0, seq_comm); MEM_CHECK(std_map);
+#endif
+}
+
+void NativePrecond::residual(scalar *b, scalar *x, scalar *r)
+{
+#pragma omp parallel for schedule(static)
+  for (int i = 0; i < size; i++) {
+    scalar s = b[i];
+    for (int k = Rp[i]; k < Rp[i + 1]; k++) s -= Rx[k] * x[Rj[k]];
+    r[i] = s;
+  }
+}
+
+void NativePrecond::build_levels()
+{
+  _F_
+  delete [] lower_ptr;
+  delete [] lower_rows;
+  delete [] upper_ptr;
+  delete [] upper_rows;
+
+  int *level = new int[size]; MEM_CHECK(level);
+  for (int pass = 0; pass < 2; pass++) {
+    bool lower = (pass == 0);
+
+    // the level of a row is one more than the highest level of the rows it depends on
+    int nlev = 0;
+    for (int ii = 0; ii < size; ii++) {
+      int i = lower ? ii : size - 1 - ii;
+      int lev = 0;
+      int from = lower ? Rp[i] : diag[i] + 1, to = lower ? diag[i] : Rp[i + 1];
+      for (int k = from; k < to; k++)
+        if (level[Rj[k]] + 1 > lev) lev = level[Rj[k]] + 1;
+      level[i] = lev;
+      if (lev + 1 > nlev) nlev = lev + 1;
+    }
+
+    // sort the rows by levels
+    int *ptr = new int[nlev + 1]; MEM_CHECK(ptr);
+    int *rows = new int[size]; MEM_CHECK(rows);
+    memset(ptr, 0, (nlev + 1) * sizeof(int));
+    for (int i = 0; i < size; i++) ptr[level[i] + 1]++;
+    for (int l = 0; l < nlev; l++) ptr[l + 1] += ptr[l];
+    int *pos = new int[nlev]; MEM_CHECK(pos);
+    memcpy(pos, ptr, nlev * sizeof(int));
+    for (int i = 0; i < size; i++) rows[pos[level[i]]++] = i;
+    delete [] pos;
+
+    if (lower) { n_lower = nlev; lower_ptr = ptr; lower_rows = rows; }
+    else { n_upper = nlev; upper_ptr = ptr; upper_rows = rows; }
+  }
+  delete [] level;
+}
+
+void NativePrecond::lower_solve(scalar *vals, double w, scalar *dinv, scalar *b, scalar *y)
+{
+#pragma omp parallel
+  for (int l = 0; l < n_lower; l++) {
+#pragma omp for schedule(static)
+    for (int k = lower_ptr[l]; k < lower_ptr[l + 1]; k++) {
+      int i = lower_rows[k];
+      scalar s = 0.0;
+      for (int p = Rp[i]; p < diag[i]; p++) s += vals[p] * y[Rj[p]];
+      s = b[i] - w * s;
+      y[i] = (dinv != NULL) ? s * dinv[i] : s;
+    }
+  }
+}
+
+void NativePrecond::upper_solve(scalar *vals, double w, scalar *dinv, scalar *b, scalar *y)
+{
+#pragma omp parallel
+  for (int l = 0; l < n_upper; l++) {
+#pragma omp for schedule(static)
+    for (int k = upper_ptr[l]; k < upper_ptr[l + 1]; k++) {
+      int i = upper_rows[k];
+      scalar s = 0.0;
+      for (int p = diag[i] + 1; p < Rp[i + 1]; p++) s += vals[p] * y[Rj[p]];
+      s = b[i] - w * s;
+      y[i] = (dinv != NULL) ? s * dinv[i] : s;
+    }
+  }
+}
+
+#ifdef HAVE_EPETRA
+int NativePrecond::ApplyInverse(const Epetra_MultiVector &r, Epetra_MultiVector &z) const
+{
+  _F_
+#if !defined(H2D_COMPLEX) && !defined(H3D_COMPLEX)
+  NativePrecond *pc = const_cast<NativePrecond *>(this);
+  // the vectors may be the same
+  scalar *tmp = new scalar[size]; MEM_CHECK(tmp);
+  for (int j = 0; j < r.NumVectors(); j++) {
+    memcpy(tmp, r[j], size * sizeof(scalar));
+    pc->apply(tmp, z[j]);
+  }
+  delete [] tmp;
+  return 0;
+#else
+  return -1;
+#endif
+}
+#endif
+
+// JacobiPrecond ///////////////////////////////////////////////////////////////////////////////////
+
+JacobiPrecond::JacobiPrecond() : NativePrecond()
+{
+  _F_
+  dinv = NULL;
+}
+
+JacobiPrecond::~JacobiPrecond()
+{
+  _F_
+  destroy();
+}
+
+void JacobiPrecond::destroy()
+{
+  _F_
+  delete [] dinv; dinv = NULL;
+  NativePrecond::destroy();
+}
+
+void JacobiPrecond::compute()
+{
+  _F_
+  assert(Rp != NULL);
+  delete [] dinv;
+  dinv = new scalar[size]; MEM_CHECK(dinv);
+  for (int i = 0; i < size; i++)
+    dinv[i] = (Rx[diag[i]] != 0.0) ? 1.0 / Rx[diag[i]] : 1.0;
+}
+
+void JacobiPrecond::apply(scalar *r, scalar *z)
+{
+#pragma omp parallel for schedule(static)
+  for (int i = 0; i < size; i++) z[i] = dinv[i] * r[i];
+}
+
+// BlockJacobiPrecond //////////////////////////////////////////////////////////////////////////////
+
+BlockJacobiPrecond::BlockJacobiPrecond() : NativePrecond()
+{
+  _F_
+  n_blocks = 0;
+  blk_ptr = blk_dofs = lu_ptr = piv = NULL;
+  lu = NULL;
+  grp_ptr.push_back(0);
+}
+
+BlockJacobiPrecond::~BlockJacobiPrecond()
+{
+  _F_
+  destroy();
+}
+
+void BlockJacobiPrecond::add_block(int n, int *dofs)
+{
+  _F_
+  for (int i = 0; i < n; i++)
+    if (dofs[i] >= 0) grp_dofs.push_back(dofs[i]);
+  if ((int) grp_dofs.size() > grp_ptr.back()) grp_ptr.push_back(grp_dofs.size());
+}
+
+void BlockJacobiPrecond::clear_blocks()
+{
+  _F_
+  grp_ptr.clear();
+  grp_dofs.clear();
+  grp_ptr.push_back(0);
+}
+
+void BlockJacobiPrecond::destroy()
+{
+  _F_
+  delete [] blk_ptr; blk_ptr = NULL;
+  delete [] blk_dofs; blk_dofs = NULL;
+  delete [] lu_ptr; lu_ptr = NULL;
+  delete [] lu; lu = NULL;
+  delete [] piv; piv = NULL;
+  n_blocks = 0;
+  NativePrecond::destroy();
+}
+
+void BlockJacobiPrecond::compute()
+{
+  _F_
+  assert(Rp != NULL);
+  delete [] blk_ptr;
+  delete [] blk_dofs;
+  delete [] lu_ptr;
+  delete [] lu;
+  delete [] piv;
+
+  // assign every DOF to the first group it appears in
+  int *owner = new int[size]; MEM_CHECK(owner);
+  for (int i = 0; i < size; i++) owner[i] = -1;
+  int ngrp = grp_ptr.size() - 1;
+  n_blocks = 0;
+  std::vector<int> bp(1, 0), bd;
+  for (int g = 0; g < ngrp; g++) {
+    for (int k = grp_ptr[g]; k < grp_ptr[g + 1]; k++) {
+      int dof = grp_dofs[k];
+      if (dof < size && owner[dof] < 0) { owner[dof] = n_blocks; bd.push_back(dof); }
+    }
+    if ((int) bd.size() > bp.back()) { bp.push_back(bd.size()); n_blocks++; }
+  }
+  for (int i = 0; i < size; i++)
+    if (owner[i] < 0) { owner[i] = n_blocks++; bd.push_back(i); bp.push_back(bd.size()); }
+
+  blk_ptr = new int[n_blocks + 1]; MEM_CHECK(blk_ptr);
+  blk_dofs = new int[size]; MEM_CHECK(blk_dofs);
+  lu_ptr = new int[n_blocks + 1]; MEM_CHECK(lu_ptr);
+  memcpy(blk_ptr, &bp[0], (n_blocks + 1) * sizeof(int));
+  memcpy(blk_dofs, &bd[0], size * sizeof(int));
+  lu_ptr[0] = 0;
+  for (int b = 0; b < n_blocks; b++) lu_ptr[b + 1] = lu_ptr[b] + sqr(blk_ptr[b + 1] - blk_ptr[b]);
+  lu = new scalar[lu_ptr[n_blocks]]; MEM_CHECK(lu);
+  piv = new int[size]; MEM_CHECK(piv);
+
+  // local index of every DOF within its block
+  int *loc = new int[size]; MEM_CHECK(loc);
+  for (int b = 0; b < n_blocks; b++)
+    for (int k = blk_ptr[b]; k < blk_ptr[b + 1]; k++) loc[blk_dofs[k]] = k - blk_ptr[b];
+
+  // extract and factorize the diagonal blocks (LU with partial pivoting)
+#pragma omp parallel for schedule(dynamic, 16)
+  for (int b = 0; b < n_blocks; b++) {
+    int n = blk_ptr[b + 1] - blk_ptr[b];
+    scalar *a = lu + lu_ptr[b];
+    int *pv = piv + blk_ptr[b];
+    memset(a, 0, n * n * sizeof(scalar));
+    for (int i = 0; i < n; i++) {
+      int row = blk_dofs[blk_ptr[b] + i];
+      for (int k = Rp[row]; k < Rp[row + 1]; k++)
+        if (owner[Rj[k]] == b) a[i * n + loc[Rj[k]]] = Rx[k];
+    }
+
+    for (int j = 0; j < n; j++) {
+      int p = j;
+      for (int i = j + 1; i < n; i++)
+        if (magn(a[i * n + j]) > magn(a[p * n + j])) p = i;
+      pv[j] = p;
+      if (p != j)
+        for (int k = 0; k < n; k++) std::swap(a[j * n + k], a[p * n + k]);
+      if (a[j * n + j] == 0.0) a[j * n + j] = 1.0;     // singular block, keep going
+      for (int i = j + 1; i < n; i++) {
+        scalar f = a[i * n + j] /= a[j * n + j];
+        for (int k = j + 1; k < n; k++) a[i * n + k] -= f * a[j * n + k];
+      }
+    }
+  }
+
+  delete [] loc;
+  delete [] owner;
+}
+
+void BlockJacobiPrecond::apply(scalar *r, scalar *z)
+{
+#pragma omp parallel
+  {
+    std::vector<scalar> x;
+#pragma omp for schedule(dynamic, 16)
+    for (int b = 0; b < n_blocks; b++) {
+      int n = blk_ptr[b + 1] - blk_ptr[b];
+      int *dofs = blk_dofs + blk_ptr[b];
+      int *pv = piv + blk_ptr[b];
+      scalar *a = lu + lu_ptr[b];
+
+      x.resize(n);
+      for (int i = 0; i < n; i++) x[i] = r[dofs[i]];
+      for (int i = 0; i < n; i++)
+        if (pv[i] != i) std::swap(x[i], x[pv[i]]);
+      for (int i = 1; i < n; i++)
+        for (int k = 0; k < i; k++) x[i] -= a[i * n + k] * x[k];
+      for (int i = n - 1; i >= 0; i--) {
+        for (int k = i + 1; k < n; k++) x[i] -= a[i * n + k] * x[k];
+        x[i] /= a[i * n + i];
+      }
+      for (int i = 0; i < n; i++) z[dofs[i]] = x[i];
+    }
+  }
+}
+
+// ILUPrecond //////////////////////////////////////////////////////////////////////////////////////
+
+ILUPrecond::ILUPrecond() : NativePrecond()
+{
+  _F_
+  lu = udinv = tmp = NULL;
+}
+
+ILUPrecond::~ILUPrecond()
+{
+  _F_
+  destroy();
+}
+
+void ILUPrecond::destroy()
+{
+  _F_
+  delete [] lu; lu = NULL;
+  delete [] udinv; udinv = NULL;
+  delete [] tmp; tmp = NULL;
+  NativePrecond::destroy();
+}
+
+void ILUPrecond::compute()
+{
+  _F_
+  assert(Rp != NULL);
+  delete [] lu;
+  delete [] udinv;
+  delete [] tmp;
+
+  int nnz = Rp[size];
+  lu = new scalar[nnz]; MEM_CHECK(lu);
+  memcpy(lu, Rx, nnz * sizeof(scalar));
+  udinv = new scalar[size]; MEM_CHECK(udinv);
+  tmp = new scalar[size]; MEM_CHECK(tmp);
+
+  // IKJ variant restricted to the pattern of the matrix
+  int *iw = new int[size]; MEM_CHECK(iw);
+  for (int i = 0; i < size; i++) iw[i] = -1;
+  for (int i = 0; i < size; i++) {
+    for (int k = Rp[i]; k < Rp[i + 1]; k++) iw[Rj[k]] = k;
+    for (int k = Rp[i]; k < diag[i]; k++) {
+      int j = Rj[k];
+      lu[k] *= udinv[j];
+      for (int p = diag[j] + 1; p < Rp[j + 1]; p++)
+        if (iw[Rj[p]] >= 0) lu[iw[Rj[p]]] -= lu[k] * lu[p];
+    }
+    if (lu[diag[i]] == 0.0) {
+      warning("ILU(0): zero pivot in row %d.", i);
+      lu[diag[i]] = 1.0;
+    }
+    udinv[i] = 1.0 / lu[diag[i]];
+    for (int k = Rp[i]; k < Rp[i + 1]; k++) iw[Rj[k]] = -1;
+  }
+  delete [] iw;
+
+  build_levels();
+}
+
+void ILUPrecond::apply(scalar *r, scalar *z)
+{
+  lower_solve(lu, 1.0, NULL, r, tmp);
+  upper_solve(lu, 1.0, udinv, tmp, z);
+}
+
+// SSORPrecond /////////////////////////////////////////////////////////////////////////////////////
+
+SSORPrecond::SSORPrecond(double omega) : NativePrecond(), omega(omega)
+{
+  _F_
+  if (omega <= 0.0 || omega >= 2.0) error("SSOR: the relaxation parameter must be in (0, 2).");
+  dinv = tmp = NULL;
+}
+
+SSORPrecond::~SSORPrecond()
+{
+  _F_
+  destroy();
+}
+
+void SSORPrecond::destroy()
+{
+  _F_
+  delete [] dinv; dinv = NULL;
+  delete [] tmp; tmp = NULL;
+  NativePrecond::destroy();
+}
+
+void SSORPrecond::compute()
+{
+  _F_
+  assert(Rp != NULL);
+  delete [] dinv;
+  delete [] tmp;
+  dinv = new scalar[size]; MEM_CHECK(dinv);
+  tmp = new scalar[size]; MEM_CHECK(tmp);
+  for (int i = 0; i < size; i++)
+    dinv[i] = (Rx[diag[i]] != 0.0) ? 1.0 / Rx[diag[i]] : 1.0;
+
+  build_levels();
+}
+
+void SSORPrecond::apply(scalar *r, scalar *z)
+{
+  // M = (D + wL) D^{-1} (D + wU) / (w (2 - w))
+  lower_solve(Rx, omega, dinv, r, tmp);
+  double c = omega * (2.0 - omega);
+#pragma omp parallel for schedule(static)
+  for (int i = 0; i < size; i++) tmp[i] *= c / dinv[i];
+  upper_solve(Rx, omega, dinv, tmp, z);
+}
+
+// PMultigridPrecond ///////////////////////////////////////////////////////////////////////////////
+
+PMultigridPrecond::PMultigridPrecond(MatrixSolverType coarse_solver)
+  : NativePrecond(), coarse_solver(coarse_solver)
+{
+  _F_
+  pre_smooth = post_smooth = 1;
+  omega = 1.0;
+  n_levels = 0;
+  lsize = NULL;
+  sub = NULL;
+  smoother = NULL;
+  x = b = r = z = NULL;
+  coarse_mat = NULL;
+  coarse_rhs = NULL;
+  coarse = NULL;
+  coarse_factorized = false;
+}
+
+PMultigridPrecond::~PMultigridPrecond()
+{
+  _F_
+  destroy();
+}
+
+void PMultigridPrecond::add_level(int n, int *dofs)
+{
+  _F_
+  // sorted DOFs keep the columns of the submatrices sorted
+  level_dofs.push_back(std::vector<int>(dofs, dofs + n));
+  std::sort(level_dofs.back().begin(), level_dofs.back().end());
+}
+
+void PMultigridPrecond::clear_levels()
+{
+  _F_
+  level_dofs.clear();
+}
+
+void PMultigridPrecond::set_smoothing(int pre, int post, double omega)
+{
+  _F_
+  pre_smooth = pre;
+  post_smooth = post;
+  this->omega = omega;
+}
+
+void PMultigridPrecond::destroy()
+{
+  _F_
+  for (int l = 0; l < n_levels; l++) {
+    if (sub != NULL) delete [] sub[l];
+    if (smoother != NULL) delete smoother[l];
+    delete [] x[l];
+    delete [] b[l];
+    delete [] r[l];
+    delete [] z[l];
+  }
+  delete [] sub; sub = NULL;
+  delete [] smoother; smoother = NULL;
+  delete [] x; x = NULL;
+  delete [] b; b = NULL;
+  delete [] r; r = NULL;
+  delete [] z; z = NULL;
+  delete [] lsize; lsize = NULL;
+  n_levels = 0;
+
+  delete coarse; coarse = NULL;
+  delete coarse_mat; coarse_mat = NULL;
+  delete coarse_rhs; coarse_rhs = NULL;
+  coarse_factorized = false;
+
+  NativePrecond::destroy();
+}
+
+void PMultigridPrecond::compute()
+{
+  _F_
+  assert(Rp != NULL);
+
+  // keep the fine matrix, release the previous hierarchy
+  int *rp = Rp, *rj = Rj;
+  scalar *rx = Rx;
+  Rp = Rj = NULL;
+  Rx = NULL;
+  int n = size;
+  destroy();
+  create_from_rows(n, rp, rj, rx);
+
+  n_levels = level_dofs.size() + 1;
+  lsize = new int[n_levels]; MEM_CHECK(lsize);
+  sub = new int *[n_levels]; MEM_CHECK(sub);
+  smoother = new SSORPrecond *[n_levels]; MEM_CHECK(smoother);
+  x = new scalar *[n_levels]; MEM_CHECK(x);
+  b = new scalar *[n_levels]; MEM_CHECK(b);
+  r = new scalar *[n_levels]; MEM_CHECK(r);
+  z = new scalar *[n_levels]; MEM_CHECK(z);
+
+  // matrix of the current level
+  int cn = size;
+  int *cp = Rp, *cj = Rj;
+  scalar *cx = Rx;
+
+  int *fine_pos = new int[size]; MEM_CHECK(fine_pos);     // position of a fine DOF on the previous level
+  int *loc = new int[size]; MEM_CHECK(loc);               // position on the current level
+  for (int i = 0; i < size; i++) fine_pos[i] = i;
+
+  for (int l = 0; l < n_levels; l++) {
+    sub[l] = NULL;
+    smoother[l] = NULL;
+    if (l > 0) {
+      // the level keeps a subset of the unknowns of the previous one
+      std::vector<int> &dofs = level_dofs[l - 1];
+      int ln = dofs.size();
+      sub[l] = new int[ln]; MEM_CHECK(sub[l]);
+      for (int i = 0; i < cn; i++) loc[i] = -1;
+      for (int i = 0; i < ln; i++) {
+        int p = (dofs[i] >= 0 && dofs[i] < size) ? fine_pos[dofs[i]] : -1;
+        if (p < 0) error("p-multigrid: level %d is not a subset of level %d.", l, l - 1);
+        sub[l][i] = p;
+        loc[p] = i;
+      }
+
+      // submatrix of the previous level (A(S, S), the restriction being the injection)
+      int *np = new int[ln + 1]; MEM_CHECK(np);
+      np[0] = 0;
+      for (int i = 0; i < ln; i++) {
+        int row = sub[l][i], cnt = 0;
+        for (int k = cp[row]; k < cp[row + 1]; k++)
+          if (loc[cj[k]] >= 0) cnt++;
+        np[i + 1] = np[i] + cnt;
+      }
+      int *nj = new int[np[ln]]; MEM_CHECK(nj);
+      scalar *nx = new scalar[np[ln]]; MEM_CHECK(nx);
+      for (int i = 0; i < ln; i++) {
+        int row = sub[l][i], pos = np[i];
+        for (int k = cp[row]; k < cp[row + 1]; k++)
+          if (loc[cj[k]] >= 0) { nj[pos] = loc[cj[k]]; nx[pos] = cx[k]; pos++; }
+      }
+
+      // new positions of the fine DOFs
+      for (int i = 0; i < size; i++) fine_pos[i] = -1;
+      for (int i = 0; i < ln; i++) fine_pos[dofs[i]] = i;
+
+      cn = ln;
+      cp = np; cj = nj; cx = nx;
+    }
+    lsize[l] = cn;
+
+    x[l] = new scalar[cn]; MEM_CHECK(x[l]);
+    b[l] = new scalar[cn]; MEM_CHECK(b[l]);
+    r[l] = new scalar[cn]; MEM_CHECK(r[l]);
+    z[l] = new scalar[cn]; MEM_CHECK(z[l]);
+
+    if (l < n_levels - 1) {
+      // smoother, it takes over the arrays of the coarse levels
+      smoother[l] = new SSORPrecond(omega);
+      if (l == 0) {
+        int *sp = new int[cn + 1]; MEM_CHECK(sp);
+        int *sj = new int[cp[cn]]; MEM_CHECK(sj);
+        scalar *sx = new scalar[cp[cn]]; MEM_CHECK(sx);
+        memcpy(sp, cp, (cn + 1) * sizeof(int));
+        memcpy(sj, cj, cp[cn] * sizeof(int));
+        memcpy(sx, cx, cp[cn] * sizeof(scalar));
+        smoother[l]->create_from_rows(cn, sp, sj, sx);
+      }
+      else
+        smoother[l]->create_from_rows(cn, cp, cj, cx);
+      smoother[l]->compute();
+    }
+    else {
+      // the coarsest level is solved directly
+      coarse_mat = create_matrix(coarse_solver);
+      coarse_rhs = create_vector(coarse_solver);
+      coarse_mat->prealloc(cn);
+      for (int i = 0; i < cn; i++)
+        coarse_mat->pre_add_block(1, cp[i + 1] - cp[i], &i, cj + cp[i]);
+      coarse_mat->alloc();
+      for (int i = 0; i < cn; i++)
+        for (int k = cp[i]; k < cp[i + 1]; k++)
+          coarse_mat->add(i, cj[k], cx[k]);
+      coarse_mat->finish();
+      coarse_rhs->alloc(cn);
+      coarse = create_linear_solver(coarse_solver, coarse_mat, coarse_rhs);
+      coarse_factorized = false;
+      if (l > 0) {
+        delete [] cp;
+        delete [] cj;
+        delete [] cx;
+      }
+    }
+  }
+
+  delete [] loc;
+  delete [] fine_pos;
+}
+
+void PMultigridPrecond::vcycle(int l)
+{
+  _F_
+  int n = lsize[l];
+  if (l == n_levels - 1) {
+    coarse_rhs->zero();
+    for (int i = 0; i < n; i++) coarse_rhs->set(i, b[l][i]);
+    if (!coarse->solve()) error("p-multigrid: the coarse level solve failed.");
+    memcpy(x[l], coarse->get_solution(), n * sizeof(scalar));
+    if (!coarse_factorized) {
+      coarse->set_factorization_scheme(HERMES_REUSE_FACTORIZATION_COMPLETELY);
+      coarse_factorized = true;
+    }
+    return;
+  }
+
+  SSORPrecond *s = smoother[l];
+
+  // pre-smoothing (x = 0 initially)
+  memset(x[l], 0, n * sizeof(scalar));
+  for (int it = 0; it < pre_smooth; it++) {
+    s->residual(b[l], x[l], r[l]);
+    s->apply(r[l], z[l]);
+    for (int i = 0; i < n; i++) x[l][i] += z[l][i];
+  }
+
+  // coarse level correction (restriction and prolongation are injections)
+  s->residual(b[l], x[l], r[l]);
+  int nc = lsize[l + 1];
+  int *sc = sub[l + 1];
+  for (int i = 0; i < nc; i++) b[l + 1][i] = r[l][sc[i]];
+  vcycle(l + 1);
+  for (int i = 0; i < nc; i++) x[l][sc[i]] += x[l + 1][i];
+
+  // post-smoothing
+  for (int it = 0; it < post_smooth; it++) {
+    s->residual(b[l], x[l], r[l]);
+    s->apply(r[l], z[l]);
+    for (int i = 0; i < n; i++) x[l][i] += z[l][i];
+  }
+}
+
+void PMultigridPrecond::apply(scalar *rr, scalar *zz)
+{
+  _F_
+  memcpy(b[0], rr, size * sizeof(scalar));
+  vcycle(0);
+  memcpy(zz, x[0], size * sizeof(scalar));
+}
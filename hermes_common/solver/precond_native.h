@@ -0,0 +1,239 @@
+// This file is part of Hermes3D
+//
+// Copyright (c) 2009 hp-FEM group at the University of Nevada, Reno (UNR).
+// Email: hpfem-group@unr.edu, home page: http://hpfem.org/.
+//
+// Hermes3D is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published
+// by the Free Software Foundation; either version 2 of the License,
+// or (at your option) any later version.
+//
+// Hermes3D is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Hermes3D; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#ifndef _PRECOND_NATIVE_H_
+#define _PRECOND_NATIVE_H_
+
+#include "precond.h"
+#include "epetra.h"
+
+class Solver;
+
+/// Base class of preconditioners working on a plain row-wise (CSR) copy of the matrix.
+///
+/// create() takes the copy of the matrix (UMFPackMatrix, or any matrix providing
+/// extract_row_copy() in the real case), compute() builds the preconditioner and
+/// apply() performs z = M^{-1} r. If Hermes is built with Trilinos, the preconditioners
+/// are Epetra operators as well, so they can be passed to AztecOO.
+///
+/// The triangular solves (ILU, SSOR) are level-scheduled: rows whose unknowns do not
+/// depend on each other form a level and the rows of a level are split among threads
+/// if Hermes is built with OpenMP.
+///
+/// @ingroup preconds
+class HERMES_API NativePrecond : public Precond {
+public:
+  NativePrecond();
+  virtual ~NativePrecond();
+
+  virtual void create(Matrix *mat);
+  virtual void destroy();
+  virtual void compute() = 0;
+
+  /// Apply the preconditioner
+  /// @param[in] r - the vector to precondition
+  /// @param[out] z - M^{-1} r
+  virtual void apply(scalar *r, scalar *z) = 0;
+
+  /// Take the matrix given by its rows, the arrays (allocated by new[], columns sorted
+  /// within rows) are taken over by the preconditioner.
+  void create_from_rows(int n, int *rp, int *rj, scalar *rx);
+
+  int get_size() const { return size; }
+
+  /// r = b - A x (A is the matrix taken by create())
+  void residual(scalar *b, scalar *x, scalar *r);
+
+#ifdef HAVE_EPETRA
+  virtual Epetra_Operator *get_obj() { return this; }
+
+  // Epetra_Operator interface
+  virtual int ApplyInverse(const Epetra_MultiVector &r, Epetra_MultiVector &z) const;
+  virtual const Epetra_Comm &Comm() const { return seq_comm; }
+  virtual const Epetra_Map &OperatorDomainMap() const { return *std_map; }
+  virtual const Epetra_Map &OperatorRangeMap() const { return *std_map; }
+#endif
+
+protected:
+  int size;
+  int *Rp;              ///< Index to Rj/Rx, where each row starts.
+  int *Rj;              ///< Column indices (sorted within rows).
+  scalar *Rx;           ///< Matrix entries (row-wise).
+  int *diag;            ///< Position of the diagonal entry of every row.
+
+  // level schedules of the triangular solves
+  int n_lower, *lower_ptr, *lower_rows;
+  int n_upper, *upper_ptr, *upper_rows;
+
+  void build_levels();
+
+  /// y_i = (b_i - w * sum_{j < i} vals_ij y_j) * dinv_i (dinv == NULL means 1)
+  void lower_solve(scalar *vals, double w, scalar *dinv, scalar *b, scalar *y);
+  /// y_i = (b_i - w * sum_{j > i} vals_ij y_j) * dinv_i (dinv == NULL means 1)
+  void upper_solve(scalar *vals, double w, scalar *dinv, scalar *b, scalar *y);
+
+#ifdef HAVE_EPETRA
+  Epetra_SerialComm seq_comm;
+  Epetra_Map *std_map;
+#endif
+};
+
+/// Point Jacobi (diagonal) preconditioner
+///
+/// @ingroup preconds
+class HERMES_API JacobiPrecond : public NativePrecond {
+public:
+  JacobiPrecond();
+  virtual ~JacobiPrecond();
+
+  virtual void destroy();
+  virtual void compute();
+  virtual void apply(scalar *r, scalar *z);
+
+protected:
+  scalar *dinv;
+};
+
+/// Block Jacobi preconditioner with blocks given by groups of DOFs, typically
+/// the assembly lists of elements (see DiscreteProblem::get_element_blocks()).
+/// Every DOF belongs to the first group it appears in, DOFs not present in any
+/// group form 1x1 blocks.
+///
+/// @ingroup preconds
+class HERMES_API BlockJacobiPrecond : public NativePrecond {
+public:
+  BlockJacobiPrecond();
+  virtual ~BlockJacobiPrecond();
+
+  /// Add a group of DOFs (negative DOFs are ignored)
+  /// @param[in] n - number of DOFs
+  /// @param[in] dofs - the DOFs
+  void add_block(int n, int *dofs);
+  /// Remove all groups added by add_block()
+  void clear_blocks();
+
+  virtual void destroy();
+  virtual void compute();
+  virtual void apply(scalar *r, scalar *z);
+
+protected:
+  std::vector<int> grp_ptr, grp_dofs;   ///< groups of DOFs as added by add_block()
+
+  int n_blocks;
+  int *blk_ptr;         ///< Index to blk_dofs, where each block starts.
+  int *blk_dofs;        ///< DOFs of the blocks.
+  int *lu_ptr;          ///< Index to lu, where the factorization of each block starts.
+  scalar *lu;           ///< LU factors of the diagonal blocks (dense, row-wise).
+  int *piv;             ///< Pivots of the factorizations (indexed as blk_dofs).
+};
+
+/// Incomplete LU factorization with no fill-in (on the sparsity pattern of the matrix)
+///
+/// @ingroup preconds
+class HERMES_API ILUPrecond : public NativePrecond {
+public:
+  ILUPrecond();
+  virtual ~ILUPrecond();
+
+  virtual void destroy();
+  virtual void compute();
+  virtual void apply(scalar *r, scalar *z);
+
+protected:
+  scalar *lu;           ///< L (unit diagonal, not stored) and U on the pattern of the matrix.
+  scalar *udinv;        ///< Inverse of the diagonal of U.
+  scalar *tmp;
+};
+
+/// Symmetric successive over-relaxation
+///
+/// @ingroup preconds
+class HERMES_API SSORPrecond : public NativePrecond {
+public:
+  /// @param[in] omega - relaxation parameter (0 < omega < 2)
+  SSORPrecond(double omega = 1.0);
+  virtual ~SSORPrecond();
+
+  virtual void destroy();
+  virtual void compute();
+  virtual void apply(scalar *r, scalar *z);
+
+protected:
+  double omega;
+  scalar *dinv;
+  scalar *tmp;
+};
+
+/// Polynomial-order (p-)multigrid V-cycle
+///
+/// The shapesets are hierarchic, so a space of lower order spans a subset of the basis
+/// functions of the original one and the restriction is a mere truncation of DOFs. The
+/// levels are therefore given by the DOFs of the original (fine) space they keep (see
+/// DiscreteProblem::get_p_levels()) and the matrices of the coarser levels are the
+/// corresponding submatrices (Galerkin products with the injection). SSOR is used as
+/// the smoother, the coarsest level is solved by a direct solver.
+///
+/// @ingroup preconds
+class HERMES_API PMultigridPrecond : public NativePrecond {
+public:
+  /// @param[in] coarse_solver - matrix solver used on the coarsest level
+  PMultigridPrecond(MatrixSolverType coarse_solver = SOLVER_UMFPACK);
+  virtual ~PMultigridPrecond();
+
+  /// Add the next coarser level
+  /// @param[in] n - number of DOFs of the level
+  /// @param[in] dofs - DOFs of the fine level kept by this level, must be a subset
+  ///                   of the DOFs of the previous level
+  void add_level(int n, int *dofs);
+  /// Remove all levels added by add_level()
+  void clear_levels();
+  int get_num_levels() const { return level_dofs.size() + 1; }
+
+  /// Set the smoother
+  /// @param[in] pre - number of pre-smoothing steps
+  /// @param[in] post - number of post-smoothing steps
+  /// @param[in] omega - relaxation parameter of SSOR
+  void set_smoothing(int pre, int post, double omega = 1.0);
+
+  virtual void destroy();
+  virtual void compute();
+  virtual void apply(scalar *r, scalar *z);
+
+protected:
+  MatrixSolverType coarse_solver;
+  int pre_smooth, post_smooth;
+  double omega;
+
+  std::vector<std::vector<int> > level_dofs;   ///< fine DOFs of the coarser levels
+
+  int n_levels;         ///< number of levels (the fine one included)
+  int *lsize;           ///< number of unknowns on the levels
+  int **sub;            ///< positions of the unknowns of level l in level l - 1
+  SSORPrecond **smoother;
+  scalar **x, **b, **r, **z;
+
+  SparseMatrix *coarse_mat;
+  Vector *coarse_rhs;
+  Solver *coarse;
+  bool coarse_factorized;
+
+  void vcycle(int l);
+};
+
+#endif /* _PRECOND_NATIVE_H_ */
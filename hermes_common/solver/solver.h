@@ -114,14 +114,41 @@ class LinearSolver : public Solver
 {
   public:
     LinearSolver(unsigned int factorization_scheme = HERMES_FACTORIZE_FROM_SCRATCH) 
-      : Solver(), factorization_scheme(factorization_scheme) {};
+      : Solver(), factorization_scheme(factorization_scheme), num_sln(0), sln_size(0) {};
     
+    /// Solve the system with several right-hand sides, factorizing the matrix only once.
+    /// The solutions are stored one after another, see get_solution(int).
+    /// @param[in] nrhs - number of right-hand sides
+    /// @param[in] rhs - the right-hand sides (of any vector type)
+    virtual bool solve_multiple(int nrhs, Vector **rhs) {
+      warning("solve_multiple() is not supported by this solver.");
+      return false;
+    }
+
+    using Solver::get_solution;
+    /// The k-th solution of the last solve_multiple()
+    scalar *get_solution(int k) { assert(k < num_sln); return sln + k * sln_size; }
+    int get_num_solutions() { return num_sln; }
+
   protected:
     virtual void set_factorization_scheme(FactorizationScheme reuse_scheme) { 
       factorization_scheme = reuse_scheme;
     }
         
     unsigned int factorization_scheme;
+    int num_sln;        ///< number of solutions stored in sln
+    int sln_size;       ///< length of one solution
+
+    /// Copy the right-hand sides into one block (column-major, n x nrhs) allocated by new[].
+    static scalar *gather_rhs(int n, int nrhs, Vector **rhs) {
+      scalar *b = new scalar[n * nrhs];
+      MEM_CHECK(b);
+      for (int k = 0; k < nrhs; k++) {
+        assert(rhs[k]->length() == n);
+        rhs[k]->extract(b + k * n);
+      }
+      return b;
+    }
 };
 
 /// Abstract class for defining interface for nonlinear solvers.
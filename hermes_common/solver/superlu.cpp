@@ -69,28 +69,12 @@ SuperLUMatrix::~SuperLUMatrix()
 void SuperLUMatrix::alloc()
 {
   _F_
-  assert(pages != NULL);
+  assert(pattern.is_initialized());
   assert(size > 0);
-  
-  // Initialize the arrays Ap and Ai.
-  Ap = new int [size + 1];
-  MEM_CHECK(Ap);
-  int aisize = get_num_indices();
-  Ai = new int [aisize];
-  MEM_CHECK(Ai);
-  
-  // sort the indices and remove duplicities, insert into Ai
-  int i, pos = 0;
-  for (i = 0; i < size; i++) {
-    Ap[i] = pos;
-    pos += sort_and_store_indices(pages[i], Ai + pos, Ai + aisize);
-  }
-  Ap[i] = pos;
-  
-  delete [] pages;
-  pages = NULL;
-  
-  nnz = Ap[size];
+
+  // build the CSC structure: sorted row indices of every column, without duplicities
+  nnz = pattern.build(true, Ap, Ai);
+  pattern.free();
 
   Ax = new slu_scalar [nnz];
   memset(Ax, 0, sizeof(slu_scalar) * nnz);
@@ -156,6 +140,50 @@ void SuperLUMatrix::add(int m, int n, scalar **mat, int *rows, int *cols)
       add(rows[i], cols[j], mat[i][j]);
 }
 
+bool SuperLUMatrix::get_block_map(int m, int n, int *rows, int *cols, int *map)
+{
+  _F_
+  for (int j = 0; j < n; j++)       // cols
+  {
+    int col = cols[j];
+    for (int i = 0; i < m; i++)     // rows
+    {
+      if (rows[i] < 0 || col < 0)   // dirichlet DOFs are not stored
+      {
+        map[i * n + j] = -1;
+        continue;
+      }
+      // Find i-th row in the j-th column.
+      int pos = find_position(Ai + Ap[col], Ap[col + 1] - Ap[col], rows[i]);
+      if (pos < 0) 
+        error("Sparse matrix entry not found");
+      map[i * n + j] = Ap[col] + pos;
+    }
+  }
+  return true;
+}
+
+void SuperLUMatrix::add_block_with_map(int m, int n, scalar **mat, int *map)
+{
+  _F_
+  for (int i = 0; i < m; i++)       // rows
+  {
+    scalar *row = mat[i];
+    int *row_map = map + i * n;
+    for (int j = 0; j < n; j++)     // cols
+    {
+      int pos = row_map[j];
+      if (pos < 0) continue;
+#if !defined(H1D_COMPLEX) && !defined(H2D_COMPLEX) && !defined(H3D_COMPLEX)
+      Ax[pos] += row[j];
+#else
+      Ax[pos].r += row[j].real();
+      Ax[pos].i += row[j].imag();
+#endif
+    }
+  }
+}
+
 /// Save matrix and right-hand side to a file.
 ///
 bool SuperLUMatrix::dump(FILE *file, const char *var_name, EMatrixDumpFormat fmt)
@@ -407,17 +435,78 @@ bool SuperLUSolver::solve()
   assert(m != NULL);
   assert(rhs != NULL);
   
+  // If the right-hand side vector changed, recreate the input rhs for the solver driver from 
+  // a local copy of the new value array.
+  if (B_changed)
+    free_rhs();
+  
+  if (!has_B)
+  {
+    if (local_rhs) delete [] local_rhs;
+    local_rhs = new slu_scalar [rhs->size];
+    memcpy(local_rhs, rhs->v, rhs->size * sizeof(slu_scalar));
+    
+    SLU_CREATE_DENSE_MATRIX(&B, rhs->size, 1, local_rhs, rhs->size, SLU_DN, SLU_DTYPE, SLU_GE);
+    
+    has_B = true;
+  }
+  
+  return solve_block();
+#else
+  return false;
+#endif
+}
+
+bool SuperLUSolver::solve_multiple(int nrhs, Vector **rhs)
+{
+  _F_
+#ifdef WITH_SUPERLU
+  assert(m != NULL);
+  assert(nrhs > 0);
+  
+  // B will hold all the right-hand sides (one column each); it is recreated from this->rhs 
+  // by the next call to solve().
+  free_rhs();
+  
+  if (local_rhs) delete [] local_rhs;
+  local_rhs = new slu_scalar [m->size * nrhs];
+  for (int k = 0; k < nrhs; k++)
+  {
+    assert(rhs[k]->length() == m->size);
+    rhs[k]->extract((scalar *) (local_rhs + k * m->size));
+  }
+  
+  SLU_CREATE_DENSE_MATRIX(&B, m->size, nrhs, local_rhs, m->size, SLU_DN, SLU_DTYPE, SLU_GE);
+  has_B = true;
+  
+  bool ret = solve_block();
+  free_rhs();
+  
+  return ret;
+#else
+  return false;
+#endif
+}
+
+bool SuperLUSolver::solve_block()
+{
+  _F_
+#ifdef WITH_SUPERLU
+  assert(has_B);
+  
   TimePeriod tmr;
   
+  int nrhs = B.ncol;
+  
   // Initialize SuperLU.
   void *work = NULL;      // Explicit pointer to the factorization workspace 
                           // (unused, see below).
   int lwork = 0;          // Space for the factorization will be allocated 
                           // internally by system malloc.
-  double ferr = 1.0;      // Estimated relative forward error 
-                          // (unused unless iterative refinement is performed).
-  double berr = 1.0;      // Estimated relative backward error 
-                          // (unused unless iterative refinement is performed).
+  double *ferr = new double[nrhs];  // Estimated relative forward errors 
+                                    // (unused unless iterative refinement is performed).
+  double *berr = new double[nrhs];  // Estimated relative backward errors 
+                                    // (unused unless iterative refinement is performed).
   mem_usage_t mem_usage;  // Record the memory usage statistics.
   double rpivot_growth;   // The reciprocal pivot growth factor.
   double rcond;           // The estimate of the reciprocal condition number.
@@ -429,6 +518,8 @@ bool SuperLUSolver::solve()
   if ( !prepare_factorization_structures() )
   {
     warning("LU factorization could not be completed.");
+    delete [] ferr;
+    delete [] berr;
     return false;
   }
   
@@ -464,36 +555,20 @@ bool SuperLUSolver::solve()
     }
   }
   
-  // If the right-hand side vector changed, recreate the input rhs for the solver driver from 
-  // a local copy of the new value array.
-  if (B_changed)
-    free_rhs();
-  
-  if (!has_B)
-  {
-    if (local_rhs) delete [] local_rhs;
-    local_rhs = new slu_scalar [rhs->size];
-    memcpy(local_rhs, rhs->v, rhs->size * sizeof(slu_scalar));
-    
-    SLU_CREATE_DENSE_MATRIX(&B, rhs->size, 1, local_rhs, rhs->size, SLU_DN, SLU_DTYPE, SLU_GE);
-    
-    has_B = true;
-  }
-  
-  // Initialize the solution variable.
+  // Initialize the solution variable (one column for every right-hand side).
   SuperMatrix X;
   slu_scalar *x;
-  if ( !(x = SLU_SCALAR_MALLOC(m->size)) ) 
+  if ( !(x = SLU_SCALAR_MALLOC(m->size * nrhs)) ) 
     ABORT("Malloc fails for x[].");
-  SLU_CREATE_DENSE_MATRIX(&X, m->size, 1, x, m->size, SLU_DN, SLU_DTYPE, SLU_GE);
+  SLU_CREATE_DENSE_MATRIX(&X, m->size, nrhs, x, m->size, SLU_DN, SLU_DTYPE, SLU_GE);
   
   // Initialize the statistics variable.
   SuperLUStat_t stat;
   StatInit(&stat);
   
-  // Solve the system.
+  // Solve the system (the factorization is computed once for all the right-hand sides).
   SLU_SOLVER_DRIVER(&options, &A, perm_c, perm_r, etree, equed, R, C, &L, &U,
-                    work, lwork, &B, &X, &rpivot_growth, &rcond, &ferr, &berr,
+                    work, lwork, &B, &X, &rpivot_growth, &rcond, ferr, berr,
                     &mem_usage, &stat, &info);
   
   // A and B may have been multiplied by the scaling vectors R and C on the output of the 
@@ -506,11 +581,13 @@ bool SuperLUSolver::solve()
   if (factorized) 
   {
     delete [] sln;
-    sln = new scalar[m->size];
+    sln = new scalar[m->size * nrhs];
+    num_sln = nrhs;
+    sln_size = m->size;
     
     slu_scalar *sol = (slu_scalar*) ((DNformat*) X.Store)->nzval; 
     
-    for (int i = 0; i < rhs->size; i++)
+    for (int i = 0; i < m->size * nrhs; i++)
 #if !defined(H1D_COMPLEX) && !defined(H2D_COMPLEX) && !defined(H3D_COMPLEX)      
       sln[i] = sol[i];
 #else
@@ -525,6 +602,8 @@ bool SuperLUSolver::solve()
   StatFree(&stat);
   SUPERLU_FREE (x);
   Destroy_SuperMatrix_Store(&X);
+  delete [] ferr;
+  delete [] berr;
   
   tmr.tick();
   time = tmr.accumulated();
@@ -535,11 +614,6 @@ bool SuperLUSolver::solve()
 #endif
 }
 
-#define CHECK_FACT_STATE  \
-  if (!has_fact_structs || !factorized) { \
-    warning("Factorization structures could not be reused - no successful factorization performed yet.");\
-    return false;\
-  }
 bool SuperLUSolver::prepare_factorization_structures()
 {
   _F_
@@ -79,6 +79,8 @@ public:
   virtual void zero();
   virtual void add(int m, int n, scalar v);
   virtual void add(int m, int n, scalar **mat, int *rows, int *cols);
+  virtual bool get_block_map(int m, int n, int *rows, int *cols, int *map);
+  virtual void add_block_with_map(int m, int n, scalar **mat, int *map);
   virtual bool dump(FILE *file, const char *var_name, EMatrixDumpFormat fmt = DF_MATLAB_SPARSE);
   virtual int get_matrix_size() const;
   virtual double get_fill_in() const;
@@ -91,6 +93,7 @@ protected:
   int nnz;        // Number of non-zero entries (= Ap[size]).
   
   friend class SuperLUSolver;
+  friend class MixedPrecisionSolver;
 };
 
 
@@ -130,6 +133,7 @@ public:
   virtual ~SuperLUSolver();
 
   virtual bool solve();
+  virtual bool solve_multiple(int nrhs, Vector **rhs);
   
   virtual void notify(const int notification) {
     if (notification & HERMES_NOTIFY_MATRIX_CHANGED) A_changed = true;
@@ -152,6 +156,7 @@ protected:
                                 // internally during factorization or externally by the user.
                                 
   bool check_status(int info);  // Check the status returned from the solver routine.
+  bool solve_block();           // Factorize (if needed) and solve for all columns of B.
   
   // Deep copies of matrix and rhs data vectors (they may be changed by the solver driver,
   // hence we need a copy so that the original SuperLUMatrix/Vector is preserved).
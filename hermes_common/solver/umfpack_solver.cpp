@@ -77,28 +77,12 @@ UMFPackMatrix::~UMFPackMatrix() {
 
 void UMFPackMatrix::alloc() {
   _F_
-  assert(pages != NULL);
+  assert(pattern.is_initialized());
   assert(size > 0);
 
-  // initialize the arrays Ap and Ai
-  Ap = new int [size + 1];
-  MEM_CHECK(Ap);
-  int aisize = get_num_indices();
-  Ai = new int [aisize];
-  MEM_CHECK(Ai);
-
-  // sort the indices and remove duplicities, insert into Ai
-  int i, pos = 0;
-  for (i = 0; i < size; i++) {
-    Ap[i] = pos;
-    pos += sort_and_store_indices(pages[i], Ai + pos, Ai + aisize);
-  }
-  Ap[i] = pos;
-
-  delete [] pages;
-  pages = NULL;
-
-  nnz = Ap[size];
+  // build the CSC structure: sorted row indices of every column, without duplicities
+  nnz = pattern.build(true, Ap, Ai, sym_storage);
+  pattern.free();
   
   Ax = new scalar [nnz];
   MEM_CHECK(Ax);
@@ -116,6 +100,7 @@ void UMFPackMatrix::free() {
 scalar UMFPackMatrix::get(int m, int n)
 {
   _F_
+  if (sym_storage && m > n) std::swap(m, n);
   // Find m-th row in the n-th column.
   int mid = find_position(Ai + Ap[n], Ap[n + 1] - Ap[n], m);
 
@@ -134,6 +119,8 @@ void UMFPackMatrix::add(int m, int n, scalar v) {
   _F_
   if (v != 0.0 && m >= 0 && n >= 0)   // ignore dirichlet DOFs
   {
+    if (sym_storage && m > n) return;   // the lower triangle is not stored
+
     // Find m-th row in the n-th column.
     int pos = find_position(Ai + Ap[n], Ap[n + 1] - Ap[n], m);
     // Make sure we are adding to an existing non-zero entry.
@@ -151,6 +138,40 @@ void UMFPackMatrix::add(int m, int n, scalar **mat, int *rows, int *cols) {
       add(rows[i], cols[j], mat[i][j]);
 }
 
+bool UMFPackMatrix::get_block_map(int m, int n, int *rows, int *cols, int *map) {
+  _F_
+  for (int j = 0; j < n; j++)       // cols
+  {
+    int col = cols[j];
+    for (int i = 0; i < m; i++)     // rows
+    {
+      if (rows[i] < 0 || col < 0 || (sym_storage && rows[i] > col))   // dirichlet DOFs (and the lower
+      {                                                                 // triangle if symmetric) are not stored
+        map[i * n + j] = -1;
+        continue;
+      }
+      // Find i-th row in the j-th column.
+      int pos = find_position(Ai + Ap[col], Ap[col + 1] - Ap[col], rows[i]);
+      if (pos < 0)
+        error("Sparse matrix entry not found");
+      map[i * n + j] = Ap[col] + pos;
+    }
+  }
+  return true;
+}
+
+void UMFPackMatrix::add_block_with_map(int m, int n, scalar **mat, int *map) {
+  _F_
+  for (int i = 0; i < m; i++)       // rows
+  {
+    scalar *row = mat[i];
+    int *row_map = map + i * n;
+    for (int j = 0; j < n; j++)     // cols
+      if (row_map[j] >= 0)
+        Ax[row_map[j]] += row[j];
+  }
+}
+
 /// dumping matrix and right-hand side
 ///
 bool UMFPackMatrix::dump(FILE *file, const char *var_name, EMatrixDumpFormat fmt) {
@@ -163,19 +184,32 @@ bool UMFPackMatrix::dump(FILE *file, const char *var_name, EMatrixDumpFormat fmt
         for (int i = Ap[j]; i < Ap[j + 1]; i++)
           fprintf(file, "%d %d " SCALAR_FMT "\n", Ai[i] + 1, j + 1, SCALAR(Ax[i]));
       fprintf(file, "];\n%s = spconvert(temp);\n", var_name);
+      if (sym_storage)  // only the upper triangle was written
+        fprintf(file, "%s = %s + %s.' - diag(diag(%s));\n", var_name, var_name, var_name, var_name);
 
       return true;
 
     case DF_HERMES_BIN: 
     {
+      // the whole matrix is written even in the case of the symmetric storage
+      int *ap = Ap, *ai = Ai, fnnz = nnz;
+      scalar *ax = Ax;
+      if (sym_storage) fnnz = get_full_csc(ap, ai, ax);
+
       hermes_fwrite("H3DX\001\000\000\000", 1, 8, file);
       int ssize = sizeof(scalar);
       hermes_fwrite(&ssize, sizeof(int), 1, file);
       hermes_fwrite(&size, sizeof(int), 1, file);
-      hermes_fwrite(&nnz, sizeof(int), 1, file);
-      hermes_fwrite(Ap, sizeof(int), size + 1, file);
-      hermes_fwrite(Ai, sizeof(int), nnz, file);
-      hermes_fwrite(Ax, sizeof(scalar), nnz, file);
+      hermes_fwrite(&fnnz, sizeof(int), 1, file);
+      hermes_fwrite(ap, sizeof(int), size + 1, file);
+      hermes_fwrite(ai, sizeof(int), fnnz, file);
+      hermes_fwrite(ax, sizeof(scalar), fnnz, file);
+
+      if (sym_storage) {
+        delete [] ap;
+        delete [] ai;
+        delete [] ax;
+      }
       return true;
     }
 
@@ -200,6 +234,49 @@ double UMFPackMatrix::get_fill_in() const {
   return nnz / (double) (size * size);
 }
 
+void UMFPackMatrix::multiply(scalar *x, scalar *y) {
+  _F_
+  memset(y, 0, size * sizeof(scalar));
+  for (int j = 0; j < size; j++)
+    for (int k = Ap[j]; k < Ap[j + 1]; k++) {
+      int i = Ai[k];
+      y[i] += Ax[k] * x[j];
+      if (sym_storage && i != j) y[j] += Ax[k] * x[i];
+    }
+}
+
+int UMFPackMatrix::get_full_csc(int *&ap, int *&ai, scalar *&ax) const {
+  _F_
+  // column j of the full matrix = column j of the upper triangle + row j of it (mirrored)
+  ap = new int[size + 1];
+  MEM_CHECK(ap);
+  memset(ap, 0, (size + 1) * sizeof(int));
+  for (int j = 0; j < size; j++)
+    for (int k = Ap[j]; k < Ap[j + 1]; k++) {
+      ap[j + 1]++;
+      if (sym_storage && Ai[k] != j) ap[Ai[k] + 1]++;
+    }
+  for (int j = 0; j < size; j++) ap[j + 1] += ap[j];
+
+  int fnnz = ap[size];
+  ai = new int[fnnz];
+  MEM_CHECK(ai);
+  ax = new scalar[fnnz];
+  MEM_CHECK(ax);
+  int *pos = new int[size];
+  MEM_CHECK(pos);
+  memcpy(pos, ap, size * sizeof(int));
+  // walking the columns in ascending order keeps the row indices sorted
+  for (int j = 0; j < size; j++)
+    for (int k = Ap[j]; k < Ap[j + 1]; k++) {
+      int i = Ai[k];
+      if (sym_storage && i != j) { ai[pos[i]] = j; ax[pos[i]++] = Ax[k]; }
+      ai[pos[j]] = i; ax[pos[j]++] = Ax[k];
+    }
+  delete [] pos;
+  return fnnz;
+}
+
 
 // UMFPackVector ///////
 
@@ -309,7 +386,8 @@ bool UMFPackVector::dump(FILE *file, const char *var_name, EMatrixDumpFormat fmt
 
 
 UMFPackLinearSolver::UMFPackLinearSolver(UMFPackMatrix *m, UMFPackVector *rhs)
-  : LinearSolver(HERMES_FACTORIZE_FROM_SCRATCH), m(m), rhs(rhs), symbolic(NULL), numeric(NULL)
+  : LinearSolver(HERMES_FACTORIZE_FROM_SCRATCH), m(m), rhs(rhs), symbolic(NULL), numeric(NULL),
+    Ap(NULL), Ai(NULL), Ax(NULL), own_csc(false)
 {
   _F_
 #ifdef WITH_UMFPACK
@@ -322,6 +400,19 @@ UMFPackLinearSolver::UMFPackLinearSolver(UMFPackMatrix *m, UMFPackVector *rhs)
 UMFPackLinearSolver::~UMFPackLinearSolver() {
   _F_
   free_factorization_structures();
+  free_full_csc();
+}
+
+void UMFPackLinearSolver::free_full_csc() {
+  _F_
+  if (own_csc) {
+    delete [] Ap;
+    delete [] Ai;
+    delete [] Ax;
+  }
+  own_csc = false;
+  Ap = Ai = NULL;
+  Ax = NULL;
 }
 
 #ifdef WITH_UMFPACK
@@ -369,8 +460,10 @@ bool UMFPackLinearSolver::solve() {
   sln = new scalar[m->size];
   MEM_CHECK(sln);
   memset(sln, 0, m->size * sizeof(scalar));
+  num_sln = 1;
+  sln_size = m->size;
 
-  status = umfpack_solve(UMFPACK_A, m->Ap, m->Ai, m->Ax, sln, rhs->v, numeric, NULL, NULL);
+  status = umfpack_solve(UMFPACK_A, Ap, Ai, Ax, sln, rhs->v, numeric, NULL, NULL);
   if (status != UMFPACK_OK) {
     check_status("umfpack_di_solve", status);
     return false;
@@ -385,18 +478,77 @@ bool UMFPackLinearSolver::solve() {
 #endif
 }
 
+bool UMFPackLinearSolver::solve_multiple(int nrhs, Vector **rhs)
+{
+  _F_
+#ifdef WITH_UMFPACK
+  assert(m != NULL);
+  assert(nrhs > 0);
+
+  TimePeriod tmr;
+
+  if ( !prepare_factorization_structures() )
+  {
+    warning("LU factorization could not be completed.");
+    return false;
+  }
+
+  int n = m->size;
+  scalar *b = gather_rhs(n, nrhs, rhs);
+
+  if(sln)
+    delete [] sln;
+  sln = new scalar[n * nrhs];
+  MEM_CHECK(sln);
+  memset(sln, 0, n * nrhs * sizeof(scalar));
+  num_sln = nrhs;
+  sln_size = n;
+
+  bool ret = true;
+  for (int k = 0; k < nrhs && ret; k++) {
+    int status = umfpack_solve(UMFPACK_A, Ap, Ai, Ax, sln + k * n, b + k * n, numeric, NULL, NULL);
+    if (status != UMFPACK_OK) {
+      check_status("umfpack_di_solve", status);
+      ret = false;
+    }
+  }
+  delete [] b;
+
+  tmr.tick();
+  time = tmr.accumulated();
+
+  return ret;
+#else
+  return false;
+#endif
+}
+
 bool UMFPackLinearSolver::prepare_factorization_structures()
 {
   _F_
 #ifdef WITH_UMFPACK
   int status;
+
+  if (factorization_scheme != HERMES_REUSE_FACTORIZATION_COMPLETELY || Ap == NULL)
+  {
+    // UMFPACK does not work with the symmetric storage, it gets a copy of the whole matrix
+    free_full_csc();
+    if (m->sym_storage) {
+      m->get_full_csc(Ap, Ai, Ax);
+      own_csc = true;
+    }
+    else {
+      Ap = m->Ap; Ai = m->Ai; Ax = m->Ax;
+    }
+  }
+
   switch(factorization_scheme)
   {
     case HERMES_FACTORIZE_FROM_SCRATCH:
       if (symbolic != NULL) umfpack_free_symbolic(&symbolic);
       
       //debug_log("Factorizing symbolically.");
-      status = umfpack_symbolic(m->size, m->size, m->Ap, m->Ai, m->Ax, &symbolic, NULL, NULL);
+      status = umfpack_symbolic(m->size, m->size, Ap, Ai, Ax, &symbolic, NULL, NULL);
       if (status != UMFPACK_OK) {
         check_status("umfpack_di_symbolic", status);
         return false;
@@ -408,7 +560,7 @@ bool UMFPackLinearSolver::prepare_factorization_structures()
       if (numeric != NULL) umfpack_free_numeric(&numeric);
       
       //debug_log("Factorizing numerically.");
-      status = umfpack_numeric(m->Ap, m->Ai, m->Ax, symbolic, &numeric, NULL, NULL);
+      status = umfpack_numeric(Ap, Ai, Ax, symbolic, &numeric, NULL, NULL);
       if (status != UMFPACK_OK) {
         check_status("umfpack_di_numeric", status);
         return false;
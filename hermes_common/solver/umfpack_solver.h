@@ -35,18 +35,32 @@ public:
   virtual void zero();
   virtual void add(int m, int n, scalar v);
   virtual void add(int m, int n, scalar **mat, int *rows, int *cols);
+  virtual bool get_block_map(int m, int n, int *rows, int *cols, int *map);
+  virtual void add_block_with_map(int m, int n, scalar **mat, int *map);
   virtual bool dump(FILE *file, const char *var_name, EMatrixDumpFormat fmt = DF_MATLAB_SPARSE);
   virtual int get_matrix_size() const;
   virtual double get_fill_in() const;
+  virtual bool set_symmetric_storage(bool sym) { sym_storage = sym; return true; }
+  virtual void multiply(scalar *x, scalar *y);
+
+  /// Build the CSC structure with both triangles (for the symmetric storage),
+  /// the arrays are allocated by new[].
+  /// @return - number of nonzero entries
+  int get_full_csc(int *&ap, int *&ai, scalar *&ax) const;
   
 protected:
   // UMFPack specific data structures for storing the system matrix (CSC format).
+  // Only the upper triangle is stored in the case of the symmetric storage.
   scalar *Ax;   // Matrix entries (column-wise).
   int *Ai;      // Row indices of values in Ax.
   int *Ap;      // Index to Ax/Ai, where each column starts.
   int nnz;      // Number of non-zero entries (= Ap[size]).
 
   friend class UMFPackLinearSolver;
+  friend class KrylovSolver;
+  friend class NativePrecond;
+  friend class MixedPrecisionSolver;
+  friend class EigenSolver;
 };
 
 class HERMES_API UMFPackVector : public Vector {
@@ -70,6 +84,7 @@ protected:
   scalar *v;
 
   friend class UMFPackLinearSolver;
+  friend class KrylovSolver;
 };
 
 
@@ -82,6 +97,8 @@ public:
   virtual ~UMFPackLinearSolver();
 
   virtual bool solve();
+  /// UMFPACK has no blocked solve, the factorization is reused for every column.
+  virtual bool solve_multiple(int nrhs, Vector **rhs);
     
 protected:
   UMFPackMatrix *m;
@@ -90,6 +107,13 @@ protected:
   // Reusable factorization information (A denotes matrix represented by the pointer 'm').
   void *symbolic; // Reordering of matrix A to reduce fill-in during factorization.
   void *numeric;  // LU factorization of matrix A.
+
+  // CSC structure passed to UMFPACK: the arrays of 'm', or their copy with both triangles
+  // if 'm' uses the symmetric storage.
+  int *Ap, *Ai;
+  scalar *Ax;
+  bool own_csc;   // Ap, Ai, Ax is a copy
+  void free_full_csc();
   
   bool prepare_factorization_structures();
   void free_factorization_structures();
@@ -0,0 +1,200 @@
+// This file is part of Hermes3D
+//
+// Copyright (c) 2009 hp-FEM group at the University of Nevada, Reno (UNR).
+// Email: hpfem-group@unr.edu, home page: http://hpfem.org/.
+//
+// Hermes3D is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published
+// by the Free Software Foundation; either version 2 of the License,
+// or (at your option) any later version.
+//
+// Hermes3D is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Hermes3D; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include "common.h"
+#include "sparsity.h"
+#include "error.h"
+#include "callstack.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+SparsityPattern::SparsityPattern()
+{
+	_F_
+	size = 0;
+}
+
+SparsityPattern::~SparsityPattern()
+{
+	_F_
+	free();
+}
+
+void SparsityPattern::init(int size)
+{
+	_F_
+	free();
+	this->size = size;
+}
+
+void SparsityPattern::free()
+{
+	_F_
+	// swap with empty vectors to really release the memory
+	std::vector<int>().swap(blocks);
+	std::vector<int>().swap(idx);
+	std::vector<int>().swap(entries);
+	size = 0;
+}
+
+void SparsityPattern::add_block(int m, int n, int *rows, int *cols)
+{
+	_F_
+	assert(size > 0);
+	int start = idx.size();
+	int mm = 0, nn = 0;
+	for (int i = 0; i < m; i++)
+		if (rows[i] >= 0) { idx.push_back(rows[i]); mm++; }
+	for (int j = 0; j < n; j++)
+		if (cols[j] >= 0) { idx.push_back(cols[j]); nn++; }
+
+	if (mm == 0 || nn == 0) {
+		idx.resize(start);
+		return;
+	}
+	blocks.push_back(start);
+	blocks.push_back(mm);
+	blocks.push_back(nn);
+}
+
+void SparsityPattern::add(int row, int col)
+{
+	_F_
+	assert(size > 0);
+	if (row < 0 || col < 0) return;
+	entries.push_back(row);
+	entries.push_back(col);
+}
+
+int SparsityPattern::build(bool by_cols, int *&Ap, int *&Ai, bool upper)
+{
+	_F_
+	assert(size > 0);
+	int nblk = blocks.size() / 3;
+	const int *ix = idx.empty() ? NULL : &idx[0];
+	const int *bl = blocks.empty() ? NULL : &blocks[0];
+	int nent = entries.size() / 2;
+	const int *en = entries.empty() ? NULL : &entries[0];
+
+	// 'minor' indices are those stored in Ai (rows for CSC), 'major' ones index Ap.
+	// The gather pass runs over the minor indices and collects the major ones,
+	// the final transpose then orders the minor indices within every major one.
+	int minor_ofs = by_cols ? 0 : 1;       // position of the minor list inside a block (0 = rows)
+
+	// 1. bucket the blocks by their minor indices; the single entries follow the blocks
+	// in the buckets (as nblk + their number)
+	int *inc_ptr = new int[size + 1];
+	MEM_CHECK(inc_ptr);
+	memset(inc_ptr, 0, (size + 1) * sizeof(int));
+	for (int b = 0; b < nblk; b++) {
+		const int *mi = ix + bl[3 * b] + (minor_ofs ? bl[3 * b + 1] : 0);
+		int cnt = bl[3 * b + 1 + minor_ofs];
+		for (int k = 0; k < cnt; k++) inc_ptr[mi[k] + 1]++;
+	}
+	for (int e = 0; e < nent; e++) inc_ptr[en[2 * e + minor_ofs] + 1]++;
+	for (int i = 0; i < size; i++) inc_ptr[i + 1] += inc_ptr[i];
+
+	int *inc = new int[inc_ptr[size]];
+	MEM_CHECK(inc);
+	int *pos = new int[size];
+	MEM_CHECK(pos);
+	memcpy(pos, inc_ptr, size * sizeof(int));
+	for (int b = 0; b < nblk; b++) {
+		const int *mi = ix + bl[3 * b] + (minor_ofs ? bl[3 * b + 1] : 0);
+		int cnt = bl[3 * b + 1 + minor_ofs];
+		for (int k = 0; k < cnt; k++) inc[pos[mi[k]]++] = b;
+	}
+	for (int e = 0; e < nent; e++) inc[pos[en[2 * e + minor_ofs]]++] = nblk + e;
+
+	// 2. gather unique major indices of every minor index (unsorted), in two sweeps:
+	// the first one counts, the second one stores
+	int *rp = new int[size + 1];
+	MEM_CHECK(rp);
+	rp[0] = 0;
+	int *ri = NULL;
+	for (int sweep = 0; sweep < 2; sweep++) {
+#pragma omp parallel
+		{
+			int *marker = new int[size];
+			MEM_CHECK(marker);
+			for (int i = 0; i < size; i++) marker[i] = -1;
+
+#pragma omp for schedule(dynamic, 256)
+			for (int r = 0; r < size; r++) {
+				int cnt = 0;
+				int *out = (sweep == 1) ? ri + rp[r] : NULL;
+				for (int k = inc_ptr[r]; k < inc_ptr[r + 1]; k++) {
+					int b = inc[k];
+					const int *mj;
+					int n;
+					if (b < nblk) {
+						mj = ix + bl[3 * b] + (minor_ofs ? 0 : bl[3 * b + 1]);
+						n = bl[3 * b + 2 - minor_ofs];
+					}
+					else {
+						mj = en + 2 * (b - nblk) + 1 - minor_ofs;
+						n = 1;
+					}
+					for (int l = 0; l < n; l++) {
+						int c = mj[l];
+						// upper triangle: row <= col, i.e. minor <= major for CSC, major <= minor for CSR
+						if (upper && (by_cols ? r > c : c > r)) continue;
+						if (marker[c] != r) {
+							marker[c] = r;
+							if (out != NULL) out[cnt] = c;
+							cnt++;
+						}
+					}
+				}
+				if (sweep == 0) rp[r + 1] = cnt;
+			}
+			delete [] marker;
+		}
+
+		if (sweep == 0) {
+			for (int i = 0; i < size; i++) rp[i + 1] += rp[i];
+			ri = new int[rp[size]];
+			MEM_CHECK(ri);
+		}
+	}
+	delete [] inc;
+	delete [] inc_ptr;
+
+	// 3. transpose: walking the minor indices in ascending order leaves the result sorted
+	int nnz = rp[size];
+	Ap = new int[size + 1];
+	MEM_CHECK(Ap);
+	Ai = new int[nnz];
+	MEM_CHECK(Ai);
+	memset(Ap, 0, (size + 1) * sizeof(int));
+	for (int k = 0; k < nnz; k++) Ap[ri[k] + 1]++;
+	for (int i = 0; i < size; i++) Ap[i + 1] += Ap[i];
+	memcpy(pos, Ap, size * sizeof(int));
+	for (int r = 0; r < size; r++)
+		for (int k = rp[r]; k < rp[r + 1]; k++)
+			Ai[pos[ri[k]]++] = r;
+
+	delete [] ri;
+	delete [] rp;
+	delete [] pos;
+
+	return nnz;
+}
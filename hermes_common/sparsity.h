@@ -0,0 +1,80 @@
+// This file is part of Hermes3D
+//
+// Copyright (c) 2009 hp-FEM group at the University of Nevada, Reno (UNR).
+// Email: hpfem-group@unr.edu, home page: http://hpfem.org/.
+//
+// Hermes3D is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published
+// by the Free Software Foundation; either version 2 of the License,
+// or (at your option) any later version.
+//
+// Hermes3D is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Hermes3D; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#ifndef _SPARSITY_H_
+#define _SPARSITY_H_
+
+#include "common.h"
+
+/// \class SparsityPattern
+/// \brief Builder of the compressed (CSC/CSR) structure of a sparse matrix.
+///
+/// Instead of storing every nonzero entry, the builder only records the connectivity
+/// of dense blocks (typically the DOF lists of element assembly lists), i.e. m + n
+/// indices for an (m x n) block (single entries added by add() take two indices).
+/// The compressed structure is then built by build():
+/// 1. the blocks are bucketed by the indices of the minor dimension (counting pass),
+/// 2. the unique major indices of every minor index are gathered (rows are split
+///    among threads if Hermes is built with OpenMP),
+/// 3. the result is transposed by a counting pass, which leaves the minor indices
+///    of every major index sorted, so no sorting is needed at all.
+///
+class HERMES_API SparsityPattern {
+public:
+	SparsityPattern();
+	~SparsityPattern();
+
+	/// Start collecting the pattern of a (size x size) matrix.
+	void init(int size);
+	/// Release the collected data.
+	void free();
+
+	bool is_initialized() const { return size > 0; }
+	int get_size() const { return size; }
+
+	/// Register all entries of a dense block. Negative indices (dirichlet DOFs) are ignored.
+	///
+	/// @param[in] m    - number of rows of the block
+	/// @param[in] n    - number of columns of the block
+	/// @param[in] rows - array with row indexes
+	/// @param[in] cols - array with column indexes
+	void add_block(int m, int n, int *rows, int *cols);
+
+	/// Register a single entry. Stored as a (row, col) pair, not as a block.
+	void add(int row, int col);
+
+	/// Build the compressed structure. The arrays are allocated by new[] and
+	/// their ownership is passed to the caller.
+	///
+	/// @param[in] by_cols - true for CSC (Ap indexed by columns, Ai holds row indices),
+	///                      false for CSR (Ap indexed by rows, Ai holds column indices)
+	/// @param[out] Ap     - index to Ai where each column (row) starts, size + 1 entries
+	/// @param[out] Ai     - sorted row (column) indices without duplicities
+	/// @param[in] upper   - keep only the entries of the upper triangle (row <= col)
+	/// @return - number of nonzero entries (= Ap[size])
+	int build(bool by_cols, int *&Ap, int *&Ai, bool upper = false);
+
+protected:
+	int size;
+	std::vector<int> blocks;   ///< (start, m, n) for every registered block
+	std::vector<int> idx;      ///< rows and columns of the blocks, one after another
+	std::vector<int> entries;  ///< (row, col) for every single entry registered by add()
+};
+
+#endif